@@ -16,9 +16,11 @@ from typing import (
     Dict,
     Iterable,
     Iterator,
+    List,
     Mapping,
     Optional,
     Sequence,
+    Tuple,
     Union,
     overload,
 )
@@ -57,6 +59,14 @@ class Program:
     The main functionality of a ``Program`` is looking up objects (i.e.,
     variables, constants, or functions). This is usually done with the
     :meth:`[] <.__getitem__>` operator.
+
+    Potentially long-running operations (loading debugging information,
+    reading memory with :meth:`read()`, looking up types with :meth:`type()`,
+    getting stack traces, and formatting objects) release the global
+    interpreter lock, so other threads can run in the meantime. All operations
+    on the same ``Program`` and its objects, types, and stack traces are
+    serialized, so another thread using the same ``Program`` waits for them to
+    finish.
     """
 
     def __init__(self, platform: Optional[Platform] = None) -> None:
@@ -89,6 +99,21 @@ class Program:
     this is determined from the language of ``main`` in the program, falling
     back to :attr:`Language.C`. This heuristic may change in the future.
     """
+
+    frame_pointer_unwinding: bool
+    """
+    Whether :meth:`stack_trace()` and :meth:`stack_traces()` unwind stacks by
+    following frame pointers.
+
+    This is much faster than using call frame information, but it is only
+    correct for code compiled with frame pointers (e.g., with
+    ``-fno-omit-frame-pointer``). Each frame is unwound with the frame pointer
+    if the result looks valid; otherwise, including for interrupted frames,
+    the frame is unwound normally. Frames unwound with the frame pointer only
+    have the program counter, stack pointer, and frame pointer registers.
+
+    This is ``False`` by default.
+    """
     def __getitem__(self, name: str) -> Object:
         """
         Implement ``self[name]``. Get the object (variable, constant, or
@@ -180,17 +205,152 @@ class Program:
             the given file
         """
         ...
+    def per_cpu_values(
+        self, ptr: Object, cpus: Optional[Iterable[IntegerLike]] = None
+    ) -> List[Object]:
+        """
+        Get the value of a Linux kernel per-CPU variable on multiple CPUs.
+
+        The per-CPU offsets and the set of possible CPUs are read the first
+        time they are needed and cached for the lifetime of the program.
+
+        >>> prog.per_cpu_values(prog["runqueues"].address_of_())[0].nr_running
+        (unsigned int)2
+
+        :param ptr: ``type __percpu *``
+        :param cpus: CPU numbers to read the variable on. Defaults to every
+            possible CPU in ascending order.
+        :return: List of ``type`` values in the same order as *cpus*.
+        """
+        ...
+    def per_cpu_sum(
+        self, ptr: Object, cpus: Optional[Iterable[IntegerLike]] = None
+    ) -> Object:
+        """
+        Sum the value of a Linux kernel per-CPU integer variable over multiple
+        CPUs.
+
+        This reads the values like :meth:`per_cpu_values()`. The sum wraps
+        around on overflow.
+
+        >>> from drgn.helpers.linux.cpumask import for_each_online_cpu
+        >>> fbc = prog["vm_committed_as"]
+        >>> prog.per_cpu_sum(fbc.counters, for_each_online_cpu(prog))
+        (long long)-1233
+
+        :param ptr: ``type __percpu *``, where ``type`` is an integer type.
+        :param cpus: CPU numbers to sum the variable over. Defaults to every
+            possible CPU.
+        :return: ``long long`` if ``type`` is signed, ``unsigned long long``
+            otherwise.
+        """
+        ...
     # address_or_name is positional-only.
     def symbol(self, address_or_name: Union[IntegerLike, str]) -> Symbol:
         """
         Get the symbol containing the given address, or the global symbol with
         the given name.
 
+        For the Linux kernel, symbols which are not in any loaded debugging
+        information are looked up in the kernel's own symbol table: either
+        ``/proc/kallsyms`` for the running kernel, or the ``kallsyms`` tables in
+        the core dump if its ``VMCOREINFO`` describes them (Linux 6.0 and
+        newer). This makes symbolization possible without ``vmlinux``, but the
+        sizes of these symbols are estimated from the address of the next
+        symbol.
+
         :param address_or_name: The address or name.
         :raises LookupError: if no symbol contains the given address or matches
             the given name
         """
         ...
+    # addresses is positional-only.
+    def symbolize(self, addresses: Iterable[IntegerLike]) -> List[Optional[Symbol]]:
+        """
+        Get the symbols containing each of the given addresses.
+
+        This is equivalent to calling :meth:`symbol()` for each address, except
+        that addresses which are not in any symbol result in ``None`` rather
+        than an exception.
+
+        >>> prog.symbolize([0xffffffff8d0e1d32, 0])
+        [Symbol(name='schedule', address=0xffffffff8d0e1cd0, size=0x90), None]
+
+        Recently looked up addresses are cached, so symbolizing many repeated
+        addresses (e.g., the return addresses of every stack trace) is cheap.
+
+        :param addresses: Addresses to look up.
+        """
+        ...
+    def symbols(self, pattern: Optional[str] = None) -> List[Symbol]:
+        """
+        Get the global symbols whose names match a pattern.
+
+        >>> prog.symbols('jiffies*')
+        [Symbol(name='jiffies', address=0xffffffff8dc05000, size=0x8), ...]
+
+        Symbols are looked up in an index that is built the first time that
+        this or :meth:`symbol()` is called with a name, so looking up many
+        names is much faster than scanning the symbol tables each time.
+
+        :param pattern: Shell-style wildcard pattern (see :mod:`fnmatch`) to
+            match symbol names against. If ``None``, all global symbols are
+            returned.
+        """
+        ...
+    # expr is positional-only.
+    def eval(
+        self, expr: str, **variables: Union[Object, int, float, bool]
+    ) -> Object:
+        """
+        Evaluate an expression in the language of the program.
+
+        >>> prog.eval('init_task.comm')
+        (char [16])"swapper/0"
+        >>> prog.eval('task->pid + 1', task=prog['init_task'].address_of_())
+        (int)1
+
+        Names in the expression refer to the given keyword arguments or to
+        objects in the program (see :meth:`object()`), and type names are
+        looked up with :meth:`type()`. For C, member access, subscripts, casts,
+        ``sizeof``, and the unary, binary, and conditional operators are
+        supported. Integer literals may be decimal, octal, or hexadecimal and
+        may have a ``u`` and/or ``l``/``ll`` suffix. Floating-point, character,
+        and string literals, function calls, and assignments are not
+        supported.
+
+        To evaluate the same expression many times, use :meth:`compile()`
+        instead.
+
+        :param expr: Expression to evaluate.
+        :param variables: Objects to bind to names in the expression. Python
+            ``int``, ``float``, and ``bool`` values are converted to literal
+            objects.
+        :raises SyntaxError: if the expression is invalid
+        :raises LookupError: if a name in the expression is not found
+        """
+        ...
+    def compile(self, expr: str, params: Sequence[str] = ()) -> Expression:
+        """
+        Compile an expression in the language of the program for repeated
+        evaluation.
+
+        The expression is parsed and the objects and types that it refers to
+        are looked up once. Evaluating the returned :class:`Expression` only
+        performs the operations themselves:
+
+        >>> next_pid = prog.compile('task->pid + 1', ['task'])
+        >>> [next_pid(task) for task in for_each_task(prog)]
+
+        See :meth:`eval()` for the supported syntax.
+
+        :param expr: Expression to compile.
+        :param params: Names of the expression's parameters. These take
+            precedence over objects in the program with the same name.
+        :raises SyntaxError: if the expression is invalid
+        :raises LookupError: if a name in the expression is not found
+        """
+        ...
     def stack_trace(
         self,
         # Object is already IntegerLike, but this explicitly documents that it
@@ -217,10 +377,62 @@ class Program:
         well as userspace core dumps; it is not yet implemented for live
         userspace processes.
 
+        Stacks are unwound using DWARF call frame information (from
+        ``.eh_frame`` or ``.debug_frame``), falling back to the frame pointer
+        for code without it. For x86-64 Linux kernels built with
+        ``CONFIG_UNWINDER_ORC``, the kernel's ORC unwinder tables are used
+        instead when available.
+
         :param thread: Thread ID, ``struct pt_regs`` object, or
             ``struct task_struct *`` object.
         """
         ...
+    # threads is positional-only.
+    def stack_traces(
+        self, threads: Iterable[Union[Object, IntegerLike]]
+    ) -> List[Optional[StackTrace]]:
+        """
+        Get the stack traces for many threads at once.
+
+        This is equivalent to calling :meth:`stack_trace()` for each thread,
+        except that the stacks are unwound in parallel, and threads whose
+        stacks could not be unwound (for example, because they are running on
+        a live kernel or no longer exist) result in ``None`` rather than an
+        exception.
+
+        >>> from drgn.helpers.linux.pid import for_each_task
+        >>> traces = prog.stack_traces(for_each_task(prog))
+
+        :param threads: Thread IDs, ``struct pt_regs`` objects, or ``struct
+            task_struct *`` objects; see :meth:`stack_trace()`.
+        """
+        ...
+    # threads is positional-only.
+    def aggregate_stack_traces(
+        self, threads: Iterable[Union[Object, IntegerLike]]
+    ) -> List[Tuple[StackTrace, List[Union[Object, IntegerLike]]]]:
+        """
+        Get the stack traces for many threads and group threads with identical
+        stack traces.
+
+        The stacks are unwound like :meth:`stack_traces()`. Threads whose
+        stack traces have the same sequence of program counters are grouped
+        together, and each distinct stack trace is only returned (and
+        symbolized when it is printed) once. Threads whose stacks could not be
+        unwound are omitted.
+
+        >>> from drgn.helpers.linux.pid import for_each_task
+        >>> for trace, tasks in prog.aggregate_stack_traces(for_each_task(prog)):
+        ...     print(len(tasks), "tasks:")
+        ...     print(trace)
+
+        :param threads: Thread IDs, ``struct pt_regs`` objects, or ``struct
+            task_struct *`` objects; see :meth:`stack_trace()`.
+        :return: List of ``(trace, threads)`` tuples, where ``threads`` is the
+            list of elements of *threads* with that stack trace. This is sorted
+            by decreasing number of threads.
+        """
+        ...
     def type(self, name: str, filename: Optional[str] = None) -> Type:
         """
         Get the type with the given name.
@@ -257,6 +469,87 @@ class Program:
         :raises ValueError: if *size* is negative
         """
         ...
+    def search_memory(
+        self,
+        pattern: bytes,
+        mask: Optional[bytes] = None,
+        *,
+        align: IntegerLike = 1,
+        physical: bool = False,
+        start: IntegerLike = 0,
+        end: Optional[IntegerLike] = None,
+    ) -> Iterator[int]:
+        """
+        Search the program's memory for a byte pattern.
+
+        The memory segments of the program are read in large chunks by
+        multiple threads and searched natively, and matches are returned in
+        increasing order of address as they are found. Parts of memory that
+        can't be read are skipped. For the Linux kernel, virtual memory that
+        isn't in the core dump is not searched; search physical memory to find
+        it. For a running process, only the memory that is mapped when the
+        search starts is searched.
+
+        >>> task = find_task(prog, 1)
+        >>> pattern = task.value_().to_bytes(8, "little")
+        >>> [hex(addr) for addr in prog.search_memory(pattern, align=8)]
+        ['0xffff8881002a8e10', '0xffff888100b43f58', ...]
+
+        :param pattern: Bytes to search for.
+        :param mask: If given, only the bits that are set in the mask are
+            compared. It must be the same length as *pattern*.
+        :param align: Only return matches whose address is a multiple of this.
+        :param physical: Whether to search physical memory instead of virtual
+            memory.
+        :param start: Address to start searching at.
+        :param end: Address to stop searching at (exclusive). Matches must
+            start before this address. Defaults to the end of the address
+            space.
+        :return: Iterator of match addresses.
+        """
+        ...
+    def start_recording(self) -> None:
+        """
+        Start recording the memory that is read from this program so that it
+        can be saved with :meth:`write_minicore()`.
+
+        The first time that any part of a page of virtual or physical memory
+        is read, the contents of the whole page are copied. To include the
+        memory read while loading debugging information, call this before
+        :meth:`load_debug_info()`. Memory read by :meth:`search_memory()` is
+        not recorded.
+        """
+        ...
+    def stop_recording(self) -> None:
+        """
+        Stop recording the memory that is read from this program. The memory
+        recorded so far is kept, and recording can be started again.
+        """
+        ...
+    def write_minicore(self, path: Path) -> None:
+        """
+        Write the memory recorded by :meth:`start_recording()` to a sparse ELF
+        core dump (a "minicore").
+
+        The minicore only contains the recorded pages and the ``VMCOREINFO``
+        and ``NT_PRSTATUS`` notes, so it is usually a tiny fraction of the size
+        of the original core dump. Reading a recorded page from the minicore
+        returns its contents from when it was first read, even if it changed
+        later; reading memory that wasn't recorded raises a
+        :class:`FaultError`.
+
+        >>> prog = drgn.Program()
+        >>> prog.start_recording()
+        >>> prog.set_core_dump("/var/crash/vmcore")
+        >>> prog.load_default_debug_info()
+        >>> triage(prog)
+        >>> prog.write_minicore("/var/crash/minicore")
+
+        Physical memory is only saved for the Linux kernel.
+
+        :param path: File to write.
+        """
+        ...
     def read_u8(self, address: IntegerLike, physical: bool = False) -> int:
         ""
         ...
@@ -417,6 +710,28 @@ class Program:
         This is equivalent to ``load_debug_info(None, True)``.
         """
         ...
+    def load_btf(self, path: Optional[Path] = None) -> None:
+        """
+        Load types from BPF Type Format (BTF).
+
+        The Linux kernel can be built with a compact description of its types
+        in BTF. Loading it is much faster than loading DWARF debugging
+        information, so this is useful for quickly getting types when
+        ``vmlinux`` is not available. Only types are loaded, not variables or
+        functions.
+
+        Types are looked up in BTF before debugging information that was
+        loaded earlier and after debugging information that is loaded later.
+        BTF does not record source filenames, so lookups with a filename never
+        find BTF types.
+
+        :param path: Path of a raw BTF file (like ``/sys/kernel/btf/vmlinux``)
+            or an ELF file with a ``.BTF`` section. If ``None``, the BTF of the
+            Linux kernel is found automatically, either from
+            ``/sys/kernel/btf/vmlinux`` or from kernel memory.
+        :raises ValueError: if BTF was already loaded
+        """
+        ...
     cache: Dict[Any, Any]
     """
     Dictionary for caching program metadata.
@@ -1368,6 +1683,27 @@ class Symbol:
     size: int
     """Size of this symbol in bytes."""
 
+class Expression:
+    """
+    An ``Expression`` is an expression compiled with :meth:`Program.compile()`.
+
+    Calling an expression evaluates it and returns the resulting
+    :class:`Object`. The arguments are bound to the parameters in order or by
+    name. Like :meth:`Program.eval()`, arguments may also be ``int``,
+    ``float``, or ``bool`` values.
+    """
+
+    prog: Program
+    """Program that this expression was compiled for."""
+
+    params: Tuple[str, ...]
+    """Names of the parameters of this expression."""
+    def __call__(
+        self,
+        *args: Union[Object, int, float, bool],
+        **kwargs: Union[Object, int, float, bool],
+    ) -> Object: ...
+
 class StackTrace:
     """
     A ``StackTrace`` is a :ref:`sequence <python:typesseq-common>` of
@@ -1920,6 +2256,16 @@ def _linux_helper_find_task(
     """
     ...
 
+def _linux_helper_per_cpu_ptr(ptr: Object, cpu: IntegerLike) -> Object:
+    """
+    Return the per-CPU pointer for a given CPU.
+
+    :param ptr: ``type __percpu *``
+    :param cpu: CPU number.
+    :return: ``type *``
+    """
+    ...
+
 def _linux_helper_kaslr_offset(prog: Program) -> int:
     """
     Get the kernel address space layout randomization offset (zero if it is
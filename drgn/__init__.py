@@ -48,6 +48,7 @@ import types
 from _drgn import (
     NULL,
     Architecture,
+    Expression,
     FaultError,
     FindObjectFlags,
     IntegerLike,
@@ -88,6 +89,7 @@ from drgn.internal.version import version as __version__
 
 __all__ = (
     "Architecture",
+    "Expression",
     "FaultError",
     "FindObjectFlags",
     "IntegerLike",
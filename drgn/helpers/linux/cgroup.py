@@ -10,13 +10,15 @@ cgroup interface in :linux:`include/linux/cgroup.h`. Only cgroup v2 is
 supported.
 """
 
-from typing import Callable, Iterator
+from typing import Callable, Iterator, NamedTuple, Optional, Sequence, Tuple, Union
 
-from drgn import NULL, Object, cast, container_of
+from _drgn import _linux_helper_cgroup_walk
+from drgn import NULL, Object, Type, cast, container_of
 from drgn.helpers.linux.kernfs import kernfs_name, kernfs_path
 from drgn.helpers.linux.list import list_for_each_entry
 
 __all__ = (
+    "CssWalkEntry",
     "cgroup_name",
     "cgroup_parent",
     "cgroup_path",
@@ -24,6 +26,7 @@ __all__ = (
     "css_for_each_descendant_pre",
     "css_next_child",
     "css_next_descendant_pre",
+    "css_walk",
     "sock_cgroup_ptr",
 )
 
@@ -159,3 +162,80 @@ def css_for_each_descendant_pre(css: Object) -> Iterator[Object]:
     :return: Iterator of ``struct cgroup_subsys_state *`` objects.
     """
     return _css_for_each_impl(css_next_descendant_pre, css)
+
+
+class CssWalkEntry(NamedTuple):
+    """A css visited by :func:`css_walk()`."""
+
+    css: Object
+    """``struct cgroup_subsys_state *``"""
+
+    path: bytes
+    """Full path of the css's cgroup, as returned by :func:`cgroup_path()`."""
+
+    counters: Tuple[Optional[int], ...]
+    """
+    Value of each requested counter for this css, or ``None`` if it could not
+    be read (e.g., because a pointer on the way to it was ``NULL``).
+    """
+
+    totals: Tuple[int, ...]
+    """
+    Sum of each requested counter over this css and all of its online
+    descendants. Counters that could not be read count as 0.
+    """
+
+
+def css_walk(
+    css: Object,
+    counters: Sequence[str] = (),
+    *,
+    type: Union[str, Type] = "struct cgroup",
+    member: str = "self",
+) -> Iterator[CssWalkEntry]:
+    """
+    Walk the given css and its descendants in pre-order, like
+    :func:`css_for_each_descendant_pre()`, along with the path of each one and
+    optionally some counters.
+
+    The whole subtree is walked when iteration starts. Counters are fields of
+    the structure that each css is embedded in, given by *type* and *member*.
+    They are member designators which may also follow pointers with ``->``.
+    They are also summed over each subtree.
+
+    For example, ``nr_populated_csets`` counts the css_sets with tasks in each
+    cgroup itself, not in its descendants, so its total counts the css_sets
+    with tasks in the whole subtree:
+
+    >>> root = prog["cgrp_dfl_root"].cgrp.self.address_of_()
+    >>> for entry in css_walk(root, ["nr_populated_csets"]):
+    ...     print(entry.path, entry.counters[0], entry.totals[0])
+    ...
+    b'/' 0 5
+    b'/init.scope' 1 1
+    b'/system.slice' 0 3
+    b'/system.slice/cron.service' 1 1
+    b'/system.slice/sshd.service' 2 2
+    b'/user.slice' 1 1
+
+    Counters that the kernel already accumulates over descendants, like the
+    memory usage of a memory cgroup, shouldn't be summed again.
+
+    :param css: ``struct cgroup_subsys_state *``
+    :param counters: Integer or pointer fields to read for each css.
+    :param type: Type of the structure containing each css.
+    :param member: Name of the css member in *type*.
+    """
+    prog = css.prog_
+    type_name = type if isinstance(type, str) else type.type_name()
+    csses, paths, values, totals = _linux_helper_cgroup_walk(
+        css, counters, type_name, member
+    )
+    css_type = prog.type("struct cgroup_subsys_state *")
+    for i, address in enumerate(csses):
+        yield CssWalkEntry(
+            Object(prog, css_type, value=address),
+            paths[i],
+            tuple(column[i] for column in values),
+            tuple(column[i] for column in totals),
+        )
@@ -12,7 +12,12 @@ Linux virtual filesystem (VFS) layer, including mounts, dentries, and inodes.
 import os
 from typing import Iterator, Optional, Tuple, Union, overload
 
-from drgn import IntegerLike, Object, Path, Program, container_of, sizeof
+from _drgn import (
+    _linux_helper_d_path,
+    _linux_helper_dentry_path,
+    _linux_helper_task_files,
+)
+from drgn import IntegerLike, Object, Path, Program, container_of
 from drgn.helpers import escape_ascii_string
 from drgn.helpers.linux.list import (
     hlist_empty,
@@ -156,35 +161,10 @@ def d_path(  # type: ignore  # Need positional-only arguments.
 ) -> bytes:
     if dentry is None:
         vfsmnt = path_or_vfsmnt.mnt
-        dentry = path_or_vfsmnt.dentry.read_()
+        dentry = path_or_vfsmnt.dentry
     else:
         vfsmnt = path_or_vfsmnt
-        dentry = dentry.read_()
-    mnt = container_of(vfsmnt, "struct mount", "mnt")
-
-    d_op = dentry.d_op.read_()
-    if d_op and d_op.d_dname:
-        return b"[" + dentry.d_inode.i_sb.s_type.name.string_() + b"]"
-
-    components = []
-    while True:
-        if dentry == mnt.mnt.mnt_root:
-            mnt_parent = mnt.mnt_parent.read_()
-            if mnt == mnt_parent:
-                break
-            dentry = mnt.mnt_mountpoint.read_()
-            mnt = mnt_parent
-            continue
-        d_parent = dentry.d_parent.read_()
-        if dentry == d_parent:
-            break
-        components.append(dentry.d_name.name.string_())
-        components.append(b"/")
-        dentry = d_parent
-    if components:
-        return b"".join(reversed(components))
-    else:
-        return b"/"
+    return _linux_helper_d_path(vfsmnt, dentry)
 
 
 def dentry_path(dentry: Object) -> bytes:
@@ -193,14 +173,7 @@ def dentry_path(dentry: Object) -> bytes:
 
     :param dentry: ``struct dentry *``
     """
-    components = []
-    while True:
-        d_parent = dentry.d_parent.read_()
-        if dentry == d_parent:
-            break
-        components.append(dentry.d_name.name.string_())
-        dentry = d_parent
-    return b"/".join(reversed(components))
+    return _linux_helper_dentry_path(dentry)
 
 
 def inode_path(inode: Object) -> Optional[bytes]:
@@ -336,18 +309,17 @@ def for_each_file(task: Object) -> Iterator[Tuple[int, Object]]:
     """
     Iterate over all of the files open in a given task.
 
+    The file descriptor table is read all at once when iteration starts, in
+    increasing order of file descriptor. A task without a file table (e.g., a
+    zombie) has no open files.
+
     :param task: ``struct task_struct *``
     :return: Iterator of (fd, ``struct file *``) tuples.
     """
-    fdt = task.files.fdt.read_()
-    bits_per_long = 8 * sizeof(fdt.open_fds.type_.type)
-    for i in range((fdt.max_fds.value_() + bits_per_long - 1) // bits_per_long):
-        word = fdt.open_fds[i].value_()
-        for j in range(bits_per_long):
-            if word & (1 << j):
-                fd = i * bits_per_long + j
-                file = fdt.fd[fd].read_()
-                yield fd, file
+    prog = task.prog_
+    file_type = prog.type("struct file *")
+    for fd, file in _linux_helper_task_files(task):
+        yield fd, Object(prog, file_type, value=file)
 
 
 def print_files(task: Object) -> None:
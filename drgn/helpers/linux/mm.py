@@ -11,21 +11,40 @@ implemented.
 """
 
 import operator
-from typing import Any, Iterator, List, Optional, Union, overload
+from typing import (
+    Any,
+    Dict,
+    Iterator,
+    List,
+    Optional,
+    Sequence,
+    Tuple,
+    Union,
+    overload,
+)
 
-from _drgn import _linux_helper_read_vm
-from drgn import IntegerLike, Object, Program, cast
+from _drgn import (
+    _linux_helper_build_pointer_index,
+    _linux_helper_load_pointer_index,
+    _linux_helper_read_vm,
+    _linux_helper_scan_pages,
+)
+from drgn import IntegerLike, Object, Path, Program, TypeKind, cast
 
 __all__ = (
+    "PointerIndex",
     "access_process_vm",
     "access_remote_vm",
     "cmdline",
+    "count_pages",
     "environ",
     "for_each_page",
     "page_to_pfn",
     "page_to_virt",
     "pfn_to_page",
     "pfn_to_virt",
+    "pointer_index",
+    "scan_pages",
     "virt_to_page",
     "virt_to_pfn",
 )
@@ -42,6 +61,157 @@ def for_each_page(prog: Program) -> Iterator[Object]:
         yield vmemmap + i
 
 
+_PAGE_FILTER_OPS = {"==": 0, "!=": 1, "<": 2, "<=": 3, ">": 4, ">=": 5}
+_U64_MASK = (1 << 64) - 1
+
+
+# Get the (offset, size, is_signed, mask) of a member of struct page for
+# _linux_helper_scan_pages().
+def _page_field(
+    vmemmap: Object, member: str, mask: Optional[IntegerLike] = None
+) -> Tuple[int, int, bool, int]:
+    field = Object(vmemmap.prog_, vmemmap.type_.type, address=0)
+    for name in member.split("."):
+        field = field.member_(name)
+    if field.bit_field_size_ is not None:
+        raise ValueError(f"struct page member {member!r} is a bit field")
+    type = field.type_
+    while type.kind == TypeKind.TYPEDEF:
+        type = type.type
+    if type.kind == TypeKind.ENUM:
+        is_signed = type.type.is_signed
+    elif type.kind in (TypeKind.INT, TypeKind.BOOL):
+        is_signed = type.is_signed
+    elif type.kind == TypeKind.POINTER:
+        is_signed = False
+    else:
+        raise TypeError(f"cannot scan pages by struct page member {member!r}")
+    return (
+        field.address_,
+        type.size,
+        is_signed,
+        _U64_MASK if mask is None else operator.index(mask) & _U64_MASK,
+    )
+
+
+def _page_filters(
+    vmemmap: Object,
+    flags: IntegerLike,
+    not_flags: IntegerLike,
+    where: Sequence[Tuple[str, str, IntegerLike]],
+) -> List[Tuple[Tuple[int, int, bool, int], int, int]]:
+    filters = []
+    flags = operator.index(flags)
+    not_flags = operator.index(not_flags)
+    if flags or not_flags:
+        filters.append(
+            (
+                _page_field(vmemmap, "flags", flags | not_flags),
+                _PAGE_FILTER_OPS["=="],
+                flags & _U64_MASK,
+            )
+        )
+    for member, op, value in where:
+        try:
+            op_value = _PAGE_FILTER_OPS[op]
+        except KeyError:
+            raise ValueError(f"invalid page filter operator {op!r}") from None
+        filters.append(
+            (_page_field(vmemmap, member), op_value, operator.index(value) & _U64_MASK)
+        )
+    return filters
+
+
+def scan_pages(
+    prog: Program,
+    *,
+    flags: IntegerLike = 0,
+    not_flags: IntegerLike = 0,
+    where: Sequence[Tuple[str, str, IntegerLike]] = (),
+    start_pfn: IntegerLike = 0,
+    end_pfn: Optional[IntegerLike] = None,
+) -> List[int]:
+    """
+    Find all pages matching some conditions.
+
+    Pages whose ``struct page`` can't be read (e.g., because they are in a
+    hole in the memory map) are skipped.
+
+    >>> PG_slab = prog["PG_slab"]
+    >>> len(scan_pages(prog, flags=1 << PG_slab))
+    120527
+    >>> scan_pages(
+    ...     prog, not_flags=1 << PG_slab, where=[("_refcount.counter", ">", 1000)]
+    ... )
+    [4096, 4097]
+
+    :param flags: Only match pages with all of these ``page->flags`` bits
+        set.
+    :param not_flags: Only match pages with none of these ``page->flags`` bits
+        set.
+    :param where: Only match pages where every condition is true. Each
+        condition is a tuple of a ``struct page`` member (which may be nested,
+        e.g., ``"_refcount.counter"``), a comparison operator (``"=="``,
+        ``"!="``, ``"<"``, ``"<="``, ``">"``, or ``">="``), and an integer.
+        The member must be an integer, enum, or pointer.
+    :param start_pfn: First page frame number to scan.
+    :param end_pfn: Page frame number to stop scanning at (exclusive).
+        Defaults to ``max_pfn``.
+    :return: Matching page frame numbers in increasing order. Use
+        :func:`pfn_to_page()` to get the pages.
+    """
+    vmemmap = prog["vmemmap"]
+    if end_pfn is None:
+        end_pfn = prog["max_pfn"]
+    return _linux_helper_scan_pages(
+        vmemmap, start_pfn, end_pfn, _page_filters(vmemmap, flags, not_flags, where)
+    )
+
+
+def count_pages(
+    prog: Program,
+    by: str,
+    *,
+    by_mask: Optional[IntegerLike] = None,
+    flags: IntegerLike = 0,
+    not_flags: IntegerLike = 0,
+    where: Sequence[Tuple[str, str, IntegerLike]] = (),
+    start_pfn: IntegerLike = 0,
+    end_pfn: Optional[IntegerLike] = None,
+) -> Dict[int, int]:
+    """
+    Count pages matching some conditions by the value of a ``struct page``
+    member.
+
+    This takes the same conditions as :func:`scan_pages()`.
+
+    >>> count_pages(prog, "mapping", flags=1 << prog["PG_lru"])
+    {0: 1203, 18446612682626219432: 917, ...}
+
+    :param by: ``struct page`` member to count by.
+    :param by_mask: Mask to apply to the member before counting.
+    :return: Dictionary from member value to the number of matching pages with
+        that value, in decreasing order of count.
+    """
+    vmemmap = prog["vmemmap"]
+    if end_pfn is None:
+        end_pfn = prog["max_pfn"]
+    field = _page_field(vmemmap, by, by_mask)
+    counts = _linux_helper_scan_pages(
+        vmemmap,
+        start_pfn,
+        end_pfn,
+        _page_filters(vmemmap, flags, not_flags, where),
+        field,
+    )
+    if field[2]:
+        return {
+            value - (1 << 64) if value >> 63 else value: count
+            for value, count in counts
+        }
+    return dict(counts)
+
+
 def page_to_pfn(page: Object) -> Object:
     """
     Get the page frame number (PFN) of a page.
@@ -201,6 +371,84 @@ def virt_to_page(  # type: ignore  # Need positional-only arguments.
     return pfn_to_page(virt_to_pfn(prog_or_addr, addr))  # type: ignore[arg-type]
 
 
+class PointerIndex:
+    """
+    Index of the words in kernel memory that point into the direct mapping.
+    This is returned by :func:`pointer_index()`.
+    """
+
+    def __init__(self, index: Any) -> None:
+        self._index = index
+
+    def __len__(self) -> int:
+        """Get the number of pointers in the index."""
+        return len(self._index)
+
+    def referrers(
+        self, address: IntegerLike, size: IntegerLike = 1
+    ) -> List[Tuple[int, int]]:
+        """
+        Find the words that point into a range of memory.
+
+        This is a binary search, so it is fast no matter how large the index
+        is.
+
+        :param address: Start of the range.
+        :param size: Size of the range in bytes.
+        :return: List of ``(location, value)`` tuples sorted by value and then
+            location, where ``location`` is the (direct mapping) address of
+            the word and ``value`` is the address that it points to.
+        """
+        start = operator.index(address)
+        end = min(start + operator.index(size), _U64_MASK)
+        return self._index.find(start, end)
+
+    def save(self, path: Path) -> None:
+        """
+        Save the index to a file so that it can be loaded by
+        :func:`pointer_index()` without scanning memory again.
+        """
+        self._index.save(path)
+
+
+def pointer_index(prog: Program, path: Optional[Path] = None) -> PointerIndex:
+    """
+    Get an index of every aligned word in memory that looks like a pointer into
+    the direct mapping (i.e., its value is between ``PAGE_OFFSET`` and the end
+    of the direct mapping). This can answer "what points to this object?"
+
+    Building the index reads all of physical memory in parallel, which takes a
+    while for large machines. If *path* is given and exists, the index is
+    loaded from it instead. Otherwise, the index is built and saved to *path*.
+    This makes it possible to keep the index next to a core dump. Loading an
+    index that was built from a different core dump is an error.
+
+    >>> index = pointer_index(prog, "/var/crash/vmcore.ptrx")
+    >>> task = find_task(prog, 1)
+    >>> for location, value in index.referrers(task, sizeof(task[0])):
+    ...     print(hex(location), hex(value))
+    ...
+    0xffff8e8f40b8a4b8 0xffff8e8f40a84000
+    0xffff8e8f40d71d40 0xffff8e8f40a84010
+    ...
+
+    Pointers to memory outside of the direct mapping (e.g., vmalloc or the
+    kernel image) are not indexed, and pointers stored in memory that is not
+    in the direct mapping are not found.
+
+    :param path: File to load the index from or save it to.
+    """
+    if path is not None:
+        try:
+            return PointerIndex(_linux_helper_load_pointer_index(prog, path))
+        except FileNotFoundError:
+            pass
+    index = PointerIndex(_linux_helper_build_pointer_index(prog))
+    if path is not None:
+        index.save(path)
+    return index
+
+
 def access_process_vm(task: Object, address: IntegerLike, size: IntegerLike) -> bytes:
     """
     Read memory from a task's virtual address space.
@@ -9,15 +9,17 @@ The ``drgn.helpers.linux.net`` module provides helpers for working with the
 Linux kernel networking subsystem.
 """
 
-from typing import Iterator
+from typing import Any, Dict, Iterator, List
 
-from drgn import Object
+from _drgn import _linux_helper_socket_table
+from drgn import Object, Program
 from drgn.helpers.linux.list_nulls import hlist_nulls_for_each_entry
 from drgn.helpers.linux.tcp import sk_tcpstate
 
 __all__ = (
     "sk_fullsock",
     "sk_nulls_for_each",
+    "socket_table",
 )
 
 
@@ -45,3 +47,54 @@ def sk_nulls_for_each(head: Object) -> Iterator[Object]:
         "struct sock", head, "__sk_common.skc_nulls_node"
     ):
         yield sk
+
+
+_SOCKET_TABLE_COLUMNS = (
+    "sk",
+    "family",
+    "state",
+    "saddr",
+    "sport",
+    "daddr",
+    "dport",
+    "inode",
+)
+
+
+def socket_table(prog: Program, protocol: str = "tcp") -> Dict[str, List[Any]]:
+    """
+    Get a snapshot of all of the sockets in the kernel hash tables for a
+    protocol, similar to :manpage:`netstat(8)`.
+
+    For TCP, listening sockets come first, followed by established, time-wait,
+    and request sockets.
+
+    >>> table = socket_table(prog, "tcp")
+    >>> for family, saddr, sport, state in zip(
+    ...     table["family"], table["saddr"], table["sport"], table["state"]
+    ... ):
+    ...     print(socket.inet_ntop(family, saddr), sport, state)
+    ...
+    0.0.0.0 22 10
+    :: 22 10
+    10.0.0.2 22 1
+    ...
+
+    :param protocol: ``"tcp"`` or ``"udp"``.
+    :return: Dictionary from each of the following keys to a list of its value
+        for every socket:
+
+        * ``"sk"``: Address of the ``struct sock`` (or the ``struct
+          sock_common`` of a time-wait or request socket).
+        * ``"family"``: Address family (``AF_INET`` or ``AF_INET6``).
+        * ``"state"``: TCP state (e.g., ``TCP_ESTABLISHED``). UDP sockets also
+          use these states.
+        * ``"saddr"``, ``"daddr"``: Local and remote addresses as ``bytes`` in
+          network byte order (4 bytes for ``AF_INET``, 16 for ``AF_INET6``).
+        * ``"sport"``, ``"dport"``: Local and remote ports.
+        * ``"inode"``: Inode number of the socket's file, as shown in
+          ``/proc/net/tcp``, or 0 if it doesn't have one.
+    """
+    return dict(
+        zip(_SOCKET_TABLE_COLUMNS, _linux_helper_socket_table(prog, protocol))
+    )
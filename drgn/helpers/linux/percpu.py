@@ -10,6 +10,7 @@ per-CPU allocations from :linux:`include/linux/percpu.h` and per-CPU counters
 from :linux:`include/linux/percpu_counter.h`.
 """
 
+from _drgn import _linux_helper_per_cpu_ptr
 from drgn import IntegerLike, Object
 from drgn.helpers.linux.cpumask import for_each_online_cpu
 
@@ -23,12 +24,14 @@ def per_cpu_ptr(ptr: Object, cpu: IntegerLike) -> Object:
     """
     Return the per-CPU pointer for a given CPU.
 
+    To get the value on every CPU at once, use
+    :meth:`drgn.Program.per_cpu_values()` instead.
+
     :param ptr: ``type __percpu *``
     :param cpu: CPU number.
     :return: ``type *``
     """
-    offset = ptr.prog_["__per_cpu_offset"][cpu].value_()
-    return Object(ptr.prog_, ptr.type_, value=ptr.value_() + offset)
+    return _linux_helper_per_cpu_ptr(ptr, cpu)
 
 
 def percpu_counter_sum(fbc: Object) -> int:
@@ -37,8 +40,7 @@ def percpu_counter_sum(fbc: Object) -> int:
 
     :param fbc: ``struct percpu_counter *``
     """
-    ret = fbc.count.value_()
-    ptr = fbc.counters
-    for cpu in for_each_online_cpu(fbc.prog_):
-        ret += per_cpu_ptr(ptr, cpu)[0].value_()
-    return ret
+    prog = fbc.prog_
+    return fbc.count.value_() + prog.per_cpu_sum(
+        fbc.counters, for_each_online_cpu(prog)
+    ).value_()
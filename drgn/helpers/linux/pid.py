@@ -9,12 +9,13 @@ The ``drgn.helpers.linux.pid`` module provides helpers for looking up process
 IDs and processes.
 """
 
-from typing import Iterator, Union
+from typing import Any, Dict, Iterator, List, Sequence, Tuple, Union
 
 from _drgn import (
     _linux_helper_find_pid as find_pid,
     _linux_helper_find_task as find_task,
     _linux_helper_pid_task as pid_task,
+    _linux_helper_task_table,
 )
 from drgn import NULL, Object, Program, cast, container_of
 from drgn.helpers.linux.idr import idr_find, idr_for_each
@@ -26,9 +27,17 @@ __all__ = (
     "for_each_pid",
     "for_each_task",
     "pid_task",
+    "task_table",
 )
 
 
+def _prog_and_ns(prog_or_ns: Union[Program, Object]) -> Tuple[Program, Object]:
+    if isinstance(prog_or_ns, Program):
+        return prog_or_ns, prog_or_ns["init_pid_ns"].address_of_()
+    else:
+        return prog_or_ns.prog_, prog_or_ns
+
+
 def for_each_pid(prog_or_ns: Union[Program, Object]) -> Iterator[Object]:
     """
     Iterate over all PIDs in a namespace.
@@ -37,12 +46,7 @@ def for_each_pid(prog_or_ns: Union[Program, Object]) -> Iterator[Object]:
         :class:`Program` to iterate over initial PID namespace.
     :return: Iterator of ``struct pid *`` objects.
     """
-    if isinstance(prog_or_ns, Program):
-        prog = prog_or_ns
-        ns = prog_or_ns["init_pid_ns"].address_of_()
-    else:
-        prog = prog_or_ns.prog_
-        ns = prog_or_ns
+    prog, ns = _prog_and_ns(prog_or_ns)
     if hasattr(ns, "idr"):
         for nr, entry in idr_for_each(ns.idr):
             yield cast("struct pid *", entry)
@@ -73,3 +77,43 @@ def for_each_task(prog_or_ns: Union[Program, Object]) -> Iterator[Object]:
         task = pid_task(pid, PIDTYPE_PID)
         if task:
             yield task
+
+
+def task_table(
+    prog_or_ns: Union[Program, Object], fields: Sequence[str]
+) -> Dict[str, List[Any]]:
+    """
+    Get a snapshot of some fields of all of the tasks visible in a namespace.
+
+    Unlike :func:`for_each_task()`, which finds tasks lazily, this finds every
+    task first and then reads the fields of each one natively, reading nearby
+    fields together.
+
+    >>> table = task_table(prog, ["pid", "comm", "mm->total_vm"])
+    >>> for pid, comm, total_vm in zip(
+    ...     table["pid"], table["comm"], table["mm->total_vm"]
+    ... ):
+    ...     print(pid, comm.decode(), total_vm)
+    ...
+    1 systemd 42374
+    2 kthreadd None
+    ...
+
+    :param prog_or_ns: ``struct pid_namespace *`` to get tasks from, or
+        :class:`Program` to get tasks from initial PID namespace.
+    :param fields: Members of ``struct task_struct`` to read. These may be
+        nested (e.g., ``"se.vruntime"``), follow pointers (e.g.,
+        ``"mm->rss_stat.count[0].counter"``), and index arrays. Each field
+        must be an integer, pointer, or character array.
+    :return: Dictionary from each field to a list of its value for every task
+        (an ``int``, or ``bytes`` up to the first null byte for character
+        arrays), in the same order as :func:`for_each_task()`. A value is
+        ``None`` if a pointer leading to it was ``NULL`` or could not be read.
+        The ``"task"`` key maps to the addresses of the ``struct task_struct``
+        of each task.
+    """
+    _, ns = _prog_and_ns(prog_or_ns)
+    tasks, columns = _linux_helper_task_table(ns, fields)
+    table = dict(zip(fields, columns))
+    table["task"] = tasks
+    return table
@@ -4,6 +4,7 @@
 """drgn command line interface"""
 
 import argparse
+import atexit
 import builtins
 import code
 import importlib
@@ -89,6 +90,14 @@ def main() -> None:
         help="don't load any debugging symbols that were not explicitly added with -s",
     )
 
+    parser.add_argument(
+        "--record-minicore",
+        metavar="PATH",
+        type=str,
+        help="record the memory that is read and write it to a sparse core dump "
+        "at the given path on exit; each page contains what it held when it "
+        "was first read",
+    )
     parser.add_argument(
         "-q",
         "--quiet",
@@ -107,6 +116,8 @@ def main() -> None:
     args = parser.parse_args()
 
     prog = drgn.Program()
+    if args.record_minicore is not None:
+        prog.start_recording()
     if args.core is not None:
         prog.set_core_dump(args.core)
     elif args.pid is not None:
@@ -121,12 +132,14 @@ def main() -> None:
         if not args.quiet:
             print(str(e), file=sys.stderr)
 
+    if args.record_minicore is not None:
+        atexit.register(prog.write_minicore, args.record_minicore)
+
     init_globals: Dict[str, Any] = {"prog": prog}
     if args.script:
         sys.argv = args.script
         runpy.run_path(args.script[0], init_globals=init_globals, run_name="__main__")
     else:
-        import atexit
         import readline
 
         from drgn.internal.rlcompleter import Completer
@@ -0,0 +1,1164 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <byteswap.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <gelf.h>
+#include <inttypes.h>
+#include <libelf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "btf.h"
+#include "error.h"
+#include "hash_table.h"
+#include "language.h"
+#include "program.h"
+#include "type.h"
+#include "util.h"
+
+/* Definitions from include/uapi/linux/btf.h in the Linux kernel. */
+
+#define BTF_MAGIC 0xeb9f
+#define BTF_VERSION 1
+
+struct btf_header {
+	uint16_t magic;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t hdr_len;
+	/* Offsets are relative to the end of the header. */
+	uint32_t type_off;
+	uint32_t type_len;
+	uint32_t str_off;
+	uint32_t str_len;
+};
+
+struct btf_type {
+	uint32_t name_off;
+	/*
+	 * Bits 0-15: vlen (e.g., number of struct members).
+	 * Bits 24-28: kind.
+	 * Bit 31: kind_flag.
+	 */
+	uint32_t info;
+	/*
+	 * Size for INT, ENUM, STRUCT, UNION, FLOAT, DATASEC, and ENUM64; type
+	 * ID otherwise.
+	 */
+	uint32_t size_or_type;
+};
+
+#define BTF_INFO_KIND(info) (((info) >> 24) & 0x1f)
+#define BTF_INFO_VLEN(info) ((info) & 0xffff)
+#define BTF_INFO_KFLAG(info) ((info) >> 31)
+
+enum {
+	BTF_KIND_UNKN,
+	BTF_KIND_INT,
+	BTF_KIND_PTR,
+	BTF_KIND_ARRAY,
+	BTF_KIND_STRUCT,
+	BTF_KIND_UNION,
+	BTF_KIND_ENUM,
+	BTF_KIND_FWD,
+	BTF_KIND_TYPEDEF,
+	BTF_KIND_VOLATILE,
+	BTF_KIND_CONST,
+	BTF_KIND_RESTRICT,
+	BTF_KIND_FUNC,
+	BTF_KIND_FUNC_PROTO,
+	BTF_KIND_VAR,
+	BTF_KIND_DATASEC,
+	BTF_KIND_FLOAT,
+	BTF_KIND_DECL_TAG,
+	BTF_KIND_TYPE_TAG,
+	BTF_KIND_ENUM64,
+};
+
+/* Trailing data of BTF_KIND_INT. */
+#define BTF_INT_ENCODING(val) (((val) & 0x0f000000) >> 24)
+#define BTF_INT_OFFSET(val) (((val) & 0x00ff0000) >> 16)
+#define BTF_INT_BITS(val) ((val) & 0x000000ff)
+
+#define BTF_INT_SIGNED (1 << 0)
+#define BTF_INT_CHAR (1 << 1)
+#define BTF_INT_BOOL (1 << 2)
+
+struct btf_array {
+	uint32_t type;
+	uint32_t index_type;
+	uint32_t nelems;
+};
+
+struct btf_member {
+	uint32_t name_off;
+	uint32_t type;
+	/*
+	 * If kind_flag is set: bits 0-23 are the bit offset and bits 24-31 are
+	 * the bit field size. Otherwise, this is the bit offset.
+	 */
+	uint32_t offset;
+};
+
+#define BTF_MEMBER_BITFIELD_SIZE(val) ((val) >> 24)
+#define BTF_MEMBER_BIT_OFFSET(val) ((val) & 0xffffff)
+
+struct btf_enum {
+	uint32_t name_off;
+	int32_t val;
+};
+
+struct btf_enum64 {
+	uint32_t name_off;
+	uint32_t val_lo32;
+	uint32_t val_hi32;
+};
+
+struct btf_param {
+	uint32_t name_off;
+	uint32_t type;
+};
+
+struct btf_var {
+	uint32_t linkage;
+};
+
+struct btf_var_secinfo {
+	uint32_t type;
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct btf_decl_tag {
+	int32_t component_idx;
+};
+
+/*
+ * Types with the same name are chained together through drgn_btf::next_by_name
+ * starting from the lowest type ID.
+ */
+DEFINE_HASH_MAP(drgn_btf_name_map, struct string, uint32_t, string_hash_pair,
+		string_eq)
+
+struct drgn_btf {
+	struct drgn_program *prog;
+	/* Raw BTF data. */
+	char *data;
+	/* String section. The last byte is guaranteed to be a null byte. */
+	const char *strs;
+	uint32_t str_len;
+	/* Types indexed by type ID. Index 0 (void) is NULL. */
+	const struct btf_type **types;
+	/* Number of types, not including void. */
+	uint32_t num_types;
+	/*
+	 * Types that have already been created, indexed by type ID. The type is
+	 * @c NULL if it hasn't been created yet.
+	 */
+	struct drgn_qualified_type *cache;
+	/* Name index, built on the first lookup. */
+	struct drgn_btf_name_map name_map;
+	uint32_t *next_by_name;
+	bool indexed;
+	/* Depth of drgn_btf_type() recursion, to bail out on cycles. */
+	int depth;
+};
+
+static inline const char *btf_str(struct drgn_btf *btf, uint32_t off)
+{
+	/* Offsets are validated by drgn_btf_create(). */
+	return &btf->strs[off];
+}
+
+/* Return the name of a type, or NULL if it is anonymous. */
+static inline const char *btf_type_name(struct drgn_btf *btf,
+					const struct btf_type *t)
+{
+	const char *name = btf_str(btf, t->name_off);
+	return name[0] ? name : NULL;
+}
+
+static struct drgn_error *btf_error(const char *message)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER, "invalid BTF: %s", message);
+}
+
+/*
+ * Return the size of the data following a struct btf_type, or SIZE_MAX if the
+ * kind is unknown.
+ */
+static size_t btf_type_extra_size(const struct btf_type *t)
+{
+	size_t vlen = BTF_INFO_VLEN(t->info);
+	switch (BTF_INFO_KIND(t->info)) {
+	case BTF_KIND_INT:
+		return sizeof(uint32_t);
+	case BTF_KIND_PTR:
+	case BTF_KIND_FWD:
+	case BTF_KIND_TYPEDEF:
+	case BTF_KIND_VOLATILE:
+	case BTF_KIND_CONST:
+	case BTF_KIND_RESTRICT:
+	case BTF_KIND_FUNC:
+	case BTF_KIND_FLOAT:
+	case BTF_KIND_TYPE_TAG:
+		return 0;
+	case BTF_KIND_ARRAY:
+		return sizeof(struct btf_array);
+	case BTF_KIND_STRUCT:
+	case BTF_KIND_UNION:
+		return vlen * sizeof(struct btf_member);
+	case BTF_KIND_ENUM:
+		return vlen * sizeof(struct btf_enum);
+	case BTF_KIND_FUNC_PROTO:
+		return vlen * sizeof(struct btf_param);
+	case BTF_KIND_VAR:
+		return sizeof(struct btf_var);
+	case BTF_KIND_DATASEC:
+		return vlen * sizeof(struct btf_var_secinfo);
+	case BTF_KIND_DECL_TAG:
+		return sizeof(struct btf_decl_tag);
+	case BTF_KIND_ENUM64:
+		return vlen * sizeof(struct btf_enum64);
+	default:
+		return SIZE_MAX;
+	}
+}
+
+/* Check that every string offset in a type is in bounds. */
+static bool btf_type_strings_valid(struct drgn_btf *btf,
+				   const struct btf_type *t)
+{
+	if (t->name_off >= btf->str_len)
+		return false;
+	size_t vlen = BTF_INFO_VLEN(t->info);
+	switch (BTF_INFO_KIND(t->info)) {
+	case BTF_KIND_STRUCT:
+	case BTF_KIND_UNION: {
+		const struct btf_member *members = (void *)(t + 1);
+		for (size_t i = 0; i < vlen; i++) {
+			if (members[i].name_off >= btf->str_len)
+				return false;
+		}
+		return true;
+	}
+	case BTF_KIND_ENUM: {
+		const struct btf_enum *enums = (void *)(t + 1);
+		for (size_t i = 0; i < vlen; i++) {
+			if (enums[i].name_off >= btf->str_len)
+				return false;
+		}
+		return true;
+	}
+	case BTF_KIND_ENUM64: {
+		const struct btf_enum64 *enums = (void *)(t + 1);
+		for (size_t i = 0; i < vlen; i++) {
+			if (enums[i].name_off >= btf->str_len)
+				return false;
+		}
+		return true;
+	}
+	case BTF_KIND_FUNC_PROTO: {
+		const struct btf_param *params = (void *)(t + 1);
+		for (size_t i = 0; i < vlen; i++) {
+			if (params[i].name_off >= btf->str_len)
+				return false;
+		}
+		return true;
+	}
+	default:
+		return true;
+	}
+}
+
+struct drgn_error *drgn_btf_create(struct drgn_program *prog, char *data,
+				   size_t size, struct drgn_btf **ret)
+{
+	struct drgn_error *err;
+
+	struct btf_header hdr;
+	if (size < sizeof(hdr))
+		return btf_error("header is truncated");
+	memcpy(&hdr, data, sizeof(hdr));
+	/*
+	 * BTF is in the byte order of the program that it describes. Every
+	 * field after the header is 32 bits, so the type section can be
+	 * swapped in place if necessary.
+	 */
+	bool bswap;
+	if (hdr.magic == BTF_MAGIC) {
+		bswap = false;
+	} else if (hdr.magic == bswap_16(BTF_MAGIC)) {
+		bswap = true;
+		hdr.hdr_len = bswap_32(hdr.hdr_len);
+		hdr.type_off = bswap_32(hdr.type_off);
+		hdr.type_len = bswap_32(hdr.type_len);
+		hdr.str_off = bswap_32(hdr.str_off);
+		hdr.str_len = bswap_32(hdr.str_len);
+	} else {
+		return btf_error("bad magic");
+	}
+	if (hdr.version != BTF_VERSION) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "unknown BTF version %" PRIu8,
+					 hdr.version);
+	}
+	if (hdr.hdr_len < sizeof(hdr) || hdr.hdr_len > size)
+		return btf_error("invalid header length");
+	size_t body_size = size - hdr.hdr_len;
+	if (hdr.type_off > body_size || hdr.type_len > body_size - hdr.type_off)
+		return btf_error("type section is out of bounds");
+	if (hdr.str_off > body_size || hdr.str_len > body_size - hdr.str_off)
+		return btf_error("string section is out of bounds");
+	if ((hdr.hdr_len + hdr.type_off) % sizeof(uint32_t) ||
+	    hdr.type_len % sizeof(uint32_t))
+		return btf_error("type section is misaligned");
+	if (!hdr.str_len || data[hdr.hdr_len + hdr.str_off + hdr.str_len - 1])
+		return btf_error("string section is not null-terminated");
+
+	struct drgn_btf *btf = calloc(1, sizeof(*btf));
+	if (!btf)
+		return &drgn_enomem;
+	btf->prog = prog;
+	btf->strs = data + hdr.hdr_len + hdr.str_off;
+	btf->str_len = hdr.str_len;
+	drgn_btf_name_map_init(&btf->name_map);
+
+	char *type_section = data + hdr.hdr_len + hdr.type_off;
+	if (bswap) {
+		uint32_t *words = (uint32_t *)type_section;
+		for (size_t i = 0; i < hdr.type_len / sizeof(uint32_t); i++)
+			words[i] = bswap_32(words[i]);
+	}
+
+	/*
+	 * Index 0 is void. The number of types isn't known until the whole
+	 * section is walked, so grow the array as we go.
+	 */
+	size_t capacity = 1024;
+	btf->types = malloc_array(capacity, sizeof(btf->types[0]));
+	if (!btf->types) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	btf->types[0] = NULL;
+	size_t pos = 0;
+	while (pos < hdr.type_len) {
+		const struct btf_type *t = (void *)(type_section + pos);
+		size_t extra = 0;
+		if (hdr.type_len - pos < sizeof(*t) ||
+		    (extra = btf_type_extra_size(t)) == SIZE_MAX ||
+		    extra > hdr.type_len - pos - sizeof(*t)) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"invalid BTF: type %" PRIu32 " is %s",
+						btf->num_types + 1,
+						extra == SIZE_MAX ?
+						"of unknown kind" : "truncated");
+			goto err;
+		}
+		if (!btf_type_strings_valid(btf, t)) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"invalid BTF: type %" PRIu32 " has invalid string offset",
+						btf->num_types + 1);
+			goto err;
+		}
+		if (btf->num_types + 1 == capacity) {
+			capacity *= 2;
+			const struct btf_type **tmp =
+				realloc_array(btf->types, capacity,
+					      sizeof(btf->types[0]));
+			if (!tmp) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			btf->types = tmp;
+		}
+		btf->types[++btf->num_types] = t;
+		pos += sizeof(*t) + extra;
+	}
+
+	btf->cache = calloc(btf->num_types + 1, sizeof(btf->cache[0]));
+	if (!btf->cache) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	btf->data = data;
+	*ret = btf;
+	return NULL;
+
+err:
+	free(btf->types);
+	drgn_btf_name_map_deinit(&btf->name_map);
+	free(btf);
+	return err;
+}
+
+void drgn_btf_destroy(struct drgn_btf *btf)
+{
+	if (!btf)
+		return;
+	free(btf->next_by_name);
+	drgn_btf_name_map_deinit(&btf->name_map);
+	free(btf->cache);
+	free(btf->types);
+	free(btf->data);
+	free(btf);
+}
+
+static struct drgn_error *drgn_btf_build_index(struct drgn_btf *btf)
+{
+	btf->next_by_name = calloc(btf->num_types + 1,
+				   sizeof(btf->next_by_name[0]));
+	if (!btf->next_by_name)
+		return &drgn_enomem;
+	/* Go backwards so that each chain ends up in type ID order. */
+	for (uint32_t id = btf->num_types; id > 0; id--) {
+		const struct btf_type *t = btf->types[id];
+		switch (BTF_INFO_KIND(t->info)) {
+		case BTF_KIND_INT:
+		case BTF_KIND_STRUCT:
+		case BTF_KIND_UNION:
+		case BTF_KIND_ENUM:
+		case BTF_KIND_TYPEDEF:
+		case BTF_KIND_FLOAT:
+		case BTF_KIND_ENUM64:
+			break;
+		default:
+			continue;
+		}
+		const char *name = btf_type_name(btf, t);
+		if (!name)
+			continue;
+		struct drgn_btf_name_map_entry entry = {
+			.key = { name, strlen(name) },
+			.value = id,
+		};
+		struct drgn_btf_name_map_iterator it;
+		int r = drgn_btf_name_map_insert(&btf->name_map, &entry, &it);
+		if (r < 0) {
+			drgn_btf_name_map_clear(&btf->name_map);
+			free(btf->next_by_name);
+			btf->next_by_name = NULL;
+			return &drgn_enomem;
+		} else if (r == 0) {
+			btf->next_by_name[id] = it.entry->value;
+			it.entry->value = id;
+		}
+	}
+	btf->indexed = true;
+	return NULL;
+}
+
+/* Return the first type ID with the given name, or 0 if there is none. */
+static uint32_t drgn_btf_lookup(struct drgn_btf *btf, const char *name,
+				size_t name_len)
+{
+	struct string key = { name, name_len };
+	struct drgn_btf_name_map_iterator it =
+		drgn_btf_name_map_search(&btf->name_map, &key);
+	return it.entry ? it.entry->value : 0;
+}
+
+static struct drgn_error *drgn_btf_type(struct drgn_btf *btf, uint32_t id,
+					bool can_be_incomplete_array,
+					struct drgn_qualified_type *ret);
+
+struct drgn_btf_type_thunk {
+	struct drgn_type_thunk thunk;
+	struct drgn_btf *btf;
+	uint32_t id;
+	bool can_be_incomplete_array;
+};
+
+static struct drgn_error *
+drgn_btf_type_thunk_evaluate_fn(struct drgn_type_thunk *thunk,
+				struct drgn_qualified_type *ret)
+{
+	struct drgn_btf_type_thunk *t =
+		container_of(thunk, struct drgn_btf_type_thunk, thunk);
+	return drgn_btf_type(t->btf, t->id, t->can_be_incomplete_array, ret);
+}
+
+static void drgn_btf_type_thunk_free_fn(struct drgn_type_thunk *thunk)
+{
+	free(container_of(thunk, struct drgn_btf_type_thunk, thunk));
+}
+
+static struct drgn_error *drgn_lazy_type_from_btf(struct drgn_btf *btf,
+						  uint32_t id,
+						  bool can_be_incomplete_array,
+						  struct drgn_lazy_type *ret)
+{
+	struct drgn_btf_type_thunk *thunk = malloc(sizeof(*thunk));
+	if (!thunk)
+		return &drgn_enomem;
+	thunk->thunk.prog = btf->prog;
+	thunk->thunk.evaluate_fn = drgn_btf_type_thunk_evaluate_fn;
+	thunk->thunk.free_fn = drgn_btf_type_thunk_free_fn;
+	thunk->btf = btf;
+	thunk->id = id;
+	thunk->can_be_incomplete_array = can_be_incomplete_array;
+	drgn_lazy_type_init_thunk(ret, &thunk->thunk);
+	return NULL;
+}
+
+static struct drgn_error *drgn_btf_int_type(struct drgn_btf *btf,
+					    const struct btf_type *t,
+					    struct drgn_type **ret)
+{
+	const char *name = btf_type_name(btf, t);
+	if (!name)
+		return btf_error("BTF_KIND_INT has no name");
+	uint32_t encoding = *(const uint32_t *)(t + 1);
+	if (BTF_INT_ENCODING(encoding) & BTF_INT_BOOL) {
+		return drgn_bool_type_create(btf->prog, name, t->size_or_type,
+					     &drgn_language_c, ret);
+	}
+	return drgn_int_type_create(btf->prog, name, t->size_or_type,
+				    BTF_INT_ENCODING(encoding) & BTF_INT_SIGNED,
+				    &drgn_language_c, ret);
+}
+
+static struct drgn_error *drgn_btf_compound_type(struct drgn_btf *btf,
+						 const struct btf_type *t,
+						 struct drgn_type **ret)
+{
+	struct drgn_error *err;
+
+	enum drgn_type_kind kind =
+		BTF_INFO_KIND(t->info) == BTF_KIND_STRUCT ?
+		DRGN_TYPE_STRUCT : DRGN_TYPE_UNION;
+	bool kind_flag = BTF_INFO_KFLAG(t->info);
+	size_t vlen = BTF_INFO_VLEN(t->info);
+	const struct btf_member *members = (void *)(t + 1);
+
+	struct drgn_compound_type_builder builder;
+	drgn_compound_type_builder_init(&builder, btf->prog, kind);
+	for (size_t i = 0; i < vlen; i++) {
+		uint64_t bit_offset, bit_field_size;
+		if (kind_flag) {
+			bit_offset = BTF_MEMBER_BIT_OFFSET(members[i].offset);
+			bit_field_size =
+				BTF_MEMBER_BITFIELD_SIZE(members[i].offset);
+		} else {
+			/*
+			 * Without kind_flag, bit fields are encoded in the
+			 * member's integer type.
+			 */
+			bit_offset = members[i].offset;
+			bit_field_size = 0;
+			if (members[i].type <= btf->num_types) {
+				const struct btf_type *member_type =
+					btf->types[members[i].type];
+				if (member_type &&
+				    BTF_INFO_KIND(member_type->info) == BTF_KIND_INT) {
+					uint32_t encoding =
+						*(const uint32_t *)(member_type + 1);
+					uint64_t bits = BTF_INT_BITS(encoding);
+					if (BTF_INT_OFFSET(encoding) ||
+					    bits != 8 * (uint64_t)member_type->size_or_type) {
+						bit_offset += BTF_INT_OFFSET(encoding);
+						bit_field_size = bits;
+					}
+				}
+			}
+		}
+
+		/*
+		 * Like GCC, BTF can't distinguish between zero-length and
+		 * incomplete arrays. Only the last member of a structure can be
+		 * an incomplete array.
+		 */
+		struct drgn_lazy_type member_type;
+		err = drgn_lazy_type_from_btf(btf, members[i].type,
+					      kind == DRGN_TYPE_STRUCT &&
+					      i == vlen - 1,
+					      &member_type);
+		if (err)
+			goto err;
+		const char *name = btf_str(btf, members[i].name_off);
+		err = drgn_compound_type_builder_add_member(&builder,
+							    member_type,
+							    name[0] ? name : NULL,
+							    bit_offset,
+							    bit_field_size);
+		if (err) {
+			drgn_lazy_type_deinit(&member_type);
+			goto err;
+		}
+	}
+	err = drgn_compound_type_create(&builder, btf_type_name(btf, t),
+					t->size_or_type, &drgn_language_c, ret);
+	if (err)
+		goto err;
+	return NULL;
+
+err:
+	drgn_compound_type_builder_deinit(&builder);
+	return err;
+}
+
+static struct drgn_error *drgn_btf_enum_type(struct drgn_btf *btf,
+					     const struct btf_type *t,
+					     struct drgn_type **ret)
+{
+	struct drgn_error *err;
+
+	const char *tag = btf_type_name(btf, t);
+	size_t vlen = BTF_INFO_VLEN(t->info);
+	/* An enum without enumerators is a forward declaration. */
+	if (!vlen) {
+		return drgn_incomplete_enum_type_create(btf->prog, tag,
+							&drgn_language_c, ret);
+	}
+
+	/*
+	 * kind_flag indicates a signed enum since Linux 6.0. Before that, the
+	 * values were always signed 32-bit integers, so guess from whether any
+	 * of them are negative.
+	 */
+	bool is_64 = BTF_INFO_KIND(t->info) == BTF_KIND_ENUM64;
+	const struct btf_enum *enums = (void *)(t + 1);
+	const struct btf_enum64 *enums64 = (void *)(t + 1);
+	bool is_signed = BTF_INFO_KFLAG(t->info);
+	if (!is_signed && !is_64) {
+		for (size_t i = 0; i < vlen; i++) {
+			if (enums[i].val < 0) {
+				is_signed = true;
+				break;
+			}
+		}
+	}
+
+	struct drgn_enum_type_builder builder;
+	drgn_enum_type_builder_init(&builder, btf->prog);
+	for (size_t i = 0; i < vlen; i++) {
+		const char *name;
+		uint64_t value;
+		if (is_64) {
+			name = btf_str(btf, enums64[i].name_off);
+			value = ((uint64_t)enums64[i].val_hi32 << 32) |
+				enums64[i].val_lo32;
+		} else {
+			name = btf_str(btf, enums[i].name_off);
+			value = is_signed ? (uint64_t)(int64_t)enums[i].val :
+				(uint32_t)enums[i].val;
+		}
+		if (is_signed) {
+			err = drgn_enum_type_builder_add_signed(&builder, name,
+								value);
+		} else {
+			err = drgn_enum_type_builder_add_unsigned(&builder,
+								  name, value);
+		}
+		if (err)
+			goto err;
+	}
+
+	/* BTF doesn't record the compatible type. */
+	struct drgn_type *compatible_type;
+	err = drgn_int_type_create(btf->prog, "<unknown>", t->size_or_type,
+				   is_signed, &drgn_language_c,
+				   &compatible_type);
+	if (err)
+		goto err;
+	err = drgn_enum_type_create(&builder, tag, compatible_type,
+				    &drgn_language_c, ret);
+	if (err)
+		goto err;
+	return NULL;
+
+err:
+	drgn_enum_type_builder_deinit(&builder);
+	return err;
+}
+
+static struct drgn_error *drgn_btf_function_type(struct drgn_btf *btf,
+						 const struct btf_type *t,
+						 struct drgn_type **ret)
+{
+	struct drgn_error *err;
+
+	struct drgn_qualified_type return_type;
+	err = drgn_btf_type(btf, t->size_or_type, true, &return_type);
+	if (err)
+		return err;
+
+	size_t vlen = BTF_INFO_VLEN(t->info);
+	const struct btf_param *params = (void *)(t + 1);
+	/* A variadic function has a final parameter with no name or type. */
+	bool is_variadic = vlen && !params[vlen - 1].type &&
+			   !params[vlen - 1].name_off;
+	if (is_variadic)
+		vlen--;
+
+	struct drgn_function_type_builder builder;
+	drgn_function_type_builder_init(&builder, btf->prog);
+	for (size_t i = 0; i < vlen; i++) {
+		struct drgn_lazy_type param_type;
+		err = drgn_lazy_type_from_btf(btf, params[i].type, true,
+					      &param_type);
+		if (err)
+			goto err;
+		const char *name = btf_str(btf, params[i].name_off);
+		err = drgn_function_type_builder_add_parameter(&builder,
+							       param_type,
+							       name[0] ? name : NULL);
+		if (err) {
+			drgn_lazy_type_deinit(&param_type);
+			goto err;
+		}
+	}
+	err = drgn_function_type_create(&builder, return_type, is_variadic,
+					&drgn_language_c, ret);
+	if (err)
+		goto err;
+	return NULL;
+
+err:
+	drgn_function_type_builder_deinit(&builder);
+	return err;
+}
+
+/*
+ * Find the complete definition of a structure or union declared by
+ * BTF_KIND_FWD. Returns 0 if there isn't exactly one.
+ */
+static uint32_t drgn_btf_find_complete(struct drgn_btf *btf, int btf_kind,
+				       const char *name)
+{
+	if (!btf->indexed && drgn_btf_build_index(btf)) {
+		/* Out of memory; just use the incomplete type. */
+		return 0;
+	}
+	uint32_t found = 0;
+	for (uint32_t id = drgn_btf_lookup(btf, name, strlen(name)); id;
+	     id = btf->next_by_name[id]) {
+		if (BTF_INFO_KIND(btf->types[id]->info) == btf_kind) {
+			if (found)
+				return 0;
+			found = id;
+		}
+	}
+	return found;
+}
+
+static struct drgn_error *
+drgn_btf_type_impl(struct drgn_btf *btf, uint32_t id,
+		   struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	const struct btf_type *t = btf->types[id];
+
+	ret->qualifiers = 0;
+	switch (BTF_INFO_KIND(t->info)) {
+	case BTF_KIND_INT:
+		return drgn_btf_int_type(btf, t, &ret->type);
+	case BTF_KIND_PTR: {
+		struct drgn_qualified_type referenced_type;
+		err = drgn_btf_type(btf, t->size_or_type, true,
+				    &referenced_type);
+		if (err)
+			return err;
+		uint8_t word_size;
+		err = drgn_program_word_size(btf->prog, &word_size);
+		if (err)
+			return err;
+		return drgn_pointer_type_create(btf->prog, referenced_type,
+						word_size, &drgn_language_c,
+						&ret->type);
+	}
+	case BTF_KIND_ARRAY: {
+		const struct btf_array *array = (void *)(t + 1);
+		struct drgn_qualified_type element_type;
+		err = drgn_btf_type(btf, array->type, false, &element_type);
+		if (err)
+			return err;
+		if (array->nelems) {
+			return drgn_array_type_create(btf->prog, element_type,
+						      array->nelems,
+						      &drgn_language_c,
+						      &ret->type);
+		}
+		return drgn_incomplete_array_type_create(btf->prog,
+							 element_type,
+							 &drgn_language_c,
+							 &ret->type);
+	}
+	case BTF_KIND_STRUCT:
+	case BTF_KIND_UNION:
+		return drgn_btf_compound_type(btf, t, &ret->type);
+	case BTF_KIND_ENUM:
+	case BTF_KIND_ENUM64:
+		return drgn_btf_enum_type(btf, t, &ret->type);
+	case BTF_KIND_FWD: {
+		int btf_kind = BTF_INFO_KFLAG(t->info) ?
+			       BTF_KIND_UNION : BTF_KIND_STRUCT;
+		const char *tag = btf_type_name(btf, t);
+		uint32_t complete_id = tag ?
+				       drgn_btf_find_complete(btf, btf_kind, tag) :
+				       0;
+		if (complete_id)
+			return drgn_btf_type(btf, complete_id, true, ret);
+		return drgn_incomplete_compound_type_create(btf->prog,
+							    btf_kind == BTF_KIND_UNION ?
+							    DRGN_TYPE_UNION :
+							    DRGN_TYPE_STRUCT,
+							    tag,
+							    &drgn_language_c,
+							    &ret->type);
+	}
+	case BTF_KIND_TYPEDEF: {
+		const char *name = btf_type_name(btf, t);
+		if (!name)
+			return btf_error("BTF_KIND_TYPEDEF has no name");
+		struct drgn_qualified_type aliased_type;
+		err = drgn_btf_type(btf, t->size_or_type, true, &aliased_type);
+		if (err)
+			return err;
+		return drgn_typedef_type_create(btf->prog, name, aliased_type,
+						&drgn_language_c, &ret->type);
+	}
+	case BTF_KIND_VOLATILE:
+	case BTF_KIND_CONST:
+	case BTF_KIND_RESTRICT:
+	case BTF_KIND_TYPE_TAG: {
+		err = drgn_btf_type(btf, t->size_or_type, true, ret);
+		if (err)
+			return err;
+		if (BTF_INFO_KIND(t->info) == BTF_KIND_VOLATILE)
+			ret->qualifiers |= DRGN_QUALIFIER_VOLATILE;
+		else if (BTF_INFO_KIND(t->info) == BTF_KIND_CONST)
+			ret->qualifiers |= DRGN_QUALIFIER_CONST;
+		else if (BTF_INFO_KIND(t->info) == BTF_KIND_RESTRICT)
+			ret->qualifiers |= DRGN_QUALIFIER_RESTRICT;
+		return NULL;
+	}
+	case BTF_KIND_FUNC_PROTO:
+		return drgn_btf_function_type(btf, t, &ret->type);
+	case BTF_KIND_FLOAT: {
+		const char *name = btf_type_name(btf, t);
+		if (!name)
+			return btf_error("BTF_KIND_FLOAT has no name");
+		return drgn_float_type_create(btf->prog, name, t->size_or_type,
+					      &drgn_language_c, &ret->type);
+	}
+	default:
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "BTF type %" PRIu32 " is not a type",
+					 id);
+	}
+}
+
+/*
+ * Get the drgn type for a BTF type ID, creating it if it hasn't been created
+ * yet.
+ *
+ * @param[in] can_be_incomplete_array Whether the type can be an incomplete
+ * array type. If this is @c false and BTF describes an array with no elements,
+ * a zero-length array type is returned instead. See @ref
+ * drgn_type_from_dwarf_internal().
+ */
+static struct drgn_error *drgn_btf_type(struct drgn_btf *btf, uint32_t id,
+					bool can_be_incomplete_array,
+					struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+
+	if (id == 0) {
+		ret->type = drgn_void_type(btf->prog, &drgn_language_c);
+		ret->qualifiers = 0;
+		return NULL;
+	}
+	if (id > btf->num_types) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "invalid BTF type ID %" PRIu32, id);
+	}
+
+	if (!btf->cache[id].type) {
+		/* A chain of non-lazy references this long must be a cycle. */
+		if (btf->depth >= 1000) {
+			return drgn_error_create(DRGN_ERROR_RECURSION,
+						 "maximum BTF type depth exceeded");
+		}
+		btf->depth++;
+		err = drgn_btf_type_impl(btf, id, &btf->cache[id]);
+		btf->depth--;
+		if (err) {
+			btf->cache[id].type = NULL;
+			return err;
+		}
+	}
+	*ret = btf->cache[id];
+
+	if (!can_be_incomplete_array &&
+	    drgn_type_kind(ret->type) == DRGN_TYPE_ARRAY &&
+	    !drgn_type_is_complete(ret->type)) {
+		return drgn_array_type_create(btf->prog,
+					      drgn_type_type(ret->type),
+					      0, &drgn_language_c,
+					      &ret->type);
+	}
+	return NULL;
+}
+
+struct drgn_error *drgn_btf_find_type(enum drgn_type_kind kind,
+				      const char *name, size_t name_len,
+				      const char *filename, void *arg,
+				      struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	struct drgn_btf *btf = arg;
+
+	/* BTF doesn't record where types are defined. */
+	if (filename)
+		return &drgn_not_found;
+
+	int btf_kind;
+	switch (kind) {
+	case DRGN_TYPE_INT:
+	case DRGN_TYPE_BOOL:
+		btf_kind = BTF_KIND_INT;
+		break;
+	case DRGN_TYPE_FLOAT:
+		btf_kind = BTF_KIND_FLOAT;
+		break;
+	case DRGN_TYPE_STRUCT:
+		btf_kind = BTF_KIND_STRUCT;
+		break;
+	case DRGN_TYPE_UNION:
+		btf_kind = BTF_KIND_UNION;
+		break;
+	case DRGN_TYPE_ENUM:
+		btf_kind = BTF_KIND_ENUM;
+		break;
+	case DRGN_TYPE_TYPEDEF:
+		btf_kind = BTF_KIND_TYPEDEF;
+		break;
+	default:
+		return &drgn_not_found;
+	}
+
+	if (!btf->indexed) {
+		err = drgn_btf_build_index(btf);
+		if (err)
+			return err;
+	}
+
+	/* Prefer a complete enum over a forward declaration. */
+	uint32_t incomplete_id = 0;
+	for (uint32_t id = drgn_btf_lookup(btf, name, name_len); id;
+	     id = btf->next_by_name[id]) {
+		const struct btf_type *t = btf->types[id];
+		int id_kind = BTF_INFO_KIND(t->info);
+		if (id_kind == BTF_KIND_ENUM64)
+			id_kind = BTF_KIND_ENUM;
+		if (id_kind != btf_kind)
+			continue;
+		if (btf_kind == BTF_KIND_INT) {
+			/* Skip bit field types. */
+			uint32_t encoding = *(const uint32_t *)(t + 1);
+			if (BTF_INT_OFFSET(encoding) ||
+			    BTF_INT_BITS(encoding) != 8 * (uint64_t)t->size_or_type)
+				continue;
+			bool is_bool = BTF_INT_ENCODING(encoding) & BTF_INT_BOOL;
+			if (is_bool != (kind == DRGN_TYPE_BOOL))
+				continue;
+		} else if (btf_kind == BTF_KIND_ENUM &&
+			   !BTF_INFO_VLEN(t->info)) {
+			if (!incomplete_id)
+				incomplete_id = id;
+			continue;
+		}
+		return drgn_btf_type(btf, id, true, ret);
+	}
+	if (incomplete_id)
+		return drgn_btf_type(btf, incomplete_id, true, ret);
+	return &drgn_not_found;
+}
+
+/* Read the raw BTF from a file, which may be raw BTF or an ELF file. */
+static struct drgn_error *read_btf_file(const char *path, char **data_ret,
+					size_t *size_ret)
+{
+	struct drgn_error *err;
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+
+	char ident[SELFMAG];
+	ssize_t r = pread(fd, ident, sizeof(ident), 0);
+	if (r == SELFMAG && memcmp(ident, ELFMAG, SELFMAG) == 0) {
+		elf_version(EV_CURRENT);
+		Elf *elf = elf_begin(fd, ELF_C_READ_MMAP, NULL);
+		if (!elf) {
+			err = drgn_error_libelf();
+			goto out_fd;
+		}
+		size_t shstrndx;
+		if (elf_getshdrstrndx(elf, &shstrndx)) {
+			err = drgn_error_libelf();
+			goto out_elf;
+		}
+		Elf_Scn *scn = NULL;
+		while ((scn = elf_nextscn(elf, scn))) {
+			GElf_Shdr shdr_mem, *shdr = gelf_getshdr(scn, &shdr_mem);
+			if (!shdr) {
+				err = drgn_error_libelf();
+				goto out_elf;
+			}
+			const char *scnname = elf_strptr(elf, shstrndx,
+							 shdr->sh_name);
+			if (scnname && strcmp(scnname, ".BTF") == 0)
+				break;
+		}
+		if (!scn) {
+			err = drgn_error_format(DRGN_ERROR_MISSING_DEBUG_INFO,
+						"%s: no .BTF section", path);
+			goto out_elf;
+		}
+		Elf_Data *elf_data = elf_rawdata(scn, NULL);
+		if (!elf_data) {
+			err = drgn_error_libelf();
+			goto out_elf;
+		}
+		char *data = malloc(elf_data->d_size ? elf_data->d_size : 1);
+		if (!data) {
+			err = &drgn_enomem;
+			goto out_elf;
+		}
+		memcpy(data, elf_data->d_buf, elf_data->d_size);
+		*data_ret = data;
+		*size_ret = elf_data->d_size;
+		err = NULL;
+out_elf:
+		elf_end(elf);
+		goto out_fd;
+	}
+
+	/*
+	 * Sysfs doesn't always report the size of /sys/kernel/btf/vmlinux
+	 * correctly, so read until EOF.
+	 */
+	size_t capacity = 1 << 20, size = 0;
+	char *data = malloc(capacity);
+	if (!data) {
+		err = &drgn_enomem;
+		goto out_fd;
+	}
+	for (;;) {
+		if (size == capacity) {
+			capacity *= 2;
+			char *tmp = realloc(data, capacity);
+			if (!tmp) {
+				free(data);
+				err = &drgn_enomem;
+				goto out_fd;
+			}
+			data = tmp;
+		}
+		r = pread(fd, data + size, capacity - size, size);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			err = drgn_error_create_os("read", errno, path);
+			free(data);
+			goto out_fd;
+		} else if (r == 0) {
+			break;
+		}
+		size += r;
+	}
+	*data_ret = data;
+	*size_ret = size;
+	err = NULL;
+out_fd:
+	close(fd);
+	return err;
+}
+
+/* Read the kernel's BTF from memory between __start_BTF and __stop_BTF. */
+static struct drgn_error *read_btf_from_memory(struct drgn_program *prog,
+					       char **data_ret,
+					       size_t *size_ret)
+{
+	struct drgn_error *err;
+
+	struct drgn_symbol *sym;
+	err = drgn_program_find_symbol_by_name(prog, "__start_BTF", &sym);
+	if (err)
+		return err;
+	uint64_t start = drgn_symbol_address(sym);
+	drgn_symbol_destroy(sym);
+	err = drgn_program_find_symbol_by_name(prog, "__stop_BTF", &sym);
+	if (err)
+		return err;
+	uint64_t end = drgn_symbol_address(sym);
+	drgn_symbol_destroy(sym);
+	/* vmlinux BTF is a few megabytes; anything huge is bogus. */
+	if (end <= start || end - start > (UINT64_C(1) << 30)) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "invalid kernel BTF symbols");
+	}
+
+	char *data = malloc64(end - start);
+	if (!data)
+		return &drgn_enomem;
+	err = drgn_program_read_memory(prog, data, start, end - start, false);
+	if (err) {
+		free(data);
+		return err;
+	}
+	*data_ret = data;
+	*size_ret = end - start;
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_load_btf(struct drgn_program *prog, const char *path)
+{
+	struct drgn_error *err;
+
+	if (prog->btf) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "BTF was already loaded");
+	}
+
+	char *data;
+	size_t size;
+	if (path) {
+		err = read_btf_file(path, &data, &size);
+	} else if (!(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL)) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "BTF can only be found automatically for the Linux kernel");
+	} else if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
+		err = read_btf_file("/sys/kernel/btf/vmlinux", &data, &size);
+		if (err) {
+			/* Older kernels don't have it; try memory instead. */
+			drgn_error_destroy(err);
+			err = read_btf_from_memory(prog, &data, &size);
+		}
+	} else {
+		err = read_btf_from_memory(prog, &data, &size);
+	}
+	if (err)
+		return err;
+
+	struct drgn_btf *btf;
+	err = drgn_btf_create(prog, data, size, &btf);
+	if (err) {
+		free(data);
+		return err;
+	}
+	err = drgn_program_add_type_finder(prog, drgn_btf_find_type, btf);
+	if (err) {
+		drgn_btf_destroy(btf);
+		return err;
+	}
+	prog->btf = btf;
+	return NULL;
+}
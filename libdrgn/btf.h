@@ -0,0 +1,65 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * BPF Type Format.
+ *
+ * See @ref BTF.
+ */
+
+#ifndef DRGN_BTF_H
+#define DRGN_BTF_H
+
+#include <stddef.h>
+
+#include "drgn.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup BTF BPF Type Format
+ *
+ * Type finder using BPF Type Format (BTF).
+ *
+ * The Linux kernel can embed a compact description of its types in the @c .BTF
+ * section of vmlinux, which is also available at runtime in
+ * <tt>/sys/kernel/btf/vmlinux</tt> and in kernel memory. It is much smaller
+ * than DWARF and doesn't need to be indexed up front, so it can be used to get
+ * types quickly when DWARF isn't available or hasn't been loaded.
+ *
+ * The BTF data is parsed when it is loaded, but the index of type names is only
+ * built on the first lookup, and @ref drgn_type "drgn types" are only created
+ * for the BTF types that are actually used. BTF doesn't describe source files,
+ * so lookups that specify a filename never match.
+ *
+ * @{
+ */
+
+struct drgn_btf;
+
+/**
+ * Create a @ref drgn_btf from raw BTF data.
+ *
+ * @param[in] data BTF data. On success, this is owned by the returned @ref
+ * drgn_btf. It must have been allocated with @c malloc().
+ * @param[in] size Size of @p data in bytes.
+ * @param[out] ret Returned BTF, which should be destroyed with @ref
+ * drgn_btf_destroy().
+ */
+struct drgn_error *drgn_btf_create(struct drgn_program *prog, char *data,
+				   size_t size, struct drgn_btf **ret);
+
+/** Destroy a @ref drgn_btf. */
+void drgn_btf_destroy(struct drgn_btf *btf);
+
+/** @ref drgn_type_find_fn() that finds types in a @ref drgn_btf. */
+struct drgn_error *drgn_btf_find_type(enum drgn_type_kind kind,
+				      const char *name, size_t name_len,
+				      const char *filename, void *arg,
+				      struct drgn_qualified_type *ret);
+
+/** @} */
+
+#endif /* DRGN_BTF_H */
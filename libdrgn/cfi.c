@@ -0,0 +1,903 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <dwarf.h>
+#include <elf.h>
+#include <elfutils/libdw.h>
+#include <elfutils/libdwfl.h>
+#include <gelf.h>
+#include <inttypes.h>
+#include <libelf.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary_buffer.h"
+#include "cfi.h"
+#include "debug_info.h"
+#include "error.h"
+#include "platform.h"
+#include "program.h"
+#include "util.h"
+#include "vector.h"
+
+DEFINE_VECTOR(drgn_cfi_cie_vector, struct drgn_cfi_cie)
+DEFINE_VECTOR(drgn_cfi_fde_vector, struct drgn_cfi_fde)
+DEFINE_VECTOR(drgn_cfi_offset_vector, uint64_t)
+DEFINE_VECTOR(drgn_cfi_row_vector, struct drgn_cfi_row)
+
+void drgn_cfi_deinit(struct drgn_cfi *cfi)
+{
+	free(cfi->fdes);
+	free(cfi->cies);
+}
+
+struct drgn_cfi_buffer {
+	struct binary_buffer bb;
+	struct drgn_debug_info_module *module;
+	const struct drgn_cfi *cfi;
+};
+
+static struct drgn_error *drgn_cfi_buffer_error(struct binary_buffer *bb,
+						const char *pos,
+						const char *message)
+{
+	struct drgn_cfi_buffer *buffer =
+		container_of(bb, struct drgn_cfi_buffer, bb);
+	const char *name = dwfl_module_info(buffer->module->dwfl_module, NULL,
+					    NULL, NULL, NULL, NULL, NULL, NULL);
+	return drgn_error_format(DRGN_ERROR_OTHER, "%s: %s+%#tx: %s", name,
+				 buffer->cfi->is_eh ? ".eh_frame" : ".debug_frame",
+				 pos - buffer->cfi->section_data, message);
+}
+
+static void drgn_cfi_buffer_init(struct drgn_cfi_buffer *buffer,
+				 struct drgn_debug_info_module *module,
+				 const struct drgn_cfi *cfi, const char *buf,
+				 size_t len)
+{
+	binary_buffer_init(&buffer->bb, buf, len, cfi->little_endian,
+			   drgn_cfi_buffer_error);
+	buffer->module = module;
+	buffer->cfi = cfi;
+}
+
+/*
+ * Read an address encoded with a DW_EH_PE_* encoding. For .debug_frame,
+ * addresses are always DW_EH_PE_absptr. The bias is not applied.
+ */
+static struct drgn_error *drgn_cfi_next_encoded(struct drgn_cfi_buffer *buffer,
+						uint8_t encoding,
+						uint64_t *ret)
+{
+	struct drgn_error *err;
+	struct binary_buffer *bb = &buffer->bb;
+	const struct drgn_cfi *cfi = buffer->cfi;
+	const char *pos = bb->pos;
+
+	/* Not currently used for CFI, but it doesn't hurt. */
+	if (encoding == DW_EH_PE_omit) {
+		*ret = 0;
+		return NULL;
+	}
+
+	uint64_t value;
+	switch (encoding & 0xf) {
+	case DW_EH_PE_absptr:
+		if (cfi->address_size == 8) {
+			err = binary_buffer_next_u64(bb, &value);
+		} else {
+			err = binary_buffer_next_u32_into_u64(bb, &value);
+		}
+		break;
+	case DW_EH_PE_uleb128:
+		err = binary_buffer_next_uleb128(bb, &value);
+		break;
+	case DW_EH_PE_udata2:
+		err = binary_buffer_next_u16_into_u64(bb, &value);
+		break;
+	case DW_EH_PE_udata4:
+		err = binary_buffer_next_u32_into_u64(bb, &value);
+		break;
+	case DW_EH_PE_udata8:
+		err = binary_buffer_next_u64(bb, &value);
+		break;
+	case DW_EH_PE_sleb128: {
+		int64_t svalue;
+		err = binary_buffer_next_sleb128(bb, &svalue);
+		value = svalue;
+		break;
+	}
+	case DW_EH_PE_sdata2: {
+		uint16_t tmp;
+		err = binary_buffer_next_u16(bb, &tmp);
+		value = (int16_t)tmp;
+		break;
+	}
+	case DW_EH_PE_sdata4: {
+		uint32_t tmp;
+		err = binary_buffer_next_u32(bb, &tmp);
+		value = (int32_t)tmp;
+		break;
+	}
+	case DW_EH_PE_sdata8:
+		err = binary_buffer_next_u64(bb, &value);
+		break;
+	default:
+		return binary_buffer_error_at(bb, pos,
+					      "unknown pointer encoding %#x",
+					      encoding);
+	}
+	if (err)
+		return err;
+
+	switch (encoding & 0x70) {
+	case DW_EH_PE_absptr:
+		break;
+	case DW_EH_PE_pcrel:
+		value += cfi->section_address + (pos - cfi->section_data);
+		break;
+	default:
+		return binary_buffer_error_at(bb, pos,
+					      "unsupported pointer encoding %#x",
+					      encoding);
+	}
+	if (encoding & DW_EH_PE_indirect) {
+		return binary_buffer_error_at(bb, pos,
+					      "unsupported pointer encoding %#x",
+					      encoding);
+	}
+	if (cfi->address_size < 8)
+		value &= (UINT64_C(1) << (8 * cfi->address_size)) - 1;
+	*ret = value;
+	return NULL;
+}
+
+/*
+ * Get the next entry in a CFI section. On return, the buffer position is after
+ * the CIE ID or CIE pointer. *entry_ret is set to NULL if there are no more
+ * entries.
+ */
+static struct drgn_error *drgn_cfi_next_entry(struct drgn_cfi_buffer *buffer,
+					      const char **entry_ret,
+					      const char **end_ret,
+					      bool *is_cie_ret,
+					      uint64_t *cie_offset_ret)
+{
+	struct drgn_error *err;
+	struct binary_buffer *bb = &buffer->bb;
+	const struct drgn_cfi *cfi = buffer->cfi;
+
+	*entry_ret = NULL;
+	if (!binary_buffer_has_next(bb))
+		return NULL;
+	const char *entry = bb->pos;
+	uint32_t tmp;
+	if ((err = binary_buffer_next_u32(bb, &tmp)))
+		return err;
+	bool is_64_bit = tmp == UINT32_C(0xffffffff);
+	uint64_t length;
+	if (is_64_bit) {
+		if ((err = binary_buffer_next_u64(bb, &length)))
+			return err;
+	} else {
+		length = tmp;
+	}
+	/* A zero length terminates .eh_frame. */
+	if (cfi->is_eh && length == 0)
+		return NULL;
+	if (length > bb->end - bb->pos) {
+		return binary_buffer_error(bb,
+					   "entry length is out of bounds");
+	}
+	const char *end = bb->pos + length;
+
+	const char *id_pos = bb->pos;
+	uint64_t id;
+	if (is_64_bit) {
+		if ((err = binary_buffer_next_u64(bb, &id)))
+			return err;
+	} else {
+		if ((err = binary_buffer_next_u32_into_u64(bb, &id)))
+			return err;
+	}
+	if (cfi->is_eh) {
+		/* In .eh_frame, the CIE pointer is relative to itself. */
+		*is_cie_ret = id == 0;
+		if (!*is_cie_ret) {
+			if (id > id_pos - cfi->section_data) {
+				return binary_buffer_error(bb,
+							   "CIE pointer is out of bounds");
+			}
+			*cie_offset_ret = (id_pos - cfi->section_data) - id;
+		}
+	} else {
+		*is_cie_ret = id == (is_64_bit ? UINT64_MAX : UINT32_MAX);
+		*cie_offset_ret = id;
+	}
+	*entry_ret = entry;
+	*end_ret = end;
+	return NULL;
+}
+
+static struct drgn_error *drgn_cfi_parse_cie(struct drgn_cfi_buffer *buffer,
+					     struct drgn_cfi_cie *cie)
+{
+	struct drgn_error *err;
+	struct binary_buffer *bb = &buffer->bb;
+	const struct drgn_cfi *cfi = buffer->cfi;
+
+	uint8_t version;
+	if ((err = binary_buffer_next_u8(bb, &version)))
+		return err;
+	if (version != 1 && version != 3 && (version != 4 || cfi->is_eh)) {
+		return binary_buffer_error(bb, "unknown CIE version %" PRIu8,
+					   version);
+	}
+	const char *augmentation;
+	size_t augmentation_len;
+	if ((err = binary_buffer_next_string(bb, &augmentation,
+					     &augmentation_len)))
+		return err;
+	if (version >= 4) {
+		uint8_t address_size, segment_selector_size;
+		if ((err = binary_buffer_next_u8(bb, &address_size)))
+			return err;
+		if (address_size != cfi->address_size) {
+			return binary_buffer_error(bb,
+						   "unsupported address size %" PRIu8,
+						   address_size);
+		}
+		if ((err = binary_buffer_next_u8(bb, &segment_selector_size)))
+			return err;
+		if (segment_selector_size) {
+			return binary_buffer_error(bb,
+						   "unsupported segment selector size %" PRIu8,
+						   segment_selector_size);
+		}
+	}
+	/* Old versions of GCC emitted an "eh" augmentation with a pointer. */
+	if (strcmp(augmentation, "eh") == 0 &&
+	    (err = binary_buffer_skip(bb, cfi->address_size)))
+		return err;
+	if ((err = binary_buffer_next_uleb128(bb,
+					      &cie->code_alignment_factor)) ||
+	    (err = binary_buffer_next_sleb128(bb,
+					      &cie->data_alignment_factor)))
+		return err;
+	if (version == 1) {
+		if ((err = binary_buffer_next_u8_into_u64(bb,
+							  &cie->return_address_register)))
+			return err;
+	} else if ((err = binary_buffer_next_uleb128(bb,
+						     &cie->return_address_register))) {
+		return err;
+	}
+
+	cie->address_encoding = DW_EH_PE_absptr;
+	cie->have_augmentation_length = augmentation[0] == 'z';
+	cie->signal_frame = false;
+	if (cie->have_augmentation_length) {
+		uint64_t augmentation_length;
+		if ((err = binary_buffer_next_uleb128(bb,
+						      &augmentation_length)))
+			return err;
+		if (augmentation_length > bb->end - bb->pos) {
+			return binary_buffer_error(bb,
+						   "augmentation length is out of bounds");
+		}
+		const char *augmentation_end = bb->pos + augmentation_length;
+		for (size_t i = 1; i < augmentation_len; i++) {
+			uint8_t encoding;
+			uint64_t personality;
+			switch (augmentation[i]) {
+			case 'L':
+				/* Language-specific data area encoding. */
+				if ((err = binary_buffer_skip(bb, 1)))
+					return err;
+				break;
+			case 'P':
+				if ((err = binary_buffer_next_u8(bb,
+								 &encoding)) ||
+				    (err = drgn_cfi_next_encoded(buffer,
+								 encoding & 0x7f,
+								 &personality)))
+					return err;
+				break;
+			case 'R':
+				if ((err = binary_buffer_next_u8(bb,
+								 &cie->address_encoding)))
+					return err;
+				break;
+			case 'S':
+				cie->signal_frame = true;
+				break;
+			default:
+				/*
+				 * We don't know how to interpret the rest of
+				 * the augmentation data, but we know how long
+				 * it is.
+				 */
+				goto skip_augmentation;
+			}
+		}
+skip_augmentation:
+		bb->pos = augmentation_end;
+	} else if (augmentation[0] && strcmp(augmentation, "eh") != 0) {
+		return binary_buffer_error(bb, "unknown CIE augmentation '%s'",
+					   augmentation);
+	}
+	cie->initial_instructions = bb->pos;
+	cie->initial_instructions_size = bb->end - bb->pos;
+	return NULL;
+}
+
+static struct drgn_error *drgn_cfi_parse_fde(struct drgn_cfi_buffer *buffer,
+					     const struct drgn_cfi_cie *cie,
+					     struct drgn_cfi_fde *fde)
+{
+	struct drgn_error *err;
+	struct binary_buffer *bb = &buffer->bb;
+
+	if ((err = drgn_cfi_next_encoded(buffer, cie->address_encoding,
+					 &fde->initial_location)) ||
+	    (err = drgn_cfi_next_encoded(buffer, cie->address_encoding & 0xf,
+					 &fde->address_range)))
+		return err;
+	fde->initial_location += buffer->cfi->bias;
+	if (cie->have_augmentation_length) {
+		uint64_t augmentation_length;
+		if ((err = binary_buffer_next_uleb128(bb,
+						      &augmentation_length)))
+			return err;
+		if (augmentation_length > bb->end - bb->pos) {
+			return binary_buffer_error(bb,
+						   "augmentation length is out of bounds");
+		}
+		bb->pos += augmentation_length;
+	}
+	fde->instructions = bb->pos;
+	fde->instructions_size = bb->end - bb->pos;
+	return NULL;
+}
+
+static int drgn_cfi_fde_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_cfi_fde *a = _a, *b = _b;
+	if (a->initial_location != b->initial_location)
+		return a->initial_location < b->initial_location ? -1 : 1;
+	return 0;
+}
+
+/* Parse all of the CIEs and FDEs in a CFI section. */
+static struct drgn_error *drgn_cfi_parse(struct drgn_debug_info_module *module,
+					 struct drgn_cfi *cfi, size_t size)
+{
+	struct drgn_error *err;
+	struct drgn_cfi_buffer buffer;
+	struct drgn_cfi_cie_vector cies = VECTOR_INIT;
+	struct drgn_cfi_offset_vector cie_offsets = VECTOR_INIT;
+	struct drgn_cfi_fde_vector fdes = VECTOR_INIT;
+	const char *entry, *end;
+	bool is_cie;
+	uint64_t cie_offset;
+
+	/*
+	 * CIEs can be anywhere in the section, so parse all of the CIEs
+	 * first. They are in order of their offsets, so the FDEs can find
+	 * their CIE with a binary search.
+	 */
+	drgn_cfi_buffer_init(&buffer, module, cfi, cfi->section_data, size);
+	for (;;) {
+		if ((err = drgn_cfi_next_entry(&buffer, &entry, &end, &is_cie,
+					       &cie_offset)))
+			goto err;
+		if (!entry)
+			break;
+		if (is_cie) {
+			struct drgn_cfi_cie *cie =
+				drgn_cfi_cie_vector_append_entry(&cies);
+			if (!cie ||
+			    !drgn_cfi_offset_vector_append(&cie_offsets,
+							   &(uint64_t){ entry - cfi->section_data })) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			const char *section_end = buffer.bb.end;
+			buffer.bb.end = end;
+			err = drgn_cfi_parse_cie(&buffer, cie);
+			buffer.bb.end = section_end;
+			if (err)
+				goto err;
+		}
+		buffer.bb.pos = end;
+	}
+
+	drgn_cfi_buffer_init(&buffer, module, cfi, cfi->section_data, size);
+	for (;;) {
+		if ((err = drgn_cfi_next_entry(&buffer, &entry, &end, &is_cie,
+					       &cie_offset)))
+			goto err;
+		if (!entry)
+			break;
+		if (!is_cie) {
+			size_t lo = 0, hi = cie_offsets.size;
+			while (lo < hi) {
+				size_t mid = lo + (hi - lo) / 2;
+				if (cie_offsets.data[mid] < cie_offset)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo >= cie_offsets.size ||
+			    cie_offsets.data[lo] != cie_offset) {
+				err = binary_buffer_error(&buffer.bb,
+							  "FDE CIE pointer is invalid");
+				goto err;
+			}
+			struct drgn_cfi_fde fde = { .cie = lo };
+			const char *section_end = buffer.bb.end;
+			buffer.bb.end = end;
+			err = drgn_cfi_parse_fde(&buffer, &cies.data[lo], &fde);
+			buffer.bb.end = section_end;
+			if (err)
+				goto err;
+			/* Ignore empty FDEs (e.g., for discarded functions). */
+			if (fde.address_range &&
+			    !drgn_cfi_fde_vector_append(&fdes, &fde)) {
+				err = &drgn_enomem;
+				goto err;
+			}
+		}
+		buffer.bb.pos = end;
+	}
+	drgn_cfi_offset_vector_deinit(&cie_offsets);
+
+	qsort(fdes.data, fdes.size, sizeof(fdes.data[0]), drgn_cfi_fde_cmp);
+	drgn_cfi_cie_vector_shrink_to_fit(&cies);
+	drgn_cfi_fde_vector_shrink_to_fit(&fdes);
+	cfi->cies = cies.data;
+	cfi->fdes = fdes.data;
+	cfi->num_fdes = fdes.size;
+	return NULL;
+
+err:
+	drgn_cfi_fde_vector_deinit(&fdes);
+	drgn_cfi_offset_vector_deinit(&cie_offsets);
+	drgn_cfi_cie_vector_deinit(&cies);
+	return err;
+}
+
+/* Find and parse a CFI section in an ELF file if it exists. */
+static struct drgn_error *drgn_cfi_parse_section(struct drgn_debug_info_module *module,
+						 Elf *elf, uint64_t bias,
+						 const char *name, bool is_eh,
+						 struct drgn_cfi *cfi)
+{
+	struct drgn_error *err;
+
+	size_t shstrndx;
+	if (elf_getshdrstrndx(elf, &shstrndx))
+		return drgn_error_libelf();
+	Elf_Scn *scn = NULL;
+	GElf_Shdr shdr_mem, *shdr;
+	for (;;) {
+		scn = elf_nextscn(elf, scn);
+		if (!scn)
+			return NULL;
+		shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr)
+			return drgn_error_libelf();
+		/* The section may be empty in a separate debug file. */
+		if (shdr->sh_type == SHT_NOBITS)
+			continue;
+		const char *scnname = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (scnname && strcmp(scnname, name) == 0)
+			break;
+	}
+
+	Elf_Data *data;
+	err = read_elf_section(scn, &data);
+	if (err)
+		return err;
+	if (!data->d_size)
+		return NULL;
+
+	const unsigned char *ident = (const unsigned char *)elf_getident(elf,
+									 NULL);
+	struct drgn_cfi tmp = {
+		.bias = bias,
+		.section_address = shdr->sh_addr,
+		.section_data = data->d_buf,
+		.address_size = ident[EI_CLASS] == ELFCLASS64 ? 8 : 4,
+		.is_eh = is_eh,
+		.little_endian = ident[EI_DATA] == ELFDATA2LSB,
+	};
+	err = drgn_cfi_parse(module, &tmp, data->d_size);
+	if (err)
+		return err;
+	*cfi = tmp;
+	return NULL;
+}
+
+struct drgn_error *
+drgn_debug_info_module_parse_cfi(struct drgn_debug_info_module *module)
+{
+	struct drgn_error *err;
+
+	if (module->cfi_parsed)
+		return NULL;
+	if (module->state != DRGN_DEBUG_INFO_MODULE_INDEXED)
+		goto out;
+
+	Dwarf_Addr bias;
+	Dwarf *dwarf = dwfl_module_getdwarf(module->dwfl_module, &bias);
+	if (!dwarf)
+		goto out;
+	Elf *elf = dwarf_getelf(dwarf);
+	if (!elf)
+		goto out;
+	GElf_Ehdr ehdr_mem, *ehdr = gelf_getehdr(elf, &ehdr_mem);
+	if (!ehdr)
+		return drgn_error_libelf();
+
+	/*
+	 * .eh_frame is in the loaded file rather than the debug file. We only
+	 * relocate debugging sections, so we can't use .eh_frame from a
+	 * relocatable file (but those usually only have .debug_frame anyways).
+	 */
+	struct drgn_cfi eh_frame = {};
+	if (ehdr->e_type != ET_REL) {
+		Dwarf_Addr main_bias;
+		Elf *main_elf = dwfl_module_getelf(module->dwfl_module,
+						   &main_bias);
+		if (main_elf) {
+			err = drgn_cfi_parse_section(module, main_elf,
+						     main_bias, ".eh_frame",
+						     true, &eh_frame);
+			if (err)
+				return err;
+		}
+	}
+	err = drgn_cfi_parse_section(module, elf, bias, ".debug_frame", false,
+				     &module->debug_frame);
+	if (err) {
+		drgn_cfi_deinit(&eh_frame);
+		return err;
+	}
+	module->eh_frame = eh_frame;
+out:
+	module->cfi_parsed = true;
+	return NULL;
+}
+
+/* Find the FDE containing a program counter. */
+static const struct drgn_cfi_fde *drgn_cfi_find_fde(const struct drgn_cfi *cfi,
+						    uint64_t pc)
+{
+	/* Find the last FDE with an initial location less than or equal to pc. */
+	size_t lo = 0, hi = cfi->num_fdes, found = SIZE_MAX;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (cfi->fdes[mid].initial_location <= pc) {
+			found = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (found == SIZE_MAX ||
+	    pc - cfi->fdes[found].initial_location >=
+	    cfi->fdes[found].address_range)
+		return NULL;
+	return &cfi->fdes[found];
+}
+
+static inline void drgn_cfi_row_set(struct drgn_cfi_row *row, uint64_t regno,
+				    const struct drgn_cfi_rule *rule)
+{
+	if (regno < DRGN_MAX_REGISTERS)
+		row->regs[regno] = *rule;
+}
+
+/*
+ * Execute call frame instructions until the row for pc is found.
+ *
+ * @param[in] initial_row Row that DW_CFA_restore restores rules from.
+ */
+static struct drgn_error *
+drgn_cfi_execute(struct drgn_cfi_buffer *buffer,
+		 const struct drgn_cfi_cie *cie,
+		 const struct drgn_cfi_row *initial_row, uint64_t location,
+		 uint64_t pc, struct drgn_cfi_row *row)
+{
+	struct drgn_error *err;
+	struct binary_buffer *bb = &buffer->bb;
+	struct drgn_cfi_row_vector state_stack = VECTOR_INIT;
+	uint8_t opcode;
+
+	while (binary_buffer_has_next(bb)) {
+		if ((err = binary_buffer_next_u8(bb, &opcode)))
+			goto out;
+
+		uint64_t regno, delta, uoffset;
+		int64_t soffset;
+		struct drgn_cfi_rule rule = {};
+		switch (opcode & 0xc0) {
+		case DW_CFA_advance_loc:
+			delta = (opcode & 0x3f) * cie->code_alignment_factor;
+			goto advance_loc;
+		case DW_CFA_offset:
+			regno = opcode & 0x3f;
+			if ((err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			soffset = (int64_t)uoffset * cie->data_alignment_factor;
+			goto at_cfa_plus_offset;
+		case DW_CFA_restore:
+			regno = opcode & 0x3f;
+			goto restore;
+		default:
+			break;
+		}
+
+		switch (opcode) {
+		case DW_CFA_nop:
+			break;
+		case DW_CFA_set_loc:
+			if ((err = drgn_cfi_next_encoded(buffer,
+							 cie->address_encoding,
+							 &location)))
+				goto out;
+			location += buffer->cfi->bias;
+			if (location > pc)
+				goto out;
+			break;
+		case DW_CFA_advance_loc1:
+			if ((err = binary_buffer_next_u8_into_u64(bb, &delta)))
+				goto out;
+			delta *= cie->code_alignment_factor;
+			goto advance_loc;
+		case DW_CFA_advance_loc2:
+			if ((err = binary_buffer_next_u16_into_u64(bb, &delta)))
+				goto out;
+			delta *= cie->code_alignment_factor;
+			goto advance_loc;
+		case DW_CFA_advance_loc4:
+			if ((err = binary_buffer_next_u32_into_u64(bb, &delta)))
+				goto out;
+			delta *= cie->code_alignment_factor;
+advance_loc:
+			if (__builtin_add_overflow(location, delta, &location) ||
+			    location > pc)
+				goto out;
+			break;
+		case DW_CFA_offset_extended:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			soffset = (int64_t)uoffset * cie->data_alignment_factor;
+			goto at_cfa_plus_offset;
+		case DW_CFA_offset_extended_sf:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_sleb128(bb, &soffset)))
+				goto out;
+			soffset *= cie->data_alignment_factor;
+			goto at_cfa_plus_offset;
+		case DW_CFA_GNU_negative_offset_extended:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			soffset = -((int64_t)uoffset *
+				    cie->data_alignment_factor);
+at_cfa_plus_offset:
+			rule.kind = DRGN_CFI_RULE_AT_CFA_PLUS_OFFSET;
+			rule.offset = soffset;
+			drgn_cfi_row_set(row, regno, &rule);
+			break;
+		case DW_CFA_val_offset:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			soffset = (int64_t)uoffset * cie->data_alignment_factor;
+			goto cfa_plus_offset;
+		case DW_CFA_val_offset_sf:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_sleb128(bb, &soffset)))
+				goto out;
+			soffset *= cie->data_alignment_factor;
+cfa_plus_offset:
+			rule.kind = DRGN_CFI_RULE_CFA_PLUS_OFFSET;
+			rule.offset = soffset;
+			drgn_cfi_row_set(row, regno, &rule);
+			break;
+		case DW_CFA_restore_extended:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)))
+				goto out;
+restore:
+			if (regno < DRGN_MAX_REGISTERS)
+				row->regs[regno] = initial_row->regs[regno];
+			break;
+		case DW_CFA_undefined:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)))
+				goto out;
+			rule.kind = DRGN_CFI_RULE_UNDEFINED;
+			drgn_cfi_row_set(row, regno, &rule);
+			break;
+		case DW_CFA_same_value:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)))
+				goto out;
+			rule.kind = DRGN_CFI_RULE_SAME_VALUE;
+			drgn_cfi_row_set(row, regno, &rule);
+			break;
+		case DW_CFA_register:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_uleb128(bb, &rule.regno)))
+				goto out;
+			rule.kind = DRGN_CFI_RULE_REGISTER_PLUS_OFFSET;
+			drgn_cfi_row_set(row, regno, &rule);
+			break;
+		case DW_CFA_remember_state:
+			/* Like GCC and libdw, this includes the CFA rule. */
+			if (!drgn_cfi_row_vector_append(&state_stack, row)) {
+				err = &drgn_enomem;
+				goto out;
+			}
+			break;
+		case DW_CFA_restore_state:
+			if (!state_stack.size) {
+				err = binary_buffer_error(bb,
+							  "DW_CFA_restore_state with empty state stack");
+				goto out;
+			}
+			*row = *drgn_cfi_row_vector_pop(&state_stack);
+			break;
+		case DW_CFA_def_cfa:
+			if ((err = binary_buffer_next_uleb128(bb,
+							      &row->cfa.regno)) ||
+			    (err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			row->cfa.kind = DRGN_CFI_RULE_REGISTER_PLUS_OFFSET;
+			row->cfa.offset = uoffset;
+			break;
+		case DW_CFA_def_cfa_sf:
+			if ((err = binary_buffer_next_uleb128(bb,
+							      &row->cfa.regno)) ||
+			    (err = binary_buffer_next_sleb128(bb, &soffset)))
+				goto out;
+			row->cfa.kind = DRGN_CFI_RULE_REGISTER_PLUS_OFFSET;
+			row->cfa.offset = soffset * cie->data_alignment_factor;
+			break;
+		case DW_CFA_def_cfa_register:
+			if ((err = binary_buffer_next_uleb128(bb,
+							      &row->cfa.regno)))
+				goto out;
+			if (row->cfa.kind != DRGN_CFI_RULE_REGISTER_PLUS_OFFSET)
+				goto invalid_cfa_rule;
+			break;
+		case DW_CFA_def_cfa_offset:
+			if ((err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			if (row->cfa.kind != DRGN_CFI_RULE_REGISTER_PLUS_OFFSET)
+				goto invalid_cfa_rule;
+			row->cfa.offset = uoffset;
+			break;
+		case DW_CFA_def_cfa_offset_sf:
+			if ((err = binary_buffer_next_sleb128(bb, &soffset)))
+				goto out;
+			if (row->cfa.kind != DRGN_CFI_RULE_REGISTER_PLUS_OFFSET)
+				goto invalid_cfa_rule;
+			row->cfa.offset = soffset * cie->data_alignment_factor;
+			break;
+		case DW_CFA_def_cfa_expression:
+			if ((err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			if (uoffset > bb->end - bb->pos) {
+				err = binary_buffer_error(bb,
+							  "expression is out of bounds");
+				goto out;
+			}
+			row->cfa.kind = DRGN_CFI_RULE_DWARF_EXPRESSION;
+			row->cfa.expr = bb->pos;
+			row->cfa.expr_size = uoffset;
+			bb->pos += uoffset;
+			break;
+		case DW_CFA_expression:
+		case DW_CFA_val_expression:
+			if ((err = binary_buffer_next_uleb128(bb, &regno)) ||
+			    (err = binary_buffer_next_uleb128(bb, &uoffset)))
+				goto out;
+			if (uoffset > bb->end - bb->pos) {
+				err = binary_buffer_error(bb,
+							  "expression is out of bounds");
+				goto out;
+			}
+			rule.kind = (opcode == DW_CFA_expression ?
+				     DRGN_CFI_RULE_AT_DWARF_EXPRESSION :
+				     DRGN_CFI_RULE_DWARF_EXPRESSION);
+			rule.expr = bb->pos;
+			rule.expr_size = uoffset;
+			bb->pos += uoffset;
+			drgn_cfi_row_set(row, regno, &rule);
+			break;
+		case DW_CFA_GNU_args_size:
+			if ((err = binary_buffer_skip_leb128(bb)))
+				goto out;
+			break;
+		default:
+			err = binary_buffer_error(bb,
+						  "unknown call frame instruction %#" PRIx8,
+						  opcode);
+			goto out;
+		}
+	}
+	err = NULL;
+out:
+	drgn_cfi_row_vector_deinit(&state_stack);
+	return err;
+
+invalid_cfa_rule:
+	err = binary_buffer_error(bb,
+				  "call frame instruction %#" PRIx8 " is incompatible with CFA rule",
+				  opcode);
+	goto out;
+}
+
+/* Rules for architectures without default rules: everything is undefined. */
+static const struct drgn_cfi_row drgn_empty_cfi_row;
+
+struct drgn_error *
+drgn_debug_info_module_find_cfi(struct drgn_program *prog,
+				struct drgn_debug_info_module *module,
+				uint64_t pc, struct drgn_cfi_row *row_ret,
+				bool *interrupted_ret,
+				uint64_t *ret_addr_regno_ret, bool *found_ret)
+{
+	struct drgn_error *err;
+
+	err = drgn_debug_info_module_parse_cfi(module);
+	if (err)
+		return err;
+
+	const struct drgn_cfi *cfis[] = { &module->eh_frame,
+					  &module->debug_frame };
+	for (size_t i = 0; i < ARRAY_SIZE(cfis); i++) {
+		const struct drgn_cfi *cfi = cfis[i];
+		const struct drgn_cfi_fde *fde = drgn_cfi_find_fde(cfi, pc);
+		if (!fde)
+			continue;
+		const struct drgn_cfi_cie *cie = &cfi->cies[fde->cie];
+
+		/*
+		 * The CIE's initial instructions are applied on top of the
+		 * architecture's default rules, and the result is the initial
+		 * row for the FDE's instructions.
+		 */
+		const struct drgn_cfi_row *default_row =
+			prog->platform.arch->default_cfi_row;
+		if (!default_row)
+			default_row = &drgn_empty_cfi_row;
+		struct drgn_cfi_row initial_row = *default_row;
+		struct drgn_cfi_buffer buffer;
+		drgn_cfi_buffer_init(&buffer, module, cfi,
+				     cie->initial_instructions,
+				     cie->initial_instructions_size);
+		err = drgn_cfi_execute(&buffer, cie, default_row,
+				       fde->initial_location, UINT64_MAX,
+				       &initial_row);
+		if (err)
+			return err;
+
+		*row_ret = initial_row;
+		drgn_cfi_buffer_init(&buffer, module, cfi, fde->instructions,
+				     fde->instructions_size);
+		err = drgn_cfi_execute(&buffer, cie, &initial_row,
+				       fde->initial_location, pc, row_ret);
+		if (err)
+			return err;
+		*interrupted_ret = cie->signal_frame;
+		*ret_addr_regno_ret = cie->return_address_register;
+		*found_ret = true;
+		return NULL;
+	}
+	*found_ret = false;
+	return NULL;
+}
@@ -0,0 +1,177 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * DWARF call frame information.
+ *
+ * See @ref CallFrameInformation.
+ */
+
+#ifndef DRGN_CFI_H
+#define DRGN_CFI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "register_state.h"
+
+struct drgn_debug_info_module;
+struct drgn_program;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup CallFrameInformation Call frame information
+ *
+ * DWARF call frame information (CFI) from @c .eh_frame and @c .debug_frame.
+ *
+ * The Frame Description Entries (FDEs) and Common Information Entries (CIEs)
+ * of a module are parsed the first time that they are needed and cached in the
+ * @ref drgn_debug_info_module, with the FDEs sorted by address so that the FDE
+ * for a program counter can be found with a binary search. The call frame
+ * instructions are only executed for the FDE that is being looked up.
+ *
+ * @{
+ */
+
+/** Kind of a @ref drgn_cfi_rule. */
+enum drgn_cfi_rule_kind {
+	/** The value can't be recovered. */
+	DRGN_CFI_RULE_UNDEFINED,
+	/** The value is the same as in the callee. */
+	DRGN_CFI_RULE_SAME_VALUE,
+	/** The value is saved at the CFA plus an offset. */
+	DRGN_CFI_RULE_AT_CFA_PLUS_OFFSET,
+	/** The value is the CFA plus an offset. */
+	DRGN_CFI_RULE_CFA_PLUS_OFFSET,
+	/** The value is another register in the callee plus an offset. */
+	DRGN_CFI_RULE_REGISTER_PLUS_OFFSET,
+	/**
+	 * The value is saved at the address computed by a DWARF expression
+	 * (with the CFA pushed on the stack).
+	 */
+	DRGN_CFI_RULE_AT_DWARF_EXPRESSION,
+	/**
+	 * The value is computed by a DWARF expression (with the CFA pushed on
+	 * the stack, except for the CFA itself).
+	 */
+	DRGN_CFI_RULE_DWARF_EXPRESSION,
+};
+
+/** Rule for recovering a register value (or the CFA) in the caller. */
+struct drgn_cfi_rule {
+	enum drgn_cfi_rule_kind kind;
+	/** Register for @ref DRGN_CFI_RULE_REGISTER_PLUS_OFFSET. */
+	uint64_t regno;
+	/** Offset for the @c *_PLUS_OFFSET kinds. */
+	int64_t offset;
+	/** DWARF expression for the @c *_DWARF_EXPRESSION kinds. */
+	const char *expr;
+	/** Size of @ref expr in bytes. */
+	size_t expr_size;
+};
+
+/** Rules for the Canonical Frame Address and every tracked register. */
+struct drgn_cfi_row {
+	/**
+	 * Rule for the CFA. This is either @ref
+	 * DRGN_CFI_RULE_REGISTER_PLUS_OFFSET, @ref
+	 * DRGN_CFI_RULE_DWARF_EXPRESSION, or @ref DRGN_CFI_RULE_UNDEFINED if
+	 * the CFA hasn't been defined.
+	 */
+	struct drgn_cfi_rule cfa;
+	/** Rule for each register, indexed by DWARF register number. */
+	struct drgn_cfi_rule regs[DRGN_MAX_REGISTERS];
+};
+
+/** Parsed Common Information Entry. */
+struct drgn_cfi_cie {
+	uint64_t code_alignment_factor;
+	int64_t data_alignment_factor;
+	uint64_t return_address_register;
+	/** Initial instructions. */
+	const char *initial_instructions;
+	size_t initial_instructions_size;
+	/** Encoding of addresses in FDEs (a @c DW_EH_PE_* value). */
+	uint8_t address_encoding;
+	/** Whether FDEs have augmentation data that must be skipped. */
+	bool have_augmentation_length;
+	/** Whether the CIE has the @c S augmentation (signal frame). */
+	bool signal_frame;
+};
+
+/** Parsed Frame Description Entry. */
+struct drgn_cfi_fde {
+	/** First address covered by the FDE (with @ref drgn_cfi::bias applied). */
+	uint64_t initial_location;
+	uint64_t address_range;
+	/** Index of the FDE's CIE in @ref drgn_cfi::cies. */
+	size_t cie;
+	const char *instructions;
+	size_t instructions_size;
+};
+
+/** Call frame information from one section of a module. */
+struct drgn_cfi {
+	/** Parsed CIEs. */
+	struct drgn_cfi_cie *cies;
+	/** Parsed FDEs sorted by @ref drgn_cfi_fde::initial_location. */
+	struct drgn_cfi_fde *fdes;
+	size_t num_fdes;
+	/** Difference between load addresses and addresses in the file. */
+	uint64_t bias;
+	/** Address of the section in the file. */
+	uint64_t section_address;
+	/** Start of the section data. */
+	const char *section_data;
+	/** Address size in bytes. */
+	uint8_t address_size;
+	/** Whether this is @c .eh_frame rather than @c .debug_frame. */
+	bool is_eh;
+	bool little_endian;
+};
+
+/** Free the parsed entries in a @ref drgn_cfi. */
+void drgn_cfi_deinit(struct drgn_cfi *cfi);
+
+/**
+ * Parse the call frame information of a @ref drgn_debug_info_module if it
+ * hasn't been parsed yet.
+ *
+ * This uses libdwfl, so it is not thread-safe. Once it has succeeded, @ref
+ * drgn_debug_info_module_find_cfi() only reads the parsed tables and may be
+ * called from multiple threads.
+ */
+struct drgn_error *
+drgn_debug_info_module_parse_cfi(struct drgn_debug_info_module *module);
+
+/**
+ * Find the rules for unwinding from a program counter in a @ref
+ * drgn_debug_info_module.
+ *
+ * The module's CFI is parsed if it hasn't been parsed yet. @c .eh_frame is
+ * preferred over @c .debug_frame.
+ *
+ * @param[in] pc Program counter to find the rules for. If the frame's program
+ * counter is a return address, this should be the return address minus one.
+ * @param[out] row_ret Returned rules.
+ * @param[out] interrupted_ret Returned whether the caller was interrupted
+ * (i.e., the FDE is for a signal frame).
+ * @param[out] ret_addr_regno_ret Returned register number that contains the
+ * return address.
+ * @param[out] found_ret Returned whether the module has CFI for @p pc. If this
+ * is @c false, the other returned values are undefined.
+ */
+struct drgn_error *
+drgn_debug_info_module_find_cfi(struct drgn_program *prog,
+				struct drgn_debug_info_module *module,
+				uint64_t pc, struct drgn_cfi_row *row_ret,
+				bool *interrupted_ret,
+				uint64_t *ret_addr_regno_ret, bool *found_ret);
+
+/** @} */
+
+#endif /* DRGN_CFI_H */
@@ -110,6 +110,17 @@ DEFINE_HASH_TABLE_FUNCTIONS(drgn_debug_info_module_table,
 DEFINE_HASH_TABLE_FUNCTIONS(c_string_set, c_string_key_hash_pair,
 			    c_string_key_eq)
 
+DEFINE_VECTOR_FUNCTIONS(drgn_symbol_vector)
+
+static void drgn_debug_info_free_symbols(struct drgn_debug_info *dbinfo)
+{
+	drgn_symbol_name_index_deinit(&dbinfo->global_symbols);
+	drgn_symbol_name_index_init(&dbinfo->global_symbols);
+	dbinfo->symbols_indexed = false;
+	dbinfo->symbols_bad_symtabs = false;
+	memset(dbinfo->symbol_cache, 0, sizeof(dbinfo->symbol_cache));
+}
+
 /**
  * @c Dwfl_Callbacks::find_elf() implementation.
  *
@@ -221,6 +232,11 @@ static void
 drgn_debug_info_module_destroy(struct drgn_debug_info_module *module)
 {
 	if (module) {
+		drgn_cfi_deinit(&module->debug_frame);
+		drgn_cfi_deinit(&module->eh_frame);
+		free(module->orc_entries);
+		free(module->orc_pcs);
+		drgn_symbol_vector_deinit(&module->address_symbols);
 		drgn_error_destroy(module->err);
 		elf_end(module->elf);
 		if (module->fd != -1)
@@ -284,6 +300,9 @@ static int drgn_dwfl_module_removed(Dwfl_Module *dwfl_module, void *userdatap,
 static void drgn_debug_info_free_modules(struct drgn_debug_info *dbinfo,
 					 bool finish_indexing, bool free_all)
 {
+	/* Modules may be removed, so the symbol names may become invalid. */
+	drgn_debug_info_free_symbols(dbinfo);
+
 	for (struct drgn_debug_info_module_table_iterator it =
 	     drgn_debug_info_module_table_first(&dbinfo->modules); it.entry; ) {
 		struct drgn_debug_info_module *module = *it.entry;
@@ -462,6 +481,14 @@ drgn_debug_info_report_module(struct drgn_debug_info_load_state *load,
 	module->elf = elf;
 	module->err = NULL;
 	module->next = NULL;
+	drgn_symbol_vector_init(&module->address_symbols);
+	module->orc_pcs = NULL;
+	module->orc_entries = NULL;
+	module->num_orc_entries = 0;
+	module->orc_parsed = false;
+	memset(&module->eh_frame, 0, sizeof(module->eh_frame));
+	memset(&module->debug_frame, 0, sizeof(module->debug_frame));
+	module->cfi_parsed = false;
 
 	/* path_key, fd and elf are owned by the module now. */
 
@@ -889,6 +916,103 @@ drgn_get_debug_sections(struct drgn_debug_info_module *module)
 	return NULL;
 }
 
+struct drgn_address_symbol {
+	struct drgn_symbol sym;
+	/* Global is preferred over weak, which is preferred over local. */
+	int binding_rank;
+	/* Index in the symbol table, to make the sort stable. */
+	int index;
+};
+
+DEFINE_VECTOR(drgn_address_symbol_vector, struct drgn_address_symbol)
+
+static int drgn_address_symbol_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_address_symbol *a = _a, *b = _b;
+	if (a->sym.address != b->sym.address)
+		return a->sym.address < b->sym.address ? -1 : 1;
+	if (a->binding_rank != b->binding_rank)
+		return b->binding_rank - a->binding_rank;
+	if (a->sym.size != b->sym.size)
+		return a->sym.size < b->sym.size ? -1 : 1;
+	return a->index - b->index;
+}
+
+/*
+ * Build drgn_debug_info_module::address_symbols. The symbols considered are the
+ * same as dwfl_module_addrinfo(): named, defined symbols other than sections,
+ * files, and TLS symbols. Symbols without a size are left to libdwfl.
+ */
+static struct drgn_error *
+drgn_debug_info_module_index_addresses(struct drgn_debug_info_module *module)
+{
+	int symtab_len = dwfl_module_getsymtab(module->dwfl_module);
+	if (symtab_len <= 0)
+		return NULL;
+
+	struct drgn_address_symbol_vector candidates = VECTOR_INIT;
+	for (int i = 1; i < symtab_len; i++) {
+		GElf_Sym elf_sym;
+		GElf_Addr elf_addr;
+		const char *name =
+			dwfl_module_getsym_info(module->dwfl_module, i,
+						&elf_sym, &elf_addr, NULL, NULL,
+						NULL);
+		if (!name || !name[0] || elf_sym.st_shndx == SHN_UNDEF ||
+		    !elf_sym.st_size)
+			continue;
+		switch (GELF_ST_TYPE(elf_sym.st_info)) {
+		case STT_SECTION:
+		case STT_FILE:
+		case STT_TLS:
+			continue;
+		default:
+			break;
+		}
+		struct drgn_address_symbol *candidate =
+			drgn_address_symbol_vector_append_entry(&candidates);
+		if (!candidate) {
+			drgn_address_symbol_vector_deinit(&candidates);
+			return &drgn_enomem;
+		}
+		candidate->sym.name = name;
+		candidate->sym.address = elf_addr;
+		candidate->sym.size = elf_sym.st_size;
+		switch (GELF_ST_BIND(elf_sym.st_info)) {
+		case STB_GLOBAL:
+			candidate->binding_rank = 2;
+			break;
+		case STB_WEAK:
+			candidate->binding_rank = 1;
+			break;
+		default:
+			candidate->binding_rank = 0;
+			break;
+		}
+		candidate->index = i;
+	}
+	qsort(candidates.data, candidates.size, sizeof(candidates.data[0]),
+	      drgn_address_symbol_cmp);
+
+	struct drgn_symbol_vector *address_symbols = &module->address_symbols;
+	if (!drgn_symbol_vector_reserve(address_symbols, candidates.size)) {
+		drgn_address_symbol_vector_deinit(&candidates);
+		return &drgn_enomem;
+	}
+	for (size_t i = 0; i < candidates.size; i++) {
+		/* The preferred symbol at each address sorts first. */
+		if (address_symbols->size &&
+		    address_symbols->data[address_symbols->size - 1].address ==
+		    candidates.data[i].sym.address)
+			continue;
+		address_symbols->data[address_symbols->size++] =
+			candidates.data[i].sym;
+	}
+	drgn_symbol_vector_shrink_to_fit(address_symbols);
+	drgn_address_symbol_vector_deinit(&candidates);
+	return NULL;
+}
+
 static struct drgn_error *
 drgn_debug_info_read_module(struct drgn_debug_info_load_state *load,
 			    struct drgn_dwarf_index_update_state *dindex_state,
@@ -904,6 +1028,9 @@ drgn_debug_info_read_module(struct drgn_debug_info_load_state *load,
 		}
 		if (module->scns[DRGN_SCN_DEBUG_INFO] &&
 		    module->scns[DRGN_SCN_DEBUG_ABBREV]) {
+			err = drgn_debug_info_module_index_addresses(module);
+			if (err)
+				return err;
 			module->state = DRGN_DEBUG_INFO_MODULE_INDEXING;
 			drgn_dwarf_index_read_module(dindex_state, module);
 			return NULL;
@@ -1023,6 +1150,7 @@ struct drgn_error *drgn_debug_info_load(struct drgn_debug_info *dbinfo,
 		.new_modules = VECTOR_INIT,
 		.max_errors = max_errors ? atoi(max_errors) : 5,
 	};
+	drgn_debug_info_free_symbols(dbinfo);
 	dwfl_report_begin_add(dbinfo->dwfl);
 	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL)
 		err = linux_kernel_report_debug_info(&load);
@@ -1068,6 +1196,133 @@ bool drgn_debug_info_is_indexed(struct drgn_debug_info *dbinfo,
 	return c_string_set_search(&dbinfo->module_names, &name).entry != NULL;
 }
 
+struct drgn_debug_info_collect_symbols_arg {
+	struct drgn_debug_info *dbinfo;
+	struct drgn_symbol_vector symbols;
+};
+
+static int drgn_debug_info_collect_symbols_cb(Dwfl_Module *dwfl_module,
+					      void **userdatap,
+					      const char *module_name,
+					      Dwarf_Addr base, void *cb_arg)
+{
+	struct drgn_debug_info_collect_symbols_arg *arg = cb_arg;
+	int symtab_len = dwfl_module_getsymtab(dwfl_module);
+	int i = dwfl_module_getsymtab_first_global(dwfl_module);
+	if (symtab_len == -1 || i == -1) {
+		arg->dbinfo->symbols_bad_symtabs = true;
+		return DWARF_CB_OK;
+	}
+	for (; i < symtab_len; i++) {
+		GElf_Sym elf_sym;
+		GElf_Addr elf_addr;
+		const char *name = dwfl_module_getsym_info(dwfl_module, i,
+							   &elf_sym, &elf_addr,
+							   NULL, NULL, NULL);
+		if (!name || !name[0])
+			continue;
+		struct drgn_symbol *sym =
+			drgn_symbol_vector_append_entry(&arg->symbols);
+		if (!sym)
+			return DWARF_CB_ABORT;
+		sym->name = name;
+		sym->address = elf_addr;
+		sym->size = elf_sym.st_size;
+	}
+	return DWARF_CB_OK;
+}
+
+struct drgn_error *drgn_debug_info_index_symbols(struct drgn_debug_info *dbinfo)
+{
+	struct drgn_error *err;
+
+	if (dbinfo->symbols_indexed)
+		return NULL;
+
+	struct drgn_debug_info_collect_symbols_arg arg = {
+		.dbinfo = dbinfo,
+		.symbols = VECTOR_INIT,
+	};
+	dbinfo->symbols_bad_symtabs = false;
+	if (dwfl_getmodules(dbinfo->dwfl, drgn_debug_info_collect_symbols_cb,
+			    &arg, 0))
+		err = &drgn_enomem;
+	else
+		err = drgn_symbol_name_index_build(&dbinfo->global_symbols,
+						   &arg.symbols);
+	drgn_symbol_vector_deinit(&arg.symbols);
+	if (err)
+		return err;
+	dbinfo->symbols_indexed = true;
+	return NULL;
+}
+
+static bool
+drgn_debug_info_find_symbol_by_address_uncached(struct drgn_debug_info *dbinfo,
+						uint64_t address,
+						Dwfl_Module *dwfl_module,
+						struct drgn_symbol *ret)
+{
+	if (!dwfl_module) {
+		dwfl_module = dwfl_addrmodule(dbinfo->dwfl, address);
+		if (!dwfl_module)
+			return false;
+	}
+
+	void **userdatap;
+	dwfl_module_info(dwfl_module, &userdatap, NULL, NULL, NULL, NULL, NULL,
+			 NULL);
+	struct drgn_debug_info_module *module = *userdatap;
+	if (module) {
+		const struct drgn_symbol *sym =
+			drgn_symbol_search_address(module->address_symbols.data,
+						   module->address_symbols.size,
+						   address);
+		if (sym) {
+			*ret = *sym;
+			return true;
+		}
+	}
+
+	GElf_Off offset;
+	GElf_Sym elf_sym;
+	const char *name = dwfl_module_addrinfo(dwfl_module, address, &offset,
+						&elf_sym, NULL, NULL, NULL);
+	if (!name)
+		return false;
+	ret->name = name;
+	ret->address = address - offset;
+	ret->size = elf_sym.st_size;
+	return true;
+}
+
+bool drgn_debug_info_find_symbol_by_address(struct drgn_debug_info *dbinfo,
+					    uint64_t address,
+					    Dwfl_Module *dwfl_module,
+					    struct drgn_symbol *ret)
+{
+	struct drgn_symbol_cache_entry *entry =
+		&dbinfo->symbol_cache[int_key_hash_pair(&address).first &
+				      (DRGN_SYMBOL_CACHE_SIZE - 1)];
+	if (entry->valid && entry->address == address &&
+	    entry->dwfl_module == dwfl_module) {
+		if (entry->found)
+			*ret = entry->sym;
+		return entry->found;
+	}
+	bool found = drgn_debug_info_find_symbol_by_address_uncached(dbinfo,
+								     address,
+								     dwfl_module,
+								     ret);
+	entry->address = address;
+	entry->dwfl_module = dwfl_module;
+	entry->valid = true;
+	entry->found = found;
+	if (found)
+		entry->sym = *ret;
+	return found;
+}
+
 DEFINE_HASH_TABLE_FUNCTIONS(drgn_dwarf_type_map, ptr_key_hash_pair,
 			    scalar_key_eq)
 
@@ -2553,6 +2808,10 @@ struct drgn_error *drgn_debug_info_create(struct drgn_program *prog,
 	drgn_dwarf_type_map_init(&dbinfo->types);
 	drgn_dwarf_type_map_init(&dbinfo->cant_be_incomplete_array_types);
 	dbinfo->depth = 0;
+	drgn_symbol_name_index_init(&dbinfo->global_symbols);
+	dbinfo->symbols_indexed = false;
+	dbinfo->symbols_bad_symtabs = false;
+	memset(dbinfo->symbol_cache, 0, sizeof(dbinfo->symbol_cache));
 	*ret = dbinfo;
 	return NULL;
 }
@@ -2566,6 +2825,7 @@ void drgn_debug_info_destroy(struct drgn_debug_info *dbinfo)
 	drgn_dwarf_index_deinit(&dbinfo->dindex);
 	c_string_set_deinit(&dbinfo->module_names);
 	drgn_debug_info_free_modules(dbinfo, false, true);
+	drgn_symbol_name_index_deinit(&dbinfo->global_symbols);
 	assert(drgn_debug_info_module_table_empty(&dbinfo->modules));
 	drgn_debug_info_module_table_deinit(&dbinfo->modules);
 	dwfl_end(dbinfo->dwfl);
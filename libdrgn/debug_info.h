@@ -16,10 +16,13 @@
 #include <libelf.h>
 
 #include "binary_buffer.h"
+#include "cfi.h"
 #include "drgn.h"
 #include "dwarf_index.h"
 #include "hash_table.h"
+#include "orc.h"
 #include "string_builder.h"
+#include "symbol.h"
 #include "vector.h"
 
 /**
@@ -96,6 +99,29 @@ struct drgn_debug_info_module {
 	 * linked in a list. Only one is indexed; the rest are destroyed.
 	 */
 	struct drgn_debug_info_module *next;
+	/**
+	 * ELF symbols with a non-zero size sorted by address.
+	 *
+	 * This is built when the module is indexed. If there are multiple
+	 * symbols at the same address, only the one that libdwfl would prefer
+	 * is kept. See @ref drgn_debug_info_find_symbol_by_address().
+	 */
+	struct drgn_symbol_vector address_symbols;
+	/**
+	 * ORC entries sorted by program counter. These are parsed on demand by
+	 * @ref drgn_debug_info_module_parse_orc().
+	 */
+	uint64_t *orc_pcs;
+	/** Entry for each program counter in @ref orc_pcs. */
+	struct drgn_orc_entry *orc_entries;
+	size_t num_orc_entries;
+	bool orc_parsed;
+	/**
+	 * Call frame information from @c .eh_frame and @c .debug_frame. These
+	 * are parsed on demand by @ref drgn_debug_info_module_find_cfi().
+	 */
+	struct drgn_cfi eh_frame, debug_frame;
+	bool cfi_parsed;
 };
 
 struct drgn_error *drgn_error_debug_info(struct drgn_debug_info_module *module,
@@ -161,6 +187,21 @@ struct drgn_dwarf_type {
 
 DEFINE_HASH_MAP_TYPE(drgn_dwarf_type_map, const void *, struct drgn_dwarf_type);
 
+/** Number of entries in @ref drgn_debug_info::symbol_cache. */
+#define DRGN_SYMBOL_CACHE_SIZE 1024
+
+/** Cached result of @ref drgn_debug_info_find_symbol_by_address(). */
+struct drgn_symbol_cache_entry {
+	uint64_t address;
+	/** Module that the lookup was limited to, or @c NULL if it wasn't. */
+	Dwfl_Module *dwfl_module;
+	struct drgn_symbol sym;
+	/** Whether this entry is valid. */
+	bool valid;
+	/** Whether a symbol containing @ref address was found. */
+	bool found;
+};
+
 /** Cache of debugging information. */
 struct drgn_debug_info {
 	/** Program owning this cache. */
@@ -196,6 +237,30 @@ struct drgn_debug_info {
 	struct drgn_dwarf_type_map cant_be_incomplete_array_types;
 	/** Current parsing recursion depth. */
 	int depth;
+
+	/**
+	 * Global ELF symbols of all modules.
+	 *
+	 * Symbols with the same name are in the order that their modules are
+	 * reported to libdwfl. This is built on demand by @ref
+	 * drgn_debug_info_index_symbols() and discarded whenever modules are
+	 * added or removed, since the names point into the modules' string
+	 * tables.
+	 */
+	struct drgn_symbol_name_index global_symbols;
+	/** Whether @ref global_symbols is valid. */
+	bool symbols_indexed;
+	/** Whether the symbol table of any module couldn't be read. */
+	bool symbols_bad_symtabs;
+	/**
+	 * Direct-mapped cache of recent address to symbol lookups.
+	 *
+	 * This is cleared at the same time as @ref global_symbols. Every lookup
+	 * may write to it, so lookups on the same @ref drgn_debug_info must not
+	 * run concurrently (the Python bindings hold the program lock for
+	 * them).
+	 */
+	struct drgn_symbol_cache_entry symbol_cache[DRGN_SYMBOL_CACHE_SIZE];
 };
 
 /** Create a @ref drgn_debug_info. */
@@ -282,6 +347,35 @@ struct drgn_error *drgn_debug_info_load(struct drgn_debug_info *dbinfo,
 					const char **paths, size_t n,
 					bool load_default, bool load_main);
 
+/**
+ * Index the global ELF symbols of a @ref drgn_debug_info by name if they are
+ * not already indexed.
+ *
+ * @sa drgn_debug_info::global_symbols
+ */
+struct drgn_error *drgn_debug_info_index_symbols(struct drgn_debug_info *dbinfo);
+
+/**
+ * Find the ELF symbol containing an address.
+ *
+ * This checks @ref drgn_debug_info::symbol_cache, then @ref
+ * drgn_debug_info_module::address_symbols of the module containing the
+ * address, and finally falls back to libdwfl for the cases that the sorted
+ * array doesn't handle (nested symbols and symbols without a size).
+ *
+ * This updates the cache, so it is not thread-safe.
+ *
+ * @param[in] dwfl_module Module containing the address. May be @c NULL, in
+ * which case this will look it up.
+ * @param[out] ret Returned symbol. Its name is valid until modules are added
+ * or removed.
+ * @return Whether the symbol was found.
+ */
+bool drgn_debug_info_find_symbol_by_address(struct drgn_debug_info *dbinfo,
+					    uint64_t address,
+					    Dwfl_Module *dwfl_module,
+					    struct drgn_symbol *ret);
+
 /**
  * Return whether a @ref drgn_debug_info has indexed a module with the given
  * name.
@@ -0,0 +1,460 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "drgn.h"
+#include "error.h"
+#include "expression.h"
+#include "language.h"
+#include "program.h"
+#include "type.h"
+#include "util.h"
+
+DEFINE_VECTOR_FUNCTIONS(drgn_expression_node_vector)
+
+struct drgn_expression_node *
+drgn_expression_append_node(struct drgn_expression *expr,
+			    enum drgn_expression_op op, uint32_t *index_ret)
+{
+	if (expr->nodes.size >= UINT32_MAX)
+		return NULL;
+	struct drgn_expression_node *node =
+		drgn_expression_node_vector_append_entry(&expr->nodes);
+	if (!node)
+		return NULL;
+	memset(node, 0, sizeof(*node));
+	node->op = op;
+	if (op == DRGN_EXPR_OBJECT)
+		drgn_object_init(&node->obj, expr->prog);
+	*index_ret = expr->nodes.size - 1;
+	return node;
+}
+
+struct drgn_error *drgn_expression_sizeof_result(struct drgn_object *res,
+						 uint64_t size)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+
+	err = drgn_program_find_primitive_type(drgn_object_program(res),
+					       DRGN_C_TYPE_SIZE_T,
+					       &qualified_type.type);
+	if (err)
+		return err;
+	qualified_type.qualifiers = 0;
+	return drgn_object_set_unsigned(res, qualified_type, size, 0);
+}
+
+static unsigned int drgn_expression_num_operands(enum drgn_expression_op op)
+{
+	switch (op) {
+	case DRGN_EXPR_OBJECT:
+	case DRGN_EXPR_PARAMETER:
+		return 0;
+	case DRGN_EXPR_MEMBER:
+	case DRGN_EXPR_MEMBER_DEREFERENCE:
+	case DRGN_EXPR_ADDRESS_OF:
+	case DRGN_EXPR_DEREFERENCE:
+	case DRGN_EXPR_CAST:
+	case DRGN_EXPR_SIZEOF:
+	case DRGN_EXPR_POS:
+	case DRGN_EXPR_NEG:
+	case DRGN_EXPR_NOT:
+	case DRGN_EXPR_LOGICAL_NOT:
+		return 1;
+	case DRGN_EXPR_CONDITIONAL:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+/*
+ * Check that the expression tree isn't too deep to evaluate recursively. A
+ * left-associative chain of binary operators is parsed iteratively, so the
+ * parser's limit doesn't cover this.
+ */
+static struct drgn_error *
+drgn_expression_check_depth(const struct drgn_expression *expr)
+{
+	uint16_t *depths = malloc_array(expr->nodes.size, sizeof(*depths));
+	if (!depths)
+		return &drgn_enomem;
+	struct drgn_error *err = NULL;
+	for (size_t i = 0; i < expr->nodes.size; i++) {
+		const struct drgn_expression_node *node = &expr->nodes.data[i];
+		unsigned int num_operands =
+			drgn_expression_num_operands(node->op);
+		uint16_t depth = 1;
+		/* Operands always come before the node that uses them. */
+		for (unsigned int j = 0; j < num_operands; j++) {
+			if (depths[node->operands[j]] >= depth)
+				depth = depths[node->operands[j]] + 1;
+		}
+		if (depth > DRGN_EXPRESSION_MAX_DEPTH) {
+			err = drgn_error_create(DRGN_ERROR_RECURSION,
+						"maximum expression depth exceeded");
+			break;
+		}
+		depths[i] = depth;
+	}
+	free(depths);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_compile_expression(struct drgn_program *prog, const char *str,
+				const char * const *params, size_t num_params,
+				struct drgn_expression **ret)
+{
+	struct drgn_error *err;
+
+	struct drgn_expression *expr = malloc(sizeof(*expr));
+	if (!expr)
+		return &drgn_enomem;
+	expr->prog = prog;
+	expr->num_params = num_params;
+	drgn_expression_node_vector_init(&expr->nodes);
+
+	err = drgn_program_language(prog)->compile_expression(prog, str,
+							      params,
+							      num_params,
+							      expr);
+	if (!err)
+		err = drgn_expression_check_depth(expr);
+	if (err) {
+		drgn_expression_destroy(expr);
+		return err;
+	}
+	drgn_expression_node_vector_shrink_to_fit(&expr->nodes);
+	*ret = expr;
+	return NULL;
+}
+
+LIBDRGN_PUBLIC void drgn_expression_destroy(struct drgn_expression *expr)
+{
+	if (!expr)
+		return;
+	for (size_t i = 0; i < expr->nodes.size; i++) {
+		struct drgn_expression_node *node = &expr->nodes.data[i];
+		switch (node->op) {
+		case DRGN_EXPR_OBJECT:
+			drgn_object_deinit(&node->obj);
+			break;
+		case DRGN_EXPR_MEMBER:
+		case DRGN_EXPR_MEMBER_DEREFERENCE:
+			free(node->member);
+			break;
+		default:
+			break;
+		}
+	}
+	drgn_expression_node_vector_deinit(&expr->nodes);
+	free(expr);
+}
+
+LIBDRGN_PUBLIC size_t
+drgn_expression_num_params(const struct drgn_expression *expr)
+{
+	return expr->num_params;
+}
+
+static drgn_binary_op * const drgn_expression_binary_ops[] = {
+	[DRGN_EXPR_ADD] = drgn_object_add,
+	[DRGN_EXPR_SUB] = drgn_object_sub,
+	[DRGN_EXPR_MUL] = drgn_object_mul,
+	[DRGN_EXPR_DIV] = drgn_object_div,
+	[DRGN_EXPR_MOD] = drgn_object_mod,
+	[DRGN_EXPR_LSHIFT] = drgn_object_lshift,
+	[DRGN_EXPR_RSHIFT] = drgn_object_rshift,
+	[DRGN_EXPR_AND] = drgn_object_and,
+	[DRGN_EXPR_OR] = drgn_object_or,
+	[DRGN_EXPR_XOR] = drgn_object_xor,
+};
+
+static drgn_unary_op * const drgn_expression_unary_ops[] = {
+	[DRGN_EXPR_ADDRESS_OF] = drgn_object_address_of,
+	[DRGN_EXPR_DEREFERENCE] = drgn_object_dereference,
+	[DRGN_EXPR_POS] = drgn_object_pos,
+	[DRGN_EXPR_NEG] = drgn_object_neg,
+	[DRGN_EXPR_NOT] = drgn_object_not,
+};
+
+static struct drgn_error *
+drgn_expression_eval(const struct drgn_expression *expr, uint32_t i,
+		     const struct drgn_object * const *args, bool unevaluated,
+		     struct drgn_object *res);
+
+/*
+ * Evaluate a node whose value is used as an operand. In an unevaluated operand
+ * (i.e., of sizeof), only the type of the result matters, so any scalar is
+ * replaced with an arbitrary value of the same type. This way, operators on it
+ * never read memory. The value is 1 so that division or shifting by it is
+ * valid.
+ */
+static struct drgn_error *
+drgn_expression_eval_value(const struct drgn_expression *expr, uint32_t i,
+			   const struct drgn_object * const *args,
+			   bool unevaluated, struct drgn_object *res)
+{
+	struct drgn_error *err;
+
+	err = drgn_expression_eval(expr, i, args, unevaluated, res);
+	if (err || !unevaluated)
+		return err;
+
+	struct drgn_qualified_type qualified_type =
+		drgn_object_qualified_type(res);
+	uint64_t bit_field_size = res->is_bit_field ? res->bit_size : 0;
+	switch (res->encoding) {
+	case DRGN_OBJECT_ENCODING_SIGNED:
+		return drgn_object_set_signed(res, qualified_type, 1,
+					      bit_field_size);
+	case DRGN_OBJECT_ENCODING_UNSIGNED:
+		return drgn_object_set_unsigned(res, qualified_type, 1,
+						bit_field_size);
+	case DRGN_OBJECT_ENCODING_FLOAT:
+		return drgn_object_set_float(res, qualified_type, 1.0);
+	default:
+		return NULL;
+	}
+}
+
+/* Evaluate the second operand of a binary operator into a temporary. */
+static struct drgn_error *
+drgn_expression_eval_binary(const struct drgn_expression *expr,
+			    const struct drgn_expression_node *node,
+			    const struct drgn_object * const *args,
+			    bool unevaluated, struct drgn_object *res)
+{
+	struct drgn_error *err;
+	struct drgn_object rhs;
+	union drgn_value index;
+	int cmp;
+
+	err = drgn_expression_eval_value(expr, node->operands[0], args,
+					 unevaluated, res);
+	if (err)
+		return err;
+	drgn_object_init(&rhs, expr->prog);
+	err = drgn_expression_eval_value(expr, node->operands[1], args,
+					 unevaluated, &rhs);
+	if (err)
+		goto out;
+
+	switch (node->op) {
+	case DRGN_EXPR_SUBSCRIPT:
+		err = drgn_object_read_integer(&rhs, &index);
+		if (err)
+			goto out;
+		err = drgn_object_subscript(res, res,
+					    rhs.encoding == DRGN_OBJECT_ENCODING_SIGNED ?
+					    index.svalue : (int64_t)index.uvalue);
+		break;
+	case DRGN_EXPR_ADD:
+	case DRGN_EXPR_SUB:
+	case DRGN_EXPR_MUL:
+	case DRGN_EXPR_DIV:
+	case DRGN_EXPR_MOD:
+	case DRGN_EXPR_LSHIFT:
+	case DRGN_EXPR_RSHIFT:
+	case DRGN_EXPR_AND:
+	case DRGN_EXPR_OR:
+	case DRGN_EXPR_XOR:
+		err = drgn_expression_binary_ops[node->op](res, res, &rhs);
+		break;
+	default:
+		err = drgn_object_cmp(res, &rhs, &cmp);
+		if (err)
+			goto out;
+		switch (node->op) {
+		case DRGN_EXPR_LT:
+			err = drgn_object_bool_literal(res, cmp < 0);
+			break;
+		case DRGN_EXPR_LE:
+			err = drgn_object_bool_literal(res, cmp <= 0);
+			break;
+		case DRGN_EXPR_GT:
+			err = drgn_object_bool_literal(res, cmp > 0);
+			break;
+		case DRGN_EXPR_GE:
+			err = drgn_object_bool_literal(res, cmp >= 0);
+			break;
+		case DRGN_EXPR_EQ:
+			err = drgn_object_bool_literal(res, cmp == 0);
+			break;
+		case DRGN_EXPR_NE:
+			err = drgn_object_bool_literal(res, cmp != 0);
+			break;
+		default:
+			UNREACHABLE();
+		}
+		break;
+	}
+out:
+	drgn_object_deinit(&rhs);
+	return err;
+}
+
+/*
+ * The type of a conditional expression is the common type of the second and
+ * third operands. For arithmetic operands, that is the type of their sum.
+ * Otherwise, they must have the same type.
+ */
+static struct drgn_error *
+drgn_expression_conditional_type(const struct drgn_expression *expr,
+				 const struct drgn_expression_node *node,
+				 const struct drgn_object * const *args,
+				 struct drgn_object *res)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	bool b;
+
+	err = drgn_expression_eval_value(expr, node->operands[0], args, true,
+					 res);
+	if (err)
+		return err;
+	err = drgn_object_bool(res, &b);
+	if (err)
+		return err;
+	err = drgn_expression_eval_value(expr, node->operands[1], args, true,
+					 res);
+	if (err)
+		return err;
+	drgn_object_init(&tmp, expr->prog);
+	err = drgn_expression_eval_value(expr, node->operands[2], args, true,
+					 &tmp);
+	if (!err && drgn_type_is_arithmetic(res->type) &&
+	    drgn_type_is_arithmetic(tmp.type))
+		err = drgn_object_add(res, res, &tmp);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *
+drgn_expression_eval(const struct drgn_expression *expr, uint32_t i,
+		     const struct drgn_object * const *args, bool unevaluated,
+		     struct drgn_object *res)
+{
+	struct drgn_error *err;
+	const struct drgn_expression_node *node = &expr->nodes.data[i];
+	uint64_t size;
+	bool b;
+
+	switch (node->op) {
+	case DRGN_EXPR_OBJECT:
+		return drgn_object_copy(res, &node->obj);
+	case DRGN_EXPR_PARAMETER:
+		return drgn_object_copy(res, args[node->param]);
+	case DRGN_EXPR_MEMBER:
+		err = drgn_expression_eval(expr, node->operands[0], args,
+					   unevaluated, res);
+		if (err)
+			return err;
+		return drgn_object_member(res, res, node->member);
+	case DRGN_EXPR_MEMBER_DEREFERENCE:
+		err = drgn_expression_eval_value(expr, node->operands[0], args,
+						 unevaluated, res);
+		if (err)
+			return err;
+		return drgn_object_member_dereference(res, res, node->member);
+	case DRGN_EXPR_ADDRESS_OF:
+		err = drgn_expression_eval(expr, node->operands[0], args,
+					   unevaluated, res);
+		if (err)
+			return err;
+		return drgn_object_address_of(res, res);
+	case DRGN_EXPR_DEREFERENCE:
+	case DRGN_EXPR_POS:
+	case DRGN_EXPR_NEG:
+	case DRGN_EXPR_NOT:
+		err = drgn_expression_eval_value(expr, node->operands[0], args,
+						 unevaluated, res);
+		if (err)
+			return err;
+		return drgn_expression_unary_ops[node->op](res, res);
+	case DRGN_EXPR_CAST:
+		err = drgn_expression_eval_value(expr, node->operands[0], args,
+						 unevaluated, res);
+		if (err)
+			return err;
+		return drgn_object_cast(res, node->type, res);
+	case DRGN_EXPR_SIZEOF:
+		/* The operand of sizeof is not evaluated. */
+		err = drgn_expression_eval(expr, node->operands[0], args, true,
+					   res);
+		if (err)
+			return err;
+		err = drgn_object_sizeof(res, &size);
+		if (err)
+			return err;
+		return drgn_expression_sizeof_result(res, size);
+	case DRGN_EXPR_LOGICAL_NOT:
+		err = drgn_expression_eval_value(expr, node->operands[0], args,
+						 unevaluated, res);
+		if (err)
+			return err;
+		err = drgn_object_bool(res, &b);
+		if (err)
+			return err;
+		return drgn_object_bool_literal(res, !b);
+	case DRGN_EXPR_LOGICAL_AND:
+	case DRGN_EXPR_LOGICAL_OR:
+		err = drgn_expression_eval_value(expr, node->operands[0], args,
+						 unevaluated, res);
+		if (err)
+			return err;
+		err = drgn_object_bool(res, &b);
+		if (err)
+			return err;
+		/* Short circuit. */
+		if (b == (node->op == DRGN_EXPR_LOGICAL_OR))
+			return drgn_object_bool_literal(res, b);
+		err = drgn_expression_eval_value(expr, node->operands[1], args,
+						 unevaluated, res);
+		if (err)
+			return err;
+		err = drgn_object_bool(res, &b);
+		if (err)
+			return err;
+		return drgn_object_bool_literal(res, b);
+	case DRGN_EXPR_CONDITIONAL:
+		if (unevaluated)
+			return drgn_expression_conditional_type(expr, node,
+								args, res);
+		err = drgn_expression_eval_value(expr, node->operands[0], args,
+						 false, res);
+		if (err)
+			return err;
+		err = drgn_object_bool(res, &b);
+		if (err)
+			return err;
+		return drgn_expression_eval(expr, node->operands[b ? 1 : 2],
+					    args, false, res);
+	default:
+		return drgn_expression_eval_binary(expr, node, args,
+						   unevaluated, res);
+	}
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_expression_evaluate(const struct drgn_expression *expr,
+			 const struct drgn_object * const *args,
+			 struct drgn_object *res)
+{
+	for (size_t i = 0; i < expr->num_params; i++) {
+		if (drgn_object_program(args[i]) != expr->prog) {
+			return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+						 "expression argument is from different program");
+		}
+	}
+	if (drgn_object_program(res) != expr->prog) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "expression result is from different program");
+	}
+	return drgn_expression_eval(expr, expr->nodes.size - 1, args, false,
+				    res);
+}
@@ -0,0 +1,180 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Expression internals.
+ *
+ * See @ref ExpressionInternals.
+ */
+
+#ifndef DRGN_EXPRESSION_H
+#define DRGN_EXPRESSION_H
+
+#include <stdint.h>
+
+#include "drgn.h"
+#include "vector.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup ExpressionInternals Expressions
+ *
+ * Compiled expression internals.
+ *
+ * A language's @ref drgn_language::compile_expression callback parses an
+ * expression into a tree of @ref drgn_expression_node%s, which is evaluated
+ * directly on @ref drgn_object%s by @ref drgn_expression_evaluate(). Type names
+ * and names of objects in the program are resolved when the expression is
+ * compiled, so evaluation doesn't do any lookups.
+ *
+ * @{
+ */
+
+/**
+ * Maximum depth of a @ref drgn_expression tree.
+ *
+ * This bounds the recursion of the language parsers and of @ref
+ * drgn_expression_evaluate().
+ */
+#define DRGN_EXPRESSION_MAX_DEPTH 1000
+
+/** Kind of @ref drgn_expression_node. */
+enum drgn_expression_op {
+	/** Constant object (@ref drgn_expression_node::obj). */
+	DRGN_EXPR_OBJECT,
+	/** Parameter (@ref drgn_expression_node::param). */
+	DRGN_EXPR_PARAMETER,
+	/** <tt>operand.member</tt>. */
+	DRGN_EXPR_MEMBER,
+	/** <tt>operand->member</tt>. */
+	DRGN_EXPR_MEMBER_DEREFERENCE,
+	/** <tt>operand[operand2]</tt>. */
+	DRGN_EXPR_SUBSCRIPT,
+	/** <tt>&operand</tt>. */
+	DRGN_EXPR_ADDRESS_OF,
+	/** <tt>*operand</tt>. */
+	DRGN_EXPR_DEREFERENCE,
+	/** <tt>(type)operand</tt>. */
+	DRGN_EXPR_CAST,
+	/** <tt>sizeof operand</tt>. */
+	DRGN_EXPR_SIZEOF,
+	/** <tt>+operand</tt>. */
+	DRGN_EXPR_POS,
+	/** <tt>-operand</tt>. */
+	DRGN_EXPR_NEG,
+	/** <tt>~operand</tt>. */
+	DRGN_EXPR_NOT,
+	/** <tt>!operand</tt>. */
+	DRGN_EXPR_LOGICAL_NOT,
+	/** <tt>operand + operand2</tt>. */
+	DRGN_EXPR_ADD,
+	/** <tt>operand - operand2</tt>. */
+	DRGN_EXPR_SUB,
+	/** <tt>operand * operand2</tt>. */
+	DRGN_EXPR_MUL,
+	/** <tt>operand / operand2</tt>. */
+	DRGN_EXPR_DIV,
+	/** <tt>operand % operand2</tt>. */
+	DRGN_EXPR_MOD,
+	/** <tt>operand << operand2</tt>. */
+	DRGN_EXPR_LSHIFT,
+	/** <tt>operand >> operand2</tt>. */
+	DRGN_EXPR_RSHIFT,
+	/** <tt>operand & operand2</tt>. */
+	DRGN_EXPR_AND,
+	/** <tt>operand | operand2</tt>. */
+	DRGN_EXPR_OR,
+	/** <tt>operand ^ operand2</tt>. */
+	DRGN_EXPR_XOR,
+	/** <tt>operand < operand2</tt>. */
+	DRGN_EXPR_LT,
+	/** <tt>operand <= operand2</tt>. */
+	DRGN_EXPR_LE,
+	/** <tt>operand > operand2</tt>. */
+	DRGN_EXPR_GT,
+	/** <tt>operand >= operand2</tt>. */
+	DRGN_EXPR_GE,
+	/** <tt>operand == operand2</tt>. */
+	DRGN_EXPR_EQ,
+	/** <tt>operand != operand2</tt>. */
+	DRGN_EXPR_NE,
+	/** <tt>operand && operand2</tt>. */
+	DRGN_EXPR_LOGICAL_AND,
+	/** <tt>operand || operand2</tt>. */
+	DRGN_EXPR_LOGICAL_OR,
+	/** <tt>operand ? operand2 : operand3</tt>. */
+	DRGN_EXPR_CONDITIONAL,
+};
+
+/** Node in a compiled @ref drgn_expression. */
+struct drgn_expression_node {
+	/** Operation. */
+	enum drgn_expression_op op;
+	/**
+	 * Indices of the operands in @ref drgn_expression::nodes.
+	 *
+	 * Only as many as the operation takes are valid.
+	 */
+	uint32_t operands[3];
+	union {
+		/** Object for @ref DRGN_EXPR_OBJECT. */
+		struct drgn_object obj;
+		/** Index of the parameter for @ref DRGN_EXPR_PARAMETER. */
+		size_t param;
+		/**
+		 * Member name for @ref DRGN_EXPR_MEMBER and @ref
+		 * DRGN_EXPR_MEMBER_DEREFERENCE.
+		 */
+		char *member;
+		/** Type to cast to for @ref DRGN_EXPR_CAST. */
+		struct drgn_qualified_type type;
+	};
+};
+
+DEFINE_VECTOR_TYPE(drgn_expression_node_vector, struct drgn_expression_node)
+
+/** Compiled expression. */
+struct drgn_expression {
+	/** Program that the expression was compiled for. */
+	struct drgn_program *prog;
+	/** Number of parameters that must be passed to evaluate it. */
+	size_t num_params;
+	/**
+	 * Nodes in the expression.
+	 *
+	 * Operands always come before the node that uses them, so the last
+	 * node is the root.
+	 */
+	struct drgn_expression_node_vector nodes;
+};
+
+/**
+ * Append a node to a @ref drgn_expression.
+ *
+ * If @p op is @ref DRGN_EXPR_OBJECT, then the object is initialized and must be
+ * set by the caller.
+ *
+ * @param[in] op Operation of the new node.
+ * @param[out] index_ret Returned index of the new node.
+ * @return The new node, or @c NULL if we ran out of memory.
+ */
+struct drgn_expression_node *
+drgn_expression_append_node(struct drgn_expression *expr,
+			    enum drgn_expression_op op, uint32_t *index_ret);
+
+/**
+ * Set a @ref drgn_object to the result of a @c sizeof operator.
+ *
+ * @param[out] res Object to set.
+ * @param[in] size Size in bytes.
+ * @return @c NULL on success, non-@c NULL on error.
+ */
+struct drgn_error *drgn_expression_sizeof_result(struct drgn_object *res,
+						 uint64_t size);
+
+/** @} */
+
+#endif /* DRGN_EXPRESSION_H */
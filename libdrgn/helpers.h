@@ -13,6 +13,7 @@
 #ifndef DRGN_HELPERS_H
 #define DRGN_HELPERS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -43,4 +44,361 @@ struct drgn_error *linux_helper_find_task(struct drgn_object *res,
 					  const struct drgn_object *ns,
 					  uint64_t pid);
 
+struct drgn_error *linux_helper_per_cpu_ptr(struct drgn_object *res,
+					    const struct drgn_object *ptr,
+					    uint64_t cpu);
+
+/** A field of <tt>struct page</tt>, masked before it is used. */
+struct linux_page_field {
+	/** Offset of the field in bytes. */
+	uint64_t offset;
+	/** Size of the field in bytes (1, 2, 4, or 8). */
+	uint8_t size;
+	/** Whether the field is sign-extended and compared as signed. */
+	bool is_signed;
+	uint64_t mask;
+};
+
+enum linux_page_filter_op {
+	LINUX_PAGE_FILTER_EQ,
+	LINUX_PAGE_FILTER_NE,
+	LINUX_PAGE_FILTER_LT,
+	LINUX_PAGE_FILTER_LE,
+	LINUX_PAGE_FILTER_GT,
+	LINUX_PAGE_FILTER_GE,
+};
+
+/** Condition on a field of <tt>struct page</tt>: <tt>(field & mask) op value</tt>. */
+struct linux_page_filter {
+	struct linux_page_field field;
+	enum linux_page_filter_op op;
+	uint64_t value;
+};
+
+/** Number of pages with a given value of a @ref linux_page_field. */
+struct linux_page_count {
+	uint64_t value;
+	uint64_t count;
+};
+
+/*
+ * Find the PFNs in [start_pfn, end_pfn) whose struct page (in the array
+ * pointed to by vmemmap) matches every filter. Holes in vmemmap are skipped.
+ * The returned array must be freed with free().
+ */
+struct drgn_error *
+linux_helper_scan_pages(const struct drgn_object *vmemmap, uint64_t start_pfn,
+			uint64_t end_pfn,
+			const struct linux_page_filter *filters,
+			size_t num_filters, uint64_t **pfns_ret,
+			size_t *num_pfns_ret);
+
+/*
+ * Like linux_helper_scan_pages(), but count the matching pages by the value of
+ * a field instead. The returned array is sorted by decreasing count and must be
+ * freed with free().
+ */
+struct drgn_error *
+linux_helper_count_pages(const struct drgn_object *vmemmap, uint64_t start_pfn,
+			 uint64_t end_pfn,
+			 const struct linux_page_filter *filters,
+			 size_t num_filters,
+			 const struct linux_page_field *key,
+			 struct linux_page_count **counts_ret,
+			 size_t *num_counts_ret);
+
+/*
+ * Get the start of the direct mapping of physical memory (PAGE_OFFSET) and the
+ * physical address that it starts at, which is 0 unless RAM doesn't start at 0
+ * on the architecture.
+ */
+struct drgn_error *linux_helper_direct_map(struct drgn_program *prog,
+					   uint64_t *page_offset_ret,
+					   uint64_t *phys_offset_ret);
+
+/** Slab allocator state cached on a program. */
+struct linux_slab_state;
+
+void linux_slab_state_destroy(struct linux_slab_state *state);
+
+/** Iterator over the objects in a SLUB slab cache. */
+struct linux_slab_cache_iterator;
+
+/*
+ * Create an iterator over the objects in a SLUB slab cache (given as a struct
+ * kmem_cache *). Slabs are found by scanning the struct page array, so this
+ * takes a while, but iterating is cheap after that. For a core dump, the slabs
+ * of every cache are found by the first scan and cached; a live program is
+ * scanned every time. Allocated objects, free objects, or both may be
+ * selected.
+ */
+struct drgn_error *
+linux_slab_cache_iterator_create(const struct drgn_object *slab_cache,
+				 bool allocated, bool free_objects,
+				 struct linux_slab_cache_iterator **ret);
+
+void linux_slab_cache_iterator_destroy(struct linux_slab_cache_iterator *it);
+
+/*
+ * Get the addresses of the selected objects in the next slab(s) that have any.
+ * The returned array is valid until the next call. Zero objects are returned
+ * once the iterator is exhausted.
+ */
+struct drgn_error *
+linux_slab_cache_iterator_next(struct linux_slab_cache_iterator *it,
+			       const uint64_t **objects_ret,
+			       size_t *num_objects_ret);
+
+/** Slab object containing an address. */
+struct linux_slab_object_info {
+	/** Address of the <tt>struct kmem_cache</tt>. */
+	uint64_t slab_cache;
+	/** Address of the <tt>struct slab</tt> (or <tt>struct page</tt>). */
+	uint64_t slab;
+	/** Start address of the object. */
+	uint64_t address;
+	/** Whether the object is allocated (i.e., not on a freelist). */
+	bool allocated;
+};
+
+/*
+ * Find the SLUB object containing an address. If the address is not in a slab
+ * object, *found_ret is set to false.
+ */
+struct drgn_error *
+linux_helper_slab_object_info(struct drgn_program *prog, uint64_t address,
+			      struct linux_slab_object_info *ret,
+			      bool *found_ret);
+
+/** Column of a @ref linux_task_table. */
+struct linux_task_column {
+	/** Whether this column holds character arrays instead of integers. */
+	bool is_string;
+	/** Whether the integers in this column are signed. */
+	bool is_signed;
+	/** Size of each character array in a string column. */
+	uint64_t string_size;
+	/**
+	 * Whether the field could be read for each task (e.g., false if a
+	 * pointer on the way to it was @c NULL).
+	 */
+	bool *valid;
+	/** Integer values if this is not a string column. */
+	uint64_t *values;
+	/** @c string_size bytes per task if this is a string column. */
+	char *strings;
+};
+
+/** Snapshot of fields of every task in a PID namespace. */
+struct linux_task_table {
+	/** Addresses of the <tt>struct task_struct</tt>s. */
+	uint64_t *tasks;
+	size_t num_tasks;
+	/** One column per requested field. */
+	struct linux_task_column *columns;
+	size_t num_columns;
+};
+
+/*
+ * Get every task in a PID namespace (given as a struct pid_namespace *) and
+ * read the given fields of each one. A field is a member designator of struct
+ * task_struct which may also follow pointers with "->", e.g.,
+ * "mm->rss_stat.count[0].counter". Fields must be integers, pointers, or
+ * character arrays. The table should be freed with linux_task_table_deinit().
+ */
+struct drgn_error *linux_helper_task_table(const struct drgn_object *ns,
+					   const char * const *fields,
+					   size_t num_fields,
+					   struct linux_task_table *ret);
+
+void linux_task_table_deinit(struct linux_task_table *table);
+
+/** Word in kernel memory that points into the direct mapping. */
+struct linux_pointer_ref {
+	/** Value of the word, i.e., the address that it points to. */
+	uint64_t value;
+	/** Direct mapping address of the word. */
+	uint64_t location;
+};
+
+/**
+ * Index of every aligned word in physical memory that looks like a pointer into
+ * the direct mapping, sorted by value.
+ */
+struct linux_pointer_index;
+
+/*
+ * Build a pointer index by scanning all of physical memory up to max_pfn. This
+ * reads every page, so it is slow, but it only needs to be done once per core
+ * dump if the index is saved with linux_pointer_index_save().
+ */
+struct drgn_error *linux_pointer_index_create(struct drgn_program *prog,
+					      struct linux_pointer_index **ret);
+
+/*
+ * Load a pointer index saved by linux_pointer_index_save(). The file is mapped
+ * rather than read. It is an error if the index was built for a kernel with a
+ * different direct mapping or from a different core dump.
+ */
+struct drgn_error *linux_pointer_index_load(struct drgn_program *prog,
+					    const char *path,
+					    struct linux_pointer_index **ret);
+
+struct drgn_error *
+linux_pointer_index_save(const struct linux_pointer_index *index,
+			 const char *path);
+
+void linux_pointer_index_destroy(struct linux_pointer_index *index);
+
+/* Get the number of pointers in a pointer index. */
+size_t linux_pointer_index_size(const struct linux_pointer_index *index);
+
+/*
+ * Find the pointers whose values are in [start, end), sorted by value and then
+ * location. The returned array is valid until the index is destroyed.
+ */
+void linux_pointer_index_find(const struct linux_pointer_index *index,
+			      uint64_t start, uint64_t end,
+			      const struct linux_pointer_ref **refs_ret,
+			      size_t *num_refs_ret);
+
+/** Entry in a task's file descriptor table. */
+struct linux_task_file {
+	/** File descriptor number. */
+	uint64_t fd;
+	/**
+	 * Address of the <tt>struct file</tt>. This may be 0 if the file
+	 * descriptor is allocated but not installed yet.
+	 */
+	uint64_t file;
+};
+
+/*
+ * Get every open file descriptor of a task (given as a struct task_struct *),
+ * sorted by file descriptor. A task without a file table (e.g., a zombie) has
+ * no files. The array should be freed with free().
+ */
+struct drgn_error *linux_helper_task_files(const struct drgn_object *task,
+					   struct linux_task_file **files_ret,
+					   size_t *num_files_ret);
+
+/*
+ * Get the full path of a dentry given a mount (as the addresses of a struct
+ * vfsmount and a struct dentry), like the kernel's d_path(). The returned
+ * string should be freed with free().
+ */
+struct drgn_error *linux_helper_d_path(struct drgn_program *prog,
+				       uint64_t vfsmnt, uint64_t dentry,
+				       char **ret, size_t *len_ret);
+
+/*
+ * Get the path of a dentry (given as the address of a struct dentry) from the
+ * root of its filesystem, without a leading slash. The returned string should
+ * be freed with free().
+ */
+struct drgn_error *linux_helper_dentry_path(struct drgn_program *prog,
+					    uint64_t dentry, char **ret,
+					    size_t *len_ret);
+
+/** Counter read for each cgroup in a @ref linux_cgroup_walk. */
+struct linux_cgroup_counter {
+	/** Whether the counter is signed. */
+	bool is_signed;
+	/**
+	 * Whether the counter could be read for each cgroup (e.g., false if a
+	 * pointer on the way to it was @c NULL).
+	 */
+	bool *valid;
+	/** Value for each cgroup. */
+	uint64_t *values;
+	/**
+	 * Sum of the valid values for each cgroup and all of its online
+	 * descendants.
+	 */
+	uint64_t *totals;
+};
+
+/** Snapshot of the online cgroups in a cgroup subtree. */
+struct linux_cgroup_walk {
+	/**
+	 * Addresses of the <tt>struct cgroup_subsys_state</tt>s, in pre-order.
+	 */
+	uint64_t *csses;
+	size_t num_csses;
+	/** Null-terminated path of each cgroup, stored back to back. */
+	char *paths;
+	/** Offset of each path in @ref paths. */
+	size_t *path_offsets;
+	/** One entry per requested counter. */
+	struct linux_cgroup_counter *counters;
+	size_t num_counters;
+};
+
+/*
+ * Walk the online descendants of a css (given as a struct cgroup_subsys_state
+ * *), including itself, in pre-order, like css_for_each_descendant_pre(). Each
+ * path is built from its parent's, so kernfs is only walked for the root.
+ *
+ * Counters are fields of the structure that each css is embedded in, given by
+ * container_type and member (e.g., "struct cgroup" and "self"), with the same
+ * syntax as linux_helper_task_table(). They must be integers or pointers. The
+ * walk should be freed with linux_cgroup_walk_deinit().
+ */
+struct drgn_error *linux_helper_cgroup_walk(const struct drgn_object *css,
+					    const char *container_type,
+					    const char *member,
+					    const char * const *counters,
+					    size_t num_counters,
+					    struct linux_cgroup_walk *ret);
+
+void linux_cgroup_walk_deinit(struct linux_cgroup_walk *walk);
+
+/** Hash table of sockets for linux_helper_socket_table(). */
+enum linux_socket_protocol {
+	/** TCP listening and established hash tables (tcp_hashinfo). */
+	LINUX_SOCKET_TCP,
+	/** UDP hash table (udp_table). */
+	LINUX_SOCKET_UDP,
+};
+
+/* Linux address families, which are the same on every architecture. */
+#define LINUX_AF_INET 2
+#define LINUX_AF_INET6 10
+
+/** Socket in a @ref linux_socket_protocol hash table. */
+struct linux_socket {
+	/**
+	 * Address of the <tt>struct sock</tt>, or of the <tt>struct
+	 * sock_common</tt> at the start of a time-wait or request socket.
+	 */
+	uint64_t sk;
+	/**
+	 * Inode number of the socket's file, or 0 if it doesn't have one (e.g.,
+	 * time-wait and request sockets).
+	 */
+	uint64_t inode;
+	/**
+	 * Local and remote addresses in network byte order. Only the first 4
+	 * bytes are used for @c AF_INET.
+	 */
+	uint8_t saddr[16], daddr[16];
+	/** Address family. */
+	uint16_t family;
+	/** Local and remote ports in host byte order. */
+	uint16_t sport, dport;
+	/** TCP state (also used for UDP sockets). */
+	uint8_t state;
+};
+
+/*
+ * Get every socket in the hash tables for a protocol: for TCP, the listening
+ * hash table followed by the established hash table. Chains may be hlists or
+ * nulls lists. The array should be freed with free().
+ */
+struct drgn_error *
+linux_helper_socket_table(struct drgn_program *prog,
+			  enum linux_socket_protocol protocol,
+			  struct linux_socket **sockets_ret,
+			  size_t *num_sockets_ret);
+
 #endif /* DRGN_HELPERS_H */
@@ -0,0 +1,485 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <byteswap.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drgn.h"
+#include "error.h"
+#include "kallsyms.h"
+#include "program.h"
+#include "string_builder.h"
+#include "symbol.h"
+#include "util.h"
+#include "vector.h"
+
+DEFINE_VECTOR_FUNCTIONS(drgn_symbol_vector)
+
+/* Symbol before it is sorted and its name is resolved. */
+struct kallsyms_entry {
+	/* Offset of the name in the string table. */
+	size_t name;
+	uint64_t address;
+};
+
+DEFINE_VECTOR(kallsyms_entry_vector, struct kallsyms_entry)
+
+static int kallsyms_entry_cmp(const void *_a, const void *_b)
+{
+	const struct kallsyms_entry *a = _a, *b = _b;
+	if (a->address != b->address)
+		return a->address < b->address ? -1 : 1;
+	/* Names are added in order, so this keeps the original order. */
+	if (a->name != b->name)
+		return a->name < b->name ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Create a drgn_kallsyms from a string table and its symbols. On success, the
+ * string table is owned by the returned drgn_kallsyms.
+ */
+static struct drgn_error *
+drgn_kallsyms_create(struct string_builder *strtab,
+		     struct kallsyms_entry_vector *entries,
+		     struct drgn_kallsyms **ret)
+{
+	struct drgn_error *err;
+
+	if (!entries->size) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "kernel symbol table is empty");
+	}
+	qsort(entries->data, entries->size, sizeof(entries->data[0]),
+	      kallsyms_entry_cmp);
+
+	struct drgn_kallsyms *kallsyms = malloc(sizeof(*kallsyms));
+	if (!kallsyms)
+		return &drgn_enomem;
+	drgn_symbol_vector_init(&kallsyms->symbols);
+	drgn_symbol_name_index_init(&kallsyms->by_name);
+	struct drgn_symbol_vector by_name = VECTOR_INIT;
+	if (!drgn_symbol_vector_reserve(&kallsyms->symbols, entries->size) ||
+	    !drgn_symbol_vector_reserve(&by_name, entries->size)) {
+		err = &drgn_enomem;
+		goto err;
+	}
+
+	/* The string table won't be resized anymore, so the names are stable. */
+	char *str = realloc(strtab->str, strtab->len);
+	if (str)
+		strtab->str = str;
+	for (size_t i = 0; i < entries->size; ) {
+		/* Each symbol extends to the next symbol at a higher address. */
+		size_t next = i + 1;
+		while (next < entries->size &&
+		       entries->data[next].address == entries->data[i].address)
+			next++;
+		uint64_t size = 0;
+		if (next < entries->size) {
+			size = (entries->data[next].address -
+				entries->data[i].address);
+		}
+		for (; i < next; i++) {
+			kallsyms->symbols.data[i] = (struct drgn_symbol){
+				.name = strtab->str + entries->data[i].name,
+				.address = entries->data[i].address,
+				.size = size,
+			};
+		}
+	}
+	kallsyms->symbols.size = entries->size;
+
+	memcpy(by_name.data, kallsyms->symbols.data,
+	       entries->size * sizeof(by_name.data[0]));
+	by_name.size = entries->size;
+	err = drgn_symbol_name_index_build(&kallsyms->by_name, &by_name);
+	if (err)
+		goto err;
+	drgn_symbol_vector_deinit(&by_name);
+
+	kallsyms->strtab = strtab->str;
+	strtab->str = NULL;
+	strtab->len = strtab->capacity = 0;
+	*ret = kallsyms;
+	return NULL;
+
+err:
+	drgn_symbol_vector_deinit(&by_name);
+	drgn_symbol_name_index_deinit(&kallsyms->by_name);
+	drgn_symbol_vector_deinit(&kallsyms->symbols);
+	free(kallsyms);
+	return err;
+}
+
+void drgn_kallsyms_destroy(struct drgn_kallsyms *kallsyms)
+{
+	if (kallsyms) {
+		drgn_symbol_name_index_deinit(&kallsyms->by_name);
+		drgn_symbol_vector_deinit(&kallsyms->symbols);
+		free(kallsyms->strtab);
+		free(kallsyms);
+	}
+}
+
+static struct drgn_error *read_whole_file(const char *path,
+					  struct string_builder *sb)
+{
+	struct drgn_error *err = NULL;
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+	/* Files in /proc don't have a meaningful size, so read until EOF. */
+	for (;;) {
+		if (!string_builder_reserve(sb, sb->len + 65536)) {
+			err = &drgn_enomem;
+			break;
+		}
+		ssize_t r = read(fd, sb->str + sb->len, sb->capacity - sb->len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			err = drgn_error_create_os("read", errno, path);
+			break;
+		}
+		if (r == 0)
+			break;
+		sb->len += r;
+	}
+	close(fd);
+	return err;
+}
+
+struct drgn_error *drgn_kallsyms_from_proc(const char *path,
+					   struct drgn_kallsyms **ret)
+{
+	struct drgn_error *err;
+	struct string_builder strtab = {};
+	struct kallsyms_entry_vector entries = VECTOR_INIT;
+
+	/*
+	 * The file is used as the string table; the names are null-terminated
+	 * in place.
+	 */
+	err = read_whole_file(path, &strtab);
+	if (err)
+		goto out;
+	if (!string_builder_appendc(&strtab, '\0')) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	bool have_addresses = false;
+	char *line = strtab.str, *end = strtab.str + strtab.len - 1;
+	while (line < end) {
+		char *newline = memchr(line, '\n', end - line);
+		if (newline)
+			*newline = '\0';
+		else
+			newline = end;
+
+		/* Lines look like "address type name\t[module]". */
+		char *p;
+		errno = 0;
+		uint64_t address = strtoull(line, &p, 16);
+		if (errno || p == line || p[0] != ' ' || !p[1] || p[2] != ' ')
+			goto invalid;
+		char *name = p + 3;
+		size_t len = strcspn(name, "\t ");
+		if (!len)
+			goto invalid;
+		name[len] = '\0';
+
+		struct kallsyms_entry *entry =
+			kallsyms_entry_vector_append_entry(&entries);
+		if (!entry) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		entry->name = name - strtab.str;
+		entry->address = address;
+		if (address)
+			have_addresses = true;
+		line = newline + 1;
+	}
+	if (!have_addresses) {
+		err = drgn_error_format(DRGN_ERROR_OTHER,
+					"%s does not contain addresses (check kernel.kptr_restrict)",
+					path);
+		goto out;
+	}
+	err = drgn_kallsyms_create(&strtab, &entries, ret);
+	goto out;
+
+invalid:
+	err = drgn_error_format(DRGN_ERROR_OTHER, "could not parse %s", path);
+out:
+	kallsyms_entry_vector_deinit(&entries);
+	free(strtab.str);
+	return err;
+}
+
+static struct drgn_error *kallsyms_invalid(const char *what)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER, "invalid %s", what);
+}
+
+/*
+ * Read a kallsyms table whose size isn't recorded anywhere. It is bounded by
+ * the next table in the kernel image.
+ */
+static struct drgn_error *read_kallsyms_table(struct drgn_program *prog,
+					      uint64_t address,
+					      uint64_t next_address,
+					      uint64_t max_size,
+					      const char *name,
+					      unsigned char **buf_ret,
+					      size_t *size_ret)
+{
+	struct drgn_error *err;
+
+	if (next_address <= address || next_address - address > max_size) {
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "could not determine size of %s",
+					 name);
+	}
+	size_t size = next_address - address;
+	unsigned char *buf = malloc(size);
+	if (!buf)
+		return &drgn_enomem;
+	err = drgn_program_read_memory(prog, buf, address, size, false);
+	if (err) {
+		free(buf);
+		return err;
+	}
+	*buf_ret = buf;
+	*size_ret = size;
+	return NULL;
+}
+
+/*
+ * Decode the compressed symbol names. See kallsyms_expand_symbol() in the
+ * kernel's kernel/kallsyms.c.
+ */
+static struct drgn_error *
+kallsyms_decode_names(const unsigned char *names, size_t names_size,
+		      const char *token_table, size_t token_table_size,
+		      const uint16_t token_index[256], uint32_t num_syms,
+		      struct string_builder *strtab,
+		      struct kallsyms_entry_vector *entries)
+{
+	for (int i = 0; i < 256; i++) {
+		if (token_index[i] >= token_table_size ||
+		    !memchr(token_table + token_index[i], '\0',
+			    token_table_size - token_index[i]))
+			return kallsyms_invalid("kallsyms_token_index");
+	}
+
+	if (!kallsyms_entry_vector_reserve(entries, num_syms))
+		return &drgn_enomem;
+	size_t pos = 0;
+	for (uint32_t i = 0; i < num_syms; i++) {
+		if (pos >= names_size)
+			return kallsyms_invalid("kallsyms_names");
+		size_t len = names[pos++];
+		/* Since Linux 6.1, long names have a two-byte length. */
+		if (len & 0x80) {
+			if (pos >= names_size)
+				return kallsyms_invalid("kallsyms_names");
+			len = (len & 0x7f) | ((size_t)names[pos++] << 7);
+		}
+		if (len > names_size - pos)
+			return kallsyms_invalid("kallsyms_names");
+
+		size_t start = strtab->len;
+		for (size_t j = 0; j < len; j++) {
+			if (!string_builder_append(strtab,
+						   token_table +
+						   token_index[names[pos + j]]))
+				return &drgn_enomem;
+		}
+		pos += len;
+		/* The first character is the symbol type. */
+		if (strtab->len - start < 2)
+			return kallsyms_invalid("kallsyms_names");
+		if (!string_builder_appendc(strtab, '\0'))
+			return &drgn_enomem;
+		entries->data[i].name = start + 1;
+	}
+	entries->size = num_syms;
+	return NULL;
+}
+
+static struct drgn_error *
+kallsyms_read_addresses(struct drgn_program *prog, uint32_t num_syms,
+			struct kallsyms_entry_vector *entries)
+{
+	struct drgn_error *err;
+	const struct vmcoreinfo *vmcoreinfo = &prog->vmcoreinfo;
+	bool bswap;
+	err = drgn_program_bswap(prog, &bswap);
+	if (err)
+		return err;
+
+	if (vmcoreinfo->kallsyms_offsets) {
+		uint64_t relative_base;
+		err = drgn_program_read_word(prog,
+					     vmcoreinfo->kallsyms_relative_base,
+					     false, &relative_base);
+		if (err)
+			return err;
+		int32_t *offsets = malloc_array(num_syms, sizeof(*offsets));
+		if (!offsets)
+			return &drgn_enomem;
+		err = drgn_program_read_memory(prog, offsets,
+					       vmcoreinfo->kallsyms_offsets,
+					       num_syms * sizeof(*offsets),
+					       false);
+		if (err) {
+			free(offsets);
+			return err;
+		}
+		/*
+		 * With CONFIG_KALLSYMS_ABSOLUTE_PERCPU, non-negative offsets
+		 * are absolute (per-CPU) addresses and negative offsets are
+		 * relative to relative_base - 1. Otherwise, offsets are
+		 * unsigned and relative to relative_base. The kernel image is
+		 * much smaller than 2 GB, so a negative offset can only occur
+		 * in the former case.
+		 */
+		bool absolute_percpu = false;
+		for (uint32_t i = 0; i < num_syms; i++) {
+			if (bswap)
+				offsets[i] = bswap_32(offsets[i]);
+			if (offsets[i] < 0)
+				absolute_percpu = true;
+		}
+		for (uint32_t i = 0; i < num_syms; i++) {
+			uint64_t address;
+			if (!absolute_percpu)
+				address = relative_base + (uint32_t)offsets[i];
+			else if (offsets[i] >= 0)
+				address = offsets[i];
+			else
+				address = relative_base - 1 - offsets[i];
+			entries->data[i].address = address;
+		}
+		free(offsets);
+		return NULL;
+	}
+
+	bool is_64_bit;
+	err = drgn_program_is_64_bit(prog, &is_64_bit);
+	if (err)
+		return err;
+	size_t word_size = is_64_bit ? 8 : 4;
+	void *addresses = malloc_array(num_syms, word_size);
+	if (!addresses)
+		return &drgn_enomem;
+	err = drgn_program_read_memory(prog, addresses,
+				       vmcoreinfo->kallsyms_addresses,
+				       num_syms * word_size, false);
+	if (err) {
+		free(addresses);
+		return err;
+	}
+	for (uint32_t i = 0; i < num_syms; i++) {
+		uint64_t address;
+		if (is_64_bit) {
+			address = ((uint64_t *)addresses)[i];
+			if (bswap)
+				address = bswap_64(address);
+		} else {
+			uint32_t tmp = ((uint32_t *)addresses)[i];
+			address = bswap ? bswap_32(tmp) : tmp;
+		}
+		entries->data[i].address = address;
+	}
+	free(addresses);
+	return NULL;
+}
+
+struct drgn_error *drgn_kallsyms_from_vmcoreinfo(struct drgn_program *prog,
+						 struct drgn_kallsyms **ret)
+{
+	struct drgn_error *err;
+	const struct vmcoreinfo *vmcoreinfo = &prog->vmcoreinfo;
+
+	if (!vmcoreinfo->kallsyms_names || !vmcoreinfo->kallsyms_num_syms ||
+	    !vmcoreinfo->kallsyms_token_table ||
+	    !vmcoreinfo->kallsyms_token_index ||
+	    (!(vmcoreinfo->kallsyms_offsets &&
+	       vmcoreinfo->kallsyms_relative_base) &&
+	     !vmcoreinfo->kallsyms_addresses)) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "VMCOREINFO does not contain kallsyms symbols");
+	}
+
+	uint32_t num_syms;
+	err = drgn_program_read_u32(prog, vmcoreinfo->kallsyms_num_syms, false,
+				    &num_syms);
+	if (err)
+		return err;
+	/* Sanity check so that a corrupt core doesn't make us run amok. */
+	if (num_syms == 0 || num_syms > 16 * 1024 * 1024)
+		return kallsyms_invalid("kallsyms_num_syms");
+
+	uint16_t token_index[256];
+	err = drgn_program_read_memory(prog, token_index,
+				       vmcoreinfo->kallsyms_token_index,
+				       sizeof(token_index), false);
+	if (err)
+		return err;
+	bool bswap;
+	err = drgn_program_bswap(prog, &bswap);
+	if (err)
+		return err;
+	if (bswap) {
+		for (int i = 0; i < 256; i++)
+			token_index[i] = bswap_16(token_index[i]);
+	}
+
+	/*
+	 * The names are followed by kallsyms_markers and then
+	 * kallsyms_token_table, which is followed by kallsyms_token_index.
+	 */
+	unsigned char *token_table, *names;
+	size_t token_table_size, names_size;
+	err = read_kallsyms_table(prog, vmcoreinfo->kallsyms_token_table,
+				  vmcoreinfo->kallsyms_token_index, 1024 * 1024,
+				  "kallsyms_token_table", &token_table,
+				  &token_table_size);
+	if (err)
+		return err;
+	err = read_kallsyms_table(prog, vmcoreinfo->kallsyms_names,
+				  vmcoreinfo->kallsyms_token_table,
+				  256 * 1024 * 1024, "kallsyms_names", &names,
+				  &names_size);
+	if (err)
+		goto out_token_table;
+
+	struct string_builder strtab = {};
+	struct kallsyms_entry_vector entries = VECTOR_INIT;
+	err = kallsyms_decode_names(names, names_size,
+				    (const char *)token_table,
+				    token_table_size, token_index, num_syms,
+				    &strtab, &entries);
+	if (err)
+		goto out;
+	err = kallsyms_read_addresses(prog, num_syms, &entries);
+	if (err)
+		goto out;
+	err = drgn_kallsyms_create(&strtab, &entries, ret);
+out:
+	kallsyms_entry_vector_deinit(&entries);
+	free(strtab.str);
+	free(names);
+out_token_table:
+	free(token_table);
+	return err;
+}
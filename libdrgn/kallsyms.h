@@ -0,0 +1,97 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Linux kernel symbol table.
+ *
+ * See @ref Kallsyms.
+ */
+
+#ifndef DRGN_KALLSYMS_H
+#define DRGN_KALLSYMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drgn.h"
+#include "symbol.h"
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup Kallsyms Kernel symbol table
+ *
+ * Symbol table of the Linux kernel, used when there is no ELF symbol table for
+ * an address or name (e.g., because vmlinux is not available).
+ *
+ * The symbol table can come from @c /proc/kallsyms for the running kernel or be
+ * decoded from the compressed @c kallsyms_* tables in kernel memory, which are
+ * found using VMCOREINFO (Linux 6.0 and newer). The kernel doesn't record
+ * symbol sizes, so each symbol is assumed to extend to the next symbol.
+ *
+ * @{
+ */
+
+/** Parsed and indexed Linux kernel symbol table. */
+struct drgn_kallsyms {
+	/** Null-terminated symbol names. */
+	char *strtab;
+	/** Symbols sorted by address. */
+	struct drgn_symbol_vector symbols;
+	/** Symbols indexed by name. */
+	struct drgn_symbol_name_index by_name;
+};
+
+/**
+ * Parse a file in the format of @c /proc/kallsyms.
+ *
+ * @param[out] ret Returned symbol table, which should be destroyed with @ref
+ * drgn_kallsyms_destroy().
+ */
+struct drgn_error *drgn_kallsyms_from_proc(const char *path,
+					   struct drgn_kallsyms **ret);
+
+/**
+ * Decode the symbol table from the memory of a Linux kernel program using the
+ * symbols in its VMCOREINFO.
+ *
+ * @param[out] ret Returned symbol table, which should be destroyed with @ref
+ * drgn_kallsyms_destroy().
+ */
+struct drgn_error *drgn_kallsyms_from_vmcoreinfo(struct drgn_program *prog,
+						 struct drgn_kallsyms **ret);
+
+/** Destroy a @ref drgn_kallsyms. */
+void drgn_kallsyms_destroy(struct drgn_kallsyms *kallsyms);
+
+/**
+ * Find the symbol containing an address in a @ref drgn_kallsyms.
+ *
+ * @return The symbol, or @c NULL if no symbol contains the address.
+ */
+static inline const struct drgn_symbol *
+drgn_kallsyms_find_by_address(struct drgn_kallsyms *kallsyms, uint64_t address)
+{
+	return drgn_symbol_search_address(kallsyms->symbols.data,
+					  kallsyms->symbols.size, address);
+}
+
+/**
+ * Find the symbols with the given name in a @ref drgn_kallsyms.
+ *
+ * @param[out] count_ret Returned number of symbols.
+ * @return Symbols with the given name in address order, or @c NULL if there
+ * are none.
+ */
+static inline struct drgn_symbol *
+drgn_kallsyms_find_by_name(struct drgn_kallsyms *kallsyms, const char *name,
+			   size_t *count_ret)
+{
+	return drgn_symbol_name_index_find(&kallsyms->by_name, name, count_ret);
+}
+
+/** @} */
+
+#endif /* DRGN_KALLSYMS_H */
@@ -17,6 +17,7 @@ const struct drgn_language drgn_languages[] = {
 		.integer_literal = c_integer_literal,
 		.bool_literal = c_bool_literal,
 		.float_literal = c_float_literal,
+		.compile_expression = c_compile_expression,
 		.op_cast = c_op_cast,
 		.op_bool = c_op_bool,
 		.op_cmp = c_op_cmp,
@@ -44,6 +45,7 @@ const struct drgn_language drgn_languages[] = {
 		.integer_literal = c_integer_literal,
 		.bool_literal = c_bool_literal,
 		.float_literal = c_float_literal,
+		.compile_expression = c_compile_expression,
 		.op_cast = c_op_cast,
 		.op_bool = c_op_bool,
 		.op_cmp = c_op_cmp,
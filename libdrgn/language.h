@@ -52,6 +52,10 @@ typedef struct drgn_error *drgn_float_literal_fn(struct drgn_object *res,
 typedef struct drgn_error *
 drgn_cast_op(struct drgn_object *res, struct drgn_qualified_type qualified_type,
 	     const struct drgn_object *obj);
+typedef struct drgn_error *
+drgn_compile_expression_fn(struct drgn_program *prog, const char *str,
+			   const char * const *params, size_t num_params,
+			   struct drgn_expression *expr);
 typedef struct drgn_error *drgn_bool_op(const struct drgn_object *obj, bool *ret);
 typedef struct drgn_error *drgn_cmp_op(const struct drgn_object *lhs,
 				       const struct drgn_object *rhs, int *ret);
@@ -110,6 +114,13 @@ struct drgn_language {
 	 * floating-point literal in the language.
 	 */
 	drgn_float_literal_fn *float_literal;
+	/**
+	 * Implement @ref drgn_program_compile_expression().
+	 *
+	 * This should parse @p str and append its nodes to @p expr (see @ref
+	 * ExpressionInternals). Object and type names should be resolved here.
+	 */
+	drgn_compile_expression_fn *compile_expression;
 	drgn_cast_op *op_cast;
 	drgn_bool_op *op_bool;
 	drgn_cmp_op *op_cmp;
@@ -136,6 +147,7 @@ drgn_bit_offset_fn c_bit_offset;
 drgn_integer_literal_fn c_integer_literal;
 drgn_bool_literal_fn c_bool_literal;
 drgn_float_literal_fn c_float_literal;
+drgn_compile_expression_fn c_compile_expression;
 drgn_cast_op c_op_cast;
 drgn_bool_op c_op_bool;
 drgn_cmp_op c_op_cmp;
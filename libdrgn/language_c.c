@@ -12,6 +12,7 @@
 
 #include "bitops.h"
 #include "error.h"
+#include "expression.h"
 #include "hash_table.h"
 #include "language.h" // IWYU pragma: associated
 #include "lexer.h"
@@ -1660,7 +1661,8 @@ enum {
 	C_TOKEN_STRUCT,
 	C_TOKEN_UNION,
 	C_TOKEN_ENUM,
-	MAX_KEYWORD_TOKEN = C_TOKEN_ENUM,
+	C_TOKEN_SIZEOF,
+	MAX_KEYWORD_TOKEN = C_TOKEN_SIZEOF,
 	C_TOKEN_LPAREN,
 	C_TOKEN_RPAREN,
 	C_TOKEN_LBRACKET,
@@ -1669,6 +1671,29 @@ enum {
 	C_TOKEN_DOT,
 	C_TOKEN_NUMBER,
 	C_TOKEN_IDENTIFIER,
+	/* The rest are only used for expressions. */
+	C_TOKEN_ARROW,
+	C_TOKEN_PLUS,
+	C_TOKEN_MINUS,
+	C_TOKEN_SLASH,
+	C_TOKEN_PERCENT,
+	C_TOKEN_LSHIFT,
+	C_TOKEN_RSHIFT,
+	C_TOKEN_LT,
+	C_TOKEN_GT,
+	C_TOKEN_LE,
+	C_TOKEN_GE,
+	C_TOKEN_EQ,
+	C_TOKEN_NE,
+	C_TOKEN_AMPERSAND,
+	C_TOKEN_PIPE,
+	C_TOKEN_CARET,
+	C_TOKEN_TILDE,
+	C_TOKEN_EXCLAMATION,
+	C_TOKEN_LOGICAL_AND,
+	C_TOKEN_LOGICAL_OR,
+	C_TOKEN_QUESTION,
+	C_TOKEN_COLON,
 };
 
 static const char *token_spelling[] = {
@@ -1690,6 +1715,7 @@ static const char *token_spelling[] = {
 	[C_TOKEN_STRUCT] = "struct",
 	[C_TOKEN_UNION] = "union",
 	[C_TOKEN_ENUM] = "enum",
+	[C_TOKEN_SIZEOF] = "sizeof",
 };
 
 DEFINE_HASH_MAP(c_keyword_map, struct string, int, string_hash_pair, string_eq)
@@ -1754,6 +1780,96 @@ struct drgn_error *drgn_lexer_c(struct drgn_lexer *lexer,
 		token->kind = C_TOKEN_DOT;
 		p++;
 		break;
+	case '+':
+		token->kind = C_TOKEN_PLUS;
+		p++;
+		break;
+	case '-':
+		if (*++p == '>') {
+			token->kind = C_TOKEN_ARROW;
+			p++;
+		} else {
+			token->kind = C_TOKEN_MINUS;
+		}
+		break;
+	case '/':
+		token->kind = C_TOKEN_SLASH;
+		p++;
+		break;
+	case '%':
+		token->kind = C_TOKEN_PERCENT;
+		p++;
+		break;
+	case '<':
+		if (*++p == '<') {
+			token->kind = C_TOKEN_LSHIFT;
+			p++;
+		} else if (*p == '=') {
+			token->kind = C_TOKEN_LE;
+			p++;
+		} else {
+			token->kind = C_TOKEN_LT;
+		}
+		break;
+	case '>':
+		if (*++p == '>') {
+			token->kind = C_TOKEN_RSHIFT;
+			p++;
+		} else if (*p == '=') {
+			token->kind = C_TOKEN_GE;
+			p++;
+		} else {
+			token->kind = C_TOKEN_GT;
+		}
+		break;
+	case '=':
+		if (*++p != '=') {
+			return drgn_error_create(DRGN_ERROR_SYNTAX,
+						 "assignment is not supported");
+		}
+		token->kind = C_TOKEN_EQ;
+		p++;
+		break;
+	case '!':
+		if (*++p == '=') {
+			token->kind = C_TOKEN_NE;
+			p++;
+		} else {
+			token->kind = C_TOKEN_EXCLAMATION;
+		}
+		break;
+	case '&':
+		if (*++p == '&') {
+			token->kind = C_TOKEN_LOGICAL_AND;
+			p++;
+		} else {
+			token->kind = C_TOKEN_AMPERSAND;
+		}
+		break;
+	case '|':
+		if (*++p == '|') {
+			token->kind = C_TOKEN_LOGICAL_OR;
+			p++;
+		} else {
+			token->kind = C_TOKEN_PIPE;
+		}
+		break;
+	case '^':
+		token->kind = C_TOKEN_CARET;
+		p++;
+		break;
+	case '~':
+		token->kind = C_TOKEN_TILDE;
+		p++;
+		break;
+	case '?':
+		token->kind = C_TOKEN_QUESTION;
+		p++;
+		break;
+	case ':':
+		token->kind = C_TOKEN_COLON;
+		p++;
+		break;
 	default:
 		if (isalpha(*p) || *p == '_') {
 			struct string key;
@@ -1770,7 +1886,7 @@ struct drgn_error *drgn_lexer_c(struct drgn_lexer *lexer,
 				       C_TOKEN_IDENTIFIER);
 		} else if ('0' <= *p && *p <= '9') {
 			token->kind = C_TOKEN_NUMBER;
-			if (*p++ == '0' && *p == 'x') {
+			if (*p++ == '0' && (*p == 'x' || *p == 'X')) {
 				p++;
 				while (('0' <= *p && *p <= '9') ||
 				       ('a' <= *p && *p <= 'f') ||
@@ -1785,7 +1901,20 @@ struct drgn_error *drgn_lexer_c(struct drgn_lexer *lexer,
 				while ('0' <= *p && *p <= '9')
 					p++;
 			}
-			if (isalpha(*p) || *p == '_') {
+			/* Integer suffix: u, l, ll, ul, ull, lu, or llu. */
+			bool is_unsigned = false;
+			if (*p == 'u' || *p == 'U') {
+				is_unsigned = true;
+				p++;
+			}
+			if (*p == 'l' || *p == 'L') {
+				if (p[1] == p[0])
+					p++;
+				p++;
+				if (!is_unsigned && (*p == 'u' || *p == 'U'))
+					p++;
+			}
+			if (isalnum(*p) || *p == '_') {
 				return drgn_error_create(DRGN_ERROR_SYNTAX,
 							 "invalid number");
 			}
@@ -1809,7 +1938,7 @@ static struct drgn_error *c_token_to_u64(const struct drgn_token *token,
 
 	assert(token->kind == C_TOKEN_NUMBER);
 	if (token->len > 2 && token->value[0] == '0' &&
-	    token->value[1] == 'x') {
+	    (token->value[1] == 'x' || token->value[1] == 'X')) {
 		for (i = 2; i < token->len; i++) {
 			char c = token->value[i];
 			int digit;
@@ -1817,9 +1946,11 @@ static struct drgn_error *c_token_to_u64(const struct drgn_token *token,
 			if ('0' <= c && c <= '9')
 				digit = c - '0';
 			else if ('a' <= c && c <= 'f')
-				digit = c - 'a';
-			else /* ('A' <= c && c <= 'F') */
-				digit = c - 'A';
+				digit = c - 'a' + 10;
+			else if ('A' <= c && c <= 'F')
+				digit = c - 'A' + 10;
+			else /* Suffix. */
+				break;
 			if (x > UINT64_MAX / 16)
 				goto overflow;
 			x *= 16;
@@ -1831,6 +1962,8 @@ static struct drgn_error *c_token_to_u64(const struct drgn_token *token,
 		for (i = 1; i < token->len; i++) {
 			int digit;
 
+			if (token->value[i] < '0' || token->value[i] > '9')
+				break;
 			digit = token->value[i] - '0';
 			if (x > UINT64_MAX / 8)
 				goto overflow;
@@ -1843,6 +1976,8 @@ static struct drgn_error *c_token_to_u64(const struct drgn_token *token,
 		for (i = 0; i < token->len; i++) {
 			int digit;
 
+			if (token->value[i] < '0' || token->value[i] > '9')
+				break;
 			digit = token->value[i] - '0';
 			if (x > UINT64_MAX / 10)
 				goto overflow;
@@ -2517,6 +2652,29 @@ c_type_from_declarator(struct drgn_program *prog,
 	return err;
 }
 
+/* Parse an abstract declarator and apply it to the type in @p ret. */
+static struct drgn_error *
+c_parse_and_apply_abstract_declarator(struct drgn_program *prog,
+				      struct drgn_lexer *lexer,
+				      struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	struct c_declarator *outer = NULL, *inner;
+
+	err = c_parse_abstract_declarator(prog, lexer, &outer, &inner);
+	if (err) {
+		while (outer) {
+			struct c_declarator *next;
+
+			next = outer->next;
+			free(outer);
+			outer = next;
+		}
+		return err;
+	}
+	return c_type_from_declarator(prog, outer, ret);
+}
+
 struct drgn_error *c_find_type(struct drgn_program *prog, const char *name,
 			       const char *filename,
 			       struct drgn_qualified_type *ret)
@@ -2535,25 +2693,11 @@ struct drgn_error *c_find_type(struct drgn_program *prog, const char *name,
 	if (err)
 		goto out;
 	if (token.kind != C_TOKEN_EOF) {
-		struct c_declarator *outer = NULL, *inner;
-
 		err = drgn_lexer_push(&lexer, &token);
 		if (err)
-			return err;
-
-		err = c_parse_abstract_declarator(prog, &lexer, &outer, &inner);
-		if (err) {
-			while (outer) {
-				struct c_declarator *next;
-
-				next = outer->next;
-				free(outer);
-				outer = next;
-			}
 			goto out;
-		}
 
-		err = c_type_from_declarator(prog, outer, ret);
+		err = c_parse_and_apply_abstract_declarator(prog, &lexer, ret);
 		if (err)
 			goto out;
 
@@ -2704,14 +2848,14 @@ out:
 	return err;
 }
 
-struct drgn_error *c_integer_literal(struct drgn_object *res, uint64_t uvalue)
+/*
+ * Set an integer literal to the first type in @p types that can represent it.
+ */
+static struct drgn_error *
+c_integer_literal_of_types(struct drgn_object *res, uint64_t uvalue,
+			   const enum drgn_primitive_type *types,
+			   size_t num_types)
 {
-	static const enum drgn_primitive_type types[] = {
-		DRGN_C_TYPE_INT,
-		DRGN_C_TYPE_LONG,
-		DRGN_C_TYPE_LONG_LONG,
-		DRGN_C_TYPE_UNSIGNED_LONG_LONG,
-	};
 	struct drgn_error *err;
 	unsigned int bits;
 	struct drgn_qualified_type qualified_type;
@@ -2719,7 +2863,7 @@ struct drgn_error *c_integer_literal(struct drgn_object *res, uint64_t uvalue)
 
 	bits = fls(uvalue);
 	qualified_type.qualifiers = 0;
-	for (i = 0; i < ARRAY_SIZE(types); i++) {
+	for (i = 0; i < num_types; i++) {
 		err = drgn_program_find_primitive_type(drgn_object_program(res),
 						       types[i],
 						       &qualified_type.type);
@@ -2741,6 +2885,18 @@ struct drgn_error *c_integer_literal(struct drgn_object *res, uint64_t uvalue)
 				 "integer literal is too large");
 }
 
+struct drgn_error *c_integer_literal(struct drgn_object *res, uint64_t uvalue)
+{
+	static const enum drgn_primitive_type types[] = {
+		DRGN_C_TYPE_INT,
+		DRGN_C_TYPE_LONG,
+		DRGN_C_TYPE_LONG_LONG,
+		DRGN_C_TYPE_UNSIGNED_LONG_LONG,
+	};
+	return c_integer_literal_of_types(res, uvalue, types,
+					  ARRAY_SIZE(types));
+}
+
 struct drgn_error *c_bool_literal(struct drgn_object *res, bool bvalue)
 {
 	struct drgn_error *err;
@@ -2769,6 +2925,632 @@ struct drgn_error *c_float_literal(struct drgn_object *res, double fvalue)
 	return drgn_object_set_float(res, qualified_type, fvalue);
 }
 
+/* Identifier that is looked up once the whole expression has been parsed. */
+struct c_expression_identifier {
+	/* Index of the DRGN_EXPR_OBJECT node. */
+	uint32_t node;
+	const char *name;
+	size_t len;
+};
+
+DEFINE_VECTOR(c_expression_identifier_vector, struct c_expression_identifier)
+
+struct c_expression_parser {
+	struct drgn_program *prog;
+	struct drgn_lexer lexer;
+	const char * const *params;
+	size_t num_params;
+	struct drgn_expression *expr;
+	/* Current parsing recursion depth. */
+	int depth;
+	/*
+	 * Identifiers that aren't parameters. They are looked up after parsing
+	 * so that syntax errors are reported before lookup errors.
+	 */
+	struct c_expression_identifier_vector identifiers;
+};
+
+static const struct {
+	/* 0 if the token is not a binary operator. */
+	int precedence;
+	enum drgn_expression_op op;
+} c_binary_operators[] = {
+	[C_TOKEN_LOGICAL_OR] = { 1, DRGN_EXPR_LOGICAL_OR },
+	[C_TOKEN_LOGICAL_AND] = { 2, DRGN_EXPR_LOGICAL_AND },
+	[C_TOKEN_PIPE] = { 3, DRGN_EXPR_OR },
+	[C_TOKEN_CARET] = { 4, DRGN_EXPR_XOR },
+	[C_TOKEN_AMPERSAND] = { 5, DRGN_EXPR_AND },
+	[C_TOKEN_EQ] = { 6, DRGN_EXPR_EQ },
+	[C_TOKEN_NE] = { 6, DRGN_EXPR_NE },
+	[C_TOKEN_LT] = { 7, DRGN_EXPR_LT },
+	[C_TOKEN_GT] = { 7, DRGN_EXPR_GT },
+	[C_TOKEN_LE] = { 7, DRGN_EXPR_LE },
+	[C_TOKEN_GE] = { 7, DRGN_EXPR_GE },
+	[C_TOKEN_LSHIFT] = { 8, DRGN_EXPR_LSHIFT },
+	[C_TOKEN_RSHIFT] = { 8, DRGN_EXPR_RSHIFT },
+	[C_TOKEN_PLUS] = { 9, DRGN_EXPR_ADD },
+	[C_TOKEN_MINUS] = { 9, DRGN_EXPR_SUB },
+	[C_TOKEN_ASTERISK] = { 10, DRGN_EXPR_MUL },
+	[C_TOKEN_SLASH] = { 10, DRGN_EXPR_DIV },
+	[C_TOKEN_PERCENT] = { 10, DRGN_EXPR_MOD },
+};
+
+static const enum drgn_expression_op c_unary_operators[] = {
+	[C_TOKEN_PLUS] = DRGN_EXPR_POS,
+	[C_TOKEN_MINUS] = DRGN_EXPR_NEG,
+	[C_TOKEN_TILDE] = DRGN_EXPR_NOT,
+	[C_TOKEN_EXCLAMATION] = DRGN_EXPR_LOGICAL_NOT,
+	[C_TOKEN_AMPERSAND] = DRGN_EXPR_ADDRESS_OF,
+	[C_TOKEN_ASTERISK] = DRGN_EXPR_DEREFERENCE,
+};
+
+static struct drgn_error *
+c_expression_append_node(struct c_expression_parser *parser,
+			 enum drgn_expression_op op, const uint32_t *operands,
+			 size_t num_operands, uint32_t *ret)
+{
+	struct drgn_expression_node *node;
+
+	node = drgn_expression_append_node(parser->expr, op, ret);
+	if (!node)
+		return &drgn_enomem;
+	memcpy(node->operands, operands, num_operands * sizeof(operands[0]));
+	return NULL;
+}
+
+static struct drgn_error *c_expect_token(struct drgn_lexer *lexer, int kind,
+					 const char *message)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+
+	err = drgn_lexer_pop(lexer, &token);
+	if (err)
+		return err;
+	if (token.kind != kind)
+		return drgn_error_create(DRGN_ERROR_SYNTAX, message);
+	return NULL;
+}
+
+/* Return the index of the parameter named by @p token, or -1 if none. */
+static ssize_t c_expression_find_param(struct c_expression_parser *parser,
+				       const struct drgn_token *token)
+{
+	for (size_t i = 0; i < parser->num_params; i++) {
+		if (strncmp(parser->params[i], token->value, token->len) == 0 &&
+		    parser->params[i][token->len] == '\0')
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Return whether @p token begins a type name, which distinguishes a cast from a
+ * parenthesized expression.
+ */
+static struct drgn_error *
+c_expression_is_type_name(struct c_expression_parser *parser,
+			  const struct drgn_token *token, bool *ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type qualified_type;
+
+	if (MIN_KEYWORD_TOKEN <= token->kind &&
+	    token->kind <= MAX_KEYWORD_TOKEN) {
+		*ret = token->kind != C_TOKEN_SIZEOF;
+		return NULL;
+	}
+	if (token->kind != C_TOKEN_IDENTIFIER ||
+	    c_expression_find_param(parser, token) >= 0) {
+		*ret = false;
+		return NULL;
+	}
+	if ((token->len == sizeof("size_t") - 1 &&
+	     memcmp(token->value, "size_t", token->len) == 0) ||
+	    (token->len == sizeof("ptrdiff_t") - 1 &&
+	     memcmp(token->value, "ptrdiff_t", token->len) == 0)) {
+		*ret = true;
+		return NULL;
+	}
+	err = drgn_program_find_type_impl(parser->prog, DRGN_TYPE_TYPEDEF,
+					  token->value, token->len, NULL,
+					  &qualified_type);
+	if (!err) {
+		*ret = true;
+		return NULL;
+	} else if (err == &drgn_not_found) {
+		*ret = false;
+		return NULL;
+	} else {
+		return err;
+	}
+}
+
+static struct drgn_error *
+c_parse_type_name(struct c_expression_parser *parser,
+		  struct drgn_qualified_type *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+
+	err = c_parse_specifier_qualifier_list(parser->prog, &parser->lexer,
+					       NULL, ret);
+	if (err)
+		return err;
+	err = drgn_lexer_peek(&parser->lexer, &token);
+	if (err)
+		return err;
+	if (token.kind == C_TOKEN_ASTERISK || token.kind == C_TOKEN_LPAREN ||
+	    token.kind == C_TOKEN_LBRACKET) {
+		err = c_parse_and_apply_abstract_declarator(parser->prog,
+							    &parser->lexer,
+							    ret);
+		if (err)
+			return err;
+	}
+	return c_expect_token(&parser->lexer, C_TOKEN_RPAREN,
+			      "expected ')' after type name");
+}
+
+static struct drgn_error *
+c_parse_integer_constant(struct c_expression_parser *parser,
+			 const struct drgn_token *token, uint32_t *ret)
+{
+	static const enum drgn_primitive_type signed_types[] = {
+		DRGN_C_TYPE_INT,
+		DRGN_C_TYPE_LONG,
+		DRGN_C_TYPE_LONG_LONG,
+	};
+	static const enum drgn_primitive_type unsigned_types[] = {
+		DRGN_C_TYPE_UNSIGNED_INT,
+		DRGN_C_TYPE_UNSIGNED_LONG,
+		DRGN_C_TYPE_UNSIGNED_LONG_LONG,
+	};
+	struct drgn_error *err;
+	uint64_t uvalue;
+	struct drgn_expression_node *node;
+
+	err = c_token_to_u64(token, &uvalue);
+	if (err)
+		return err;
+
+	bool is_decimal = token->value[0] != '0';
+	bool is_unsigned = false;
+	int long_count = 0;
+	for (size_t i = token->len; i > 0; i--) {
+		char c = token->value[i - 1];
+		if (c == 'u' || c == 'U')
+			is_unsigned = true;
+		else if (c == 'l' || c == 'L')
+			long_count++;
+		else
+			break;
+	}
+
+	node = drgn_expression_append_node(parser->expr, DRGN_EXPR_OBJECT,
+					   ret);
+	if (!node)
+		return &drgn_enomem;
+	if (is_decimal && !is_unsigned && !long_count)
+		return c_integer_literal(&node->obj, uvalue);
+
+	/*
+	 * C11 6.4.4.1: the type is the first of these that can represent the
+	 * value. Octal and hexadecimal constants may also be unsigned.
+	 */
+	enum drgn_primitive_type types[ARRAY_SIZE(signed_types) +
+					ARRAY_SIZE(unsigned_types)];
+	size_t num_types = 0;
+	for (int i = long_count; i < ARRAY_SIZE(signed_types); i++) {
+		if (!is_unsigned)
+			types[num_types++] = signed_types[i];
+		if (is_unsigned || !is_decimal)
+			types[num_types++] = unsigned_types[i];
+	}
+	return c_integer_literal_of_types(&node->obj, uvalue, types,
+					  num_types);
+}
+
+static struct drgn_error *
+c_parse_identifier(struct c_expression_parser *parser,
+		   const struct drgn_token *token, uint32_t *ret)
+{
+	struct drgn_expression_node *node;
+	ssize_t param;
+
+	param = c_expression_find_param(parser, token);
+	if (param >= 0) {
+		node = drgn_expression_append_node(parser->expr,
+						   DRGN_EXPR_PARAMETER, ret);
+		if (!node)
+			return &drgn_enomem;
+		node->param = param;
+		return NULL;
+	}
+
+	node = drgn_expression_append_node(parser->expr, DRGN_EXPR_OBJECT, ret);
+	if (!node)
+		return &drgn_enomem;
+	struct c_expression_identifier *identifier =
+		c_expression_identifier_vector_append_entry(&parser->identifiers);
+	if (!identifier)
+		return &drgn_enomem;
+	identifier->node = *ret;
+	identifier->name = token->value;
+	identifier->len = token->len;
+	return NULL;
+}
+
+static struct drgn_error *
+c_expression_find_identifiers(struct c_expression_parser *parser)
+{
+	struct drgn_error *err;
+	for (size_t i = 0; i < parser->identifiers.size; i++) {
+		const struct c_expression_identifier *identifier =
+			&parser->identifiers.data[i];
+		struct drgn_expression_node *node =
+			&parser->expr->nodes.data[identifier->node];
+		char *name = strndup(identifier->name, identifier->len);
+		if (!name)
+			return &drgn_enomem;
+		err = drgn_program_find_object(parser->prog, name, NULL,
+					       DRGN_FIND_OBJECT_ANY,
+					       &node->obj);
+		free(name);
+		if (err)
+			return err;
+	}
+	return NULL;
+}
+
+static struct drgn_error *
+c_parse_expression(struct c_expression_parser *parser, uint32_t *ret);
+
+static struct drgn_error *
+c_parse_cast_expression(struct c_expression_parser *parser, uint32_t *ret);
+
+static struct drgn_error *
+c_parse_primary_expression(struct c_expression_parser *parser, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	switch (token.kind) {
+	case C_TOKEN_NUMBER:
+		return c_parse_integer_constant(parser, &token, ret);
+	case C_TOKEN_IDENTIFIER:
+		return c_parse_identifier(parser, &token, ret);
+	case C_TOKEN_LPAREN:
+		err = c_parse_expression(parser, ret);
+		if (err)
+			return err;
+		return c_expect_token(&parser->lexer, C_TOKEN_RPAREN,
+				      "expected ')'");
+	default:
+		return drgn_error_create(DRGN_ERROR_SYNTAX,
+					 "expected expression");
+	}
+}
+
+static struct drgn_error *
+c_parse_postfix_expression(struct c_expression_parser *parser, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+	struct drgn_expression_node *node;
+	uint32_t operands[2];
+
+	err = c_parse_primary_expression(parser, ret);
+	if (err)
+		return err;
+	for (;;) {
+		err = drgn_lexer_pop(&parser->lexer, &token);
+		if (err)
+			return err;
+		operands[0] = *ret;
+		switch (token.kind) {
+		case C_TOKEN_DOT:
+		case C_TOKEN_ARROW: {
+			int op_kind = token.kind;
+
+			err = drgn_lexer_pop(&parser->lexer, &token);
+			if (err)
+				return err;
+			if (token.kind != C_TOKEN_IDENTIFIER) {
+				return drgn_error_format(DRGN_ERROR_SYNTAX,
+							 "expected identifier after '%s'",
+							 op_kind == C_TOKEN_DOT ?
+							 "." : "->");
+			}
+			char *member = strndup(token.value, token.len);
+			if (!member)
+				return &drgn_enomem;
+			node = drgn_expression_append_node(parser->expr,
+							   op_kind == C_TOKEN_DOT ?
+							   DRGN_EXPR_MEMBER :
+							   DRGN_EXPR_MEMBER_DEREFERENCE,
+							   ret);
+			if (!node) {
+				free(member);
+				return &drgn_enomem;
+			}
+			node->operands[0] = operands[0];
+			node->member = member;
+			break;
+		}
+		case C_TOKEN_LBRACKET:
+			err = c_parse_expression(parser, &operands[1]);
+			if (err)
+				return err;
+			err = c_expect_token(&parser->lexer, C_TOKEN_RBRACKET,
+					     "expected ']'");
+			if (err)
+				return err;
+			err = c_expression_append_node(parser,
+						       DRGN_EXPR_SUBSCRIPT,
+						       operands, 2, ret);
+			if (err)
+				return err;
+			break;
+		default:
+			return drgn_lexer_push(&parser->lexer, &token);
+		}
+	}
+}
+
+static struct drgn_error *
+c_parse_sizeof(struct c_expression_parser *parser, uint32_t *ret);
+
+/*
+ * Every cycle in the recursive descent goes through either a cast expression or
+ * the operand of sizeof, so those check the recursion depth.
+ */
+static struct drgn_error *
+c_expression_parser_enter(struct c_expression_parser *parser)
+{
+	if (parser->depth >= DRGN_EXPRESSION_MAX_DEPTH) {
+		return drgn_error_create(DRGN_ERROR_RECURSION,
+					 "maximum expression depth exceeded");
+	}
+	parser->depth++;
+	return NULL;
+}
+
+static struct drgn_error *
+c_parse_unary_expression(struct c_expression_parser *parser, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+	uint32_t operand;
+
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	switch (token.kind) {
+	case C_TOKEN_PLUS:
+	case C_TOKEN_MINUS:
+	case C_TOKEN_TILDE:
+	case C_TOKEN_EXCLAMATION:
+	case C_TOKEN_AMPERSAND:
+	case C_TOKEN_ASTERISK:
+		err = c_parse_cast_expression(parser, &operand);
+		if (err)
+			return err;
+		return c_expression_append_node(parser,
+						c_unary_operators[token.kind],
+						&operand, 1, ret);
+	case C_TOKEN_SIZEOF:
+		return c_parse_sizeof(parser, ret);
+	default:
+		err = drgn_lexer_push(&parser->lexer, &token);
+		if (err)
+			return err;
+		return c_parse_postfix_expression(parser, ret);
+	}
+}
+
+static struct drgn_error *
+c_parse_sizeof(struct c_expression_parser *parser, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token, token2;
+	bool is_type_name = false;
+	uint32_t operand;
+
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	if (token.kind == C_TOKEN_LPAREN) {
+		err = drgn_lexer_peek(&parser->lexer, &token2);
+		if (err)
+			return err;
+		err = c_expression_is_type_name(parser, &token2,
+						&is_type_name);
+		if (err)
+			return err;
+	}
+	if (is_type_name) {
+		/* The size of a type is a constant. */
+		struct drgn_qualified_type qualified_type;
+		struct drgn_expression_node *node;
+		uint64_t size;
+
+		err = c_parse_type_name(parser, &qualified_type);
+		if (err)
+			return err;
+		err = drgn_type_sizeof(qualified_type.type, &size);
+		if (err)
+			return err;
+		node = drgn_expression_append_node(parser->expr,
+						   DRGN_EXPR_OBJECT, ret);
+		if (!node)
+			return &drgn_enomem;
+		return drgn_expression_sizeof_result(&node->obj, size);
+	}
+
+	err = drgn_lexer_push(&parser->lexer, &token);
+	if (err)
+		return err;
+	err = c_expression_parser_enter(parser);
+	if (err)
+		return err;
+	err = c_parse_unary_expression(parser, &operand);
+	if (err)
+		return err;
+	parser->depth--;
+	return c_expression_append_node(parser, DRGN_EXPR_SIZEOF, &operand, 1,
+					ret);
+}
+
+static struct drgn_error *
+c_parse_cast_expression(struct c_expression_parser *parser, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token, token2;
+	bool is_type_name = false;
+	struct drgn_qualified_type qualified_type;
+	struct drgn_expression_node *node;
+	uint32_t operand;
+
+	err = c_expression_parser_enter(parser);
+	if (err)
+		return err;
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	if (token.kind == C_TOKEN_LPAREN) {
+		err = drgn_lexer_peek(&parser->lexer, &token2);
+		if (err)
+			return err;
+		err = c_expression_is_type_name(parser, &token2,
+						&is_type_name);
+		if (err)
+			return err;
+	}
+	if (!is_type_name) {
+		err = drgn_lexer_push(&parser->lexer, &token);
+		if (err)
+			return err;
+		err = c_parse_unary_expression(parser, ret);
+		if (err)
+			return err;
+		parser->depth--;
+		return NULL;
+	}
+
+	err = c_parse_type_name(parser, &qualified_type);
+	if (err)
+		return err;
+	err = c_parse_cast_expression(parser, &operand);
+	if (err)
+		return err;
+	parser->depth--;
+	node = drgn_expression_append_node(parser->expr, DRGN_EXPR_CAST, ret);
+	if (!node)
+		return &drgn_enomem;
+	node->operands[0] = operand;
+	node->type = qualified_type;
+	return NULL;
+}
+
+/* Operator-precedence parser for binary operators. */
+static struct drgn_error *
+c_parse_binary_expression(struct c_expression_parser *parser,
+			  int min_precedence, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+	uint32_t operands[2];
+
+	err = c_parse_cast_expression(parser, ret);
+	if (err)
+		return err;
+	for (;;) {
+		err = drgn_lexer_pop(&parser->lexer, &token);
+		if (err)
+			return err;
+		if (token.kind < 0 ||
+		    token.kind >= ARRAY_SIZE(c_binary_operators) ||
+		    c_binary_operators[token.kind].precedence < min_precedence)
+			return drgn_lexer_push(&parser->lexer, &token);
+
+		operands[0] = *ret;
+		err = c_parse_binary_expression(parser,
+						c_binary_operators[token.kind].precedence + 1,
+						&operands[1]);
+		if (err)
+			return err;
+		err = c_expression_append_node(parser,
+					       c_binary_operators[token.kind].op,
+					       operands, 2, ret);
+		if (err)
+			return err;
+	}
+}
+
+/* Parse a conditional expression (we don't support assignment or commas). */
+static struct drgn_error *
+c_parse_expression(struct c_expression_parser *parser, uint32_t *ret)
+{
+	struct drgn_error *err;
+	struct drgn_token token;
+	uint32_t operands[3];
+
+	err = c_parse_binary_expression(parser, 1, ret);
+	if (err)
+		return err;
+	err = drgn_lexer_pop(&parser->lexer, &token);
+	if (err)
+		return err;
+	if (token.kind != C_TOKEN_QUESTION)
+		return drgn_lexer_push(&parser->lexer, &token);
+
+	operands[0] = *ret;
+	err = c_parse_expression(parser, &operands[1]);
+	if (err)
+		return err;
+	err = c_expect_token(&parser->lexer, C_TOKEN_COLON, "expected ':'");
+	if (err)
+		return err;
+	err = c_parse_expression(parser, &operands[2]);
+	if (err)
+		return err;
+	return c_expression_append_node(parser, DRGN_EXPR_CONDITIONAL,
+					operands, 3, ret);
+}
+
+struct drgn_error *c_compile_expression(struct drgn_program *prog,
+					const char *str,
+					const char * const *params,
+					size_t num_params,
+					struct drgn_expression *expr)
+{
+	struct drgn_error *err;
+	struct c_expression_parser parser = {
+		.prog = prog,
+		.params = params,
+		.num_params = num_params,
+		.expr = expr,
+	};
+	uint32_t root;
+
+	drgn_lexer_init(&parser.lexer, drgn_lexer_c, str);
+	c_expression_identifier_vector_init(&parser.identifiers);
+	err = c_parse_expression(&parser, &root);
+	if (!err) {
+		err = c_expect_token(&parser.lexer, C_TOKEN_EOF,
+				     "extra tokens after expression");
+	}
+	if (!err)
+		err = c_expression_find_identifiers(&parser);
+	c_expression_identifier_vector_deinit(&parser.identifiers);
+	drgn_lexer_deinit(&parser.lexer);
+	return err;
+}
+
 static const int c_integer_conversion_rank[] = {
 	[DRGN_C_TYPE_BOOL] = 0,
 	[DRGN_C_TYPE_CHAR] = 1,
@@ -29,6 +29,7 @@
 #include "program.h"
 #include "type.h"
 #include "util.h"
+#include "vector.h"
 
 struct drgn_error *read_memory_via_pgtable(void *buf, uint64_t address,
 					   size_t count, uint64_t offset,
@@ -80,6 +81,13 @@ struct drgn_error *parse_vmcoreinfo(const char *desc, size_t descsz,
 	ret->page_size = 0;
 	ret->kaslr_offset = 0;
 	ret->pgtable_l5_enabled = false;
+	ret->kallsyms_names = 0;
+	ret->kallsyms_num_syms = 0;
+	ret->kallsyms_token_table = 0;
+	ret->kallsyms_token_index = 0;
+	ret->kallsyms_offsets = 0;
+	ret->kallsyms_relative_base = 0;
+	ret->kallsyms_addresses = 0;
 	while (line < end) {
 		const char *newline;
 
@@ -109,6 +117,41 @@ struct drgn_error *parse_vmcoreinfo(const char *desc, size_t descsz,
 					  &ret->swapper_pg_dir);
 			if (err)
 				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_names)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_names);
+			if (err)
+				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_num_syms)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_num_syms);
+			if (err)
+				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_token_table)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_token_table);
+			if (err)
+				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_token_index)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_token_index);
+			if (err)
+				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_offsets)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_offsets);
+			if (err)
+				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_relative_base)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_relative_base);
+			if (err)
+				return err;
+		} else if (linematch(&line, "SYMBOL(kallsyms_addresses)=")) {
+			err = line_to_u64(line, newline, 16,
+					  &ret->kallsyms_addresses);
+			if (err)
+				return err;
 		} else if (linematch(&line, "NUMBER(pgtable_l5_enabled)=")) {
 			uint64_t tmp;
 
@@ -131,62 +174,17 @@ struct drgn_error *parse_vmcoreinfo(const char *desc, size_t descsz,
 		return drgn_error_create(DRGN_ERROR_OTHER,
 					 "VMCOREINFO does not contain valid swapper_pg_dir");
 	}
-	/* KERNELOFFSET and pgtable_l5_enabled are optional. */
-	return NULL;
-}
-
-struct drgn_error *proc_kallsyms_symbol_addr(const char *name,
-					     unsigned long *ret)
-{
-	struct drgn_error *err;
-	FILE *file;
-	char *line = NULL;
-	size_t n = 0;
+	/* KERNELOFFSET, pgtable_l5_enabled, and kallsyms are optional. */
 
-	file = fopen("/proc/kallsyms", "r");
-	if (!file)
-		return drgn_error_create_os("fopen", errno, "/proc/kallsyms");
-
-	for (;;) {
-		char *addr_str, *sym_str, *saveptr, *end;
-
-		errno = 0;
-		if (getline(&line, &n, file) == -1) {
-			if (errno) {
-				err = drgn_error_create_os("getline", errno,
-							   "/proc/kallsyms");
-			} else {
-				err = &drgn_not_found;
-			}
-			break;
-		}
-
-		addr_str = strtok_r(line, "\t ", &saveptr);
-		if (!addr_str || !*addr_str)
-			goto invalid;
-		if (!strtok_r(NULL, "\t ", &saveptr))
-			goto invalid;
-		sym_str = strtok_r(NULL, "\t\n ", &saveptr);
-		if (!sym_str)
-			goto invalid;
-
-		if (strcmp(sym_str, name) != 0)
-			continue;
-
-		errno = 0;
-		*ret = strtoul(line, &end, 16);
-		if (errno || *end) {
-invalid:
-			err = drgn_error_create(DRGN_ERROR_OTHER,
-						"could not parse /proc/kallsyms");
-			break;
-		}
-		err = NULL;
-		break;
-	}
-	free(line);
-	fclose(file);
-	return err;
+	/* Keep a copy of the whole note so that it can be written out again. */
+	char *raw = malloc(descsz);
+	if (!raw)
+		return &drgn_enomem;
+	memcpy(raw, desc, descsz);
+	free(ret->raw);
+	ret->raw = raw;
+	ret->raw_size = descsz;
+	return NULL;
 }
 
 /*
@@ -986,9 +984,69 @@ get_kernel_module_name_from_this_module(Elf_Scn *this_module_scn,
 DEFINE_HASH_MAP(elf_scn_name_map, const char *, Elf_Scn *,
 		c_string_key_hash_pair, c_string_key_eq)
 
+/* Name and load address of a section of a loaded kernel module. */
+struct kernel_module_section {
+	char *name;
+	uint64_t address;
+};
+
+DEFINE_VECTOR(kernel_module_section_vector, struct kernel_module_section)
+
+static void
+kernel_module_section_vector_free(struct kernel_module_section_vector *sections)
+{
+	for (size_t i = 0; i < sections->size; i++)
+		free(sections->data[i].name);
+	kernel_module_section_vector_deinit(sections);
+}
+
+/*
+ * Read the section addresses of the current module of a kernel module
+ * iterator. This reads from the program (or /sys), so it is not thread-safe.
+ */
 static struct drgn_error *
-cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
-			     uint64_t *start_ret, uint64_t *end_ret)
+read_kernel_module_sections(struct kernel_module_iterator *kmod_it,
+			    struct kernel_module_section_vector *ret)
+{
+	struct drgn_error *err;
+
+	struct kernel_module_section_iterator section_it;
+	err = kernel_module_section_iterator_init(&section_it, kmod_it);
+	if (err)
+		return err;
+	const char *name;
+	uint64_t address;
+	while (!(err = kernel_module_section_iterator_next(&section_it, &name,
+							   &address))) {
+		struct kernel_module_section *section =
+			kernel_module_section_vector_append_entry(ret);
+		if (!section) {
+			err = &drgn_enomem;
+			break;
+		}
+		section->name = strdup(name);
+		if (!section->name) {
+			ret->size--;
+			err = &drgn_enomem;
+			break;
+		}
+		section->address = address;
+	}
+	kernel_module_section_iterator_deinit(&section_it);
+	if (err && err->code != DRGN_ERROR_STOP)
+		return err;
+	return NULL;
+}
+
+/*
+ * Set the addresses of the sections in a kernel module file to where they were
+ * loaded and return the address range of the module. This only accesses the
+ * given ELF file, so it can be called in parallel for different files.
+ */
+static struct drgn_error *
+set_kernel_module_section_addresses(Elf *elf,
+				    const struct kernel_module_section_vector *sections,
+				    uint64_t *start_ret, uint64_t *end_ret)
 {
 	struct drgn_error *err;
 
@@ -1028,14 +1086,9 @@ cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
 	}
 
 	uint64_t start = UINT64_MAX, end = 0;
-	struct kernel_module_section_iterator section_it;
-	err = kernel_module_section_iterator_init(&section_it, kmod_it);
-	if (err)
-		goto out_scn_map;
-	const char *name;
-	uint64_t address;
-	while (!(err = kernel_module_section_iterator_next(&section_it, &name,
-							   &address))) {
+	for (size_t i = 0; i < sections->size; i++) {
+		const char *name = sections->data[i].name;
+		uint64_t address = sections->data[i].address;
 		struct elf_scn_name_map_iterator it =
 			elf_scn_name_map_search(&scn_map, &name);
 		if (it.entry) {
@@ -1044,12 +1097,12 @@ cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
 						       &shdr_mem);
 			if (!shdr) {
 				err = drgn_error_libelf();
-				break;
+				goto out_scn_map;
 			}
 			shdr->sh_addr = address;
 			if (!gelf_update_shdr(it.entry->value, shdr)) {
 				err = drgn_error_libelf();
-				break;
+				goto out_scn_map;
 			}
 			uint64_t section_end;
 			if (__builtin_add_overflow(address, shdr->sh_size,
@@ -1063,20 +1116,31 @@ cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
 			}
 		}
 	}
-	if (err && err->code != DRGN_ERROR_STOP)
-		goto out_section_it;
-	err = NULL;
 	if (start >= end)
 		start = end = 0;
 	*start_ret = start;
 	*end_ret = end;
-out_section_it:
-	kernel_module_section_iterator_deinit(&section_it);
+	err = NULL;
 out_scn_map:
 	elf_scn_name_map_deinit(&scn_map);
 	return err;
 }
 
+static struct drgn_error *
+cache_kernel_module_sections(struct kernel_module_iterator *kmod_it, Elf *elf,
+			     uint64_t *start_ret, uint64_t *end_ret)
+{
+	struct drgn_error *err;
+	struct kernel_module_section_vector sections = VECTOR_INIT;
+	err = read_kernel_module_sections(kmod_it, &sections);
+	if (!err) {
+		err = set_kernel_module_section_addresses(elf, &sections,
+							  start_ret, end_ret);
+	}
+	kernel_module_section_vector_free(&sections);
+	return err;
+}
+
 struct kernel_module_file {
 	const char *path;
 	int fd;
@@ -1145,10 +1209,48 @@ next:
 	return NULL;
 }
 
-static struct drgn_error *
-report_default_kernel_module(struct drgn_debug_info_load_state *load,
-			     struct kernel_module_iterator *kmod_it,
-			     struct depmod_index *depmod)
+/*
+ * A loaded kernel module that wasn't reported explicitly. Finding and opening
+ * its file is the slow part of reporting kernel modules (especially on a cold
+ * cache or a network filesystem), so it is done by open_default_kernel_module()
+ * in an OpenMP task while the list of modules is still being walked.
+ */
+struct default_kernel_module {
+	/* Inputs, read from the program before the task is started. */
+	char *name;
+	struct kernel_module_section_vector sections;
+	/* Outputs of the task. */
+	char *path;
+	int fd;
+	Elf *elf;
+	uint64_t start, end;
+	/*
+	 * If the module couldn't be opened, the arguments to pass to
+	 * drgn_debug_info_report_error() (which isn't thread-safe, so it can't
+	 * be called from the task).
+	 */
+	bool failed;
+	const char *err_name;
+	const char *err_message;
+	struct drgn_error *err;
+};
+
+static void default_kernel_module_destroy(struct default_kernel_module *kmod)
+{
+	if (kmod->elf)
+		elf_end(kmod->elf);
+	if (kmod->fd != -1)
+		close(kmod->fd);
+	free(kmod->path);
+	drgn_error_destroy(kmod->err);
+	kernel_module_section_vector_free(&kmod->sections);
+	free(kmod->name);
+	free(kmod);
+}
+
+static void open_default_kernel_module(struct default_kernel_module *kmod,
+				       struct depmod_index *depmod,
+				       const char *osrelease)
 {
 	static const char * const module_paths[] = {
 		"/usr/lib/debug/lib/modules/%s/%.*s",
@@ -1160,17 +1262,16 @@ report_default_kernel_module(struct drgn_debug_info_load_state *load,
 
 	const char *depmod_path;
 	size_t depmod_path_len;
-	err = depmod_index_find(depmod, kmod_it->name, &depmod_path,
+	err = depmod_index_find(depmod, kmod->name, &depmod_path,
 				&depmod_path_len);
 	if (err) {
-		return drgn_debug_info_report_error(load,
-						    "kernel modules",
-						    "could not parse depmod",
-						    err);
+		kmod->err_name = "kernel modules";
+		kmod->err_message = "could not parse depmod";
+		goto err;
 	} else if (!depmod_path) {
-		return drgn_debug_info_report_error(load, kmod_it->name,
-						    "could not find module in depmod",
-						    NULL);
+		kmod->err_name = kmod->name;
+		kmod->err_message = "could not find module in depmod";
+		goto err;
 	}
 
 	size_t extension_len;
@@ -1180,40 +1281,62 @@ report_default_kernel_module(struct drgn_debug_info_load_state *load,
 		extension_len = 3;
 	else
 		extension_len = 0;
-	char *path;
-	int fd;
-	Elf *elf;
-	err = find_elf_file(&path, &fd, &elf, module_paths,
-			    load->dbinfo->prog->vmcoreinfo.osrelease,
-			    depmod_path_len - extension_len, depmod_path,
-			    extension_len,
+	err = find_elf_file(&kmod->path, &kmod->fd, &kmod->elf, module_paths,
+			    osrelease, depmod_path_len - extension_len,
+			    depmod_path, extension_len,
 			    depmod_path + depmod_path_len - extension_len);
-	if (err)
-		return drgn_debug_info_report_error(load, NULL, NULL, err);
-	if (!elf) {
-		return drgn_debug_info_report_error(load, kmod_it->name,
-						    "could not find .ko",
-						    NULL);
+	if (err) {
+		kmod->err_name = NULL;
+		kmod->err_message = NULL;
+		goto err;
+	}
+	if (!kmod->elf) {
+		kmod->err_name = kmod->name;
+		kmod->err_message = "could not find .ko";
+		goto err;
 	}
 
-	uint64_t start, end;
-	err = cache_kernel_module_sections(kmod_it, elf, &start, &end);
+	err = set_kernel_module_section_addresses(kmod->elf, &kmod->sections,
+						  &kmod->start, &kmod->end);
 	if (err) {
-		err = drgn_debug_info_report_error(load, path,
-						   "could not get section addresses",
-						   err);
-		elf_end(elf);
-		close(fd);
-		free(path);
-		return err;
+		kmod->err_name = kmod->path;
+		kmod->err_message = "could not get section addresses";
+		goto err;
 	}
+	return;
 
-	err = drgn_debug_info_report_elf(load, path, fd, elf, start, end,
-					 kmod_it->name, NULL);
-	free(path);
+err:
+	kmod->failed = true;
+	kmod->err = err;
+}
+
+/*
+ * Report a kernel module opened by open_default_kernel_module() (or the error
+ * that prevented it from being opened) and free it.
+ */
+static struct drgn_error *
+report_default_kernel_module(struct drgn_debug_info_load_state *load,
+			     struct default_kernel_module *kmod)
+{
+	struct drgn_error *err;
+	if (kmod->failed) {
+		err = drgn_debug_info_report_error(load, kmod->err_name,
+						   kmod->err_message,
+						   kmod->err);
+		kmod->err = NULL;
+	} else {
+		err = drgn_debug_info_report_elf(load, kmod->path, kmod->fd,
+						 kmod->elf, kmod->start,
+						 kmod->end, kmod->name, NULL);
+		kmod->elf = NULL;
+		kmod->fd = -1;
+	}
+	default_kernel_module_destroy(kmod);
 	return err;
 }
 
+DEFINE_VECTOR(default_kernel_module_vector, struct default_kernel_module *)
+
 static struct drgn_error *
 report_loaded_kernel_modules(struct drgn_debug_info_load_state *load,
 			     struct kernel_module_table *kmod_table,
@@ -1226,19 +1349,30 @@ report_loaded_kernel_modules(struct drgn_debug_info_load_state *load,
 	struct kernel_module_iterator kmod_it;
 	err = kernel_module_iterator_init(&kmod_it, prog, use_proc_and_sys);
 	if (err) {
-kernel_module_iterator_error:
 		return drgn_debug_info_report_error(load, "kernel modules",
 						    "could not find loaded kernel modules",
 						    err);
 	}
+
+	/*
+	 * Walking the list of modules and reading their section addresses
+	 * uses the program, so it must be done by one thread. Modules that
+	 * weren't reported explicitly are opened in tasks as they are found,
+	 * and then everything is reported in order once all of the tasks are
+	 * done (since reporting isn't thread-safe either).
+	 */
+	struct default_kernel_module_vector default_kmods = VECTOR_INIT;
+	bool iterator_failed = false;
+	#pragma omp parallel
+	#pragma omp master
 	for (;;) {
 		err = kernel_module_iterator_next(&kmod_it);
 		if (err && err->code == DRGN_ERROR_STOP) {
 			err = NULL;
 			break;
 		} else if (err) {
-			kernel_module_iterator_deinit(&kmod_it);
-			goto kernel_module_iterator_error;
+			iterator_failed = true;
+			break;
 		}
 
 		/* Look for an explicitly-reported file first. */
@@ -1273,13 +1407,66 @@ kernel_module_iterator_error:
 					continue;
 				}
 			}
-			err = report_default_kernel_module(load, &kmod_it,
-							   depmod);
-			if (err)
+
+			struct default_kernel_module *kmod =
+				calloc(1, sizeof(*kmod));
+			if (!kmod) {
+				err = &drgn_enomem;
+				break;
+			}
+			kmod->fd = -1;
+			kmod->name = strdup(kmod_it.name);
+			if (!kmod->name ||
+			    !default_kernel_module_vector_append(&default_kmods,
+								 &kmod)) {
+				default_kernel_module_destroy(kmod);
+				err = &drgn_enomem;
 				break;
+			}
+			err = read_kernel_module_sections(&kmod_it,
+							  &kmod->sections);
+			if (err) {
+				kmod->failed = true;
+				kmod->err_name = kmod->name;
+				kmod->err_message = "could not get section addresses";
+				kmod->err = err;
+				err = NULL;
+				continue;
+			}
+			#pragma omp task firstprivate(kmod, depmod)
+			open_default_kernel_module(kmod, depmod,
+						   prog->vmcoreinfo.osrelease);
 		}
 	}
+	/* The parallel region doesn't end until all of the tasks are done. */
 	kernel_module_iterator_deinit(&kmod_it);
+
+	/*
+	 * Report the modules that were found before any error so that a
+	 * truncated module list still gets as much as possible.
+	 */
+	size_t i = 0;
+	if (!err || iterator_failed) {
+		while (i < default_kmods.size) {
+			struct drgn_error *report_err =
+				report_default_kernel_module(load,
+							     default_kmods.data[i++]);
+			if (report_err) {
+				drgn_error_destroy(err);
+				err = report_err;
+				iterator_failed = false;
+				break;
+			}
+		}
+	}
+	for (; i < default_kmods.size; i++)
+		default_kernel_module_destroy(default_kmods.data[i]);
+	if (iterator_failed) {
+		err = drgn_debug_info_report_error(load, "kernel modules",
+						   "could not find loaded kernel modules",
+						   err);
+	}
+	default_kernel_module_vector_deinit(&default_kmods);
 	return err;
 }
 
@@ -1465,6 +1652,38 @@ report_vmlinux(struct drgn_debug_info_load_state *load,
 	return err;
 }
 
+/* Result of open_and_identify_kernel_elf(). */
+struct identified_kernel_elf {
+	int fd;
+	Elf *elf;
+	Elf_Scn *this_module_scn;
+	Elf_Scn *modinfo_scn;
+	bool is_vmlinux;
+	/* If this is non-@c NULL, the other members are not valid. */
+	struct drgn_error *err;
+};
+
+/*
+ * Open an ELF file and identify whether it is vmlinux or a kernel module. This
+ * doesn't access the program, so it can be called in parallel.
+ */
+static void open_and_identify_kernel_elf(const char *path,
+					 struct identified_kernel_elf *ret)
+{
+	ret->err = open_elf_file(path, &ret->fd, &ret->elf);
+	if (!ret->err) {
+		ret->err = identify_kernel_elf(ret->elf, &ret->this_module_scn,
+					       &ret->modinfo_scn,
+					       &ret->is_vmlinux);
+		if (!ret->err)
+			return;
+		elf_end(ret->elf);
+		close(ret->fd);
+	}
+	ret->fd = -1;
+	ret->elf = NULL;
+}
+
 struct drgn_error *
 linux_kernel_report_debug_info(struct drgn_debug_info_load_state *load)
 {
@@ -1480,6 +1699,26 @@ linux_kernel_report_debug_info(struct drgn_debug_info_load_state *load)
 		kmods = NULL;
 	}
 
+	/*
+	 * Opening and identifying the files doesn't depend on anything else,
+	 * so do it in parallel up front. Everything after that is done in
+	 * order.
+	 */
+	struct identified_kernel_elf *identified;
+	if (load->num_paths) {
+		identified = malloc_array(load->num_paths,
+					  sizeof(*identified));
+		if (!identified) {
+			free(kmods);
+			return &drgn_enomem;
+		}
+	} else {
+		identified = NULL;
+	}
+	#pragma omp parallel for schedule(dynamic)
+	for (size_t i = 0; i < load->num_paths; i++)
+		open_and_identify_kernel_elf(load->paths[i], &identified[i]);
+
 	/*
 	 * We may need to index vmlinux before we can properly report kernel
 	 * modules. So, this sets aside kernel modules and reports everything
@@ -1490,30 +1729,23 @@ linux_kernel_report_debug_info(struct drgn_debug_info_load_state *load)
 	bool vmlinux_is_pending = false;
 	for (size_t i = 0; i < load->num_paths; i++) {
 		const char *path = load->paths[i];
-		int fd;
-		Elf *elf;
-		err = open_elf_file(path, &fd, &elf);
-		if (err) {
+		/* The file is now owned by this iteration. */
+		int fd = identified[i].fd;
+		Elf *elf = identified[i].elf;
+		identified[i].fd = -1;
+		identified[i].elf = NULL;
+		if (identified[i].err) {
 			err = drgn_debug_info_report_error(load, path, NULL,
-							   err);
+							   identified[i].err);
+			identified[i].err = NULL;
 			if (err)
 				goto out;
 			continue;
 		}
 
-		Elf_Scn *this_module_scn, *modinfo_scn;
-		bool is_vmlinux;
-		err = identify_kernel_elf(elf, &this_module_scn, &modinfo_scn,
-					  &is_vmlinux);
-		if (err) {
-			err = drgn_debug_info_report_error(load, path, NULL,
-							   err);
-			elf_end(elf);
-			close(fd);
-			if (err)
-				goto out;
-			continue;
-		}
+		Elf_Scn *this_module_scn = identified[i].this_module_scn;
+		Elf_Scn *modinfo_scn = identified[i].modinfo_scn;
+		bool is_vmlinux = identified[i].is_vmlinux;
 		if (this_module_scn || modinfo_scn) {
 			struct kernel_module_file *kmod = &kmods[num_kmods++];
 			kmod->path = path;
@@ -1573,6 +1805,13 @@ linux_kernel_report_debug_info(struct drgn_debug_info_load_state *load)
 	err = report_kernel_modules(load, kmods, num_kmods,
 				    need_module_definition, vmlinux_is_pending);
 out:
+	for (size_t i = 0; i < load->num_paths; i++) {
+		drgn_error_destroy(identified[i].err);
+		elf_end(identified[i].elf);
+		if (identified[i].fd != -1)
+			close(identified[i].fd);
+	}
+	free(identified);
 	for (size_t i = 0; i < num_kmods; i++) {
 		elf_end(kmods[i].elf);
 		if (kmods[i].fd != -1)
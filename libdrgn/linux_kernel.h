@@ -17,9 +17,6 @@ struct drgn_error *read_memory_via_pgtable(void *buf, uint64_t address,
 struct drgn_error *parse_vmcoreinfo(const char *desc, size_t descsz,
 				    struct vmcoreinfo *ret);
 
-struct drgn_error *proc_kallsyms_symbol_addr(const char *name,
-					     unsigned long *ret);
-
 struct drgn_error *read_vmcoreinfo_fallback(struct drgn_memory_reader *reader,
 					    struct vmcoreinfo *ret);
 
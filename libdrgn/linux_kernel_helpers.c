@@ -1,14 +1,25 @@
 // Copyright (c) Facebook, Inc. and its affiliates.
 // SPDX-License-Identifier: GPL-3.0+
 
+#include <byteswap.h>
+#include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 
+#include "bitops.h"
 #include "drgn.h"
+#include "hash_table.h"
+#include "helpers.h"
 #include "minmax.h"
 #include "platform.h"
 #include "program.h"
+#include "serialize.h"
+#include "type.h"
+#include "util.h"
+#include "vector.h"
 
 struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
 					uint64_t pgtable, uint64_t virt_addr,
@@ -99,68 +110,104 @@ struct drgn_error *linux_helper_read_vm(struct drgn_program *prog,
 	return err;
 }
 
-struct drgn_error *
-linux_helper_radix_tree_lookup(struct drgn_object *res,
-			       const struct drgn_object *root, uint64_t index)
+/* Read a pointer-sized value from a buffer of target memory. */
+static uint64_t read_word(const char *buf, uint8_t word_size, bool bswap)
 {
-	struct drgn_error *err;
-	static const uint64_t RADIX_TREE_ENTRY_MASK = 3;
-	uint64_t RADIX_TREE_INTERNAL_NODE;
-	uint64_t RADIX_TREE_MAP_MASK;
-	struct drgn_object node, tmp;
+	if (word_size == 8) {
+		uint64_t value;
+		memcpy(&value, buf, sizeof(value));
+		return bswap ? bswap_64(value) : value;
+	} else {
+		uint32_t value;
+		memcpy(&value, buf, sizeof(value));
+		return bswap ? bswap_32(value) : value;
+	}
+}
+
+/* Layout of the nodes of a radix tree (or, since v4.20, an XArray). */
+struct radix_tree_layout {
+	/* struct xa_node * or struct radix_tree_node *. */
 	struct drgn_qualified_type node_type;
+	/* RADIX_TREE_INTERNAL_NODE. */
+	uint64_t internal_node;
+	uint64_t slots_offset;
+	uint64_t num_slots;
+};
 
-	drgn_object_init(&node, drgn_object_program(res));
-	drgn_object_init(&tmp, drgn_object_program(res));
+/* Get the head entry of a radix tree root and the layout of its nodes. */
+static struct drgn_error *radix_tree_layout_init(struct drgn_object *head,
+						 const struct drgn_object *root,
+						 struct radix_tree_layout *ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(head);
 
-	/* node = root->xa_head */
-	err = drgn_object_member_dereference(&node, root, "xa_head");
+	/* head = root->xa_head */
+	err = drgn_object_member_dereference(head, root, "xa_head");
 	if (!err) {
-		err = drgn_program_find_type(drgn_object_program(res),
-					     "struct xa_node *", NULL,
-					     &node_type);
+		err = drgn_program_find_type(prog, "struct xa_node *", NULL,
+					     &ret->node_type);
 		if (err)
-			goto out;
-		RADIX_TREE_INTERNAL_NODE = 2;
+			return err;
+		ret->internal_node = 2;
 	} else if (err->code == DRGN_ERROR_LOOKUP) {
 		drgn_error_destroy(err);
-		/* node = (void *)root.rnode */
-		err = drgn_object_member_dereference(&node, root, "rnode");
+		/* head = (void *)root.rnode */
+		err = drgn_object_member_dereference(head, root, "rnode");
 		if (err)
-			goto out;
-		err = drgn_program_find_type(drgn_object_program(res), "void *",
-					     NULL, &node_type);
+			return err;
+		struct drgn_qualified_type void_ptr_type;
+		err = drgn_program_find_type(prog, "void *", NULL,
+					     &void_ptr_type);
 		if (err)
-			goto out;
-		err = drgn_object_cast(&node, node_type, &node);
+			return err;
+		err = drgn_object_cast(head, void_ptr_type, head);
 		if (err)
-			goto out;
-		err = drgn_program_find_type(drgn_object_program(res),
-					     "struct radix_tree_node *", NULL,
-					     &node_type);
+			return err;
+		err = drgn_program_find_type(prog, "struct radix_tree_node *",
+					     NULL, &ret->node_type);
 		if (err)
-			goto out;
-		RADIX_TREE_INTERNAL_NODE = 1;
+			return err;
+		ret->internal_node = 1;
 	} else {
-		goto out;
+		return err;
 	}
 
 	struct drgn_type_member *member;
 	uint64_t member_bit_offset;
-	err = drgn_type_find_member(drgn_type_type(node_type.type).type,
+	err = drgn_type_find_member(drgn_type_type(ret->node_type.type).type,
 				    "slots", &member, &member_bit_offset);
 	if (err)
-		goto out;
+		return err;
 	struct drgn_qualified_type member_type;
 	err = drgn_member_type(member, &member_type);
 	if (err)
-		goto out;
+		return err;
 	if (drgn_type_kind(member_type.type) != DRGN_TYPE_ARRAY) {
-		err = drgn_error_create(DRGN_ERROR_TYPE,
-					"struct radix_tree_node slots member is not an array");
-		goto out;
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "struct radix_tree_node slots member is not an array");
 	}
-	RADIX_TREE_MAP_MASK = drgn_type_length(member_type.type) - 1;
+	ret->slots_offset = member_bit_offset / 8;
+	ret->num_slots = drgn_type_length(member_type.type);
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_radix_tree_lookup(struct drgn_object *res,
+			       const struct drgn_object *root, uint64_t index)
+{
+	struct drgn_error *err;
+	static const uint64_t RADIX_TREE_ENTRY_MASK = 3;
+	struct drgn_object node, tmp;
+
+	drgn_object_init(&node, drgn_object_program(res));
+	drgn_object_init(&tmp, drgn_object_program(res));
+
+	struct radix_tree_layout layout;
+	err = radix_tree_layout_init(&node, root, &layout);
+	if (err)
+		goto out;
+	uint64_t RADIX_TREE_MAP_MASK = layout.num_slots - 1;
 
 	for (;;) {
 		uint64_t value;
@@ -173,10 +220,10 @@ linux_helper_radix_tree_lookup(struct drgn_object *res,
 		err = drgn_object_read_unsigned(&node, &value);
 		if (err)
 			goto out;
-		if ((value & RADIX_TREE_ENTRY_MASK) != RADIX_TREE_INTERNAL_NODE)
+		if ((value & RADIX_TREE_ENTRY_MASK) != layout.internal_node)
 			break;
-		err = drgn_object_set_unsigned(&node, node_type,
-					       value & ~RADIX_TREE_INTERNAL_NODE,
+		err = drgn_object_set_unsigned(&node, layout.node_type,
+					       value & ~layout.internal_node,
 					       0);
 		if (err)
 			goto out;
@@ -205,6 +252,95 @@ out:
 	return err;
 }
 
+typedef struct drgn_error *radix_tree_for_each_fn(uint64_t entry, void *arg);
+
+struct radix_tree_walker {
+	struct drgn_program *prog;
+	uint8_t word_size;
+	bool bswap;
+	struct radix_tree_layout layout;
+	radix_tree_for_each_fn *fn;
+	void *arg;
+};
+
+static struct drgn_error *radix_tree_walk(struct radix_tree_walker *w,
+					  uint64_t entry, int depth)
+{
+	struct drgn_error *err;
+	if ((entry & 3) != w->layout.internal_node)
+		return entry ? w->fn(entry, w->arg) : NULL;
+	/* Small internal entries are XArray sibling and retry entries. */
+	if (entry < 4096)
+		return NULL;
+	if (depth >= 64) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "radix tree is too deep");
+	}
+	uint64_t node = entry & ~w->layout.internal_node;
+	size_t size = w->layout.num_slots * w->word_size;
+	char *buf = malloc(size);
+	if (!buf)
+		return &drgn_enomem;
+	err = drgn_program_read_memory(w->prog, buf,
+				       node + w->layout.slots_offset, size,
+				       false);
+	for (uint64_t i = 0; !err && i < w->layout.num_slots; i++) {
+		err = radix_tree_walk(w, read_word(buf + i * w->word_size,
+						   w->word_size, w->bswap),
+				      depth + 1);
+	}
+	free(buf);
+	return err;
+}
+
+/*
+ * Call a function for every non-NULL entry in a radix tree, in index order. The
+ * nodes are read directly rather than through objects.
+ */
+static struct drgn_error *radix_tree_for_each(const struct drgn_object *root,
+					      radix_tree_for_each_fn *fn,
+					      void *arg)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(root);
+	struct radix_tree_walker w = {
+		.prog = prog,
+		.fn = fn,
+		.arg = arg,
+	};
+	err = drgn_program_word_size(prog, &w.word_size);
+	if (err)
+		return err;
+	err = drgn_program_bswap(prog, &w.bswap);
+	if (err)
+		return err;
+
+	struct drgn_object head;
+	drgn_object_init(&head, prog);
+	err = radix_tree_layout_init(&head, root, &w.layout);
+	if (err)
+		goto out;
+	uint64_t entry;
+	err = drgn_object_read_unsigned(&head, &entry);
+	if (err)
+		goto out;
+	err = radix_tree_walk(&w, entry, 0);
+out:
+	drgn_object_deinit(&head);
+	return err;
+}
+
+/* res = &idr->idr_rt */
+static struct drgn_error *idr_radix_tree(struct drgn_object *res,
+					 const struct drgn_object *idr)
+{
+	struct drgn_error *err;
+	err = drgn_object_member_dereference(res, idr, "idr_rt");
+	if (err)
+		return err;
+	return drgn_object_address_of(res, res);
+}
+
 struct drgn_error *linux_helper_idr_find(struct drgn_object *res,
 					 const struct drgn_object *idr,
 					 uint64_t id)
@@ -231,10 +367,7 @@ struct drgn_error *linux_helper_idr_find(struct drgn_object *res,
 	}
 
 	/* radix_tree_lookup(&idr->idr_rt, id) */
-	err = drgn_object_member_dereference(&tmp, idr, "idr_rt");
-	if (err)
-		goto out;
-	err = drgn_object_address_of(&tmp, &tmp);
+	err = idr_radix_tree(&tmp, idr);
 	if (err)
 		goto out;
 	err = linux_helper_radix_tree_lookup(res, &tmp, id);
@@ -243,6 +376,20 @@ out:
 	return err;
 }
 
+/* Call a function for every non-NULL entry in an IDR, in ID order. */
+static struct drgn_error *idr_for_each(const struct drgn_object *idr,
+				       radix_tree_for_each_fn *fn, void *arg)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, drgn_object_program(idr));
+	err = idr_radix_tree(&tmp, idr);
+	if (!err)
+		err = radix_tree_for_each(&tmp, fn, arg);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
 /*
  * Before Linux kernel commit 95846ecf9dac ("pid: replace pid bitmap
  * implementation with IDR API") (in v4.15), (struct pid_namespace).idr does not
@@ -533,3 +680,3900 @@ out:
 	drgn_object_deinit(&pid_obj);
 	return err;
 }
+
+static uint64_t linux_page_field_value(const struct linux_page_field *field,
+				       const char *page, bool bswap)
+{
+	uint64_t value;
+	switch (field->size) {
+	case 1: {
+		uint8_t tmp;
+		memcpy(&tmp, page + field->offset, sizeof(tmp));
+		value = field->is_signed ? (uint64_t)(int8_t)tmp : tmp;
+		break;
+	}
+	case 2: {
+		uint16_t tmp;
+		memcpy(&tmp, page + field->offset, sizeof(tmp));
+		if (bswap)
+			tmp = bswap_16(tmp);
+		value = field->is_signed ? (uint64_t)(int16_t)tmp : tmp;
+		break;
+	}
+	case 4: {
+		uint32_t tmp;
+		memcpy(&tmp, page + field->offset, sizeof(tmp));
+		if (bswap)
+			tmp = bswap_32(tmp);
+		value = field->is_signed ? (uint64_t)(int32_t)tmp : tmp;
+		break;
+	}
+	default: {
+		uint64_t tmp;
+		memcpy(&tmp, page + field->offset, sizeof(tmp));
+		value = bswap ? bswap_64(tmp) : tmp;
+		break;
+	}
+	}
+	return value & field->mask;
+}
+
+static bool linux_page_filter_matches(const struct linux_page_filter *filter,
+				      const char *page, bool bswap)
+{
+	uint64_t value = linux_page_field_value(&filter->field, page, bswap);
+	int cmp;
+	if (filter->field.is_signed) {
+		cmp = ((int64_t)value > (int64_t)filter->value) -
+		      ((int64_t)value < (int64_t)filter->value);
+	} else {
+		cmp = (value > filter->value) - (value < filter->value);
+	}
+	switch (filter->op) {
+	case LINUX_PAGE_FILTER_EQ:
+		return cmp == 0;
+	case LINUX_PAGE_FILTER_NE:
+		return cmp != 0;
+	case LINUX_PAGE_FILTER_LT:
+		return cmp < 0;
+	case LINUX_PAGE_FILTER_LE:
+		return cmp <= 0;
+	case LINUX_PAGE_FILTER_GT:
+		return cmp > 0;
+	case LINUX_PAGE_FILTER_GE:
+		return cmp >= 0;
+	default:
+		UNREACHABLE();
+	}
+}
+
+static struct drgn_error *
+linux_page_field_check(const struct linux_page_field *field,
+		       uint64_t page_size)
+{
+	if (field->size != 1 && field->size != 2 && field->size != 4 &&
+	    field->size != 8) {
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "invalid struct page field size %" PRIu8,
+					 field->size);
+	}
+	if (field->offset > page_size || field->size > page_size - field->offset) {
+		return drgn_error_create(DRGN_ERROR_OUT_OF_BOUNDS,
+					 "field is out of bounds of struct page");
+	}
+	return NULL;
+}
+
+/* Read this much of vmemmap at a time. */
+#define SCAN_PAGES_CHUNK_SIZE (1024 * 1024)
+/* vmemmap is mapped in at least this granularity. */
+#define SCAN_PAGES_HOLE_ALIGN 4096
+
+typedef struct drgn_error *scan_pages_fn(uint64_t pfn, const char *page,
+					 bool bswap, void *arg);
+
+/*
+ * Call fn for each page in [start_pfn, end_pfn) matching every filter. The
+ * struct page array is read in large chunks, and if a chunk hits a hole in
+ * vmemmap, the pages before the hole are still checked and the scan continues
+ * after the hole.
+ */
+static struct drgn_error *
+scan_pages(const struct drgn_object *vmemmap, uint64_t start_pfn,
+	   uint64_t end_pfn, const struct linux_page_filter *filters,
+	   size_t num_filters, const struct linux_page_field *key,
+	   scan_pages_fn *fn, void *arg)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(vmemmap);
+
+	struct drgn_type *type = drgn_underlying_type(vmemmap->type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "vmemmap must be a pointer");
+	}
+	uint64_t page_size;
+	err = drgn_type_sizeof(drgn_type_type(type).type, &page_size);
+	if (err)
+		return err;
+	if (!page_size || page_size > SCAN_PAGES_CHUNK_SIZE) {
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "invalid struct page size %" PRIu64,
+					 page_size);
+	}
+	for (size_t i = 0; i < num_filters; i++) {
+		err = linux_page_field_check(&filters[i].field, page_size);
+		if (err)
+			return err;
+	}
+	if (key) {
+		err = linux_page_field_check(key, page_size);
+		if (err)
+			return err;
+	}
+	uint64_t base;
+	err = drgn_object_read_unsigned(vmemmap, &base);
+	if (err)
+		return err;
+	bool bswap;
+	err = drgn_program_bswap(prog, &bswap);
+	if (err)
+		return err;
+
+	uint64_t chunk_pages = SCAN_PAGES_CHUNK_SIZE / page_size;
+	char *buf = malloc(chunk_pages * page_size);
+	if (!buf)
+		return &drgn_enomem;
+	uint64_t pfn = start_pfn;
+	while (pfn < end_pfn) {
+		uint64_t n = min(chunk_pages, end_pfn - pfn);
+		uint64_t address = base + pfn * page_size;
+		uint64_t next_pfn = pfn + n;
+		err = drgn_program_read_memory(prog, buf, address,
+					       n * page_size, false);
+		if (err && err->code == DRGN_ERROR_FAULT &&
+		    err->address >= address &&
+		    err->address - address < n * page_size) {
+			uint64_t fault_address = err->address;
+			drgn_error_destroy(err);
+			/*
+			 * Check the pages before the hole, then skip to the
+			 * first page starting after the unmapped page.
+			 */
+			n = (fault_address - address) / page_size;
+			err = n ? drgn_program_read_memory(prog, buf, address,
+							   n * page_size,
+							   false)
+				: NULL;
+			uint64_t resume = (fault_address |
+					   (SCAN_PAGES_HOLE_ALIGN - 1)) + 1;
+			next_pfn = max(pfn + n + 1,
+				       (resume - base + page_size - 1) /
+				       page_size);
+		}
+		if (err)
+			goto out;
+
+		for (uint64_t i = 0; i < n; i++) {
+			const char *page = buf + i * page_size;
+			size_t j;
+			for (j = 0; j < num_filters; j++) {
+				if (!linux_page_filter_matches(&filters[j],
+							       page, bswap))
+					break;
+			}
+			if (j == num_filters) {
+				err = fn(pfn + i, page, bswap, arg);
+				if (err)
+					goto out;
+			}
+		}
+		pfn = next_pfn;
+	}
+	err = NULL;
+out:
+	free(buf);
+	return err;
+}
+
+DEFINE_VECTOR(uint64_vector, uint64_t)
+
+static struct drgn_error *scan_pages_append_pfn(uint64_t pfn,
+						const char *page, bool bswap,
+						void *arg)
+{
+	if (!uint64_vector_append(arg, &pfn))
+		return &drgn_enomem;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_scan_pages(const struct drgn_object *vmemmap, uint64_t start_pfn,
+			uint64_t end_pfn,
+			const struct linux_page_filter *filters,
+			size_t num_filters, uint64_t **pfns_ret,
+			size_t *num_pfns_ret)
+{
+	struct uint64_vector pfns = VECTOR_INIT;
+	struct drgn_error *err = scan_pages(vmemmap, start_pfn, end_pfn,
+					    filters, num_filters, NULL,
+					    scan_pages_append_pfn, &pfns);
+	if (err) {
+		uint64_vector_deinit(&pfns);
+		return err;
+	}
+	uint64_vector_shrink_to_fit(&pfns);
+	*pfns_ret = pfns.data;
+	*num_pfns_ret = pfns.size;
+	return NULL;
+}
+
+DEFINE_HASH_MAP(linux_page_count_map, uint64_t, uint64_t, int_key_hash_pair,
+		scalar_key_eq)
+
+struct count_pages_arg {
+	const struct linux_page_field *key;
+	struct linux_page_count_map map;
+};
+
+static struct drgn_error *scan_pages_count(uint64_t pfn, const char *page,
+					   bool bswap, void *arg)
+{
+	struct count_pages_arg *count_arg = arg;
+	struct linux_page_count_map_entry entry = {
+		.key = linux_page_field_value(count_arg->key, page, bswap),
+		.value = 1,
+	};
+	struct linux_page_count_map_iterator it;
+	int r = linux_page_count_map_insert(&count_arg->map, &entry, &it);
+	if (r < 0)
+		return &drgn_enomem;
+	if (r == 0)
+		it.entry->value++;
+	return NULL;
+}
+
+static int linux_page_count_cmp(const void *_a, const void *_b)
+{
+	const struct linux_page_count *a = _a, *b = _b;
+	if (a->count != b->count)
+		return a->count > b->count ? -1 : 1;
+	if (a->value != b->value)
+		return a->value < b->value ? -1 : 1;
+	return 0;
+}
+
+struct drgn_error *
+linux_helper_count_pages(const struct drgn_object *vmemmap, uint64_t start_pfn,
+			 uint64_t end_pfn,
+			 const struct linux_page_filter *filters,
+			 size_t num_filters,
+			 const struct linux_page_field *key,
+			 struct linux_page_count **counts_ret,
+			 size_t *num_counts_ret)
+{
+	struct drgn_error *err;
+	struct count_pages_arg arg = {
+		.key = key,
+		.map = HASH_TABLE_INIT,
+	};
+	err = scan_pages(vmemmap, start_pfn, end_pfn, filters, num_filters,
+			 key, scan_pages_count, &arg);
+	if (err)
+		goto out;
+
+	size_t num_counts = linux_page_count_map_size(&arg.map);
+	struct linux_page_count *counts =
+		malloc_array(num_counts ? num_counts : 1, sizeof(*counts));
+	if (!counts) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	size_t i = 0;
+	for (struct linux_page_count_map_iterator it =
+	     linux_page_count_map_first(&arg.map);
+	     it.entry; it = linux_page_count_map_next(it)) {
+		counts[i].value = it.entry->key;
+		counts[i].count = it.entry->value;
+		i++;
+	}
+	qsort(counts, num_counts, sizeof(counts[0]), linux_page_count_cmp);
+	*counts_ret = counts;
+	*num_counts_ret = num_counts;
+	err = NULL;
+out:
+	linux_page_count_map_deinit(&arg.map);
+	return err;
+}
+
+/*
+ * Layout of the struct page fields needed to find and walk SLUB slabs. Since
+ * Linux kernel commit d122019bf061 ("mm: Split slab into its own type") (in
+ * v5.17), the slab fields are in struct slab, which overlays struct page.
+ */
+struct slab_layout {
+	struct drgn_program *prog;
+	uint64_t vmemmap;
+	/* sizeof(struct page). */
+	uint64_t page_size;
+	/* Start of the direct mapping and the physical address that it maps. */
+	uint64_t page_offset;
+	uint64_t phys_offset;
+	uint64_t page_shift;
+	uint64_t max_pfn;
+	uint64_t pg_slab;
+	struct linux_page_field flags;
+	/* If there is no compound_head member, size is 0. */
+	struct linux_page_field compound_head;
+	struct linux_page_field slab_cache;
+	struct linux_page_field freelist;
+	uint64_t objects_bit_offset;
+	uint8_t objects_bit_size;
+	uint8_t word_size;
+	bool little_endian;
+	bool bswap;
+};
+
+static struct drgn_error *slab_layout_field(const struct slab_layout *layout,
+					    struct drgn_type *type,
+					    const char *name,
+					    struct linux_page_field *ret)
+{
+	struct drgn_type_member *member;
+	uint64_t bit_offset;
+	struct drgn_error *err = drgn_type_find_member(type, name, &member,
+						       &bit_offset);
+	if (err)
+		return err;
+	ret->offset = bit_offset / 8;
+	ret->size = layout->word_size;
+	ret->is_signed = false;
+	ret->mask = UINT64_MAX;
+	return linux_page_field_check(ret, layout->page_size);
+}
+
+static struct drgn_error *linux_type_offsetof(struct drgn_program *prog,
+					      const char *type_name,
+					      const char *member_designator,
+					      uint64_t *ret)
+{
+	struct drgn_qualified_type qualified_type;
+	struct drgn_error *err = drgn_program_find_type(prog, type_name, NULL,
+							&qualified_type);
+	if (err)
+		return err;
+	return drgn_type_offsetof(qualified_type.type, member_designator, ret);
+}
+
+static struct drgn_error *
+linux_find_integer_constant(struct drgn_program *prog, const char *name,
+			    struct drgn_object *tmp, uint64_t *ret)
+{
+	struct drgn_error *err;
+	err = drgn_program_find_object(prog, name, NULL, DRGN_FIND_OBJECT_ANY,
+				       tmp);
+	if (err)
+		return err;
+	union drgn_value value;
+	err = drgn_object_read_integer(tmp, &value);
+	if (err)
+		return err;
+	*ret = value.uvalue;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_direct_map(struct drgn_program *prog,
+					   uint64_t *page_offset_ret,
+					   uint64_t *phys_offset_ret)
+{
+	struct drgn_error *err;
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	err = linux_find_integer_constant(prog, "PAGE_OFFSET", &tmp,
+					  page_offset_ret);
+	if (err)
+		goto out;
+	/*
+	 * On AArch64, the direct mapping starts at the beginning of RAM,
+	 * memstart_addr. Architectures without it (e.g., x86-64) map physical
+	 * address 0 at PAGE_OFFSET.
+	 */
+	err = linux_find_integer_constant(prog, "memstart_addr", &tmp,
+					  phys_offset_ret);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*phys_offset_ret = 0;
+		err = NULL;
+	}
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static struct drgn_error *slab_layout_init(struct slab_layout *layout,
+					   struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	layout->prog = prog;
+	err = drgn_program_word_size(prog, &layout->word_size);
+	if (err)
+		return err;
+	err = drgn_program_is_little_endian(prog, &layout->little_endian);
+	if (err)
+		return err;
+	err = drgn_program_bswap(prog, &layout->bswap);
+	if (err)
+		return err;
+
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	err = drgn_program_find_object(prog, "vmemmap", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	struct drgn_type *type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"vmemmap must be a pointer");
+		goto out;
+	}
+	struct drgn_type *page_type = drgn_type_type(type).type;
+	err = drgn_type_sizeof(page_type, &layout->page_size);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &layout->vmemmap);
+	if (err)
+		goto out;
+
+	err = linux_helper_direct_map(prog, &layout->page_offset,
+				      &layout->phys_offset);
+	if (err)
+		goto out;
+	err = linux_find_integer_constant(prog, "PAGE_SHIFT", &tmp,
+					  &layout->page_shift);
+	if (err)
+		goto out;
+	err = linux_find_integer_constant(prog, "max_pfn", &tmp,
+					  &layout->max_pfn);
+	if (err)
+		goto out;
+	err = linux_find_integer_constant(prog, "PG_slab", &tmp,
+					  &layout->pg_slab);
+	if (err)
+		goto out;
+	if (layout->pg_slab >= 8 * layout->word_size) {
+		err = drgn_error_create(DRGN_ERROR_OTHER, "invalid PG_slab");
+		goto out;
+	}
+
+	err = slab_layout_field(layout, page_type, "flags", &layout->flags);
+	if (err)
+		goto out;
+	err = slab_layout_field(layout, page_type, "compound_head",
+				&layout->compound_head);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		layout->compound_head.size = 0;
+	} else if (err) {
+		goto out;
+	}
+
+	struct drgn_qualified_type slab_type;
+	err = drgn_program_find_type(prog, "struct slab", NULL, &slab_type);
+	if (!err) {
+		bool has_slab_cache;
+		err = drgn_type_has_member(slab_type.type, "slab_cache",
+					   &has_slab_cache);
+		if (err)
+			goto out;
+		if (!has_slab_cache)
+			slab_type.type = page_type;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		slab_type.type = page_type;
+	} else {
+		goto out;
+	}
+	err = slab_layout_field(layout, slab_type.type, "slab_cache",
+				&layout->slab_cache);
+	if (err)
+		goto out;
+	err = slab_layout_field(layout, slab_type.type, "freelist",
+				&layout->freelist);
+	if (err)
+		goto out;
+	struct drgn_type_member *objects_member;
+	err = drgn_type_find_member(slab_type.type, "objects", &objects_member,
+				    &layout->objects_bit_offset);
+	if (err)
+		goto out;
+	layout->objects_bit_size = objects_member->bit_field_size;
+	if (!layout->objects_bit_size) {
+		struct drgn_qualified_type objects_type;
+		err = drgn_member_type(objects_member, &objects_type);
+		if (err)
+			goto out;
+		uint64_t size;
+		err = drgn_type_sizeof(objects_type.type, &size);
+		if (err)
+			goto out;
+		layout->objects_bit_size = min(size, UINT64_C(4)) * 8;
+	}
+	if (layout->objects_bit_offset + layout->objects_bit_size >
+	    8 * layout->page_size) {
+		err = drgn_error_create(DRGN_ERROR_OUT_OF_BOUNDS,
+					"field is out of bounds of struct page");
+		goto out;
+	}
+	err = NULL;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+static uint64_t slab_page_objects(const struct slab_layout *layout,
+				  const char *page)
+{
+	return deserialize_bits(page, layout->objects_bit_offset,
+				layout->objects_bit_size,
+				layout->little_endian);
+}
+
+static uint64_t slab_pfn_to_virt(const struct slab_layout *layout,
+				 uint64_t pfn)
+{
+	return (layout->page_offset + (pfn << layout->page_shift) -
+		layout->phys_offset);
+}
+
+struct slab_cache_info {
+	uint64_t address;
+	uint64_t size;
+	uint64_t offset;
+	uint64_t red_left_pad;
+	/* Whether CONFIG_SLAB_FREELIST_HARDENED is enabled. */
+	bool hardened;
+	/*
+	 * Whether the freelist pointer address is byte-swapped before it is
+	 * mixed in (see slab_mark_free()), or -1 if we don't know yet.
+	 */
+	int swab;
+	uint64_t random;
+};
+
+static struct drgn_error *
+slab_cache_read_member(const struct drgn_object *slab_cache, const char *name,
+		       struct drgn_object *tmp, uint64_t *ret)
+{
+	struct drgn_error *err;
+	err = drgn_object_member_dereference(tmp, slab_cache, name);
+	if (err)
+		return err;
+	union drgn_value value;
+	err = drgn_object_read_integer(tmp, &value);
+	if (err)
+		return err;
+	*ret = value.uvalue;
+	return NULL;
+}
+
+DEFINE_HASH_MAP(slab_freelist_map, uint64_t, uint64_t, int_key_hash_pair,
+		scalar_key_eq)
+
+static struct drgn_error *per_cpu_cache_init(struct drgn_program *prog);
+static struct drgn_error *per_cpu_offset(struct drgn_program *prog,
+					 uint64_t cpu, uint64_t *ret);
+
+/*
+ * Get the parameters of a slab cache and the freelists of its per-CPU slabs,
+ * indexed by PFN.
+ */
+static struct drgn_error *
+slab_cache_info_init(struct slab_cache_info *info,
+		     const struct slab_layout *layout,
+		     const struct drgn_object *slab_cache,
+		     struct slab_freelist_map *cpu_freelists)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = layout->prog;
+
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+
+	err = drgn_object_read_unsigned(slab_cache, &info->address);
+	if (err)
+		goto out;
+
+	/* struct kmem_cache_cpu only exists for SLUB. */
+	uint64_t cpu_slab;
+	err = slab_cache_read_member(slab_cache, "cpu_slab", &tmp, &cpu_slab);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					"only SLUB is supported");
+		goto out;
+	} else if (err) {
+		goto out;
+	}
+	struct drgn_type *cpu_type = drgn_underlying_type(tmp.type);
+	if (drgn_type_kind(cpu_type) != DRGN_TYPE_POINTER) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"cpu_slab must be a pointer");
+		goto out;
+	}
+	cpu_type = drgn_type_type(cpu_type).type;
+	struct drgn_type_member *member;
+	uint64_t cpu_freelist_bit_offset, cpu_slab_bit_offset;
+	err = drgn_type_find_member(cpu_type, "freelist", &member,
+				    &cpu_freelist_bit_offset);
+	if (err)
+		goto out;
+	err = drgn_type_find_member(cpu_type, "slab", &member,
+				    &cpu_slab_bit_offset);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		/*
+		 * Before Linux kernel commit bb192ed9aa71 ("mm/slub: Convert
+		 * most struct page to struct slab by spatch") (in v5.17).
+		 */
+		drgn_error_destroy(err);
+		err = drgn_type_find_member(cpu_type, "page", &member,
+					    &cpu_slab_bit_offset);
+	}
+	if (err)
+		goto out;
+
+	err = slab_cache_read_member(slab_cache, "size", &tmp, &info->size);
+	if (err)
+		goto out;
+	if (info->size < layout->word_size) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid slab cache object size");
+		goto out;
+	}
+	err = slab_cache_read_member(slab_cache, "offset", &tmp,
+				     &info->offset);
+	if (err)
+		goto out;
+	if (info->offset > info->size - layout->word_size) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid slab cache freelist offset");
+		goto out;
+	}
+
+	/* red_left_pad is 0 unless the cache has SLAB_RED_ZONE set. */
+	err = slab_cache_read_member(slab_cache, "red_left_pad", &tmp,
+				     &info->red_left_pad);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		/* red_left_pad was added in v4.6. */
+		drgn_error_destroy(err);
+		info->red_left_pad = 0;
+	} else if (err) {
+		goto out;
+	}
+
+	err = slab_cache_read_member(slab_cache, "random", &tmp,
+				     &info->random);
+	if (!err) {
+		info->hardened = true;
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		info->hardened = false;
+	} else {
+		goto out;
+	}
+	info->swab = -1;
+
+	/* Collect the freelist of each possible CPU's slab. */
+	err = per_cpu_cache_init(prog);
+	if (err)
+		goto out;
+	for (size_t i = 0; i < prog->num_possible_cpus; i++) {
+		uint64_t cpu_offset;
+		err = per_cpu_offset(prog, prog->possible_cpus[i], &cpu_offset);
+		if (err)
+			goto out;
+		uint64_t address = cpu_slab + cpu_offset;
+		char buf[8];
+		err = drgn_program_read_memory(prog, buf,
+					       address + cpu_freelist_bit_offset / 8,
+					       layout->word_size, false);
+		if (err)
+			goto out;
+		uint64_t freelist = read_word(buf, layout->word_size,
+					      layout->bswap);
+		err = drgn_program_read_memory(prog, buf,
+					       address + cpu_slab_bit_offset / 8,
+					       layout->word_size, false);
+		if (err)
+			goto out;
+		uint64_t page = read_word(buf, layout->word_size,
+					  layout->bswap);
+		if (!freelist || page < layout->vmemmap)
+			continue;
+		struct slab_freelist_map_entry entry = {
+			.key = (page - layout->vmemmap) / layout->page_size,
+			.value = freelist,
+		};
+		if (slab_freelist_map_insert(cpu_freelists, &entry, NULL) < 0) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	err = NULL;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/* Parameters of a slab cache and the freelists of its per-CPU slabs. */
+struct slab_cache_state {
+	struct slab_cache_info info;
+	struct slab_freelist_map cpu_freelists;
+};
+
+static void slab_cache_state_init(struct slab_cache_state *cache)
+{
+	slab_freelist_map_init(&cache->cpu_freelists);
+}
+
+static void slab_cache_state_deinit(struct slab_cache_state *cache)
+{
+	slab_freelist_map_deinit(&cache->cpu_freelists);
+}
+
+DEFINE_HASH_MAP(slab_cache_state_map, uint64_t, struct slab_cache_state *,
+		int_key_hash_pair, scalar_key_eq)
+
+struct slab_page {
+	uint64_t pfn;
+	uint64_t freelist;
+	/* Freelist of the CPU using the slab, or 0 if no CPU is using it. */
+	uint64_t cpu_freelist;
+	uint64_t objects;
+};
+
+DEFINE_VECTOR(slab_vector, struct slab_page)
+
+DEFINE_HASH_MAP(slab_index, uint64_t, struct slab_vector, int_key_hash_pair,
+		scalar_key_eq)
+
+/*
+ * Slab allocator state cached on a program; see linux_slab_state(). The struct
+ * page layout never changes. The parameters and CPU freelists of each cache and
+ * the slabs belonging to each cache only stay the same in a core dump, so they
+ * are not cached for a live program.
+ */
+struct linux_slab_state {
+	struct slab_layout layout;
+	/* Keyed by the address of the struct kmem_cache. */
+	struct slab_cache_state_map caches;
+	/*
+	 * Slabs of every cache, keyed by the address of the struct kmem_cache.
+	 * Built by one scan of the struct page array; see linux_slab_index().
+	 */
+	struct slab_index slabs;
+	bool slabs_indexed;
+};
+
+static void slab_index_deinit_all(struct slab_index *slabs)
+{
+	for (struct slab_index_iterator it = slab_index_first(slabs);
+	     it.entry; it = slab_index_next(it))
+		slab_vector_deinit(&it.entry->value);
+	slab_index_deinit(slabs);
+}
+
+void linux_slab_state_destroy(struct linux_slab_state *state)
+{
+	if (!state)
+		return;
+	slab_index_deinit_all(&state->slabs);
+	for (struct slab_cache_state_map_iterator it =
+	     slab_cache_state_map_first(&state->caches);
+	     it.entry; it = slab_cache_state_map_next(it)) {
+		slab_cache_state_deinit(it.entry->value);
+		free(it.entry->value);
+	}
+	slab_cache_state_map_deinit(&state->caches);
+	free(state);
+}
+
+/*
+ * Get the slab allocator state of a program, creating it if necessary. It is
+ * freed when debugging information is loaded (see
+ * drgn_program_load_debug_info()).
+ */
+static struct drgn_error *linux_slab_state(struct drgn_program *prog,
+					   struct linux_slab_state **ret)
+{
+	if (prog->slab_state) {
+		*ret = prog->slab_state;
+		return NULL;
+	}
+	struct linux_slab_state *state = malloc(sizeof(*state));
+	if (!state)
+		return &drgn_enomem;
+	struct drgn_error *err = slab_layout_init(&state->layout, prog);
+	if (err) {
+		free(state);
+		return err;
+	}
+	slab_cache_state_map_init(&state->caches);
+	slab_index_init(&state->slabs);
+	state->slabs_indexed = false;
+	prog->slab_state = state;
+	*ret = state;
+	return NULL;
+}
+
+/*
+ * Get the parameters and CPU freelists of a slab cache. For a live program,
+ * they are read into *tmp, which must already be initialized with
+ * slab_cache_state_init(). Otherwise, they are cached in the slab state.
+ */
+static struct drgn_error *
+linux_slab_cache_state(struct linux_slab_state *state,
+		       const struct drgn_object *slab_cache,
+		       struct slab_cache_state *tmp,
+		       struct slab_cache_state **ret)
+{
+	struct drgn_error *err;
+
+	if (state->layout.prog->flags & DRGN_PROGRAM_IS_LIVE) {
+		err = slab_cache_info_init(&tmp->info, &state->layout,
+					   slab_cache, &tmp->cpu_freelists);
+		if (err)
+			return err;
+		*ret = tmp;
+		return NULL;
+	}
+
+	uint64_t address;
+	err = drgn_object_read_unsigned(slab_cache, &address);
+	if (err)
+		return err;
+	struct slab_cache_state_map_iterator it =
+		slab_cache_state_map_search(&state->caches, &address);
+	if (it.entry) {
+		*ret = it.entry->value;
+		return NULL;
+	}
+
+	struct slab_cache_state *cache = malloc(sizeof(*cache));
+	if (!cache)
+		return &drgn_enomem;
+	slab_cache_state_init(cache);
+	err = slab_cache_info_init(&cache->info, &state->layout, slab_cache,
+				   &cache->cpu_freelists);
+	if (err)
+		goto err;
+	struct slab_cache_state_map_entry entry = {
+		.key = address,
+		.value = cache,
+	};
+	if (slab_cache_state_map_insert(&state->caches, &entry, NULL) < 0) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	*ret = cache;
+	return NULL;
+
+err:
+	slab_cache_state_deinit(cache);
+	free(cache);
+	return err;
+}
+
+static struct drgn_error *slab_vector_add_page(const struct slab_layout *layout,
+					       struct slab_vector *slabs,
+					       uint64_t pfn, const char *page,
+					       bool bswap)
+{
+	struct slab_page *slab = slab_vector_append_entry(slabs);
+	if (!slab)
+		return &drgn_enomem;
+	slab->pfn = pfn;
+	slab->freelist = linux_page_field_value(&layout->freelist, page,
+						bswap);
+	slab->cpu_freelist = 0;
+	slab->objects = slab_page_objects(layout, page);
+	return NULL;
+}
+
+/*
+ * Scan the struct page array for slabs belonging to the cache at the given
+ * address, or to any cache if the address is 0.
+ */
+static struct drgn_error *slab_scan(const struct slab_layout *layout,
+				    uint64_t address, scan_pages_fn *fn,
+				    void *arg)
+{
+	struct drgn_error *err;
+	struct drgn_object vmemmap;
+	drgn_object_init(&vmemmap, layout->prog);
+	err = drgn_program_find_object(layout->prog, "vmemmap", NULL,
+				       DRGN_FIND_OBJECT_ANY, &vmemmap);
+	if (err)
+		goto out;
+	struct linux_page_filter filters[] = {
+		{
+			.field = layout->flags,
+			.op = LINUX_PAGE_FILTER_EQ,
+			.value = UINT64_C(1) << layout->pg_slab,
+		},
+		{
+			.field = layout->slab_cache,
+			.op = LINUX_PAGE_FILTER_EQ,
+			.value = address,
+		},
+	};
+	filters[0].field.mask = filters[0].value;
+	err = scan_pages(&vmemmap, 0, layout->max_pfn, filters,
+			 address ? 2 : 1, NULL, fn, arg);
+out:
+	drgn_object_deinit(&vmemmap);
+	return err;
+}
+
+static struct drgn_error *slab_index_add_slab(uint64_t pfn, const char *page,
+					      bool bswap, void *arg)
+{
+	struct linux_slab_state *state = arg;
+	struct slab_index_entry entry = {
+		.key = linux_page_field_value(&state->layout.slab_cache, page,
+					      bswap),
+		.value = VECTOR_INIT,
+	};
+	struct slab_index_iterator it;
+	if (slab_index_insert(&state->slabs, &entry, &it) < 0)
+		return &drgn_enomem;
+	return slab_vector_add_page(&state->layout, &it.entry->value, pfn, page,
+				    bswap);
+}
+
+/* Find the slabs of every cache if they haven't been found already. */
+static struct drgn_error *linux_slab_index(struct linux_slab_state *state)
+{
+	if (state->slabs_indexed)
+		return NULL;
+	struct drgn_error *err = slab_scan(&state->layout, 0,
+					   slab_index_add_slab, state);
+	if (err) {
+		slab_index_deinit_all(&state->slabs);
+		slab_index_init(&state->slabs);
+		return err;
+	}
+	for (struct slab_index_iterator it = slab_index_first(&state->slabs);
+	     it.entry; it = slab_index_next(it))
+		slab_vector_shrink_to_fit(&it.entry->value);
+	state->slabs_indexed = true;
+	return NULL;
+}
+
+/* State for reading slabs from one slab cache. */
+struct slab_walker {
+	const struct slab_layout *layout;
+	struct slab_cache_info *cache;
+	/* Contents of the current slab. */
+	char *buf;
+	size_t buf_capacity;
+	/* Whether each object in the current slab is free. */
+	bool *is_free;
+	bool *scratch;
+	uint64_t objects_capacity;
+};
+
+static void slab_walker_init(struct slab_walker *w,
+			     const struct slab_layout *layout,
+			     struct slab_cache_info *cache)
+{
+	w->layout = layout;
+	w->cache = cache;
+	w->buf = NULL;
+	w->buf_capacity = 0;
+	w->is_free = w->scratch = NULL;
+	w->objects_capacity = 0;
+}
+
+static void slab_walker_deinit(struct slab_walker *w)
+{
+	free(w->scratch);
+	free(w->is_free);
+	free(w->buf);
+}
+
+/*
+ * Walk a freelist in the current slab, marking the objects on it as free.
+ * Returns false if the freelist is not valid.
+ */
+static bool slab_walk_freelist(struct slab_walker *w, uint64_t slab_addr,
+			       uint64_t objects, uint64_t ptr, bool swab,
+			       bool *is_free)
+{
+	const struct slab_cache_info *cache = w->cache;
+	uint8_t word_size = w->layout->word_size;
+	uint64_t start = slab_addr + cache->red_left_pad;
+	while (ptr) {
+		if (ptr < start || (ptr - start) % cache->size)
+			return false;
+		uint64_t i = (ptr - start) / cache->size;
+		if (i >= objects || is_free[i])
+			return false;
+		is_free[i] = true;
+
+		uint64_t location = ptr + cache->offset;
+		ptr = read_word(w->buf + (location - slab_addr), word_size,
+				w->layout->bswap);
+		if (cache->hardened) {
+			if (swab) {
+				location = word_size == 8 ?
+					   bswap_64(location) :
+					   bswap_32(location);
+			}
+			ptr ^= cache->random ^ location;
+		}
+	}
+	return true;
+}
+
+/*
+ * Mark the objects on a freelist in the current slab as free. Returns an error
+ * if the freelist can't be decoded.
+ */
+static struct drgn_error *slab_mark_free(struct slab_walker *w,
+					 uint64_t slab_addr, uint64_t objects,
+					 uint64_t freelist)
+{
+	struct slab_cache_info *cache = w->cache;
+	if (!freelist)
+		return NULL;
+	if (!cache->hardened || cache->swab >= 0) {
+		if (slab_walk_freelist(w, slab_addr, objects, freelist,
+				       cache->swab > 0, w->is_free))
+			return NULL;
+		goto invalid;
+	}
+	/*
+	 * Since Linux kernel commit 1ad53d9fa3f6 ("slub: improve bit diffusion
+	 * for freelist ptr obfuscation") (in v5.7), hardened freelist pointers
+	 * are obfuscated with the byte-swapped address of the pointer. That
+	 * commit has been backported, so rather than trusting the version, try
+	 * both and remember whichever one decodes to a valid freelist.
+	 */
+	for (int swab = 1; swab >= 0; swab--) {
+		memcpy(w->scratch, w->is_free, objects * sizeof(w->is_free[0]));
+		if (slab_walk_freelist(w, slab_addr, objects, freelist, swab,
+				       w->scratch)) {
+			cache->swab = swab;
+			memcpy(w->is_free, w->scratch,
+			       objects * sizeof(w->is_free[0]));
+			return NULL;
+		}
+	}
+invalid:
+	return drgn_error_format(DRGN_ERROR_OTHER,
+				 "invalid freelist in slab at 0x%" PRIx64,
+				 slab_addr);
+}
+
+/*
+ * Read a slab in one go and figure out which of its objects are free from the
+ * slab's freelist and, if it is a CPU slab, the CPU freelist.
+ */
+static struct drgn_error *slab_walker_read(struct slab_walker *w, uint64_t pfn,
+					   uint64_t freelist,
+					   uint64_t cpu_freelist,
+					   uint64_t objects)
+{
+	struct drgn_error *err;
+	const struct slab_cache_info *cache = w->cache;
+
+	if (!objects)
+		return NULL;
+	if (objects > w->objects_capacity) {
+		free(w->scratch);
+		free(w->is_free);
+		w->is_free = malloc_array(objects, sizeof(w->is_free[0]));
+		w->scratch = malloc_array(objects, sizeof(w->scratch[0]));
+		if (!w->is_free || !w->scratch) {
+			w->objects_capacity = 0;
+			return &drgn_enomem;
+		}
+		w->objects_capacity = objects;
+	}
+	/* objects fits in a bit field and size in an unsigned int. */
+	uint64_t size = cache->red_left_pad + objects * cache->size;
+	if (size > SIZE_MAX)
+		return &drgn_enomem;
+	if (size > w->buf_capacity) {
+		free(w->buf);
+		w->buf = malloc(size);
+		if (!w->buf) {
+			w->buf_capacity = 0;
+			return &drgn_enomem;
+		}
+		w->buf_capacity = size;
+	}
+
+	uint64_t slab_addr = slab_pfn_to_virt(w->layout, pfn);
+	err = drgn_program_read_memory(w->layout->prog, w->buf, slab_addr, size,
+				       false);
+	if (err)
+		return err;
+
+	memset(w->is_free, 0, objects * sizeof(w->is_free[0]));
+	err = slab_mark_free(w, slab_addr, objects, freelist);
+	if (err)
+		return err;
+	return slab_mark_free(w, slab_addr, objects, cpu_freelist);
+}
+
+struct linux_slab_cache_iterator {
+	/*
+	 * Copies of the cached layout and cache parameters, which are freed if
+	 * debugging information is loaded while the iterator is alive.
+	 */
+	struct slab_layout layout;
+	struct slab_cache_info cache;
+	struct slab_walker walker;
+	struct slab_vector slabs;
+	size_t next_slab;
+	struct uint64_vector objects;
+	bool allocated;
+	bool free;
+};
+
+static struct drgn_error *slab_cache_iterator_add_slab(uint64_t pfn,
+						       const char *page,
+						       bool bswap, void *arg)
+{
+	struct linux_slab_cache_iterator *it = arg;
+	return slab_vector_add_page(&it->layout, &it->slabs, pfn, page, bswap);
+}
+
+struct drgn_error *
+linux_slab_cache_iterator_create(const struct drgn_object *slab_cache,
+				 bool allocated, bool free_objects,
+				 struct linux_slab_cache_iterator **ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(slab_cache);
+
+	struct linux_slab_state *state;
+	err = linux_slab_state(prog, &state);
+	if (err)
+		return err;
+
+	struct linux_slab_cache_iterator *it = malloc(sizeof(*it));
+	if (!it)
+		return &drgn_enomem;
+	it->layout = state->layout;
+	slab_walker_init(&it->walker, &it->layout, &it->cache);
+	slab_vector_init(&it->slabs);
+	it->next_slab = 0;
+	uint64_vector_init(&it->objects);
+	it->allocated = allocated;
+	it->free = free_objects;
+
+	struct slab_cache_state tmp, *cache;
+	slab_cache_state_init(&tmp);
+	err = linux_slab_cache_state(state, slab_cache, &tmp, &cache);
+	if (err)
+		goto err;
+	it->cache = cache->info;
+
+	if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
+		/* Slabs come and go, so scan for this cache's every time. */
+		err = slab_scan(&it->layout, it->cache.address,
+				slab_cache_iterator_add_slab, it);
+		if (err)
+			goto err;
+	} else {
+		err = linux_slab_index(state);
+		if (err)
+			goto err;
+		struct slab_index_iterator index_it =
+			slab_index_search(&state->slabs, &it->cache.address);
+		if (index_it.entry) {
+			const struct slab_vector *slabs = &index_it.entry->value;
+			if (!slab_vector_reserve(&it->slabs, slabs->size)) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			memcpy(it->slabs.data, slabs->data,
+			       slabs->size * sizeof(slabs->data[0]));
+			it->slabs.size = slabs->size;
+		}
+	}
+	for (size_t i = 0; i < it->slabs.size; i++) {
+		struct slab_page *slab = &it->slabs.data[i];
+		struct slab_freelist_map_iterator freelist_it =
+			slab_freelist_map_search(&cache->cpu_freelists,
+						 &slab->pfn);
+		if (freelist_it.entry)
+			slab->cpu_freelist = freelist_it.entry->value;
+	}
+	slab_vector_shrink_to_fit(&it->slabs);
+	slab_cache_state_deinit(&tmp);
+	*ret = it;
+	return NULL;
+
+err:
+	slab_cache_state_deinit(&tmp);
+	linux_slab_cache_iterator_destroy(it);
+	return err;
+}
+
+void linux_slab_cache_iterator_destroy(struct linux_slab_cache_iterator *it)
+{
+	uint64_vector_deinit(&it->objects);
+	slab_vector_deinit(&it->slabs);
+	slab_walker_deinit(&it->walker);
+	free(it);
+}
+
+struct drgn_error *
+linux_slab_cache_iterator_next(struct linux_slab_cache_iterator *it,
+			       const uint64_t **objects_ret,
+			       size_t *num_objects_ret)
+{
+	struct drgn_error *err;
+	struct slab_walker *w = &it->walker;
+
+	it->objects.size = 0;
+	while (!it->objects.size && it->next_slab < it->slabs.size) {
+		const struct slab_page *slab = &it->slabs.data[it->next_slab++];
+		err = slab_walker_read(w, slab->pfn, slab->freelist,
+				       slab->cpu_freelist, slab->objects);
+		if (err && err->code == DRGN_ERROR_FAULT) {
+			/* The slab was freed out from under us. */
+			drgn_error_destroy(err);
+			continue;
+		} else if (err) {
+			return err;
+		}
+		uint64_t address = (slab_pfn_to_virt(&it->layout, slab->pfn) +
+				    it->cache.red_left_pad);
+		for (uint64_t i = 0; i < slab->objects; i++) {
+			if (w->is_free[i] ? it->free : it->allocated) {
+				if (!uint64_vector_append(&it->objects,
+							       &address))
+					return &drgn_enomem;
+			}
+			address += it->cache.size;
+		}
+	}
+	*objects_ret = it->objects.data;
+	*num_objects_ret = it->objects.size;
+	return NULL;
+}
+
+struct drgn_error *
+linux_helper_slab_object_info(struct drgn_program *prog, uint64_t address,
+			      struct linux_slab_object_info *ret,
+			      bool *found_ret)
+{
+	struct drgn_error *err;
+
+	struct linux_slab_state *state;
+	err = linux_slab_state(prog, &state);
+	if (err)
+		return err;
+	const struct slab_layout *layout = &state->layout;
+
+	*found_ret = false;
+	if (address < layout->page_offset)
+		return NULL;
+	uint64_t pfn = ((address - layout->page_offset + layout->phys_offset) >>
+			layout->page_shift);
+	if (pfn >= layout->max_pfn)
+		return NULL;
+
+	struct slab_walker w;
+	slab_walker_init(&w, layout, NULL);
+	struct slab_cache_state tmp, *cache;
+	slab_cache_state_init(&tmp);
+	struct drgn_object slab_cache;
+	drgn_object_init(&slab_cache, prog);
+
+	char *page = malloc(layout->page_size);
+	if (!page) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	err = drgn_program_read_memory(prog, page,
+				       layout->vmemmap + pfn * layout->page_size,
+				       layout->page_size, false);
+	if (err)
+		goto not_found;
+	if (layout->compound_head.size) {
+		uint64_t compound_head =
+			linux_page_field_value(&layout->compound_head, page,
+					       layout->bswap);
+		if (compound_head & 1) {
+			uint64_t head = compound_head - 1;
+			if (head < layout->vmemmap)
+				goto out;
+			pfn = (head - layout->vmemmap) / layout->page_size;
+			err = drgn_program_read_memory(prog, page, head,
+						       layout->page_size,
+						       false);
+			if (err)
+				goto not_found;
+		}
+	}
+	uint64_t flags = linux_page_field_value(&layout->flags, page,
+						layout->bswap);
+	if (!(flags & (UINT64_C(1) << layout->pg_slab)))
+		goto out;
+
+	struct drgn_qualified_type slab_cache_type;
+	err = drgn_program_find_type(prog, "struct kmem_cache *", NULL,
+				     &slab_cache_type);
+	if (err)
+		goto out;
+	err = drgn_object_set_unsigned(&slab_cache, slab_cache_type,
+				       linux_page_field_value(&layout->slab_cache,
+							      page,
+							      layout->bswap),
+				       0);
+	if (err)
+		goto out;
+	err = linux_slab_cache_state(state, &slab_cache, &tmp, &cache);
+	if (err)
+		goto out;
+	w.cache = &cache->info;
+
+	uint64_t objects = slab_page_objects(layout, page);
+	uint64_t start = slab_pfn_to_virt(layout, pfn) + w.cache->red_left_pad;
+	if (address < start)
+		goto out;
+	uint64_t i = (address - start) / w.cache->size;
+	if (i >= objects)
+		goto out;
+	struct slab_freelist_map_iterator freelist_it =
+		slab_freelist_map_search(&cache->cpu_freelists, &pfn);
+	err = slab_walker_read(&w, pfn,
+			       linux_page_field_value(&layout->freelist, page,
+						      layout->bswap),
+			       freelist_it.entry ? freelist_it.entry->value : 0,
+			       objects);
+	if (err)
+		goto out;
+	ret->slab_cache = w.cache->address;
+	ret->slab = layout->vmemmap + pfn * layout->page_size;
+	ret->address = start + i * w.cache->size;
+	ret->allocated = !w.is_free[i];
+	*found_ret = true;
+	err = NULL;
+out:
+	free(page);
+	drgn_object_deinit(&slab_cache);
+	slab_cache_state_deinit(&tmp);
+	slab_walker_deinit(&w);
+	return err;
+
+not_found:
+	if (err->code != DRGN_ERROR_FAULT)
+		goto out;
+	/* There is no struct page for the address. */
+	drgn_error_destroy(err);
+	err = NULL;
+	goto out;
+}
+
+/*
+ * Reads of task fields at most this far apart are merged. The task table
+ * machinery is also used for fields of other structures (see
+ * task_table_builder::what).
+ */
+#define TASK_TABLE_READ_GAP 256
+
+struct task_table_range {
+	uint64_t start, end;
+	/* Position of the range in the node buffer. */
+	size_t pos;
+};
+
+DEFINE_VECTOR(task_table_range_vector, struct task_table_range)
+
+/*
+ * Memory read for each task: the task_struct itself, or memory reached from it
+ * by following a pointer.
+ */
+struct task_table_node {
+	/* Index of the node containing the pointer, or SIZE_MAX for the root. */
+	size_t parent;
+	uint64_t pointer_offset;
+	size_t pointer_pos;
+	/* Added to the pointer value (for subscripting a pointer). */
+	uint64_t pointer_add;
+	struct task_table_range_vector ranges;
+	char *buf;
+	/* Whether the node could be read for the current task. */
+	bool valid;
+};
+
+DEFINE_VECTOR(task_table_node_vector, struct task_table_node)
+
+struct task_table_leaf {
+	size_t node;
+	uint64_t offset;
+	size_t pos;
+	uint64_t bit_size;
+	uint8_t bit_offset;
+	bool little_endian;
+};
+
+struct task_table_builder {
+	struct drgn_program *prog;
+	/* What the fields belong to, for error messages (e.g., "task"). */
+	const char *what;
+	uint8_t word_size;
+	bool bswap;
+	struct task_table_node_vector nodes;
+};
+
+static struct drgn_error *
+task_table_builder_init(struct task_table_builder *b,
+			struct drgn_program *prog, const char *what)
+{
+	struct drgn_error *err;
+	b->prog = prog;
+	b->what = what;
+	task_table_node_vector_init(&b->nodes);
+	err = drgn_program_word_size(prog, &b->word_size);
+	if (err)
+		return err;
+	err = drgn_program_bswap(prog, &b->bswap);
+	if (err)
+		return err;
+	struct task_table_node *root =
+		task_table_node_vector_append_entry(&b->nodes);
+	if (!root)
+		return &drgn_enomem;
+	root->parent = SIZE_MAX;
+	task_table_range_vector_init(&root->ranges);
+	root->buf = NULL;
+	return NULL;
+}
+
+static void task_table_builder_deinit(struct task_table_builder *b)
+{
+	for (size_t i = 0; i < b->nodes.size; i++) {
+		free(b->nodes.data[i].buf);
+		task_table_range_vector_deinit(&b->nodes.data[i].ranges);
+	}
+	task_table_node_vector_deinit(&b->nodes);
+}
+
+static struct drgn_error *task_table_need(struct task_table_builder *b,
+					  size_t node, uint64_t start,
+					  uint64_t size)
+{
+	struct task_table_range *range =
+		task_table_range_vector_append_entry(&b->nodes.data[node].ranges);
+	if (!range)
+		return &drgn_enomem;
+	range->start = start;
+	if (__builtin_add_overflow(start, size, &range->end)) {
+		return drgn_error_format(DRGN_ERROR_OVERFLOW,
+					 "%s field offset is too large",
+					 b->what);
+	}
+	return NULL;
+}
+
+/*
+ * Follow the pointer in obj (plus index elements). *node and obj are replaced
+ * with the node for the referenced memory and a reference to it.
+ */
+static struct drgn_error *task_table_deref(struct task_table_builder *b,
+					   size_t *node,
+					   struct drgn_object *obj,
+					   uint64_t index)
+{
+	struct drgn_error *err;
+	struct drgn_type *type = drgn_underlying_type(obj->type);
+	if (drgn_type_kind(type) != DRGN_TYPE_POINTER ||
+	    obj->kind != DRGN_OBJECT_REFERENCE || obj->is_bit_field ||
+	    obj->bit_size != 8 * b->word_size) {
+		return drgn_error_format(DRGN_ERROR_TYPE,
+					 "cannot dereference non-pointer %s field",
+					 b->what);
+	}
+	struct drgn_qualified_type referenced_type = drgn_type_type(type);
+	uint64_t add = 0;
+	if (index) {
+		uint64_t size;
+		err = drgn_type_sizeof(referenced_type.type, &size);
+		if (err)
+			return err;
+		if (__builtin_mul_overflow(index, size, &add)) {
+			return drgn_error_format(DRGN_ERROR_OVERFLOW,
+						 "%s field offset is too large",
+						 b->what);
+		}
+	}
+
+	uint64_t offset = obj->address;
+	err = task_table_need(b, *node, offset, b->word_size);
+	if (err)
+		return err;
+	size_t i;
+	for (i = 1; i < b->nodes.size; i++) {
+		const struct task_table_node *child = &b->nodes.data[i];
+		if (child->parent == *node && child->pointer_offset == offset &&
+		    child->pointer_add == add)
+			break;
+	}
+	if (i == b->nodes.size) {
+		struct task_table_node *child =
+			task_table_node_vector_append_entry(&b->nodes);
+		if (!child)
+			return &drgn_enomem;
+		child->parent = *node;
+		child->pointer_offset = offset;
+		child->pointer_add = add;
+		task_table_range_vector_init(&child->ranges);
+		child->buf = NULL;
+	}
+	*node = i;
+	return drgn_object_set_reference(obj, referenced_type, 0, 0, 0,
+					 DRGN_PROGRAM_ENDIAN);
+}
+
+static struct drgn_error *
+task_field_syntax_error(const struct task_table_builder *b, const char *field)
+{
+	return drgn_error_format(DRGN_ERROR_SYNTAX, "invalid %s field '%s'",
+				 b->what, field);
+}
+
+/* Parse a field and record what needs to be read for it. */
+static struct drgn_error *
+task_table_compile(struct task_table_builder *b,
+		   struct drgn_qualified_type task_type, const char *field,
+		   struct task_table_leaf *leaf,
+		   struct linux_task_column *column)
+{
+	struct drgn_error *err;
+	struct drgn_object obj;
+	drgn_object_init(&obj, b->prog);
+	err = drgn_object_set_reference(&obj, task_type, 0, 0, 0,
+					DRGN_PROGRAM_ENDIAN);
+	if (err)
+		goto out;
+
+	size_t node = 0;
+	bool arrow = false;
+	const char *p = field;
+	for (;;) {
+		size_t len = 0;
+		while (isalnum((unsigned char)p[len]) || p[len] == '_')
+			len++;
+		if (!len || isdigit((unsigned char)p[0])) {
+			err = task_field_syntax_error(b, field);
+			goto out;
+		}
+		if (arrow) {
+			err = task_table_deref(b, &node, &obj, 0);
+			if (err)
+				goto out;
+		}
+		char *name = strndup(p, len);
+		if (!name) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		err = drgn_object_member(&obj, &obj, name);
+		free(name);
+		if (err)
+			goto out;
+		p += len;
+
+		while (*p == '[') {
+			if (!isdigit((unsigned char)p[1])) {
+				err = task_field_syntax_error(b, field);
+				goto out;
+			}
+			char *end;
+			errno = 0;
+			uint64_t index = strtoull(p + 1, &end, 0);
+			if (errno || *end != ']') {
+				err = task_field_syntax_error(b, field);
+				goto out;
+			}
+			p = end + 1;
+			if (drgn_type_kind(drgn_underlying_type(obj.type)) ==
+			    DRGN_TYPE_POINTER)
+				err = task_table_deref(b, &node, &obj, index);
+			else
+				err = drgn_object_subscript(&obj, &obj, index);
+			if (err)
+				goto out;
+		}
+
+		if (*p == '\0') {
+			break;
+		} else if (*p == '.') {
+			arrow = false;
+			p++;
+		} else if (p[0] == '-' && p[1] == '>') {
+			arrow = true;
+			p += 2;
+		} else {
+			err = task_field_syntax_error(b, field);
+			goto out;
+		}
+	}
+
+	leaf->node = node;
+	leaf->offset = obj.address;
+	leaf->bit_offset = obj.bit_offset;
+	leaf->little_endian = obj.little_endian;
+	column->is_string = false;
+	column->is_signed = obj.encoding == DRGN_OBJECT_ENCODING_SIGNED;
+	struct drgn_type *type = drgn_underlying_type(obj.type);
+	if (drgn_type_kind(type) == DRGN_TYPE_ARRAY &&
+	    drgn_type_is_complete(type)) {
+		struct drgn_type *element_type =
+			drgn_underlying_type(drgn_type_type(type).type);
+		if (drgn_type_kind(element_type) == DRGN_TYPE_INT &&
+		    drgn_type_size(element_type) == 1) {
+			column->is_string = true;
+			column->string_size = drgn_type_length(type);
+			leaf->bit_size = 8 * column->string_size;
+			err = task_table_need(b, node, leaf->offset,
+					      column->string_size);
+			goto out;
+		}
+	}
+	if ((obj.encoding != DRGN_OBJECT_ENCODING_SIGNED &&
+	     obj.encoding != DRGN_OBJECT_ENCODING_UNSIGNED) ||
+	    obj.bit_size > 64) {
+		err = drgn_error_format(DRGN_ERROR_TYPE,
+					"%s field '%s' is not an integer, pointer, or character array",
+					b->what, field);
+		goto out;
+	}
+	leaf->bit_size = obj.bit_size;
+	err = task_table_need(b, node, leaf->offset,
+			      (obj.bit_offset + obj.bit_size + 7) / 8);
+out:
+	drgn_object_deinit(&obj);
+	return err;
+}
+
+static int task_table_range_cmp(const void *_a, const void *_b)
+{
+	const struct task_table_range *a = _a, *b = _b;
+	if (a->start != b->start)
+		return a->start < b->start ? -1 : 1;
+	return 0;
+}
+
+static size_t task_table_pos(const struct task_table_node *node,
+			     uint64_t offset)
+{
+	for (size_t i = 0; i < node->ranges.size; i++) {
+		const struct task_table_range *range = &node->ranges.data[i];
+		if (offset >= range->start && offset < range->end)
+			return range->pos + (offset - range->start);
+	}
+	UNREACHABLE();
+}
+
+/* Merge the ranges to read for each node and lay them out in its buffer. */
+static struct drgn_error *task_table_layout(struct task_table_builder *b,
+					    struct task_table_leaf *leaves,
+					    size_t num_leaves)
+{
+	for (size_t i = 0; i < b->nodes.size; i++) {
+		struct task_table_node *node = &b->nodes.data[i];
+		struct task_table_range *ranges = node->ranges.data;
+		qsort(ranges, node->ranges.size, sizeof(ranges[0]),
+		      task_table_range_cmp);
+		size_t n = 0;
+		for (size_t j = 0; j < node->ranges.size; j++) {
+			if (n && ranges[j].start <=
+			    ranges[n - 1].end + TASK_TABLE_READ_GAP) {
+				ranges[n - 1].end = max(ranges[n - 1].end,
+							ranges[j].end);
+			} else {
+				ranges[n++] = ranges[j];
+			}
+		}
+		node->ranges.size = n;
+		uint64_t size = 0;
+		for (size_t j = 0; j < n; j++) {
+			ranges[j].pos = size;
+			size += ranges[j].end - ranges[j].start;
+		}
+		if (size > SIZE_MAX)
+			return &drgn_enomem;
+		node->buf = malloc(size ? size : 1);
+		if (!node->buf)
+			return &drgn_enomem;
+	}
+	for (size_t i = 1; i < b->nodes.size; i++) {
+		struct task_table_node *node = &b->nodes.data[i];
+		node->pointer_pos = task_table_pos(&b->nodes.data[node->parent],
+						   node->pointer_offset);
+	}
+	for (size_t i = 0; i < num_leaves; i++) {
+		leaves[i].pos = task_table_pos(&b->nodes.data[leaves[i].node],
+					       leaves[i].offset);
+	}
+	return NULL;
+}
+
+/* Read every node for a task. Unreadable nodes are marked invalid. */
+static struct drgn_error *task_table_read(struct task_table_builder *b,
+					  uint64_t task)
+{
+	struct drgn_error *err;
+	for (size_t i = 0; i < b->nodes.size; i++) {
+		struct task_table_node *node = &b->nodes.data[i];
+		uint64_t base;
+		if (i == 0) {
+			base = task;
+		} else {
+			const struct task_table_node *parent =
+				&b->nodes.data[node->parent];
+			node->valid = false;
+			if (!parent->valid)
+				continue;
+			base = read_word(parent->buf + node->pointer_pos,
+					 b->word_size, b->bswap);
+			if (!base)
+				continue;
+			base += node->pointer_add;
+		}
+		node->valid = true;
+		for (size_t j = 0; j < node->ranges.size; j++) {
+			const struct task_table_range *range =
+				&node->ranges.data[j];
+			err = drgn_program_read_memory(b->prog,
+						       node->buf + range->pos,
+						       base + range->start,
+						       range->end - range->start,
+						       false);
+			if (err && err->code == DRGN_ERROR_FAULT) {
+				drgn_error_destroy(err);
+				node->valid = false;
+				break;
+			} else if (err) {
+				return err;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Maximum length of a pid_hash chain. A longer chain is an error, since it
+ * probably has a cycle.
+ */
+#define PID_HASH_MAX_CHAIN (1 << 20)
+
+struct task_enumerator {
+	uint64_t pid_type;
+	struct drgn_qualified_type pid_ptr_type;
+	struct drgn_object pid;
+	struct drgn_object task;
+	struct uint64_vector *tasks;
+};
+
+/* Add the task of a struct pid, if it has one (see linux_helper_pid_task()). */
+static struct drgn_error *task_enumerate_pid(uint64_t pid, void *arg)
+{
+	struct drgn_error *err;
+	struct task_enumerator *e = arg;
+	err = drgn_object_set_unsigned(&e->pid, e->pid_ptr_type, pid, 0);
+	if (err)
+		return err;
+	err = linux_helper_pid_task(&e->task, &e->pid, e->pid_type);
+	if (err)
+		return err;
+	uint64_t task;
+	err = drgn_object_read_unsigned(&e->task, &task);
+	if (err)
+		return err;
+	if (task && !uint64_vector_append(e->tasks, &task))
+		return &drgn_enomem;
+	return NULL;
+}
+
+/*
+ * Before Linux kernel commit 95846ecf9dac ("pid: replace pid bitmap
+ * implementation with IDR API") (in v4.15), walk every chain of pid_hash (see
+ * find_pid_in_pid_hash()).
+ */
+static struct drgn_error *task_enumerate_pid_hash(struct task_enumerator *e,
+						  const struct drgn_object *ns)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(ns);
+
+	uint8_t word_size;
+	err = drgn_program_word_size(prog, &word_size);
+	if (err)
+		return err;
+	bool bswap;
+	err = drgn_program_bswap(prog, &bswap);
+	if (err)
+		return err;
+
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	char *buckets = NULL;
+
+	uint64_t ns_addr;
+	err = drgn_object_read_unsigned(ns, &ns_addr);
+	if (err)
+		goto out;
+	union drgn_value level;
+	err = drgn_object_member_dereference(&tmp, ns, "level");
+	if (err)
+		goto out;
+	err = drgn_object_read_integer(&tmp, &level);
+	if (err)
+		goto out;
+
+	struct drgn_qualified_type pid_type, upid_type;
+	err = drgn_program_find_type(prog, "struct pid", NULL, &pid_type);
+	if (err)
+		goto out;
+	err = drgn_program_find_type(prog, "struct upid", NULL, &upid_type);
+	if (err)
+		goto out;
+	char member[64];
+	snprintf(member, sizeof(member), "numbers[%" PRIu64 "]", level.uvalue);
+	uint64_t numbers_offset, pid_chain_offset, ns_offset;
+	err = drgn_type_offsetof(pid_type.type, member, &numbers_offset);
+	if (err)
+		goto out;
+	err = drgn_type_offsetof(upid_type.type, "pid_chain",
+				 &pid_chain_offset);
+	if (err)
+		goto out;
+	err = drgn_type_offsetof(upid_type.type, "ns", &ns_offset);
+	if (err)
+		goto out;
+
+	err = drgn_program_find_object(prog, "pidhash_shift", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	union drgn_value pidhash_shift;
+	err = drgn_object_read_integer(&tmp, &pidhash_shift);
+	if (err)
+		goto out;
+	if (pidhash_shift.uvalue >= 32) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"invalid pidhash_shift");
+		goto out;
+	}
+	uint64_t num_buckets = UINT64_C(1) << pidhash_shift.uvalue;
+	err = drgn_program_find_object(prog, "pid_hash", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	uint64_t pid_hash;
+	err = drgn_object_read_unsigned(&tmp, &pid_hash);
+	if (err)
+		goto out;
+	buckets = malloc_array(num_buckets, word_size);
+	if (!buckets) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	err = drgn_program_read_memory(prog, buckets, pid_hash,
+				       num_buckets * word_size, false);
+	if (err)
+		goto out;
+
+	for (uint64_t i = 0; i < num_buckets; i++) {
+		uint64_t node = read_word(buckets + i * word_size, word_size,
+					  bswap);
+		for (int length = 0; node; length++) {
+			if (length >= PID_HASH_MAX_CHAIN) {
+				err = drgn_error_create(DRGN_ERROR_OTHER,
+							"pid_hash chain is too long");
+				goto out;
+			}
+			char buf[8];
+			uint64_t upid = node - pid_chain_offset;
+			err = drgn_program_read_memory(prog, buf,
+						       upid + ns_offset,
+						       word_size, false);
+			if (err)
+				goto out;
+			if (read_word(buf, word_size, bswap) == ns_addr) {
+				err = task_enumerate_pid(upid - numbers_offset,
+							 e);
+				if (err)
+					goto out;
+			}
+			/* node = node->next */
+			err = drgn_program_read_memory(prog, buf, node,
+						       word_size, false);
+			if (err)
+				goto out;
+			node = read_word(buf, word_size, bswap);
+		}
+	}
+	err = NULL;
+out:
+	free(buckets);
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/*
+ * Find the task_struct of every PID in a namespace, in the same order as the
+ * for_each_pid() Python helper.
+ */
+static struct drgn_error *task_enumerate(const struct drgn_object *ns,
+					 struct uint64_vector *tasks)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(ns);
+	struct task_enumerator e = {
+		.tasks = tasks,
+	};
+	drgn_object_init(&e.pid, prog);
+	drgn_object_init(&e.task, prog);
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+
+	err = drgn_program_find_object(prog, "PIDTYPE_PID", NULL,
+				       DRGN_FIND_OBJECT_CONSTANT, &tmp);
+	if (err)
+		goto out;
+	union drgn_value pid_type;
+	err = drgn_object_read_integer(&tmp, &pid_type);
+	if (err)
+		goto out;
+	e.pid_type = pid_type.uvalue;
+	err = drgn_program_find_type(prog, "struct pid *", NULL,
+				     &e.pid_ptr_type);
+	if (err)
+		goto out;
+
+	err = drgn_object_member_dereference(&tmp, ns, "idr");
+	if (!err) {
+		err = drgn_object_address_of(&tmp, &tmp);
+		if (!err)
+			err = idr_for_each(&tmp, task_enumerate_pid, &e);
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		err = task_enumerate_pid_hash(&e, ns);
+	}
+out:
+	drgn_object_deinit(&tmp);
+	drgn_object_deinit(&e.task);
+	drgn_object_deinit(&e.pid);
+	return err;
+}
+
+struct drgn_error *linux_helper_task_table(const struct drgn_object *ns,
+					   const char * const *fields,
+					   size_t num_fields,
+					   struct linux_task_table *ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(ns);
+	struct task_table_builder b;
+	struct uint64_vector tasks = VECTOR_INIT;
+	struct task_table_leaf *leaves = NULL;
+	struct linux_task_column *columns = NULL;
+
+	err = task_table_builder_init(&b, prog, "task");
+	if (err)
+		goto err;
+
+	struct drgn_qualified_type task_type;
+	err = drgn_program_find_type(prog, "struct task_struct", NULL,
+				     &task_type);
+	if (err)
+		goto err;
+
+	leaves = malloc_array(num_fields ? num_fields : 1, sizeof(*leaves));
+	columns = calloc(num_fields ? num_fields : 1, sizeof(*columns));
+	if (!leaves || !columns) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (size_t i = 0; i < num_fields; i++) {
+		err = task_table_compile(&b, task_type, fields[i], &leaves[i],
+					 &columns[i]);
+		if (err)
+			goto err;
+	}
+	err = task_table_layout(&b, leaves, num_fields);
+	if (err)
+		goto err;
+
+	err = task_enumerate(ns, &tasks);
+	if (err)
+		goto err;
+	uint64_vector_shrink_to_fit(&tasks);
+	size_t num_tasks = tasks.size;
+
+	for (size_t i = 0; i < num_fields; i++) {
+		struct linux_task_column *column = &columns[i];
+		column->valid = malloc_array(num_tasks ? num_tasks : 1,
+					     sizeof(column->valid[0]));
+		if (column->is_string) {
+			column->strings = malloc_array(num_tasks ? num_tasks : 1,
+						       column->string_size ?
+						       column->string_size : 1);
+		} else {
+			column->values = malloc_array(num_tasks ? num_tasks : 1,
+						      sizeof(column->values[0]));
+		}
+		if (!column->valid || (!column->strings && !column->values)) {
+			err = &drgn_enomem;
+			goto err;
+		}
+	}
+
+	for (size_t t = 0; t < num_tasks; t++) {
+		err = task_table_read(&b, tasks.data[t]);
+		if (err)
+			goto err;
+		for (size_t i = 0; i < num_fields; i++) {
+			const struct task_table_leaf *leaf = &leaves[i];
+			const struct task_table_node *node =
+				&b.nodes.data[leaf->node];
+			struct linux_task_column *column = &columns[i];
+			column->valid[t] = node->valid;
+			if (!node->valid)
+				continue;
+			const char *src = node->buf + leaf->pos;
+			if (column->is_string) {
+				memcpy(column->strings + t * column->string_size,
+				       src, column->string_size);
+				continue;
+			}
+			uint64_t value = deserialize_bits(src, leaf->bit_offset,
+							  leaf->bit_size,
+							  leaf->little_endian);
+			if (column->is_signed)
+				value = sign_extend(value, leaf->bit_size);
+			column->values[t] = value;
+		}
+	}
+
+	ret->tasks = tasks.data;
+	ret->num_tasks = num_tasks;
+	ret->columns = columns;
+	ret->num_columns = num_fields;
+	err = NULL;
+	goto out;
+
+err:
+	if (columns) {
+		struct linux_task_table table = {
+			.columns = columns,
+			.num_columns = num_fields,
+		};
+		linux_task_table_deinit(&table);
+	}
+	uint64_vector_deinit(&tasks);
+out:
+	free(leaves);
+	task_table_builder_deinit(&b);
+	return err;
+}
+
+void linux_task_table_deinit(struct linux_task_table *table)
+{
+	for (size_t i = 0; i < table->num_columns; i++) {
+		free(table->columns[i].strings);
+		free(table->columns[i].values);
+		free(table->columns[i].valid);
+	}
+	free(table->columns);
+	free(table->tasks);
+}
+
+/*
+ * Return whether the kernel was built without CONFIG_SMP. That is also the only
+ * case where there is no __per_cpu_offset variable on most architectures, but
+ * the variable may be missing for other reasons (e.g., missing debugging
+ * information, or powerpc, which keeps the offsets in the paca), so this
+ * requires positive evidence: the kernel's variables can be found, but
+ * nr_cpu_ids, which is a constant without CONFIG_SMP, is not one of them.
+ */
+static struct drgn_error *linux_kernel_is_up(struct drgn_object *tmp,
+					     bool *ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(tmp);
+
+	*ret = false;
+	err = drgn_program_find_object(prog, "init_task", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, tmp);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		return NULL;
+	} else if (err) {
+		return err;
+	}
+	err = drgn_program_find_object(prog, "nr_cpu_ids", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, tmp);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		*ret = true;
+		return NULL;
+	}
+	return err;
+}
+
+/*
+ * Cache __per_cpu_offset and the list of possible CPUs. Neither changes after
+ * boot, so they are only read once. Failures are not cached, and the cache is
+ * reset when debugging information is loaded (see
+ * drgn_program_load_debug_info()).
+ */
+static struct drgn_error *per_cpu_cache_init(struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	if (prog->per_cpu_cached)
+		return NULL;
+
+	uint8_t word_size;
+	err = drgn_program_word_size(prog, &word_size);
+	if (err)
+		return err;
+	bool bswap;
+	err = drgn_program_bswap(prog, &bswap);
+	if (err)
+		return err;
+
+	struct drgn_object obj;
+	drgn_object_init(&obj, prog);
+	uint64_t *offsets = NULL;
+	size_t num_offsets;
+	struct uint64_vector possible_cpus = VECTOR_INIT;
+	char *buf = NULL;
+
+	err = drgn_program_find_object(prog, "__per_cpu_offset", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &obj);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		bool up;
+		err = linux_kernel_is_up(&obj, &up);
+		if (err)
+			goto out;
+		if (!up) {
+			err = drgn_error_create(DRGN_ERROR_LOOKUP,
+						"could not find per-CPU offsets (__per_cpu_offset)");
+			goto out;
+		}
+		/*
+		 * Without CONFIG_SMP, per-CPU pointers point directly to the
+		 * only CPU's variables.
+		 */
+		offsets = malloc(sizeof(*offsets));
+		if (!offsets) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		offsets[0] = 0;
+		num_offsets = 1;
+	} else if (err) {
+		goto out;
+	} else {
+		struct drgn_type *type = drgn_underlying_type(obj.type);
+		if (drgn_type_kind(type) != DRGN_TYPE_ARRAY ||
+		    !drgn_type_is_complete(type) ||
+		    obj.kind != DRGN_OBJECT_REFERENCE) {
+			err = drgn_error_create(DRGN_ERROR_TYPE,
+						"__per_cpu_offset is not an array");
+			goto out;
+		}
+		uint64_t address = obj.address;
+		num_offsets = drgn_type_length(type);
+
+		/* nr_cpu_ids is NR_CPUS if it isn't a variable. */
+		err = drgn_program_find_object(prog, "nr_cpu_ids", NULL,
+					       DRGN_FIND_OBJECT_VARIABLE, &obj);
+		if (!err) {
+			uint64_t nr_cpu_ids;
+			err = drgn_object_read_unsigned(&obj, &nr_cpu_ids);
+			if (err)
+				goto out;
+			if (nr_cpu_ids < num_offsets)
+				num_offsets = nr_cpu_ids;
+		} else if (err->code == DRGN_ERROR_LOOKUP) {
+			drgn_error_destroy(err);
+		} else {
+			goto out;
+		}
+
+		offsets = malloc_array(num_offsets ? num_offsets : 1,
+				       sizeof(*offsets));
+		buf = malloc_array(num_offsets ? num_offsets : 1, word_size);
+		if (!offsets || !buf) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		err = drgn_program_read_memory(prog, buf, address,
+					       num_offsets * word_size, false);
+		if (err)
+			goto out;
+		for (size_t i = 0; i < num_offsets; i++) {
+			offsets[i] = read_word(buf + i * word_size, word_size,
+					       bswap);
+		}
+	}
+
+	err = drgn_program_find_object(prog, "__cpu_possible_mask", NULL,
+				       DRGN_FIND_OBJECT_VARIABLE, &obj);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		/* Before Linux 4.5, assume that every CPU is possible. */
+		drgn_error_destroy(err);
+		for (size_t i = 0; i < num_offsets; i++) {
+			if (!uint64_vector_append(&possible_cpus,
+						  &(uint64_t){i})) {
+				err = &drgn_enomem;
+				goto out;
+			}
+		}
+	} else if (err) {
+		goto out;
+	} else {
+		uint64_t size;
+		err = drgn_type_sizeof(obj.type, &size);
+		if (err)
+			goto out;
+		if (obj.kind != DRGN_OBJECT_REFERENCE) {
+			err = drgn_error_create(DRGN_ERROR_TYPE,
+						"__cpu_possible_mask is not a variable");
+			goto out;
+		}
+		size -= size % word_size;
+		free(buf);
+		buf = malloc(size ? size : 1);
+		if (!buf) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		err = drgn_program_read_memory(prog, buf, obj.address, size,
+					       false);
+		if (err)
+			goto out;
+		for (uint64_t i = 0; i < size / word_size; i++) {
+			uint64_t word = read_word(buf + i * word_size,
+						  word_size, bswap);
+			while (word) {
+				uint64_t cpu = i * 8 * word_size +
+					       ctz(word);
+				if (cpu >= num_offsets)
+					break;
+				if (!uint64_vector_append(&possible_cpus,
+							  &cpu)) {
+					err = &drgn_enomem;
+					goto out;
+				}
+				word &= word - 1;
+			}
+		}
+	}
+
+	uint64_vector_shrink_to_fit(&possible_cpus);
+	prog->per_cpu_offsets = offsets;
+	prog->num_per_cpu_offsets = num_offsets;
+	prog->possible_cpus = possible_cpus.data;
+	prog->num_possible_cpus = possible_cpus.size;
+	prog->per_cpu_cached = true;
+	offsets = NULL;
+	possible_cpus.data = NULL;
+	possible_cpus.size = 0;
+	err = NULL;
+out:
+	free(buf);
+	uint64_vector_deinit(&possible_cpus);
+	free(offsets);
+	drgn_object_deinit(&obj);
+	return err;
+}
+
+static struct drgn_error *per_cpu_offset(struct drgn_program *prog,
+					 uint64_t cpu, uint64_t *ret)
+{
+	struct drgn_error *err = per_cpu_cache_init(prog);
+	if (err)
+		return err;
+	if (cpu >= prog->num_per_cpu_offsets) {
+		return drgn_error_format(DRGN_ERROR_OUT_OF_BOUNDS,
+					 "invalid CPU %" PRIu64, cpu);
+	}
+	*ret = prog->per_cpu_offsets[cpu];
+	return NULL;
+}
+
+struct drgn_error *linux_helper_per_cpu_ptr(struct drgn_object *res,
+					    const struct drgn_object *ptr,
+					    uint64_t cpu)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(ptr);
+	uint64_t offset;
+	err = per_cpu_offset(prog, cpu, &offset);
+	if (err)
+		return err;
+	uint64_t value;
+	err = drgn_object_read_unsigned(ptr, &value);
+	if (err)
+		return err;
+	return drgn_object_set_unsigned(res, drgn_object_qualified_type(ptr),
+					value + offset, 0);
+}
+
+/*
+ * Read the value of a per-CPU variable on each of the given CPUs into
+ * consecutive elements of a buffer.
+ */
+static struct drgn_error *
+per_cpu_read(struct drgn_program *prog, const struct drgn_object *ptr,
+	     const uint64_t **cpus, size_t *num_cpus,
+	     struct drgn_qualified_type *type_ret, uint64_t *size_ret,
+	     char **buf_ret)
+{
+	struct drgn_error *err;
+
+	if (drgn_object_program(ptr) != prog) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "object is from different program");
+	}
+	if (drgn_type_kind(drgn_underlying_type(ptr->type)) !=
+	    DRGN_TYPE_POINTER) {
+		return drgn_error_create(DRGN_ERROR_TYPE,
+					 "per-CPU variable must be a pointer");
+	}
+	struct drgn_qualified_type type =
+		drgn_type_type(drgn_underlying_type(ptr->type));
+	uint64_t size;
+	err = drgn_type_sizeof(type.type, &size);
+	if (err)
+		return err;
+	uint64_t address;
+	err = drgn_object_read_unsigned(ptr, &address);
+	if (err)
+		return err;
+
+	err = per_cpu_cache_init(prog);
+	if (err)
+		return err;
+	if (!*cpus) {
+		*cpus = prog->possible_cpus;
+		*num_cpus = prog->num_possible_cpus;
+	}
+
+	char *buf = malloc_array(*num_cpus ? *num_cpus : 1, size ? size : 1);
+	if (!buf)
+		return &drgn_enomem;
+	for (size_t i = 0; i < *num_cpus; i++) {
+		uint64_t offset;
+		err = per_cpu_offset(prog, (*cpus)[i], &offset);
+		if (err)
+			goto err;
+		err = drgn_program_read_memory(prog, buf + i * size,
+					       address + offset, size, false);
+		if (err)
+			goto err;
+	}
+	*type_ret = type;
+	*size_ret = size;
+	*buf_ret = buf;
+	return NULL;
+
+err:
+	free(buf);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_per_cpu_values(struct drgn_program *prog,
+			    const struct drgn_object *ptr,
+			    const uint64_t *cpus, size_t num_cpus,
+			    struct drgn_object **values_ret,
+			    size_t *num_values_ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type type;
+	uint64_t size;
+	char *buf;
+	err = per_cpu_read(prog, ptr, &cpus, &num_cpus, &type, &size, &buf);
+	if (err)
+		return err;
+
+	struct drgn_object *values = malloc_array(num_cpus ? num_cpus : 1,
+						  sizeof(*values));
+	if (!values) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (size_t i = 0; i < num_cpus; i++)
+		drgn_object_init(&values[i], prog);
+	for (size_t i = 0; i < num_cpus; i++) {
+		err = drgn_object_set_from_buffer(&values[i], type,
+						  buf + i * size, size, 0, 0,
+						  DRGN_PROGRAM_ENDIAN);
+		if (err) {
+			for (size_t j = 0; j < num_cpus; j++)
+				drgn_object_deinit(&values[j]);
+			free(values);
+			goto out;
+		}
+	}
+	*values_ret = values;
+	*num_values_ret = num_cpus;
+out:
+	free(buf);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_per_cpu_sum(struct drgn_program *prog,
+			 const struct drgn_object *ptr, const uint64_t *cpus,
+			 size_t num_cpus, struct drgn_object *ret)
+{
+	struct drgn_error *err;
+	struct drgn_qualified_type type;
+	uint64_t size;
+	char *buf;
+	err = per_cpu_read(prog, ptr, &cpus, &num_cpus, &type, &size, &buf);
+	if (err)
+		return err;
+
+	/* Get the encoding of the type from a dummy reference. */
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	err = drgn_object_set_reference(&tmp, type, 0, 0, 0,
+					DRGN_PROGRAM_ENDIAN);
+	if (err)
+		goto out;
+	bool is_signed = tmp.encoding == DRGN_OBJECT_ENCODING_SIGNED;
+	if ((!is_signed && tmp.encoding != DRGN_OBJECT_ENCODING_UNSIGNED) ||
+	    tmp.bit_size > 64) {
+		err = drgn_error_create(DRGN_ERROR_TYPE,
+					"per-CPU variable is not an integer");
+		goto out;
+	}
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < num_cpus; i++) {
+		uint64_t value = deserialize_bits(buf + i * size, 0,
+						  tmp.bit_size,
+						  tmp.little_endian);
+		if (is_signed)
+			value = sign_extend(value, tmp.bit_size);
+		sum += value;
+	}
+
+	struct drgn_qualified_type sum_type;
+	err = drgn_program_find_primitive_type(prog,
+					       is_signed ?
+					       DRGN_C_TYPE_LONG_LONG :
+					       DRGN_C_TYPE_UNSIGNED_LONG_LONG,
+					       &sum_type.type);
+	if (err)
+		goto out;
+	sum_type.qualifiers = 0;
+	if (is_signed)
+		err = drgn_object_set_signed(ret, sum_type, sum, 0);
+	else
+		err = drgn_object_set_unsigned(ret, sum_type, sum, 0);
+out:
+	drgn_object_deinit(&tmp);
+	free(buf);
+	return err;
+}
+
+DEFINE_VECTOR(linux_task_file_vector, struct linux_task_file)
+
+/* Number of open_fds words to read at a time. */
+#define TASK_FILES_CHUNK_WORDS 512
+
+struct drgn_error *linux_helper_task_files(const struct drgn_object *task,
+					   struct linux_task_file **files_ret,
+					   size_t *num_files_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(task);
+	uint8_t word_size;
+	err = drgn_program_word_size(prog, &word_size);
+	if (err)
+		return err;
+	bool bswap;
+	err = drgn_program_bswap(prog, &bswap);
+	if (err)
+		return err;
+
+	struct linux_task_file_vector files = VECTOR_INIT;
+	char *bitmap_buf = NULL, *fd_buf = NULL;
+	struct drgn_object fdt, tmp;
+	drgn_object_init(&fdt, prog);
+	drgn_object_init(&tmp, prog);
+
+	err = drgn_object_member_dereference(&fdt, task, "files");
+	if (err)
+		goto out;
+	uint64_t files_addr;
+	err = drgn_object_read_unsigned(&fdt, &files_addr);
+	if (err || !files_addr)
+		goto out;
+	err = drgn_object_member_dereference(&fdt, &fdt, "fdt");
+	if (err)
+		goto out;
+	uint64_t max_fds, open_fds, fd_array;
+	err = drgn_object_member_dereference(&tmp, &fdt, "max_fds");
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &max_fds);
+	if (err)
+		goto out;
+	err = drgn_object_member_dereference(&tmp, &fdt, "open_fds");
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &open_fds);
+	if (err)
+		goto out;
+	err = drgn_object_member_dereference(&tmp, &fdt, "fd");
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &fd_array);
+	if (err)
+		goto out;
+
+	unsigned int bits_per_word = 8 * word_size;
+	uint64_t num_words = (max_fds + bits_per_word - 1) / bits_per_word;
+	bitmap_buf = malloc_array(TASK_FILES_CHUNK_WORDS, word_size);
+	fd_buf = malloc_array(bits_per_word, word_size);
+	if (!bitmap_buf || !fd_buf) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (uint64_t i = 0; i < num_words; i += TASK_FILES_CHUNK_WORDS) {
+		uint64_t n = min(num_words - i,
+				 (uint64_t)TASK_FILES_CHUNK_WORDS);
+		err = drgn_program_read_memory(prog, bitmap_buf,
+					       open_fds + i * word_size,
+					       n * word_size, false);
+		if (err)
+			goto out;
+		for (uint64_t j = 0; j < n; j++) {
+			uint64_t word = read_word(bitmap_buf + j * word_size,
+						  word_size, bswap);
+			if (!word)
+				continue;
+			/*
+			 * Read the fd array entries spanned by this word's set
+			 * bits all at once.
+			 */
+			uint64_t base = (i + j) * bits_per_word;
+			unsigned int first = ctz(word);
+			unsigned int last = fls(word) - 1;
+			err = drgn_program_read_memory(prog, fd_buf,
+						       fd_array +
+						       (base + first) *
+						       word_size,
+						       (last - first + 1) *
+						       word_size, false);
+			if (err)
+				goto out;
+			unsigned int bit;
+			for_each_bit(bit, word) {
+				struct linux_task_file *entry =
+					linux_task_file_vector_append_entry(&files);
+				if (!entry) {
+					err = &drgn_enomem;
+					goto out;
+				}
+				entry->fd = base + bit;
+				entry->file = read_word(fd_buf +
+							(bit - first) *
+							word_size,
+							word_size, bswap);
+			}
+		}
+	}
+	err = NULL;
+out:
+	free(fd_buf);
+	free(bitmap_buf);
+	drgn_object_deinit(&tmp);
+	drgn_object_deinit(&fdt);
+	if (err) {
+		linux_task_file_vector_deinit(&files);
+		return err;
+	}
+	linux_task_file_vector_shrink_to_fit(&files);
+	*files_ret = files.data;
+	*num_files_ret = files.size;
+	return NULL;
+}
+
+DEFINE_VECTOR(char_vector, char)
+
+/*
+ * Maximum number of dentries and mounts to walk for one path. A longer path
+ * must have a cycle.
+ */
+#define PATH_WALK_MAX_STEPS 65536
+
+/* Maximum length of one path component. Longer names are truncated. */
+#define PATH_WALK_MAX_NAME 4096
+
+/* Member offsets used to walk paths, resolved once per program. */
+struct linux_path_offsets {
+	uint64_t d_parent, d_name;
+	/* Range of struct dentry containing d_parent and d_name.name. */
+	uint64_t dentry_start, dentry_size;
+	uint64_t mnt, mnt_parent, mnt_mountpoint, mnt_root;
+	/*
+	 * Range of struct mount containing mnt_parent, mnt_mountpoint, and
+	 * mnt.mnt_root.
+	 */
+	uint64_t mount_start, mount_size;
+	/* Used to get the filesystem type of a dentry with d_dname(). */
+	uint64_t d_op, d_dname, d_inode, i_sb, s_type, fs_type_name;
+};
+
+struct path_walker {
+	struct drgn_program *prog;
+	const struct linux_path_offsets *offsets;
+	uint8_t word_size;
+	bool bswap;
+	/* Buffer for reading the members of a dentry or mount at once. */
+	char buf[256];
+	/* Names of the path components, from the last to the first. */
+	struct char_vector names;
+	/* Offset of each name in names, plus the total size at the end. */
+	struct uint64_vector name_offsets;
+};
+
+static struct drgn_error *
+linux_path_offsets(struct drgn_program *prog,
+		   const struct linux_path_offsets **ret)
+{
+	struct drgn_error *err;
+	if (prog->path_offsets) {
+		*ret = prog->path_offsets;
+		return NULL;
+	}
+
+	uint8_t word_size;
+	err = drgn_program_word_size(prog, &word_size);
+	if (err)
+		return err;
+
+	static const struct {
+		const char *type_name;
+		const char *member;
+		size_t offset;
+	} members[] = {
+#define X(type_name, member, field)	\
+	{ type_name, member, offsetof(struct linux_path_offsets, field) }
+		X("struct dentry", "d_parent", d_parent),
+		X("struct dentry", "d_name.name", d_name),
+		X("struct mount", "mnt", mnt),
+		X("struct mount", "mnt_parent", mnt_parent),
+		X("struct mount", "mnt_mountpoint", mnt_mountpoint),
+		X("struct mount", "mnt.mnt_root", mnt_root),
+		X("struct dentry", "d_op", d_op),
+		X("struct dentry_operations", "d_dname", d_dname),
+		X("struct dentry", "d_inode", d_inode),
+		X("struct inode", "i_sb", i_sb),
+		X("struct super_block", "s_type", s_type),
+		X("struct file_system_type", "name", fs_type_name),
+#undef X
+	};
+	struct linux_path_offsets *offsets = malloc(sizeof(*offsets));
+	if (!offsets)
+		return &drgn_enomem;
+	for (size_t i = 0; i < ARRAY_SIZE(members); i++) {
+		err = linux_type_offsetof(prog, members[i].type_name,
+					  members[i].member,
+					  (uint64_t *)((char *)offsets +
+						       members[i].offset));
+		if (err) {
+			free(offsets);
+			return err;
+		}
+	}
+	offsets->dentry_start = min(offsets->d_parent, offsets->d_name);
+	offsets->dentry_size = (max(offsets->d_parent, offsets->d_name) +
+				word_size - offsets->dentry_start);
+	offsets->mount_start = min(min(offsets->mnt_parent,
+				       offsets->mnt_mountpoint),
+				   offsets->mnt_root);
+	offsets->mount_size = (max(max(offsets->mnt_parent,
+				       offsets->mnt_mountpoint),
+				   offsets->mnt_root) +
+			       word_size - offsets->mount_start);
+
+	prog->path_offsets = offsets;
+	*ret = offsets;
+	return NULL;
+}
+
+static struct drgn_error *path_walker_init(struct path_walker *w,
+					   struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	w->prog = prog;
+	char_vector_init(&w->names);
+	uint64_vector_init(&w->name_offsets);
+	err = drgn_program_word_size(prog, &w->word_size);
+	if (err)
+		return err;
+	err = drgn_program_bswap(prog, &w->bswap);
+	if (err)
+		return err;
+	return linux_path_offsets(prog, &w->offsets);
+}
+
+static void path_walker_deinit(struct path_walker *w)
+{
+	uint64_vector_deinit(&w->name_offsets);
+	char_vector_deinit(&w->names);
+}
+
+/*
+ * Read the words at the given offsets in a structure, which are all within
+ * [start, start + size). If that range fits in the buffer, this reads it all at
+ * once.
+ */
+static struct drgn_error *path_walker_read_words(struct path_walker *w,
+						 uint64_t address,
+						 uint64_t start, uint64_t size,
+						 const uint64_t *offsets,
+						 uint64_t *ret, size_t n)
+{
+	struct drgn_error *err;
+	if (size > sizeof(w->buf)) {
+		for (size_t i = 0; i < n; i++) {
+			err = drgn_program_read_word(w->prog,
+						     address + offsets[i],
+						     false, &ret[i]);
+			if (err)
+				return err;
+		}
+		return NULL;
+	}
+	err = drgn_program_read_memory(w->prog, w->buf, address + start, size,
+				       false);
+	if (err)
+		return err;
+	for (size_t i = 0; i < n; i++) {
+		ret[i] = read_word(w->buf + offsets[i] - start, w->word_size,
+				   w->bswap);
+	}
+	return NULL;
+}
+
+/*
+ * Read a null-terminated string into a vector. This reads up to the next
+ * 256-byte boundary at a time so that a read never crosses into a page that
+ * the string doesn't reach.
+ */
+static struct drgn_error *read_c_string_chunked(struct drgn_program *prog,
+						uint64_t address,
+						size_t max_size,
+						struct char_vector *str)
+{
+	size_t end = str->size + max_size;
+	while (str->size < end) {
+		size_t n = min(256 - address % 256, end - str->size);
+		if (!char_vector_reserve(str, str->size + n))
+			return &drgn_enomem;
+		struct drgn_error *err =
+			drgn_program_read_memory(prog, str->data + str->size,
+						 address, n, false);
+		if (err)
+			return err;
+		char *nul = memchr(str->data + str->size, 0, n);
+		if (nul) {
+			str->size = nul - str->data;
+			break;
+		}
+		str->size += n;
+		address += n;
+	}
+	return NULL;
+}
+
+static struct drgn_error *path_walker_read_mount(struct path_walker *w,
+						 uint64_t mnt,
+						 uint64_t *mnt_root_ret,
+						 uint64_t *mnt_parent_ret,
+						 uint64_t *mnt_mountpoint_ret)
+{
+	const struct linux_path_offsets *o = w->offsets;
+	uint64_t offsets[] = { o->mnt_root, o->mnt_parent, o->mnt_mountpoint };
+	uint64_t values[ARRAY_SIZE(offsets)];
+	struct drgn_error *err =
+		path_walker_read_words(w, mnt, o->mount_start, o->mount_size,
+				       offsets, values, ARRAY_SIZE(offsets));
+	if (err)
+		return err;
+	*mnt_root_ret = values[0];
+	*mnt_parent_ret = values[1];
+	*mnt_mountpoint_ret = values[2];
+	return NULL;
+}
+
+/*
+ * Collect the names from a dentry up to the root of its filesystem or, if mnt
+ * is the address of a struct mount, up to the root of its mount namespace.
+ */
+static struct drgn_error *path_walk(struct path_walker *w, uint64_t mnt,
+				    uint64_t dentry)
+{
+	struct drgn_error *err;
+	uint64_t mnt_root = 0, mnt_parent = 0, mnt_mountpoint = 0;
+	if (mnt) {
+		err = path_walker_read_mount(w, mnt, &mnt_root, &mnt_parent,
+					     &mnt_mountpoint);
+		if (err)
+			return err;
+	}
+	for (int steps = 0; ; steps++) {
+		if (steps >= PATH_WALK_MAX_STEPS) {
+			return drgn_error_create(DRGN_ERROR_OTHER,
+						 "dentry path is too long");
+		}
+		if (mnt && dentry == mnt_root) {
+			if (mnt == mnt_parent)
+				break;
+			dentry = mnt_mountpoint;
+			mnt = mnt_parent;
+			err = path_walker_read_mount(w, mnt, &mnt_root,
+						     &mnt_parent,
+						     &mnt_mountpoint);
+			if (err)
+				return err;
+			continue;
+		}
+		const struct linux_path_offsets *o = w->offsets;
+		uint64_t offsets[] = { o->d_parent, o->d_name };
+		uint64_t values[ARRAY_SIZE(offsets)];
+		err = path_walker_read_words(w, dentry, o->dentry_start,
+					     o->dentry_size, offsets, values,
+					     ARRAY_SIZE(offsets));
+		if (err)
+			return err;
+		uint64_t d_parent = values[0];
+		if (dentry == d_parent)
+			break;
+		uint64_t name = values[1];
+		uint64_t offset = w->names.size;
+		if (!uint64_vector_append(&w->name_offsets, &offset))
+			return &drgn_enomem;
+		err = read_c_string_chunked(w->prog, name, PATH_WALK_MAX_NAME,
+					    &w->names);
+		if (err)
+			return err;
+		dentry = d_parent;
+	}
+	uint64_t offset = w->names.size;
+	if (!uint64_vector_append(&w->name_offsets, &offset))
+		return &drgn_enomem;
+	return NULL;
+}
+
+/*
+ * Join the collected names in reverse order, with a slash before each one if
+ * absolute or between them otherwise.
+ */
+static struct drgn_error *path_walker_join(struct path_walker *w,
+					   bool absolute, char **ret,
+					   size_t *len_ret)
+{
+	size_t num_names = w->name_offsets.size - 1;
+	size_t len = w->names.size + num_names;
+	if (!absolute && num_names)
+		len--;
+	else if (absolute && !num_names)
+		len = 1;
+	char *path = malloc(len + 1);
+	if (!path)
+		return &drgn_enomem;
+	char *p = path;
+	if (absolute && !num_names)
+		*p++ = '/';
+	for (size_t i = num_names; i-- > 0;) {
+		if (absolute || i != num_names - 1)
+			*p++ = '/';
+		uint64_t start = w->name_offsets.data[i];
+		uint64_t end = w->name_offsets.data[i + 1];
+		memcpy(p, w->names.data + start, end - start);
+		p += end - start;
+	}
+	*p = '\0';
+	*ret = path;
+	*len_ret = len;
+	return NULL;
+}
+
+/*
+ * If a dentry has a d_dname() operation (e.g., pipes and sockets), get the
+ * name of its filesystem type in brackets. This is what d_path() returns in
+ * that case, minus the dynamic part of the name.
+ */
+static struct drgn_error *d_path_dname(struct path_walker *w, uint64_t dentry,
+				       bool *found_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = w->prog;
+	const struct linux_path_offsets *o = w->offsets;
+	uint64_t d_op, d_dname;
+
+	*found_ret = false;
+	err = drgn_program_read_word(prog, dentry + o->d_op, false, &d_op);
+	if (err || !d_op)
+		return err;
+	err = drgn_program_read_word(prog, d_op + o->d_dname, false, &d_dname);
+	if (err || !d_dname)
+		return err;
+
+	const uint64_t chain[] = {
+		o->d_inode, o->i_sb, o->s_type, o->fs_type_name,
+	};
+	uint64_t address = dentry;
+	for (size_t i = 0; i < ARRAY_SIZE(chain); i++) {
+		err = drgn_program_read_word(prog, address + chain[i], false,
+					     &address);
+		if (err)
+			return err;
+	}
+	if (!char_vector_append(&w->names, &(char){'['}))
+		return &drgn_enomem;
+	err = read_c_string_chunked(prog, address, PATH_WALK_MAX_NAME,
+				    &w->names);
+	if (err)
+		return err;
+	if (!char_vector_append(&w->names, &(char){']'}))
+		return &drgn_enomem;
+	*found_ret = true;
+	return NULL;
+}
+
+struct drgn_error *linux_helper_d_path(struct drgn_program *prog,
+				       uint64_t vfsmnt, uint64_t dentry,
+				       char **ret, size_t *len_ret)
+{
+	struct drgn_error *err;
+	struct path_walker w;
+	err = path_walker_init(&w, prog);
+	if (err)
+		goto out;
+
+	bool found;
+	err = d_path_dname(&w, dentry, &found);
+	if (err)
+		goto out;
+	if (found) {
+		if (!char_vector_append(&w.names, &(char){'\0'})) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		char_vector_shrink_to_fit(&w.names);
+		*len_ret = w.names.size - 1;
+		*ret = w.names.data;
+		char_vector_init(&w.names);
+		goto out;
+	}
+
+	err = path_walk(&w, vfsmnt - w.offsets->mnt, dentry);
+	if (err)
+		goto out;
+	err = path_walker_join(&w, true, ret, len_ret);
+out:
+	path_walker_deinit(&w);
+	return err;
+}
+
+struct drgn_error *linux_helper_dentry_path(struct drgn_program *prog,
+					    uint64_t dentry, char **ret,
+					    size_t *len_ret)
+{
+	struct drgn_error *err;
+	struct path_walker w;
+	err = path_walker_init(&w, prog);
+	if (err)
+		goto out;
+	err = path_walk(&w, 0, dentry);
+	if (err)
+		goto out;
+	err = path_walker_join(&w, false, ret, len_ret);
+out:
+	path_walker_deinit(&w);
+	return err;
+}
+
+/*
+ * Maximum number of csses to walk. Walking more than this is an error, since
+ * the list of children is probably corrupted.
+ */
+#define CGROUP_WALK_MAX_CSSES (1 << 24)
+
+struct cgroup_walk_node {
+	uint64_t css;
+	/* Index of the parent node, or SIZE_MAX for the root. */
+	size_t parent;
+	size_t path_offset;
+	bool online;
+};
+
+DEFINE_VECTOR(cgroup_walk_node_vector, struct cgroup_walk_node)
+
+struct cgroup_walk_frame {
+	size_t node;
+	/* Next sibling list pointer to visit in the node's children list. */
+	uint64_t next;
+};
+
+DEFINE_VECTOR(cgroup_walk_frame_vector, struct cgroup_walk_frame)
+
+struct cgroup_walker {
+	struct drgn_program *prog;
+	uint8_t word_size;
+	bool bswap;
+	uint64_t css_online;
+	/*
+	 * Range of struct cgroup_subsys_state containing flags, children,
+	 * sibling, and cgroup.
+	 */
+	uint64_t css_start, css_size;
+	uint64_t flags_offset, children_offset, sibling_offset, cgroup_offset;
+	uint64_t kn_offset, kn_name_offset, kn_parent_offset;
+	char *buf;
+	struct cgroup_walk_node_vector nodes;
+	struct cgroup_walk_frame_vector stack;
+	struct char_vector paths;
+};
+
+static struct drgn_error *cgroup_walker_init(struct cgroup_walker *w,
+					     struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	w->prog = prog;
+	w->buf = NULL;
+	cgroup_walk_node_vector_init(&w->nodes);
+	cgroup_walk_frame_vector_init(&w->stack);
+	char_vector_init(&w->paths);
+	err = drgn_program_word_size(prog, &w->word_size);
+	if (err)
+		return err;
+	err = drgn_program_bswap(prog, &w->bswap);
+	if (err)
+		return err;
+
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	err = linux_find_integer_constant(prog, "CSS_ONLINE", &tmp,
+					  &w->css_online);
+	drgn_object_deinit(&tmp);
+	if (err)
+		return err;
+
+	err = linux_type_offsetof(prog, "struct cgroup_subsys_state", "flags",
+				  &w->flags_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct cgroup_subsys_state",
+				  "children.next", &w->children_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct cgroup_subsys_state",
+				  "sibling.next", &w->sibling_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct cgroup_subsys_state", "cgroup",
+				  &w->cgroup_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct cgroup", "kn", &w->kn_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct kernfs_node", "name",
+				  &w->kn_name_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct kernfs_node", "parent",
+				  &w->kn_parent_offset);
+	if (err)
+		return err;
+
+	w->css_start = min(min(w->flags_offset, w->children_offset),
+			   min(w->sibling_offset, w->cgroup_offset));
+	/* flags is an unsigned int; the rest are pointers. */
+	uint64_t end = max(w->flags_offset + sizeof(uint32_t),
+			   max(max(w->children_offset, w->sibling_offset),
+			       w->cgroup_offset) + w->word_size);
+	w->css_size = end - w->css_start;
+	w->buf = malloc(w->css_size);
+	if (!w->buf)
+		return &drgn_enomem;
+	return NULL;
+}
+
+static void cgroup_walker_deinit(struct cgroup_walker *w)
+{
+	char_vector_deinit(&w->paths);
+	cgroup_walk_frame_vector_deinit(&w->stack);
+	cgroup_walk_node_vector_deinit(&w->nodes);
+	free(w->buf);
+}
+
+/* Append the full path of a kernfs node, like kernfs_path(). */
+static struct drgn_error *cgroup_walker_kernfs_path(struct cgroup_walker *w,
+						    uint64_t kn)
+{
+	struct drgn_error *err;
+	static const char null_path[] = "(null)";
+	if (!kn) {
+		if (!char_vector_reserve(&w->paths,
+					 w->paths.size + sizeof(null_path) - 1))
+			return &drgn_enomem;
+		memcpy(w->paths.data + w->paths.size, null_path,
+		       sizeof(null_path) - 1);
+		w->paths.size += sizeof(null_path) - 1;
+		return NULL;
+	}
+
+	struct uint64_vector names = VECTOR_INIT;
+	for (int steps = 0; ; steps++) {
+		if (steps >= PATH_WALK_MAX_STEPS) {
+			err = drgn_error_create(DRGN_ERROR_OTHER,
+						"kernfs path is too long");
+			goto out;
+		}
+		if (!uint64_vector_append(&names, &kn)) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		err = drgn_program_read_word(w->prog, kn + w->kn_parent_offset,
+					     false, &kn);
+		if (err)
+			goto out;
+		if (!kn)
+			break;
+	}
+	if (names.size == 1) {
+		if (!char_vector_append(&w->paths, &(char){'/'}))
+			err = &drgn_enomem;
+		goto out;
+	}
+	for (size_t i = names.size; i-- > 0;) {
+		uint64_t name;
+		err = drgn_program_read_word(w->prog,
+					     names.data[i] + w->kn_name_offset,
+					     false, &name);
+		if (err)
+			goto out;
+		err = read_c_string_chunked(w->prog, name, PATH_WALK_MAX_NAME,
+					    &w->paths);
+		if (err)
+			goto out;
+		if (i && !char_vector_append(&w->paths, &(char){'/'})) {
+			err = &drgn_enomem;
+			goto out;
+		}
+	}
+	err = NULL;
+out:
+	uint64_vector_deinit(&names);
+	return err;
+}
+
+/*
+ * Read a css, record it as a child of the given node, and push it onto the
+ * stack. Its path is its parent's path plus the name of its kernfs node.
+ */
+static struct drgn_error *cgroup_walker_visit(struct cgroup_walker *w,
+					      uint64_t css, size_t parent,
+					      uint64_t *sibling_ret)
+{
+	struct drgn_error *err;
+
+	if (w->nodes.size >= CGROUP_WALK_MAX_CSSES) {
+		return drgn_error_create(DRGN_ERROR_OTHER,
+					 "too many cgroups; list may be corrupted");
+	}
+	err = drgn_program_read_memory(w->prog, w->buf, css + w->css_start,
+				       w->css_size, false);
+	if (err)
+		return err;
+	uint32_t flags;
+	memcpy(&flags, w->buf + w->flags_offset - w->css_start, sizeof(flags));
+	if (w->bswap)
+		flags = bswap_32(flags);
+	uint64_t children = read_word(w->buf + w->children_offset -
+				      w->css_start, w->word_size, w->bswap);
+	uint64_t cgroup = read_word(w->buf + w->cgroup_offset - w->css_start,
+				    w->word_size, w->bswap);
+	if (sibling_ret) {
+		*sibling_ret = read_word(w->buf + w->sibling_offset -
+					 w->css_start, w->word_size, w->bswap);
+	}
+
+	struct cgroup_walk_node *node =
+		cgroup_walk_node_vector_append_entry(&w->nodes);
+	if (!node)
+		return &drgn_enomem;
+	node->css = css;
+	node->parent = parent;
+	node->path_offset = w->paths.size;
+	node->online = flags & w->css_online;
+
+	uint64_t kn;
+	err = drgn_program_read_word(w->prog, cgroup + w->kn_offset, false,
+				     &kn);
+	if (err)
+		return err;
+	if (parent == SIZE_MAX) {
+		err = cgroup_walker_kernfs_path(w, kn);
+		if (err)
+			return err;
+	} else {
+		size_t parent_offset = w->nodes.data[parent].path_offset;
+		size_t parent_len = strlen(w->paths.data + parent_offset);
+		/* The parent's path may move, so reserve first. */
+		if (!char_vector_reserve(&w->paths,
+					 w->paths.size + parent_len + 1))
+			return &drgn_enomem;
+		if (strcmp(w->paths.data + parent_offset, "/") != 0) {
+			memcpy(w->paths.data + w->paths.size,
+			       w->paths.data + parent_offset, parent_len);
+			w->paths.size += parent_len;
+		}
+		w->paths.data[w->paths.size++] = '/';
+		uint64_t name;
+		err = drgn_program_read_word(w->prog, kn + w->kn_name_offset,
+					     false, &name);
+		if (err)
+			return err;
+		err = read_c_string_chunked(w->prog, name, PATH_WALK_MAX_NAME,
+					    &w->paths);
+		if (err)
+			return err;
+	}
+	if (!char_vector_append(&w->paths, &(char){'\0'}))
+		return &drgn_enomem;
+
+	struct cgroup_walk_frame *frame =
+		cgroup_walk_frame_vector_append_entry(&w->stack);
+	if (!frame)
+		return &drgn_enomem;
+	frame->node = w->nodes.size - 1;
+	frame->next = children;
+	return NULL;
+}
+
+/* Visit every css in the subtree in pre-order, including offline ones. */
+static struct drgn_error *cgroup_walker_walk(struct cgroup_walker *w,
+					     uint64_t root)
+{
+	struct drgn_error *err = cgroup_walker_visit(w, root, SIZE_MAX, NULL);
+	if (err)
+		return err;
+	while (w->stack.size) {
+		struct cgroup_walk_frame *frame =
+			&w->stack.data[w->stack.size - 1];
+		uint64_t head = (w->nodes.data[frame->node].css +
+				 w->children_offset);
+		if (frame->next == head) {
+			cgroup_walk_frame_vector_pop(&w->stack);
+			continue;
+		}
+		uint64_t child = frame->next - w->sibling_offset;
+		/* Visiting may reallocate the stack, so save the node first. */
+		size_t node = frame->node;
+		uint64_t sibling;
+		err = cgroup_walker_visit(w, child, node, &sibling);
+		if (err)
+			return err;
+		w->stack.data[w->stack.size - 2].next = sibling;
+	}
+	return NULL;
+}
+
+struct drgn_error *linux_helper_cgroup_walk(const struct drgn_object *css,
+					    const char *container_type,
+					    const char *member,
+					    const char * const *counters,
+					    size_t num_counters,
+					    struct linux_cgroup_walk *ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = drgn_object_program(css);
+	struct cgroup_walker w;
+	struct task_table_builder b = { .nodes = VECTOR_INIT };
+	struct task_table_leaf *leaves = NULL;
+	struct linux_cgroup_counter *out_counters = NULL;
+	uint64_t *csses = NULL;
+	size_t *path_offsets = NULL;
+
+	err = cgroup_walker_init(&w, prog);
+	if (err)
+		goto err;
+	err = task_table_builder_init(&b, prog, "cgroup");
+	if (err)
+		goto err;
+
+	struct drgn_qualified_type qualified_type;
+	err = drgn_program_find_type(prog, container_type, NULL,
+				     &qualified_type);
+	if (err)
+		goto err;
+	uint64_t member_offset;
+	err = drgn_type_offsetof(qualified_type.type, member, &member_offset);
+	if (err)
+		goto err;
+
+	leaves = malloc_array(num_counters ? num_counters : 1,
+			      sizeof(*leaves));
+	out_counters = calloc(num_counters ? num_counters : 1,
+			      sizeof(*out_counters));
+	if (!leaves || !out_counters) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (size_t i = 0; i < num_counters; i++) {
+		struct linux_task_column column;
+		err = task_table_compile(&b, qualified_type, counters[i],
+					 &leaves[i], &column);
+		if (err)
+			goto err;
+		if (column.is_string) {
+			err = drgn_error_format(DRGN_ERROR_TYPE,
+						"cgroup field '%s' is not an integer or pointer",
+						counters[i]);
+			goto err;
+		}
+		out_counters[i].is_signed = column.is_signed;
+	}
+	err = task_table_layout(&b, leaves, num_counters);
+	if (err)
+		goto err;
+
+	uint64_t root;
+	err = drgn_object_read_unsigned(css, &root);
+	if (err)
+		goto err;
+	err = cgroup_walker_walk(&w, root);
+	if (err)
+		goto err;
+	size_t num_nodes = w.nodes.size;
+
+	csses = malloc_array(num_nodes, sizeof(*csses));
+	path_offsets = malloc_array(num_nodes, sizeof(*path_offsets));
+	if (!csses || !path_offsets) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	for (size_t i = 0; i < num_counters; i++) {
+		struct linux_cgroup_counter *counter = &out_counters[i];
+		counter->valid = malloc_array(num_nodes,
+					      sizeof(counter->valid[0]));
+		counter->values = malloc_array(num_nodes,
+					       sizeof(counter->values[0]));
+		counter->totals = calloc(num_nodes,
+					 sizeof(counter->totals[0]));
+		if (!counter->valid || !counter->values || !counter->totals) {
+			err = &drgn_enomem;
+			goto err;
+		}
+	}
+
+	for (size_t n = 0; n < num_nodes && num_counters; n++) {
+		err = task_table_read(&b, w.nodes.data[n].css - member_offset);
+		if (err)
+			goto err;
+		for (size_t i = 0; i < num_counters; i++) {
+			const struct task_table_leaf *leaf = &leaves[i];
+			const struct task_table_node *node =
+				&b.nodes.data[leaf->node];
+			struct linux_cgroup_counter *counter = &out_counters[i];
+			counter->valid[n] = node->valid;
+			if (!node->valid)
+				continue;
+			uint64_t value = deserialize_bits(node->buf + leaf->pos,
+							  leaf->bit_offset,
+							  leaf->bit_size,
+							  leaf->little_endian);
+			if (counter->is_signed)
+				value = sign_extend(value, leaf->bit_size);
+			counter->values[n] = value;
+			if (w.nodes.data[n].online)
+				counter->totals[n] = value;
+		}
+	}
+	/* Children come after their parents, so sum in reverse. */
+	for (size_t n = num_nodes; n-- > 1;) {
+		size_t parent = w.nodes.data[n].parent;
+		for (size_t i = 0; i < num_counters; i++) {
+			out_counters[i].totals[parent] +=
+				out_counters[i].totals[n];
+		}
+	}
+
+	/* Only return online csses. */
+	size_t num_csses = 0;
+	for (size_t n = 0; n < num_nodes; n++) {
+		if (!w.nodes.data[n].online)
+			continue;
+		csses[num_csses] = w.nodes.data[n].css;
+		path_offsets[num_csses] = w.nodes.data[n].path_offset;
+		for (size_t i = 0; i < num_counters; i++) {
+			struct linux_cgroup_counter *counter = &out_counters[i];
+			counter->valid[num_csses] = counter->valid[n];
+			counter->values[num_csses] = counter->values[n];
+			counter->totals[num_csses] = counter->totals[n];
+		}
+		num_csses++;
+	}
+
+	char_vector_shrink_to_fit(&w.paths);
+	ret->csses = csses;
+	ret->num_csses = num_csses;
+	ret->paths = w.paths.data;
+	char_vector_init(&w.paths);
+	ret->path_offsets = path_offsets;
+	ret->counters = out_counters;
+	ret->num_counters = num_counters;
+	err = NULL;
+	goto out;
+
+err:
+	if (out_counters) {
+		struct linux_cgroup_walk walk = {
+			.counters = out_counters,
+			.num_counters = num_counters,
+		};
+		linux_cgroup_walk_deinit(&walk);
+	}
+	free(path_offsets);
+	free(csses);
+out:
+	free(leaves);
+	task_table_builder_deinit(&b);
+	cgroup_walker_deinit(&w);
+	return err;
+}
+
+void linux_cgroup_walk_deinit(struct linux_cgroup_walk *walk)
+{
+	for (size_t i = 0; i < walk->num_counters; i++) {
+		free(walk->counters[i].totals);
+		free(walk->counters[i].values);
+		free(walk->counters[i].valid);
+	}
+	free(walk->counters);
+	free(walk->path_offsets);
+	free(walk->paths);
+	free(walk->csses);
+}
+
+/* Number of hash buckets to read at a time. */
+#define SOCKET_TABLE_CHUNK_BUCKETS 1024
+
+/*
+ * Maximum length of a hash chain. A longer chain is an error, since it probably
+ * has a cycle.
+ */
+#define SOCKET_TABLE_MAX_CHAIN (1 << 20)
+
+DEFINE_VECTOR(linux_socket_vector, struct linux_socket)
+
+struct socket_table_builder {
+	struct drgn_program *prog;
+	uint8_t word_size;
+	bool bswap;
+	/* The whole struct sock_common is read for each socket. */
+	uint64_t common_size;
+	uint64_t node_offset;
+	uint64_t family_offset, state_offset;
+	uint64_t daddr_offset, rcv_saddr_offset;
+	uint64_t dport_offset, num_offset;
+	bool has_ipv6;
+	uint64_t v6_daddr_offset, v6_rcv_saddr_offset;
+	uint64_t sk_socket_offset;
+	/* Offset from a struct socket to its inode's i_ino. */
+	uint64_t socket_ino_offset;
+	/* States of sockets that are only a struct sock_common. */
+	uint64_t time_wait, new_syn_recv;
+	char *common_buf;
+	char *bucket_buf;
+	struct linux_socket_vector sockets;
+};
+
+static struct drgn_error *
+socket_table_builder_init(struct socket_table_builder *b,
+			  struct drgn_program *prog)
+{
+	struct drgn_error *err;
+
+	b->prog = prog;
+	b->common_buf = NULL;
+	b->bucket_buf = NULL;
+	linux_socket_vector_init(&b->sockets);
+	err = drgn_program_word_size(prog, &b->word_size);
+	if (err)
+		return err;
+	err = drgn_program_bswap(prog, &b->bswap);
+	if (err)
+		return err;
+
+	struct drgn_qualified_type common_type;
+	err = drgn_program_find_type(prog, "struct sock_common", NULL,
+				     &common_type);
+	if (err)
+		return err;
+	err = drgn_type_sizeof(common_type.type, &b->common_size);
+	if (err)
+		return err;
+	static const struct {
+		const char *member;
+		size_t offset;
+		uint64_t size;
+	} common_members[] = {
+#define X(member, field, size) \
+	{ member, offsetof(struct socket_table_builder, field), size }
+		/* skc_nulls_node is in a union with skc_node. */
+		X("skc_node.next", node_offset, 0),
+		X("skc_family", family_offset, 2),
+		X("skc_state", state_offset, 1),
+		X("skc_daddr", daddr_offset, 4),
+		X("skc_rcv_saddr", rcv_saddr_offset, 4),
+		X("skc_dport", dport_offset, 2),
+		X("skc_num", num_offset, 2),
+#undef X
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(common_members); i++) {
+		uint64_t *offset = (uint64_t *)((char *)b +
+						common_members[i].offset);
+		err = drgn_type_offsetof(common_type.type,
+					 common_members[i].member, offset);
+		if (err)
+			return err;
+		uint64_t size = common_members[i].size;
+		if (!size)
+			size = b->word_size;
+		if (*offset > b->common_size ||
+		    size > b->common_size - *offset) {
+			return drgn_error_create(DRGN_ERROR_OUT_OF_BOUNDS,
+						 "field is out of bounds of struct sock_common");
+		}
+	}
+	/* The IPv6 addresses only exist if CONFIG_IPV6 is enabled. */
+	err = drgn_type_offsetof(common_type.type, "skc_v6_daddr",
+				 &b->v6_daddr_offset);
+	if (!err) {
+		err = drgn_type_offsetof(common_type.type, "skc_v6_rcv_saddr",
+					 &b->v6_rcv_saddr_offset);
+		if (err)
+			return err;
+		b->has_ipv6 = (b->v6_daddr_offset + 16 <= b->common_size &&
+			       b->v6_rcv_saddr_offset + 16 <= b->common_size);
+	} else if (err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		b->has_ipv6 = false;
+	} else {
+		return err;
+	}
+
+	err = linux_type_offsetof(prog, "struct sock", "sk_socket",
+				  &b->sk_socket_offset);
+	if (err)
+		return err;
+	uint64_t socket_offset, vfs_inode_offset, i_ino_offset;
+	err = linux_type_offsetof(prog, "struct socket_alloc", "socket",
+				  &socket_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct socket_alloc", "vfs_inode",
+				  &vfs_inode_offset);
+	if (err)
+		return err;
+	err = linux_type_offsetof(prog, "struct inode", "i_ino",
+				  &i_ino_offset);
+	if (err)
+		return err;
+	b->socket_ino_offset = vfs_inode_offset + i_ino_offset - socket_offset;
+
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	err = linux_find_integer_constant(prog, "TCP_TIME_WAIT", &tmp,
+					  &b->time_wait);
+	if (err)
+		goto out;
+	/* TCP_NEW_SYN_RECV was added in Linux 4.1. */
+	err = linux_find_integer_constant(prog, "TCP_NEW_SYN_RECV", &tmp,
+					  &b->new_syn_recv);
+	if (err && err->code == DRGN_ERROR_LOOKUP) {
+		drgn_error_destroy(err);
+		b->new_syn_recv = UINT64_MAX;
+		err = NULL;
+	}
+out:
+	drgn_object_deinit(&tmp);
+	if (err)
+		return err;
+
+	b->common_buf = malloc(b->common_size);
+	if (!b->common_buf)
+		return &drgn_enomem;
+	return NULL;
+}
+
+static void socket_table_builder_deinit(struct socket_table_builder *b)
+{
+	linux_socket_vector_deinit(&b->sockets);
+	free(b->bucket_buf);
+	free(b->common_buf);
+}
+
+static uint16_t read_u16(const char *buf, bool bswap)
+{
+	uint16_t value;
+	memcpy(&value, buf, sizeof(value));
+	return bswap ? bswap_16(value) : value;
+}
+
+/* Read a socket and append it. */
+static struct drgn_error *socket_table_add(struct socket_table_builder *b,
+					   uint64_t sk)
+{
+	struct drgn_error *err;
+	const char *buf = b->common_buf;
+	struct linux_socket *socket =
+		linux_socket_vector_append_entry(&b->sockets);
+	if (!socket)
+		return &drgn_enomem;
+	memset(socket, 0, sizeof(*socket));
+	socket->sk = sk;
+	socket->family = read_u16(buf + b->family_offset, b->bswap);
+	socket->state = buf[b->state_offset];
+	socket->sport = read_u16(buf + b->num_offset, b->bswap);
+	/* skc_dport is big endian. */
+	socket->dport = ((uint16_t)(uint8_t)buf[b->dport_offset] << 8 |
+			 (uint8_t)buf[b->dport_offset + 1]);
+	if (socket->family == LINUX_AF_INET6 && b->has_ipv6) {
+		memcpy(socket->saddr, buf + b->v6_rcv_saddr_offset, 16);
+		memcpy(socket->daddr, buf + b->v6_daddr_offset, 16);
+	} else {
+		memcpy(socket->saddr, buf + b->rcv_saddr_offset, 4);
+		memcpy(socket->daddr, buf + b->daddr_offset, 4);
+	}
+
+	if (socket->state == b->time_wait || socket->state == b->new_syn_recv)
+		return NULL;
+	uint64_t sock;
+	err = drgn_program_read_word(b->prog, sk + b->sk_socket_offset, false,
+				     &sock);
+	if (err || !sock)
+		return err;
+	return drgn_program_read_word(b->prog, sock + b->socket_ino_offset,
+				      false, &socket->inode);
+}
+
+/*
+ * Walk every chain in an array of hash buckets. The list head is at
+ * head_offset in each bucket. Chains may be hlists, which end with NULL, or
+ * nulls lists, which end with an odd "nulls" marker.
+ */
+static struct drgn_error *socket_table_walk(struct socket_table_builder *b,
+					    uint64_t buckets,
+					    uint64_t num_buckets,
+					    uint64_t bucket_size,
+					    uint64_t head_offset)
+{
+	struct drgn_error *err;
+	if (head_offset + b->word_size > bucket_size) {
+		return drgn_error_create(DRGN_ERROR_OUT_OF_BOUNDS,
+					 "list head is out of bounds of hash bucket");
+	}
+	free(b->bucket_buf);
+	b->bucket_buf = malloc_array(SOCKET_TABLE_CHUNK_BUCKETS, bucket_size);
+	if (!b->bucket_buf)
+		return &drgn_enomem;
+	for (uint64_t i = 0; i < num_buckets;
+	     i += SOCKET_TABLE_CHUNK_BUCKETS) {
+		uint64_t n = min(num_buckets - i,
+				 (uint64_t)SOCKET_TABLE_CHUNK_BUCKETS);
+		err = drgn_program_read_memory(b->prog, b->bucket_buf,
+					       buckets + i * bucket_size,
+					       n * bucket_size, false);
+		if (err)
+			return err;
+		for (uint64_t j = 0; j < n; j++) {
+			uint64_t node = read_word(b->bucket_buf +
+						  j * bucket_size +
+						  head_offset,
+						  b->word_size, b->bswap);
+			for (int length = 0; node && !(node & 1); length++) {
+				if (length >= SOCKET_TABLE_MAX_CHAIN) {
+					return drgn_error_create(DRGN_ERROR_OTHER,
+								 "socket hash chain is too long");
+				}
+				uint64_t sk = node - b->node_offset;
+				err = drgn_program_read_memory(b->prog,
+							       b->common_buf,
+							       sk,
+							       b->common_size,
+							       false);
+				if (err)
+					return err;
+				node = read_word(b->common_buf +
+						 b->node_offset, b->word_size,
+						 b->bswap);
+				err = socket_table_add(b, sk);
+				if (err)
+					return err;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Walk the hash table whose bucket array is the given member of a table
+ * object, with the given number of buckets or the mask in mask_member plus
+ * one.
+ */
+static struct drgn_error *
+socket_table_walk_member(struct socket_table_builder *b,
+			 const struct drgn_object *table, const char *member,
+			 const char *mask_member, const char *head_member)
+{
+	struct drgn_error *err;
+	struct drgn_object buckets;
+	drgn_object_init(&buckets, b->prog);
+
+	err = drgn_object_member(&buckets, table, member);
+	if (err)
+		goto out;
+	struct drgn_type *type = drgn_underlying_type(buckets.type);
+	struct drgn_type *bucket_type;
+	uint64_t address, num_buckets;
+	if (drgn_type_kind(type) == DRGN_TYPE_ARRAY) {
+		if (buckets.kind != DRGN_OBJECT_REFERENCE) {
+			err = drgn_error_create(DRGN_ERROR_TYPE,
+						"hash table is not in memory");
+			goto out;
+		}
+		address = buckets.address;
+		num_buckets = drgn_type_length(type);
+		bucket_type = drgn_type_type(type).type;
+	} else if (drgn_type_kind(type) == DRGN_TYPE_POINTER) {
+		err = drgn_object_read_unsigned(&buckets, &address);
+		if (err)
+			goto out;
+		bucket_type = drgn_type_type(type).type;
+		err = drgn_object_member(&buckets, table, mask_member);
+		if (err)
+			goto out;
+		uint64_t mask;
+		err = drgn_object_read_unsigned(&buckets, &mask);
+		if (err)
+			goto out;
+		num_buckets = mask + 1;
+	} else {
+		err = drgn_error_format(DRGN_ERROR_TYPE,
+					"%s is not an array or pointer",
+					member);
+		goto out;
+	}
+	if (!address)
+		goto out;
+
+	uint64_t bucket_size, head_offset;
+	err = drgn_type_sizeof(bucket_type, &bucket_size);
+	if (err)
+		goto out;
+	err = drgn_type_offsetof(bucket_type, head_member, &head_offset);
+	if (err)
+		goto out;
+	err = socket_table_walk(b, address, num_buckets, bucket_size,
+				head_offset);
+out:
+	drgn_object_deinit(&buckets);
+	return err;
+}
+
+struct drgn_error *
+linux_helper_socket_table(struct drgn_program *prog,
+			  enum linux_socket_protocol protocol,
+			  struct linux_socket **sockets_ret,
+			  size_t *num_sockets_ret)
+{
+	struct drgn_error *err;
+	struct socket_table_builder b;
+	struct drgn_object table;
+	drgn_object_init(&table, prog);
+
+	err = socket_table_builder_init(&b, prog);
+	if (err)
+		goto out;
+
+	if (protocol == LINUX_SOCKET_TCP) {
+		err = drgn_program_find_object(prog, "tcp_hashinfo", NULL,
+					       DRGN_FIND_OBJECT_VARIABLE,
+					       &table);
+		if (err)
+			goto out;
+		/*
+		 * Before Linux 5.19, listening sockets are in listening_hash
+		 * (an hlist or, later, a nulls list). lhash2 also exists since
+		 * Linux 4.16, but it is only a secondary index until 5.19.
+		 */
+		struct drgn_type *hashinfo_type =
+			drgn_underlying_type(table.type);
+		bool has_listening_hash;
+		err = drgn_type_has_member(hashinfo_type, "listening_hash",
+					   &has_listening_hash);
+		if (err)
+			goto out;
+		if (has_listening_hash) {
+			struct drgn_qualified_type bucket_type;
+			err = drgn_program_find_type(prog,
+						     "struct inet_listen_hashbucket",
+						     NULL, &bucket_type);
+			if (err)
+				goto out;
+			bool has_head;
+			err = drgn_type_has_member(bucket_type.type, "head",
+						   &has_head);
+			if (err)
+				goto out;
+			err = socket_table_walk_member(&b, &table,
+						       "listening_hash", NULL,
+						       has_head ?
+						       "head" : "nulls_head");
+		} else {
+			err = socket_table_walk_member(&b, &table, "lhash2",
+						       "lhash2_mask",
+						       "nulls_head");
+		}
+		if (err)
+			goto out;
+		err = socket_table_walk_member(&b, &table, "ehash",
+					       "ehash_mask", "chain");
+	} else if (protocol == LINUX_SOCKET_UDP) {
+		err = drgn_program_find_object(prog, "udp_table", NULL,
+					       DRGN_FIND_OBJECT_VARIABLE,
+					       &table);
+		if (err)
+			goto out;
+		err = socket_table_walk_member(&b, &table, "hash", "mask",
+					       "head");
+	} else {
+		err = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					"invalid socket protocol");
+	}
+	if (err)
+		goto out;
+
+	linux_socket_vector_shrink_to_fit(&b.sockets);
+	*sockets_ret = b.sockets.data;
+	*num_sockets_ret = b.sockets.size;
+	linux_socket_vector_init(&b.sockets);
+out:
+	socket_table_builder_deinit(&b);
+	drgn_object_deinit(&table);
+	return err;
+}
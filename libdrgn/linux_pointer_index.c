@@ -0,0 +1,525 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <byteswap.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cityhash.h"
+#include "drgn.h"
+#include "helpers.h"
+#include "memory_scan.h"
+#include "minmax.h"
+#include "program.h"
+#include "util.h"
+#include "vector.h"
+
+#define POINTER_INDEX_MAGIC "DRGNPTRX"
+#define POINTER_INDEX_VERSION 2
+
+/*
+ * On-disk format of a pointer index: this header followed by num_refs struct
+ * linux_pointer_ref in host byte order. The index is only meant to be used on
+ * the machine that built it, so a byte order mismatch is caught by the version
+ * check.
+ */
+struct linux_pointer_index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t word_size;
+	uint64_t page_offset;
+	uint64_t phys_offset;
+	uint64_t direct_map_size;
+	/* Hash of the VMCOREINFO note; see linux_pointer_index_core_id(). */
+	uint64_t core_id;
+	uint64_t num_refs;
+};
+
+/* Bounds of the direct mapping. */
+struct linux_pointer_index_layout {
+	/* Start of the direct mapping. */
+	uint64_t page_offset;
+	/* Physical address mapped at page_offset. */
+	uint64_t phys_offset;
+	uint64_t direct_map_size;
+	uint32_t word_size;
+};
+
+struct linux_pointer_index {
+	struct linux_pointer_index_layout layout;
+	uint64_t core_id;
+	const struct linux_pointer_ref *refs;
+	size_t num_refs;
+	/*
+	 * If the index was loaded from a file, the mapping of the file.
+	 * Otherwise, refs was allocated with malloc().
+	 */
+	void *map;
+	size_t map_size;
+};
+
+DEFINE_VECTOR(linux_pointer_ref_vector, struct linux_pointer_ref)
+
+DEFINE_VECTOR(drgn_memory_scan_chunk_vector, struct drgn_memory_scan_chunk)
+
+struct linux_pointer_scan_thread {
+	const struct linux_pointer_scan *scan;
+	struct linux_pointer_ref_vector refs;
+	struct drgn_error *err;
+};
+
+struct linux_pointer_scan {
+	struct linux_pointer_index_layout layout;
+	bool bswap;
+	struct drgn_memory_scan mem;
+	struct drgn_memory_scan_chunk_vector chunks;
+	struct linux_pointer_scan_thread *threads;
+	/* Set once any thread fails so that the others stop early. */
+	bool failed;
+};
+
+/* Get the bounds of the direct mapping as recorded in a pointer index. */
+static struct drgn_error *
+linux_pointer_index_layout(struct drgn_program *prog,
+			   struct linux_pointer_index_layout *ret)
+{
+	struct drgn_error *err;
+
+	if (!(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL)) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "pointer index is only available for the Linux kernel");
+	}
+	uint64_t page_size = prog->vmcoreinfo.page_size;
+	if (!page_size) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "pointer index requires page size from VMCOREINFO");
+	}
+	uint8_t word_size;
+	err = drgn_program_word_size(prog, &word_size);
+	if (err)
+		return err;
+
+	uint64_t page_offset, phys_offset;
+	err = linux_helper_direct_map(prog, &page_offset, &phys_offset);
+	if (err)
+		return err;
+	struct drgn_object tmp;
+	drgn_object_init(&tmp, prog);
+	uint64_t max_pfn;
+	err = drgn_program_find_object(prog, "max_pfn", NULL,
+				       DRGN_FIND_OBJECT_ANY, &tmp);
+	if (err)
+		goto out;
+	err = drgn_object_read_unsigned(&tmp, &max_pfn);
+	if (err)
+		goto out;
+
+	/* The direct mapping covers physical memory from phys_offset. */
+	uint64_t end, direct_map_size;
+	if (__builtin_mul_overflow(max_pfn, page_size, &end))
+		end = UINT64_MAX;
+	direct_map_size = end > phys_offset ? end - phys_offset : 0;
+	/* The direct mapping can't extend past the end of the address space. */
+	uint64_t max_address = word_size == 8 ? UINT64_MAX : UINT32_MAX;
+	if (page_offset > max_address) {
+		err = drgn_error_create(DRGN_ERROR_OTHER,
+					"PAGE_OFFSET is out of range");
+		goto out;
+	}
+	direct_map_size = min(direct_map_size, max_address - page_offset);
+
+	ret->page_offset = page_offset;
+	ret->phys_offset = phys_offset;
+	ret->direct_map_size = direct_map_size;
+	ret->word_size = word_size;
+	err = NULL;
+out:
+	drgn_object_deinit(&tmp);
+	return err;
+}
+
+/*
+ * Identify the core dump that a pointer index is built from. The VMCOREINFO
+ * note includes the kernel release, the KASLR offset, and, for a kdump, the
+ * crash time, so different kernels and different crashes of the same kernel
+ * get different identities.
+ */
+static uint64_t linux_pointer_index_core_id(struct drgn_program *prog)
+{
+	return cityhash64(prog->vmcoreinfo.raw, prog->vmcoreinfo.raw_size);
+}
+
+/* Find the aligned pointers starting in buf[0, end) that are entirely in buf. */
+static struct drgn_error *linux_pointer_scan_buffer(const char *buf,
+						    uint64_t address,
+						    uint64_t len, uint64_t end,
+						    void *arg)
+{
+	struct linux_pointer_scan_thread *thread = arg;
+	const struct linux_pointer_scan *scan = thread->scan;
+	struct linux_pointer_ref_vector *refs = &thread->refs;
+	uint64_t page_offset = scan->layout.page_offset;
+	uint64_t direct_map_size = scan->layout.direct_map_size;
+	uint32_t word_size = scan->layout.word_size;
+	if (len < word_size)
+		return NULL;
+	end = min(end, len - word_size + 1);
+	uint64_t pos = (word_size - address % word_size) % word_size;
+	uint64_t location = page_offset + (address - scan->layout.phys_offset);
+	if (word_size == 8) {
+		for (; pos < end; pos += 8) {
+			uint64_t value;
+			memcpy(&value, buf + pos, 8);
+			if (scan->bswap)
+				value = bswap_64(value);
+			if (value - page_offset < direct_map_size) {
+				struct linux_pointer_ref ref = {
+					value, location + pos
+				};
+				if (!linux_pointer_ref_vector_append(refs, &ref))
+					return &drgn_enomem;
+			}
+		}
+	} else {
+		for (; pos < end; pos += 4) {
+			uint32_t value;
+			memcpy(&value, buf + pos, 4);
+			if (scan->bswap)
+				value = bswap_32(value);
+			if (value - page_offset < direct_map_size) {
+				struct linux_pointer_ref ref = {
+					value, location + pos
+				};
+				if (!linux_pointer_ref_vector_append(refs, &ref))
+					return &drgn_enomem;
+			}
+		}
+	}
+	return NULL;
+}
+
+static int linux_pointer_ref_compare(const void *_a, const void *_b)
+{
+	const struct linux_pointer_ref *a = _a, *b = _b;
+	if (a->value != b->value)
+		return a->value < b->value ? -1 : 1;
+	if (a->location != b->location)
+		return a->location < b->location ? -1 : 1;
+	return 0;
+}
+
+struct drgn_error *linux_pointer_index_create(struct drgn_program *prog,
+					      struct linux_pointer_index **ret)
+{
+	struct drgn_error *err;
+	struct linux_pointer_scan scan = {};
+	drgn_memory_scan_chunk_vector_init(&scan.chunks);
+
+	err = linux_pointer_index_layout(prog, &scan.layout);
+	if (err)
+		goto out_chunks;
+	err = drgn_program_bswap(prog, &scan.bswap);
+	if (err)
+		goto out_chunks;
+	if (!scan.layout.direct_map_size) {
+		err = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					"program does not have physical memory to index");
+		goto out_chunks;
+	}
+
+	/* Pointers may start in one chunk and end in the next. */
+	err = drgn_memory_scan_init(&scan.mem, &prog->reader, true,
+				    scan.layout.phys_offset,
+				    scan.layout.phys_offset +
+				    scan.layout.direct_map_size - 1,
+				    scan.layout.word_size - 1);
+	if (err)
+		goto out_chunks;
+	for (;;) {
+		struct drgn_memory_scan_chunk *chunk =
+			drgn_memory_scan_chunk_vector_append_entry(&scan.chunks);
+		if (!chunk) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		if (!drgn_memory_scan_next_chunk(&scan.mem, chunk)) {
+			scan.chunks.size--;
+			break;
+		}
+	}
+	if (!scan.chunks.size) {
+		err = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					"program does not have physical memory to index");
+		goto out;
+	}
+
+	int num_threads = scan.mem.num_threads;
+	scan.threads = calloc(num_threads, sizeof(scan.threads[0]));
+	if (!scan.threads) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	for (int i = 0; i < num_threads; i++) {
+		scan.threads[i].scan = &scan;
+		linux_pointer_ref_vector_init(&scan.threads[i].refs);
+	}
+
+	#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+	for (size_t i = 0; i < scan.chunks.size; i++) {
+		struct linux_pointer_scan_thread *thread =
+			&scan.threads[omp_get_thread_num()];
+		if (__atomic_load_n(&scan.failed, __ATOMIC_RELAXED))
+			continue;
+		thread->err = drgn_memory_scan_visit(&scan.mem,
+						     &scan.chunks.data[i],
+						     linux_pointer_scan_buffer,
+						     thread);
+		if (thread->err)
+			__atomic_store_n(&scan.failed, true, __ATOMIC_RELAXED);
+	}
+
+	size_t num_refs = 0;
+	for (int i = 0; i < scan.mem.num_threads; i++) {
+		struct linux_pointer_scan_thread *thread = &scan.threads[i];
+		if (thread->err) {
+			if (err)
+				drgn_error_destroy(thread->err);
+			else
+				err = thread->err;
+		}
+		num_refs += thread->refs.size;
+	}
+	if (err)
+		goto out;
+
+	struct linux_pointer_index *index = malloc(sizeof(*index));
+	if (!index) {
+		err = &drgn_enomem;
+		goto out;
+	}
+	struct linux_pointer_ref *refs =
+		malloc_array(max(num_refs, (size_t)1), sizeof(*refs));
+	if (!refs) {
+		free(index);
+		err = &drgn_enomem;
+		goto out;
+	}
+	size_t pos = 0;
+	for (int i = 0; i < scan.mem.num_threads; i++) {
+		struct linux_pointer_scan_thread *thread = &scan.threads[i];
+		memcpy(refs + pos, thread->refs.data,
+		       thread->refs.size * sizeof(*refs));
+		pos += thread->refs.size;
+		/* Free memory as we go, since the index may be huge. */
+		linux_pointer_ref_vector_deinit(&thread->refs);
+		linux_pointer_ref_vector_init(&thread->refs);
+	}
+	qsort(refs, num_refs, sizeof(*refs), linux_pointer_ref_compare);
+
+	index->layout = scan.layout;
+	index->core_id = linux_pointer_index_core_id(prog);
+	index->refs = refs;
+	index->num_refs = num_refs;
+	index->map = NULL;
+	index->map_size = 0;
+	*ret = index;
+	err = NULL;
+out:
+	if (scan.threads) {
+		for (int i = 0; i < scan.mem.num_threads; i++)
+			linux_pointer_ref_vector_deinit(&scan.threads[i].refs);
+		free(scan.threads);
+	}
+	drgn_memory_scan_deinit(&scan.mem);
+out_chunks:
+	drgn_memory_scan_chunk_vector_deinit(&scan.chunks);
+	return err;
+}
+
+struct drgn_error *linux_pointer_index_load(struct drgn_program *prog,
+					    const char *path,
+					    struct linux_pointer_index **ret)
+{
+	struct drgn_error *err;
+	struct linux_pointer_index_layout layout;
+	err = linux_pointer_index_layout(prog, &layout);
+	if (err)
+		return err;
+	uint64_t core_id = linux_pointer_index_core_id(prog);
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		err = drgn_error_create_os("fstat", errno, path);
+		close(fd);
+		return err;
+	}
+	if (st.st_size < (off_t)sizeof(struct linux_pointer_index_header)) {
+		close(fd);
+		return drgn_error_format(DRGN_ERROR_OTHER,
+					 "%s: pointer index is truncated", path);
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	err = map == MAP_FAILED ? drgn_error_create_os("mmap", errno, path)
+				: NULL;
+	close(fd);
+	if (err)
+		return err;
+
+	const struct linux_pointer_index_header *header = map;
+	uint64_t refs_size;
+	if (memcmp(header->magic, POINTER_INDEX_MAGIC,
+		   sizeof(header->magic)) != 0) {
+		err = drgn_error_format(DRGN_ERROR_OTHER,
+					"%s: not a pointer index", path);
+		goto err;
+	}
+	if (header->version != POINTER_INDEX_VERSION) {
+		err = drgn_error_format(DRGN_ERROR_OTHER,
+					"%s: unsupported pointer index version",
+					path);
+		goto err;
+	}
+	if (__builtin_mul_overflow(header->num_refs,
+				   sizeof(struct linux_pointer_ref),
+				   &refs_size) ||
+	    refs_size != st.st_size - sizeof(*header)) {
+		err = drgn_error_format(DRGN_ERROR_OTHER,
+					"%s: pointer index is truncated", path);
+		goto err;
+	}
+	if (header->word_size != layout.word_size ||
+	    header->page_offset != layout.page_offset ||
+	    header->phys_offset != layout.phys_offset ||
+	    header->direct_map_size != layout.direct_map_size) {
+		err = drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					"%s: pointer index was built for a different kernel",
+					path);
+		goto err;
+	}
+	if (header->core_id != core_id) {
+		err = drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					"%s: pointer index was built for a different core dump",
+					path);
+		goto err;
+	}
+
+	struct linux_pointer_index *index = malloc(sizeof(*index));
+	if (!index) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	index->layout = layout;
+	index->core_id = core_id;
+	index->refs = (const struct linux_pointer_ref *)(header + 1);
+	index->num_refs = header->num_refs;
+	index->map = map;
+	index->map_size = st.st_size;
+	*ret = index;
+	return NULL;
+
+err:
+	munmap(map, st.st_size);
+	return err;
+}
+
+static bool write_all(int fd, const void *buf, size_t count)
+{
+	while (count) {
+		ssize_t ret = write(fd, buf, count);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		buf = (const char *)buf + ret;
+		count -= ret;
+	}
+	return true;
+}
+
+struct drgn_error *
+linux_pointer_index_save(const struct linux_pointer_index *index,
+			 const char *path)
+{
+	struct linux_pointer_index_header header = {
+		.magic = POINTER_INDEX_MAGIC,
+		.version = POINTER_INDEX_VERSION,
+		.word_size = index->layout.word_size,
+		.page_offset = index->layout.page_offset,
+		.phys_offset = index->layout.phys_offset,
+		.direct_map_size = index->layout.direct_map_size,
+		.core_id = index->core_id,
+		.num_refs = index->num_refs,
+	};
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+		return drgn_error_create_os("open", errno, path);
+	if (!write_all(fd, &header, sizeof(header)) ||
+	    !write_all(fd, index->refs,
+		       index->num_refs * sizeof(index->refs[0]))) {
+		struct drgn_error *err =
+			drgn_error_create_os("write", errno, path);
+		close(fd);
+		unlink(path);
+		return err;
+	}
+	if (close(fd) == -1) {
+		struct drgn_error *err =
+			drgn_error_create_os("close", errno, path);
+		unlink(path);
+		return err;
+	}
+	return NULL;
+}
+
+void linux_pointer_index_destroy(struct linux_pointer_index *index)
+{
+	if (!index)
+		return;
+	if (index->map)
+		munmap(index->map, index->map_size);
+	else
+		free((struct linux_pointer_ref *)index->refs);
+	free(index);
+}
+
+size_t linux_pointer_index_size(const struct linux_pointer_index *index)
+{
+	return index->num_refs;
+}
+
+/* Find the first pointer whose value is greater than or equal to value. */
+static size_t linux_pointer_index_lower_bound(const struct linux_pointer_index *index,
+					      uint64_t value)
+{
+	size_t lo = 0, hi = index->num_refs;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->refs[mid].value < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void linux_pointer_index_find(const struct linux_pointer_index *index,
+			      uint64_t start, uint64_t end,
+			      const struct linux_pointer_ref **refs_ret,
+			      size_t *num_refs_ret)
+{
+	size_t lo = linux_pointer_index_lower_bound(index, start);
+	size_t hi = end > start ?
+		    linux_pointer_index_lower_bound(index, end) : lo;
+	*refs_ret = index->refs + lo;
+	*num_refs_ret = hi - lo;
+}
@@ -2,16 +2,38 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include <errno.h>
+#include <omp.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "hash_table.h"
 #include "memory_reader.h"
 #include "minmax.h"
+#include "util.h"
 
 DEFINE_BINARY_SEARCH_TREE_FUNCTIONS(drgn_memory_segment_tree,
 				    binary_search_tree_scalar_cmp, splay)
 
+/* Contents of a recorded page as of when it was first read. */
+struct drgn_recorded_page {
+	/* Bitmap of the bytes in data that could be read. */
+	uint64_t valid[DRGN_MEMORY_RECORDING_PAGE_SIZE / 64];
+	char data[DRGN_MEMORY_RECORDING_PAGE_SIZE];
+};
+
+DEFINE_HASH_MAP(drgn_recorded_page_map, uint64_t, struct drgn_recorded_page *,
+		int_key_hash_pair, scalar_key_eq)
+
+struct drgn_memory_recording {
+	bool enabled;
+	/* Recorded pages keyed by start address. */
+	struct drgn_recorded_page_map virtual_pages;
+	struct drgn_recorded_page_map physical_pages;
+	/* Reads may happen in parallel. */
+	omp_lock_t lock;
+};
+
 void drgn_memory_reader_init(struct drgn_memory_reader *reader)
 {
 	drgn_memory_segment_tree_init(&reader->virtual_segments);
@@ -31,8 +53,24 @@ static void free_memory_segment_tree(struct drgn_memory_segment_tree *tree)
 	}
 }
 
+static void free_recorded_pages(struct drgn_recorded_page_map *map)
+{
+	for (struct drgn_recorded_page_map_iterator it =
+	     drgn_recorded_page_map_first(map);
+	     it.entry; it = drgn_recorded_page_map_next(it))
+		free(it.entry->value);
+	drgn_recorded_page_map_deinit(map);
+}
+
 void drgn_memory_reader_deinit(struct drgn_memory_reader *reader)
 {
+	struct drgn_memory_recording *recording = reader->recording;
+	if (recording) {
+		omp_destroy_lock(&recording->lock);
+		free_recorded_pages(&recording->physical_pages);
+		free_recorded_pages(&recording->virtual_pages);
+		free(recording);
+	}
 	free_memory_segment_tree(&reader->physical_segments);
 	free_memory_segment_tree(&reader->virtual_segments);
 }
@@ -224,9 +262,234 @@ insert:
 	return NULL;
 }
 
-struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
-					   void *buf, uint64_t address,
-					   size_t count, bool physical)
+struct drgn_error *
+drgn_memory_reader_for_each_segment(struct drgn_memory_reader *reader,
+				    bool physical, drgn_memory_segment_fn *fn,
+				    void *arg)
+{
+	struct drgn_memory_segment_tree *tree = (physical ?
+						 &reader->physical_segments :
+						 &reader->virtual_segments);
+	for (struct drgn_memory_segment_tree_iterator it =
+	     drgn_memory_segment_tree_first(tree);
+	     it.entry; it = drgn_memory_segment_tree_next(it)) {
+		struct drgn_error *err = fn(it.entry, arg);
+		if (err)
+			return err;
+	}
+	return NULL;
+}
+
+struct drgn_error *
+drgn_memory_reader_start_recording(struct drgn_memory_reader *reader)
+{
+	struct drgn_memory_recording *recording = reader->recording;
+	if (!recording) {
+		recording = malloc(sizeof(*recording));
+		if (!recording)
+			return &drgn_enomem;
+		drgn_recorded_page_map_init(&recording->virtual_pages);
+		drgn_recorded_page_map_init(&recording->physical_pages);
+		omp_init_lock(&recording->lock);
+		reader->recording = recording;
+	}
+	recording->enabled = true;
+	return NULL;
+}
+
+void drgn_memory_reader_stop_recording(struct drgn_memory_reader *reader)
+{
+	if (reader->recording)
+		reader->recording->enabled = false;
+}
+
+bool drgn_memory_reader_is_recording(struct drgn_memory_reader *reader)
+{
+	return reader->recording && reader->recording->enabled;
+}
+
+static void drgn_recorded_page_set_valid(struct drgn_recorded_page *page,
+					 size_t offset, size_t size)
+{
+	for (size_t i = offset; i < offset + size; i++)
+		page->valid[i / 64] |= UINT64_C(1) << (i % 64);
+}
+
+static bool drgn_recorded_page_is_valid(const struct drgn_recorded_page *page,
+					size_t i)
+{
+	return page->valid[i / 64] & (UINT64_C(1) << (i % 64));
+}
+
+/*
+ * Copy a page that is being read for the first time. buf contains the count
+ * bytes that were just read at address, which must be within the page. The
+ * rest of the page is read from whatever segments it overlaps, leaving out
+ * anything that can't be read.
+ */
+static struct drgn_error *
+drgn_memory_reader_copy_page(struct drgn_memory_segment_tree *tree,
+			     uint64_t page_address, const void *buf,
+			     uint64_t address, uint64_t count, bool physical,
+			     struct drgn_recorded_page **ret)
+{
+	struct drgn_recorded_page *page = calloc(1, sizeof(*page));
+	if (!page)
+		return &drgn_enomem;
+
+	uint64_t last = page_address + (DRGN_MEMORY_RECORDING_PAGE_SIZE - 1);
+	struct drgn_memory_segment_tree_iterator it =
+		drgn_memory_segment_tree_search_le(tree, &page_address);
+	if (!it.entry)
+		it = drgn_memory_segment_tree_first(tree);
+	for (; it.entry && it.entry->address <= last;
+	     it = drgn_memory_segment_tree_next(it)) {
+		const struct drgn_memory_segment *segment = it.entry;
+		uint64_t segment_last = segment->address + (segment->size - 1);
+		if (segment_last < page_address)
+			continue;
+		uint64_t start = max(segment->address, page_address);
+		uint64_t size = min(segment_last, last) - start + 1;
+		struct drgn_error *err =
+			segment->read_fn(page->data + (start - page_address),
+					 start, size,
+					 start - segment->orig_address,
+					 segment->arg, physical);
+		if (err) {
+			if (err->code != DRGN_ERROR_FAULT) {
+				free(page);
+				return err;
+			}
+			drgn_error_destroy(err);
+			continue;
+		}
+		drgn_recorded_page_set_valid(page, start - page_address, size);
+	}
+
+	/* Always keep exactly what the caller saw. */
+	memcpy(page->data + (address - page_address), buf, count);
+	drgn_recorded_page_set_valid(page, address - page_address, count);
+	*ret = page;
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_memory_reader_record(struct drgn_memory_reader *reader, const void *buf,
+			  uint64_t address, uint64_t count, bool physical)
+{
+	struct drgn_memory_recording *recording = reader->recording;
+	struct drgn_memory_segment_tree *tree = (physical ?
+						 &reader->physical_segments :
+						 &reader->virtual_segments);
+	struct drgn_recorded_page_map *map = (physical ?
+					      &recording->physical_pages :
+					      &recording->virtual_pages);
+	while (count) {
+		uint64_t page_address =
+			address & -DRGN_MEMORY_RECORDING_PAGE_SIZE;
+		uint64_t n = min(page_address +
+				 (DRGN_MEMORY_RECORDING_PAGE_SIZE - 1) - address,
+				 count - 1) + 1;
+
+		omp_set_lock(&recording->lock);
+		bool recorded =
+			drgn_recorded_page_map_search(map, &page_address).entry;
+		omp_unset_lock(&recording->lock);
+		/* Only the first read of a page is recorded. */
+		if (!recorded) {
+			struct drgn_recorded_page_map_entry entry = {
+				.key = page_address,
+			};
+			struct drgn_error *err =
+				drgn_memory_reader_copy_page(tree, page_address,
+							     buf, address, n,
+							     physical,
+							     &entry.value);
+			if (err)
+				return err;
+			omp_set_lock(&recording->lock);
+			int r = drgn_recorded_page_map_insert(map, &entry,
+							      NULL);
+			omp_unset_lock(&recording->lock);
+			/* Another thread may have recorded it in the meantime. */
+			if (r <= 0) {
+				free(entry.value);
+				if (r < 0)
+					return &drgn_enomem;
+			}
+		}
+
+		buf = (const char *)buf + n;
+		address += n;
+		count -= n;
+	}
+	return NULL;
+}
+
+static int compare_recorded_pages(const void *_a, const void *_b)
+{
+	uint64_t a = ((const struct drgn_recorded_page_map_entry *)_a)->key;
+	uint64_t b = ((const struct drgn_recorded_page_map_entry *)_b)->key;
+	return (a > b) - (a < b);
+}
+
+struct drgn_error *
+drgn_memory_reader_for_each_recorded(struct drgn_memory_reader *reader,
+				     bool physical, drgn_memory_recorded_fn *fn,
+				     void *arg)
+{
+	struct drgn_memory_recording *recording = reader->recording;
+	if (!recording)
+		return NULL;
+	struct drgn_recorded_page_map *map = (physical ?
+					      &recording->physical_pages :
+					      &recording->virtual_pages);
+
+	omp_set_lock(&recording->lock);
+	size_t num_pages = drgn_recorded_page_map_size(map);
+	struct drgn_recorded_page_map_entry *pages =
+		malloc_array(num_pages, sizeof(*pages));
+	if (!pages) {
+		omp_unset_lock(&recording->lock);
+		return num_pages ? &drgn_enomem : NULL;
+	}
+	size_t i = 0;
+	for (struct drgn_recorded_page_map_iterator it =
+	     drgn_recorded_page_map_first(map);
+	     it.entry; it = drgn_recorded_page_map_next(it))
+		pages[i++] = *it.entry;
+	omp_unset_lock(&recording->lock);
+	qsort(pages, num_pages, sizeof(*pages), compare_recorded_pages);
+
+	struct drgn_error *err = NULL;
+	for (i = 0; i < num_pages; i++) {
+		const struct drgn_recorded_page *page = pages[i].value;
+		size_t start = 0;
+		while (start < DRGN_MEMORY_RECORDING_PAGE_SIZE) {
+			if (!drgn_recorded_page_is_valid(page, start)) {
+				start++;
+				continue;
+			}
+			size_t end = start + 1;
+			while (end < DRGN_MEMORY_RECORDING_PAGE_SIZE &&
+			       drgn_recorded_page_is_valid(page, end))
+				end++;
+			err = fn(pages[i].key + start, page->data + start,
+				 end - start, arg);
+			if (err)
+				goto out;
+			start = end;
+		}
+	}
+out:
+	free(pages);
+	return err;
+}
+
+static struct drgn_error *
+drgn_memory_reader_read_impl(struct drgn_memory_reader *reader, void *buf,
+			     uint64_t address, size_t count, bool physical,
+			     omp_lock_t *lock)
 {
 	struct drgn_memory_segment_tree *tree = (physical ?
 						 &reader->physical_segments :
@@ -238,18 +501,46 @@ struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
 		struct drgn_memory_segment *segment;
 		size_t n;
 
+		/* Searching the splay tree modifies it. */
+		if (lock)
+			omp_set_lock(lock);
 		segment = drgn_memory_segment_tree_search_le(tree,
 							     &address).entry;
 		if (!segment || segment->address + segment->size <= address) {
+			if (lock)
+				omp_unset_lock(lock);
 			return drgn_error_create_fault("could not find memory segment",
 						       address);
 		}
 
 		n = min(segment->address + segment->size - address,
 			(uint64_t)(count - read));
-		err = segment->read_fn((char *)buf + read, address, n,
-				       address - segment->orig_address,
-				       segment->arg, physical);
+		bool recording = reader->recording && reader->recording->enabled;
+		/*
+		 * Reading from a file is thread-safe. Other callbacks and
+		 * recording (which reads the rest of the page from the tree)
+		 * may not be.
+		 */
+		if (lock && segment->read_fn == drgn_read_memory_file &&
+		    !recording) {
+			uint64_t offset = address - segment->orig_address;
+			void *arg = segment->arg;
+			omp_unset_lock(lock);
+			err = drgn_read_memory_file((char *)buf + read, address,
+						    n, offset, arg, physical);
+		} else {
+			err = segment->read_fn((char *)buf + read, address, n,
+					       address - segment->orig_address,
+					       segment->arg, physical);
+			if (!err && recording) {
+				err = drgn_memory_reader_record(reader,
+								(char *)buf +
+								read, address,
+								n, physical);
+			}
+			if (lock)
+				omp_unset_lock(lock);
+		}
 		if (err)
 			return err;
 
@@ -259,6 +550,23 @@ struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
 	return NULL;
 }
 
+struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
+					   void *buf, uint64_t address,
+					   size_t count, bool physical)
+{
+	return drgn_memory_reader_read_impl(reader, buf, address, count,
+					    physical, NULL);
+}
+
+struct drgn_error *
+drgn_memory_reader_read_locked(struct drgn_memory_reader *reader, void *buf,
+			       uint64_t address, size_t count, bool physical,
+			       omp_lock_t *lock)
+{
+	return drgn_memory_reader_read_impl(reader, buf, address, count,
+					    physical, lock);
+}
+
 struct drgn_error *drgn_read_memory_file(void *buf, uint64_t address,
 					 size_t count, uint64_t offset,
 					 void *arg, bool physical)
@@ -275,6 +583,13 @@ struct drgn_error *drgn_read_memory_file(void *buf, uint64_t address,
 	} else {
 		file_count = 0;
 	}
+	/*
+	 * pread() can't read at offsets that don't fit in off_t (e.g., the
+	 * vsyscall page in /proc/$pid/mem).
+	 */
+	if (file_count &&
+	    (file_offset > INT64_MAX || file_count - 1 > INT64_MAX - file_offset))
+		return drgn_error_create_fault("could not read memory", address);
 	while (file_count) {
 		ssize_t ret;
 
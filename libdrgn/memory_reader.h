@@ -12,6 +12,8 @@
 #ifndef DRGN_MEMORY_READER_H
 #define DRGN_MEMORY_READER_H
 
+#include <omp.h>
+
 #include "binary_search_tree.h"
 #include "drgn.h"
 
@@ -69,6 +71,11 @@ struct drgn_memory_reader {
 	struct drgn_memory_segment_tree virtual_segments;
 	/** Physical memory segments. */
 	struct drgn_memory_segment_tree physical_segments;
+	/**
+	 * Contents of the pages that have been read since recording was started,
+	 * or @c NULL if recording was never started.
+	 */
+	struct drgn_memory_recording *recording;
 };
 
 /**
@@ -91,6 +98,74 @@ drgn_memory_reader_add_segment(struct drgn_memory_reader *reader,
 			       drgn_memory_read_fn read_fn, void *arg,
 			       bool physical);
 
+/** Callback for @ref drgn_memory_reader_for_each_segment(). */
+typedef struct drgn_error *
+drgn_memory_segment_fn(const struct drgn_memory_segment *segment, void *arg);
+
+/**
+ * Call a function for each segment in a @ref drgn_memory_reader in order of
+ * address.
+ *
+ * @param[in] physical Whether to iterate over the physical segments instead of
+ * the virtual segments.
+ * @return @c NULL on success, the first error returned by @p fn otherwise.
+ */
+struct drgn_error *
+drgn_memory_reader_for_each_segment(struct drgn_memory_reader *reader,
+				    bool physical, drgn_memory_segment_fn *fn,
+				    void *arg);
+
+/**
+ * Start recording the pages that are read from a @ref drgn_memory_reader.
+ *
+ * The first time that any part of a page (in units of @ref
+ * DRGN_MEMORY_RECORDING_PAGE_SIZE) is successfully read with @ref
+ * drgn_memory_reader_read(), the contents of the whole page are copied, both
+ * for virtual and physical reads. This is a no-op if recording is already
+ * enabled.
+ */
+struct drgn_error *
+drgn_memory_reader_start_recording(struct drgn_memory_reader *reader);
+
+/**
+ * Stop recording the pages that are read from a @ref drgn_memory_reader.
+ *
+ * The pages recorded so far are kept, and recording can be resumed later.
+ */
+void drgn_memory_reader_stop_recording(struct drgn_memory_reader *reader);
+
+/** Return whether a @ref drgn_memory_reader is recording. */
+bool drgn_memory_reader_is_recording(struct drgn_memory_reader *reader);
+
+/** Granularity that reads are recorded in. */
+#define DRGN_MEMORY_RECORDING_PAGE_SIZE UINT64_C(4096)
+
+/**
+ * Callback for @ref drgn_memory_reader_for_each_recorded().
+ *
+ * @param[in] address Start of the range.
+ * @param[in] buf Recorded contents of the range.
+ * @param[in] size Size of the range. The range never crosses a page boundary.
+ */
+typedef struct drgn_error *drgn_memory_recorded_fn(uint64_t address,
+						   const void *buf,
+						   uint64_t size, void *arg);
+
+/**
+ * Call a function for each range of recorded memory in a @ref
+ * drgn_memory_reader in order of address.
+ *
+ * Parts of recorded pages that could not be read are skipped.
+ *
+ * @param[in] physical Whether to iterate over the recorded physical pages
+ * instead of the recorded virtual pages.
+ * @return @c NULL on success, the first error returned by @p fn otherwise.
+ */
+struct drgn_error *
+drgn_memory_reader_for_each_recorded(struct drgn_memory_reader *reader,
+				     bool physical, drgn_memory_recorded_fn *fn,
+				     void *arg);
+
 /**
  * Read from a @ref drgn_memory_reader.
  *
@@ -105,6 +180,19 @@ struct drgn_error *drgn_memory_reader_read(struct drgn_memory_reader *reader,
 					   void *buf, uint64_t address,
 					   size_t count, bool physical);
 
+/**
+ * Like @ref drgn_memory_reader_read(), but may be called from multiple threads
+ * at once as long as they all pass the same lock.
+ *
+ * @p lock is held while looking up segments and while calling read callbacks
+ * which may not be thread-safe. Reads from files with @ref
+ * drgn_read_memory_file() are done without it.
+ */
+struct drgn_error *
+drgn_memory_reader_read_locked(struct drgn_memory_reader *reader, void *buf,
+			       uint64_t address, size_t count, bool physical,
+			       omp_lock_t *lock);
+
 /** Argument for @ref drgn_read_memory_file(). */
 struct drgn_memory_file_segment {
 	/** Offset in the file where the segment starts. */
@@ -0,0 +1,289 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <stdlib.h>
+
+#include "linux_kernel.h"
+#include "memory_reader.h"
+#include "memory_scan.h"
+#include "minmax.h"
+
+/*
+ * Granularity to retry reading a chunk in if it can't be read all at once.
+ * Memory is always mapped in at least this granularity.
+ */
+#define DRGN_MEMORY_SCAN_PAGE_SIZE UINT64_C(4096)
+
+DEFINE_VECTOR_FUNCTIONS(drgn_memory_scan_segment_vector)
+
+struct drgn_memory_scan_add_segment_arg {
+	struct drgn_memory_scan *scan;
+	uint64_t min_address;
+	/* Last address that may need to be read for the overlap. */
+	uint64_t max_read_address;
+};
+
+static struct drgn_error *
+drgn_memory_scan_add_segment(const struct drgn_memory_segment *segment,
+			     void *_arg)
+{
+	struct drgn_memory_scan_add_segment_arg *arg = _arg;
+	/*
+	 * Memory that is only reachable through the page table is also in the
+	 * physical segments that the page table points to. Scanning it would
+	 * walk the entire virtual address space, so skip it.
+	 */
+	if (segment->read_fn == read_memory_via_pgtable)
+		return NULL;
+	uint64_t last = segment->address + (segment->size - 1);
+	if (last < arg->min_address ||
+	    segment->address > arg->max_read_address)
+		return NULL;
+	struct drgn_memory_scan_segment *entry =
+		drgn_memory_scan_segment_vector_append_entry(&arg->scan->segments);
+	if (!entry)
+		return &drgn_enomem;
+	entry->start = max(segment->address, arg->min_address);
+	entry->last = min(last, arg->max_read_address);
+	entry->orig_address = segment->orig_address;
+	entry->read_fn = segment->read_fn;
+	entry->arg = segment->arg;
+	return NULL;
+}
+
+/* Compute the runs of contiguous segments and start at the first segment. */
+static void drgn_memory_scan_reset(struct drgn_memory_scan *scan)
+{
+	for (size_t i = scan->segments.size; i-- > 0;) {
+		struct drgn_memory_scan_segment *entry =
+			&scan->segments.data[i];
+		if (i + 1 < scan->segments.size &&
+		    entry->last != UINT64_MAX &&
+		    entry[1].start == entry->last + 1)
+			entry->run_last = entry[1].run_last;
+		else
+			entry->run_last = entry->last;
+	}
+	scan->segment = 0;
+	if (scan->segments.size)
+		scan->address = scan->segments.data[0].start;
+}
+
+struct drgn_error *drgn_memory_scan_init(struct drgn_memory_scan *scan,
+					 struct drgn_memory_reader *reader,
+					 bool physical, uint64_t min_address,
+					 uint64_t max_address,
+					 uint64_t overlap)
+{
+	struct drgn_error *err;
+
+	scan->physical = physical;
+	scan->max_address = max_address;
+	scan->overlap = overlap;
+	drgn_memory_scan_segment_vector_init(&scan->segments);
+	scan->segment = 0;
+	scan->address = 0;
+	scan->num_threads = omp_get_max_threads();
+	scan->bufs = NULL;
+	omp_init_lock(&scan->lock);
+
+	struct drgn_memory_scan_add_segment_arg arg = {
+		.scan = scan,
+		.min_address = min_address,
+	};
+	if (__builtin_add_overflow(max_address, overlap,
+				   &arg.max_read_address))
+		arg.max_read_address = UINT64_MAX;
+	err = drgn_memory_reader_for_each_segment(reader, physical,
+						  drgn_memory_scan_add_segment,
+						  &arg);
+	if (err)
+		goto err;
+	drgn_memory_scan_reset(scan);
+
+	scan->bufs = calloc(scan->num_threads, sizeof(scan->bufs[0]));
+	if (!scan->bufs) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	return NULL;
+
+err:
+	drgn_memory_scan_deinit(scan);
+	return err;
+}
+
+struct drgn_error *
+drgn_memory_scan_restrict(struct drgn_memory_scan *scan,
+			  const struct drgn_memory_scan_range *ranges,
+			  size_t num_ranges)
+{
+	struct drgn_memory_scan_segment_vector segments;
+	drgn_memory_scan_segment_vector_init(&segments);
+	size_t i = 0, j = 0;
+	while (i < scan->segments.size && j < num_ranges) {
+		const struct drgn_memory_scan_segment *entry =
+			&scan->segments.data[i];
+		uint64_t start = max(entry->start, ranges[j].start);
+		uint64_t last = min(entry->last, ranges[j].last);
+		if (start <= last) {
+			struct drgn_memory_scan_segment *new_entry;
+			new_entry = drgn_memory_scan_segment_vector_append_entry(&segments);
+			if (!new_entry)
+				goto enomem;
+			*new_entry = *entry;
+			new_entry->start = start;
+			new_entry->last = last;
+		}
+		if (entry->last <= ranges[j].last)
+			i++;
+		else
+			j++;
+	}
+	drgn_memory_scan_segment_vector_deinit(&scan->segments);
+	scan->segments = segments;
+	drgn_memory_scan_reset(scan);
+	return NULL;
+
+enomem:
+	drgn_memory_scan_segment_vector_deinit(&segments);
+	return &drgn_enomem;
+}
+
+void drgn_memory_scan_deinit(struct drgn_memory_scan *scan)
+{
+	if (scan->bufs) {
+		for (int i = 0; i < scan->num_threads; i++)
+			free(scan->bufs[i]);
+		free(scan->bufs);
+	}
+	drgn_memory_scan_segment_vector_deinit(&scan->segments);
+	omp_destroy_lock(&scan->lock);
+}
+
+bool drgn_memory_scan_next_chunk(struct drgn_memory_scan *scan,
+				 struct drgn_memory_scan_chunk *ret)
+{
+	if (scan->segment >= scan->segments.size)
+		return false;
+	const struct drgn_memory_scan_segment *entry =
+		&scan->segments.data[scan->segment];
+	/*
+	 * The remaining segments are only needed to read the overlap of
+	 * earlier chunks.
+	 */
+	if (entry->start > scan->max_address) {
+		scan->segment = scan->segments.size;
+		return false;
+	}
+	uint64_t last = min(entry->last, scan->max_address);
+	ret->segment = scan->segment;
+	ret->address = scan->address;
+	ret->size = min(last - scan->address,
+			DRGN_MEMORY_SCAN_CHUNK_SIZE - 1) + 1;
+	uint64_t chunk_last = scan->address + (ret->size - 1);
+	ret->read_size = ret->size + min(entry->run_last - chunk_last,
+					 scan->overlap);
+	if (chunk_last == last) {
+		if (++scan->segment < scan->segments.size)
+			scan->address = scan->segments.data[scan->segment].start;
+	} else {
+		scan->address = chunk_last + 1;
+	}
+	return true;
+}
+
+/*
+ * Read memory starting in a segment, continuing into the following contiguous
+ * segments if necessary.
+ */
+static struct drgn_error *drgn_memory_scan_read(struct drgn_memory_scan *scan,
+						size_t segment, char *buf,
+						uint64_t address,
+						uint64_t count)
+{
+	struct drgn_error *err;
+	while (count) {
+		const struct drgn_memory_scan_segment *entry =
+			&scan->segments.data[segment];
+		while (address > entry->last)
+			entry = &scan->segments.data[++segment];
+		uint64_t n = min(entry->last - address, count - 1) + 1;
+		/*
+		 * Reading from a file is thread-safe. Other callbacks may not
+		 * be.
+		 */
+		bool locked = entry->read_fn != drgn_read_memory_file;
+		if (locked)
+			omp_set_lock(&scan->lock);
+		err = entry->read_fn(buf, address, n,
+				     address - entry->orig_address, entry->arg,
+				     scan->physical);
+		if (locked)
+			omp_unset_lock(&scan->lock);
+		if (err)
+			return err;
+		buf += n;
+		address += n;
+		count -= n;
+	}
+	return NULL;
+}
+
+struct drgn_error *
+drgn_memory_scan_visit(struct drgn_memory_scan *scan,
+		       const struct drgn_memory_scan_chunk *chunk,
+		       drgn_memory_scan_fn *fn, void *arg)
+{
+	struct drgn_error *err;
+	char **bufp = &scan->bufs[omp_get_thread_num()];
+	if (!*bufp) {
+		*bufp = malloc(DRGN_MEMORY_SCAN_CHUNK_SIZE + scan->overlap);
+		if (!*bufp)
+			return &drgn_enomem;
+	}
+	char *buf = *bufp;
+	err = drgn_memory_scan_read(scan, chunk->segment, buf, chunk->address,
+				    chunk->read_size);
+	if (!err) {
+		return fn(buf, chunk->address, chunk->read_size, chunk->size,
+			  arg);
+	} else if (err->code != DRGN_ERROR_FAULT) {
+		return err;
+	}
+	drgn_error_destroy(err);
+
+	/*
+	 * Part of the chunk couldn't be read. Read it a page at a time and
+	 * visit each run of readable pages.
+	 */
+	uint64_t run_start = 0, pos = 0;
+	while (pos < chunk->read_size) {
+		uint64_t address = chunk->address + pos;
+		uint64_t n = min(DRGN_MEMORY_SCAN_PAGE_SIZE -
+				 address % DRGN_MEMORY_SCAN_PAGE_SIZE,
+				 chunk->read_size - pos);
+		err = drgn_memory_scan_read(scan, chunk->segment, buf + pos,
+					    address, n);
+		if (err && err->code != DRGN_ERROR_FAULT)
+			return err;
+		if (err || pos + n == chunk->read_size) {
+			uint64_t run_end = err ? pos : pos + n;
+			if (run_start < chunk->size && run_end > run_start) {
+				struct drgn_error *err2 =
+					fn(buf + run_start,
+					   chunk->address + run_start,
+					   run_end - run_start,
+					   chunk->size - run_start, arg);
+				if (err2) {
+					drgn_error_destroy(err);
+					return err2;
+				}
+			}
+			drgn_error_destroy(err);
+			run_start = pos + n;
+		}
+		pos += n;
+	}
+	return NULL;
+}
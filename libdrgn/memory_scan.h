@@ -0,0 +1,173 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Parallel memory scanning.
+ *
+ * See @ref MemoryScan.
+ */
+
+#ifndef DRGN_MEMORY_SCAN_H
+#define DRGN_MEMORY_SCAN_H
+
+#include <omp.h>
+
+#include "drgn.h"
+#include "vector.h"
+
+struct drgn_memory_reader;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup MemoryScan Memory scanning
+ *
+ * Reading large ranges of memory in parallel.
+ *
+ * A @ref drgn_memory_scan takes a snapshot of the segments of a @ref
+ * drgn_memory_reader and splits them into chunks of at most @ref
+ * DRGN_MEMORY_SCAN_CHUNK_SIZE bytes. Each chunk can then be read and visited by
+ * a different OpenMP thread. Memory that can't be read (e.g., because it was
+ * excluded from a core dump) is skipped.
+ *
+ * @{
+ */
+
+/** Maximum number of bytes visited in one chunk. */
+#define DRGN_MEMORY_SCAN_CHUNK_SIZE (UINT64_C(1) << 20)
+
+/** Copy of a memory segment to scan, clamped to the scanned range. */
+struct drgn_memory_scan_segment {
+	uint64_t start;
+	/** Last address in the segment (inclusive). */
+	uint64_t last;
+	/**
+	 * Last address in the run of contiguous segments that this segment is
+	 * part of (inclusive).
+	 */
+	uint64_t run_last;
+	uint64_t orig_address;
+	drgn_memory_read_fn read_fn;
+	void *arg;
+};
+
+DEFINE_VECTOR_TYPE(drgn_memory_scan_segment_vector,
+		   struct drgn_memory_scan_segment)
+
+/** Part of the scanned memory that is visited by one thread. */
+struct drgn_memory_scan_chunk {
+	/** Index of the segment that the chunk starts in. */
+	size_t segment;
+	uint64_t address;
+	/** Number of bytes to visit. */
+	uint64_t size;
+	/** Number of bytes to read, including the overlap with the next chunk. */
+	uint64_t read_size;
+};
+
+/** State of a parallel scan over memory. */
+struct drgn_memory_scan {
+	bool physical;
+	/** Last address to visit. */
+	uint64_t max_address;
+	/** Number of bytes after each chunk that are also read. */
+	uint64_t overlap;
+	/** Snapshot of the segments in the scanned range, in order. */
+	struct drgn_memory_scan_segment_vector segments;
+	/** Next segment and address to split into a chunk. */
+	size_t segment;
+	uint64_t address;
+	/**
+	 * Maximum number of threads that may call @ref drgn_memory_scan_visit()
+	 * concurrently.
+	 */
+	int num_threads;
+	/** One read buffer per thread, allocated when first needed. */
+	char **bufs;
+	/** Serializes calls to read callbacks that aren't thread-safe. */
+	omp_lock_t lock;
+};
+
+/**
+ * Initialize a @ref drgn_memory_scan.
+ *
+ * Memory that is only reachable through the page table is skipped, since it
+ * is also in the physical segments that the page table points to.
+ *
+ * @param[in] min_address First address to visit.
+ * @param[in] max_address Last address to visit.
+ * @param[in] overlap Number of bytes past the end of each chunk to also read,
+ * so that values which start in one chunk and end in the next one can be
+ * found. This may be read from past @p max_address.
+ *
+ * If this fails, then @p scan is left deinitialized.
+ */
+struct drgn_error *drgn_memory_scan_init(struct drgn_memory_scan *scan,
+					 struct drgn_memory_reader *reader,
+					 bool physical, uint64_t min_address,
+					 uint64_t max_address,
+					 uint64_t overlap);
+
+/** Range of addresses for @ref drgn_memory_scan_restrict(). */
+struct drgn_memory_scan_range {
+	uint64_t start;
+	/** Last address in the range (inclusive). */
+	uint64_t last;
+};
+
+/**
+ * Only visit the parts of the memory of a @ref drgn_memory_scan that are in the
+ * given ranges.
+ *
+ * This must be called before @ref drgn_memory_scan_next_chunk().
+ *
+ * @param[in] ranges Ranges sorted by address. They must not overlap.
+ */
+struct drgn_error *
+drgn_memory_scan_restrict(struct drgn_memory_scan *scan,
+			  const struct drgn_memory_scan_range *ranges,
+			  size_t num_ranges);
+
+/** Deinitialize a @ref drgn_memory_scan. */
+void drgn_memory_scan_deinit(struct drgn_memory_scan *scan);
+
+/**
+ * Split off the next chunk to visit.
+ *
+ * @return @c true if a chunk was returned, @c false if there are no more
+ * chunks.
+ */
+bool drgn_memory_scan_next_chunk(struct drgn_memory_scan *scan,
+				 struct drgn_memory_scan_chunk *ret);
+
+/**
+ * Callback for @ref drgn_memory_scan_visit().
+ *
+ * @param[in] buf Memory read starting at @p address.
+ * @param[in] len Number of bytes in @p buf.
+ * @param[in] end Only values starting in `buf[0, end)` belong to this call;
+ * the rest is overlap with the next chunk. This may be greater than @p len.
+ */
+typedef struct drgn_error *drgn_memory_scan_fn(const char *buf,
+					       uint64_t address, uint64_t len,
+					       uint64_t end, void *arg);
+
+/**
+ * Read a chunk and call a function on its contents.
+ *
+ * If part of the chunk can't be read, then it is read a page at a time instead,
+ * and @p fn is called on each run of readable pages.
+ *
+ * This may be called concurrently from an OpenMP parallel region with at most
+ * @ref drgn_memory_scan::num_threads threads.
+ */
+struct drgn_error *
+drgn_memory_scan_visit(struct drgn_memory_scan *scan,
+		       const struct drgn_memory_scan_chunk *chunk,
+		       drgn_memory_scan_fn *fn, void *arg);
+
+/** @} */
+
+#endif /* DRGN_MEMORY_SCAN_H */
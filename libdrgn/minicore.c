@@ -0,0 +1,439 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <elf.h>
+#include <errno.h>
+#include <gelf.h>
+#include <libelf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drgn.h"
+#include "error.h"
+#include "hash_table.h"
+#include "memory_reader.h"
+#include "minmax.h"
+#include "platform.h"
+#include "program.h"
+#include "vector.h"
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_prstatus_map, int_key_hash_pair, scalar_key_eq)
+
+/* Contiguous range of recorded memory. */
+struct minicore_run {
+	uint64_t address;
+	uint64_t size;
+	/* Offset of the contents in the data buffer. */
+	size_t data_offset;
+};
+
+DEFINE_VECTOR(minicore_run_vector, struct minicore_run)
+DEFINE_VECTOR(minicore_buffer, char)
+
+struct minicore_builder {
+	struct minicore_run_vector *runs;
+	struct minicore_buffer *data;
+};
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_start_recording(struct drgn_program *prog)
+{
+	return drgn_memory_reader_start_recording(&prog->reader);
+}
+
+LIBDRGN_PUBLIC void drgn_program_stop_recording(struct drgn_program *prog)
+{
+	drgn_memory_reader_stop_recording(&prog->reader);
+}
+
+static bool minicore_buffer_reserve_more(struct minicore_buffer *buffer,
+					 size_t n)
+{
+	size_t capacity;
+	if (__builtin_add_overflow(buffer->size, n, &capacity))
+		return false;
+	if (capacity <= buffer->capacity)
+		return true;
+	return minicore_buffer_reserve(buffer,
+				       max(capacity, 2 * buffer->capacity));
+}
+
+static struct drgn_error *
+minicore_add_range(uint64_t address, const void *buf, uint64_t size,
+		   void *arg)
+{
+	struct minicore_builder *builder = arg;
+	struct minicore_buffer *data = builder->data;
+
+	if (!minicore_buffer_reserve_more(data, size))
+		return &drgn_enomem;
+	memcpy(data->data + data->size, buf, size);
+
+	struct minicore_run_vector *runs = builder->runs;
+	struct minicore_run *last = (runs->size ?
+				     &runs->data[runs->size - 1] : NULL);
+	if (last && last->address + last->size == address &&
+	    last->data_offset + last->size == data->size) {
+		last->size += size;
+	} else {
+		struct minicore_run *run =
+			minicore_run_vector_append_entry(runs);
+		if (!run)
+			return &drgn_enomem;
+		run->address = address;
+		run->size = size;
+		run->data_offset = data->size;
+	}
+	data->size += size;
+	return NULL;
+}
+
+static struct drgn_error *minicore_add_note(struct minicore_buffer *notes,
+					    const char *name, uint32_t type,
+					    const void *desc, size_t desc_size,
+					    unsigned int encoding)
+{
+	size_t name_size = strlen(name) + 1;
+	size_t name_padded = (name_size + 3) & ~(size_t)3;
+	size_t desc_padded = (desc_size + 3) & ~(size_t)3;
+	if (desc_size > UINT32_MAX) {
+		return drgn_error_create(DRGN_ERROR_OVERFLOW,
+					 "note is too large");
+	}
+	if (!minicore_buffer_reserve_more(notes, sizeof(Elf64_Nhdr) +
+					  name_padded + desc_padded))
+		return &drgn_enomem;
+
+	char *p = notes->data + notes->size;
+	Elf64_Nhdr nhdr = {
+		.n_namesz = name_size,
+		.n_descsz = desc_size,
+		.n_type = type,
+	};
+	Elf_Data data = {
+		.d_buf = &nhdr,
+		.d_type = ELF_T_NHDR,
+		.d_size = sizeof(nhdr),
+		.d_version = EV_CURRENT,
+	};
+	Elf_Data dst = data;
+	dst.d_buf = p;
+	if (!elf64_xlatetof(&dst, &data, encoding))
+		return drgn_error_libelf();
+	p += sizeof(nhdr);
+	memset(p, 0, name_padded + desc_padded);
+	memcpy(p, name, name_size);
+	memcpy(p + name_padded, desc, desc_size);
+	notes->size += sizeof(nhdr) + name_padded + desc_padded;
+	return NULL;
+}
+
+static struct drgn_error *minicore_add_notes(struct drgn_program *prog,
+					     struct minicore_buffer *notes,
+					     unsigned int encoding)
+{
+	struct drgn_error *err;
+	if (prog->vmcoreinfo.raw) {
+		err = minicore_add_note(notes, "VMCOREINFO", 0,
+					prog->vmcoreinfo.raw,
+					prog->vmcoreinfo.raw_size, encoding);
+		if (err)
+			return err;
+	}
+
+	err = drgn_program_cache_prstatus(prog);
+	if (err)
+		return err;
+	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		/* The notes must stay in CPU order. */
+		for (size_t i = 0; i < prog->prstatus_vector.size; i++) {
+			struct string *prstatus = &prog->prstatus_vector.data[i];
+			err = minicore_add_note(notes, "CORE", NT_PRSTATUS,
+						prstatus->str, prstatus->len,
+						encoding);
+			if (err)
+				return err;
+		}
+	} else {
+		for (struct drgn_prstatus_map_iterator it =
+		     drgn_prstatus_map_first(&prog->prstatus_map);
+		     it.entry; it = drgn_prstatus_map_next(it)) {
+			err = minicore_add_note(notes, "CORE", NT_PRSTATUS,
+						it.entry->value.str,
+						it.entry->value.len, encoding);
+			if (err)
+				return err;
+		}
+	}
+	return NULL;
+}
+
+/* Convert an ELF structure to the file representation in place. */
+static struct drgn_error *minicore_xlate(void *buf, size_t size, Elf_Type type,
+					 bool is_64_bit, unsigned int encoding)
+{
+	Elf_Data data = {
+		.d_buf = buf,
+		.d_type = type,
+		.d_size = size,
+		.d_version = EV_CURRENT,
+	};
+	if (!(is_64_bit ? elf64_xlatetof(&data, &data, encoding) :
+	      elf32_xlatetof(&data, &data, encoding)))
+		return drgn_error_libelf();
+	return NULL;
+}
+
+static void minicore_set_phdr(void *phdrs, size_t i, bool is_64_bit,
+			      const GElf_Phdr *phdr)
+{
+	if (is_64_bit) {
+		((Elf64_Phdr *)phdrs)[i] = *phdr;
+	} else {
+		((Elf32_Phdr *)phdrs)[i] = (Elf32_Phdr){
+			.p_type = phdr->p_type,
+			.p_offset = phdr->p_offset,
+			.p_vaddr = phdr->p_vaddr,
+			.p_paddr = phdr->p_paddr,
+			.p_filesz = phdr->p_filesz,
+			.p_memsz = phdr->p_memsz,
+			.p_flags = phdr->p_flags,
+			.p_align = phdr->p_align,
+		};
+	}
+}
+
+static struct drgn_error *
+minicore_write(struct drgn_program *prog, const char *path,
+	       const struct minicore_buffer *notes,
+	       const struct minicore_run_vector *physical_runs,
+	       const struct minicore_run_vector *virtual_runs,
+	       const struct minicore_buffer *data, uint64_t page_offset)
+{
+	struct drgn_error *err;
+	bool is_64_bit = prog->platform.flags & DRGN_PLATFORM_IS_64_BIT;
+	unsigned int encoding =
+		(prog->platform.flags & DRGN_PLATFORM_IS_LITTLE_ENDIAN) ?
+		ELFDATA2LSB : ELFDATA2MSB;
+	size_t ehdr_size = is_64_bit ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+	size_t phdr_size = is_64_bit ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+	size_t shdr_size = is_64_bit ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+	uint64_t no_paddr = is_64_bit ? UINT64_MAX : UINT32_MAX;
+
+	size_t phnum = (notes->size ? 1 : 0) + physical_runs->size +
+		       virtual_runs->size;
+	/* Too many segments for e_phnum; the count goes in section 0. */
+	bool extended_phnum = phnum >= PN_XNUM;
+	uint64_t offset = ehdr_size + phnum * phdr_size;
+	uint64_t shoff = 0;
+	if (extended_phnum) {
+		shoff = offset;
+		offset += shdr_size;
+	}
+
+	void *phdrs = calloc(max(phnum, (size_t)1), phdr_size);
+	if (!phdrs)
+		return &drgn_enomem;
+	size_t i = 0;
+	if (notes->size) {
+		minicore_set_phdr(phdrs, i++, is_64_bit, &(GElf_Phdr){
+			.p_type = PT_NOTE,
+			.p_offset = offset,
+			.p_filesz = notes->size,
+			.p_align = 4,
+		});
+		offset += notes->size;
+	}
+	uint64_t data_offset = offset;
+	/*
+	 * Physical memory is also mapped at its direct mapping address. The
+	 * virtual runs come last so that they take precedence over that.
+	 */
+	for (size_t j = 0; j < physical_runs->size; j++) {
+		const struct minicore_run *run = &physical_runs->data[j];
+		minicore_set_phdr(phdrs, i++, is_64_bit, &(GElf_Phdr){
+			.p_type = PT_LOAD,
+			.p_offset = data_offset + run->data_offset,
+			.p_vaddr = page_offset + run->address,
+			.p_paddr = run->address,
+			.p_filesz = run->size,
+			.p_memsz = run->size,
+			.p_flags = PF_R | PF_W | PF_X,
+		});
+	}
+	for (size_t j = 0; j < virtual_runs->size; j++) {
+		const struct minicore_run *run = &virtual_runs->data[j];
+		minicore_set_phdr(phdrs, i++, is_64_bit, &(GElf_Phdr){
+			.p_type = PT_LOAD,
+			.p_offset = data_offset + run->data_offset,
+			.p_vaddr = run->address,
+			.p_paddr = no_paddr,
+			.p_filesz = run->size,
+			.p_memsz = run->size,
+			.p_flags = PF_R | PF_W | PF_X,
+		});
+	}
+	err = minicore_xlate(phdrs, phnum * phdr_size, ELF_T_PHDR, is_64_bit,
+			     encoding);
+	if (err)
+		goto out_phdrs;
+
+	union {
+		Elf64_Ehdr ehdr64;
+		Elf32_Ehdr ehdr32;
+	} ehdr;
+	union {
+		Elf64_Shdr shdr64;
+		Elf32_Shdr shdr32;
+	} shdr;
+	memset(&ehdr, 0, sizeof(ehdr));
+	memset(&shdr, 0, sizeof(shdr));
+	unsigned char *ident = is_64_bit ? ehdr.ehdr64.e_ident :
+				ehdr.ehdr32.e_ident;
+	memcpy(ident, ELFMAG, SELFMAG);
+	ident[EI_CLASS] = is_64_bit ? ELFCLASS64 : ELFCLASS32;
+	ident[EI_DATA] = encoding;
+	ident[EI_VERSION] = EV_CURRENT;
+	ident[EI_OSABI] = ELFOSABI_NONE;
+	uint16_t machine;
+	switch (prog->platform.arch->arch) {
+	case DRGN_ARCH_X86_64:
+		machine = EM_X86_64;
+		break;
+	default:
+		machine = EM_NONE;
+		break;
+	}
+#define SET_EHDR(ehdr, shdr) do {					\
+	(ehdr).e_type = ET_CORE;					\
+	(ehdr).e_machine = machine;					\
+	(ehdr).e_version = EV_CURRENT;					\
+	(ehdr).e_phoff = ehdr_size;					\
+	(ehdr).e_ehsize = ehdr_size;					\
+	(ehdr).e_phentsize = phdr_size;					\
+	(ehdr).e_phnum = extended_phnum ? PN_XNUM : phnum;		\
+	if (extended_phnum) {						\
+		(ehdr).e_shoff = shoff;					\
+		(ehdr).e_shentsize = shdr_size;				\
+		(ehdr).e_shnum = 1;					\
+		(shdr).sh_info = phnum;					\
+	}								\
+} while (0)
+	if (is_64_bit)
+		SET_EHDR(ehdr.ehdr64, shdr.shdr64);
+	else
+		SET_EHDR(ehdr.ehdr32, shdr.shdr32);
+#undef SET_EHDR
+	err = minicore_xlate(&ehdr, ehdr_size, ELF_T_EHDR, is_64_bit, encoding);
+	if (err)
+		goto out_phdrs;
+	err = minicore_xlate(&shdr, shdr_size, ELF_T_SHDR, is_64_bit, encoding);
+	if (err)
+		goto out_phdrs;
+
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		err = drgn_error_create_os("fopen", errno, path);
+		goto out_phdrs;
+	}
+	if (fwrite(&ehdr, ehdr_size, 1, file) != 1 ||
+	    (phnum && fwrite(phdrs, phdr_size, phnum, file) != phnum) ||
+	    (extended_phnum && fwrite(&shdr, shdr_size, 1, file) != 1) ||
+	    (notes->size && fwrite(notes->data, notes->size, 1, file) != 1) ||
+	    (data->size && fwrite(data->data, data->size, 1, file) != 1)) {
+		err = drgn_error_create_os("fwrite", errno, path);
+		fclose(file);
+		goto out_phdrs;
+	}
+	if (fclose(file) == EOF)
+		err = drgn_error_create_os("fclose", errno, path);
+	else
+		err = NULL;
+out_phdrs:
+	free(phdrs);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_write_minicore(struct drgn_program *prog, const char *path)
+{
+	struct drgn_error *err;
+
+	if (!prog->has_platform) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "cannot write minicore without platform");
+	}
+	if (!prog->reader.recording) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "memory has not been recorded");
+	}
+	elf_version(EV_CURRENT);
+
+	/* Don't record the reads done to write the minicore. */
+	bool recording = drgn_memory_reader_is_recording(&prog->reader);
+	drgn_memory_reader_stop_recording(&prog->reader);
+
+	struct minicore_buffer notes, data;
+	struct minicore_run_vector physical_runs, virtual_runs;
+	minicore_buffer_init(&notes);
+	minicore_buffer_init(&data);
+	minicore_run_vector_init(&physical_runs);
+	minicore_run_vector_init(&virtual_runs);
+
+	unsigned int encoding =
+		(prog->platform.flags & DRGN_PLATFORM_IS_LITTLE_ENDIAN) ?
+		ELFDATA2LSB : ELFDATA2MSB;
+	err = minicore_add_notes(prog, &notes, encoding);
+	if (err)
+		goto out;
+
+	/*
+	 * Physical memory only means something for the Linux kernel, where it
+	 * can also be mapped at its direct mapping address.
+	 */
+	uint64_t page_offset = 0;
+	if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
+		struct drgn_object tmp;
+		drgn_object_init(&tmp, prog);
+		err = drgn_program_find_object(prog, "PAGE_OFFSET", NULL,
+					       DRGN_FIND_OBJECT_ANY, &tmp);
+		if (!err)
+			err = drgn_object_read_unsigned(&tmp, &page_offset);
+		drgn_object_deinit(&tmp);
+		if (err)
+			goto out;
+
+		struct minicore_builder builder = {
+			.runs = &physical_runs,
+			.data = &data,
+		};
+		err = drgn_memory_reader_for_each_recorded(&prog->reader, true,
+							   minicore_add_range,
+							   &builder);
+		if (err)
+			goto out;
+	}
+	struct minicore_builder builder = {
+		.runs = &virtual_runs,
+		.data = &data,
+	};
+	err = drgn_memory_reader_for_each_recorded(&prog->reader, false,
+						   minicore_add_range,
+						   &builder);
+	if (err)
+		goto out;
+
+	err = minicore_write(prog, path, &notes, &physical_runs, &virtual_runs,
+			     &data, page_offset);
+out:
+	minicore_run_vector_deinit(&virtual_runs);
+	minicore_run_vector_deinit(&physical_runs);
+	minicore_buffer_deinit(&data);
+	minicore_buffer_deinit(&notes);
+	if (recording) {
+		/* This only allocates if recording was never started. */
+		drgn_memory_reader_start_recording(&prog->reader);
+	}
+	return err;
+}
@@ -6,15 +6,54 @@
 
 #include "object_index.h"
 
+static struct hash_pair
+drgn_object_index_cache_key_hash_pair(const struct drgn_object_index_cache_key *key)
+{
+	size_t hash = hash_combine(hash_c_string(key->name), key->flags);
+	if (key->filename)
+		hash = hash_combine(hash, hash_c_string(key->filename));
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool
+drgn_object_index_cache_key_eq(const struct drgn_object_index_cache_key *a,
+			       const struct drgn_object_index_cache_key *b)
+{
+	return (a->flags == b->flags && strcmp(a->name, b->name) == 0 &&
+		(a->filename ?
+		 b->filename && strcmp(a->filename, b->filename) == 0 :
+		 !b->filename));
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_object_index_cache,
+			    drgn_object_index_cache_key_hash_pair,
+			    drgn_object_index_cache_key_eq)
+
 void drgn_object_index_init(struct drgn_object_index *oindex)
 {
 	oindex->finders = NULL;
+	drgn_object_index_cache_init(&oindex->cache);
+}
+
+static void drgn_object_index_free_cache(struct drgn_object_index *oindex)
+{
+	for (struct drgn_object_index_cache_iterator it =
+	     drgn_object_index_cache_first(&oindex->cache);
+	     it.entry; it = drgn_object_index_cache_next(it)) {
+		/* The filename is in the same allocation as the name. */
+		free((char *)it.entry->key.name);
+		if (it.entry->value.found)
+			drgn_object_deinit(&it.entry->value.obj);
+	}
 }
 
 void drgn_object_index_deinit(struct drgn_object_index *oindex)
 {
 	struct drgn_object_finder *finder;
 
+	drgn_object_index_free_cache(oindex);
+	drgn_object_index_cache_deinit(&oindex->cache);
+
 	finder = oindex->finders;
 	while (finder) {
 		struct drgn_object_finder *next = finder->next;
@@ -37,6 +76,7 @@ drgn_object_index_add_finder(struct drgn_object_index *oindex,
 	finder->arg = arg;
 	finder->next = oindex->finders;
 	oindex->finders = finder;
+	drgn_object_index_flush_cache(oindex);
 	return NULL;
 }
 
@@ -45,6 +85,53 @@ void drgn_object_index_remove_finder(struct drgn_object_index *oindex)
 	struct drgn_object_finder *finder = oindex->finders->next;
 	free(oindex->finders);
 	oindex->finders = finder;
+	drgn_object_index_flush_cache(oindex);
+}
+
+void drgn_object_index_flush_cache(struct drgn_object_index *oindex)
+{
+	drgn_object_index_free_cache(oindex);
+	drgn_object_index_cache_clear(&oindex->cache);
+}
+
+/*
+ * Remember the result of a lookup. This is best effort: if we run out of
+ * memory, the lookup will simply be repeated next time.
+ */
+static void
+drgn_object_index_cache_result(struct drgn_object_index *oindex,
+			       const struct drgn_object_index_cache_key *key,
+			       struct hash_pair hp, const struct drgn_object *obj)
+{
+	size_t name_size = strlen(key->name) + 1;
+	size_t filename_size = key->filename ? strlen(key->filename) + 1 : 0;
+	char *buf = malloc(name_size + filename_size);
+	if (!buf)
+		return;
+	struct drgn_object_index_cache_entry entry = {
+		.key = {
+			.name = memcpy(buf, key->name, name_size),
+			.filename = (key->filename ?
+				     memcpy(buf + name_size, key->filename,
+					    filename_size) : NULL),
+			.flags = key->flags,
+		},
+		.value = { .found = obj != NULL },
+	};
+	if (obj) {
+		drgn_object_init(&entry.value.obj, drgn_object_program(obj));
+		if (drgn_object_copy(&entry.value.obj, obj))
+			goto err;
+	}
+	if (drgn_object_index_cache_insert_searched(&oindex->cache, &entry, hp,
+						    NULL) == -1)
+		goto err;
+	return;
+
+err:
+	if (obj)
+		drgn_object_deinit(&entry.value.obj);
+	free(buf);
 }
 
 struct drgn_error *drgn_object_index_find(struct drgn_object_index *oindex,
@@ -63,15 +150,34 @@ struct drgn_error *drgn_object_index_find(struct drgn_object_index *oindex,
 					 "invalid find object flags");
 	}
 
+	struct drgn_object_index_cache_key key = {
+		.name = name,
+		.filename = filename,
+		.flags = flags,
+	};
+	struct hash_pair hp = drgn_object_index_cache_hash(&key);
+	struct drgn_object_index_cache_iterator it =
+		drgn_object_index_cache_search_hashed(&oindex->cache, &key, hp);
+	if (it.entry) {
+		if (it.entry->value.found)
+			return drgn_object_copy(ret, &it.entry->value.obj);
+		goto not_found;
+	}
+
 	name_len = strlen(name);
 	finder = oindex->finders;
 	while (finder) {
 		err = finder->fn(name, name_len, filename, flags, finder->arg,
 				 ret);
+		if (!err)
+			drgn_object_index_cache_result(oindex, &key, hp, ret);
 		if (err != &drgn_not_found)
 			return err;
 		finder = finder->next;
 	}
+	drgn_object_index_cache_result(oindex, &key, hp, NULL);
+
+not_found:
 
 	switch (flags) {
 	case DRGN_FIND_OBJECT_CONSTANT:
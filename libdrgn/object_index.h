@@ -13,6 +13,7 @@
 #define DRGN_OBJECT_INDEX_H
 
 #include "drgn.h"
+#include "hash_table.h"
 
 /**
  * @ingroup Internals
@@ -37,6 +38,40 @@ struct drgn_object_finder {
 	struct drgn_object_finder *next;
 };
 
+/** <tt>(name, filename, flags)</tt> key of a cached object lookup. */
+struct drgn_object_index_cache_key {
+	const char *name;
+	/** Filename, or @c NULL for any definition. */
+	const char *filename;
+	enum drgn_find_object_flags flags;
+};
+
+/**
+ * Result of a cached object lookup.
+ *
+ * @c found is @c false if no finder found the object, in which case @c obj is
+ * not initialized.
+ */
+struct drgn_object_index_cache_value {
+	bool found;
+	struct drgn_object obj;
+};
+
+#ifdef DOXYGEN
+/**
+ * @struct drgn_object_index_cache
+ *
+ * Map of previous object lookups to their results.
+ *
+ * The key is a @ref drgn_object_index_cache_key, and the value is a @ref
+ * drgn_object_index_cache_value.
+ */
+#else
+DEFINE_HASH_MAP_TYPE(drgn_object_index_cache,
+		      struct drgn_object_index_cache_key,
+		      struct drgn_object_index_cache_value)
+#endif
+
 /**
  * Object index.
  *
@@ -48,6 +83,14 @@ struct drgn_object_finder {
 struct drgn_object_index {
 	/** Callbacks for finding objects. */
 	struct drgn_object_finder *finders;
+	/**
+	 * Cache of lookup results, including objects which were not found.
+	 *
+	 * This is flushed whenever the result of a lookup may change (i.e.,
+	 * when a finder is added or removed or debugging information is
+	 * loaded).
+	 */
+	struct drgn_object_index_cache cache;
 };
 
 /** Initialize a @ref drgn_object_index. */
@@ -64,9 +107,15 @@ drgn_object_index_add_finder(struct drgn_object_index *oindex,
 /** Remove the most recently added object finding callback. */
 void drgn_object_index_remove_finder(struct drgn_object_index *oindex);
 
+/** Forget all cached lookup results in a @ref drgn_object_index. */
+void drgn_object_index_flush_cache(struct drgn_object_index *oindex);
+
 /**
  * Find an object in a @ref drgn_object_index.
  *
+ * Results (including objects which were not found) are cached, so the finders
+ * are only called the first time an object is looked up.
+ *
  * @param[in] oindex Object index.
  * @param[in] name Name of the object.
  * @param[in] filename Exact filename containing the object definition, or @c
@@ -0,0 +1,131 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * ORC unwinder information.
+ *
+ * See @ref OrcInfo.
+ */
+
+#ifndef DRGN_ORC_H
+#define DRGN_ORC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "drgn.h"
+
+struct drgn_debug_info_module;
+struct drgn_program;
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup OrcInfo ORC unwinder information
+ *
+ * ORC ("Oops Rewind Capability") unwinder information for the x86-64 Linux
+ * kernel.
+ *
+ * The kernel and kernel modules contain an @c .orc_unwind_ip section with the
+ * (relative) instruction addresses that each entry in @c .orc_unwind applies
+ * to. Each entry describes how to find the caller's stack pointer, frame
+ * pointer, and return address (or interrupted registers) until the next entry.
+ * This is simpler and much more compact than DWARF CFI, and unlike DWARF CFI,
+ * it is included in all x86-64 kernels built with @c CONFIG_UNWINDER_ORC.
+ *
+ * The on-disk format has changed a few times, so entries are decoded to @ref
+ * drgn_orc_entry.
+ *
+ * @{
+ */
+
+/** Where a register value comes from in a @ref drgn_orc_entry. */
+enum drgn_orc_reg {
+	DRGN_ORC_REG_UNDEFINED = 0,
+	DRGN_ORC_REG_PREV_SP = 1,
+	DRGN_ORC_REG_DX = 2,
+	DRGN_ORC_REG_DI = 3,
+	DRGN_ORC_REG_BP = 4,
+	DRGN_ORC_REG_SP = 5,
+	DRGN_ORC_REG_R10 = 6,
+	DRGN_ORC_REG_R13 = 7,
+	DRGN_ORC_REG_BP_INDIRECT = 8,
+	DRGN_ORC_REG_SP_INDIRECT = 9,
+};
+
+/** Kind of frame described by a @ref drgn_orc_entry. */
+enum drgn_orc_type {
+	/** The stack can't be unwound from here (e.g., padding). */
+	DRGN_ORC_TYPE_UNDEFINED,
+	/** This is the outermost frame. */
+	DRGN_ORC_TYPE_END_OF_STACK,
+	/** The return address is right below the caller's stack pointer. */
+	DRGN_ORC_TYPE_CALL,
+	/** The caller's stack pointer points to a full <tt>struct pt_regs</tt>. */
+	DRGN_ORC_TYPE_REGS,
+	/**
+	 * The caller's stack pointer points to the hardware interrupt frame
+	 * (the last five registers of <tt>struct pt_regs</tt>).
+	 */
+	DRGN_ORC_TYPE_REGS_PARTIAL,
+};
+
+/** Decoded ORC entry. */
+struct drgn_orc_entry {
+	/** Offset added to @ref sp_reg to get the caller's stack pointer. */
+	int16_t sp_offset;
+	/** Offset added to @ref bp_reg to get the address of the saved rbp. */
+	int16_t bp_offset;
+	/** @ref drgn_orc_reg that the caller's stack pointer is based on. */
+	uint8_t sp_reg;
+	/** @ref drgn_orc_reg that the saved rbp is based on. */
+	uint8_t bp_reg;
+	/** @ref drgn_orc_type. */
+	uint8_t type;
+	/**
+	 * Whether the caller was interrupted (as opposed to having made a
+	 * call), in which case its program counter is not a return address.
+	 */
+	bool signal;
+};
+
+/**
+ * Frame pointer-based entry used by the kernel for code without ORC
+ * information (e.g., BPF programs).
+ */
+static const struct drgn_orc_entry drgn_orc_fp_entry = {
+	.sp_offset = 16,
+	.bp_offset = -16,
+	.sp_reg = DRGN_ORC_REG_BP,
+	.bp_reg = DRGN_ORC_REG_PREV_SP,
+	.type = DRGN_ORC_TYPE_CALL,
+};
+
+/**
+ * Parse the ORC information of a @ref drgn_debug_info_module if it hasn't been
+ * parsed yet.
+ *
+ * A module without ORC information (or with ORC information that can't be
+ * parsed) is not an error; it simply has no entries.
+ */
+struct drgn_error *
+drgn_debug_info_module_parse_orc(struct drgn_program *prog,
+				 struct drgn_debug_info_module *module);
+
+/**
+ * Find the ORC entry for a program counter in a @ref drgn_debug_info_module.
+ *
+ * @ref drgn_debug_info_module_parse_orc() must have been called.
+ *
+ * @return The entry, or @c NULL if the module has no ORC entry covering @p pc.
+ */
+const struct drgn_orc_entry *
+drgn_debug_info_module_find_orc(struct drgn_debug_info_module *module,
+				uint64_t pc);
+
+/** @} */
+
+#endif /* DRGN_ORC_H */
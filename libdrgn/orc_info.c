@@ -0,0 +1,318 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include <elf.h>
+#include <elfutils/libdw.h>
+#include <elfutils/libdwfl.h>
+#include <gelf.h>
+#include <libelf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug_info.h"
+#include "error.h"
+#include "orc.h"
+#include "program.h"
+#include "util.h"
+
+/* Layout of the flags in struct orc_entry, which depends on the kernel version. */
+enum drgn_orc_version {
+	/* Before Linux 6.3: sp_reg:4, bp_reg:4, type:2, end:1. */
+	DRGN_ORC_VERSION_1,
+	/* Linux 6.3: sp_reg:4, bp_reg:4, type:2, signal:1, end:1. */
+	DRGN_ORC_VERSION_2,
+	/*
+	 * Since Linux 6.4: sp_reg:4, bp_reg:4, type:3, signal:1, with the
+	 * types numbered like enum drgn_orc_type.
+	 */
+	DRGN_ORC_VERSION_3,
+};
+
+static enum drgn_orc_version drgn_orc_version(struct drgn_program *prog)
+{
+	unsigned int major, minor;
+	if (sscanf(prog->vmcoreinfo.osrelease, "%u.%u", &major, &minor) != 2)
+		return DRGN_ORC_VERSION_3;
+	if (major < 6 || (major == 6 && minor < 3))
+		return DRGN_ORC_VERSION_1;
+	else if (major == 6 && minor == 3)
+		return DRGN_ORC_VERSION_2;
+	else
+		return DRGN_ORC_VERSION_3;
+}
+
+/* Size of struct orc_entry in the kernel. */
+#define DRGN_ORC_ENTRY_SIZE 6
+
+static void drgn_orc_decode(enum drgn_orc_version version, const char *raw,
+			    struct drgn_orc_entry *ret)
+{
+	uint16_t flags;
+	memcpy(&ret->sp_offset, raw, sizeof(ret->sp_offset));
+	memcpy(&ret->bp_offset, raw + 2, sizeof(ret->bp_offset));
+	memcpy(&flags, raw + 4, sizeof(flags));
+
+	ret->sp_reg = flags & 0xf;
+	ret->bp_reg = (flags >> 4) & 0xf;
+	if (version == DRGN_ORC_VERSION_3) {
+		ret->type = (flags >> 8) & 0x7;
+		ret->signal = flags & 0x800;
+		return;
+	}
+
+	unsigned int type = (flags >> 8) & 0x3;
+	bool end = flags & (version == DRGN_ORC_VERSION_1 ? 0x400 : 0x800);
+	if (ret->sp_reg == DRGN_ORC_REG_UNDEFINED) {
+		ret->type = (end ? DRGN_ORC_TYPE_END_OF_STACK :
+			     DRGN_ORC_TYPE_UNDEFINED);
+	} else if (type <= 2) {
+		/* Before Linux 6.4, CALL was 0, REGS was 1, and REGS_PARTIAL was 2. */
+		ret->type = DRGN_ORC_TYPE_CALL + type;
+	} else {
+		ret->type = DRGN_ORC_TYPE_UNDEFINED;
+	}
+	if (version == DRGN_ORC_VERSION_2)
+		ret->signal = flags & 0x400;
+	else
+		ret->signal = ret->type != DRGN_ORC_TYPE_CALL;
+}
+
+struct drgn_orc_sort_entry {
+	uint64_t pc;
+	struct drgn_orc_entry entry;
+	size_t index;
+};
+
+static int drgn_orc_sort_entry_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_orc_sort_entry *a = _a, *b = _b;
+	if (a->pc != b->pc)
+		return a->pc < b->pc ? -1 : 1;
+	/*
+	 * Like the kernel, sort section terminators (undefined entries) before
+	 * real entries at the same address so that lookups prefer the latter.
+	 */
+	bool a_undefined = a->entry.type == DRGN_ORC_TYPE_UNDEFINED;
+	bool b_undefined = b->entry.type == DRGN_ORC_TYPE_UNDEFINED;
+	if (a_undefined != b_undefined)
+		return a_undefined ? -1 : 1;
+	return a->index < b->index ? -1 : a->index > b->index;
+}
+
+/*
+ * In relocatable files (kernel modules), .orc_unwind_ip may not have been
+ * relocated yet (we only apply relocations to debugging sections, but libdwfl
+ * relocates all sections once it needs the symbol table), so apply any
+ * remaining relocations against it. The sections were assigned their load
+ * addresses when the module was reported. Entries for sections that aren't
+ * loaded (e.g., .init.text after initialization) are invalidated.
+ */
+static struct drgn_error *
+drgn_orc_relocated_pcs(Elf *elf, Elf_Scn *rela_scn, size_t num_entries,
+		       uint64_t bias, struct drgn_orc_sort_entry *entries,
+		       bool *valid)
+{
+	struct drgn_error *err;
+	GElf_Shdr rela_shdr_mem, *rela_shdr = gelf_getshdr(rela_scn,
+							  &rela_shdr_mem);
+	if (!rela_shdr)
+		return drgn_error_libelf();
+	Elf_Scn *symtab_scn = elf_getscn(elf, rela_shdr->sh_link);
+	if (!symtab_scn)
+		return drgn_error_libelf();
+	Elf_Data *rela_data, *symtab_data;
+	err = read_elf_section(rela_scn, &rela_data);
+	if (err)
+		return err;
+	err = read_elf_section(symtab_scn, &symtab_data);
+	if (err)
+		return err;
+
+	const Elf64_Rela *relocs = rela_data->d_buf;
+	size_t num_relocs = rela_data->d_size / sizeof(Elf64_Rela);
+	const Elf64_Sym *syms = symtab_data->d_buf;
+	size_t num_syms = symtab_data->d_size / sizeof(Elf64_Sym);
+	for (size_t i = 0; i < num_relocs; i++) {
+		const Elf64_Rela *reloc = &relocs[i];
+		uint32_t r_sym = ELF64_R_SYM(reloc->r_info);
+		if (reloc->r_offset % 4 != 0 ||
+		    reloc->r_offset / 4 >= num_entries)
+			continue;
+		size_t j = reloc->r_offset / 4;
+		valid[j] = false;
+		if (ELF64_R_TYPE(reloc->r_info) != R_X86_64_PC32 ||
+		    r_sym >= num_syms)
+			continue;
+		uint16_t shndx = syms[r_sym].st_shndx;
+		if (shndx == SHN_UNDEF || shndx >= SHN_LORESERVE)
+			continue;
+		Elf_Scn *scn = elf_getscn(elf, shndx);
+		GElf_Shdr shdr_mem, *shdr;
+		if (!scn || !(shdr = gelf_getshdr(scn, &shdr_mem)))
+			return drgn_error_libelf();
+		if (!shdr->sh_addr)
+			continue;
+		/* R_X86_64_PC32 is S + A - P, and the kernel adds P back. */
+		entries[j].pc = (bias + shdr->sh_addr + syms[r_sym].st_value +
+				 reloc->r_addend);
+		valid[j] = true;
+	}
+	return NULL;
+}
+
+struct drgn_error *
+drgn_debug_info_module_parse_orc(struct drgn_program *prog,
+				 struct drgn_debug_info_module *module)
+{
+	struct drgn_error *err;
+
+	if (module->orc_parsed)
+		return NULL;
+	if (!(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) ||
+	    module->state != DRGN_DEBUG_INFO_MODULE_INDEXED)
+		goto out;
+
+	Dwarf_Addr bias;
+	Dwarf *dwarf = dwfl_module_getdwarf(module->dwfl_module, &bias);
+	if (!dwarf)
+		goto out;
+	Elf *elf = dwarf_getelf(dwarf);
+	if (!elf)
+		goto out;
+	GElf_Ehdr ehdr_mem, *ehdr = gelf_getehdr(elf, &ehdr_mem);
+	if (!ehdr)
+		return drgn_error_libelf();
+	/* ORC is only used on x86-64. */
+	if (ehdr->e_machine != EM_X86_64 ||
+	    ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    ehdr->e_ident[EI_DATA] !=
+	    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ?
+	     ELFDATA2LSB : ELFDATA2MSB))
+		goto out;
+
+	size_t shstrndx;
+	if (elf_getshdrstrndx(elf, &shstrndx))
+		return drgn_error_libelf();
+	Elf_Scn *ip_scn = NULL, *orc_scn = NULL, *rela_scn = NULL;
+	GElf_Addr ip_addr = 0;
+	Elf_Scn *scn = NULL;
+	while ((scn = elf_nextscn(elf, scn))) {
+		GElf_Shdr shdr_mem, *shdr = gelf_getshdr(scn, &shdr_mem);
+		if (!shdr)
+			return drgn_error_libelf();
+		if (shdr->sh_type == SHT_NOBITS)
+			continue;
+		const char *scnname = elf_strptr(elf, shstrndx, shdr->sh_name);
+		if (!scnname)
+			continue;
+		if (strcmp(scnname, ".orc_unwind_ip") == 0) {
+			ip_scn = scn;
+			ip_addr = shdr->sh_addr;
+		} else if (strcmp(scnname, ".orc_unwind") == 0) {
+			orc_scn = scn;
+		} else if (strcmp(scnname, ".rela.orc_unwind_ip") == 0) {
+			rela_scn = scn;
+		}
+	}
+	if (!ip_scn || !orc_scn)
+		goto out;
+
+	Elf_Data *ip_data, *orc_data;
+	err = read_elf_section(ip_scn, &ip_data);
+	if (err)
+		return err;
+	err = read_elf_section(orc_scn, &orc_data);
+	if (err)
+		return err;
+	size_t num_entries = ip_data->d_size / 4;
+	if (ip_data->d_size % 4 != 0 ||
+	    orc_data->d_size != num_entries * DRGN_ORC_ENTRY_SIZE ||
+	    !num_entries)
+		goto out;
+
+	struct drgn_orc_sort_entry *entries = malloc_array(num_entries,
+							   sizeof(*entries));
+	bool *valid = malloc_array(num_entries, sizeof(*valid));
+	if (!entries || !valid) {
+		err = &drgn_enomem;
+		goto err;
+	}
+	enum drgn_orc_version version = drgn_orc_version(prog);
+	const char *raw = orc_data->d_buf;
+	for (size_t i = 0; i < num_entries; i++) {
+		drgn_orc_decode(version, raw + i * DRGN_ORC_ENTRY_SIZE,
+				&entries[i].entry);
+		entries[i].index = i;
+	}
+	/* Each entry in .orc_unwind_ip is relative to its own address. */
+	const char *ip_raw = ip_data->d_buf;
+	for (size_t i = 0; i < num_entries; i++) {
+		int32_t offset;
+		memcpy(&offset, ip_raw + 4 * i, sizeof(offset));
+		entries[i].pc = bias + ip_addr + 4 * i + offset;
+		valid[i] = true;
+	}
+	if (ehdr->e_type == ET_REL && rela_scn) {
+		err = drgn_orc_relocated_pcs(elf, rela_scn, num_entries, bias,
+					     entries, valid);
+		if (err)
+			goto err;
+	}
+
+	/* Drop the invalid entries, then sort the rest by address. */
+	size_t num_valid = 0;
+	for (size_t i = 0; i < num_entries; i++) {
+		if (valid[i])
+			entries[num_valid++] = entries[i];
+	}
+	qsort(entries, num_valid, sizeof(entries[0]), drgn_orc_sort_entry_cmp);
+
+	if (num_valid) {
+		module->orc_pcs = malloc_array(num_valid,
+					       sizeof(module->orc_pcs[0]));
+		module->orc_entries = malloc_array(num_valid,
+						   sizeof(module->orc_entries[0]));
+		if (!module->orc_pcs || !module->orc_entries) {
+			free(module->orc_entries);
+			module->orc_entries = NULL;
+			free(module->orc_pcs);
+			module->orc_pcs = NULL;
+			err = &drgn_enomem;
+			goto err;
+		}
+		for (size_t i = 0; i < num_valid; i++) {
+			module->orc_pcs[i] = entries[i].pc;
+			module->orc_entries[i] = entries[i].entry;
+		}
+		module->num_orc_entries = num_valid;
+	}
+	free(valid);
+	free(entries);
+out:
+	module->orc_parsed = true;
+	return NULL;
+
+err:
+	free(valid);
+	free(entries);
+	return err;
+}
+
+const struct drgn_orc_entry *
+drgn_debug_info_module_find_orc(struct drgn_debug_info_module *module,
+				uint64_t pc)
+{
+	/* Find the last entry with an address less than or equal to pc. */
+	size_t lo = 0, hi = module->num_orc_entries, found = SIZE_MAX;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (module->orc_pcs[mid] <= pc) {
+			found = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return found == SIZE_MAX ? NULL : &module->orc_entries[found];
+}
@@ -9,6 +9,9 @@
 
 #include "drgn.h"
 
+struct drgn_cfi_row;
+struct drgn_register_state;
+
 struct drgn_register {
 	const char *name;
 	enum drgn_register_number number;
@@ -59,15 +62,32 @@ struct drgn_architecture_info {
 	const struct drgn_register *registers;
 	size_t num_registers;
 	const struct drgn_register *(*register_by_name)(const char *name);
+	/* DWARF register number of the program counter. */
+	enum drgn_register_number pc_regno;
+	/*
+	 * Whether frames can be unwound by following the frame pointer: the
+	 * frame pointer points to the caller's saved frame pointer, which is
+	 * followed by the return address, and the caller's stack pointer is
+	 * just past the return address.
+	 */
+	bool has_frame_pointer;
+	/* DWARF register numbers of the stack pointer and frame pointer. */
+	enum drgn_register_number sp_regno;
+	enum drgn_register_number fp_regno;
+	/*
+	 * Rules that apply to registers not mentioned in call frame
+	 * information, or NULL if all registers are undefined.
+	 */
+	const struct drgn_cfi_row *default_cfi_row;
 	/* Given pt_regs as a value buffer object. */
-	struct drgn_error *(*pt_regs_set_initial_registers)(Dwfl_Thread *,
-							    const struct drgn_object *);
+	struct drgn_error *(*pt_regs_set_initial_registers)(const struct drgn_object *,
+							    struct drgn_register_state *);
 	struct drgn_error *(*prstatus_set_initial_registers)(struct drgn_program *,
-							     Dwfl_Thread *,
 							     const void *,
-							     size_t);
-	struct drgn_error *(*linux_kernel_set_initial_registers)(Dwfl_Thread *,
-								 const struct drgn_object *);
+							     size_t,
+							     struct drgn_register_state *);
+	struct drgn_error *(*linux_kernel_set_initial_registers)(const struct drgn_object *,
+								 struct drgn_register_state *);
 	struct drgn_error *(*linux_kernel_get_page_offset)(struct drgn_object *);
 	struct drgn_error *(*linux_kernel_get_vmemmap)(struct drgn_object *);
 	struct drgn_error *(*linux_kernel_live_direct_mapping_fallback)(struct drgn_program *,
@@ -8,6 +8,7 @@
 #include <elfutils/libdw.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <gelf.h>
 #include <inttypes.h>
 #include <stdio.h>
@@ -16,12 +17,17 @@
 #include <sys/statfs.h>
 #include <unistd.h>
 
+#include "btf.h"
 #include "debug_info.h"
 #include "dwarf_index.h"
 #include "error.h"
+#include "helpers.h"
+#include "kallsyms.h"
 #include "language.h"
 #include "linux_kernel.h"
 #include "memory_reader.h"
+#include "memory_scan.h"
+#include "minmax.h"
 #include "object_index.h"
 #include "program.h"
 #include "symbol.h"
@@ -88,6 +94,11 @@ void drgn_program_deinit(struct drgn_program *prog)
 			drgn_prstatus_map_deinit(&prog->prstatus_map);
 	}
 	free(prog->pgtable_it);
+	free(prog->possible_cpus);
+	free(prog->per_cpu_offsets);
+	free(prog->path_offsets);
+	linux_slab_state_destroy(prog->slab_state);
+	free(prog->vmcoreinfo.raw);
 
 	drgn_object_deinit(&prog->vmemmap);
 	drgn_object_deinit(&prog->page_offset);
@@ -107,6 +118,8 @@ void drgn_program_deinit(struct drgn_program *prog)
 		close(prog->core_fd);
 
 	drgn_debug_info_destroy(prog->_dbinfo);
+	drgn_kallsyms_destroy(prog->kallsyms);
+	drgn_btf_destroy(prog->btf);
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
@@ -617,6 +630,23 @@ static int drgn_set_platform_from_dwarf(Dwfl_Module *module, void **userdatap,
 	return DWARF_CB_ABORT;
 }
 
+/*
+ * Forget helper state that was derived from debugging information, which may
+ * be different once more is loaded.
+ */
+static void drgn_program_flush_helper_caches(struct drgn_program *prog)
+{
+	free(prog->per_cpu_offsets);
+	prog->per_cpu_offsets = NULL;
+	prog->num_per_cpu_offsets = 0;
+	free(prog->possible_cpus);
+	prog->possible_cpus = NULL;
+	prog->num_possible_cpus = 0;
+	prog->per_cpu_cached = false;
+	linux_slab_state_destroy(prog->slab_state);
+	prog->slab_state = NULL;
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_program_load_debug_info(struct drgn_program *prog, const char **paths,
 			     size_t n, bool load_default, bool load_main)
@@ -632,6 +662,13 @@ drgn_program_load_debug_info(struct drgn_program *prog, const char **paths,
 		return err;
 
 	err = drgn_debug_info_load(dbinfo, paths, n, load_default, load_main);
+	/*
+	 * Even if this failed, some debugging information may have been
+	 * indexed, so previous lookups may no longer be accurate.
+	 */
+	drgn_object_index_flush_cache(&prog->oindex);
+	drgn_program_flush_type_caches(prog);
+	drgn_program_flush_helper_caches(prog);
 	if ((!err || err->code == DRGN_ERROR_MISSING_DEBUG_INFO)) {
 		if (!prog->lang &&
 		    !(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL))
@@ -694,7 +731,7 @@ struct drgn_error *drgn_program_cache_prstatus_entry(struct drgn_program *prog,
 	return NULL;
 }
 
-static struct drgn_error *drgn_program_cache_prstatus(struct drgn_program *prog)
+struct drgn_error *drgn_program_cache_prstatus(struct drgn_program *prog)
 {
 	struct drgn_error *err;
 	size_t phnum, i;
@@ -938,6 +975,310 @@ drgn_program_read_memory(struct drgn_program *prog, void *buf, uint64_t address,
 				       physical);
 }
 
+DEFINE_VECTOR(uint64_vector, uint64_t)
+
+/* Part of memory searched by one thread. */
+struct drgn_memory_search_chunk {
+	const struct drgn_memory_search_iterator *it;
+	struct drgn_memory_scan_chunk chunk;
+	struct uint64_vector hits;
+	struct drgn_error *err;
+};
+
+struct drgn_memory_search_iterator {
+	char *pattern;
+	/* NULL if every byte of the pattern must match exactly. */
+	char *mask;
+	size_t size;
+	uint64_t alignment;
+	struct drgn_memory_scan scan;
+	struct drgn_memory_search_chunk *chunks;
+	size_t max_chunks;
+	struct uint64_vector hits;
+};
+
+DEFINE_VECTOR(drgn_memory_scan_range_vector, struct drgn_memory_scan_range)
+
+/*
+ * The memory of a running process is a single segment covering the whole
+ * address space, so limit the scan to what is currently mapped.
+ */
+static struct drgn_error *
+drgn_memory_scan_restrict_to_maps(struct drgn_memory_scan *scan, pid_t pid)
+{
+	struct drgn_error *err;
+	char path[64];
+	sprintf(path, "/proc/%ld/maps", (long)pid);
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return drgn_error_create_os("fopen", errno, path);
+
+	struct drgn_memory_scan_range_vector ranges = VECTOR_INIT;
+	char *line = NULL;
+	size_t n = 0;
+	for (;;) {
+		errno = 0;
+		if (getline(&line, &n, file) == -1) {
+			if (errno) {
+				err = drgn_error_create_os("getline", errno,
+							   path);
+				goto out;
+			}
+			break;
+		}
+		uint64_t start, end;
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64, &start, &end) != 2 ||
+		    start >= end) {
+			err = drgn_error_format(DRGN_ERROR_OTHER,
+						"could not parse %s", path);
+			goto out;
+		}
+		struct drgn_memory_scan_range *range =
+			drgn_memory_scan_range_vector_append_entry(&ranges);
+		if (!range) {
+			err = &drgn_enomem;
+			goto out;
+		}
+		range->start = start;
+		range->last = end - 1;
+	}
+	err = drgn_memory_scan_restrict(scan, ranges.data, ranges.size);
+out:
+	drgn_memory_scan_range_vector_deinit(&ranges);
+	free(line);
+	fclose(file);
+	return err;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_search_memory(struct drgn_program *prog, const void *pattern,
+			   const void *mask, size_t size, uint64_t alignment,
+			   uint64_t min_address, uint64_t max_address,
+			   bool physical,
+			   struct drgn_memory_search_iterator **ret)
+{
+	if (size == 0 || size > DRGN_MEMORY_SCAN_CHUNK_SIZE) {
+		return drgn_error_format(DRGN_ERROR_INVALID_ARGUMENT,
+					 "search pattern size must be between 1 and %" PRIu64,
+					 DRGN_MEMORY_SCAN_CHUNK_SIZE);
+	}
+	if (alignment == 0) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "search alignment must be non-zero");
+	}
+
+	struct drgn_error *err;
+	struct drgn_memory_search_iterator *it = calloc(1, sizeof(*it));
+	if (!it)
+		return &drgn_enomem;
+	err = drgn_memory_scan_init(&it->scan, &prog->reader, physical,
+				    min_address, max_address, size - 1);
+	if (err) {
+		free(it);
+		return err;
+	}
+	if ((prog->flags & (DRGN_PROGRAM_IS_LINUX_KERNEL |
+			    DRGN_PROGRAM_IS_LIVE)) == DRGN_PROGRAM_IS_LIVE &&
+	    !physical) {
+		err = drgn_memory_scan_restrict_to_maps(&it->scan, prog->pid);
+		if (err) {
+			drgn_memory_scan_deinit(&it->scan);
+			free(it);
+			return err;
+		}
+	}
+	uint64_vector_init(&it->hits);
+	it->size = size;
+	it->alignment = alignment;
+	it->pattern = malloc(size);
+	if (!it->pattern)
+		goto enomem;
+	memcpy(it->pattern, pattern, size);
+	if (mask) {
+		it->mask = malloc(size);
+		if (!it->mask)
+			goto enomem;
+		/*
+		 * Clear the masked out bits of the pattern so that the
+		 * comparisons can mask only the memory.
+		 */
+		for (size_t i = 0; i < size; i++) {
+			it->mask[i] = ((const char *)mask)[i];
+			it->pattern[i] &= it->mask[i];
+		}
+	}
+
+	it->max_chunks = 4 * it->scan.num_threads;
+	it->chunks = calloc(it->max_chunks, sizeof(it->chunks[0]));
+	if (!it->chunks)
+		goto enomem;
+	for (size_t i = 0; i < it->max_chunks; i++)
+		it->chunks[i].it = it;
+
+	*ret = it;
+	return NULL;
+
+enomem:
+	drgn_memory_search_iterator_destroy(it);
+	return &drgn_enomem;
+}
+
+LIBDRGN_PUBLIC void
+drgn_memory_search_iterator_destroy(struct drgn_memory_search_iterator *it)
+{
+	if (!it)
+		return;
+	if (it->chunks) {
+		for (size_t i = 0; i < it->max_chunks; i++)
+			uint64_vector_deinit(&it->chunks[i].hits);
+		free(it->chunks);
+	}
+	uint64_vector_deinit(&it->hits);
+	drgn_memory_scan_deinit(&it->scan);
+	free(it->mask);
+	free(it->pattern);
+	free(it);
+}
+
+/* Find the matches starting in buf[0, end) that are entirely in buf[0, len). */
+static struct drgn_error *drgn_memory_search_buffer(const char *buf,
+						    uint64_t address,
+						    uint64_t len, uint64_t end,
+						    void *arg)
+{
+	struct drgn_memory_search_chunk *chunk = arg;
+	const struct drgn_memory_search_iterator *it = chunk->it;
+	struct uint64_vector *hits = &chunk->hits;
+	const char *pattern = it->pattern, *mask = it->mask;
+	size_t size = it->size;
+	uint64_t alignment = it->alignment;
+	if (len < size)
+		return NULL;
+	end = min(end, len - size + 1);
+	uint64_t pos = (alignment - address % alignment) % alignment;
+
+	if (!mask) {
+		while (pos < end) {
+			const char *match = memmem(buf + pos, end - 1 + size - pos,
+						   pattern, size);
+			if (!match)
+				break;
+			pos = match - buf;
+			uint64_t misalignment = (address + pos) % alignment;
+			if (misalignment) {
+				pos += alignment - misalignment;
+				continue;
+			}
+			if (!uint64_vector_append(hits,
+						  &(uint64_t){address + pos}))
+				return &drgn_enomem;
+			pos += alignment;
+		}
+	} else if (size == 8 && alignment % 8 == 0) {
+		/* Fast path for aligned words, e.g., pointers. */
+		uint64_t value, word_mask;
+		memcpy(&value, pattern, 8);
+		memcpy(&word_mask, mask, 8);
+		for (; pos < end; pos += alignment) {
+			uint64_t word;
+			memcpy(&word, buf + pos, 8);
+			if ((word & word_mask) == value &&
+			    !uint64_vector_append(hits,
+						  &(uint64_t){address + pos}))
+				return &drgn_enomem;
+		}
+	} else if (size == 4 && alignment % 4 == 0) {
+		uint32_t value, word_mask;
+		memcpy(&value, pattern, 4);
+		memcpy(&word_mask, mask, 4);
+		for (; pos < end; pos += alignment) {
+			uint32_t word;
+			memcpy(&word, buf + pos, 4);
+			if ((word & word_mask) == value &&
+			    !uint64_vector_append(hits,
+						  &(uint64_t){address + pos}))
+				return &drgn_enomem;
+		}
+	} else {
+		for (; pos < end; pos += alignment) {
+			size_t i;
+			for (i = 0; i < size; i++) {
+				if (((unsigned char)buf[pos + i] &
+				     (unsigned char)mask[i]) !=
+				    (unsigned char)pattern[i])
+					break;
+			}
+			if (i == size &&
+			    !uint64_vector_append(hits,
+						  &(uint64_t){address + pos}))
+				return &drgn_enomem;
+		}
+	}
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_memory_search_iterator_next(struct drgn_memory_search_iterator *it,
+				 const uint64_t **addresses_ret,
+				 size_t *count_ret)
+{
+	struct drgn_error *err = NULL;
+	it->hits.size = 0;
+	while (!it->hits.size) {
+		/* Split the next part of memory into chunks. */
+		size_t num_chunks = 0;
+		while (num_chunks < it->max_chunks &&
+		       drgn_memory_scan_next_chunk(&it->scan,
+						   &it->chunks[num_chunks].chunk)) {
+			it->chunks[num_chunks].hits.size = 0;
+			it->chunks[num_chunks].err = NULL;
+			num_chunks++;
+		}
+		if (!num_chunks)
+			break;
+
+		#pragma omp parallel for schedule(dynamic) \
+			num_threads(it->scan.num_threads)
+		for (size_t i = 0; i < num_chunks; i++) {
+			it->chunks[i].err =
+				drgn_memory_scan_visit(&it->scan,
+						       &it->chunks[i].chunk,
+						       drgn_memory_search_buffer,
+						       &it->chunks[i]);
+		}
+
+		for (size_t i = 0; i < num_chunks; i++) {
+			struct drgn_memory_search_chunk *chunk = &it->chunks[i];
+			if (chunk->err) {
+				if (err)
+					drgn_error_destroy(chunk->err);
+				else
+					err = chunk->err;
+				continue;
+			}
+			if (err || !chunk->hits.size)
+				continue;
+			if (!uint64_vector_reserve(&it->hits,
+						   it->hits.size +
+						   chunk->hits.size)) {
+				err = &drgn_enomem;
+				continue;
+			}
+			memcpy(it->hits.data + it->hits.size, chunk->hits.data,
+			       chunk->hits.size * sizeof(it->hits.data[0]));
+			it->hits.size += chunk->hits.size;
+		}
+		if (err) {
+			/* Don't continue after an error. */
+			it->scan.segment = it->scan.segments.size;
+			return err;
+		}
+	}
+	*addresses_ret = it->hits.data;
+	*count_ret = it->hits.size;
+	return NULL;
+}
+
 DEFINE_VECTOR(char_vector, char)
 
 LIBDRGN_PUBLIC struct drgn_error *
@@ -1052,31 +1393,75 @@ drgn_program_find_object(struct drgn_program *prog, const char *name,
 				      ret);
 }
 
+/*
+ * Get the kernel symbol table, loading it the first time this is called.
+ * Returns NULL if the program is not the Linux kernel or the symbol table is
+ * not available. It is only a fallback for when the ELF symbol tables don't
+ * have a symbol, so errors while loading it are ignored.
+ */
+static struct drgn_kallsyms *drgn_program_kallsyms(struct drgn_program *prog)
+{
+	if (prog->kallsyms_loaded ||
+	    !(prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL))
+		return prog->kallsyms;
+	prog->kallsyms_loaded = true;
+
+	struct drgn_error *err;
+	if (prog->flags & DRGN_PROGRAM_IS_LIVE) {
+		err = drgn_kallsyms_from_proc("/proc/kallsyms",
+					      &prog->kallsyms);
+		if (!err)
+			return prog->kallsyms;
+		drgn_error_destroy(err);
+	}
+	err = drgn_kallsyms_from_vmcoreinfo(prog, &prog->kallsyms);
+	drgn_error_destroy(err);
+	return prog->kallsyms;
+}
+
+struct drgn_error *
+drgn_program_live_kallsyms_symbol_addr(struct drgn_program *prog,
+				       const char *name, uint64_t *ret)
+{
+	if (!prog->kallsyms_loaded) {
+		struct drgn_error *err =
+			drgn_kallsyms_from_proc("/proc/kallsyms",
+						&prog->kallsyms);
+		if (err)
+			return err;
+		prog->kallsyms_loaded = true;
+	}
+	if (!prog->kallsyms)
+		return &drgn_not_found;
+	size_t count;
+	const struct drgn_symbol *symbols =
+		drgn_kallsyms_find_by_name(prog->kallsyms, name, &count);
+	if (!count)
+		return &drgn_not_found;
+	*ret = symbols[0].address;
+	return NULL;
+}
+
 bool drgn_program_find_symbol_by_address_internal(struct drgn_program *prog,
 						  uint64_t address,
 						  Dwfl_Module *module,
 						  struct drgn_symbol *ret)
 {
-	if (!module) {
-		if (prog->_dbinfo) {
-			module = dwfl_addrmodule(prog->_dbinfo->dwfl, address);
-			if (!module)
-				return false;
-		} else {
-			return false;
+	if (prog->_dbinfo &&
+	    drgn_debug_info_find_symbol_by_address(prog->_dbinfo, address,
+						   module, ret))
+		return true;
+
+	struct drgn_kallsyms *kallsyms = drgn_program_kallsyms(prog);
+	if (kallsyms) {
+		const struct drgn_symbol *sym =
+			drgn_kallsyms_find_by_address(kallsyms, address);
+		if (sym) {
+			*ret = *sym;
+			return true;
 		}
 	}
-
-	GElf_Off offset;
-	GElf_Sym elf_sym;
-	const char *name = dwfl_module_addrinfo(module, address, &offset,
-						&elf_sym, NULL, NULL, NULL);
-	if (!name)
-		return false;
-	ret->name = name;
-	ret->address = address - offset;
-	ret->size = elf_sym.st_size;
-	return true;
+	return false;
 }
 
 struct drgn_error *drgn_error_symbol_not_found(uint64_t address)
@@ -1104,68 +1489,132 @@ drgn_program_find_symbol_by_address(struct drgn_program *prog, uint64_t address,
 	return NULL;
 }
 
-struct find_symbol_by_name_arg {
-	const char *name;
-	struct drgn_symbol **ret;
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_find_symbol_by_name(struct drgn_program *prog,
+			const char *name, struct drgn_symbol **ret)
+{
 	struct drgn_error *err;
-	bool bad_symtabs;
-};
+	struct drgn_symbol *found = NULL;
+	size_t count;
+	bool bad_symtabs = false;
 
-static int find_symbol_by_name_cb(Dwfl_Module *dwfl_module, void **userdatap,
-				  const char *module_name, Dwarf_Addr base,
-				  void *cb_arg)
+	if (prog->_dbinfo) {
+		err = drgn_debug_info_index_symbols(prog->_dbinfo);
+		if (err)
+			return err;
+		found = drgn_symbol_name_index_find(&prog->_dbinfo->global_symbols,
+						    name, &count);
+		bad_symtabs = prog->_dbinfo->symbols_bad_symtabs;
+	}
+	if (!found) {
+		struct drgn_kallsyms *kallsyms = drgn_program_kallsyms(prog);
+		if (kallsyms)
+			found = drgn_kallsyms_find_by_name(kallsyms, name, &count);
+	}
+	if (!found) {
+		return drgn_error_format(DRGN_ERROR_LOOKUP,
+					 "could not find symbol with name '%s'%s",
+					 name,
+					 bad_symtabs ?
+					 " (could not get some symbol tables)" : "");
+	}
+	struct drgn_symbol *sym = malloc(sizeof(*sym));
+	if (!sym)
+		return &drgn_enomem;
+	*sym = found[0];
+	*ret = sym;
+	return NULL;
+}
+
+/*
+ * Return copies of the symbols in an array that match a pattern. If exact is
+ * true, then the symbols were already looked up by name.
+ */
+static struct drgn_error *match_symbols(const struct drgn_symbol *candidates,
+					size_t num_candidates,
+					const char *pattern, bool exact,
+					struct drgn_symbol ***syms_ret,
+					size_t *count_ret)
 {
-	struct find_symbol_by_name_arg *arg = cb_arg;
-	int symtab_len, i;
+	struct drgn_symbol **syms;
+	size_t count = 0;
 
-	symtab_len = dwfl_module_getsymtab(dwfl_module);
-	i = dwfl_module_getsymtab_first_global(dwfl_module);
-	if (symtab_len == -1 || i == -1) {
-		arg->bad_symtabs = true;
-		return DWARF_CB_OK;
-	}
-	for (; i < symtab_len; i++) {
-		GElf_Sym elf_sym;
-		GElf_Addr elf_addr;
-		const char *name;
-
-		name = dwfl_module_getsym_info(dwfl_module, i, &elf_sym,
-					       &elf_addr, NULL, NULL, NULL);
-		if (name && strcmp(arg->name, name) == 0) {
-			struct drgn_symbol *sym;
-
-			sym = malloc(sizeof(*sym));
-			if (sym) {
-				sym->name = name;
-				sym->address = elf_addr;
-				sym->size = elf_sym.st_size;
-				*arg->ret = sym;
-			} else {
-				arg->err = &drgn_enomem;
-			}
-			return DWARF_CB_ABORT;
+	if (!num_candidates)
+		return NULL;
+	syms = malloc_array(num_candidates, sizeof(*syms));
+	if (!syms)
+		return &drgn_enomem;
+	for (size_t i = 0; i < num_candidates; i++) {
+		if (!exact && pattern &&
+		    fnmatch(pattern, candidates[i].name, 0) != 0)
+			continue;
+		syms[count] = malloc(sizeof(*syms[count]));
+		if (!syms[count]) {
+			while (count)
+				free(syms[--count]);
+			free(syms);
+			return &drgn_enomem;
 		}
+		*syms[count++] = candidates[i];
 	}
-	return DWARF_CB_OK;
+	if (!count) {
+		free(syms);
+		return NULL;
+	} else if (count < num_candidates) {
+		struct drgn_symbol **tmp = realloc(syms,
+						   count * sizeof(*syms));
+		if (tmp)
+			syms = tmp;
+	}
+	*syms_ret = syms;
+	*count_ret = count;
+	return NULL;
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
-drgn_program_find_symbol_by_name(struct drgn_program *prog,
-			const char *name, struct drgn_symbol **ret)
+drgn_program_find_symbols(struct drgn_program *prog, const char *pattern,
+			  struct drgn_symbol ***syms_ret, size_t *count_ret)
 {
-	struct find_symbol_by_name_arg arg = {
-		.name = name,
-		.ret = ret,
-	};
+	struct drgn_error *err;
+	struct drgn_symbol *candidates;
+	size_t num_candidates;
 
-	if (prog->_dbinfo &&
-	    dwfl_getmodules(prog->_dbinfo->dwfl, find_symbol_by_name_cb,
-			    &arg, 0))
-		return arg.err;
-	return drgn_error_format(DRGN_ERROR_LOOKUP,
-				 "could not find symbol with name '%s'%s", name,
-				 arg.bad_symtabs ?
-				 " (could not get some symbol tables)" : "");
+	*syms_ret = NULL;
+	*count_ret = 0;
+
+	/* A pattern without any special characters can use the index. */
+	bool exact = pattern && !strpbrk(pattern, "*?[\\");
+	if (prog->_dbinfo) {
+		err = drgn_debug_info_index_symbols(prog->_dbinfo);
+		if (err)
+			return err;
+		struct drgn_symbol_name_index *index =
+			&prog->_dbinfo->global_symbols;
+		if (exact) {
+			candidates = drgn_symbol_name_index_find(index, pattern,
+								 &num_candidates);
+		} else {
+			candidates = index->symbols.data;
+			num_candidates = index->symbols.size;
+		}
+		err = match_symbols(candidates, num_candidates, pattern, exact,
+				    syms_ret, count_ret);
+		if (err || *count_ret)
+			return err;
+	}
+
+	struct drgn_kallsyms *kallsyms = drgn_program_kallsyms(prog);
+	if (!kallsyms)
+		return NULL;
+	if (exact) {
+		candidates = drgn_kallsyms_find_by_name(kallsyms, pattern,
+							&num_candidates);
+	} else {
+		candidates = kallsyms->symbols.data;
+		num_candidates = kallsyms->symbols.size;
+	}
+	return match_symbols(candidates, num_candidates, pattern, exact,
+			     syms_ret, count_ret);
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
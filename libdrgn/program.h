@@ -28,7 +28,11 @@
 #include "type.h"
 #include "vector.h"
 
+struct drgn_btf;
 struct drgn_debug_info;
+struct drgn_kallsyms;
+struct linux_path_offsets;
+struct linux_slab_state;
 struct drgn_symbol;
 
 /**
@@ -63,6 +67,23 @@ struct vmcoreinfo {
 	uint64_t swapper_pg_dir;
 	/** Whether 5-level paging was enabled. */
 	bool pgtable_l5_enabled;
+	/**
+	 * Addresses of the kallsyms tables, or 0 if not present.
+	 *
+	 * These were added in Linux 6.0. Only one of @c kallsyms_offsets and
+	 * @c kallsyms_relative_base or @c kallsyms_addresses is present,
+	 * depending on @c CONFIG_KALLSYMS_BASE_RELATIVE.
+	 */
+	uint64_t kallsyms_names;
+	uint64_t kallsyms_num_syms;
+	uint64_t kallsyms_token_table;
+	uint64_t kallsyms_token_index;
+	uint64_t kallsyms_offsets;
+	uint64_t kallsyms_relative_base;
+	uint64_t kallsyms_addresses;
+	/** Contents of the note, or @c NULL if it was not found. */
+	char *raw;
+	size_t raw_size;
 };
 
 DEFINE_VECTOR_TYPE(drgn_typep_vector, struct drgn_type *)
@@ -93,6 +114,10 @@ struct drgn_program {
 	 */
 	/** Callbacks for finding types. */
 	struct drgn_type_finder *type_finders;
+	/** Cache for @ref drgn_program_find_type(). */
+	struct drgn_type_name_cache type_name_cache;
+	/** Cache for @ref drgn_program_find_type_impl(). */
+	struct drgn_type_find_cache type_find_cache;
 	/** Void type for each language. */
 	struct drgn_type void_types[DRGN_NUM_LANGUAGES];
 	/** Cache of primitive types. */
@@ -150,13 +175,12 @@ struct drgn_program {
 		/* For userspace programs, PRSTATUS notes indexed by PID. */
 		struct drgn_prstatus_map prstatus_map;
 	};
-	/* See @ref drgn_object_stack_trace(). */
-	struct drgn_error *stack_trace_err;
-	/* See @ref drgn_object_stack_trace_next_thread(). */
-	const struct drgn_object *stack_trace_obj;
-	uint32_t stack_trace_tid;
 	bool prstatus_cached;
-	bool attached_dwfl_state;
+	/*
+	 * Whether to unwind by following frame pointers when possible. See
+	 * drgn_program_set_frame_pointer_unwinding().
+	 */
+	bool frame_pointer_unwinding;
 
 	/*
 	 * Linux kernel-specific.
@@ -166,6 +190,19 @@ struct drgn_program {
 	struct drgn_object page_offset;
 	/* Cached vmemmap. */
 	struct drgn_object vmemmap;
+	/*
+	 * Cached __per_cpu_offset, indexed by CPU, and possible CPUs. See
+	 * drgn_program_per_cpu_values().
+	 */
+	uint64_t *per_cpu_offsets;
+	size_t num_per_cpu_offsets;
+	uint64_t *possible_cpus;
+	size_t num_possible_cpus;
+	bool per_cpu_cached;
+	/* Cached member offsets for d_path(); see linux_path_offsets(). */
+	struct linux_path_offsets *path_offsets;
+	/* Cached slab allocator state; see linux_slab_state(). */
+	struct linux_slab_state *slab_state;
 	/* Page table iterator for linux_helper_read_vm(). */
 	struct pgtable_iterator *pgtable_it;
 	/*
@@ -173,6 +210,14 @@ struct drgn_program {
 	 * to prevent address translation from recursing.
 	 */
 	bool pgtable_it_in_use;
+	/*
+	 * Kernel symbol table, used for symbols that aren't in any ELF symbol
+	 * table. Loaded on demand; see drgn_program_kallsyms().
+	 */
+	struct drgn_kallsyms *kallsyms;
+	bool kallsyms_loaded;
+	/* BTF type information; see drgn_program_load_btf(). */
+	struct drgn_btf *btf;
 };
 
 /** Initialize a @ref drgn_program. */
@@ -285,6 +330,13 @@ struct drgn_error *drgn_program_find_prstatus_by_tid(struct drgn_program *prog,
 						     uint32_t tid,
 						     struct string *ret);
 
+/**
+ * Cache the @c NT_PRSTATUS notes of the core dump in @c prog->prstatus_vector
+ * (for the Linux kernel) or @c prog->prstatus_map (for userspace programs) if
+ * they haven't been cached already.
+ */
+struct drgn_error *drgn_program_cache_prstatus(struct drgn_program *prog);
+
 /**
  * Cache the @c NT_PRSTATUS note provided by @p data in @p prog.
  *
@@ -295,6 +347,20 @@ struct drgn_error *drgn_program_cache_prstatus_entry(struct drgn_program *prog,
                                                      const char *data,
 						     size_t size);
 
+/**
+ * Find the address of a symbol in the symbol table of the running kernel.
+ *
+ * The symbol table is read from @c /proc/kallsyms the first time it is needed
+ * and cached in @ref drgn_program::kallsyms. This may be called while the
+ * program is still being set up as the running kernel.
+ *
+ * @return @c NULL on success, &@ref drgn_not_found if the symbol was not
+ * found, non-@c NULL on other errors.
+ */
+struct drgn_error *
+drgn_program_live_kallsyms_symbol_addr(struct drgn_program *prog,
+				       const char *name, uint64_t *ret);
+
 /*
  * Like @ref drgn_program_find_symbol_by_address(), but @p ret is already
  * allocated, we may already know the module, and doesn't return a @ref
@@ -8,6 +8,7 @@
 
 // IWYU pragma: begin_exports
 #include <Python.h>
+#include <pythread.h>
 #include "structmember.h"
 
 #include "docstrings.h"
@@ -16,6 +17,7 @@
 
 #include "../hash_table.h"
 #include "../program.h"
+#include "../symbol.h"
 
 /* These were added in Python 3.7. */
 #ifndef Py_UNREACHABLE
@@ -37,8 +39,101 @@
     } while (0)
 #endif
 
+/*
+ * Methods which are called in hot loops use the "fast" calling convention,
+ * which avoids building an argument tuple and keyword argument dictionary for
+ * every call. Such methods are defined with DRGNPY_FASTCALL_ARGS as their
+ * parameters (after self), registered with DRGNPY_FASTCALL_FLAGS, and parse
+ * their arguments by passing args, nargs, and kwnames to
+ * drgnpy_parse_fastcall() along with a static drgnpy_arg_parser.
+ *
+ * Before Python 3.13, drgnpy_arg_parser is CPython's private _PyArg_Parser,
+ * which caches the parsed format string and keywords between calls. It was
+ * made internal in Python 3.13, so after that, the arguments are converted to
+ * a tuple and dictionary and parsed with the public API instead.
+ *
+ * METH_FASTCALL | METH_KEYWORDS was added in Python 3.7. Before that, fall
+ * back to the classic calling convention, which can still use the cached
+ * parser. In that case, there is no nargs parameter, and the nargs argument to
+ * drgnpy_parse_fastcall() is ignored.
+ */
+#if PY_VERSION_HEX >= 0x030d0000
+typedef struct {
+	const char *format;
+	const char * const *keywords;
+} drgnpy_arg_parser;
+#else
+typedef _PyArg_Parser drgnpy_arg_parser;
+#endif
+
+#if PY_VERSION_HEX >= 0x030700a4
+#define DRGNPY_FASTCALL_ARGS	\
+	PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames
+#define DRGNPY_FASTCALL_FLAGS (METH_FASTCALL | METH_KEYWORDS)
+#define DRGNPY_FASTCALL_PASS args, nargs, kwnames
+#else
+#define DRGNPY_FASTCALL_ARGS PyObject *args, PyObject *kwnames
+#define DRGNPY_FASTCALL_FLAGS (METH_VARARGS | METH_KEYWORDS)
+#define DRGNPY_FASTCALL_PASS args, kwnames
+#endif
+
+#if PY_VERSION_HEX >= 0x030d0000
+int drgnpy_parse_fastcall(PyObject *const *args, Py_ssize_t nargs,
+			  PyObject *kwnames, drgnpy_arg_parser *parser, ...);
+int drgnpy_parse_tuple_and_keywords(PyObject *args, PyObject *kwds,
+				    drgnpy_arg_parser *parser, ...);
+#else
+#if PY_VERSION_HEX >= 0x030700a4
+#define drgnpy_parse_fastcall(args, nargs, kwnames, parser, ...)	\
+	_PyArg_ParseStackAndKeywords(args, nargs, kwnames, parser,	\
+				     __VA_ARGS__)
+#else
+#define drgnpy_parse_fastcall(args, nargs, kwnames, parser, ...)	\
+	_PyArg_ParseTupleAndKeywordsFast(args, kwnames, parser, __VA_ARGS__)
+#endif
+#define drgnpy_parse_tuple_and_keywords(args, kwds, parser, ...)	\
+	_PyArg_ParseTupleAndKeywordsFast(args, kwds, parser, __VA_ARGS__)
+#endif
+
 #define DRGNPY_PUBLIC __attribute__((visibility("default")))
 
+/*
+ * Define name##_locked(), which calls name() with the lock of the Program given
+ * by prog held (see Program_lock()). params and args are the parenthesized
+ * parameter and argument lists, and prog may refer to the parameters. If the
+ * lock can't be taken, name##_locked() returns error_ret.
+ */
+#define DRGNPY_LOCKED(ret_type, error_ret, name, params, args, prog)	\
+static ret_type name##_locked params					\
+{									\
+	Program *locked_prog = (prog);					\
+	if (Program_lock(locked_prog))					\
+		return error_ret;					\
+	ret_type locked_ret = name args;				\
+	Program_unlock(locked_prog);					\
+	return locked_ret;						\
+}
+
+/* Shorthands for DRGNPY_LOCKED() for the method calling conventions. */
+#define DRGNPY_LOCKED_NOARGS(ret_type, self_type, name, prog)		\
+	DRGNPY_LOCKED(ret_type, NULL, name,				\
+		      (self_type *self, PyObject *Py_UNUSED(ignored)),	\
+		      (self), prog)
+#define DRGNPY_LOCKED_O(ret_type, self_type, name, prog)		\
+	DRGNPY_LOCKED(ret_type, NULL, name,				\
+		      (self_type *self, PyObject *arg), (self, arg), prog)
+#define DRGNPY_LOCKED_KEYWORDS(ret_type, self_type, name, prog)		\
+	DRGNPY_LOCKED(ret_type, NULL, name,				\
+		      (self_type *self, PyObject *args, PyObject *kwds), \
+		      (self, args, kwds), prog)
+#define DRGNPY_LOCKED_FASTCALL(ret_type, self_type, name, prog)		\
+	DRGNPY_LOCKED(ret_type, NULL, name,				\
+		      (self_type *self, DRGNPY_FASTCALL_ARGS),		\
+		      (self, DRGNPY_FASTCALL_PASS), prog)
+#define DRGNPY_LOCKED_GETTER(ret_type, self_type, name, prog)		\
+	DRGNPY_LOCKED(ret_type, NULL, name,				\
+		      (self_type *self, void *arg), (self, arg), prog)
+
 typedef struct {
 	PyObject_HEAD
 	struct drgn_object obj;
@@ -88,14 +183,57 @@ typedef struct {
 	 * lifetime of the Program.
 	 */
 	struct pyobjectp_set objects;
+	/*
+	 * Recursive lock serializing libdrgn calls which are made with the GIL
+	 * released. See Program_begin_allow_threads().
+	 */
+	PyThread_type_lock lock;
+	/*
+	 * Thread identifier of the holder of lock, or 0. Accessed atomically
+	 * since it is checked by threads which don't hold the lock.
+	 */
+	unsigned long lock_owner;
+	unsigned long lock_count;
 } Program;
 
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct drgn_memory_search_iterator *it;
+	/* Current batch of match addresses. */
+	const uint64_t *addresses;
+	size_t num_addresses, index;
+} MemorySearchIterator;
+
 typedef struct {
 	PyObject_HEAD
 	Program *prog;
 	struct drgn_stack_trace *trace;
 } StackTrace;
 
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct linux_slab_cache_iterator *it;
+	/* Current batch of object addresses. */
+	const uint64_t *objects;
+	size_t num_objects, index;
+} SlabCacheObjectIterator;
+
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct linux_pointer_index *index;
+} PointerIndex;
+
+typedef struct {
+	PyObject_HEAD
+	Program *prog;
+	struct drgn_expression *expr;
+	/* Tuple of parameter names. */
+	PyObject *params;
+} Expression;
+
 typedef struct {
 	PyObject_HEAD
 	StackTrace *trace;
@@ -105,7 +243,7 @@ typedef struct {
 typedef struct {
 	PyObject_HEAD
 	Program *prog;
-	struct drgn_symbol *sym;
+	struct drgn_symbol sym;
 } Symbol;
 
 typedef struct {
@@ -149,12 +287,16 @@ extern PyObject *TypeKind_class;
 extern PyStructSequence_Desc Register_desc;
 extern PyTypeObject DrgnObject_type;
 extern PyTypeObject DrgnType_type;
+extern PyTypeObject Expression_type;
 extern PyTypeObject FaultError_type;
 extern PyTypeObject Language_type;
+extern PyTypeObject MemorySearchIterator_type;
 extern PyTypeObject ObjectIterator_type;
 extern PyTypeObject Platform_type;
 extern PyTypeObject Program_type;
 extern PyTypeObject Register_type;
+extern PyTypeObject PointerIndex_type;
+extern PyTypeObject SlabCacheObjectIterator_type;
 extern PyTypeObject StackFrame_type;
 extern PyTypeObject StackTrace_type;
 extern PyTypeObject Symbol_type;
@@ -193,14 +335,25 @@ static inline Program *DrgnObject_prog(DrgnObject *obj)
 {
 	return container_of(drgn_object_program(&obj->obj), Program, prog);
 }
+int DrgnObject_literal(struct drgn_object *res, PyObject *literal);
 PyObject *DrgnObject_NULL(PyObject *self, PyObject *args, PyObject *kwds);
-DrgnObject *cast(PyObject *self, PyObject *args, PyObject *kwds);
-DrgnObject *reinterpret(PyObject *self, PyObject *args, PyObject *kwds);
-DrgnObject *DrgnObject_container_of(PyObject *self, PyObject *args,
-				    PyObject *kwds);
+DrgnObject *cast(PyObject *self, DRGNPY_FASTCALL_ARGS);
+DrgnObject *reinterpret(PyObject *self, DRGNPY_FASTCALL_ARGS);
+DrgnObject *DrgnObject_container_of(PyObject *self, DRGNPY_FASTCALL_ARGS);
+
+Expression *Program_compile_expression(Program *prog, const char *str,
+				       PyObject *params_obj);
 
 PyObject *Platform_wrap(const struct drgn_platform *platform);
 
+PyGILState_STATE drgnpy_gilstate_ensure(void);
+void drgnpy_gilstate_release(PyGILState_STATE state);
+
+int Program_lock(Program *prog) __attribute__((__warn_unused_result__));
+void Program_unlock(Program *prog);
+PyThreadState *Program_begin_allow_threads(Program *prog)
+	__attribute__((__warn_unused_result__));
+void Program_end_allow_threads(Program *prog, PyThreadState *save);
 int Program_hold_object(Program *prog, PyObject *obj);
 bool Program_hold_reserve(Program *prog, size_t n);
 int Program_type_arg(Program *prog, PyObject *type_obj, bool can_be_none,
@@ -209,7 +362,7 @@ Program *program_from_core_dump(PyObject *self, PyObject *args, PyObject *kwds);
 Program *program_from_kernel(PyObject *self);
 Program *program_from_pid(PyObject *self, PyObject *args, PyObject *kwds);
 
-PyObject *Symbol_wrap(struct drgn_symbol *sym, Program *prog);
+PyObject *Symbol_wrap(const struct drgn_symbol *sym, Program *prog);
 
 static inline Program *DrgnType_prog(DrgnType *type)
 {
@@ -283,11 +436,38 @@ DrgnObject *drgnpy_linux_helper_pid_task(PyObject *self, PyObject *args,
 					 PyObject *kwds);
 DrgnObject *drgnpy_linux_helper_find_task(PyObject *self, PyObject *args,
 					  PyObject *kwds);
+DrgnObject *drgnpy_linux_helper_per_cpu_ptr(PyObject *self, PyObject *args,
+					    PyObject *kwds);
 PyObject *drgnpy_linux_helper_task_state_to_char(PyObject *self, PyObject *args,
 						 PyObject *kwds);
 PyObject *drgnpy_linux_helper_kaslr_offset(PyObject *self, PyObject *args,
 					   PyObject *kwds);
 PyObject *drgnpy_linux_helper_pgtable_l5_enabled(PyObject *self, PyObject *args,
 						 PyObject *kwds);
+PyObject *drgnpy_linux_helper_scan_pages(PyObject *self, PyObject *args,
+					 PyObject *kwds);
+SlabCacheObjectIterator *
+drgnpy_linux_helper_slab_cache_objects(PyObject *self, PyObject *args,
+				       PyObject *kwds);
+PyObject *drgnpy_linux_helper_slab_object_info(PyObject *self, PyObject *args,
+					       PyObject *kwds);
+PyObject *drgnpy_linux_helper_task_table(PyObject *self, PyObject *args,
+					 PyObject *kwds);
+PyObject *drgnpy_linux_helper_task_files(PyObject *self, PyObject *args,
+					 PyObject *kwds);
+PyObject *drgnpy_linux_helper_d_path(PyObject *self, PyObject *args,
+				     PyObject *kwds);
+PyObject *drgnpy_linux_helper_dentry_path(PyObject *self, PyObject *args,
+					  PyObject *kwds);
+PyObject *drgnpy_linux_helper_cgroup_walk(PyObject *self, PyObject *args,
+					  PyObject *kwds);
+PyObject *drgnpy_linux_helper_socket_table(PyObject *self, PyObject *args,
+					   PyObject *kwds);
+PointerIndex *drgnpy_linux_helper_build_pointer_index(PyObject *self,
+						      PyObject *args,
+						      PyObject *kwds);
+PointerIndex *drgnpy_linux_helper_load_pointer_index(PyObject *self,
+						     PyObject *args,
+						     PyObject *kwds);
 
 #endif /* DRGNPY_H */
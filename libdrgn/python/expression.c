@@ -0,0 +1,201 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+#include "drgnpy.h"
+
+Expression *Program_compile_expression(Program *prog, const char *str,
+				       PyObject *params_obj)
+{
+	struct drgn_error *err;
+	Expression *ret;
+	const char **params;
+	Py_ssize_t num_params, i;
+	bool clear;
+
+	ret = (Expression *)Expression_type.tp_alloc(&Expression_type, 0);
+	if (!ret)
+		return NULL;
+	ret->prog = prog;
+	Py_INCREF(prog);
+	ret->params = PySequence_Tuple(params_obj);
+	if (!ret->params)
+		goto err;
+
+	num_params = PyTuple_GET_SIZE(ret->params);
+	params = malloc_array(num_params, sizeof(*params));
+	if (num_params && !params) {
+		PyErr_NoMemory();
+		goto err;
+	}
+	for (i = 0; i < num_params; i++) {
+		PyObject *param = PyTuple_GET_ITEM(ret->params, i);
+
+		if (!PyUnicode_Check(param)) {
+			PyErr_SetString(PyExc_TypeError,
+					"expression parameter must be str");
+			goto err_params;
+		}
+		params[i] = PyUnicode_AsUTF8(param);
+		if (!params[i])
+			goto err_params;
+	}
+
+	clear = set_drgn_in_python();
+	err = drgn_program_compile_expression(&prog->prog, str, params,
+					      num_params, &ret->expr);
+	if (clear)
+		clear_drgn_in_python();
+	free(params);
+	if (err) {
+		set_drgn_error(err);
+		goto err;
+	}
+	return ret;
+
+err_params:
+	free(params);
+err:
+	Py_DECREF(ret);
+	return NULL;
+}
+
+static void Expression_dealloc(Expression *self)
+{
+	drgn_expression_destroy(self->expr);
+	Py_XDECREF(self->params);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+ * Get the argument for parameter i from args or kwargs. Returns a borrowed
+ * reference.
+ */
+static PyObject *Expression_arg(Expression *self, Py_ssize_t i, PyObject *args,
+				PyObject *kwargs, Py_ssize_t *num_kwargs_used)
+{
+	PyObject *param = PyTuple_GET_ITEM(self->params, i);
+	PyObject *arg = NULL;
+
+	if (kwargs) {
+		arg = PyDict_GetItemWithError(kwargs, param);
+		if (!arg && PyErr_Occurred())
+			return NULL;
+	}
+	if (i < PyTuple_GET_SIZE(args)) {
+		if (arg) {
+			PyErr_Format(PyExc_TypeError,
+				     "expression got multiple values for argument %R",
+				     param);
+			return NULL;
+		}
+		return PyTuple_GET_ITEM(args, i);
+	}
+	if (!arg) {
+		PyErr_Format(PyExc_TypeError,
+			     "expression missing argument %R", param);
+		return NULL;
+	}
+	(*num_kwargs_used)++;
+	return arg;
+}
+
+static DrgnObject *Expression_call(Expression *self, PyObject *args,
+				   PyObject *kwargs)
+{
+	struct drgn_error *err;
+	Py_ssize_t num_params = PyTuple_GET_SIZE(self->params);
+	Py_ssize_t num_kwargs_used = 0, i;
+	struct drgn_object *tmps;
+	const struct drgn_object **objs;
+	DrgnObject *ret = NULL;
+	bool clear;
+
+	if (PyTuple_GET_SIZE(args) > num_params) {
+		PyErr_Format(PyExc_TypeError,
+			     "expression takes %zd arguments but %zd were given",
+			     num_params, PyTuple_GET_SIZE(args));
+		return NULL;
+	}
+
+	tmps = malloc_array(num_params, sizeof(*tmps));
+	objs = malloc_array(num_params, sizeof(*objs));
+	if (num_params && (!tmps || !objs)) {
+		free(objs);
+		free(tmps);
+		PyErr_NoMemory();
+		return NULL;
+	}
+	for (i = 0; i < num_params; i++)
+		drgn_object_init(&tmps[i], &self->prog->prog);
+
+	for (i = 0; i < num_params; i++) {
+		PyObject *arg;
+		int r;
+
+		arg = Expression_arg(self, i, args, kwargs, &num_kwargs_used);
+		if (!arg)
+			goto out;
+		if (PyObject_TypeCheck(arg, &DrgnObject_type)) {
+			objs[i] = &((DrgnObject *)arg)->obj;
+			continue;
+		}
+		r = DrgnObject_literal(&tmps[i], arg);
+		if (r < 0)
+			goto out;
+		if (r > 0) {
+			PyErr_Format(PyExc_TypeError,
+				     "expression argument must be Object, int, bool, or float, not '%s'",
+				     Py_TYPE(arg)->tp_name);
+			goto out;
+		}
+		objs[i] = &tmps[i];
+	}
+	if (kwargs && PyDict_Size(kwargs) > num_kwargs_used) {
+		PyErr_SetString(PyExc_TypeError,
+				"expression got an unexpected keyword argument");
+		goto out;
+	}
+
+	ret = DrgnObject_alloc(self->prog);
+	if (!ret)
+		goto out;
+	clear = set_drgn_in_python();
+	err = drgn_expression_evaluate(self->expr, objs, &ret->obj);
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		Py_DECREF(ret);
+		ret = set_drgn_error(err);
+	}
+
+out:
+	for (i = 0; i < num_params; i++)
+		drgn_object_deinit(&tmps[i]);
+	free(objs);
+	free(tmps);
+	return ret;
+}
+
+DRGNPY_LOCKED(DrgnObject *, NULL, Expression_call,
+	      (Expression *self, PyObject *args, PyObject *kwargs),
+	      (self, args, kwargs), self->prog)
+
+static PyMemberDef Expression_members[] = {
+	{"prog", T_OBJECT_EX, offsetof(Expression, prog), READONLY,
+	 drgn_Expression_prog_DOC},
+	{"params", T_OBJECT_EX, offsetof(Expression, params), READONLY,
+	 drgn_Expression_params_DOC},
+	{},
+};
+
+PyTypeObject Expression_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn.Expression",
+	.tp_basicsize = sizeof(Expression),
+	.tp_dealloc = (destructor)Expression_dealloc,
+	.tp_call = (ternaryfunc)Expression_call_locked,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = drgn_Expression_DOC,
+	.tp_members = Expression_members,
+};
@@ -29,8 +29,13 @@ PyObject *drgnpy_linux_helper_read_vm(PyObject *self, PyObject *args,
 	buf = PyBytes_FromStringAndSize(NULL, size);
 	if (!buf)
 		return NULL;
+	if (Program_lock(prog)) {
+		Py_DECREF(buf);
+		return NULL;
+	}
 	err = linux_helper_read_vm(&prog->prog, pgtable.uvalue, address.uvalue,
 				   PyBytes_AS_STRING(buf), size);
+	Program_unlock(prog);
 	if (err) {
 		Py_DECREF(buf);
 		return set_drgn_error(err);
@@ -56,8 +61,13 @@ DrgnObject *drgnpy_linux_helper_radix_tree_lookup(PyObject *self,
 	res = DrgnObject_alloc(DrgnObject_prog(root));
 	if (!res)
 		return NULL;
+	if (Program_lock(DrgnObject_prog(root))) {
+		Py_DECREF(res);
+		return NULL;
+	}
 	err = linux_helper_radix_tree_lookup(&res->obj, &root->obj,
 					     index.uvalue);
+	Program_unlock(DrgnObject_prog(root));
 	if (err) {
 		Py_DECREF(res);
 		return set_drgn_error(err);
@@ -82,7 +92,12 @@ DrgnObject *drgnpy_linux_helper_idr_find(PyObject *self, PyObject *args,
 	res = DrgnObject_alloc(DrgnObject_prog(idr));
 	if (!res)
 		return NULL;
+	if (Program_lock(DrgnObject_prog(idr))) {
+		Py_DECREF(res);
+		return NULL;
+	}
 	err = linux_helper_idr_find(&res->obj, &idr->obj, id.uvalue);
+	Program_unlock(DrgnObject_prog(idr));
 	if (err) {
 		Py_DECREF(res);
 		return set_drgn_error(err);
@@ -116,12 +131,15 @@ static int prog_or_pid_ns_converter(PyObject *o, void *p)
 
 		arg->prog = (Program *)o;
 		arg->ns = &arg->tmp;
+		if (Program_lock(arg->prog))
+			return 0;
 		drgn_object_init(arg->ns, &arg->prog->prog);
 		err = drgn_program_find_object(&arg->prog->prog, "init_pid_ns",
 					       NULL, DRGN_FIND_OBJECT_ANY,
 					       arg->ns);
 		if (!err)
 			err = drgn_object_address_of(arg->ns, arg->ns);
+		Program_unlock(arg->prog);
 		if (err) {
 			drgn_object_deinit(arg->ns);
 			set_drgn_error(err);
@@ -156,7 +174,12 @@ DrgnObject *drgnpy_linux_helper_find_pid(PyObject *self, PyObject *args,
 	res = DrgnObject_alloc(prog_or_ns.prog);
 	if (!res)
 		goto out;
+	if (Program_lock(prog_or_ns.prog)) {
+		Py_CLEAR(res);
+		goto out;
+	}
 	err = linux_helper_find_pid(&res->obj, prog_or_ns.ns, pid.uvalue);
+	Program_unlock(prog_or_ns.prog);
 	if (err) {
 		Py_DECREF(res);
 		set_drgn_error(err);
@@ -184,7 +207,12 @@ DrgnObject *drgnpy_linux_helper_pid_task(PyObject *self, PyObject *args,
 	res = DrgnObject_alloc(DrgnObject_prog(pid));
 	if (!res)
 		return NULL;
+	if (Program_lock(DrgnObject_prog(pid))) {
+		Py_DECREF(res);
+		return NULL;
+	}
 	err = linux_helper_pid_task(&res->obj, &pid->obj, pid_type.uvalue);
+	Program_unlock(DrgnObject_prog(pid));
 	if (err) {
 		Py_DECREF(res);
 		return set_drgn_error(err);
@@ -209,7 +237,12 @@ DrgnObject *drgnpy_linux_helper_find_task(PyObject *self, PyObject *args,
 	res = DrgnObject_alloc(prog_or_ns.prog);
 	if (!res)
 		goto out;
+	if (Program_lock(prog_or_ns.prog)) {
+		Py_CLEAR(res);
+		goto out;
+	}
 	err = linux_helper_find_task(&res->obj, prog_or_ns.ns, pid.uvalue);
+	Program_unlock(prog_or_ns.prog);
 	if (err) {
 		Py_DECREF(res);
 		set_drgn_error(err);
@@ -220,6 +253,36 @@ out:
 	return res;
 }
 
+DrgnObject *drgnpy_linux_helper_per_cpu_ptr(PyObject *self, PyObject *args,
+					    PyObject *kwds)
+{
+	static char *keywords[] = {"ptr", "cpu", NULL};
+	struct drgn_error *err;
+	DrgnObject *ptr;
+	struct index_arg cpu = {};
+	DrgnObject *res;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O&:per_cpu_ptr",
+					 keywords, &DrgnObject_type, &ptr,
+					 index_converter, &cpu))
+		return NULL;
+
+	res = DrgnObject_alloc(DrgnObject_prog(ptr));
+	if (!res)
+		return NULL;
+	if (Program_lock(DrgnObject_prog(ptr))) {
+		Py_DECREF(res);
+		return NULL;
+	}
+	err = linux_helper_per_cpu_ptr(&res->obj, &ptr->obj, cpu.uvalue);
+	Program_unlock(DrgnObject_prog(ptr));
+	if (err) {
+		Py_DECREF(res);
+		return set_drgn_error(err);
+	}
+	return res;
+}
+
 PyObject *drgnpy_linux_helper_kaslr_offset(PyObject *self, PyObject *args,
 					   PyObject *kwds)
 
@@ -252,3 +315,857 @@ PyObject *drgnpy_linux_helper_pgtable_l5_enabled(PyObject *self, PyObject *args,
 	else
 		Py_RETURN_FALSE;
 }
+
+static int page_field_converter(PyObject *o, void *p)
+{
+	struct linux_page_field *field = p;
+	int is_signed;
+	if (!PyArg_ParseTuple(o, "KbpK:page field", &field->offset,
+			      &field->size, &is_signed, &field->mask))
+		return 0;
+	field->is_signed = is_signed;
+	return 1;
+}
+
+PyObject *drgnpy_linux_helper_scan_pages(PyObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {
+		"vmemmap", "start_pfn", "end_pfn", "filters", "count_by", NULL,
+	};
+	struct drgn_error *err;
+	DrgnObject *vmemmap;
+	struct index_arg start_pfn = {};
+	struct index_arg end_pfn = {};
+	PyObject *filters_obj;
+	PyObject *count_by_obj = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O&O&O|O:scan_pages",
+					 keywords, &DrgnObject_type, &vmemmap,
+					 index_converter, &start_pfn,
+					 index_converter, &end_pfn,
+					 &filters_obj, &count_by_obj))
+		return NULL;
+
+	struct linux_page_field count_by;
+	if (count_by_obj != Py_None &&
+	    !page_field_converter(count_by_obj, &count_by))
+		return NULL;
+
+	PyObject *filters_seq = PySequence_Fast(filters_obj,
+						"filters must be a sequence");
+	if (!filters_seq)
+		return NULL;
+	size_t num_filters = PySequence_Fast_GET_SIZE(filters_seq);
+	struct linux_page_filter *filters =
+		malloc_array(num_filters ? num_filters : 1, sizeof(*filters));
+	if (!filters) {
+		Py_DECREF(filters_seq);
+		return PyErr_NoMemory();
+	}
+	for (size_t i = 0; i < num_filters; i++) {
+		PyObject *field_obj;
+		int op;
+		if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(filters_seq, i),
+				      "OiK:page filter", &field_obj, &op,
+				      &filters[i].value) ||
+		    !page_field_converter(field_obj, &filters[i].field)) {
+			free(filters);
+			Py_DECREF(filters_seq);
+			return NULL;
+		}
+		if (op < LINUX_PAGE_FILTER_EQ || op > LINUX_PAGE_FILTER_GE) {
+			PyErr_SetString(PyExc_ValueError,
+					"invalid page filter operator");
+			free(filters);
+			Py_DECREF(filters_seq);
+			return NULL;
+		}
+		filters[i].op = op;
+	}
+	Py_DECREF(filters_seq);
+
+	Program *prog = DrgnObject_prog(vmemmap);
+	uint64_t *pfns = NULL;
+	struct linux_page_count *counts = NULL;
+	size_t n;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		free(filters);
+		return NULL;
+	}
+	if (count_by_obj == Py_None) {
+		err = linux_helper_scan_pages(&vmemmap->obj, start_pfn.uvalue,
+					      end_pfn.uvalue, filters,
+					      num_filters, &pfns, &n);
+	} else {
+		err = linux_helper_count_pages(&vmemmap->obj, start_pfn.uvalue,
+					       end_pfn.uvalue, filters,
+					       num_filters, &count_by, &counts,
+					       &n);
+	}
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	free(filters);
+	if (err)
+		return set_drgn_error(err);
+
+	PyObject *ret = PyList_New(n);
+	if (!ret)
+		goto out;
+	for (size_t i = 0; i < n; i++) {
+		PyObject *item;
+		if (pfns) {
+			item = PyLong_FromUnsignedLongLong(pfns[i]);
+		} else {
+			item = Py_BuildValue("KK",
+					     (unsigned long long)counts[i].value,
+					     (unsigned long long)counts[i].count);
+		}
+		if (!item) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+out:
+	free(pfns);
+	free(counts);
+	return ret;
+}
+
+SlabCacheObjectIterator *
+drgnpy_linux_helper_slab_cache_objects(PyObject *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"slab_cache", "allocated", "free", NULL};
+	struct drgn_error *err;
+	DrgnObject *slab_cache;
+	int allocated = 1, free_objects = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "O!|pp:slab_cache_objects", keywords,
+					 &DrgnObject_type, &slab_cache,
+					 &allocated, &free_objects))
+		return NULL;
+
+	SlabCacheObjectIterator *ret =
+		(SlabCacheObjectIterator *)SlabCacheObjectIterator_type.tp_alloc(
+			&SlabCacheObjectIterator_type, 0);
+	if (!ret)
+		return NULL;
+	Program *prog = DrgnObject_prog(slab_cache);
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		ret->it = NULL;
+		Py_DECREF(ret);
+		return NULL;
+	}
+	err = linux_slab_cache_iterator_create(&slab_cache->obj, allocated,
+					       free_objects, &ret->it);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		ret->it = NULL;
+		Py_DECREF(ret);
+		return set_drgn_error(err);
+	}
+	ret->prog = prog;
+	Py_INCREF(prog);
+	return ret;
+}
+
+static void SlabCacheObjectIterator_dealloc(SlabCacheObjectIterator *self)
+{
+	if (self->it)
+		linux_slab_cache_iterator_destroy(self->it);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *SlabCacheObjectIterator_next(SlabCacheObjectIterator *self)
+{
+	if (self->index >= self->num_objects) {
+		struct drgn_error *err;
+		bool clear = set_drgn_in_python();
+		PyThreadState *save = Program_begin_allow_threads(self->prog);
+		if (!save) {
+			if (clear)
+				clear_drgn_in_python();
+			return NULL;
+		}
+		err = linux_slab_cache_iterator_next(self->it, &self->objects,
+						     &self->num_objects);
+		Program_end_allow_threads(self->prog, save);
+		if (clear)
+			clear_drgn_in_python();
+		if (err) {
+			self->num_objects = 0;
+			return set_drgn_error(err);
+		}
+		self->index = 0;
+		if (!self->num_objects)
+			return NULL;
+	}
+	return PyLong_FromUnsignedLongLong(self->objects[self->index++]);
+}
+
+PyTypeObject SlabCacheObjectIterator_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._SlabCacheObjectIterator",
+	.tp_basicsize = sizeof(SlabCacheObjectIterator),
+	.tp_dealloc = (destructor)SlabCacheObjectIterator_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_iter = PyObject_SelfIter,
+	.tp_iternext = (iternextfunc)SlabCacheObjectIterator_next,
+};
+
+PyObject *drgnpy_linux_helper_slab_object_info(PyObject *self, PyObject *args,
+					       PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "address", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct index_arg address = {};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O&:slab_object_info",
+					 keywords, &Program_type, &prog,
+					 index_converter, &address))
+		return NULL;
+
+	struct linux_slab_object_info info;
+	bool found;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
+	err = linux_helper_slab_object_info(&prog->prog, address.uvalue, &info,
+					    &found);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+	if (!found)
+		Py_RETURN_NONE;
+	return Py_BuildValue("KKKO", (unsigned long long)info.slab_cache,
+			     (unsigned long long)info.slab,
+			     (unsigned long long)info.address,
+			     info.allocated ? Py_True : Py_False);
+}
+
+static PyObject *task_column_to_list(const struct linux_task_column *column,
+				     size_t num_tasks)
+{
+	PyObject *list = PyList_New(num_tasks);
+	if (!list)
+		return NULL;
+	for (size_t i = 0; i < num_tasks; i++) {
+		PyObject *item;
+		if (!column->valid[i]) {
+			Py_INCREF(Py_None);
+			item = Py_None;
+		} else if (column->is_string) {
+			const char *s = column->strings + i * column->string_size;
+			const char *nul = memchr(s, 0, column->string_size);
+			item = PyBytes_FromStringAndSize(s,
+							 nul ? nul - s :
+							 column->string_size);
+		} else if (column->is_signed) {
+			item = PyLong_FromLongLong((int64_t)column->values[i]);
+		} else {
+			item = PyLong_FromUnsignedLongLong(column->values[i]);
+		}
+		if (!item) {
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, i, item);
+	}
+	return list;
+}
+
+PyObject *drgnpy_linux_helper_task_table(PyObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"ns", "fields", NULL};
+	struct drgn_error *err;
+	DrgnObject *ns;
+	PyObject *fields_obj;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O:task_table",
+					 keywords, &DrgnObject_type, &ns,
+					 &fields_obj))
+		return NULL;
+
+	PyObject *fields_seq = PySequence_Fast(fields_obj,
+					       "fields must be a sequence");
+	if (!fields_seq)
+		return NULL;
+	size_t num_fields = PySequence_Fast_GET_SIZE(fields_seq);
+	const char **fields = malloc_array(num_fields ? num_fields : 1,
+					   sizeof(*fields));
+	if (!fields) {
+		Py_DECREF(fields_seq);
+		return PyErr_NoMemory();
+	}
+	for (size_t i = 0; i < num_fields; i++) {
+		fields[i] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(fields_seq,
+								      i));
+		if (!fields[i]) {
+			free(fields);
+			Py_DECREF(fields_seq);
+			return NULL;
+		}
+	}
+
+	Program *prog = DrgnObject_prog(ns);
+	struct linux_task_table table;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		free(fields);
+		Py_DECREF(fields_seq);
+		return NULL;
+	}
+	err = linux_helper_task_table(&ns->obj, fields, num_fields, &table);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	free(fields);
+	Py_DECREF(fields_seq);
+	if (err)
+		return set_drgn_error(err);
+
+	PyObject *ret = NULL;
+	PyObject *tasks = PyList_New(table.num_tasks);
+	PyObject *columns = PyList_New(table.num_columns);
+	if (!tasks || !columns)
+		goto out;
+	for (size_t i = 0; i < table.num_tasks; i++) {
+		PyObject *item = PyLong_FromUnsignedLongLong(table.tasks[i]);
+		if (!item)
+			goto out;
+		PyList_SET_ITEM(tasks, i, item);
+	}
+	for (size_t i = 0; i < table.num_columns; i++) {
+		PyObject *column = task_column_to_list(&table.columns[i],
+						       table.num_tasks);
+		if (!column)
+			goto out;
+		PyList_SET_ITEM(columns, i, column);
+	}
+	ret = PyTuple_Pack(2, tasks, columns);
+out:
+	Py_XDECREF(columns);
+	Py_XDECREF(tasks);
+	linux_task_table_deinit(&table);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_task_files(PyObject *self, PyObject *args,
+					 PyObject *kwds)
+{
+	static char *keywords[] = {"task", NULL};
+	struct drgn_error *err;
+	DrgnObject *task;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:task_files",
+					 keywords, &DrgnObject_type, &task))
+		return NULL;
+
+	Program *prog = DrgnObject_prog(task);
+	struct linux_task_file *files;
+	size_t num_files;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
+	err = linux_helper_task_files(&task->obj, &files, &num_files);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+
+	PyObject *ret = PyList_New(num_files);
+	if (!ret)
+		goto out;
+	for (size_t i = 0; i < num_files; i++) {
+		PyObject *item = Py_BuildValue("KK",
+					       (unsigned long long)files[i].fd,
+					       (unsigned long long)files[i].file);
+		if (!item) {
+			Py_CLEAR(ret);
+			goto out;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+out:
+	free(files);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_d_path(PyObject *self, PyObject *args,
+				     PyObject *kwds)
+{
+	static char *keywords[] = {"vfsmnt", "dentry", NULL};
+	struct drgn_error *err;
+	DrgnObject *vfsmnt, *dentry;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O!:d_path", keywords,
+					 &DrgnObject_type, &vfsmnt,
+					 &DrgnObject_type, &dentry))
+		return NULL;
+	if (DrgnObject_prog(vfsmnt) != DrgnObject_prog(dentry)) {
+		PyErr_SetString(PyExc_ValueError,
+				"objects are from different programs");
+		return NULL;
+	}
+
+	Program *prog = DrgnObject_prog(dentry);
+	uint64_t vfsmnt_addr, dentry_addr;
+	char *path;
+	size_t len;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
+	err = drgn_object_read_unsigned(&vfsmnt->obj, &vfsmnt_addr);
+	if (!err)
+		err = drgn_object_read_unsigned(&dentry->obj, &dentry_addr);
+	if (!err) {
+		err = linux_helper_d_path(&prog->prog, vfsmnt_addr, dentry_addr,
+					  &path, &len);
+	}
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+	PyObject *ret = PyBytes_FromStringAndSize(path, len);
+	free(path);
+	return ret;
+}
+
+PyObject *drgnpy_linux_helper_dentry_path(PyObject *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"dentry", NULL};
+	struct drgn_error *err;
+	DrgnObject *dentry;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:dentry_path",
+					 keywords, &DrgnObject_type, &dentry))
+		return NULL;
+
+	Program *prog = DrgnObject_prog(dentry);
+	uint64_t dentry_addr;
+	char *path;
+	size_t len;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
+	err = drgn_object_read_unsigned(&dentry->obj, &dentry_addr);
+	if (!err) {
+		err = linux_helper_dentry_path(&prog->prog, dentry_addr, &path,
+					       &len);
+	}
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+	PyObject *ret = PyBytes_FromStringAndSize(path, len);
+	free(path);
+	return ret;
+}
+
+static PyObject *
+cgroup_counter_to_list(const struct linux_cgroup_counter *counter,
+		       size_t num_csses, bool totals)
+{
+	PyObject *list = PyList_New(num_csses);
+	if (!list)
+		return NULL;
+	for (size_t i = 0; i < num_csses; i++) {
+		PyObject *item;
+		uint64_t value = totals ? counter->totals[i] :
+			counter->values[i];
+		if (!totals && !counter->valid[i]) {
+			Py_INCREF(Py_None);
+			item = Py_None;
+		} else if (counter->is_signed) {
+			item = PyLong_FromLongLong((int64_t)value);
+		} else {
+			item = PyLong_FromUnsignedLongLong(value);
+		}
+		if (!item) {
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, i, item);
+	}
+	return list;
+}
+
+PyObject *drgnpy_linux_helper_cgroup_walk(PyObject *self, PyObject *args,
+					  PyObject *kwds)
+{
+	static char *keywords[] = {"css", "counters", "type", "member", NULL};
+	struct drgn_error *err;
+	DrgnObject *css;
+	PyObject *counters_obj;
+	const char *type_name, *member;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!Oss:cgroup_walk",
+					 keywords, &DrgnObject_type, &css,
+					 &counters_obj, &type_name, &member))
+		return NULL;
+
+	PyObject *counters_seq = PySequence_Fast(counters_obj,
+						 "counters must be a sequence");
+	if (!counters_seq)
+		return NULL;
+	size_t num_counters = PySequence_Fast_GET_SIZE(counters_seq);
+	const char **counters = malloc_array(num_counters ? num_counters : 1,
+					     sizeof(*counters));
+	if (!counters) {
+		Py_DECREF(counters_seq);
+		return PyErr_NoMemory();
+	}
+	for (size_t i = 0; i < num_counters; i++) {
+		counters[i] =
+			PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(counters_seq,
+								  i));
+		if (!counters[i]) {
+			free(counters);
+			Py_DECREF(counters_seq);
+			return NULL;
+		}
+	}
+
+	Program *prog = DrgnObject_prog(css);
+	struct linux_cgroup_walk walk;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		free(counters);
+		Py_DECREF(counters_seq);
+		return NULL;
+	}
+	err = linux_helper_cgroup_walk(&css->obj, type_name, member, counters,
+				       num_counters, &walk);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	free(counters);
+	Py_DECREF(counters_seq);
+	if (err)
+		return set_drgn_error(err);
+
+	PyObject *ret = NULL;
+	PyObject *csses = PyList_New(walk.num_csses);
+	PyObject *paths = PyList_New(walk.num_csses);
+	PyObject *values = PyList_New(walk.num_counters);
+	PyObject *totals = PyList_New(walk.num_counters);
+	if (!csses || !paths || !values || !totals)
+		goto out;
+	for (size_t i = 0; i < walk.num_csses; i++) {
+		PyObject *item = PyLong_FromUnsignedLongLong(walk.csses[i]);
+		if (!item)
+			goto out;
+		PyList_SET_ITEM(csses, i, item);
+		item = PyBytes_FromString(walk.paths + walk.path_offsets[i]);
+		if (!item)
+			goto out;
+		PyList_SET_ITEM(paths, i, item);
+	}
+	for (size_t i = 0; i < walk.num_counters; i++) {
+		PyObject *item = cgroup_counter_to_list(&walk.counters[i],
+							walk.num_csses, false);
+		if (!item)
+			goto out;
+		PyList_SET_ITEM(values, i, item);
+		item = cgroup_counter_to_list(&walk.counters[i],
+					      walk.num_csses, true);
+		if (!item)
+			goto out;
+		PyList_SET_ITEM(totals, i, item);
+	}
+	ret = PyTuple_Pack(4, csses, paths, values, totals);
+out:
+	Py_XDECREF(totals);
+	Py_XDECREF(values);
+	Py_XDECREF(paths);
+	Py_XDECREF(csses);
+	linux_cgroup_walk_deinit(&walk);
+	return ret;
+}
+
+static PyObject *socket_address(const struct linux_socket *socket,
+				 const uint8_t *addr)
+{
+	return PyBytes_FromStringAndSize((const char *)addr,
+					 socket->family == LINUX_AF_INET6 ?
+					 16 : 4);
+}
+
+PyObject *drgnpy_linux_helper_socket_table(PyObject *self, PyObject *args,
+					   PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "protocol", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	const char *protocol_name;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!s:socket_table",
+					 keywords, &Program_type, &prog,
+					 &protocol_name))
+		return NULL;
+
+	enum linux_socket_protocol protocol;
+	if (strcmp(protocol_name, "tcp") == 0) {
+		protocol = LINUX_SOCKET_TCP;
+	} else if (strcmp(protocol_name, "udp") == 0) {
+		protocol = LINUX_SOCKET_UDP;
+	} else {
+		return PyErr_Format(PyExc_ValueError,
+				    "unknown socket protocol '%s'",
+				    protocol_name);
+	}
+
+	struct linux_socket *sockets;
+	size_t num_sockets;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
+	err = linux_helper_socket_table(&prog->prog, protocol, &sockets,
+					&num_sockets);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+
+	enum { SK, FAMILY, STATE, SADDR, SPORT, DADDR, DPORT, INODE,
+	       NUM_COLUMNS };
+	PyObject *columns[NUM_COLUMNS] = {};
+	PyObject *ret = NULL;
+	for (int i = 0; i < NUM_COLUMNS; i++) {
+		columns[i] = PyList_New(num_sockets);
+		if (!columns[i])
+			goto out;
+	}
+	for (size_t i = 0; i < num_sockets; i++) {
+		const struct linux_socket *socket = &sockets[i];
+		PyObject *items[NUM_COLUMNS] = {
+			[SK] = PyLong_FromUnsignedLongLong(socket->sk),
+			[FAMILY] = PyLong_FromLong(socket->family),
+			[STATE] = PyLong_FromLong(socket->state),
+			[SADDR] = socket_address(socket, socket->saddr),
+			[SPORT] = PyLong_FromLong(socket->sport),
+			[DADDR] = socket_address(socket, socket->daddr),
+			[DPORT] = PyLong_FromLong(socket->dport),
+			[INODE] = PyLong_FromUnsignedLongLong(socket->inode),
+		};
+		bool failed = false;
+		for (int j = 0; j < NUM_COLUMNS; j++) {
+			if (items[j])
+				PyList_SET_ITEM(columns[j], i, items[j]);
+			else
+				failed = true;
+		}
+		if (failed)
+			goto out;
+	}
+	ret = PyTuple_New(NUM_COLUMNS);
+	if (!ret)
+		goto out;
+	for (int i = 0; i < NUM_COLUMNS; i++) {
+		PyTuple_SET_ITEM(ret, i, columns[i]);
+		columns[i] = NULL;
+	}
+out:
+	for (int i = 0; i < NUM_COLUMNS; i++)
+		Py_XDECREF(columns[i]);
+	free(sockets);
+	return ret;
+}
+
+static PointerIndex *PointerIndex_new(Program *prog,
+				      struct linux_pointer_index *index)
+{
+	PointerIndex *ret =
+		(PointerIndex *)PointerIndex_type.tp_alloc(&PointerIndex_type,
+							   0);
+	if (!ret) {
+		linux_pointer_index_destroy(index);
+		return NULL;
+	}
+	ret->prog = prog;
+	Py_INCREF(prog);
+	ret->index = index;
+	return ret;
+}
+
+PointerIndex *drgnpy_linux_helper_build_pointer_index(PyObject *self,
+						      PyObject *args,
+						      PyObject *kwds)
+{
+	static char *keywords[] = {"prog", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!:build_pointer_index",
+					 keywords, &Program_type, &prog))
+		return NULL;
+
+	struct linux_pointer_index *index;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
+	err = linux_pointer_index_create(&prog->prog, &index);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err)
+		return set_drgn_error(err);
+	return PointerIndex_new(prog, index);
+}
+
+PointerIndex *drgnpy_linux_helper_load_pointer_index(PyObject *self,
+						     PyObject *args,
+						     PyObject *kwds)
+{
+	static char *keywords[] = {"prog", "path", NULL};
+	struct drgn_error *err;
+	Program *prog;
+	struct path_arg path = {};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O&:load_pointer_index",
+					 keywords, &Program_type, &prog,
+					 path_converter, &path))
+		return NULL;
+
+	struct linux_pointer_index *index;
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(prog);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		path_cleanup(&path);
+		return NULL;
+	}
+	err = linux_pointer_index_load(&prog->prog, path.path, &index);
+	Program_end_allow_threads(prog, save);
+	if (clear)
+		clear_drgn_in_python();
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	return PointerIndex_new(prog, index);
+}
+
+static void PointerIndex_dealloc(PointerIndex *self)
+{
+	linux_pointer_index_destroy(self->index);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static Py_ssize_t PointerIndex_length(PointerIndex *self)
+{
+	return linux_pointer_index_size(self->index);
+}
+
+static PyObject *PointerIndex_find(PointerIndex *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"start", "end", NULL};
+	struct index_arg start = {}, end = {};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&:find", keywords,
+					 index_converter, &start,
+					 index_converter, &end))
+		return NULL;
+
+	const struct linux_pointer_ref *refs;
+	size_t num_refs;
+	linux_pointer_index_find(self->index, start.uvalue, end.uvalue, &refs,
+				 &num_refs);
+	PyObject *ret = PyList_New(num_refs);
+	if (!ret)
+		return NULL;
+	for (size_t i = 0; i < num_refs; i++) {
+		PyObject *item = Py_BuildValue("KK",
+					       (unsigned long long)refs[i].location,
+					       (unsigned long long)refs[i].value);
+		if (!item) {
+			Py_DECREF(ret);
+			return NULL;
+		}
+		PyList_SET_ITEM(ret, i, item);
+	}
+	return ret;
+}
+
+static PyObject *PointerIndex_save(PointerIndex *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:save", keywords,
+					 path_converter, &path))
+		return NULL;
+
+	PyThreadState *save = PyEval_SaveThread();
+	err = linux_pointer_index_save(self->index, path.path);
+	PyEval_RestoreThread(save);
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef PointerIndex_methods[] = {
+	{"find", (PyCFunction)PointerIndex_find, METH_VARARGS | METH_KEYWORDS},
+	{"save", (PyCFunction)PointerIndex_save, METH_VARARGS | METH_KEYWORDS},
+	{},
+};
+
+static PySequenceMethods PointerIndex_as_sequence = {
+	.sq_length = (lenfunc)PointerIndex_length,
+};
+
+PyTypeObject PointerIndex_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._PointerIndex",
+	.tp_basicsize = sizeof(PointerIndex),
+	.tp_dealloc = (destructor)PointerIndex_dealloc,
+	.tp_as_sequence = &PointerIndex_as_sequence,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_methods = PointerIndex_methods,
+};
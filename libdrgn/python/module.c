@@ -56,12 +56,21 @@ static PyObject *filename_matches(PyObject *self, PyObject *args,
 static PyObject *sizeof_(PyObject *self, PyObject *arg)
 {
 	struct drgn_error *err;
+	Program *prog;
 	uint64_t size;
 
 	if (PyObject_TypeCheck(arg, &DrgnType_type)) {
+		prog = DrgnType_prog((DrgnType *)arg);
+		if (Program_lock(prog))
+			return NULL;
 		err = drgn_type_sizeof(((DrgnType *)arg)->type, &size);
+		Program_unlock(prog);
 	} else if (PyObject_TypeCheck(arg, &DrgnObject_type)) {
+		prog = DrgnObject_prog((DrgnObject *)arg);
+		if (Program_lock(prog))
+			return NULL;
 		err = drgn_object_sizeof(&((DrgnObject *)arg)->obj, &size);
+		Program_unlock(prog);
 	} else {
 		return PyErr_Format(PyExc_TypeError,
 				    "expected Type or Object, not %s",
@@ -83,7 +92,11 @@ static PyObject *offsetof_(PyObject *self, PyObject *args, PyObject *kwds)
 					 &DrgnType_type, &type, &member))
 		return NULL;
 	uint64_t offset;
+	Program *prog = DrgnType_prog(type);
+	if (Program_lock(prog))
+		return NULL;
 	err = drgn_type_offsetof(type->type, member, &offset);
+	Program_unlock(prog);
 	if (err)
 		return set_drgn_error(err);
 	return PyLong_FromUnsignedLongLong(offset);
@@ -97,12 +110,11 @@ static PyMethodDef drgn_methods[] = {
 	{"sizeof", (PyCFunction)sizeof_, METH_O, drgn_sizeof_DOC},
 	{"offsetof", (PyCFunction)offsetof_, METH_VARARGS | METH_KEYWORDS,
 	 drgn_offsetof_DOC},
-	{"cast", (PyCFunction)cast, METH_VARARGS | METH_KEYWORDS,
-	 drgn_cast_DOC},
-	{"reinterpret", (PyCFunction)reinterpret, METH_VARARGS | METH_KEYWORDS,
+	{"cast", (PyCFunction)cast, DRGNPY_FASTCALL_FLAGS, drgn_cast_DOC},
+	{"reinterpret", (PyCFunction)reinterpret, DRGNPY_FASTCALL_FLAGS,
 	 drgn_reinterpret_DOC},
 	{"container_of", (PyCFunction)DrgnObject_container_of,
-	 METH_VARARGS | METH_KEYWORDS, drgn_container_of_DOC},
+	 DRGNPY_FASTCALL_FLAGS, drgn_container_of_DOC},
 	{"program_from_core_dump", (PyCFunction)program_from_core_dump,
 	 METH_VARARGS | METH_KEYWORDS, drgn_program_from_core_dump_DOC},
 	{"program_from_kernel", (PyCFunction)program_from_kernel,
@@ -122,12 +134,47 @@ static PyMethodDef drgn_methods[] = {
 	 METH_VARARGS | METH_KEYWORDS},
 	{"_linux_helper_find_task", (PyCFunction)drgnpy_linux_helper_find_task,
 	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_per_cpu_ptr",
+	 (PyCFunction)drgnpy_linux_helper_per_cpu_ptr,
+	 METH_VARARGS | METH_KEYWORDS},
 	{"_linux_helper_kaslr_offset",
 	 (PyCFunction)drgnpy_linux_helper_kaslr_offset,
 	 METH_VARARGS | METH_KEYWORDS},
 	{"_linux_helper_pgtable_l5_enabled",
 	 (PyCFunction)drgnpy_linux_helper_pgtable_l5_enabled,
 	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_scan_pages",
+	 (PyCFunction)drgnpy_linux_helper_scan_pages,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_slab_cache_objects",
+	 (PyCFunction)drgnpy_linux_helper_slab_cache_objects,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_slab_object_info",
+	 (PyCFunction)drgnpy_linux_helper_slab_object_info,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_task_table",
+	 (PyCFunction)drgnpy_linux_helper_task_table,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_task_files",
+	 (PyCFunction)drgnpy_linux_helper_task_files,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_d_path", (PyCFunction)drgnpy_linux_helper_d_path,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_dentry_path",
+	 (PyCFunction)drgnpy_linux_helper_dentry_path,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_cgroup_walk",
+	 (PyCFunction)drgnpy_linux_helper_cgroup_walk,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_socket_table",
+	 (PyCFunction)drgnpy_linux_helper_socket_table,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_build_pointer_index",
+	 (PyCFunction)drgnpy_linux_helper_build_pointer_index,
+	 METH_VARARGS | METH_KEYWORDS},
+	{"_linux_helper_load_pointer_index",
+	 (PyCFunction)drgnpy_linux_helper_load_pointer_index,
+	 METH_VARARGS | METH_KEYWORDS},
 	{},
 };
 
@@ -241,6 +288,11 @@ DRGNPY_PUBLIC PyMODINIT_FUNC PyInit__drgn(void)
 		goto err;
 	PyModule_AddObject(m, "OutOfBoundsError", OutOfBoundsError);
 
+	if (PyType_Ready(&Expression_type) < 0)
+		goto err;
+	Py_INCREF(&Expression_type);
+	PyModule_AddObject(m, "Expression", (PyObject *)&Expression_type);
+
 	if (PyType_Ready(&Language_type) < 0)
 		goto err;
 	Py_INCREF(&Language_type);
@@ -260,11 +312,20 @@ DRGNPY_PUBLIC PyMODINIT_FUNC PyInit__drgn(void)
 	if (PyType_Ready(&ObjectIterator_type) < 0)
 		goto err;
 
+	if (PyType_Ready(&MemorySearchIterator_type) < 0)
+		goto err;
+
 	if (PyType_Ready(&Platform_type) < 0)
 		goto err;
 	Py_INCREF(&Platform_type);
 	PyModule_AddObject(m, "Platform", (PyObject *)&Platform_type);
 
+	if (PyType_Ready(&SlabCacheObjectIterator_type) < 0)
+		goto err;
+
+	if (PyType_Ready(&PointerIndex_type) < 0)
+		goto err;
+
 	if (PyType_Ready(&Program_type) < 0)
 		goto err;
 	Py_INCREF(&Program_type);
@@ -12,7 +12,7 @@
 #include "../type.h"
 #include "../util.h"
 
-static int DrgnObject_literal(struct drgn_object *res, PyObject *literal)
+int DrgnObject_literal(struct drgn_object *res, PyObject *literal)
 {
 	struct drgn_error *err;
 
@@ -362,36 +362,21 @@ static int buffer_object_from_value(struct drgn_object *res,
 	return 0;
 }
 
-static DrgnObject *DrgnObject_new(PyTypeObject *subtype, PyObject *args,
-				  PyObject *kwds)
+static DrgnObject *DrgnObject_new_impl(Program *prog, PyObject *type_obj,
+					PyObject *value_obj,
+					struct index_arg *address_arg,
+					struct byteorder_arg *byteorder_arg,
+					struct index_arg *bit_offset_arg,
+					struct index_arg *bit_field_size_arg)
 {
-	static char *keywords[] = {
-		"prog", "type", "value", "address", "byteorder",
-		"bit_offset", "bit_field_size", NULL,
-	};
 	struct drgn_error *err;
-	Program *prog;
-	PyObject *type_obj = Py_None, *value_obj = Py_None;
-	struct index_arg address = { .allow_none = true, .is_none = true };
-	struct byteorder_arg byteorder = {
-		.allow_none = true,
-		.is_none = true,
-		.value = DRGN_PROGRAM_ENDIAN,
-	};
-	struct index_arg bit_offset = { .allow_none = true, .is_none = true };
-	struct index_arg bit_field_size = { .allow_none = true, .is_none = true };
+	struct index_arg address = *address_arg;
+	struct byteorder_arg byteorder = *byteorder_arg;
+	struct index_arg bit_offset = *bit_offset_arg;
+	struct index_arg bit_field_size = *bit_field_size_arg;
 	struct drgn_qualified_type qualified_type;
 	DrgnObject *obj;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|OO$O&O&O&O&:Object",
-					 keywords, &Program_type, &prog,
-					 &type_obj, &value_obj, index_converter,
-					 &address, byteorder_converter,
-					 &byteorder, index_converter,
-					 &bit_offset, index_converter,
-					 &bit_field_size))
-		return NULL;
-
 	if (Program_type_arg(prog, type_obj, true, &qualified_type) == -1)
 		return NULL;
 
@@ -568,6 +553,79 @@ err:
 	return NULL;
 }
 
+DRGNPY_LOCKED(DrgnObject *, NULL, DrgnObject_new_impl,
+	      (Program *prog, PyObject *type_obj, PyObject *value_obj,
+	       struct index_arg *address_arg,
+	       struct byteorder_arg *byteorder_arg,
+	       struct index_arg *bit_offset_arg,
+	       struct index_arg *bit_field_size_arg),
+	      (prog, type_obj, value_obj, address_arg, byteorder_arg,
+	       bit_offset_arg, bit_field_size_arg),
+	      prog)
+
+static const char * const DrgnObject_new_keywords[] = {
+	"prog", "type", "value", "address", "byteorder", "bit_offset",
+	"bit_field_size", NULL,
+};
+
+static drgnpy_arg_parser DrgnObject_new_parser = {
+	.format = "O!|OO$O&O&O&O&:Object",
+	.keywords = DrgnObject_new_keywords,
+};
+
+#define DRGNOBJECT_NEW_ARGS						\
+	Program *prog;							\
+	PyObject *type_obj = Py_None, *value_obj = Py_None;		\
+	struct index_arg address = { .allow_none = true, .is_none = true };	\
+	struct byteorder_arg byteorder = {				\
+		.allow_none = true,					\
+		.is_none = true,					\
+		.value = DRGN_PROGRAM_ENDIAN,				\
+	};								\
+	struct index_arg bit_offset = { .allow_none = true, .is_none = true };	\
+	struct index_arg bit_field_size = { .allow_none = true, .is_none = true }
+
+#define DRGNOBJECT_NEW_PARSE_ARGS					\
+	&Program_type, &prog, &type_obj, &value_obj, index_converter,	\
+	&address, byteorder_converter, &byteorder, index_converter,	\
+	&bit_offset, index_converter, &bit_field_size
+
+static DrgnObject *DrgnObject_new(PyTypeObject *subtype, PyObject *args,
+				  PyObject *kwds)
+{
+	DRGNOBJECT_NEW_ARGS;
+	if (!drgnpy_parse_tuple_and_keywords(args, kwds,
+					     &DrgnObject_new_parser,
+					     DRGNOBJECT_NEW_PARSE_ARGS))
+		return NULL;
+	return DrgnObject_new_impl_locked(prog, type_obj, value_obj, &address,
+					  &byteorder, &bit_offset,
+					  &bit_field_size);
+}
+
+#if PY_VERSION_HEX >= 0x03090000
+/*
+ * Calling a type object only uses vectorcall since Python 3.9. This skips
+ * creating the argument tuple and keyword argument dictionary for Object().
+ */
+static PyObject *DrgnObject_vectorcall(PyObject *type, PyObject *const *args,
+				       size_t nargsf, PyObject *kwnames)
+{
+	DRGNOBJECT_NEW_ARGS;
+	if (!drgnpy_parse_fastcall(args, PyVectorcall_NARGS(nargsf), kwnames,
+				   &DrgnObject_new_parser,
+				   DRGNOBJECT_NEW_PARSE_ARGS))
+		return NULL;
+	return (PyObject *)DrgnObject_new_impl_locked(prog, type_obj,
+						      value_obj, &address,
+						      &byteorder, &bit_offset,
+						      &bit_field_size);
+}
+#endif
+
+#undef DRGNOBJECT_NEW_PARSE_ARGS
+#undef DRGNOBJECT_NEW_ARGS
+
 static void DrgnObject_dealloc(DrgnObject *self)
 {
 	Py_DECREF(DrgnObject_prog(self));
@@ -933,11 +991,23 @@ out:
 static PyObject *DrgnObject_str(DrgnObject *self)
 {
 	struct drgn_error *err;
+	PyThreadState *save;
+	bool clear;
 	char *str;
 	PyObject *ret;
 
+	clear = set_drgn_in_python();
+	save = Program_begin_allow_threads(DrgnObject_prog(self));
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
 	err = drgn_format_object(&self->obj, SIZE_MAX,
 				 DRGN_FORMAT_OBJECT_PRETTY, &str);
+	Program_end_allow_threads(DrgnObject_prog(self), save);
+	if (clear)
+		clear_drgn_in_python();
 	if (err)
 		return set_drgn_error(err);
 
@@ -1001,6 +1071,8 @@ static PyObject *DrgnObject_format(DrgnObject *self, PyObject *args,
 	struct format_object_flag_arg name##_arg = { &flags, value };
 	FLAGS
 #undef X
+	PyThreadState *save;
+	bool clear;
 	char *str;
 	PyObject *ret;
 
@@ -1025,7 +1097,17 @@ static PyObject *DrgnObject_format(DrgnObject *self, PyObject *args,
 			return NULL;
 	}
 
+	clear = set_drgn_in_python();
+	save = Program_begin_allow_threads(DrgnObject_prog(self));
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
 	err = drgn_format_object(&self->obj, columns, flags, &str);
+	Program_end_allow_threads(DrgnObject_prog(self), save);
+	if (clear)
+		clear_drgn_in_python();
 	if (err)
 		return set_drgn_error(err);
 
@@ -1105,6 +1187,16 @@ static int DrgnObject_binary_operand(PyObject *self, PyObject *other,
 	}
 }
 
+/* At least one operand of a binary operator is a DrgnObject. */
+static Program *DrgnObject_binary_operand_prog(PyObject *left,
+					       PyObject *right)
+{
+	if (PyObject_TypeCheck(left, &DrgnObject_type))
+		return DrgnObject_prog((DrgnObject *)left);
+	else
+		return DrgnObject_prog((DrgnObject *)right);
+}
+
 #define DrgnObject_BINARY_OP(op)						\
 static PyObject *DrgnObject_##op(PyObject *left, PyObject *right)		\
 {										\
@@ -1148,7 +1240,10 @@ out:										\
 		Py_RETURN_NOTIMPLEMENTED;					\
 	else									\
 		return (PyObject *)res;						\
-}
+}										\
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_##op,				\
+	      (PyObject *left, PyObject *right), (left, right),		\
+	      DrgnObject_binary_operand_prog(left, right))
 DrgnObject_BINARY_OP(add)
 DrgnObject_BINARY_OP(sub)
 DrgnObject_BINARY_OP(mul)
@@ -1177,7 +1272,10 @@ static DrgnObject *DrgnObject_##op(DrgnObject *self)	\
 		return set_drgn_error(err);		\
 	}						\
 	return res;					\
-}
+}							\
+DRGNPY_LOCKED(DrgnObject *, NULL, DrgnObject_##op,	\
+	      (DrgnObject *self), (self),		\
+	      DrgnObject_prog(self))
 DrgnObject_UNARY_OP(pos)
 DrgnObject_UNARY_OP(neg)
 DrgnObject_UNARY_OP(not)
@@ -1389,7 +1487,9 @@ static PyObject *DrgnObject_##func(DrgnObject *self)			\
 	}								\
 	drgn_object_deinit_value(&self->obj, value);			\
 	return ret;							\
-}
+}									\
+DRGNPY_LOCKED_NOARGS(PyObject *, DrgnObject, DrgnObject_##func,	\
+		     DrgnObject_prog(self))
 DrgnObject_round_method(trunc)
 DrgnObject_round_method(floor)
 DrgnObject_round_method(ceil)
@@ -1427,16 +1527,18 @@ out:
 		Py_RETURN_RICHCOMPARE(cmp, 0, op);
 }
 
-static DrgnObject *DrgnObject_member(DrgnObject *self, PyObject *args,
-				     PyObject *kwds)
+static DrgnObject *DrgnObject_member(DrgnObject *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"name", NULL};
+	static const char * const keywords[] = {"name", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "s:member_",
+		.keywords = keywords,
+	};
 	struct drgn_error *err;
 	const char *name;
 	DrgnObject *res;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:member_", keywords,
-					 &name))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &name))
 		return NULL;
 
 	res = DrgnObject_alloc(DrgnObject_prog(self));
@@ -1672,6 +1774,43 @@ static PyObject *DrgnObject_dir(DrgnObject *self)
 	return dir;
 }
 
+/* Entry points which don't release the GIL. See Program_lock(). */
+DRGNPY_LOCKED_NOARGS(PyObject *, DrgnObject, DrgnObject_value,
+		     DrgnObject_prog(self))
+DRGNPY_LOCKED_NOARGS(PyObject *, DrgnObject, DrgnObject_string,
+		     DrgnObject_prog(self))
+DRGNPY_LOCKED_NOARGS(DrgnObject *, DrgnObject, DrgnObject_address_of,
+		     DrgnObject_prog(self))
+DRGNPY_LOCKED_NOARGS(DrgnObject *, DrgnObject, DrgnObject_read,
+		     DrgnObject_prog(self))
+DRGNPY_LOCKED_NOARGS(PyObject *, DrgnObject, DrgnObject_dir,
+		     DrgnObject_prog(self))
+DRGNPY_LOCKED_FASTCALL(DrgnObject *, DrgnObject, DrgnObject_member,
+		       DrgnObject_prog(self))
+DRGNPY_LOCKED_KEYWORDS(PyObject *, DrgnObject, DrgnObject_format,
+		       DrgnObject_prog(self))
+DRGNPY_LOCKED_KEYWORDS(PyObject *, DrgnObject, DrgnObject_round,
+		       DrgnObject_prog(self))
+DRGNPY_LOCKED(DrgnObject *, NULL, DrgnObject_subscript,
+	      (DrgnObject *self, PyObject *key), (self, key),
+	      DrgnObject_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_getattro,
+	      (DrgnObject *self, PyObject *attr_name), (self, attr_name),
+	      DrgnObject_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_richcompare,
+	      (PyObject *left, PyObject *right, int op), (left, right, op),
+	      DrgnObject_binary_operand_prog(left, right))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_repr, (DrgnObject *self), (self),
+	      DrgnObject_prog(self))
+DRGNPY_LOCKED(int, -1, DrgnObject_bool, (DrgnObject *self), (self),
+	      DrgnObject_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_int, (DrgnObject *self), (self),
+	      DrgnObject_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_float, (DrgnObject *self), (self),
+	      DrgnObject_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnObject_index, (DrgnObject *self), (self),
+	      DrgnObject_prog(self))
+
 static PyGetSetDef DrgnObject_getset[] = {
 	{"prog_", (getter)DrgnObject_get_prog, NULL, drgn_Object_prog__DOC},
 	{"type_", (getter)DrgnObject_get_type, NULL, drgn_Object_type__DOC},
@@ -1687,53 +1826,53 @@ static PyGetSetDef DrgnObject_getset[] = {
 };
 
 static PyMethodDef DrgnObject_methods[] = {
-	{"__getitem__", (PyCFunction)DrgnObject_subscript,
+	{"__getitem__", (PyCFunction)DrgnObject_subscript_locked,
 	 METH_O | METH_COEXIST, drgn_Object___getitem___DOC},
-	{"value_", (PyCFunction)DrgnObject_value, METH_NOARGS,
+	{"value_", (PyCFunction)DrgnObject_value_locked, METH_NOARGS,
 	 drgn_Object_value__DOC},
-	{"string_", (PyCFunction)DrgnObject_string, METH_NOARGS,
+	{"string_", (PyCFunction)DrgnObject_string_locked, METH_NOARGS,
 	 drgn_Object_string__DOC},
-	{"member_", (PyCFunction)DrgnObject_member,
-	 METH_VARARGS | METH_KEYWORDS, drgn_Object_member__DOC},
-	{"address_of_", (PyCFunction)DrgnObject_address_of, METH_NOARGS,
+	{"member_", (PyCFunction)DrgnObject_member_locked,
+	 DRGNPY_FASTCALL_FLAGS, drgn_Object_member__DOC},
+	{"address_of_", (PyCFunction)DrgnObject_address_of_locked, METH_NOARGS,
 	 drgn_Object_address_of__DOC},
-	{"read_", (PyCFunction)DrgnObject_read, METH_NOARGS,
+	{"read_", (PyCFunction)DrgnObject_read_locked, METH_NOARGS,
 	 drgn_Object_read__DOC},
-	{"format_", (PyCFunction)DrgnObject_format,
+	{"format_", (PyCFunction)DrgnObject_format_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Object_format__DOC},
-	{"__round__", (PyCFunction)DrgnObject_round,
+	{"__round__", (PyCFunction)DrgnObject_round_locked,
 	 METH_VARARGS | METH_KEYWORDS},
-	{"__trunc__", (PyCFunction)DrgnObject_trunc, METH_NOARGS},
-	{"__floor__", (PyCFunction)DrgnObject_floor, METH_NOARGS},
-	{"__ceil__", (PyCFunction)DrgnObject_ceil, METH_NOARGS},
-	{"__dir__", (PyCFunction)DrgnObject_dir, METH_NOARGS,
+	{"__trunc__", (PyCFunction)DrgnObject_trunc_locked, METH_NOARGS},
+	{"__floor__", (PyCFunction)DrgnObject_floor_locked, METH_NOARGS},
+	{"__ceil__", (PyCFunction)DrgnObject_ceil_locked, METH_NOARGS},
+	{"__dir__", (PyCFunction)DrgnObject_dir_locked, METH_NOARGS,
 "dir() implementation which includes structure, union, and class members."},
 	{},
 };
 
 static PyNumberMethods DrgnObject_as_number = {
-	.nb_add = (binaryfunc)DrgnObject_add,
-	.nb_subtract = (binaryfunc)DrgnObject_sub,
-	.nb_multiply = (binaryfunc)DrgnObject_mul,
-	.nb_remainder = (binaryfunc)DrgnObject_mod,
-	.nb_negative = (unaryfunc)DrgnObject_neg,
-	.nb_positive = (unaryfunc)DrgnObject_pos,
-	.nb_bool = (inquiry)DrgnObject_bool,
-	.nb_invert = (unaryfunc)DrgnObject_not,
-	.nb_lshift = (binaryfunc)DrgnObject_lshift,
-	.nb_rshift = (binaryfunc)DrgnObject_rshift,
-	.nb_and = (binaryfunc)DrgnObject_and,
-	.nb_xor = (binaryfunc)DrgnObject_xor,
-	.nb_or = (binaryfunc)DrgnObject_or,
-	.nb_int = (unaryfunc)DrgnObject_int,
-	.nb_float = (unaryfunc)DrgnObject_float,
-	.nb_true_divide = (binaryfunc)DrgnObject_div,
-	.nb_index = (unaryfunc)DrgnObject_index,
+	.nb_add = (binaryfunc)DrgnObject_add_locked,
+	.nb_subtract = (binaryfunc)DrgnObject_sub_locked,
+	.nb_multiply = (binaryfunc)DrgnObject_mul_locked,
+	.nb_remainder = (binaryfunc)DrgnObject_mod_locked,
+	.nb_negative = (unaryfunc)DrgnObject_neg_locked,
+	.nb_positive = (unaryfunc)DrgnObject_pos_locked,
+	.nb_bool = (inquiry)DrgnObject_bool_locked,
+	.nb_invert = (unaryfunc)DrgnObject_not_locked,
+	.nb_lshift = (binaryfunc)DrgnObject_lshift_locked,
+	.nb_rshift = (binaryfunc)DrgnObject_rshift_locked,
+	.nb_and = (binaryfunc)DrgnObject_and_locked,
+	.nb_xor = (binaryfunc)DrgnObject_xor_locked,
+	.nb_or = (binaryfunc)DrgnObject_or_locked,
+	.nb_int = (unaryfunc)DrgnObject_int_locked,
+	.nb_float = (unaryfunc)DrgnObject_float_locked,
+	.nb_true_divide = (binaryfunc)DrgnObject_div_locked,
+	.nb_index = (unaryfunc)DrgnObject_index_locked,
 };
 
 static PyMappingMethods DrgnObject_as_mapping = {
 	.mp_length = (lenfunc)DrgnObject_length,
-	.mp_subscript = (binaryfunc)DrgnObject_subscript,
+	.mp_subscript = (binaryfunc)DrgnObject_subscript_locked,
 };
 
 PyTypeObject DrgnObject_type = {
@@ -1741,18 +1880,21 @@ PyTypeObject DrgnObject_type = {
 	.tp_name = "_drgn.Object",
 	.tp_basicsize = sizeof(DrgnObject),
 	.tp_dealloc = (destructor)DrgnObject_dealloc,
-	.tp_repr = (reprfunc)DrgnObject_repr,
+	.tp_repr = (reprfunc)DrgnObject_repr_locked,
 	.tp_as_number = &DrgnObject_as_number,
 	.tp_as_mapping = &DrgnObject_as_mapping,
 	.tp_str = (reprfunc)DrgnObject_str,
-	.tp_getattro = (getattrofunc)DrgnObject_getattro,
+	.tp_getattro = (getattrofunc)DrgnObject_getattro_locked,
 	.tp_flags = Py_TPFLAGS_DEFAULT,
 	.tp_doc = drgn_Object_DOC,
-	.tp_richcompare = DrgnObject_richcompare,
+	.tp_richcompare = DrgnObject_richcompare_locked,
 	.tp_iter = (getiterfunc)DrgnObject_iter,
 	.tp_methods = DrgnObject_methods,
 	.tp_getset = DrgnObject_getset,
 	.tp_new = (newfunc)DrgnObject_new,
+#if PY_VERSION_HEX >= 0x03090000
+	.tp_vectorcall = DrgnObject_vectorcall,
+#endif
 };
 
 PyObject *DrgnObject_NULL(PyObject *self, PyObject *args, PyObject *kwds)
@@ -1779,37 +1921,51 @@ PyObject *DrgnObject_NULL(PyObject *self, PyObject *args, PyObject *kwds)
 	return ret;
 }
 
-DrgnObject *cast(PyObject *self, PyObject *args, PyObject *kwds)
+DrgnObject *cast(PyObject *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"type", "obj", NULL};
+	static const char * const keywords[] = {"type", "obj", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "OO!:cast",
+		.keywords = keywords,
+	};
 	struct drgn_error *err;
 	struct drgn_qualified_type qualified_type;
 	PyObject *type_obj;
 	DrgnObject *obj, *res;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO!:cast", keywords,
-					 &type_obj, &DrgnObject_type, &obj))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &type_obj,
+				   &DrgnObject_type, &obj))
 		return NULL;
 
-	if (Program_type_arg(DrgnObject_prog(obj), type_obj, false,
-			     &qualified_type) == -1)
+	Program *prog = DrgnObject_prog(obj);
+	if (Program_lock(prog))
 		return NULL;
+	if (Program_type_arg(prog, type_obj, false, &qualified_type) == -1) {
+		res = NULL;
+		goto out;
+	}
 
-	res = DrgnObject_alloc(DrgnObject_prog(obj));
+	res = DrgnObject_alloc(prog);
 	if (!res)
-		return NULL;
+		goto out;
 
 	err = drgn_object_cast(&res->obj, qualified_type, &obj->obj);
 	if (err) {
 		Py_DECREF(res);
-		return set_drgn_error(err);
+		res = set_drgn_error(err);
 	}
+out:
+	Program_unlock(prog);
 	return res;
 }
 
-DrgnObject *reinterpret(PyObject *self, PyObject *args, PyObject *kwds)
+DrgnObject *reinterpret(PyObject *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"type", "obj", "byteorder", NULL};
+	static const char * const keywords[] = {"type", "obj", "byteorder", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "OO!|O&:reinterpret",
+		.keywords = keywords,
+	};
 	struct drgn_error *err;
 	PyObject *type_obj;
 	struct drgn_qualified_type qualified_type;
@@ -1820,58 +1976,72 @@ DrgnObject *reinterpret(PyObject *self, PyObject *args, PyObject *kwds)
 	};
 	DrgnObject *obj, *res;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO!|O&:reinterpret",
-					 keywords, &type_obj, &DrgnObject_type,
-					 &obj, byteorder_converter,
-					 &byteorder))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &type_obj,
+				   &DrgnObject_type, &obj, byteorder_converter,
+				   &byteorder))
 		return NULL;
 
-	if (Program_type_arg(DrgnObject_prog(obj), type_obj, false,
-			     &qualified_type) == -1)
+	Program *prog = DrgnObject_prog(obj);
+	if (Program_lock(prog))
 		return NULL;
+	if (Program_type_arg(prog, type_obj, false, &qualified_type) == -1) {
+		res = NULL;
+		goto out;
+	}
 
-	res = DrgnObject_alloc(DrgnObject_prog(obj));
+	res = DrgnObject_alloc(prog);
 	if (!res)
-		return NULL;
+		goto out;
 
 	err = drgn_object_reinterpret(&res->obj, qualified_type,
 				      byteorder.value, &obj->obj);
 	if (err) {
 		Py_DECREF(res);
-		return set_drgn_error(err);
+		res = set_drgn_error(err);
 	}
+out:
+	Program_unlock(prog);
 	return res;
 }
 
-DrgnObject *DrgnObject_container_of(PyObject *self, PyObject *args,
-				    PyObject *kwds)
+DrgnObject *DrgnObject_container_of(PyObject *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"ptr", "type", "member", NULL};
+	static const char * const keywords[] = {"ptr", "type", "member", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "O!Os:container_of",
+		.keywords = keywords,
+	};
 	struct drgn_error *err;
 	DrgnObject *obj, *res;
 	PyObject *type_obj;
 	struct drgn_qualified_type qualified_type;
 	const char *member_designator;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!Os:container_of",
-					 keywords, &DrgnObject_type, &obj,
-					 &type_obj, &member_designator))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser,
+				   &DrgnObject_type, &obj, &type_obj,
+				   &member_designator))
 		return NULL;
 
-	if (Program_type_arg(DrgnObject_prog(obj), type_obj, false,
-			     &qualified_type) == -1)
+	Program *prog = DrgnObject_prog(obj);
+	if (Program_lock(prog))
 		return NULL;
+	if (Program_type_arg(prog, type_obj, false, &qualified_type) == -1) {
+		res = NULL;
+		goto out;
+	}
 
-	res = DrgnObject_alloc(DrgnObject_prog(obj));
+	res = DrgnObject_alloc(prog);
 	if (!res)
-		return NULL;
+		goto out;
 
 	err = drgn_object_container_of(&res->obj, &obj->obj, qualified_type,
 				       member_designator);
 	if (err) {
 		Py_DECREF(res);
-		return set_drgn_error(err);
+		res = set_drgn_error(err);
 	}
+out:
+	Program_unlock(prog);
 	return res;
 }
 
@@ -1885,7 +2055,12 @@ static DrgnObject *ObjectIterator_next(ObjectIterator *self)
 {
 	if (self->index >= self->length)
 		return NULL;
-	return DrgnObject_subscript_impl(self->obj, self->index++);
+	Program *prog = DrgnObject_prog(self->obj);
+	if (Program_lock(prog))
+		return NULL;
+	DrgnObject *ret = DrgnObject_subscript_impl(self->obj, self->index++);
+	Program_unlock(prog);
+	return ret;
 }
 
 static PyObject *ObjectIterator_length_hint(ObjectIterator *self)
@@ -2,13 +2,142 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include "drgnpy.h"
+#include "../error.h"
 #include "../hash_table.h"
 #include "../program.h"
+#include "../type.h"
 #include "../vector.h"
 #include "../util.h"
 
 DEFINE_HASH_TABLE_FUNCTIONS(pyobjectp_set, ptr_key_hash_pair, scalar_key_eq)
 
+/*
+ * Number of nested drgnpy_gilstate_ensure() calls on this thread if it is a
+ * libdrgn worker thread (i.e., it had no Python thread state when the
+ * outermost callback started), 0 otherwise.
+ */
+static __thread unsigned int drgnpy_worker_depth;
+
+PyGILState_STATE drgnpy_gilstate_ensure(void)
+{
+	if (drgnpy_worker_depth || !PyGILState_GetThisThreadState())
+		drgnpy_worker_depth++;
+	return PyGILState_Ensure();
+}
+
+void drgnpy_gilstate_release(PyGILState_STATE state)
+{
+	PyGILState_Release(state);
+	if (drgnpy_worker_depth)
+		drgnpy_worker_depth--;
+}
+
+/*
+ * A callback running on a libdrgn worker thread must not wait for a program
+ * lock held by another thread: that thread may be the one waiting for the
+ * worker to finish. The GIL must be held.
+ */
+static int Program_check_lock(Program *prog, unsigned long ident)
+{
+	unsigned long owner = __atomic_load_n(&prog->lock_owner,
+					      __ATOMIC_RELAXED);
+	if (drgnpy_worker_depth && owner && owner != ident) {
+		PyErr_SetString(PyExc_RuntimeError,
+				"program cannot be used from a callback on a worker thread while it is in use by another thread");
+		return -1;
+	}
+	return 0;
+}
+
+static void Program_acquire_lock(Program *prog, unsigned long ident,
+				 bool have_gil)
+{
+	/*
+	 * Only this thread can have set lock_owner to ident, so if it reads
+	 * ident, it already holds the lock.
+	 */
+	if (__atomic_load_n(&prog->lock_owner, __ATOMIC_RELAXED) == ident) {
+		prog->lock_count++;
+		return;
+	}
+	if (!have_gil) {
+		PyThread_acquire_lock(prog->lock, WAIT_LOCK);
+	} else if (!PyThread_acquire_lock(prog->lock, NOWAIT_LOCK)) {
+		Py_BEGIN_ALLOW_THREADS
+		PyThread_acquire_lock(prog->lock, WAIT_LOCK);
+		Py_END_ALLOW_THREADS
+	}
+	__atomic_store_n(&prog->lock_owner, ident, __ATOMIC_RELAXED);
+	prog->lock_count = 1;
+}
+
+/*
+ * libdrgn programs are not thread-safe, so every call into libdrgn on a
+ * program must be made with the program's lock held. The lock is recursive so
+ * that a Python callback (e.g., a memory reader or finder) may call back into
+ * the same program.
+ *
+ * Entry points which hold the GIL for the whole call take the lock with
+ * Program_lock() and Program_unlock(), usually through a wrapper defined with
+ * DRGNPY_LOCKED(). If another thread holds the lock, the GIL is released while
+ * waiting for it, so a thread waiting for the lock never blocks a callback
+ * waiting for the GIL.
+ *
+ * Some libdrgn calls run callbacks on worker threads. Such a callback can't
+ * use the program that the call was made on, since the calling thread holds
+ * its lock. Program_lock() raises RuntimeError and returns -1 in that case
+ * instead of waiting forever. It returns 0 on success.
+ */
+int Program_lock(Program *prog)
+{
+	unsigned long ident = PyThread_get_thread_ident();
+	if (Program_check_lock(prog, ident))
+		return -1;
+	Program_acquire_lock(prog, ident, true);
+	return 0;
+}
+
+void Program_unlock(Program *prog)
+{
+	if (--prog->lock_count == 0) {
+		__atomic_store_n(&prog->lock_owner, 0, __ATOMIC_RELAXED);
+		PyThread_release_lock(prog->lock);
+	}
+}
+
+/*
+ * Release the GIL before a potentially long-running libdrgn call on a program.
+ * This must be paired with Program_end_allow_threads():
+ *
+ *	save = Program_begin_allow_threads(prog);
+ *	if (!save)
+ *		return NULL;
+ *	err = drgn_program_foo(&prog->prog, ...);
+ *	Program_end_allow_threads(prog, save);
+ *
+ * The call must not touch any Python objects other than through callbacks,
+ * which acquire the GIL themselves. The program lock is held for the duration
+ * of the call. It is taken after the GIL is released for the same reason as in
+ * Program_lock(). Like Program_lock(), this fails if it is called from a
+ * callback on a worker thread while another thread holds the lock, in which
+ * case it returns NULL with an exception set and the GIL still held.
+ */
+PyThreadState *Program_begin_allow_threads(Program *prog)
+{
+	unsigned long ident = PyThread_get_thread_ident();
+	if (Program_check_lock(prog, ident))
+		return NULL;
+	PyThreadState *save = PyEval_SaveThread();
+	Program_acquire_lock(prog, ident, false);
+	return save;
+}
+
+void Program_end_allow_threads(Program *prog, PyThreadState *save)
+{
+	Program_unlock(prog);
+	PyEval_RestoreThread(save);
+}
+
 int Program_hold_object(Program *prog, PyObject *obj)
 {
 	if (pyobjectp_set_insert(&prog->objects, &obj, NULL) == -1)
@@ -84,12 +213,21 @@ static Program *Program_new(PyTypeObject *subtype, PyObject *args,
 	if (!cache)
 		return NULL;
 
+	PyThread_type_lock lock = PyThread_allocate_lock();
+	if (!lock) {
+		Py_DECREF(cache);
+		PyErr_NoMemory();
+		return NULL;
+	}
+
 	Program *prog = (Program *)Program_type.tp_alloc(&Program_type, 0);
 	if (!prog) {
+		PyThread_free_lock(lock);
 		Py_DECREF(cache);
 		return NULL;
 	}
 	prog->cache = cache;
+	prog->lock = lock;
 	pyobjectp_set_init(&prog->objects);
 	drgn_program_init(&prog->prog, platform);
 	return prog;
@@ -104,6 +242,8 @@ static void Program_dealloc(Program *self)
 		Py_DECREF(*it.entry);
 	pyobjectp_set_deinit(&self->objects);
 	Py_XDECREF(self->cache);
+	if (self->lock)
+		PyThread_free_lock(self->lock);
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -138,7 +278,7 @@ static struct drgn_error *py_memory_read_fn(void *buf, uint64_t address,
 	PyObject *ret;
 	Py_buffer view;
 
-	gstate = PyGILState_Ensure();
+	gstate = drgnpy_gilstate_ensure();
 	ret = PyObject_CallFunction(arg, "KKKO", (unsigned long long)address,
 				    (unsigned long long)count,
 				    (unsigned long long)offset,
@@ -166,7 +306,7 @@ out_view:
 out_ret:
 	Py_DECREF(ret);
 out:
-	PyGILState_Release(gstate);
+	drgnpy_gilstate_release(gstate);
 	return err;
 }
 
@@ -214,7 +354,7 @@ static struct drgn_error *py_type_find_fn(enum drgn_type_kind kind,
 	PyObject *kind_obj, *name_obj;
 	PyObject *type_obj;
 
-	gstate = PyGILState_Ensure();
+	gstate = drgnpy_gilstate_ensure();
 	kind_obj = PyObject_CallFunction(TypeKind_class, "k", kind);
 	if (!kind_obj) {
 		err = drgn_error_from_python();
@@ -264,7 +404,7 @@ out_name_obj:
 out_kind_obj:
 	Py_DECREF(kind_obj);
 out_gstate:
-	PyGILState_Release(gstate);
+	drgnpy_gilstate_release(gstate);
 	return err;
 }
 
@@ -309,7 +449,7 @@ static struct drgn_error *py_object_find_fn(const char *name, size_t name_len,
 	PyObject *name_obj, *flags_obj;
 	PyObject *obj;
 
-	gstate = PyGILState_Ensure();
+	gstate = drgnpy_gilstate_ensure();
 	name_obj = PyUnicode_FromStringAndSize(name, name_len);
 	if (!name_obj) {
 		err = drgn_error_from_python();
@@ -347,7 +487,7 @@ out_flags_obj:
 out_name_obj:
 	Py_DECREF(name_obj);
 out_gstate:
-	PyGILState_Release(gstate);
+	drgnpy_gilstate_release(gstate);
 	return err;
 }
 
@@ -493,8 +633,19 @@ static PyObject *Program_load_debug_info(Program *self, PyObject *args,
 		for (size_t i = 0; i < path_args.size; i++)
 			paths[i] = path_args.data[i].path;
 	}
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		free(paths);
+		goto out;
+	}
 	err = drgn_program_load_debug_info(&self->prog, paths, path_args.size,
 					   load_default, load_main);
+	Program_end_allow_threads(self, save);
+	if (clear)
+		clear_drgn_in_python();
 	free(paths);
 	if (err)
 		set_drgn_error(err);
@@ -511,27 +662,74 @@ out:
 static PyObject *Program_load_default_debug_info(Program *self)
 {
 	struct drgn_error *err;
+	PyThreadState *save;
+	bool clear;
 
+	clear = set_drgn_in_python();
+	save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		return NULL;
+	}
 	err = drgn_program_load_debug_info(&self->prog, NULL, 0, true, true);
+	Program_end_allow_threads(self, save);
+	if (clear)
+		clear_drgn_in_python();
 	if (err)
 		return set_drgn_error(err);
 	Py_RETURN_NONE;
 }
 
-static PyObject *Program_read(Program *self, PyObject *args, PyObject *kwds)
+static PyObject *Program_load_btf(Program *self, PyObject *args,
+				  PyObject *kwds)
 {
-	static char *keywords[] = {"address", "size", "physical", NULL};
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = { .allow_none = true };
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O&:load_btf", keywords,
+					 path_converter, &path))
+		return NULL;
+
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		path_cleanup(&path);
+		return NULL;
+	}
+	err = drgn_program_load_btf(&self->prog, path.path);
+	Program_end_allow_threads(self, save);
+	if (clear)
+		clear_drgn_in_python();
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_read(Program *self, DRGNPY_FASTCALL_ARGS)
+{
+	static const char * const keywords[] = {
+		"address", "size", "physical", NULL,
+	};
+	static drgnpy_arg_parser parser = {
+		.format = "O&n|p:read",
+		.keywords = keywords,
+	};
 	struct drgn_error *err;
 	struct index_arg address = {};
 	Py_ssize_t size;
 	int physical = 0;
 	PyObject *buf;
+	PyThreadState *save;
 	bool clear;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&n|p:read", keywords,
-					 index_converter, &address, &size,
-					 &physical))
-	    return NULL;
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser,
+				   index_converter, &address, &size,
+				   &physical))
+		return NULL;
 
 	if (size < 0) {
 		PyErr_SetString(PyExc_ValueError, "negative size");
@@ -541,8 +739,16 @@ static PyObject *Program_read(Program *self, PyObject *args, PyObject *kwds)
 	if (!buf)
 		return NULL;
 	clear = set_drgn_in_python();
+	save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		Py_DECREF(buf);
+		return NULL;
+	}
 	err = drgn_program_read_memory(&self->prog, PyBytes_AS_STRING(buf),
 				       address.uvalue, size, physical);
+	Program_end_allow_threads(self, save);
 	if (clear)
 		clear_drgn_in_python();
 	if (err) {
@@ -552,19 +758,125 @@ static PyObject *Program_read(Program *self, PyObject *args, PyObject *kwds)
 	return buf;
 }
 
+static MemorySearchIterator *Program_search_memory(Program *self,
+						   PyObject *args,
+						   PyObject *kwds)
+{
+	static char *keywords[] = {
+		"pattern", "mask", "align", "physical", "start", "end", NULL,
+	};
+	struct drgn_error *err;
+	Py_buffer pattern, mask = {};
+	struct index_arg align = { .uvalue = 1 };
+	int physical = 0;
+	struct index_arg start = {};
+	struct index_arg end = { .allow_none = true, .is_none = true };
+	if (!PyArg_ParseTupleAndKeywords(args, kwds,
+					 "y*|z*$O&pO&O&:search_memory",
+					 keywords, &pattern, &mask,
+					 index_converter, &align, &physical,
+					 index_converter, &start,
+					 index_converter, &end))
+		return NULL;
+
+	MemorySearchIterator *ret = NULL;
+	if (mask.buf && mask.len != pattern.len) {
+		PyErr_SetString(PyExc_ValueError,
+				"mask must be the same length as pattern");
+		goto out;
+	}
+	uint64_t min_address = start.uvalue, max_address = UINT64_MAX;
+	if (!end.is_none) {
+		if (end.uvalue <= start.uvalue) {
+			/* Empty range. */
+			min_address = 1;
+			max_address = 0;
+		} else {
+			max_address = end.uvalue - 1;
+		}
+	}
+
+	ret = (MemorySearchIterator *)MemorySearchIterator_type.tp_alloc(
+		&MemorySearchIterator_type, 0);
+	if (!ret)
+		goto out;
+	err = drgn_program_search_memory(&self->prog, pattern.buf, mask.buf,
+					 pattern.len, align.uvalue,
+					 min_address, max_address, physical,
+					 &ret->it);
+	if (err) {
+		ret->it = NULL;
+		Py_CLEAR(ret);
+		set_drgn_error(err);
+		goto out;
+	}
+	ret->prog = self;
+	Py_INCREF(self);
+out:
+	if (mask.buf)
+		PyBuffer_Release(&mask);
+	PyBuffer_Release(&pattern);
+	return ret;
+}
+
+static PyObject *Program_start_recording(Program *self)
+{
+	struct drgn_error *err = drgn_program_start_recording(&self->prog);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_stop_recording(Program *self)
+{
+	drgn_program_stop_recording(&self->prog);
+	Py_RETURN_NONE;
+}
+
+static PyObject *Program_write_minicore(Program *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"path", NULL};
+	struct drgn_error *err;
+	struct path_arg path = {};
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&:write_minicore",
+					 keywords, path_converter, &path))
+		return NULL;
+
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		path_cleanup(&path);
+		return NULL;
+	}
+	err = drgn_program_write_minicore(&self->prog, path.path);
+	Program_end_allow_threads(self, save);
+	if (clear)
+		clear_drgn_in_python();
+	path_cleanup(&path);
+	if (err)
+		return set_drgn_error(err);
+	Py_RETURN_NONE;
+}
+
 #define METHOD_READ(x, type)							\
-static PyObject *Program_read_##x(Program *self, PyObject *args,		\
-				  PyObject *kwds)				\
+static PyObject *Program_read_##x(Program *self, DRGNPY_FASTCALL_ARGS)		\
 {										\
-	static char *keywords[] = {"address", "physical", NULL};		\
+	static const char * const keywords[] = {"address", "physical", NULL};	\
+	static drgnpy_arg_parser parser = {						\
+		.format = "O&|p:read_"#x,					\
+		.keywords = keywords,						\
+	};									\
 	struct drgn_error *err;							\
 	struct index_arg address = {};						\
 	int physical = 0;							\
 	type tmp;								\
 										\
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p:read_"#x, keywords,	\
-					 index_converter, &address, &physical))	\
-	    return NULL;							\
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser,		\
+				   index_converter, &address, &physical))	\
+		return NULL;							\
 										\
 	err = drgn_program_read_##x(&self->prog, address.uvalue, physical,	\
 				    &tmp);					\
@@ -582,22 +894,35 @@ METHOD_READ(u64, uint64_t)
 METHOD_READ(word, uint64_t)
 #undef METHOD_READ
 
-static PyObject *Program_find_type(Program *self, PyObject *args, PyObject *kwds)
+static PyObject *Program_find_type(Program *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"name", "filename", NULL};
+	static const char * const keywords[] = {"name", "filename", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "s|O&:type",
+		.keywords = keywords,
+	};
 	struct drgn_error *err;
 	const char *name;
 	struct path_arg filename = {.allow_none = true};
 	struct drgn_qualified_type qualified_type;
+	PyThreadState *save;
 	bool clear;
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:type", keywords,
-					 &name, path_converter, &filename))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &name,
+				   path_converter, &filename))
 		return NULL;
 
 	clear = set_drgn_in_python();
+	save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		path_cleanup(&filename);
+		return NULL;
+	}
 	err = drgn_program_find_type(&self->prog, name, filename.path,
 				     &qualified_type);
+	Program_end_allow_threads(self, save);
 	if (clear)
 		clear_drgn_in_python();
 	path_cleanup(&filename);
@@ -631,10 +956,15 @@ static DrgnObject *Program_find_object(Program *self, const char *name,
 	return ret;
 }
 
-static DrgnObject *Program_object(Program *self, PyObject *args,
-				  PyObject *kwds)
+static DrgnObject *Program_object(Program *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"name", "flags", "filename", NULL};
+	static const char * const keywords[] = {
+		"name", "flags", "filename", NULL,
+	};
+	static drgnpy_arg_parser parser = {
+		.format = "s|O&O&:object",
+		.keywords = keywords,
+	};
 	const char *name;
 	struct enum_arg flags = {
 		.type = FindObjectFlags_class,
@@ -642,53 +972,62 @@ static DrgnObject *Program_object(Program *self, PyObject *args,
 	};
 	struct path_arg filename = {.allow_none = true};
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&O&:object", keywords,
-					 &name, enum_converter, &flags,
-					 path_converter, &filename))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &name,
+				   enum_converter, &flags, path_converter,
+				   &filename))
 		return NULL;
 
 	return Program_find_object(self, name, &filename, flags.value);
 }
 
-static DrgnObject *Program_constant(Program *self, PyObject *args,
-				    PyObject *kwds)
+static DrgnObject *Program_constant(Program *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"name", "filename", NULL};
+	static const char * const keywords[] = {"name", "filename", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "s|O&:constant",
+		.keywords = keywords,
+	};
 	const char *name;
 	struct path_arg filename = {.allow_none = true};
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:constant", keywords,
-					 &name, path_converter, &filename))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &name,
+				   path_converter, &filename))
 		return NULL;
 
 	return Program_find_object(self, name, &filename,
 				   DRGN_FIND_OBJECT_CONSTANT);
 }
 
-static DrgnObject *Program_function(Program *self, PyObject *args,
-				    PyObject *kwds)
+static DrgnObject *Program_function(Program *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"name", "filename", NULL};
+	static const char * const keywords[] = {"name", "filename", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "s|O&:function",
+		.keywords = keywords,
+	};
 	const char *name;
 	struct path_arg filename = {.allow_none = true};
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:function", keywords,
-					 &name, path_converter, &filename))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &name,
+				   path_converter, &filename))
 		return NULL;
 
 	return Program_find_object(self, name, &filename,
 				   DRGN_FIND_OBJECT_FUNCTION);
 }
 
-static DrgnObject *Program_variable(Program *self, PyObject *args,
-				    PyObject *kwds)
+static DrgnObject *Program_variable(Program *self, DRGNPY_FASTCALL_ARGS)
 {
-	static char *keywords[] = {"name", "filename", NULL};
+	static const char * const keywords[] = {"name", "filename", NULL};
+	static drgnpy_arg_parser parser = {
+		.format = "s|O&:variable",
+		.keywords = keywords,
+	};
 	const char *name;
 	struct path_arg filename = {.allow_none = true};
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O&:variable", keywords,
-					 &name, path_converter, &filename))
+	if (!drgnpy_parse_fastcall(args, nargs, kwnames, &parser, &name,
+				   path_converter, &filename))
 		return NULL;
 
 	return Program_find_object(self, name, &filename,
@@ -702,6 +1041,8 @@ static StackTrace *Program_stack_trace(Program *self, PyObject *args,
 	struct drgn_error *err;
 	PyObject *thread;
 	struct drgn_stack_trace *trace;
+	PyThreadState *save;
+	bool clear;
 	StackTrace *ret;
 
 	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:stack_trace", keywords,
@@ -709,15 +1050,33 @@ static StackTrace *Program_stack_trace(Program *self, PyObject *args,
 		return NULL;
 
 	if (PyObject_TypeCheck(thread, &DrgnObject_type)) {
+		clear = set_drgn_in_python();
+		save = Program_begin_allow_threads(self);
+		if (!save) {
+			if (clear)
+				clear_drgn_in_python();
+			return NULL;
+		}
 		err = drgn_object_stack_trace(&((DrgnObject *)thread)->obj,
 					      &trace);
+		Program_end_allow_threads(self, save);
 	} else {
 		struct index_arg tid = {};
 
 		if (!index_converter(thread, &tid))
 			return NULL;
+		clear = set_drgn_in_python();
+		save = Program_begin_allow_threads(self);
+		if (!save) {
+			if (clear)
+				clear_drgn_in_python();
+			return NULL;
+		}
 		err = drgn_program_stack_trace(&self->prog, tid.uvalue, &trace);
+		Program_end_allow_threads(self, save);
 	}
+	if (clear)
+		clear_drgn_in_python();
 	if (err)
 		return set_drgn_error(err);
 
@@ -732,6 +1091,255 @@ static StackTrace *Program_stack_trace(Program *self, PyObject *args,
 	return ret;
 }
 
+/*
+ * Convert a sequence of thread arguments for stack_traces() and
+ * aggregate_stack_traces() to objects. Thread IDs are stored in tids, and the
+ * number of initialized objects in tids is returned in *num_tids_ret even on
+ * failure.
+ */
+static int Program_thread_objects(Program *self, PyObject *seq,
+				  const struct drgn_object **threads,
+				  struct drgn_object *tids,
+				  size_t *num_tids_ret)
+{
+	struct drgn_error *err;
+	size_t n = PySequence_Fast_GET_SIZE(seq);
+
+	*num_tids_ret = 0;
+	for (size_t i = 0; i < n; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+
+		if (PyObject_TypeCheck(item, &DrgnObject_type)) {
+			threads[i] = &((DrgnObject *)item)->obj;
+		} else {
+			struct index_arg tid = {};
+			struct drgn_qualified_type qualified_type = {};
+
+			if (!index_converter(item, &tid))
+				return -1;
+			err = drgn_program_find_primitive_type(&self->prog,
+							       DRGN_C_TYPE_UNSIGNED_INT,
+							       &qualified_type.type);
+			if (err) {
+				set_drgn_error(err);
+				return -1;
+			}
+			struct drgn_object *obj = &tids[(*num_tids_ret)++];
+			drgn_object_init(obj, &self->prog);
+			err = drgn_object_set_unsigned(obj, qualified_type,
+						       tid.uvalue, 0);
+			if (err) {
+				set_drgn_error(err);
+				return -1;
+			}
+			threads[i] = obj;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Threads that couldn't be unwound (e.g., because they are running) are
+ * skipped, but errors that indicate a bug or a system problem are raised.
+ */
+static int check_stack_trace_errors(struct drgn_error **errs, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (errs[i] && (errs[i]->code == DRGN_ERROR_NO_MEMORY ||
+				errs[i]->code == DRGN_ERROR_TYPE)) {
+			set_drgn_error(errs[i]);
+			errs[i] = NULL;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Wrap a stack trace, taking ownership of it. */
+static PyObject *Program_wrap_stack_trace(Program *self,
+					  struct drgn_stack_trace *trace)
+{
+	StackTrace *ret =
+		(StackTrace *)StackTrace_type.tp_alloc(&StackTrace_type, 0);
+	if (!ret) {
+		drgn_stack_trace_destroy(trace);
+		return NULL;
+	}
+	ret->trace = trace;
+	ret->prog = self;
+	Py_INCREF(self);
+	return (PyObject *)ret;
+}
+
+static PyObject *Program_stack_traces(Program *self, PyObject *arg)
+{
+	struct drgn_error *err;
+	PyObject *seq, *list = NULL;
+	const struct drgn_object **threads = NULL;
+	struct drgn_object *tids = NULL;
+	struct drgn_stack_trace **traces = NULL;
+	struct drgn_error **errs = NULL;
+	size_t n, num_tids = 0, i;
+
+	seq = PySequence_Fast(arg, "threads must be iterable");
+	if (!seq)
+		return NULL;
+	n = PySequence_Fast_GET_SIZE(seq);
+	threads = malloc_array(n, sizeof(*threads));
+	tids = malloc_array(n, sizeof(*tids));
+	traces = malloc_array(n, sizeof(*traces));
+	errs = malloc_array(n, sizeof(*errs));
+	if ((!threads || !tids || !traces || !errs) && n) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	if (Program_thread_objects(self, seq, threads, tids, &num_tids))
+		goto out;
+
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		goto out;
+	}
+	err = drgn_program_stack_traces(&self->prog, threads, n, traces, errs);
+	Program_end_allow_threads(self, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+
+	if (check_stack_trace_errors(errs, n))
+		goto out_traces;
+	list = PyList_New(n);
+	if (!list)
+		goto out_traces;
+	for (i = 0; i < n; i++) {
+		PyObject *item;
+
+		if (traces[i]) {
+			item = Program_wrap_stack_trace(self, traces[i]);
+			traces[i] = NULL;
+			if (!item) {
+				Py_CLEAR(list);
+				goto out_traces;
+			}
+		} else {
+			Py_INCREF(Py_None);
+			item = Py_None;
+		}
+		PyList_SET_ITEM(list, i, item);
+	}
+
+out_traces:
+	for (i = 0; i < n; i++) {
+		if (traces[i])
+			drgn_stack_trace_destroy(traces[i]);
+		drgn_error_destroy(errs[i]);
+	}
+out:
+	while (num_tids)
+		drgn_object_deinit(&tids[--num_tids]);
+	free(errs);
+	free(traces);
+	free(tids);
+	free(threads);
+	Py_DECREF(seq);
+	return list;
+}
+
+static PyObject *Program_aggregate_stack_traces(Program *self, PyObject *arg)
+{
+	struct drgn_error *err;
+	PyObject *seq, *list = NULL;
+	const struct drgn_object **threads = NULL;
+	struct drgn_object *tids = NULL;
+	struct drgn_error **errs = NULL;
+	struct drgn_stack_trace_bucket *buckets = NULL;
+	size_t n, num_tids = 0, num_buckets = 0, i;
+
+	seq = PySequence_Fast(arg, "threads must be iterable");
+	if (!seq)
+		return NULL;
+	n = PySequence_Fast_GET_SIZE(seq);
+	threads = malloc_array(n, sizeof(*threads));
+	tids = malloc_array(n, sizeof(*tids));
+	errs = malloc_array(n, sizeof(*errs));
+	if ((!threads || !tids || !errs) && n) {
+		PyErr_NoMemory();
+		goto out;
+	}
+	if (Program_thread_objects(self, seq, threads, tids, &num_tids))
+		goto out;
+
+	bool clear = set_drgn_in_python();
+	PyThreadState *save = Program_begin_allow_threads(self);
+	if (!save) {
+		if (clear)
+			clear_drgn_in_python();
+		goto out;
+	}
+	err = drgn_program_aggregate_stack_traces(&self->prog, threads, n,
+						  &buckets, &num_buckets,
+						  errs);
+	Program_end_allow_threads(self, save);
+	if (clear)
+		clear_drgn_in_python();
+	if (err) {
+		set_drgn_error(err);
+		goto out;
+	}
+
+	if (check_stack_trace_errors(errs, n))
+		goto out_buckets;
+	list = PyList_New(num_buckets);
+	if (!list)
+		goto out_buckets;
+	for (i = 0; i < num_buckets; i++) {
+		PyObject *bucket_threads = PyList_New(buckets[i].num_threads);
+		if (!bucket_threads)
+			goto err;
+		for (size_t j = 0; j < buckets[i].num_threads; j++) {
+			PyObject *thread =
+				PySequence_Fast_GET_ITEM(seq,
+							 buckets[i].threads[j]);
+			Py_INCREF(thread);
+			PyList_SET_ITEM(bucket_threads, j, thread);
+		}
+		PyObject *trace = Program_wrap_stack_trace(self,
+							   buckets[i].trace);
+		buckets[i].trace = NULL;
+		if (!trace) {
+			Py_DECREF(bucket_threads);
+			goto err;
+		}
+		PyObject *item = Py_BuildValue("NN", trace, bucket_threads);
+		if (!item)
+			goto err;
+		PyList_SET_ITEM(list, i, item);
+	}
+
+out_buckets:
+	for (i = 0; i < n; i++)
+		drgn_error_destroy(errs[i]);
+	drgn_stack_trace_buckets_destroy(buckets, num_buckets);
+out:
+	while (num_tids)
+		drgn_object_deinit(&tids[--num_tids]);
+	free(errs);
+	free(tids);
+	free(threads);
+	Py_DECREF(seq);
+	return list;
+
+err:
+	Py_CLEAR(list);
+	goto out_buckets;
+}
+
 static PyObject *Program_symbol(Program *self, PyObject *arg)
 {
 	struct drgn_error *err;
@@ -745,21 +1353,270 @@ static PyObject *Program_symbol(Program *self, PyObject *arg)
 		if (!name)
 			return NULL;
 		err = drgn_program_find_symbol_by_name(&self->prog, name, &sym);
+		if (err)
+			return set_drgn_error(err);
+		ret = Symbol_wrap(sym, self);
+		drgn_symbol_destroy(sym);
+		return ret;
 	} else {
 		struct index_arg address = {};
+		struct drgn_symbol tmp;
 
 		if (!index_converter(arg, &address))
 			return NULL;
-		err = drgn_program_find_symbol_by_address(&self->prog,
-							  address.uvalue, &sym);
+		if (!drgn_program_find_symbol_by_address_internal(&self->prog,
+								  address.uvalue,
+								  NULL, &tmp)) {
+			err = drgn_error_symbol_not_found(address.uvalue);
+			return set_drgn_error(err);
+		}
+		return Symbol_wrap(&tmp, self);
+	}
+}
+
+/* Convert an optional iterable of CPU numbers for the per-CPU methods. */
+static int per_cpu_cpus_arg(PyObject *cpus_obj, uint64_t **cpus_ret,
+			    size_t *num_cpus_ret)
+{
+	*cpus_ret = NULL;
+	*num_cpus_ret = 0;
+	if (cpus_obj == Py_None)
+		return 0;
+
+	PyObject *seq = PySequence_Fast(cpus_obj, "cpus must be iterable");
+	if (!seq)
+		return -1;
+	size_t n = PySequence_Fast_GET_SIZE(seq);
+	uint64_t *cpus = malloc_array(n ? n : 1, sizeof(*cpus));
+	if (!cpus) {
+		Py_DECREF(seq);
+		PyErr_NoMemory();
+		return -1;
 	}
+	for (size_t i = 0; i < n; i++) {
+		struct index_arg cpu = {};
+		if (!index_converter(PySequence_Fast_GET_ITEM(seq, i), &cpu)) {
+			Py_DECREF(seq);
+			free(cpus);
+			return -1;
+		}
+		cpus[i] = cpu.uvalue;
+	}
+	Py_DECREF(seq);
+	*cpus_ret = cpus;
+	*num_cpus_ret = n;
+	return 0;
+}
+
+static PyObject *Program_per_cpu_values(Program *self, PyObject *args,
+					PyObject *kwds)
+{
+	static char *keywords[] = {"ptr", "cpus", NULL};
+	struct drgn_error *err;
+	DrgnObject *ptr;
+	PyObject *cpus_obj = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O:per_cpu_values",
+					 keywords, &DrgnObject_type, &ptr,
+					 &cpus_obj))
+		return NULL;
+	if (DrgnObject_prog(ptr) != self) {
+		PyErr_SetString(PyExc_ValueError,
+				"object is from different program");
+		return NULL;
+	}
+
+	uint64_t *cpus;
+	size_t num_cpus;
+	if (per_cpu_cpus_arg(cpus_obj, &cpus, &num_cpus))
+		return NULL;
+	struct drgn_object *values;
+	size_t num_values;
+	err = drgn_program_per_cpu_values(&self->prog, &ptr->obj, cpus,
+					  num_cpus, &values, &num_values);
+	free(cpus);
 	if (err)
 		return set_drgn_error(err);
-	ret = Symbol_wrap(sym, self);
-	if (!ret) {
-		drgn_symbol_destroy(sym);
+
+	PyObject *list = PyList_New(num_values);
+	for (size_t i = 0; list && i < num_values; i++) {
+		DrgnObject *item = DrgnObject_alloc(self);
+		if (!item) {
+			Py_CLEAR(list);
+			break;
+		}
+		PyList_SET_ITEM(list, i, (PyObject *)item);
+		err = drgn_object_copy(&item->obj, &values[i]);
+		if (err) {
+			set_drgn_error(err);
+			Py_CLEAR(list);
+		}
+	}
+	for (size_t i = 0; i < num_values; i++)
+		drgn_object_deinit(&values[i]);
+	free(values);
+	return list;
+}
+
+static DrgnObject *Program_per_cpu_sum(Program *self, PyObject *args,
+				       PyObject *kwds)
+{
+	static char *keywords[] = {"ptr", "cpus", NULL};
+	struct drgn_error *err;
+	DrgnObject *ptr;
+	PyObject *cpus_obj = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O:per_cpu_sum",
+					 keywords, &DrgnObject_type, &ptr,
+					 &cpus_obj))
+		return NULL;
+	if (DrgnObject_prog(ptr) != self) {
+		PyErr_SetString(PyExc_ValueError,
+				"object is from different program");
 		return NULL;
 	}
+
+	uint64_t *cpus;
+	size_t num_cpus;
+	if (per_cpu_cpus_arg(cpus_obj, &cpus, &num_cpus))
+		return NULL;
+	DrgnObject *res = DrgnObject_alloc(self);
+	if (!res) {
+		free(cpus);
+		return NULL;
+	}
+	err = drgn_program_per_cpu_sum(&self->prog, &ptr->obj, cpus, num_cpus,
+				       &res->obj);
+	free(cpus);
+	if (err) {
+		Py_DECREF(res);
+		return set_drgn_error(err);
+	}
+	return res;
+}
+
+static PyObject *Program_symbols(Program *self, PyObject *args,
+				 PyObject *kwds)
+{
+	static char *keywords[] = {"pattern", NULL};
+	struct drgn_error *err;
+	const char *pattern = NULL;
+	struct drgn_symbol **syms;
+	size_t count, i;
+	PyObject *list;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z:symbols", keywords,
+					 &pattern))
+		return NULL;
+
+	err = drgn_program_find_symbols(&self->prog, pattern, &syms, &count);
+	if (err)
+		return set_drgn_error(err);
+
+	list = PyList_New(count);
+	if (list) {
+		for (i = 0; i < count; i++) {
+			PyObject *item = Symbol_wrap(syms[i], self);
+			if (!item) {
+				Py_CLEAR(list);
+				break;
+			}
+			PyList_SET_ITEM(list, i, item);
+		}
+	}
+	for (i = 0; i < count; i++)
+		drgn_symbol_destroy(syms[i]);
+	free(syms);
+	return list;
+}
+
+static PyObject *Program_symbolize(Program *self, PyObject *arg)
+{
+	PyObject *seq, *list;
+	Py_ssize_t i, n;
+
+	seq = PySequence_Fast(arg, "addresses must be iterable");
+	if (!seq)
+		return NULL;
+	n = PySequence_Fast_GET_SIZE(seq);
+	list = PyList_New(n);
+	if (!list)
+		goto out;
+	for (i = 0; i < n; i++) {
+		struct index_arg address = {};
+		struct drgn_symbol sym;
+		PyObject *item;
+
+		if (!index_converter(PySequence_Fast_GET_ITEM(seq, i),
+				     &address)) {
+			Py_CLEAR(list);
+			goto out;
+		}
+		if (drgn_program_find_symbol_by_address_internal(&self->prog,
+								 address.uvalue,
+								 NULL, &sym)) {
+			item = Symbol_wrap(&sym, self);
+			if (!item) {
+				Py_CLEAR(list);
+				goto out;
+			}
+		} else {
+			Py_INCREF(Py_None);
+			item = Py_None;
+		}
+		PyList_SET_ITEM(list, i, item);
+	}
+out:
+	Py_DECREF(seq);
+	return list;
+}
+
+static Expression *Program_compile(Program *self, PyObject *args,
+				   PyObject *kwds)
+{
+	static char *keywords[] = {"expr", "params", NULL};
+	const char *str;
+	PyObject *params_obj = NULL;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O:compile", keywords,
+					 &str, &params_obj))
+		return NULL;
+
+	if (!params_obj) {
+		params_obj = PyTuple_New(0);
+		if (!params_obj)
+			return NULL;
+	} else {
+		Py_INCREF(params_obj);
+	}
+	Expression *ret = Program_compile_expression(self, str, params_obj);
+	Py_DECREF(params_obj);
+	return ret;
+}
+
+static DrgnObject *Program_eval(Program *self, PyObject *args, PyObject *kwds)
+{
+	const char *str;
+	PyObject *params_obj, *empty;
+	Expression *expr;
+	DrgnObject *ret;
+
+	if (!PyArg_ParseTuple(args, "s:eval", &str))
+		return NULL;
+
+	params_obj = kwds ? PyDict_Keys(kwds) : PyTuple_New(0);
+	if (!params_obj)
+		return NULL;
+	expr = Program_compile_expression(self, str, params_obj);
+	Py_DECREF(params_obj);
+	if (!expr)
+		return NULL;
+	empty = PyTuple_New(0);
+	if (!empty) {
+		Py_DECREF(expr);
+		return NULL;
+	}
+	ret = (DrgnObject *)PyObject_Call((PyObject *)expr, empty, kwds);
+	Py_DECREF(empty);
+	Py_DECREF(expr);
 	return ret;
 }
 
@@ -858,76 +1715,183 @@ static PyObject *Program_get_language(Program *self, void *arg)
 	return Language_wrap(drgn_program_language(&self->prog));
 }
 
+static PyObject *Program_get_frame_pointer_unwinding(Program *self, void *arg)
+{
+	return PyBool_FromLong(drgn_program_frame_pointer_unwinding(&self->prog));
+}
+
+static int Program_set_frame_pointer_unwinding(Program *self, PyObject *value,
+					       void *arg)
+{
+	if (!value) {
+		PyErr_SetString(PyExc_AttributeError,
+				"cannot delete frame_pointer_unwinding attribute");
+		return -1;
+	}
+	int ret = PyObject_IsTrue(value);
+	if (ret == -1)
+		return -1;
+	drgn_program_set_frame_pointer_unwinding(&self->prog, ret);
+	return 0;
+}
+
+/* Entry points which don't release the GIL. See Program_lock(). */
+DRGNPY_LOCKED_NOARGS(PyObject *, Program, Program_set_kernel, self)
+DRGNPY_LOCKED_NOARGS(PyObject *, Program, Program_load_default_debug_info, self)
+DRGNPY_LOCKED_NOARGS(PyObject *, Program, Program_start_recording, self)
+DRGNPY_LOCKED_NOARGS(PyObject *, Program, Program_stop_recording, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_add_memory_segment, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_add_type_finder, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_add_object_finder, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_set_core_dump, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_set_pid, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_load_debug_info, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_load_btf, self)
+DRGNPY_LOCKED_KEYWORDS(MemorySearchIterator *, Program,
+		       Program_search_memory, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_write_minicore, self)
+DRGNPY_LOCKED_KEYWORDS(StackTrace *, Program, Program_stack_trace, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_per_cpu_values, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnObject *, Program, Program_per_cpu_sum, self)
+DRGNPY_LOCKED_KEYWORDS(PyObject *, Program, Program_symbols, self)
+DRGNPY_LOCKED_KEYWORDS(Expression *, Program, Program_compile, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnObject *, Program, Program_eval, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_void_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_int_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_bool_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_float_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_complex_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_struct_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_union_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_class_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_enum_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_typedef_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_pointer_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_array_type, self)
+DRGNPY_LOCKED_KEYWORDS(DrgnType *, Program, Program_function_type, self)
+DRGNPY_LOCKED_O(DrgnObject *, Program, Program_subscript, self)
+DRGNPY_LOCKED_O(PyObject *, Program, Program_stack_traces, self)
+DRGNPY_LOCKED_O(PyObject *, Program, Program_aggregate_stack_traces, self)
+DRGNPY_LOCKED_O(PyObject *, Program, Program_symbol, self)
+DRGNPY_LOCKED_O(PyObject *, Program, Program_symbolize, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_read, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_find_type, self)
+DRGNPY_LOCKED_FASTCALL(DrgnObject *, Program, Program_object, self)
+DRGNPY_LOCKED_FASTCALL(DrgnObject *, Program, Program_constant, self)
+DRGNPY_LOCKED_FASTCALL(DrgnObject *, Program, Program_function, self)
+DRGNPY_LOCKED_FASTCALL(DrgnObject *, Program, Program_variable, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_read_u8, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_read_u16, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_read_u32, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_read_u64, self)
+DRGNPY_LOCKED_FASTCALL(PyObject *, Program, Program_read_word, self)
+DRGNPY_LOCKED(int, -1, Program_contains, (Program *self, PyObject *key),
+	      (self, key), self)
+DRGNPY_LOCKED_GETTER(PyObject *, Program, Program_get_platform, self)
+DRGNPY_LOCKED_GETTER(PyObject *, Program, Program_get_language, self)
+DRGNPY_LOCKED_GETTER(PyObject *, Program,
+		     Program_get_frame_pointer_unwinding, self)
+DRGNPY_LOCKED(int, -1, Program_set_frame_pointer_unwinding,
+	      (Program *self, PyObject *value, void *arg), (self, value, arg),
+	      self)
+
 static PyMethodDef Program_methods[] = {
-	{"add_memory_segment", (PyCFunction)Program_add_memory_segment,
+	{"add_memory_segment", (PyCFunction)Program_add_memory_segment_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_add_memory_segment_DOC},
-	{"add_type_finder", (PyCFunction)Program_add_type_finder,
+	{"add_type_finder", (PyCFunction)Program_add_type_finder_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_add_type_finder_DOC},
-	{"add_object_finder", (PyCFunction)Program_add_object_finder,
+	{"add_object_finder", (PyCFunction)Program_add_object_finder_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_add_object_finder_DOC},
-	{"set_core_dump", (PyCFunction)Program_set_core_dump,
+	{"set_core_dump", (PyCFunction)Program_set_core_dump_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_set_core_dump_DOC},
-	{"set_kernel", (PyCFunction)Program_set_kernel, METH_NOARGS,
+	{"set_kernel", (PyCFunction)Program_set_kernel_locked, METH_NOARGS,
 	 drgn_Program_set_kernel_DOC},
-	{"set_pid", (PyCFunction)Program_set_pid, METH_VARARGS | METH_KEYWORDS,
-	 drgn_Program_set_pid_DOC},
-	{"load_debug_info", (PyCFunction)Program_load_debug_info,
+	{"set_pid", (PyCFunction)Program_set_pid_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_set_pid_DOC},
+	{"load_debug_info", (PyCFunction)Program_load_debug_info_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_load_debug_info_DOC},
 	{"load_default_debug_info",
-	 (PyCFunction)Program_load_default_debug_info, METH_NOARGS,
+	 (PyCFunction)Program_load_default_debug_info_locked, METH_NOARGS,
 	 drgn_Program_load_default_debug_info_DOC},
-	{"__getitem__", (PyCFunction)Program_subscript, METH_O | METH_COEXIST,
-	 drgn_Program___getitem___DOC},
-	{"read", (PyCFunction)Program_read, METH_VARARGS | METH_KEYWORDS,
+	{"load_btf", (PyCFunction)Program_load_btf_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_load_btf_DOC},
+	{"__getitem__", (PyCFunction)Program_subscript_locked,
+	 METH_O | METH_COEXIST, drgn_Program___getitem___DOC},
+	{"read", (PyCFunction)Program_read_locked, DRGNPY_FASTCALL_FLAGS,
 	 drgn_Program_read_DOC},
+	{"search_memory", (PyCFunction)Program_search_memory_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_search_memory_DOC},
+	{"start_recording", (PyCFunction)Program_start_recording_locked,
+	 METH_NOARGS, drgn_Program_start_recording_DOC},
+	{"stop_recording", (PyCFunction)Program_stop_recording_locked,
+	 METH_NOARGS, drgn_Program_stop_recording_DOC},
+	{"write_minicore", (PyCFunction)Program_write_minicore_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_write_minicore_DOC},
 #define METHOD_DEF_READ(x)						\
-	{"read_"#x, (PyCFunction)Program_read_##x,			\
-	 METH_VARARGS | METH_KEYWORDS, drgn_Program_read_##x##_DOC}
+	{"read_"#x, (PyCFunction)Program_read_##x##_locked,		\
+	 DRGNPY_FASTCALL_FLAGS, drgn_Program_read_##x##_DOC}
 	METHOD_DEF_READ(u8),
 	METHOD_DEF_READ(u16),
 	METHOD_DEF_READ(u32),
 	METHOD_DEF_READ(u64),
 	METHOD_DEF_READ(word),
 #undef METHOD_READ_U
-	{"type", (PyCFunction)Program_find_type, METH_VARARGS | METH_KEYWORDS,
+	{"type", (PyCFunction)Program_find_type_locked, DRGNPY_FASTCALL_FLAGS,
 	 drgn_Program_type_DOC},
-	{"object", (PyCFunction)Program_object, METH_VARARGS | METH_KEYWORDS,
+	{"object", (PyCFunction)Program_object_locked, DRGNPY_FASTCALL_FLAGS,
 	 drgn_Program_object_DOC},
-	{"constant", (PyCFunction)Program_constant,
-	 METH_VARARGS | METH_KEYWORDS, drgn_Program_constant_DOC},
-	{"function", (PyCFunction)Program_function,
-	 METH_VARARGS | METH_KEYWORDS, drgn_Program_function_DOC},
-	{"variable", (PyCFunction)Program_variable,
-	 METH_VARARGS | METH_KEYWORDS, drgn_Program_variable_DOC},
-	{"stack_trace", (PyCFunction)Program_stack_trace,
+	{"constant", (PyCFunction)Program_constant_locked,
+	 DRGNPY_FASTCALL_FLAGS, drgn_Program_constant_DOC},
+	{"function", (PyCFunction)Program_function_locked,
+	 DRGNPY_FASTCALL_FLAGS, drgn_Program_function_DOC},
+	{"variable", (PyCFunction)Program_variable_locked,
+	 DRGNPY_FASTCALL_FLAGS, drgn_Program_variable_DOC},
+	{"stack_trace", (PyCFunction)Program_stack_trace_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_stack_trace_DOC},
-	{"symbol", (PyCFunction)Program_symbol, METH_O,
+	{"stack_traces", (PyCFunction)Program_stack_traces_locked, METH_O,
+	 drgn_Program_stack_traces_DOC},
+	{"aggregate_stack_traces",
+	 (PyCFunction)Program_aggregate_stack_traces_locked, METH_O,
+	 drgn_Program_aggregate_stack_traces_DOC},
+	{"per_cpu_values", (PyCFunction)Program_per_cpu_values_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_per_cpu_values_DOC},
+	{"per_cpu_sum", (PyCFunction)Program_per_cpu_sum_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_per_cpu_sum_DOC},
+	{"symbol", (PyCFunction)Program_symbol_locked, METH_O,
 	 drgn_Program_symbol_DOC},
-	{"void_type", (PyCFunction)Program_void_type,
+	{"symbolize", (PyCFunction)Program_symbolize_locked, METH_O,
+	 drgn_Program_symbolize_DOC},
+	{"symbols", (PyCFunction)Program_symbols_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_symbols_DOC},
+	{"compile", (PyCFunction)Program_compile_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Program_compile_DOC},
+	{"eval", (PyCFunction)Program_eval_locked, METH_VARARGS | METH_KEYWORDS,
+	 drgn_Program_eval_DOC},
+	{"void_type", (PyCFunction)Program_void_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_void_type_DOC},
-	{"int_type", (PyCFunction)Program_int_type,
+	{"int_type", (PyCFunction)Program_int_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_int_type_DOC},
-	{"bool_type", (PyCFunction)Program_bool_type,
+	{"bool_type", (PyCFunction)Program_bool_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_bool_type_DOC},
-	{"float_type", (PyCFunction)Program_float_type,
+	{"float_type", (PyCFunction)Program_float_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_float_type_DOC},
-	{"complex_type", (PyCFunction)Program_complex_type,
+	{"complex_type", (PyCFunction)Program_complex_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_complex_type_DOC},
-	{"struct_type", (PyCFunction)Program_struct_type,
+	{"struct_type", (PyCFunction)Program_struct_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_struct_type_DOC},
-	{"union_type", (PyCFunction)Program_union_type,
+	{"union_type", (PyCFunction)Program_union_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_union_type_DOC},
-	{"class_type", (PyCFunction)Program_class_type,
+	{"class_type", (PyCFunction)Program_class_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_class_type_DOC},
-	{"enum_type", (PyCFunction)Program_enum_type,
+	{"enum_type", (PyCFunction)Program_enum_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_enum_type_DOC},
-	{"typedef_type", (PyCFunction)Program_typedef_type,
+	{"typedef_type", (PyCFunction)Program_typedef_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_typedef_type_DOC},
-	{"pointer_type", (PyCFunction)Program_pointer_type,
+	{"pointer_type", (PyCFunction)Program_pointer_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_pointer_type_DOC},
-	{"array_type", (PyCFunction)Program_array_type,
+	{"array_type", (PyCFunction)Program_array_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_array_type_DOC},
-	{"function_type", (PyCFunction)Program_function_type,
+	{"function_type", (PyCFunction)Program_function_type_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Program_function_type_DOC},
 	{},
 };
@@ -940,20 +1904,69 @@ static PyMemberDef Program_members[] = {
 
 static PyGetSetDef Program_getset[] = {
 	{"flags", (getter)Program_get_flags, NULL, drgn_Program_flags_DOC},
-	{"platform", (getter)Program_get_platform, NULL,
+	{"platform", (getter)Program_get_platform_locked, NULL,
 	 drgn_Program_platform_DOC},
-	{"language", (getter)Program_get_language, NULL,
+	{"language", (getter)Program_get_language_locked, NULL,
 	 drgn_Program_language_DOC},
+	{"frame_pointer_unwinding",
+	 (getter)Program_get_frame_pointer_unwinding_locked,
+	 (setter)Program_set_frame_pointer_unwinding_locked,
+	 drgn_Program_frame_pointer_unwinding_DOC},
 	{},
 };
 
 static PyMappingMethods Program_as_mapping = {
-	.mp_subscript = (binaryfunc)Program_subscript,
+	.mp_subscript = (binaryfunc)Program_subscript_locked,
 };
 
 
 static PySequenceMethods Program_as_sequence = {
-	.sq_contains = (objobjproc)Program_contains,
+	.sq_contains = (objobjproc)Program_contains_locked,
+};
+
+static void MemorySearchIterator_dealloc(MemorySearchIterator *self)
+{
+	drgn_memory_search_iterator_destroy(self->it);
+	Py_XDECREF(self->prog);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *MemorySearchIterator_next(MemorySearchIterator *self)
+{
+	if (self->index >= self->num_addresses) {
+		struct drgn_error *err;
+		bool clear = set_drgn_in_python();
+		PyThreadState *save = Program_begin_allow_threads(self->prog);
+		if (!save) {
+			if (clear)
+				clear_drgn_in_python();
+			return NULL;
+		}
+		err = drgn_memory_search_iterator_next(self->it,
+						       &self->addresses,
+						       &self->num_addresses);
+		Program_end_allow_threads(self->prog, save);
+		if (clear)
+			clear_drgn_in_python();
+		if (err) {
+			self->num_addresses = 0;
+			return set_drgn_error(err);
+		}
+		self->index = 0;
+		if (!self->num_addresses)
+			return NULL;
+	}
+	return PyLong_FromUnsignedLongLong(self->addresses[self->index++]);
+}
+
+PyTypeObject MemorySearchIterator_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "_drgn._MemorySearchIterator",
+	.tp_basicsize = sizeof(MemorySearchIterator),
+	.tp_dealloc = (destructor)MemorySearchIterator_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_iter = PyObject_SelfIter,
+	.tp_iternext = (iternextfunc)MemorySearchIterator_next,
 };
 
 PyTypeObject Program_type = {
@@ -978,6 +1991,7 @@ Program *program_from_core_dump(PyObject *self, PyObject *args, PyObject *kwds)
 	static char *keywords[] = {"path", NULL};
 	struct drgn_error *err;
 	struct path_arg path = {};
+	PyThreadState *save;
 	Program *prog;
 
 	if (!PyArg_ParseTupleAndKeywords(args, kwds,
@@ -991,7 +2005,14 @@ Program *program_from_core_dump(PyObject *self, PyObject *args, PyObject *kwds)
 		return NULL;
 	}
 
+	save = Program_begin_allow_threads(prog);
+	if (!save) {
+		path_cleanup(&path);
+		Py_DECREF(prog);
+		return NULL;
+	}
 	err = drgn_program_init_core_dump(&prog->prog, path.path);
+	Program_end_allow_threads(prog, save);
 	path_cleanup(&path);
 	if (err) {
 		Py_DECREF(prog);
@@ -1003,13 +2024,20 @@ Program *program_from_core_dump(PyObject *self, PyObject *args, PyObject *kwds)
 Program *program_from_kernel(PyObject *self)
 {
 	struct drgn_error *err;
+	PyThreadState *save;
 	Program *prog;
 
 	prog = (Program *)PyObject_CallObject((PyObject *)&Program_type, NULL);
 	if (!prog)
 		return NULL;
 
+	save = Program_begin_allow_threads(prog);
+	if (!save) {
+		Py_DECREF(prog);
+		return NULL;
+	}
 	err = drgn_program_init_kernel(&prog->prog);
+	Program_end_allow_threads(prog, save);
 	if (err) {
 		Py_DECREF(prog);
 		return set_drgn_error(err);
@@ -1022,6 +2050,7 @@ Program *program_from_pid(PyObject *self, PyObject *args, PyObject *kwds)
 	static char *keywords[] = {"pid", NULL};
 	struct drgn_error *err;
 	int pid;
+	PyThreadState *save;
 	Program *prog;
 
 	if (!PyArg_ParseTupleAndKeywords(args, kwds, "i:program_from_pid",
@@ -1032,7 +2061,13 @@ Program *program_from_pid(PyObject *self, PyObject *args, PyObject *kwds)
 	if (!prog)
 		return NULL;
 
+	save = Program_begin_allow_threads(prog);
+	if (!save) {
+		Py_DECREF(prog);
+		return NULL;
+	}
 	err = drgn_program_init_pid(&prog->prog, pid);
+	Program_end_allow_threads(prog, save);
 	if (err) {
 		Py_DECREF(prog);
 		return set_drgn_error(err);
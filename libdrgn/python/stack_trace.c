@@ -25,6 +25,9 @@ static PyObject *StackTrace_str(StackTrace *self)
 	return ret;
 }
 
+DRGNPY_LOCKED(PyObject *, NULL, StackTrace_str, (StackTrace *self), (self),
+	      self->prog)
+
 static Py_ssize_t StackTrace_length(StackTrace *self)
 {
 	return drgn_stack_trace_num_frames(self->trace);
@@ -60,7 +63,7 @@ PyTypeObject StackTrace_type = {
 	.tp_basicsize = sizeof(StackTrace),
 	.tp_dealloc = (destructor)StackTrace_dealloc,
 	.tp_as_sequence = &StackTrace_as_sequence,
-	.tp_str = (reprfunc)StackTrace_str,
+	.tp_str = (reprfunc)StackTrace_str_locked,
 	.tp_flags = Py_TPFLAGS_DEFAULT,
 	.tp_doc = drgn_StackTrace_DOC,
 };
@@ -81,10 +84,7 @@ static PyObject *StackFrame_symbol(StackFrame *self)
 	if (err)
 		return set_drgn_error(err);
 	ret = Symbol_wrap(sym, self->trace->prog);
-	if (!ret) {
-		drgn_symbol_destroy(sym);
-		return NULL;
-	}
+	drgn_symbol_destroy(sym);
 	return ret;
 }
 
@@ -159,12 +159,20 @@ static PyObject *StackFrame_get_pc(StackFrame *self, void *arg)
 	return PyLong_FromUnsignedLongLong(drgn_stack_frame_pc(self->frame));
 }
 
+/* Entry points which don't release the GIL. See Program_lock(). */
+DRGNPY_LOCKED_NOARGS(PyObject *, StackFrame, StackFrame_symbol,
+		     self->trace->prog)
+DRGNPY_LOCKED_O(PyObject *, StackFrame, StackFrame_register,
+		self->trace->prog)
+DRGNPY_LOCKED_NOARGS(PyObject *, StackFrame, StackFrame_registers,
+		     self->trace->prog)
+
 static PyMethodDef StackFrame_methods[] = {
-	{"symbol", (PyCFunction)StackFrame_symbol, METH_NOARGS,
+	{"symbol", (PyCFunction)StackFrame_symbol_locked, METH_NOARGS,
 	 drgn_StackFrame_symbol_DOC},
-	{"register", (PyCFunction)StackFrame_register,
+	{"register", (PyCFunction)StackFrame_register_locked,
 	 METH_O, drgn_StackFrame_register_DOC},
-	{"registers", (PyCFunction)StackFrame_registers,
+	{"registers", (PyCFunction)StackFrame_registers_locked,
 	 METH_NOARGS, drgn_StackFrame_registers_DOC},
 	{},
 };
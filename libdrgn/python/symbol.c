@@ -5,13 +5,13 @@
 
 #include "drgnpy.h"
 
-PyObject *Symbol_wrap(struct drgn_symbol *sym, Program *prog)
+PyObject *Symbol_wrap(const struct drgn_symbol *sym, Program *prog)
 {
 	Symbol *ret;
 
 	ret = (Symbol *)Symbol_type.tp_alloc(&Symbol_type, 0);
 	if (ret) {
-		ret->sym = sym;
+		ret->sym = *sym;
 		ret->prog = prog;
 		Py_INCREF(prog);
 	}
@@ -20,7 +20,6 @@ PyObject *Symbol_wrap(struct drgn_symbol *sym, Program *prog)
 
 static void Symbol_dealloc(Symbol *self)
 {
-	drgn_symbol_destroy(self->sym);
 	Py_XDECREF(self->prog);
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
@@ -30,11 +29,11 @@ static PyObject *Symbol_repr(Symbol *self)
 	PyObject *tmp, *ret;
 	char address[19], size[19];
 
-	tmp = PyUnicode_FromString(drgn_symbol_name(self->sym));
+	tmp = PyUnicode_FromString(drgn_symbol_name(&self->sym));
 	if (!tmp)
 		return NULL;
-	sprintf(address, "0x%" PRIx64, drgn_symbol_address(self->sym));
-	sprintf(size, "0x%" PRIx64, drgn_symbol_size(self->sym));
+	sprintf(address, "0x%" PRIx64, drgn_symbol_address(&self->sym));
+	sprintf(size, "0x%" PRIx64, drgn_symbol_size(&self->sym));
 	ret = PyUnicode_FromFormat("Symbol(name=%R, address=%s, size=%s)", tmp,
 				   address, size);
 	Py_DECREF(tmp);
@@ -48,7 +47,7 @@ static PyObject *Symbol_richcompare(Symbol *self, PyObject *other, int op)
 	if (!PyObject_TypeCheck(other, &Symbol_type) ||
 	    (op != Py_EQ && op != Py_NE))
 		Py_RETURN_NOTIMPLEMENTED;
-	ret = drgn_symbol_eq(self->sym, ((Symbol *)other)->sym);
+	ret = drgn_symbol_eq(&self->sym, &((Symbol *)other)->sym);
 	if (op == Py_NE)
 		ret = !ret;
 	if (ret)
@@ -59,17 +58,17 @@ static PyObject *Symbol_richcompare(Symbol *self, PyObject *other, int op)
 
 static PyObject *Symbol_get_name(Symbol *self, void *arg)
 {
-	return PyUnicode_FromString(drgn_symbol_name(self->sym));
+	return PyUnicode_FromString(drgn_symbol_name(&self->sym));
 }
 
 static PyObject *Symbol_get_address(Symbol *self, void *arg)
 {
-	return PyLong_FromUnsignedLongLong(drgn_symbol_address(self->sym));
+	return PyLong_FromUnsignedLongLong(drgn_symbol_address(&self->sym));
 }
 
 static PyObject *Symbol_get_size(Symbol *self, void *arg)
 {
-	return PyLong_FromUnsignedLongLong(drgn_symbol_size(self->sym));
+	return PyLong_FromUnsignedLongLong(drgn_symbol_size(&self->sym));
 }
 
 static PyGetSetDef Symbol_getset[] = {
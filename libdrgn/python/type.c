@@ -374,6 +374,10 @@ static PyObject *DrgnType_getter(DrgnType *self, struct DrgnType_Attr *attr)
 	return value;
 }
 
+DRGNPY_LOCKED(PyObject *, NULL, DrgnType_getter,
+	      (DrgnType *self, struct DrgnType_Attr *attr), (self, attr),
+	      DrgnType_prog(self))
+
 static PyGetSetDef DrgnType_getset[] = {
 	{"_ptr", (getter)DrgnType_get_ptr, NULL,
 "Address of underlying ``struct drgn_type``.\n"
@@ -382,33 +386,33 @@ static PyGetSetDef DrgnType_getset[] = {
 "\n"
 ":vartype: int"},
 	{"prog", (getter)DrgnType_get_prog, NULL, drgn_Type_prog_DOC},
-	{"kind", (getter)DrgnType_getter, NULL,
+	{"kind", (getter)DrgnType_getter_locked, NULL,
 	 drgn_Type_kind_DOC, &DrgnType_attr_kind},
-	{"primitive", (getter)DrgnType_getter, NULL, drgn_Type_primitive_DOC,
-	 &DrgnType_attr_primitive},
-	{"qualifiers", (getter)DrgnType_getter, NULL, drgn_Type_qualifiers_DOC,
-	 &DrgnType_attr_qualifiers},
+	{"primitive", (getter)DrgnType_getter_locked, NULL,
+	 drgn_Type_primitive_DOC, &DrgnType_attr_primitive},
+	{"qualifiers", (getter)DrgnType_getter_locked, NULL,
+	 drgn_Type_qualifiers_DOC, &DrgnType_attr_qualifiers},
 	{"language", (getter)DrgnType_get_language, NULL,
 	 drgn_Type_language_DOC},
-	{"name", (getter)DrgnType_getter, NULL, drgn_Type_name_DOC,
+	{"name", (getter)DrgnType_getter_locked, NULL, drgn_Type_name_DOC,
 	 &DrgnType_attr_name},
-	{"tag", (getter)DrgnType_getter, NULL, drgn_Type_tag_DOC,
+	{"tag", (getter)DrgnType_getter_locked, NULL, drgn_Type_tag_DOC,
 	 &DrgnType_attr_tag},
-	{"size", (getter)DrgnType_getter, NULL, drgn_Type_size_DOC,
+	{"size", (getter)DrgnType_getter_locked, NULL, drgn_Type_size_DOC,
 	 &DrgnType_attr_size},
-	{"length", (getter)DrgnType_getter, NULL, drgn_Type_length_DOC,
+	{"length", (getter)DrgnType_getter_locked, NULL, drgn_Type_length_DOC,
 	 &DrgnType_attr_length},
-	{"is_signed", (getter)DrgnType_getter, NULL, drgn_Type_is_signed_DOC,
-	 &DrgnType_attr_is_signed},
-	{"type", (getter)DrgnType_getter, NULL, drgn_Type_type_DOC,
+	{"is_signed", (getter)DrgnType_getter_locked, NULL,
+	 drgn_Type_is_signed_DOC, &DrgnType_attr_is_signed},
+	{"type", (getter)DrgnType_getter_locked, NULL, drgn_Type_type_DOC,
 	 &DrgnType_attr_type},
-	{"members", (getter)DrgnType_getter, NULL, drgn_Type_members_DOC,
+	{"members", (getter)DrgnType_getter_locked, NULL, drgn_Type_members_DOC,
 	 &DrgnType_attr_members},
-	{"enumerators", (getter)DrgnType_getter, NULL,
+	{"enumerators", (getter)DrgnType_getter_locked, NULL,
 	 drgn_Type_enumerators_DOC, &DrgnType_attr_enumerators},
-	{"parameters", (getter)DrgnType_getter, NULL, drgn_Type_parameters_DOC,
-	 &DrgnType_attr_parameters},
-	{"is_variadic", (getter)DrgnType_getter, NULL,
+	{"parameters", (getter)DrgnType_getter_locked, NULL,
+	 drgn_Type_parameters_DOC, &DrgnType_attr_parameters},
+	{"is_variadic", (getter)DrgnType_getter_locked, NULL,
 	 drgn_Type_is_variadic_DOC, &DrgnType_attr_is_variadic},
 	{},
 };
@@ -735,8 +739,20 @@ static PyObject *DrgnType_has_member(DrgnType *self, PyObject *args,
 		Py_RETURN_FALSE;
 }
 
+/* Entry points which don't release the GIL. See Program_lock(). */
+DRGNPY_LOCKED_NOARGS(PyObject *, DrgnType, DrgnType_type_name,
+		     DrgnType_prog(self))
+DRGNPY_LOCKED_KEYWORDS(TypeMember *, DrgnType, DrgnType_member,
+		       DrgnType_prog(self))
+DRGNPY_LOCKED_KEYWORDS(PyObject *, DrgnType, DrgnType_has_member,
+		       DrgnType_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnType_repr, (DrgnType *self), (self),
+	      DrgnType_prog(self))
+DRGNPY_LOCKED(PyObject *, NULL, DrgnType_str, (DrgnType *self), (self),
+	      DrgnType_prog(self))
+
 static PyMethodDef DrgnType_methods[] = {
-	{"type_name", (PyCFunction)DrgnType_type_name, METH_NOARGS,
+	{"type_name", (PyCFunction)DrgnType_type_name_locked, METH_NOARGS,
 	 drgn_Type_type_name_DOC},
 	{"is_complete", (PyCFunction)DrgnType_is_complete, METH_NOARGS,
 	 drgn_Type_is_complete_DOC},
@@ -744,9 +760,9 @@ static PyMethodDef DrgnType_methods[] = {
 	 METH_VARARGS | METH_KEYWORDS, drgn_Type_qualified_DOC},
 	{"unqualified", (PyCFunction)DrgnType_unqualified, METH_NOARGS,
 	 drgn_Type_unqualified_DOC},
-	{"member", (PyCFunction)DrgnType_member, METH_VARARGS | METH_KEYWORDS,
-	 drgn_Type_member_DOC},
-	{"has_member", (PyCFunction)DrgnType_has_member,
+	{"member", (PyCFunction)DrgnType_member_locked,
+	 METH_VARARGS | METH_KEYWORDS, drgn_Type_member_DOC},
+	{"has_member", (PyCFunction)DrgnType_has_member_locked,
 	 METH_VARARGS | METH_KEYWORDS, drgn_Type_has_member_DOC},
 	{},
 };
@@ -756,8 +772,8 @@ PyTypeObject DrgnType_type = {
 	.tp_name = "_drgn.Type",
 	.tp_basicsize = sizeof(DrgnType),
 	.tp_dealloc = (destructor)DrgnType_dealloc,
-	.tp_repr = (reprfunc)DrgnType_repr,
-	.tp_str = (reprfunc)DrgnType_str,
+	.tp_repr = (reprfunc)DrgnType_repr_locked,
+	.tp_str = (reprfunc)DrgnType_str_locked,
 	.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
 	.tp_doc = drgn_Type_DOC,
 	.tp_traverse = (traverseproc)DrgnType_traverse,
@@ -882,14 +898,22 @@ static DrgnType *LazyType_get_borrowed(LazyType *self)
 				return NULL;
 			}
 		} else {
+			/* obj is the Type that the lazy type belongs to. */
+			Program *prog = DrgnType_prog((DrgnType *)self->obj);
 			bool clear = false;
 			/* Avoid the thread state overhead if we can. */
 			if (!drgn_lazy_type_is_evaluated(self->lazy_type))
 				clear = set_drgn_in_python();
+			if (Program_lock(prog)) {
+				if (clear)
+					clear_drgn_in_python();
+				return NULL;
+			}
 			struct drgn_qualified_type qualified_type;
 			struct drgn_error *err =
 				drgn_lazy_type_evaluate(self->lazy_type,
 							&qualified_type);
+			Program_unlock(prog);
 			if (clear)
 				clear_drgn_in_python();
 			if (err)
@@ -1376,7 +1400,7 @@ py_type_thunk_evaluate_fn(struct drgn_type_thunk *thunk,
 			  struct drgn_qualified_type *ret)
 {
 	struct py_type_thunk *t = container_of(thunk, struct py_type_thunk, thunk);
-	PyGILState_STATE gstate = PyGILState_Ensure();
+	PyGILState_STATE gstate = drgnpy_gilstate_ensure();
 	DrgnType *type = LazyType_get_borrowed(t->lazy_type);
 	struct drgn_error *err;
 	if (type) {
@@ -1386,7 +1410,7 @@ py_type_thunk_evaluate_fn(struct drgn_type_thunk *thunk,
 	} else {
 		err = drgn_error_from_python();
 	}
-	PyGILState_Release(gstate);
+	drgnpy_gilstate_release(gstate);
 	return err;
 }
 
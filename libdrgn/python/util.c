@@ -44,6 +44,56 @@ int append_format(PyObject *parts, const char *format, ...)
 	return ret;
 }
 
+#if PY_VERSION_HEX >= 0x030d0000
+int drgnpy_parse_tuple_and_keywords(PyObject *args, PyObject *kwds,
+				    drgnpy_arg_parser *parser, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, parser);
+	ret = PyArg_VaParseTupleAndKeywords(args, kwds, parser->format,
+					    (char **)parser->keywords, ap);
+	va_end(ap);
+	return ret;
+}
+
+int drgnpy_parse_fastcall(PyObject *const *args, Py_ssize_t nargs,
+			  PyObject *kwnames, drgnpy_arg_parser *parser, ...)
+{
+	va_list ap;
+	int ret = 0;
+	PyObject *tuple, *dict = NULL;
+
+	tuple = PyTuple_New(nargs);
+	if (!tuple)
+		return 0;
+	for (Py_ssize_t i = 0; i < nargs; i++) {
+		Py_INCREF(args[i]);
+		PyTuple_SET_ITEM(tuple, i, args[i]);
+	}
+	if (kwnames) {
+		dict = PyDict_New();
+		if (!dict)
+			goto out;
+		for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(kwnames); i++) {
+			if (PyDict_SetItem(dict, PyTuple_GET_ITEM(kwnames, i),
+					   args[nargs + i]))
+				goto out;
+		}
+	}
+
+	va_start(ap, parser);
+	ret = PyArg_VaParseTupleAndKeywords(tuple, dict, parser->format,
+					    (char **)parser->keywords, ap);
+	va_end(ap);
+out:
+	Py_XDECREF(dict);
+	Py_DECREF(tuple);
+	return ret;
+}
+#endif
+
 PyObject *byteorder_string(bool little_endian)
 {
 	_Py_IDENTIFIER(little);
@@ -0,0 +1,91 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// SPDX-License-Identifier: GPL-3.0+
+
+/**
+ * @file
+ *
+ * Register state of a stack frame.
+ *
+ * See @ref RegisterState.
+ */
+
+#ifndef DRGN_REGISTER_STATE_H
+#define DRGN_REGISTER_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Internals
+ *
+ * @defgroup RegisterState Register state
+ *
+ * Register values of a stack frame.
+ *
+ * Registers are indexed by DWARF register number. Only the registers needed
+ * for unwinding (the general-purpose registers and the program counter) are
+ * tracked, so this is small enough to store for every frame in a stack trace.
+ *
+ * @{
+ */
+
+/**
+ * Maximum number of registers in a @ref drgn_register_state. Registers with a
+ * DWARF register number greater than or equal to this are never known.
+ */
+#define DRGN_MAX_REGISTERS 32
+
+/** Register values of a stack frame. */
+struct drgn_register_state {
+	/** Register values indexed by DWARF register number. */
+	uint64_t regs[DRGN_MAX_REGISTERS];
+	/** Bitmask of the registers in @ref regs which are known. */
+	uint32_t known;
+	/**
+	 * Whether the program counter is where the frame was interrupted (or
+	 * the initial frame) rather than a return address.
+	 */
+	bool interrupted;
+};
+
+/** Initialize a @ref drgn_register_state with no known registers. */
+static inline void drgn_register_state_init(struct drgn_register_state *regs,
+					    bool interrupted)
+{
+	regs->known = 0;
+	regs->interrupted = interrupted;
+}
+
+/** Return whether a register is known. */
+static inline bool
+drgn_register_state_has(const struct drgn_register_state *regs,
+			uint64_t regno)
+{
+	return regno < DRGN_MAX_REGISTERS &&
+	       (regs->known & (UINT32_C(1) << regno));
+}
+
+/**
+ * Set the value of a register. Registers that aren't tracked are silently
+ * ignored.
+ */
+static inline void drgn_register_state_set(struct drgn_register_state *regs,
+					   uint64_t regno, uint64_t value)
+{
+	if (regno < DRGN_MAX_REGISTERS) {
+		regs->regs[regno] = value;
+		regs->known |= UINT32_C(1) << regno;
+	}
+}
+
+/** Mark a register as unknown. */
+static inline void drgn_register_state_unset(struct drgn_register_state *regs,
+					     uint64_t regno)
+{
+	if (regno < DRGN_MAX_REGISTERS)
+		regs->known &= ~(UINT32_C(1) << regno);
+}
+
+/** @} */
+
+#endif /* DRGN_REGISTER_STATE_H */
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: GPL-3.0+
 
 #include <assert.h>
+#include <byteswap.h>
+#include <dwarf.h>
 #include <elfutils/libdw.h>
 #include <elfutils/libdwfl.h>
 #include <inttypes.h>
@@ -9,13 +11,17 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include "binary_buffer.h"
+#include "cfi.h"
 #include "debug_info.h"
 #include "drgn.h"
 #include "error.h"
 #include "hash_table.h"
 #include "helpers.h"
+#include "orc.h"
 #include "platform.h"
 #include "program.h"
+#include "register_state.h"
 #include "string_builder.h"
 #include "symbol.h"
 #include "type.h"
@@ -23,20 +29,35 @@
 
 struct drgn_stack_trace {
 	struct drgn_program *prog;
-	union {
-		size_t capacity;
-		Dwfl_Thread *thread;
-	};
 	size_t num_frames;
-	Dwfl_Frame *frames[];
+	/*
+	 * Registers of each frame. These don't refer to any libdwfl state, so
+	 * a trace is valid for as long as the program is.
+	 */
+	struct drgn_register_state frames[];
 };
 
 LIBDRGN_PUBLIC void drgn_stack_trace_destroy(struct drgn_stack_trace *trace)
 {
-	dwfl_detach_thread(trace->thread);
 	free(trace);
 }
 
+static void drgn_stack_frame_pc_internal(struct drgn_stack_frame frame,
+					 uint64_t *pc_ret, bool *interrupted_ret)
+{
+	const struct drgn_register_state *regs = &frame.trace->frames[frame.i];
+	*pc_ret = regs->regs[frame.trace->prog->platform.arch->pc_regno];
+	if (interrupted_ret)
+		*interrupted_ret = regs->interrupted;
+}
+
+static Dwfl_Module *drgn_stack_frame_dwfl_module(struct drgn_stack_frame frame,
+						 uint64_t pc, bool interrupted)
+{
+	return dwfl_addrmodule(frame.trace->prog->_dbinfo->dwfl,
+			       pc - !interrupted);
+}
+
 LIBDRGN_PUBLIC
 size_t drgn_stack_trace_num_frames(struct drgn_stack_trace *trace)
 {
@@ -51,7 +72,7 @@ drgn_format_stack_trace(struct drgn_stack_trace *trace, char **ret)
 	struct drgn_stack_frame frame = { .trace = trace, };
 
 	for (; frame.i < trace->num_frames; frame.i++) {
-		Dwarf_Addr pc;
+		uint64_t pc;
 		bool isactivation;
 		Dwfl_Module *module;
 		struct drgn_symbol sym;
@@ -61,8 +82,8 @@ drgn_format_stack_trace(struct drgn_stack_trace *trace, char **ret)
 			goto err;
 		}
 
-		dwfl_frame_pc(trace->frames[frame.i], &pc, &isactivation);
-		module = dwfl_frame_module(trace->frames[frame.i]);
+		drgn_stack_frame_pc_internal(frame, &pc, &isactivation);
+		module = drgn_stack_frame_dwfl_module(frame, pc, isactivation);
 		if (module &&
 		    drgn_program_find_symbol_by_address_internal(trace->prog,
 								 pc - !isactivation,
@@ -101,24 +122,24 @@ err:
 
 LIBDRGN_PUBLIC uint64_t drgn_stack_frame_pc(struct drgn_stack_frame frame)
 {
-	Dwarf_Addr pc;
+	uint64_t pc;
 
-	dwfl_frame_pc(frame.trace->frames[frame.i], &pc, NULL);
+	drgn_stack_frame_pc_internal(frame, &pc, NULL);
 	return pc;
 }
 
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_stack_frame_symbol(struct drgn_stack_frame frame, struct drgn_symbol **ret)
 {
-	Dwarf_Addr pc;
+	uint64_t pc;
 	bool isactivation;
 	Dwfl_Module *module;
 	struct drgn_symbol *sym;
 
-	dwfl_frame_pc(frame.trace->frames[frame.i], &pc, &isactivation);
+	drgn_stack_frame_pc_internal(frame, &pc, &isactivation);
+	module = drgn_stack_frame_dwfl_module(frame, pc, isactivation);
 	if (!isactivation)
 		pc--;
-	module = dwfl_frame_module(frame.trace->frames[frame.i]);
 	if (!module)
 		return drgn_error_symbol_not_found(pc);
 	sym = malloc(sizeof(*sym));
@@ -137,13 +158,12 @@ LIBDRGN_PUBLIC struct drgn_error *
 drgn_stack_frame_register(struct drgn_stack_frame frame,
 			  enum drgn_register_number regno, uint64_t *ret)
 {
-	Dwarf_Addr value;
-
-	if (!dwfl_frame_register(frame.trace->frames[frame.i], regno, &value)) {
+	const struct drgn_register_state *regs = &frame.trace->frames[frame.i];
+	if (!drgn_register_state_has(regs, regno)) {
 		return drgn_error_create(DRGN_ERROR_LOOKUP,
 					 "register value is not known");
 	}
-	*ret = value;
+	*ret = regs->regs[regno];
 	return NULL;
 }
 
@@ -162,59 +182,120 @@ drgn_stack_frame_register_by_name(struct drgn_stack_frame frame,
 	return drgn_stack_frame_register(frame, reg->number, ret);
 }
 
-static bool drgn_thread_memory_read(Dwfl *dwfl, Dwarf_Addr addr,
-				    Dwarf_Word *result, void *dwfl_arg)
+/*
+ * Locks used by drgn_program_stack_traces() while unwinding in parallel.
+ * libdwfl isn't thread-safe, so module lookups and the first use of a
+ * module's ORC or CFI (which is parsed with libdwfl) are done with dwfl held.
+ * After that, the parsed tables are only read, so searching them and applying
+ * the rules is done without any lock. memory is passed to
+ * drgn_memory_reader_read_locked(), which only holds it for segment lookups
+ * and read callbacks that aren't thread-safe.
+ */
+struct drgn_stack_trace_locks {
+	omp_lock_t dwfl;
+	omp_lock_t memory;
+};
+
+/* State for unwinding a single thread. */
+struct drgn_stack_trace_state {
+	struct drgn_program *prog;
+	/* Object to get the initial registers from, or NULL to use tid. */
+	const struct drgn_object *obj;
+	uint32_t tid;
+	/* Registers of the first frame. */
+	struct drgn_register_state initial;
+	/* Locks if unwinding in parallel, NULL otherwise. */
+	struct drgn_stack_trace_locks *locks;
+};
+
+static inline void
+drgn_stack_trace_lock_dwfl(struct drgn_stack_trace_state *state)
 {
-	struct drgn_error *err;
-	struct drgn_program *prog = dwfl_arg;
-	uint64_t word;
+	if (state->locks)
+		omp_set_lock(&state->locks->dwfl);
+}
 
-	err = drgn_program_read_word(prog, addr, false, &word);
-	if (err) {
-		if (err->code == DRGN_ERROR_FAULT) {
-			/*
-			 * This could be the end of the stack trace, so it shouldn't be
-			 * fatal.
-			 */
-			drgn_error_destroy(err);
-		} else {
-			drgn_error_destroy(prog->stack_trace_err);
-			prog->stack_trace_err = err;
-		}
-		return false;
-	}
-	*result = word;
-	return true;
+static inline void
+drgn_stack_trace_unlock_dwfl(struct drgn_stack_trace_state *state)
+{
+	if (state->locks)
+		omp_unset_lock(&state->locks->dwfl);
 }
 
 /*
- * We only care about the specific thread that we're unwinding, so we return it
- * with an arbitrary TID.
+ * Read memory while unwinding. A fault is not an error since it could be the
+ * end of the stack trace; it sets *found_ret to false.
  */
-#define STACK_TRACE_OBJ_TID 1
-static pid_t drgn_object_stack_trace_next_thread(Dwfl *dwfl, void *dwfl_arg,
-						 void **thread_argp)
+static struct drgn_error *
+drgn_stack_trace_read_memory(struct drgn_stack_trace_state *state,
+			     uint64_t address, void *buf, size_t count,
+			     bool *found_ret)
 {
-	struct drgn_program *prog = dwfl_arg;
+	struct drgn_error *err;
 
-	if (*thread_argp)
-		return 0;
-	*thread_argp = prog;
-	return STACK_TRACE_OBJ_TID;
+	if (state->locks) {
+		err = drgn_memory_reader_read_locked(&state->prog->reader, buf,
+						     address, count, false,
+						     &state->locks->memory);
+	} else {
+		err = drgn_program_read_memory(state->prog, buf, address,
+					       count, false);
+	}
+	if (err && err->code == DRGN_ERROR_FAULT) {
+		drgn_error_destroy(err);
+		*found_ret = false;
+		return NULL;
+	}
+	*found_ret = !err;
+	return err;
 }
 
+/* Like drgn_stack_trace_read_memory(), but read a word in program byte order. */
 static struct drgn_error *
-drgn_get_stack_trace_obj(struct drgn_object *res, struct drgn_program *prog,
+drgn_stack_trace_read_word(struct drgn_stack_trace_state *state,
+			   uint64_t address, uint64_t *ret, bool *found_ret)
+{
+	struct drgn_error *err;
+	bool is_64_bit, bswap;
+
+	err = drgn_program_is_64_bit(state->prog, &is_64_bit);
+	if (err)
+		return err;
+	err = drgn_program_bswap(state->prog, &bswap);
+	if (err)
+		return err;
+	if (is_64_bit) {
+		uint64_t tmp;
+		err = drgn_stack_trace_read_memory(state, address, &tmp,
+						   sizeof(tmp), found_ret);
+		if (err || !*found_ret)
+			return err;
+		*ret = bswap ? bswap_64(tmp) : tmp;
+	} else {
+		uint32_t tmp;
+		err = drgn_stack_trace_read_memory(state, address, &tmp,
+						   sizeof(tmp), found_ret);
+		if (err || !*found_ret)
+			return err;
+		*ret = bswap ? bswap_32(tmp) : tmp;
+	}
+	return NULL;
+}
+
+static struct drgn_error *
+drgn_get_stack_trace_obj(struct drgn_object *res,
+			 struct drgn_stack_trace_state *state,
 			 bool *is_pt_regs_ret)
 {
 	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
 	struct drgn_type *type;
 
-	type = drgn_underlying_type(prog->stack_trace_obj->type);
+	type = drgn_underlying_type(state->obj->type);
 	if (drgn_type_kind(type) == DRGN_TYPE_STRUCT &&
 	    strcmp(drgn_type_tag(type), "pt_regs") == 0) {
 		*is_pt_regs_ret = true;
-		return drgn_object_read(res, prog->stack_trace_obj);
+		return drgn_object_read(res, state->obj);
 	}
 
 	if (drgn_type_kind(type) != DRGN_TYPE_POINTER)
@@ -226,7 +307,7 @@ drgn_get_stack_trace_obj(struct drgn_object *res, struct drgn_program *prog,
 	if ((prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) &&
 	    strcmp(drgn_type_tag(type), "task_struct") == 0) {
 		*is_pt_regs_ret = false;
-		return drgn_object_read(res, prog->stack_trace_obj);
+		return drgn_object_read(res, state->obj);
 	} else if (strcmp(drgn_type_tag(type), "pt_regs") == 0) {
 		*is_pt_regs_ret = true;
 		/*
@@ -234,7 +315,7 @@ drgn_get_stack_trace_obj(struct drgn_object *res, struct drgn_program *prog,
 		 * the rule of not modifying the result on error, but we
 		 * don't care in this context.
 		 */
-		err = drgn_object_dereference(res, prog->stack_trace_obj);
+		err = drgn_object_dereference(res, state->obj);
 		if (err)
 			return err;
 		return drgn_object_read(res, res);
@@ -247,22 +328,28 @@ type_error:
 				 ", struct task_struct *" : "");
 }
 
-static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
-					      void *thread_arg)
+/*
+ * Get the initial registers of a thread into state->initial. This looks up
+ * objects and types, so it may not be called in parallel.
+ */
+static struct drgn_error *
+drgn_stack_trace_get_initial_registers(struct drgn_stack_trace_state *state)
 {
 	struct drgn_error *err;
-	struct drgn_program *prog = thread_arg;
+	struct drgn_program *prog = state->prog;
+	struct drgn_register_state *regs = &state->initial;
 	struct drgn_object obj;
 	struct drgn_object tmp;
 	struct string prstatus;
 
+	drgn_register_state_init(regs, true);
 	drgn_object_init(&obj, prog);
 	drgn_object_init(&tmp, prog);
 
 	/* First, try pt_regs. */
-	if (prog->stack_trace_obj) {
+	if (state->obj) {
 		bool is_pt_regs;
-		err = drgn_get_stack_trace_obj(&obj, prog, &is_pt_regs);
+		err = drgn_get_stack_trace_obj(&obj, state, &is_pt_regs);
 		if (err)
 			goto out;
 
@@ -275,8 +362,8 @@ static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 							prog->platform.arch->name);
 				goto out;
 			}
-			err = prog->platform.arch->pt_regs_set_initial_registers(thread,
-										 &obj);
+			err = prog->platform.arch->pt_regs_set_initial_registers(&obj,
+										 regs);
 			goto out;
 		}
 	} else if (prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) {
@@ -287,7 +374,7 @@ static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 		err = drgn_object_address_of(&tmp, &tmp);
 		if (err)
 			goto out;
-		err = linux_helper_find_task(&obj, &tmp, prog->stack_trace_tid);
+		err = linux_helper_find_task(&obj, &tmp, state->tid);
 		if (err)
 			goto out;
 		bool found;
@@ -386,11 +473,10 @@ static bool drgn_thread_set_initial_registers(Dwfl_Thread *thread,
 						prog->platform.arch->name);
 			goto out;
 		}
-		err = prog->platform.arch->linux_kernel_set_initial_registers(thread,
-									      &obj);
+		err = prog->platform.arch->linux_kernel_set_initial_registers(&obj,
+									      regs);
 	} else {
-		err = drgn_program_find_prstatus_by_tid(prog,
-							prog->stack_trace_tid,
+		err = drgn_program_find_prstatus_by_tid(prog, state->tid,
 							&prstatus);
 		if (err)
 			goto out;
@@ -406,140 +492,1020 @@ prstatus:
 			goto out;
 		}
 		err = prog->platform.arch->prstatus_set_initial_registers(prog,
-									  thread,
 									  prstatus.str,
-									  prstatus.len);
+									  prstatus.len,
+									  regs);
 	}
 
 out:
 	drgn_object_deinit(&tmp);
 	drgn_object_deinit(&obj);
-	if (err) {
-		drgn_error_destroy(prog->stack_trace_err);
-		prog->stack_trace_err = err;
-		return false;
+	return err;
+}
+
+/*
+ * Find the module containing an address (or NULL if there isn't one) and parse
+ * its ORC information if @p orc is true or its CFI otherwise, so that it can be
+ * searched without any lock.
+ */
+static struct drgn_error *
+drgn_unwind_find_module(struct drgn_stack_trace_state *state, Dwfl *dwfl,
+			uint64_t pc, bool orc,
+			struct drgn_debug_info_module **ret)
+{
+	struct drgn_error *err = NULL;
+	struct drgn_debug_info_module *module = NULL;
+
+	drgn_stack_trace_lock_dwfl(state);
+	Dwfl_Module *dwfl_module = dwfl_addrmodule(dwfl, pc);
+	if (dwfl_module) {
+		void **userdatap;
+		dwfl_module_info(dwfl_module, &userdatap, NULL, NULL, NULL,
+				 NULL, NULL, NULL);
+		module = *userdatap;
+		if (orc)
+			err = drgn_debug_info_module_parse_orc(state->prog,
+							       module);
+		else
+			err = drgn_debug_info_module_parse_cfi(module);
 	}
-	return true;
+	drgn_stack_trace_unlock_dwfl(state);
+	*ret = module;
+	return err;
+}
+
+/* Return whether an address is in any module. */
+static bool drgn_unwind_in_module(struct drgn_stack_trace_state *state,
+				  Dwfl *dwfl, uint64_t pc)
+{
+	drgn_stack_trace_lock_dwfl(state);
+	bool ret = dwfl_addrmodule(dwfl, pc) != NULL;
+	drgn_stack_trace_unlock_dwfl(state);
+	return ret;
+}
+
+/* Map from struct pt_regs (in units of 8 bytes) to DWARF register numbers. */
+static const enum drgn_register_number drgn_orc_pt_regs[] = {
+	DRGN_REGISTER_X86_64_r15,
+	DRGN_REGISTER_X86_64_r14,
+	DRGN_REGISTER_X86_64_r13,
+	DRGN_REGISTER_X86_64_r12,
+	DRGN_REGISTER_X86_64_rbp,
+	DRGN_REGISTER_X86_64_rbx,
+	DRGN_REGISTER_X86_64_r11,
+	DRGN_REGISTER_X86_64_r10,
+	DRGN_REGISTER_X86_64_r9,
+	DRGN_REGISTER_X86_64_r8,
+	DRGN_REGISTER_X86_64_rax,
+	DRGN_REGISTER_X86_64_rcx,
+	DRGN_REGISTER_X86_64_rdx,
+	DRGN_REGISTER_X86_64_rsi,
+	DRGN_REGISTER_X86_64_rdi,
+};
+/* Offsets in struct pt_regs (in units of 8 bytes) of the interrupt frame. */
+#define DRGN_ORC_PT_REGS_IP 16
+#define DRGN_ORC_PT_REGS_CS 17
+#define DRGN_ORC_PT_REGS_SP 19
+#define DRGN_ORC_PT_REGS_SIZE 21
+
+/*
+ * Maximum number of times that a stack trace may switch stacks (e.g., from an
+ * interrupt stack to a task stack). Any other step must move up the stack, so
+ * this guarantees that unwinding bad data terminates.
+ */
+#define DRGN_ORC_MAX_STACK_SWITCHES 16
+
+/*
+ * Get the ORC entry for a frame. This is the equivalent of orc_find() in the
+ * kernel.
+ */
+static struct drgn_error *
+drgn_orc_find_entry(struct drgn_stack_trace_state *state, Dwfl *dwfl,
+		    uint64_t pc, const struct drgn_orc_entry **ret)
+{
+	struct drgn_error *err;
+
+	*ret = NULL;
+	struct drgn_debug_info_module *module;
+	err = drgn_unwind_find_module(state, dwfl, pc, true, &module);
+	if (err || !module)
+		return err;
+	*ret = drgn_debug_info_module_find_orc(module, pc);
+	return NULL;
 }
 
-static int drgn_append_stack_frame(Dwfl_Frame *state, void *arg)
+/*
+ * Unwind one frame with ORC, following unwind_next_frame() in the kernel. If
+ * the caller can't be unwound, *found_ret is set to false.
+ */
+static struct drgn_error *
+drgn_orc_unwind_frame(struct drgn_stack_trace_state *state, Dwfl *dwfl,
+		      const struct drgn_register_state *frame,
+		      struct drgn_register_state *caller, int *stack_switches,
+		      bool *found_ret)
 {
-	struct drgn_stack_trace **tracep = arg;
-	struct drgn_stack_trace *trace = *tracep;
+	struct drgn_error *err;
 
-	if (trace->num_frames >= trace->capacity) {
-		struct drgn_stack_trace *tmp;
-		size_t new_capacity, bytes;
+	*found_ret = false;
+	/*
+	 * For a call, the program counter is the return address, which may
+	 * belong to a different ORC entry than the call instruction itself
+	 * (e.g., if the callee doesn't return).
+	 */
+	uint64_t pc = frame->regs[DRGN_REGISTER_X86_64_rip];
+	const struct drgn_orc_entry *orc;
+	err = drgn_orc_find_entry(state, dwfl, frame->interrupted ? pc : pc - 1,
+				  &orc);
+	if (err)
+		return err;
+	if (!orc) {
+		/* Like the kernel, assume that it uses a frame pointer. */
+		orc = &drgn_orc_fp_entry;
+	} else if (orc->type == DRGN_ORC_TYPE_UNDEFINED ||
+		   orc->type == DRGN_ORC_TYPE_END_OF_STACK) {
+		return NULL;
+	}
+
+	/* Find the caller's stack pointer. */
+	enum drgn_register_number sp_regno;
+	switch (orc->sp_reg) {
+	case DRGN_ORC_REG_SP:
+	case DRGN_ORC_REG_SP_INDIRECT:
+		sp_regno = DRGN_REGISTER_X86_64_rsp;
+		break;
+	case DRGN_ORC_REG_BP:
+	case DRGN_ORC_REG_BP_INDIRECT:
+		sp_regno = DRGN_REGISTER_X86_64_rbp;
+		break;
+	case DRGN_ORC_REG_R10:
+		sp_regno = DRGN_REGISTER_X86_64_r10;
+		break;
+	case DRGN_ORC_REG_R13:
+		sp_regno = DRGN_REGISTER_X86_64_r13;
+		break;
+	case DRGN_ORC_REG_DI:
+		sp_regno = DRGN_REGISTER_X86_64_rdi;
+		break;
+	case DRGN_ORC_REG_DX:
+		sp_regno = DRGN_REGISTER_X86_64_rdx;
+		break;
+	default:
+		return NULL;
+	}
+	if (!drgn_register_state_has(frame, sp_regno))
+		return NULL;
+	uint64_t sp = frame->regs[sp_regno];
+	bool switched_stack = false;
+	switch (orc->sp_reg) {
+	case DRGN_ORC_REG_SP:
+	case DRGN_ORC_REG_BP:
+		sp += orc->sp_offset;
+		break;
+	case DRGN_ORC_REG_SP_INDIRECT:
+	case DRGN_ORC_REG_BP_INDIRECT:
+		if (orc->sp_reg == DRGN_ORC_REG_BP_INDIRECT)
+			sp += orc->sp_offset;
+		err = drgn_stack_trace_read_memory(state, sp, &sp, sizeof(sp),
+						   found_ret);
+		if (err || !*found_ret)
+			return err;
+		if (orc->sp_reg == DRGN_ORC_REG_SP_INDIRECT)
+			sp += orc->sp_offset;
+		switched_stack = true;
+		break;
+	default:
+		break;
+	}
 
-		if (__builtin_mul_overflow(2U, trace->capacity,
-					   &new_capacity) ||
-		    __builtin_mul_overflow(new_capacity,
-					   sizeof(trace->frames[0]), &bytes) ||
-		    __builtin_add_overflow(bytes, sizeof(*trace), &bytes) ||
-		    !(tmp = realloc(trace, bytes))) {
-			drgn_error_destroy(trace->prog->stack_trace_err);
-			trace->prog->stack_trace_err = &drgn_enomem;
-			return DWARF_CB_ABORT;
+	/* Find the caller's program counter and stack pointer. */
+	drgn_register_state_init(caller, orc->signal);
+	switch (orc->type) {
+	case DRGN_ORC_TYPE_CALL: {
+		uint64_t ret_addr;
+		err = drgn_stack_trace_read_memory(state, sp - 8, &ret_addr,
+						   sizeof(ret_addr), found_ret);
+		if (err || !*found_ret)
+			return err;
+		drgn_register_state_set(caller, DRGN_REGISTER_X86_64_rip,
+					ret_addr);
+		drgn_register_state_set(caller, DRGN_REGISTER_X86_64_rsp, sp);
+		break;
+	}
+	case DRGN_ORC_TYPE_REGS:
+	case DRGN_ORC_TYPE_REGS_PARTIAL: {
+		uint64_t pt_regs[DRGN_ORC_PT_REGS_SIZE];
+		/* For a partial frame, sp points to the interrupt frame. */
+		size_t start = (orc->type == DRGN_ORC_TYPE_REGS ?
+				0 : DRGN_ORC_PT_REGS_IP);
+		err = drgn_stack_trace_read_memory(state, sp, &pt_regs[start],
+						   sizeof(pt_regs) - start * 8,
+						   found_ret);
+		if (err || !*found_ret)
+			return err;
+		/* Stop at user mode registers. */
+		if (pt_regs[DRGN_ORC_PT_REGS_CS] & 3) {
+			*found_ret = false;
+			return NULL;
+		}
+		if (orc->type == DRGN_ORC_TYPE_REGS) {
+			for (size_t i = 0; i < ARRAY_SIZE(drgn_orc_pt_regs);
+			     i++) {
+				drgn_register_state_set(caller,
+							drgn_orc_pt_regs[i],
+							pt_regs[i]);
+			}
+		}
+		drgn_register_state_set(caller, DRGN_REGISTER_X86_64_rip,
+					pt_regs[DRGN_ORC_PT_REGS_IP]);
+		drgn_register_state_set(caller, DRGN_REGISTER_X86_64_rsp,
+					pt_regs[DRGN_ORC_PT_REGS_SP]);
+		/* The interrupted code may have been on a different stack. */
+		switched_stack = true;
+		break;
+	}
+	default:
+		*found_ret = false;
+		return NULL;
+	}
+
+	/* Find the caller's frame pointer. */
+	uint64_t bp;
+	switch (orc->bp_reg) {
+	case DRGN_ORC_REG_UNDEFINED:
+		if (!drgn_register_state_has(caller, DRGN_REGISTER_X86_64_rbp) &&
+		    drgn_register_state_has(frame, DRGN_REGISTER_X86_64_rbp)) {
+			drgn_register_state_set(caller,
+						DRGN_REGISTER_X86_64_rbp,
+						frame->regs[DRGN_REGISTER_X86_64_rbp]);
 		}
-		*tracep = trace = tmp;
-		trace->capacity = new_capacity;
+		break;
+	case DRGN_ORC_REG_PREV_SP:
+	case DRGN_ORC_REG_BP:
+		if (orc->bp_reg == DRGN_ORC_REG_PREV_SP) {
+			bp = sp;
+		} else if (drgn_register_state_has(frame,
+						   DRGN_REGISTER_X86_64_rbp)) {
+			bp = frame->regs[DRGN_REGISTER_X86_64_rbp];
+		} else {
+			*found_ret = false;
+			return NULL;
+		}
+		err = drgn_stack_trace_read_memory(state, bp + orc->bp_offset,
+						   &bp, sizeof(bp), found_ret);
+		if (err || !*found_ret)
+			return err;
+		drgn_register_state_set(caller, DRGN_REGISTER_X86_64_rbp, bp);
+		break;
+	default:
+		*found_ret = false;
+		return NULL;
 	}
-	trace->frames[trace->num_frames++] = state;
-	return DWARF_CB_OK;
+
+	/* Protect against loops caused by bad data. */
+	uint64_t caller_sp = caller->regs[DRGN_REGISTER_X86_64_rsp];
+	if (!caller->regs[DRGN_REGISTER_X86_64_rip]) {
+		*found_ret = false;
+	} else if (switched_stack) {
+		*found_ret = ++*stack_switches <= DRGN_ORC_MAX_STACK_SWITCHES;
+	} else {
+		*found_ret = (!drgn_register_state_has(frame,
+						       DRGN_REGISTER_X86_64_rsp) ||
+			      caller_sp > frame->regs[DRGN_REGISTER_X86_64_rsp]);
+	}
+	return NULL;
 }
 
-static const Dwfl_Thread_Callbacks drgn_linux_kernel_thread_callbacks = {
-	.next_thread = drgn_object_stack_trace_next_thread,
-	.memory_read = drgn_thread_memory_read,
-	.set_initial_registers = drgn_thread_set_initial_registers,
-};
+static struct drgn_error *
+drgn_cfi_expression_error(struct binary_buffer *bb, const char *pos,
+			  const char *message)
+{
+	return drgn_error_format(DRGN_ERROR_OTHER,
+				 "DWARF expression in call frame information: %s",
+				 message);
+}
 
-static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
-					       uint32_t tid,
-					       const struct drgn_object *obj,
-					       struct drgn_stack_trace **ret)
+/* Maximum depth of the stack of a DWARF expression. */
+#define DRGN_CFI_EXPRESSION_STACK_SIZE 64
+/*
+ * Maximum number of operations executed by a DWARF expression. Expressions can
+ * branch, so this guarantees that a bad expression terminates.
+ */
+#define DRGN_CFI_EXPRESSION_MAX_OPS 10000
+
+/*
+ * Evaluate a DWARF expression from call frame information. This only needs to
+ * support the operations allowed in call frame information, which excludes
+ * anything that needs debugging information entries. If the expression
+ * depends on a register or memory that isn't known, *found_ret is set to
+ * false.
+ *
+ * @param[in] cfa If not NULL, the CFA, which is pushed on the stack first.
+ */
+static struct drgn_error *
+drgn_eval_cfi_expression(struct drgn_stack_trace_state *state,
+			 const struct drgn_cfi_rule *rule,
+			 const struct drgn_register_state *regs,
+			 const uint64_t *cfa, uint64_t *ret, bool *found_ret)
 {
 	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+	bool little_endian = prog->platform.flags & DRGN_PLATFORM_IS_LITTLE_ENDIAN;
+	uint8_t address_size =
+		(prog->platform.flags & DRGN_PLATFORM_IS_64_BIT) ? 8 : 4;
+	uint64_t address_mask = address_size == 8 ? UINT64_MAX : UINT32_MAX;
+	uint64_t stack[DRGN_CFI_EXPRESSION_STACK_SIZE];
+	size_t stack_size = 0;
+	struct binary_buffer bb;
 
-	if (!prog->has_platform) {
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
-					 "cannot unwind stack without platform");
+	binary_buffer_init(&bb, rule->expr, rule->expr_size, little_endian,
+			   drgn_cfi_expression_error);
+
+#define CHECK(n) do {							\
+	if (stack_size < (n))						\
+		return binary_buffer_error(&bb, "stack underflow");	\
+} while (0)
+#define PUSH(x) do {							\
+	uint64_t push = (x);						\
+	if (stack_size >= ARRAY_SIZE(stack))				\
+		return binary_buffer_error(&bb, "stack overflow");	\
+	stack[stack_size++] = push;					\
+} while (0)
+#define TOP stack[stack_size - 1]
+#define BINARY_OP(op) do {						\
+	CHECK(2);							\
+	stack[stack_size - 2] = stack[stack_size - 2] op TOP;		\
+	stack_size--;							\
+} while (0)
+#define SIGNED_COMPARISON(op) do {					\
+	CHECK(2);							\
+	stack[stack_size - 2] = ((int64_t)stack[stack_size - 2] op	\
+				 (int64_t)TOP);				\
+	stack_size--;							\
+} while (0)
+
+	if (cfa)
+		PUSH(*cfa);
+	for (int ops = 0; binary_buffer_has_next(&bb); ops++) {
+		if (ops >= DRGN_CFI_EXPRESSION_MAX_OPS) {
+			return binary_buffer_error(&bb,
+						   "too many operations");
+		}
+		uint8_t opcode;
+		if ((err = binary_buffer_next_u8(&bb, &opcode)))
+			return err;
+		uint64_t uvalue, regno;
+		int64_t svalue;
+		uint8_t u8;
+		uint16_t u16;
+		uint32_t u32;
+		switch (opcode) {
+		case DW_OP_lit0 ... DW_OP_lit31:
+			PUSH(opcode - DW_OP_lit0);
+			break;
+		case DW_OP_addr:
+			if (address_size == 8) {
+				err = binary_buffer_next_u64(&bb, &uvalue);
+			} else {
+				err = binary_buffer_next_u32_into_u64(&bb,
+								      &uvalue);
+			}
+			if (err)
+				return err;
+			PUSH(uvalue);
+			break;
+		case DW_OP_const1u:
+			if ((err = binary_buffer_next_u8(&bb, &u8)))
+				return err;
+			PUSH(u8);
+			break;
+		case DW_OP_const1s:
+			if ((err = binary_buffer_next_u8(&bb, &u8)))
+				return err;
+			PUSH((int8_t)u8);
+			break;
+		case DW_OP_const2u:
+			if ((err = binary_buffer_next_u16(&bb, &u16)))
+				return err;
+			PUSH(u16);
+			break;
+		case DW_OP_const2s:
+			if ((err = binary_buffer_next_u16(&bb, &u16)))
+				return err;
+			PUSH((int16_t)u16);
+			break;
+		case DW_OP_const4u:
+			if ((err = binary_buffer_next_u32(&bb, &u32)))
+				return err;
+			PUSH(u32);
+			break;
+		case DW_OP_const4s:
+			if ((err = binary_buffer_next_u32(&bb, &u32)))
+				return err;
+			PUSH((int32_t)u32);
+			break;
+		case DW_OP_const8u:
+		case DW_OP_const8s:
+			if ((err = binary_buffer_next_u64(&bb, &uvalue)))
+				return err;
+			PUSH(uvalue);
+			break;
+		case DW_OP_constu:
+			if ((err = binary_buffer_next_uleb128(&bb, &uvalue)))
+				return err;
+			PUSH(uvalue);
+			break;
+		case DW_OP_consts:
+			if ((err = binary_buffer_next_sleb128(&bb, &svalue)))
+				return err;
+			PUSH(svalue);
+			break;
+		case DW_OP_dup:
+			CHECK(1);
+			PUSH(TOP);
+			break;
+		case DW_OP_drop:
+			CHECK(1);
+			stack_size--;
+			break;
+		case DW_OP_over:
+			CHECK(2);
+			PUSH(stack[stack_size - 2]);
+			break;
+		case DW_OP_pick:
+			if ((err = binary_buffer_next_u8(&bb, &u8)))
+				return err;
+			CHECK((size_t)u8 + 1);
+			PUSH(stack[stack_size - 1 - u8]);
+			break;
+		case DW_OP_swap:
+			CHECK(2);
+			uvalue = TOP;
+			TOP = stack[stack_size - 2];
+			stack[stack_size - 2] = uvalue;
+			break;
+		case DW_OP_rot:
+			CHECK(3);
+			uvalue = TOP;
+			TOP = stack[stack_size - 2];
+			stack[stack_size - 2] = stack[stack_size - 3];
+			stack[stack_size - 3] = uvalue;
+			break;
+		case DW_OP_deref:
+		case DW_OP_deref_size:
+			if (opcode == DW_OP_deref_size) {
+				if ((err = binary_buffer_next_u8(&bb, &u8)))
+					return err;
+				if (u8 == 0 || u8 > address_size) {
+					return binary_buffer_error(&bb,
+								   "invalid DW_OP_deref_size size %" PRIu8,
+								   u8);
+				}
+			} else {
+				u8 = address_size;
+			}
+			CHECK(1);
+			char buf[8];
+			err = drgn_stack_trace_read_memory(state,
+							   TOP & address_mask,
+							   buf, u8, found_ret);
+			if (err || !*found_ret)
+				return err;
+			uvalue = 0;
+			for (uint8_t i = 0; i < u8; i++) {
+				uint8_t byte = buf[little_endian ? i : u8 - 1 - i];
+				uvalue |= (uint64_t)byte << (8 * i);
+			}
+			TOP = uvalue;
+			break;
+		case DW_OP_abs:
+			CHECK(1);
+			if ((int64_t)TOP < 0)
+				TOP = -TOP;
+			break;
+		case DW_OP_neg:
+			CHECK(1);
+			TOP = -TOP;
+			break;
+		case DW_OP_not:
+			CHECK(1);
+			TOP = ~TOP;
+			break;
+		case DW_OP_and:
+			BINARY_OP(&);
+			break;
+		case DW_OP_or:
+			BINARY_OP(|);
+			break;
+		case DW_OP_xor:
+			BINARY_OP(^);
+			break;
+		case DW_OP_plus:
+			BINARY_OP(+);
+			break;
+		case DW_OP_minus:
+			BINARY_OP(-);
+			break;
+		case DW_OP_mul:
+			BINARY_OP(*);
+			break;
+		case DW_OP_div:
+		case DW_OP_mod:
+			CHECK(2);
+			if (!TOP)
+				return binary_buffer_error(&bb, "division by zero");
+			if (opcode == DW_OP_div && TOP == UINT64_MAX) {
+				/*
+				 * Dividing by -1 is negation. INT64_MIN / -1
+				 * overflows, so negate the unsigned value,
+				 * which wraps around to INT64_MIN instead.
+				 */
+				stack[stack_size - 2] = -stack[stack_size - 2];
+				stack_size--;
+			} else if (opcode == DW_OP_div) {
+				SIGNED_COMPARISON(/);
+			} else {
+				BINARY_OP(%);
+			}
+			break;
+		case DW_OP_shl:
+			CHECK(2);
+			stack[stack_size - 2] = (TOP < 64 ?
+						 stack[stack_size - 2] << TOP :
+						 0);
+			stack_size--;
+			break;
+		case DW_OP_shr:
+			CHECK(2);
+			stack[stack_size - 2] = (TOP < 64 ?
+						 stack[stack_size - 2] >> TOP :
+						 0);
+			stack_size--;
+			break;
+		case DW_OP_shra:
+			CHECK(2);
+			stack[stack_size - 2] =
+				(int64_t)stack[stack_size - 2] >> (TOP < 63 ? TOP : 63);
+			stack_size--;
+			break;
+		case DW_OP_plus_uconst:
+			if ((err = binary_buffer_next_uleb128(&bb, &uvalue)))
+				return err;
+			CHECK(1);
+			TOP += uvalue;
+			break;
+		case DW_OP_eq:
+			SIGNED_COMPARISON(==);
+			break;
+		case DW_OP_ne:
+			SIGNED_COMPARISON(!=);
+			break;
+		case DW_OP_ge:
+			SIGNED_COMPARISON(>=);
+			break;
+		case DW_OP_gt:
+			SIGNED_COMPARISON(>);
+			break;
+		case DW_OP_le:
+			SIGNED_COMPARISON(<=);
+			break;
+		case DW_OP_lt:
+			SIGNED_COMPARISON(<);
+			break;
+		case DW_OP_skip:
+		case DW_OP_bra: {
+			if ((err = binary_buffer_next_u16(&bb, &u16)))
+				return err;
+			int16_t skip = u16;
+			if (opcode == DW_OP_bra) {
+				CHECK(1);
+				if (!stack[--stack_size])
+					break;
+			}
+			if (skip >= 0 ? skip > bb.end - bb.pos :
+			    -skip > bb.pos - rule->expr)
+				return binary_buffer_error(&bb, "branch is out of bounds");
+			bb.pos += skip;
+			break;
+		}
+		case DW_OP_breg0 ... DW_OP_breg31:
+			regno = opcode - DW_OP_breg0;
+			goto breg;
+		case DW_OP_bregx:
+			if ((err = binary_buffer_next_uleb128(&bb, &regno)))
+				return err;
+breg:
+			if ((err = binary_buffer_next_sleb128(&bb, &svalue)))
+				return err;
+			if (!drgn_register_state_has(regs, regno)) {
+				*found_ret = false;
+				return NULL;
+			}
+			PUSH(regs->regs[regno] + svalue);
+			break;
+		case DW_OP_nop:
+			break;
+		default:
+			return binary_buffer_error(&bb,
+						   "unsupported opcode %#" PRIx8,
+						   opcode);
+		}
 	}
-	if ((prog->flags & (DRGN_PROGRAM_IS_LINUX_KERNEL |
-			    DRGN_PROGRAM_IS_LIVE)) == DRGN_PROGRAM_IS_LIVE) {
-		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
-					 "stack unwinding is not yet supported for live processes");
+	CHECK(1);
+	*ret = TOP & address_mask;
+	*found_ret = true;
+	return NULL;
+
+#undef SIGNED_COMPARISON
+#undef BINARY_OP
+#undef TOP
+#undef PUSH
+#undef CHECK
+}
+
+/*
+ * Unwind one frame with rules from call frame information. If the caller can't
+ * be unwound (e.g., because the return address is undefined in the outermost
+ * frame), *found_ret is set to false.
+ */
+static struct drgn_error *
+drgn_cfi_unwind_frame(struct drgn_stack_trace_state *state,
+		      const struct drgn_cfi_row *row, uint64_t ret_addr_regno,
+		      const struct drgn_register_state *frame,
+		      struct drgn_register_state *caller, bool *found_ret)
+{
+	struct drgn_error *err;
+
+	*found_ret = false;
+	uint64_t cfa;
+	switch (row->cfa.kind) {
+	case DRGN_CFI_RULE_REGISTER_PLUS_OFFSET:
+		if (!drgn_register_state_has(frame, row->cfa.regno))
+			return NULL;
+		cfa = frame->regs[row->cfa.regno] + row->cfa.offset;
+		break;
+	case DRGN_CFI_RULE_DWARF_EXPRESSION: {
+		bool found;
+		err = drgn_eval_cfi_expression(state, &row->cfa, frame, NULL,
+					       &cfa, &found);
+		if (err || !found)
+			return err;
+		break;
+	}
+	default:
+		return NULL;
 	}
 
-	struct drgn_debug_info *dbinfo;
-	err = drgn_program_get_dbinfo(prog, &dbinfo);
+	for (uint64_t regno = 0; regno < DRGN_MAX_REGISTERS; regno++) {
+		const struct drgn_cfi_rule *rule = &row->regs[regno];
+		uint64_t value;
+		bool found = true;
+		switch (rule->kind) {
+		case DRGN_CFI_RULE_UNDEFINED:
+			found = false;
+			break;
+		case DRGN_CFI_RULE_SAME_VALUE:
+			found = drgn_register_state_has(frame, regno);
+			value = frame->regs[regno];
+			break;
+		case DRGN_CFI_RULE_AT_CFA_PLUS_OFFSET:
+			err = drgn_stack_trace_read_word(state,
+							 cfa + rule->offset,
+							 &value, &found);
+			if (err)
+				return err;
+			break;
+		case DRGN_CFI_RULE_CFA_PLUS_OFFSET:
+			value = cfa + rule->offset;
+			break;
+		case DRGN_CFI_RULE_REGISTER_PLUS_OFFSET:
+			found = drgn_register_state_has(frame, rule->regno);
+			if (found)
+				value = frame->regs[rule->regno] + rule->offset;
+			break;
+		case DRGN_CFI_RULE_AT_DWARF_EXPRESSION:
+			err = drgn_eval_cfi_expression(state, rule, frame, &cfa,
+						       &value, &found);
+			if (err)
+				return err;
+			if (found) {
+				err = drgn_stack_trace_read_word(state, value,
+								 &value,
+								 &found);
+				if (err)
+					return err;
+			}
+			break;
+		case DRGN_CFI_RULE_DWARF_EXPRESSION:
+			err = drgn_eval_cfi_expression(state, rule, frame, &cfa,
+						       &value, &found);
+			if (err)
+				return err;
+			break;
+		default:
+			UNREACHABLE();
+		}
+		if (found)
+			drgn_register_state_set(caller, regno, value);
+	}
+
+	/* The caller's program counter is the return address. */
+	if (!drgn_register_state_has(caller, ret_addr_regno))
+		return NULL;
+	uint64_t ret_addr = caller->regs[ret_addr_regno];
+	/* A return address of zero marks the outermost frame. */
+	if (!ret_addr)
+		return NULL;
+	drgn_register_state_set(caller, state->prog->platform.arch->pc_regno,
+				ret_addr);
+	*found_ret = true;
+	return NULL;
+}
+
+/*
+ * Unwind one frame using the frame pointer.
+ *
+ * This is the last resort for code without call frame information, in which
+ * case we trust whatever we find. If @p strict is true, then this is the fast
+ * path for programs built with frame pointers, and the frame is only unwound
+ * if the frame pointer chain looks intact: the frame pointer is aligned, the
+ * caller's frame pointer (if any) is higher on the stack, and the return
+ * address is in a known module. Otherwise, *found_ret is set to false so that
+ * the caller can fall back to call frame information.
+ */
+static struct drgn_error *
+drgn_unwind_frame_pointer(struct drgn_stack_trace_state *state, Dwfl *dwfl,
+			  const struct drgn_register_state *frame,
+			  struct drgn_register_state *caller, bool strict,
+			  bool *found_ret)
+{
+	struct drgn_error *err;
+	const struct drgn_architecture_info *arch =
+		state->prog->platform.arch;
+	uint64_t word_size =
+		(state->prog->platform.flags & DRGN_PLATFORM_IS_64_BIT) ? 8 : 4;
+
+	*found_ret = false;
+	if (!arch->has_frame_pointer ||
+	    !drgn_register_state_has(frame, arch->fp_regno))
+		return NULL;
+	uint64_t fp = frame->regs[arch->fp_regno];
+	if (!fp || (strict && (fp & (word_size - 1))))
+		return NULL;
+	uint64_t prev_fp, ret_addr;
+	bool found;
+	err = drgn_stack_trace_read_word(state, fp, &prev_fp, &found);
 	if (err)
 		return err;
-	if (!prog->attached_dwfl_state) {
-		if (!dwfl_attach_state(dbinfo->dwfl, NULL, 0,
-				       &drgn_linux_kernel_thread_callbacks,
-				       prog))
-			return drgn_error_libdwfl();
-		prog->attached_dwfl_state = true;
-	}
-
-	prog->stack_trace_tid = tid;
-	prog->stack_trace_obj = obj;
-	Dwfl_Thread *thread = dwfl_attach_thread(dbinfo->dwfl,
-						 STACK_TRACE_OBJ_TID);
-	prog->stack_trace_obj = NULL;
-	prog->stack_trace_tid = 0;
-	if (prog->stack_trace_err)
-		goto stack_trace_err;
-	if (!thread) {
-		err = drgn_error_libdwfl();
-		goto err;
+	if (!found) {
+		if (strict)
+			return NULL;
+		prev_fp = 0;
 	}
+	if (strict && prev_fp && prev_fp <= fp)
+		return NULL;
+	err = drgn_stack_trace_read_word(state, fp + word_size, &ret_addr,
+					 &found);
+	if (err || !found || !ret_addr)
+		return err;
+	if (strict && !drgn_unwind_in_module(state, dwfl, ret_addr - 1))
+		return NULL;
 
+	drgn_register_state_init(caller, false);
+	drgn_register_state_set(caller, arch->fp_regno, prev_fp);
+	drgn_register_state_set(caller, arch->sp_regno, fp + 2 * word_size);
+	drgn_register_state_set(caller, arch->pc_regno, ret_addr);
+	/* The stack grows down, so the caller's frame must be above ours. */
+	*found_ret = (!drgn_register_state_has(frame, arch->sp_regno) ||
+		      fp + 2 * word_size > frame->regs[arch->sp_regno]);
+	return NULL;
+}
+
+/*
+ * Unwind one frame with call frame information if it is available for the
+ * frame's program counter, falling back to the frame pointer if not. If the
+ * caller can't be unwound, *found_ret is set to false.
+ */
+static struct drgn_error *
+drgn_unwind_frame(struct drgn_stack_trace_state *state, Dwfl *dwfl,
+		  const struct drgn_register_state *frame,
+		  struct drgn_register_state *caller, bool *found_ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+
+	/*
+	 * If the program counter is a return address, the call instruction
+	 * may be the last instruction of a different function (e.g., if the
+	 * callee doesn't return).
+	 */
+	uint64_t pc = frame->regs[prog->platform.arch->pc_regno];
+	if (!frame->interrupted)
+		pc--;
+	struct drgn_debug_info_module *module;
+	err = drgn_unwind_find_module(state, dwfl, pc, false, &module);
+	if (err)
+		return err;
+	if (module) {
+		struct drgn_cfi_row row;
+		bool interrupted, found;
+		uint64_t ret_addr_regno;
+		err = drgn_debug_info_module_find_cfi(prog, module, pc, &row,
+						      &interrupted,
+						      &ret_addr_regno, &found);
+		if (err)
+			return err;
+		if (found) {
+			drgn_register_state_init(caller, interrupted);
+			err = drgn_cfi_unwind_frame(state, &row, ret_addr_regno,
+						    frame, caller, found_ret);
+			goto out;
+		}
+	}
+	err = drgn_unwind_frame_pointer(state, dwfl, frame, caller, false,
+					found_ret);
+out:
+	/* Stop if bad data made us loop on the same frame. */
+	if (!err && *found_ret && caller->known == frame->known &&
+	    caller->interrupted == frame->interrupted) {
+		bool same = true;
+		for (int regno = 0; regno < DRGN_MAX_REGISTERS; regno++) {
+			if (drgn_register_state_has(frame, regno) &&
+			    caller->regs[regno] != frame->regs[regno]) {
+				same = false;
+				break;
+			}
+		}
+		*found_ret = !same;
+	}
+	return err;
+}
+
+/*
+ * Unwind a thread whose initial registers have been set up. This may be called
+ * from multiple threads at once if state->locks is set.
+ */
+static struct drgn_error *
+drgn_stack_trace_unwind(struct drgn_stack_trace_state *state, Dwfl *dwfl,
+			struct drgn_stack_trace **ret)
+{
+	struct drgn_error *err;
+	struct drgn_program *prog = state->prog;
+
+	size_t capacity = 1;
 	struct drgn_stack_trace *trace = malloc(sizeof(*trace) +
 						sizeof(trace->frames[0]));
-	if (!trace) {
-		err = &drgn_enomem;
-		goto err;
-	}
+	if (!trace)
+		return &drgn_enomem;
 	trace->prog = prog;
-	trace->capacity = 1;
 	trace->num_frames = 0;
+	uint64_t pc_regno = prog->platform.arch->pc_regno;
+	if (!drgn_register_state_has(&state->initial, pc_regno))
+		goto out;
+	trace->frames[trace->num_frames++] = state->initial;
 
-	dwfl_thread_getframes(thread, drgn_append_stack_frame, &trace);
-	if (prog->stack_trace_err) {
-		free(trace);
-		goto stack_trace_err;
+	/*
+	 * Prefer ORC for the Linux kernel, which is what the kernel itself
+	 * uses, if it is available for the initial program counter.
+	 */
+	bool use_orc = false;
+	if ((prog->flags & DRGN_PROGRAM_IS_LINUX_KERNEL) &&
+	    prog->platform.arch->arch == DRGN_ARCH_X86_64) {
+		const struct drgn_orc_entry *orc;
+		err = drgn_orc_find_entry(state, dwfl,
+					  state->initial.regs[pc_regno], &orc);
+		if (err)
+			goto err;
+		use_orc = orc != NULL;
 	}
 
-	/* Shrink the trace to fit if we can, but don't fail if we can't. */
-	if (trace->capacity > trace->num_frames) {
-		struct drgn_stack_trace *tmp;
+	int stack_switches = 0;
+	for (;;) {
+		if (trace->num_frames >= capacity) {
+			struct drgn_stack_trace *tmp;
+			size_t new_capacity, bytes;
+			if (__builtin_mul_overflow(2U, capacity,
+						   &new_capacity) ||
+			    __builtin_mul_overflow(new_capacity,
+						   sizeof(trace->frames[0]),
+						   &bytes) ||
+			    __builtin_add_overflow(bytes, sizeof(*trace),
+						   &bytes) ||
+			    !(tmp = realloc(trace, bytes))) {
+				err = &drgn_enomem;
+				goto err;
+			}
+			trace = tmp;
+			capacity = new_capacity;
+		}
+		const struct drgn_register_state *frame =
+			&trace->frames[trace->num_frames - 1];
+		struct drgn_register_state *caller =
+			&trace->frames[trace->num_frames];
+		bool found = false;
+		/*
+		 * An interrupted function may not have set up its frame pointer
+		 * yet, so only take the fast path for calls.
+		 */
+		if (prog->frame_pointer_unwinding && !frame->interrupted) {
+			err = drgn_unwind_frame_pointer(state, dwfl, frame,
+							caller, true, &found);
+			if (err)
+				goto err;
+			if (found) {
+				trace->num_frames++;
+				continue;
+			}
+		}
+		if (use_orc) {
+			err = drgn_orc_unwind_frame(state, dwfl, frame, caller,
+						    &stack_switches, &found);
+		} else {
+			err = drgn_unwind_frame(state, dwfl, frame, caller,
+						&found);
+		}
+		if (err)
+			goto err;
+		if (!found)
+			break;
+		trace->num_frames++;
+	}
 
-		tmp = realloc(trace,
-			      sizeof(*trace) +
-			      trace->num_frames * sizeof(trace->frames[0]));
+	/* Shrink the trace to fit if we can, but don't fail if we can't. */
+	if (capacity > trace->num_frames) {
+		struct drgn_stack_trace *tmp =
+			realloc(trace,
+				sizeof(*trace) +
+				trace->num_frames * sizeof(trace->frames[0]));
 		if (tmp)
 			trace = tmp;
 	}
-	trace->thread = thread;
+out:
 	*ret = trace;
 	return NULL;
 
-stack_trace_err:
-	/*
-	 * The error reporting for dwfl_getthread_frames() is not great. The
-	 * documentation says that some of its unwinder implementations always
-	 * return an error. So, we do our own error reporting for fatal errors
-	 * through prog->stack_trace_err.
-	 */
-	err = prog->stack_trace_err;
-	prog->stack_trace_err = NULL;
 err:
-	dwfl_detach_thread(thread);
+	free(trace);
 	return err;
 }
 
+static struct drgn_error *
+drgn_stack_trace_get_dwfl(struct drgn_program *prog, Dwfl **ret)
+{
+	struct drgn_error *err;
+
+	if (!prog->has_platform) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "cannot unwind stack without platform");
+	}
+	if ((prog->flags & (DRGN_PROGRAM_IS_LINUX_KERNEL |
+			    DRGN_PROGRAM_IS_LIVE)) == DRGN_PROGRAM_IS_LIVE) {
+		return drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+					 "stack unwinding is not yet supported for live processes");
+	}
+
+	struct drgn_debug_info *dbinfo;
+	err = drgn_program_get_dbinfo(prog, &dbinfo);
+	if (err)
+		return err;
+	*ret = dbinfo->dwfl;
+	return NULL;
+}
+
+static struct drgn_error *drgn_get_stack_trace(struct drgn_program *prog,
+					       uint32_t tid,
+					       const struct drgn_object *obj,
+					       struct drgn_stack_trace **ret)
+{
+	struct drgn_error *err;
+	Dwfl *dwfl;
+	err = drgn_stack_trace_get_dwfl(prog, &dwfl);
+	if (err)
+		return err;
+
+	struct drgn_stack_trace_state state = {
+		.prog = prog,
+		.obj = obj,
+		.tid = tid,
+	};
+	err = drgn_stack_trace_get_initial_registers(&state);
+	if (err)
+		return err;
+	return drgn_stack_trace_unwind(&state, dwfl, ret);
+}
+
+LIBDRGN_PUBLIC void
+drgn_program_set_frame_pointer_unwinding(struct drgn_program *prog,
+					 bool enabled)
+{
+	prog->frame_pointer_unwinding = enabled;
+}
+
+LIBDRGN_PUBLIC bool
+drgn_program_frame_pointer_unwinding(struct drgn_program *prog)
+{
+	return prog->frame_pointer_unwinding;
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_program_stack_trace(struct drgn_program *prog, uint32_t tid,
 			 struct drgn_stack_trace **ret)
@@ -547,22 +1513,250 @@ drgn_program_stack_trace(struct drgn_program *prog, uint32_t tid,
 	return drgn_get_stack_trace(prog, tid, NULL, ret);
 }
 
-LIBDRGN_PUBLIC struct drgn_error *
-drgn_object_stack_trace(const struct drgn_object *obj,
-			struct drgn_stack_trace **ret)
+/*
+ * Get the thread ID and object to unwind for an object passed to
+ * drgn_object_stack_trace() or drgn_program_stack_traces().
+ */
+static struct drgn_error *
+drgn_stack_trace_state_init(struct drgn_stack_trace_state *state,
+			    const struct drgn_object *obj)
 {
 	struct drgn_error *err;
 
+	state->prog = drgn_object_program(obj);
+	state->locks = NULL;
 	if (drgn_type_kind(drgn_underlying_type(obj->type)) == DRGN_TYPE_INT) {
 		union drgn_value value;
 
 		err = drgn_object_read_integer(obj, &value);
 		if (err)
 			return err;
-		return drgn_get_stack_trace(drgn_object_program(obj),
-					    value.uvalue, NULL, ret);
+		state->obj = NULL;
+		state->tid = value.uvalue;
 	} else {
-		return drgn_get_stack_trace(drgn_object_program(obj), 0, obj,
-					    ret);
+		state->obj = obj;
+		state->tid = 0;
+	}
+	return NULL;
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_object_stack_trace(const struct drgn_object *obj,
+			struct drgn_stack_trace **ret)
+{
+	struct drgn_error *err;
+	struct drgn_stack_trace_state state;
+
+	err = drgn_stack_trace_state_init(&state, obj);
+	if (err)
+		return err;
+	return drgn_get_stack_trace(state.prog, state.tid, state.obj, ret);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_stack_traces(struct drgn_program *prog,
+			  const struct drgn_object * const *threads,
+			  size_t num_threads,
+			  struct drgn_stack_trace **traces_ret,
+			  struct drgn_error **errs_ret)
+{
+	struct drgn_error *err;
+	Dwfl *dwfl;
+	err = drgn_stack_trace_get_dwfl(prog, &dwfl);
+	if (err)
+		return err;
+
+	struct drgn_stack_trace_state *states =
+		malloc_array(num_threads, sizeof(*states));
+	if (!states && num_threads)
+		return &drgn_enomem;
+
+	/*
+	 * Getting the initial registers looks up objects and types, which
+	 * isn't thread-safe, so do that for every thread first.
+	 */
+	struct drgn_stack_trace_locks locks;
+	for (size_t i = 0; i < num_threads; i++) {
+		traces_ret[i] = NULL;
+		if (drgn_object_program(threads[i]) != prog) {
+			errs_ret[i] = drgn_error_create(DRGN_ERROR_INVALID_ARGUMENT,
+							"objects are from different programs");
+			continue;
+		}
+		errs_ret[i] = drgn_stack_trace_state_init(&states[i],
+							  threads[i]);
+		if (errs_ret[i])
+			continue;
+		errs_ret[i] = drgn_stack_trace_get_initial_registers(&states[i]);
+		states[i].locks = &locks;
+	}
+
+	/* Then, unwind the stacks. */
+	omp_init_lock(&locks.dwfl);
+	omp_init_lock(&locks.memory);
+	#pragma omp parallel for schedule(dynamic)
+	for (size_t i = 0; i < num_threads; i++) {
+		if (errs_ret[i])
+			continue;
+		errs_ret[i] = drgn_stack_trace_unwind(&states[i], dwfl,
+						      &traces_ret[i]);
+	}
+	omp_destroy_lock(&locks.memory);
+	omp_destroy_lock(&locks.dwfl);
+
+	free(states);
+	return NULL;
+}
+
+static struct hash_pair
+drgn_stack_trace_pcs_hash(struct drgn_stack_trace * const *key)
+{
+	const struct drgn_stack_trace *trace = *key;
+	uint64_t pc_regno = trace->prog->platform.arch->pc_regno;
+	size_t hash = trace->num_frames;
+	for (size_t i = 0; i < trace->num_frames; i++)
+		hash = hash_combine(hash, trace->frames[i].regs[pc_regno]);
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_stack_trace_pcs_eq(struct drgn_stack_trace * const *a,
+				    struct drgn_stack_trace * const *b)
+{
+	uint64_t pc_regno = (*a)->prog->platform.arch->pc_regno;
+	if ((*a)->num_frames != (*b)->num_frames)
+		return false;
+	for (size_t i = 0; i < (*a)->num_frames; i++) {
+		if ((*a)->frames[i].regs[pc_regno] !=
+		    (*b)->frames[i].regs[pc_regno])
+			return false;
+	}
+	return true;
+}
+
+/* Map from a stack trace to the index of its bucket. */
+DEFINE_HASH_MAP(drgn_stack_trace_bucket_map, struct drgn_stack_trace *, size_t,
+		drgn_stack_trace_pcs_hash, drgn_stack_trace_pcs_eq)
+
+static int drgn_stack_trace_bucket_cmp(const void *_a, const void *_b)
+{
+	const struct drgn_stack_trace_bucket *a = _a, *b = _b;
+	if (a->num_threads != b->num_threads)
+		return a->num_threads > b->num_threads ? -1 : 1;
+	return (a->threads[0] > b->threads[0]) - (a->threads[0] < b->threads[0]);
+}
+
+LIBDRGN_PUBLIC void
+drgn_stack_trace_buckets_destroy(struct drgn_stack_trace_bucket *buckets,
+				 size_t num_buckets)
+{
+	for (size_t i = 0; i < num_buckets; i++) {
+		drgn_stack_trace_destroy(buckets[i].trace);
+		free(buckets[i].threads);
+	}
+	free(buckets);
+}
+
+LIBDRGN_PUBLIC struct drgn_error *
+drgn_program_aggregate_stack_traces(struct drgn_program *prog,
+				    const struct drgn_object * const *threads,
+				    size_t num_threads,
+				    struct drgn_stack_trace_bucket **buckets_ret,
+				    size_t *num_buckets_ret,
+				    struct drgn_error **errs_ret)
+{
+	struct drgn_error *err;
+
+	struct drgn_stack_trace **traces =
+		malloc_array(num_threads, sizeof(*traces));
+	/* The bucket that each thread belongs to. */
+	size_t *thread_buckets = malloc_array(num_threads,
+					      sizeof(*thread_buckets));
+	struct drgn_stack_trace_bucket *buckets =
+		malloc_array(num_threads, sizeof(*buckets));
+	struct drgn_stack_trace_bucket_map map = HASH_TABLE_INIT;
+	size_t num_buckets = 0;
+	if ((!traces || !thread_buckets || !buckets) && num_threads) {
+		err = &drgn_enomem;
+		goto out;
+	}
+
+	err = drgn_program_stack_traces(prog, threads, num_threads, traces,
+					errs_ret);
+	if (err)
+		goto out;
+
+	/*
+	 * Find the bucket for each trace, keeping the first trace of each
+	 * bucket and freeing the duplicates as we go.
+	 */
+	for (size_t i = 0; i < num_threads; i++) {
+		if (!traces[i])
+			continue;
+		struct drgn_stack_trace_bucket_map_entry entry = {
+			.key = traces[i],
+			.value = num_buckets,
+		};
+		struct drgn_stack_trace_bucket_map_iterator it;
+		int r = drgn_stack_trace_bucket_map_insert(&map, &entry, &it);
+		if (r < 0) {
+			err = &drgn_enomem;
+			goto out_errs;
+		}
+		if (r) {
+			buckets[num_buckets].trace = traces[i];
+			buckets[num_buckets].threads = NULL;
+			buckets[num_buckets++].num_threads = 0;
+		} else {
+			drgn_stack_trace_destroy(traces[i]);
+		}
+		traces[i] = NULL;
+		thread_buckets[i] = it.entry->value;
+		buckets[it.entry->value].num_threads++;
 	}
+
+	/* Now that we have the counts, fill in the thread indices. */
+	for (size_t i = 0; i < num_buckets; i++) {
+		buckets[i].threads = malloc_array(buckets[i].num_threads,
+						  sizeof(buckets[i].threads[0]));
+		if (!buckets[i].threads) {
+			err = &drgn_enomem;
+			goto out_errs;
+		}
+		buckets[i].num_threads = 0;
+	}
+	for (size_t i = 0; i < num_threads; i++) {
+		if (errs_ret[i])
+			continue;
+		struct drgn_stack_trace_bucket *bucket =
+			&buckets[thread_buckets[i]];
+		bucket->threads[bucket->num_threads++] = i;
+	}
+	qsort(buckets, num_buckets, sizeof(buckets[0]),
+	      drgn_stack_trace_bucket_cmp);
+
+	/* Shrink the array to fit if we can, but don't fail if we can't. */
+	if (num_buckets < num_threads) {
+		struct drgn_stack_trace_bucket *tmp =
+			realloc_array(buckets, num_buckets, sizeof(buckets[0]));
+		if (tmp || !num_buckets)
+			buckets = tmp;
+	}
+	*buckets_ret = buckets;
+	*num_buckets_ret = num_buckets;
+	buckets = NULL;
+	num_buckets = 0;
+	goto out;
+
+out_errs:
+	for (size_t i = 0; i < num_threads; i++) {
+		if (traces[i])
+			drgn_stack_trace_destroy(traces[i]);
+		drgn_error_destroy(errs_ret[i]);
+	}
+out:
+	drgn_stack_trace_bucket_map_deinit(&map);
+	drgn_stack_trace_buckets_destroy(buckets, num_buckets);
+	free(thread_buckets);
+	free(traces);
+	return err;
 }
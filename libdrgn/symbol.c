@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "error.h"
 #include "symbol.h"
 #include "util.h"
 
@@ -33,3 +34,105 @@ LIBDRGN_PUBLIC bool drgn_symbol_eq(struct drgn_symbol *a, struct drgn_symbol *b)
 	return (strcmp(a->name, b->name) == 0 && a->address == b->address &&
 		a->size == b->size);
 }
+
+DEFINE_VECTOR_FUNCTIONS(drgn_symbol_vector)
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_symbol_name_map, c_string_key_hash_pair,
+			    c_string_key_eq)
+
+void drgn_symbol_name_index_init(struct drgn_symbol_name_index *index)
+{
+	drgn_symbol_vector_init(&index->symbols);
+	drgn_symbol_name_map_init(&index->map);
+}
+
+void drgn_symbol_name_index_deinit(struct drgn_symbol_name_index *index)
+{
+	drgn_symbol_name_map_deinit(&index->map);
+	drgn_symbol_vector_deinit(&index->symbols);
+}
+
+struct drgn_error *
+drgn_symbol_name_index_build(struct drgn_symbol_name_index *index,
+			     struct drgn_symbol_vector *symbols)
+{
+	drgn_symbol_name_map_clear(&index->map);
+	index->symbols.size = 0;
+
+	/* Count the symbols with each name. */
+	for (size_t i = 0; i < symbols->size; i++) {
+		struct drgn_symbol_name_map_entry entry = {
+			.key = symbols->data[i].name,
+		};
+		struct drgn_symbol_name_map_iterator it;
+		if (drgn_symbol_name_map_insert(&index->map, &entry, &it) < 0)
+			goto enomem;
+		it.entry->value.count++;
+	}
+
+	/* Assign each name a range. */
+	size_t i = 0;
+	for (struct drgn_symbol_name_map_iterator it =
+	     drgn_symbol_name_map_first(&index->map);
+	     it.entry; it = drgn_symbol_name_map_next(it)) {
+		it.entry->value.index = i;
+		i += it.entry->value.count;
+		it.entry->value.count = 0;
+	}
+
+	/* Move the symbols into their ranges, preserving their order. */
+	if (!drgn_symbol_vector_reserve(&index->symbols, symbols->size))
+		goto enomem;
+	for (i = 0; i < symbols->size; i++) {
+		struct drgn_symbol_name_range *range =
+			&drgn_symbol_name_map_search(&index->map,
+						     &symbols->data[i].name).entry->value;
+		index->symbols.data[range->index + range->count++] =
+			symbols->data[i];
+	}
+	index->symbols.size = symbols->size;
+	drgn_symbol_vector_deinit(symbols);
+	drgn_symbol_vector_init(symbols);
+	return NULL;
+
+enomem:
+	drgn_symbol_name_map_clear(&index->map);
+	return &drgn_enomem;
+}
+
+struct drgn_symbol *
+drgn_symbol_name_index_find(struct drgn_symbol_name_index *index,
+			    const char *name, size_t *count_ret)
+{
+	struct drgn_symbol_name_map_iterator it =
+		drgn_symbol_name_map_search(&index->map, &name);
+	if (!it.entry) {
+		*count_ret = 0;
+		return NULL;
+	}
+	*count_ret = it.entry->value.count;
+	return &index->symbols.data[it.entry->value.index];
+}
+
+const struct drgn_symbol *
+drgn_symbol_search_address(const struct drgn_symbol *symbols,
+			   size_t num_symbols, uint64_t address)
+{
+	/* Find the last symbol starting at or before the address. */
+	size_t lo = 0, hi = num_symbols;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (symbols[mid].address <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+	const struct drgn_symbol *sym = &symbols[lo - 1];
+	while (sym > symbols && sym[-1].address == sym->address)
+		sym--;
+	if (address - sym->address >= sym->size)
+		return NULL;
+	return sym;
+}
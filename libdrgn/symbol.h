@@ -4,12 +4,83 @@
 #ifndef DRGN_SYMBOL_H
 #define DRGN_SYMBOL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "drgn.h"
+#include "hash_table.h"
+#include "vector.h"
+
 struct drgn_symbol {
 	const char *name;
 	uint64_t address;
 	uint64_t size;
 };
 
+DEFINE_VECTOR_TYPE(drgn_symbol_vector, struct drgn_symbol)
+
+/** Range of symbols with the same name in a @ref drgn_symbol_name_index. */
+struct drgn_symbol_name_range {
+	size_t index;
+	size_t count;
+};
+
+DEFINE_HASH_MAP_TYPE(drgn_symbol_name_map, const char *,
+		     struct drgn_symbol_name_range)
+
+/** Symbols indexed by name. */
+struct drgn_symbol_name_index {
+	/**
+	 * Indexed symbols.
+	 *
+	 * Symbols with the same name are contiguous and in the order that they
+	 * were passed to @ref drgn_symbol_name_index_build().
+	 */
+	struct drgn_symbol_vector symbols;
+	/** Map from symbol name to range in @ref symbols. */
+	struct drgn_symbol_name_map map;
+};
+
+/** Initialize an empty @ref drgn_symbol_name_index. */
+void drgn_symbol_name_index_init(struct drgn_symbol_name_index *index);
+
+/** Deinitialize a @ref drgn_symbol_name_index. */
+void drgn_symbol_name_index_deinit(struct drgn_symbol_name_index *index);
+
+/**
+ * Build a @ref drgn_symbol_name_index.
+ *
+ * Any symbols already in the index are replaced. The symbol names must remain
+ * valid for as long as the index is used.
+ *
+ * @param[in] symbols Symbols to index. On success, they are moved into the
+ * index and this is left empty. On error, this is unchanged and the index is
+ * empty.
+ */
+struct drgn_error *
+drgn_symbol_name_index_build(struct drgn_symbol_name_index *index,
+			     struct drgn_symbol_vector *symbols);
+
+/**
+ * Find the symbols with the given name in a @ref drgn_symbol_name_index.
+ *
+ * @param[out] count_ret Returned number of symbols.
+ * @return Symbols with the given name, or @c NULL if there are none.
+ */
+struct drgn_symbol *
+drgn_symbol_name_index_find(struct drgn_symbol_name_index *index,
+			    const char *name, size_t *count_ret);
+
+/**
+ * Find the symbol containing an address in an array of symbols sorted by
+ * address.
+ *
+ * If multiple symbols start at the same address, the first one is returned.
+ *
+ * @return The symbol, or @c NULL if no symbol contains the address.
+ */
+const struct drgn_symbol *
+drgn_symbol_search_address(const struct drgn_symbol *symbols,
+			   size_t num_symbols, uint64_t address);
+
 #endif /* DRGN_SYMBOL_H */
@@ -173,6 +173,51 @@ DEFINE_HASH_TABLE_FUNCTIONS(drgn_member_map, drgn_member_key_hash_pair,
 
 DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_set, ptr_key_hash_pair, scalar_key_eq)
 
+static struct hash_pair
+drgn_type_find_key_hash_pair(const struct drgn_type_find_key *key)
+{
+	size_t hash = hash_combine(key->kind,
+				   hash_bytes(key->name, key->name_len));
+	if (key->filename)
+		hash = hash_combine(hash, hash_c_string(key->filename));
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_type_find_key_eq(const struct drgn_type_find_key *a,
+				  const struct drgn_type_find_key *b)
+{
+	return (a->kind == b->kind && a->name_len == b->name_len &&
+		memcmp(a->name, b->name, a->name_len) == 0 &&
+		(a->filename ?
+		 b->filename && strcmp(a->filename, b->filename) == 0 :
+		 !b->filename));
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_find_cache, drgn_type_find_key_hash_pair,
+			    drgn_type_find_key_eq)
+
+static struct hash_pair
+drgn_type_name_key_hash_pair(const struct drgn_type_name_key *key)
+{
+	size_t hash = hash_combine((uintptr_t)key->lang,
+				   hash_c_string(key->name));
+	if (key->filename)
+		hash = hash_combine(hash, hash_c_string(key->filename));
+	return hash_pair_from_avalanching_hash(hash);
+}
+
+static bool drgn_type_name_key_eq(const struct drgn_type_name_key *a,
+				  const struct drgn_type_name_key *b)
+{
+	return (a->lang == b->lang && strcmp(a->name, b->name) == 0 &&
+		(a->filename ?
+		 b->filename && strcmp(a->filename, b->filename) == 0 :
+		 !b->filename));
+}
+
+DEFINE_HASH_TABLE_FUNCTIONS(drgn_type_name_cache, drgn_type_name_key_hash_pair,
+			    drgn_type_name_key_eq)
+
 struct drgn_error *drgn_lazy_type_evaluate(struct drgn_lazy_type *lazy_type,
 					   struct drgn_qualified_type *ret)
 {
@@ -1044,10 +1089,35 @@ void drgn_program_init_types(struct drgn_program *prog)
 	drgn_typep_vector_init(&prog->created_types);
 	drgn_member_map_init(&prog->members);
 	drgn_type_set_init(&prog->members_cached);
+	drgn_type_name_cache_init(&prog->type_name_cache);
+	drgn_type_find_cache_init(&prog->type_find_cache);
+}
+
+static void drgn_program_free_type_caches(struct drgn_program *prog)
+{
+	/* The filenames are in the same allocation as the names. */
+	for (struct drgn_type_name_cache_iterator it =
+	     drgn_type_name_cache_first(&prog->type_name_cache);
+	     it.entry; it = drgn_type_name_cache_next(it))
+		free((char *)it.entry->key.name);
+	for (struct drgn_type_find_cache_iterator it =
+	     drgn_type_find_cache_first(&prog->type_find_cache);
+	     it.entry; it = drgn_type_find_cache_next(it))
+		free((char *)it.entry->key.name);
+}
+
+void drgn_program_flush_type_caches(struct drgn_program *prog)
+{
+	drgn_program_free_type_caches(prog);
+	drgn_type_name_cache_clear(&prog->type_name_cache);
+	drgn_type_find_cache_clear(&prog->type_find_cache);
 }
 
 void drgn_program_deinit_types(struct drgn_program *prog)
 {
+	drgn_program_free_type_caches(prog);
+	drgn_type_name_cache_deinit(&prog->type_name_cache);
+	drgn_type_find_cache_deinit(&prog->type_find_cache);
 	drgn_member_map_deinit(&prog->members);
 	drgn_type_set_deinit(&prog->members_cached);
 
@@ -1100,15 +1170,66 @@ drgn_program_add_type_finder(struct drgn_program *prog, drgn_type_find_fn fn,
 	finder->arg = arg;
 	finder->next = prog->type_finders;
 	prog->type_finders = finder;
+	drgn_program_flush_type_caches(prog);
 	return NULL;
 }
 
+/*
+ * Remember the result of a lookup. This is best effort: if we run out of
+ * memory, the lookup will simply be repeated next time.
+ */
+static void
+drgn_program_cache_type_find_result(struct drgn_program *prog,
+				    const struct drgn_type_find_key *key,
+				    struct hash_pair hp,
+				    struct drgn_qualified_type qualified_type)
+{
+	size_t filename_size = key->filename ? strlen(key->filename) + 1 : 0;
+	char *buf = malloc(key->name_len + 1 + filename_size);
+	if (!buf)
+		return;
+	memcpy(buf, key->name, key->name_len);
+	buf[key->name_len] = '\0';
+	struct drgn_type_find_cache_entry entry = {
+		.key = {
+			.kind = key->kind,
+			.name = buf,
+			.name_len = key->name_len,
+			.filename = (key->filename ?
+				     memcpy(buf + key->name_len + 1,
+					    key->filename, filename_size) :
+				     NULL),
+		},
+		.value = qualified_type,
+	};
+	if (drgn_type_find_cache_insert_searched(&prog->type_find_cache,
+						 &entry, hp, NULL) == -1)
+		free(buf);
+}
+
 struct drgn_error *
 drgn_program_find_type_impl(struct drgn_program *prog,
 			    enum drgn_type_kind kind, const char *name,
 			    size_t name_len, const char *filename,
 			    struct drgn_qualified_type *ret)
 {
+	struct drgn_type_find_key key = {
+		.kind = kind,
+		.name = name,
+		.name_len = name_len,
+		.filename = filename,
+	};
+	struct hash_pair hp = drgn_type_find_cache_hash(&key);
+	struct drgn_type_find_cache_iterator it =
+		drgn_type_find_cache_search_hashed(&prog->type_find_cache,
+						   &key, hp);
+	if (it.entry) {
+		if (!it.entry->value.type)
+			return &drgn_not_found;
+		*ret = it.entry->value;
+		return NULL;
+	}
+
 	struct drgn_type_finder *finder = prog->type_finders;
 	while (finder) {
 		struct drgn_error *err =
@@ -1123,24 +1244,83 @@ drgn_program_find_type_impl(struct drgn_program *prog,
 				return drgn_error_create(DRGN_ERROR_TYPE,
 							 "type find callback returned wrong kind of type");
 			}
+			drgn_program_cache_type_find_result(prog, &key, hp,
+							    *ret);
 			return NULL;
 		}
 		if (err != &drgn_not_found)
 			return err;
 		finder = finder->next;
 	}
+	drgn_program_cache_type_find_result(prog, &key, hp,
+					    (struct drgn_qualified_type){});
 	return &drgn_not_found;
 }
 
+/* Like drgn_program_cache_type_find_result() but for type names. */
+static void
+drgn_program_cache_type_name_result(struct drgn_program *prog,
+				    const struct drgn_type_name_key *key,
+				    struct hash_pair hp,
+				    struct drgn_qualified_type qualified_type)
+{
+	size_t name_size = strlen(key->name) + 1;
+	size_t filename_size = key->filename ? strlen(key->filename) + 1 : 0;
+	char *buf = malloc(name_size + filename_size);
+	if (!buf)
+		return;
+	struct drgn_type_name_cache_entry entry = {
+		.key = {
+			.lang = key->lang,
+			.name = memcpy(buf, key->name, name_size),
+			.filename = (key->filename ?
+				     memcpy(buf + name_size, key->filename,
+					    filename_size) : NULL),
+		},
+		.value = qualified_type,
+	};
+	if (drgn_type_name_cache_insert_searched(&prog->type_name_cache,
+						 &entry, hp, NULL) == -1)
+		free(buf);
+}
+
 LIBDRGN_PUBLIC struct drgn_error *
 drgn_program_find_type(struct drgn_program *prog, const char *name,
 		       const char *filename, struct drgn_qualified_type *ret)
 {
 	struct drgn_error *err;
-	err = drgn_program_language(prog)->find_type(prog, name, filename, ret);
-	if (err != &drgn_not_found)
+	/*
+	 * Parsing the type name is relatively expensive, and helpers tend to
+	 * look up the same few names over and over, so the result for the full
+	 * name is cached.
+	 */
+	struct drgn_type_name_key key = {
+		.lang = drgn_program_language(prog),
+		.name = name,
+		.filename = filename,
+	};
+	struct hash_pair hp = drgn_type_name_cache_hash(&key);
+	struct drgn_type_name_cache_iterator it =
+		drgn_type_name_cache_search_hashed(&prog->type_name_cache,
+						   &key, hp);
+	if (it.entry) {
+		if (!it.entry->value.type)
+			goto not_found;
+		*ret = it.entry->value;
+		return NULL;
+	}
+
+	err = key.lang->find_type(prog, name, filename, ret);
+	if (!err) {
+		drgn_program_cache_type_name_result(prog, &key, hp, *ret);
+		return NULL;
+	} else if (err != &drgn_not_found) {
 		return err;
+	}
+	drgn_program_cache_type_name_result(prog, &key, hp,
+					    (struct drgn_qualified_type){});
 
+not_found:
 	if (filename) {
 		return drgn_error_format(DRGN_ERROR_LOOKUP,
 					 "could not find '%s' in '%s'", name,
@@ -59,8 +59,39 @@ struct drgn_member_value {
 	uint64_t bit_offset;
 };
 
+/** <tt>(kind, name, filename)</tt> key of a cached type finder lookup. */
+struct drgn_type_find_key {
+	enum drgn_type_kind kind;
+	const char *name;
+	size_t name_len;
+	/** Filename, or @c NULL for any definition. */
+	const char *filename;
+};
+
+/** <tt>(language, type name, filename)</tt> key of a cached type lookup. */
+struct drgn_type_name_key {
+	const struct drgn_language *lang;
+	const char *name;
+	/** Filename, or @c NULL for any definition. */
+	const char *filename;
+};
+
 #ifdef DOXYGEN
 /**
+ * @struct drgn_type_name_cache
+ *
+ * Map of previous type name lookups to their results.
+ *
+ * The key is a @ref drgn_type_name_key, and the value is a @ref
+ * drgn_qualified_type, which has a @c NULL type if the type was not found.
+ *
+ * @struct drgn_type_find_cache
+ *
+ * Map of previous type finder lookups to their results.
+ *
+ * The key is a @ref drgn_type_find_key, and the value is a @ref
+ * drgn_qualified_type, which has a @c NULL type if the type was not found.
+ *
  * @struct drgn_member_map
  *
  * Map of compound type members.
@@ -72,6 +103,10 @@ struct drgn_member_value {
  * Set of types compared by address.
  */
 #else
+DEFINE_HASH_MAP_TYPE(drgn_type_name_cache, struct drgn_type_name_key,
+		      struct drgn_qualified_type)
+DEFINE_HASH_MAP_TYPE(drgn_type_find_cache, struct drgn_type_find_key,
+		      struct drgn_qualified_type)
 DEFINE_HASH_MAP_TYPE(drgn_member_map, struct drgn_member_key,
 		      struct drgn_member_value)
 DEFINE_HASH_SET_TYPE(drgn_type_set, struct drgn_type *)
@@ -679,12 +714,23 @@ void drgn_program_init_types(struct drgn_program *prog);
 /** Deinitialize type-related fields in a @ref drgn_program. */
 void drgn_program_deinit_types(struct drgn_program *prog);
 
+/**
+ * Forget all cached type lookup results in a @ref drgn_program.
+ *
+ * This must be called whenever the result of a lookup may change (e.g., when
+ * debugging information is loaded).
+ */
+void drgn_program_flush_type_caches(struct drgn_program *prog);
+
 /**
  * Find a parsed type in a @ref drgn_program.
  *
  * This should only be called by implementations of @ref
  * drgn_language::find_type()
  *
+ * Results (including types which were not found) are cached, so the type
+ * finders are only called the first time a type is looked up.
+ *
  * @param[in] kind Kind of type to find. Must be @ref DRGN_TYPE_STRUCT, @ref
  * DRGN_TYPE_UNION, @ref DRGN_TYPE_CLASS, @ref DRGN_TYPE_ENUM, or @ref
  * DRGN_TYPE_TYPEDEF.
@@ -109,6 +109,17 @@ static inline void *malloc_array(size_t nmemb, size_t size)
 	return malloc(bytes);
 }
 
+static inline void *realloc_array(void *ptr, size_t nmemb, size_t size)
+{
+	size_t bytes;
+
+	if (__builtin_mul_overflow(nmemb, size, &bytes)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return realloc(ptr, bytes);
+}
+
 static inline void *malloc64(uint64_t size)
 {
 	if (size > SIZE_MAX)
@@ -0,0 +1,491 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+# Micro-benchmarks for the per-call overhead of hot Python APIs. This must be
+# run from the root of the repository after building locally, e.g.:
+#
+#   $ python3 setup.py build_ext -i && python3 scripts/microbench.py
+#
+# Each benchmark runs against a synthetic program consisting of an ELF core
+# dump with a single memory segment and DWARF debugging information generated
+# by the test suite's DWARF writer, so no real core dump is needed.
+
+import argparse
+import os
+import os.path
+import struct
+import sys
+import tempfile
+import timeit
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), ".."))
+
+from drgn import Object, Program, cast, container_of  # noqa: E402
+from drgn.helpers.linux.list import list_for_each_entry  # noqa: E402
+from tests.dwarf import DW_AT, DW_ATE, DW_FORM, DW_TAG  # noqa: E402
+from tests.dwarfwriter import DwarfAttrib, DwarfDie, compile_dwarf  # noqa: E402
+from tests.elf import ET, PT  # noqa: E402
+from tests.elfwriter import ElfSection, create_elf_file  # noqa: E402
+from tests.test_program import prstatus_note  # noqa: E402
+
+SEGMENT_ADDRESS = 0xFFFF0000
+SEGMENT_SIZE = 64 * 1024
+POINTS_ADDRESS = SEGMENT_ADDRESS + 0x1000
+# A list_head followed by NUM_NODES struct nodes linked into it.
+LIST_ADDRESS = SEGMENT_ADDRESS + 0x4000
+NUM_NODES = 64
+NODE_SIZE = 24
+NODE_LIST_OFFSET = 8
+# Threads with a frame pointer chain of STACK_DEPTH frames each.
+NUM_THREADS = 256
+STACK_DEPTH = 32
+STACKS_ADDRESS = 0x7F0000000000
+STACK_SIZE = 16 * STACK_DEPTH
+
+
+DIES = (
+    # 0
+    DwarfDie(
+        DW_TAG.base_type,
+        (
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 4),
+            DwarfAttrib(DW_AT.encoding, DW_FORM.data1, DW_ATE.signed),
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "int"),
+        ),
+    ),
+    # 1
+    DwarfDie(
+        DW_TAG.base_type,
+        (
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 8),
+            DwarfAttrib(DW_AT.encoding, DW_FORM.data1, DW_ATE.unsigned),
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "unsigned long"),
+        ),
+    ),
+    # 2
+    DwarfDie(
+        DW_TAG.structure_type,
+        (
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "point"),
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 8),
+        ),
+        (
+            DwarfDie(
+                DW_TAG.member,
+                (
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "x"),
+                    DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 0),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                ),
+            ),
+            DwarfDie(
+                DW_TAG.member,
+                (
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "y"),
+                    DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 4),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                ),
+            ),
+        ),
+    ),
+    # 3
+    DwarfDie(
+        DW_TAG.pointer_type,
+        (
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 8),
+            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 2),
+        ),
+    ),
+    # 4
+    DwarfDie(
+        DW_TAG.array_type,
+        (DwarfAttrib(DW_AT.type, DW_FORM.ref4, 2),),
+        (
+            DwarfDie(
+                DW_TAG.subrange_type,
+                (DwarfAttrib(DW_AT.upper_bound, DW_FORM.data1, 255),),
+            ),
+        ),
+    ),
+    # 5
+    DwarfDie(
+        DW_TAG.variable,
+        (
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "points"),
+            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 4),
+            DwarfAttrib(
+                DW_AT.location,
+                DW_FORM.exprloc,
+                b"\x03" + POINTS_ADDRESS.to_bytes(8, "little"),
+            ),
+        ),
+    ),
+    # 6
+    DwarfDie(
+        DW_TAG.structure_type,
+        (
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "list_head"),
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 16),
+        ),
+        (
+            DwarfDie(
+                DW_TAG.member,
+                (
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "next"),
+                    DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 0),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 7),
+                ),
+            ),
+            DwarfDie(
+                DW_TAG.member,
+                (
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "prev"),
+                    DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 8),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 7),
+                ),
+            ),
+        ),
+    ),
+    # 7
+    DwarfDie(
+        DW_TAG.pointer_type,
+        (
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, 8),
+            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 6),
+        ),
+    ),
+    # 8
+    DwarfDie(
+        DW_TAG.structure_type,
+        (
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "node"),
+            DwarfAttrib(DW_AT.byte_size, DW_FORM.data1, NODE_SIZE),
+        ),
+        (
+            DwarfDie(
+                DW_TAG.member,
+                (
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "value"),
+                    DwarfAttrib(DW_AT.data_member_location, DW_FORM.data1, 0),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 0),
+                ),
+            ),
+            DwarfDie(
+                DW_TAG.member,
+                (
+                    DwarfAttrib(DW_AT.name, DW_FORM.string, "list"),
+                    DwarfAttrib(
+                        DW_AT.data_member_location, DW_FORM.data1, NODE_LIST_OFFSET
+                    ),
+                    DwarfAttrib(DW_AT.type, DW_FORM.ref4, 6),
+                ),
+            ),
+        ),
+    ),
+    # 9
+    DwarfDie(
+        DW_TAG.variable,
+        (
+            DwarfAttrib(DW_AT.name, DW_FORM.string, "nodes"),
+            DwarfAttrib(DW_AT.type, DW_FORM.ref4, 6),
+            DwarfAttrib(
+                DW_AT.location,
+                DW_FORM.exprloc,
+                b"\x03" + LIST_ADDRESS.to_bytes(8, "little"),
+            ),
+        ),
+    ),
+)
+
+
+def create_segment():
+    data = bytearray(bytes(range(256)) * (SEGMENT_SIZE // 256))
+
+    def write_list_head(address, next, prev):
+        offset = address - SEGMENT_ADDRESS
+        data[offset : offset + 8] = next.to_bytes(8, "little")
+        data[offset + 8 : offset + 16] = prev.to_bytes(8, "little")
+
+    nodes = [LIST_ADDRESS] + [
+        LIST_ADDRESS + 16 + i * NODE_SIZE + NODE_LIST_OFFSET for i in range(NUM_NODES)
+    ]
+    for i, node in enumerate(nodes):
+        write_list_head(node, nodes[(i + 1) % len(nodes)], nodes[i - 1])
+    return bytes(data)
+
+
+def create_stacks():
+    data = bytearray(NUM_THREADS * STACK_SIZE)
+    for i in range(NUM_THREADS):
+        for j in range(STACK_DEPTH):
+            offset = i * STACK_SIZE + j * 16
+            prev_fp = STACKS_ADDRESS + offset + 16 if j < STACK_DEPTH - 1 else 0
+            struct.pack_into("<QQ", data, offset, prev_fp, 0x401000 + j)
+    return bytes(data)
+
+
+def create_notes():
+    return b"".join(
+        prstatus_note(
+            tid,
+            0x400000,
+            STACKS_ADDRESS + (tid - 1) * STACK_SIZE,
+            STACKS_ADDRESS + (tid - 1) * STACK_SIZE - 8,
+        )
+        for tid in range(1, NUM_THREADS + 1)
+    )
+
+
+def create_program(tmpdir):
+    core_path = os.path.join(tmpdir, "core")
+    with open(core_path, "wb") as f:
+        f.write(
+            create_elf_file(
+                ET.CORE,
+                [
+                    ElfSection(p_type=PT.NOTE, data=create_notes()),
+                    ElfSection(
+                        p_type=PT.LOAD,
+                        vaddr=SEGMENT_ADDRESS,
+                        data=create_segment(),
+                    ),
+                    ElfSection(
+                        p_type=PT.LOAD,
+                        vaddr=STACKS_ADDRESS,
+                        data=create_stacks(),
+                    ),
+                ],
+            )
+        )
+    debug_info_path = os.path.join(tmpdir, "debug_info")
+    with open(debug_info_path, "wb") as f:
+        f.write(compile_dwarf(DIES))
+
+    prog = Program()
+    prog.set_core_dump(core_path)
+    prog.load_debug_info([debug_info_path])
+    return prog
+
+
+BENCHMARKS = {}
+
+
+def benchmark(group, ops=1):
+    def decorator(func):
+        BENCHMARKS[func.__name__] = (group, func, ops)
+        return func
+
+    return decorator
+
+
+# Each benchmark takes the program and returns a callable to time. If the
+# callable does more than one unit of work (e.g., it walks a whole list), ops is
+# the number of units, and the time is reported per unit.
+
+
+@benchmark("calls")
+def read_u64(prog):
+    return lambda: prog.read_u64(SEGMENT_ADDRESS)
+
+
+@benchmark("calls")
+def read_word(prog):
+    return lambda: prog.read_word(SEGMENT_ADDRESS)
+
+
+@benchmark("calls")
+def read_physical_kwarg(prog):
+    return lambda: prog.read_u32(SEGMENT_ADDRESS, physical=False)
+
+
+@benchmark("calls")
+def read_bytes(prog):
+    return lambda: prog.read(SEGMENT_ADDRESS, 64)
+
+
+@benchmark("calls")
+def object(prog):
+    return lambda: prog.object("points")
+
+
+@benchmark("calls")
+def subscript(prog):
+    return lambda: prog["points"]
+
+
+@benchmark("calls")
+def type(prog):
+    return lambda: prog.type("struct point")
+
+
+@benchmark("calls")
+def member(prog):
+    point = prog["points"][0]
+    return lambda: point.member_("y")
+
+
+@benchmark("calls")
+def getattr_member(prog):
+    point = prog["points"][0]
+    return lambda: point.y
+
+
+@benchmark("calls")
+def read_object(prog):
+    point = prog["points"][0]
+    return lambda: point.read_()
+
+
+@benchmark("calls")
+def object_constructor(prog):
+    type = prog.type("unsigned long")
+    return lambda: Object(prog, type, value=1)
+
+
+@benchmark("calls")
+def object_constructor_address(prog):
+    type = prog.type("struct point")
+    return lambda: Object(prog, type, address=POINTS_ADDRESS)
+
+
+@benchmark("calls")
+def cast_type(prog):
+    type = prog.type("unsigned long")
+    point = prog["points"][0].address_of_()
+    return lambda: cast(type, point)
+
+
+# Helpers usually pass type names as strings, which must be looked up every
+# time.
+
+
+@benchmark("casts")
+def cast_str(prog):
+    point = prog["points"][0].address_of_()
+    return lambda: cast("unsigned long", point)
+
+
+@benchmark("casts")
+def cast_pointer_str(prog):
+    address = Object(prog, "unsigned long", POINTS_ADDRESS)
+    return lambda: cast("struct point *", address)
+
+
+@benchmark("casts")
+def container_of_str(prog):
+    y = prog["points"][0].y.address_of_()
+    return lambda: container_of(y, "struct point", "y")
+
+
+@benchmark("helpers", ops=NUM_NODES)
+def list_for_each_entry_str(prog):
+    head = prog["nodes"].address_of_()
+
+    def func():
+        for _ in list_for_each_entry("struct node", head, "list"):
+            pass
+
+    return func
+
+
+# The same expression written with Python operators, evaluated by Program.eval(),
+# and compiled once.
+
+
+@benchmark("eval")
+def expression_python(prog):
+    def func():
+        (prog["points"][1].x + 1) * prog["points"][1].y
+
+    return func
+
+
+@benchmark("eval")
+def expression_eval(prog):
+    return lambda: prog.eval("(points[1].x + 1) * points[1].y")
+
+
+@benchmark("eval")
+def expression_compiled(prog):
+    expr = prog.compile("(p->x + 1) * p->y", ["p"])
+    p = prog["points"][1].address_of_()
+    return lambda: expr(p)
+
+
+# Unwinding every thread one at a time and with Program.stack_traces(), which
+# unwinds in parallel. Set OMP_NUM_THREADS to compare thread counts.
+
+
+@benchmark("unwind", ops=NUM_THREADS)
+def stack_trace_loop(prog):
+    tids = range(1, NUM_THREADS + 1)
+
+    def func():
+        for tid in tids:
+            prog.stack_trace(tid)
+
+    return func
+
+
+@benchmark("unwind", ops=NUM_THREADS)
+def stack_traces(prog):
+    tids = list(range(1, NUM_THREADS + 1))
+    return lambda: prog.stack_traces(tids)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="measure the per-call overhead of hot drgn APIs"
+    )
+    parser.add_argument(
+        "-n",
+        "--number",
+        type=int,
+        default=200000,
+        help="number of operations per measurement (default: %(default)s)",
+    )
+    parser.add_argument(
+        "-r",
+        "--repeat",
+        type=int,
+        default=5,
+        help="number of measurements; the best is reported "
+        "(default: %(default)s)",
+    )
+    parser.add_argument(
+        "-g",
+        "--group",
+        choices=sorted({group for group, _, _ in BENCHMARKS.values()}),
+        help="only run benchmarks in this group",
+    )
+    parser.add_argument(
+        "benchmarks",
+        metavar="BENCHMARK",
+        nargs="*",
+        help="benchmarks to run (default: all)",
+    )
+    args = parser.parse_args()
+
+    names = args.benchmarks or [
+        name
+        for name, (group, _, _) in BENCHMARKS.items()
+        if args.group is None or group == args.group
+    ]
+    for name in names:
+        if name not in BENCHMARKS:
+            sys.exit(f"unknown benchmark: {name}")
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        prog = create_program(tmpdir)
+        width = max(len(name) for name in names)
+        for name in names:
+            _, setup, ops = BENCHMARKS[name]
+            func = setup(prog)
+            number = max(args.number // ops, 1)
+            best = min(timeit.repeat(func, number=number, repeat=args.repeat))
+            print(f"{name:{width}}  {best / (number * ops) * 1e9:8.1f} ns/op")
+
+
+if __name__ == "__main__":
+    main()
@@ -195,7 +195,9 @@ def _compile_debug_line(cu_die, little_endian):
     return buf
 
 
-def compile_dwarf(dies, little_endian=True, bits=64, *, lang=None):
+def compile_dwarf(
+    dies, little_endian=True, bits=64, *, lang=None, symbols=(), sections=()
+):
     if isinstance(dies, DwarfDie):
         dies = (dies,)
     assert all(isinstance(die, DwarfDie) for die in dies)
@@ -210,6 +212,7 @@ def compile_dwarf(dies, little_endian=True, bits=64, *, lang=None):
     return create_elf_file(
         ET.EXEC,
         [
+            *sections,
             ElfSection(p_type=PT.LOAD, vaddr=0xFFFF0000, data=b""),
             ElfSection(
                 name=".debug_abbrev",
@@ -228,6 +231,7 @@ def compile_dwarf(dies, little_endian=True, bits=64, *, lang=None):
             ),
             ElfSection(name=".debug_str", sh_type=SHT.PROGBITS, data=b"\0"),
         ],
+        symbols,
         little_endian=little_endian,
         bits=bits,
     )
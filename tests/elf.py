@@ -41,3 +41,25 @@ class SHT(enum.IntEnum):
     PREINIT_ARRAY = 16
     GROUP = 17
     SYMTAB_SHNDX = 18
+
+
+class SHN(enum.IntEnum):
+    UNDEF = 0
+    ABS = 0xFFF1
+    COMMON = 0xFFF2
+
+
+class STB(enum.IntEnum):
+    LOCAL = 0
+    GLOBAL = 1
+    WEAK = 2
+
+
+class STT(enum.IntEnum):
+    NOTYPE = 0
+    OBJECT = 1
+    FUNC = 2
+    SECTION = 3
+    FILE = 4
+    COMMON = 5
+    TLS = 6
@@ -2,9 +2,9 @@
 # SPDX-License-Identifier: GPL-3.0+
 
 import struct
-from typing import Optional, Sequence
+from typing import NamedTuple, Optional, Sequence
 
-from tests.elf import ET, PT, SHT
+from tests.elf import ET, PT, SHN, SHT, STB, STT
 
 
 class ElfSection:
@@ -18,6 +18,9 @@ class ElfSection:
         paddr: int = 0,
         memsz: Optional[int] = None,
         p_align: int = 0,
+        sh_link: int = 0,
+        sh_info: int = 0,
+        sh_entsize: int = 0,
     ):
         self.data = data
         self.name = name
@@ -27,6 +30,9 @@ class ElfSection:
         self.paddr = paddr
         self.memsz = memsz
         self.p_align = p_align
+        self.sh_link = sh_link
+        self.sh_info = sh_info
+        self.sh_entsize = sh_entsize
 
         assert (self.name is not None) or (self.p_type is not None)
         assert (self.name is None) == (self.sh_type is None)
@@ -36,8 +42,62 @@ class ElfSection:
             self.memsz = len(self.data)
 
 
+class ElfSymbol(NamedTuple):
+    name: str
+    value: int
+    size: int
+    type: STT = STT.OBJECT
+    binding: STB = STB.GLOBAL
+    shindex: int = SHN.ABS
+
+
+def _create_symtab(
+    symbols: Sequence[ElfSymbol], symtab_index: int, little_endian: bool, bits: int
+):
+    endian = "<" if little_endian else ">"
+    if bits == 64:
+        sym_struct = struct.Struct(endian + "IBBHQQ")
+    else:
+        sym_struct = struct.Struct(endian + "IIIBBH")
+    # Local symbols must come before global symbols.
+    symbols = sorted(symbols, key=lambda sym: sym.binding != STB.LOCAL)
+    strtab = bytearray(1)
+    symtab = bytearray(sym_struct.size)  # One for the STN_UNDEF symbol.
+    first_global = 1
+    for sym in symbols:
+        if sym.binding == STB.LOCAL:
+            first_global += 1
+        st_name = len(strtab)
+        strtab.extend(sym.name.encode())
+        strtab.append(0)
+        st_info = (sym.binding << 4) | sym.type
+        if bits == 64:
+            symtab.extend(
+                sym_struct.pack(st_name, st_info, 0, sym.shindex, sym.value, sym.size)
+            )
+        else:
+            symtab.extend(
+                sym_struct.pack(st_name, sym.value, sym.size, st_info, 0, sym.shindex)
+            )
+    return [
+        ElfSection(
+            name=".symtab",
+            sh_type=SHT.SYMTAB,
+            data=symtab,
+            sh_link=symtab_index + 1,
+            sh_info=first_global,
+            sh_entsize=sym_struct.size,
+        ),
+        ElfSection(name=".strtab", sh_type=SHT.STRTAB, data=strtab),
+    ]
+
+
 def create_elf_file(
-    type: ET, sections: Sequence[ElfSection], little_endian: bool = True, bits: int = 64
+    type: ET,
+    sections: Sequence[ElfSection],
+    symbols: Sequence[ElfSymbol] = (),
+    little_endian: bool = True,
+    bits: int = 64,
 ):
     endian = "<" if little_endian else ">"
     if bits == 64:
@@ -56,6 +116,11 @@ def create_elf_file(
     tmp = [shstrtab]
     tmp.extend(sections)
     sections = tmp
+    if symbols:
+        # The .symtab section is after the SHT_NULL section and every other
+        # named section.
+        symtab_index = 1 + sum(section.name is not None for section in sections)
+        sections.extend(_create_symtab(symbols, symtab_index, little_endian, bits))
     shnum = 1  # One for the SHT_NULL section.
     phnum = 0
     for section in sections:
@@ -107,22 +172,22 @@ def create_elf_file(
     shdr_offset += shdr_struct.size
     for section in sections:
         if section.p_align:
-            padding = section.vaddr % section.p_align - len(buf) % section.p_align
+            padding = (section.vaddr - len(buf)) % section.p_align
             buf.extend(bytes(padding))
         if section.name is not None:
             shdr_struct.pack_into(
                 buf,
                 shdr_offset,
-                shstrtab.data.index(section.name.encode()),  # sh_name
+                shstrtab.data.index(section.name.encode() + b"\0"),  # sh_name
                 section.sh_type,  # sh_type
                 0,  # sh_flags
                 section.vaddr,  # sh_addr
                 len(buf),  # sh_offset
                 len(section.data),  # sh_size
-                0,  # sh_link
-                0,  # sh_info
+                section.sh_link,  # sh_link
+                section.sh_info,  # sh_info
                 1 if section.p_type is None else bits // 8,  # sh_addralign
-                0,  # sh_entsize
+                section.sh_entsize,  # sh_entsize
             )
             shdr_offset += shdr_struct.size
         if section.p_type is not None:
@@ -8,6 +8,7 @@ from drgn.helpers.linux.cgroup import (
     cgroup_path,
     css_for_each_child,
     css_for_each_descendant_pre,
+    css_walk,
 )
 from drgn.helpers.linux.pid import find_task
 from tests.helpers.linux import LinuxHelperTestCase
@@ -56,3 +57,16 @@ class TestCgroup(LinuxHelperTestCase):
                 )
             )
         )
+
+    def test_css_walk(self):
+        root = self.prog["cgrp_dfl_root"].cgrp.self.address_of_()
+        entries = list(css_walk(root, ["nr_descendants", "kn->flags"]))
+        self.assertEqual(
+            [entry.css for entry in entries], list(css_for_each_descendant_pre(root))
+        )
+        for entry in entries:
+            self.assertEqual(entry.path, cgroup_path(entry.css.cgroup))
+        self.assertIn(self.cgroup, [entry.path for entry in entries])
+        self.assertEqual(
+            entries[0].totals[0], sum(entry.counters[0] for entry in entries)
+        )
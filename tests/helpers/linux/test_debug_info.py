@@ -47,3 +47,28 @@ class TestDebugInfo(LinuxHelperTestCase):
                 del os.environ[key]
             else:
                 os.environ[key] = old_value
+
+    def test_symbolize(self):
+        addresses = []
+        with open("/proc/kallsyms", "r") as f:
+            for line in f:
+                tokens = line.split()
+                if tokens[1] in "Tt" and len(tokens) == 3:
+                    addresses.append(int(tokens[0], 16))
+                    if len(addresses) == 100:
+                        break
+        if not addresses or not any(addresses):
+            self.skipTest("kallsyms addresses are not available")
+        # Look up each address twice to exercise the cache, plus an address
+        # inside of each function.
+        addresses = addresses + addresses + [address + 1 for address in addresses]
+        symbols = self.prog.symbolize(addresses)
+        self.assertEqual(len(symbols), len(addresses))
+        for address, symbol in zip(addresses, symbols):
+            try:
+                expected = self.prog.symbol(address)
+            except LookupError:
+                self.assertIsNone(symbol)
+            else:
+                self.assertEqual(symbol, expected)
+                self.assertLessEqual(symbol.address, address)
@@ -15,10 +15,13 @@ from drgn.helpers.linux.mm import (
     access_process_vm,
     access_remote_vm,
     cmdline,
+    count_pages,
     environ,
     page_to_pfn,
     pfn_to_page,
     pfn_to_virt,
+    pointer_index,
+    scan_pages,
     virt_to_pfn,
 )
 from drgn.helpers.linux.pid import find_task
@@ -79,6 +82,38 @@ class TestMm(LinuxHelperTestCase):
                 # Test the opposite direction.
                 self.assertEqual(page_to_pfn(page), pfn)
 
+    def test_scan_pages(self):
+        with self._pages() as (map, _, pfns):
+            mapping = pfn_to_page(self.prog, pfns[0]).mapping.value_()
+            PG_mlocked = self.prog["PG_mlocked"].value_()
+            found = scan_pages(
+                self.prog,
+                flags=1 << PG_mlocked,
+                where=[("mapping", "==", mapping), ("index", "<", len(pfns))],
+            )
+            self.assertEqual(found, sorted(pfns))
+            self.assertEqual(
+                scan_pages(
+                    self.prog,
+                    not_flags=1 << PG_mlocked,
+                    where=[("mapping", "==", mapping)],
+                    start_pfn=min(pfns),
+                    end_pfn=max(pfns) + 1,
+                ),
+                [],
+            )
+
+    def test_count_pages(self):
+        with self._pages() as (map, _, pfns):
+            mapping = pfn_to_page(self.prog, pfns[0]).mapping.value_()
+            counts = count_pages(
+                self.prog,
+                "mapping",
+                flags=1 << self.prog["PG_mlocked"].value_(),
+                where=[("mapping", "==", mapping)],
+            )
+            self.assertEqual(counts, {mapping: len(pfns)})
+
     def test_read_physical(self):
         with self._pages() as (map, _, pfns):
             for i, pfn in enumerate(pfns):
@@ -128,3 +163,19 @@ class TestMm(LinuxHelperTestCase):
             proc_environ = f.read().split(b"\0")[:-1]
         task = find_task(self.prog, os.getpid())
         self.assertEqual(environ(task), proc_environ)
+
+    def test_pointer_index(self):
+        task = find_task(self.prog, os.getpid())
+        with tempfile.TemporaryDirectory(prefix="drgn-tests-") as dir:
+            path = os.path.join(dir, "pointers")
+            index = pointer_index(self.prog, path)
+            self.assertIn(
+                (task.mm.address_of_().value_(), task.mm.value_()),
+                index.referrers(task.mm),
+            )
+            loaded = pointer_index(self.prog, path)
+            self.assertEqual(len(loaded), len(index))
+            self.assertEqual(
+                loaded.referrers(task.mm, self.prog.type("struct mm_struct").size),
+                index.referrers(task.mm, self.prog.type("struct mm_struct").size),
+            )
@@ -2,10 +2,11 @@
 # SPDX-License-Identifier: GPL-3.0+
 
 import os
+import socket
 
 from drgn import cast
 from drgn.helpers.linux.fs import fget
-from drgn.helpers.linux.net import sk_fullsock
+from drgn.helpers.linux.net import sk_fullsock, socket_table
 from drgn.helpers.linux.pid import find_task
 from tests.helpers.linux import LinuxHelperTestCase, create_socket
 
@@ -16,3 +17,26 @@ class TestNet(LinuxHelperTestCase):
             file = fget(find_task(self.prog, os.getpid()), sock.fileno())
             sk = cast("struct socket *", file.private_data).sk.read_()
             self.assertTrue(sk_fullsock(sk))
+
+    def _test_socket_table(self, protocol, type):
+        with create_socket(socket.AF_INET, type) as sock:
+            sock.bind(("127.0.0.1", 0))
+            if type == socket.SOCK_STREAM:
+                sock.listen()
+            port = sock.getsockname()[1]
+            table = socket_table(self.prog, protocol)
+            i = table["inode"].index(os.fstat(sock.fileno()).st_ino)
+            file = fget(find_task(self.prog, os.getpid()), sock.fileno())
+            sk = cast("struct socket *", file.private_data).sk
+            self.assertEqual(table["sk"][i], sk.value_())
+            self.assertEqual(table["family"][i], socket.AF_INET)
+            self.assertEqual(table["saddr"][i], socket.inet_aton("127.0.0.1"))
+            self.assertEqual(table["sport"][i], port)
+            self.assertEqual(table["dport"][i], 0)
+            self.assertEqual(table["state"][i], sk.__sk_common.skc_state)
+
+    def test_socket_table_tcp(self):
+        self._test_socket_table("tcp", socket.SOCK_STREAM)
+
+    def test_socket_table_udp(self):
+        self._test_socket_table("udp", socket.SOCK_DGRAM)
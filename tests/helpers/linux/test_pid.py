@@ -3,7 +3,13 @@
 
 import os
 
-from drgn.helpers.linux.pid import find_pid, find_task, for_each_pid, for_each_task
+from drgn.helpers.linux.pid import (
+    find_pid,
+    find_task,
+    for_each_pid,
+    for_each_task,
+    task_table,
+)
 from tests.helpers.linux import LinuxHelperTestCase
 
 
@@ -32,3 +38,17 @@ class TestPid(LinuxHelperTestCase):
     def test_for_each_task(self):
         pid = os.getpid()
         self.assertTrue(any(task.pid == pid for task in for_each_task(self.prog)))
+
+    def test_task_table(self):
+        pid = os.getpid()
+        with open("/proc/self/comm", "rb") as f:
+            comm = f.read()[:-1]
+        task = find_task(self.prog, pid)
+        table = task_table(self.prog, ["pid", "comm", "mm->mmap_base"])
+        i = table["pid"].index(pid)
+        self.assertEqual(table["task"][i], task.value_())
+        self.assertEqual(table["comm"][i], comm)
+        self.assertEqual(table["mm->mmap_base"][i], task.mm.mmap_base)
+        # Kernel threads don't have an mm.
+        kthreadd = table["pid"].index(2)
+        self.assertIsNone(table["mm->mmap_base"][kthreadd])
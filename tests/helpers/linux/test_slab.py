@@ -0,0 +1,45 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import os
+
+from drgn.helpers.linux.pid import find_task
+from drgn.helpers.linux.slab import (
+    find_slab_cache,
+    for_each_slab_cache,
+    slab_cache_for_each_allocated_object,
+    slab_cache_objects,
+    slab_object_info,
+)
+from tests.helpers.linux import LinuxHelperTestCase
+
+
+class TestSlab(LinuxHelperTestCase):
+    def setUp(self):
+        super().setUp()
+        if not self.prog.type("struct kmem_cache").has_member("cpu_slab"):
+            self.skipTest("kernel does not use SLUB")
+
+    def test_find_slab_cache(self):
+        for s in for_each_slab_cache(self.prog):
+            self.assertEqual(find_slab_cache(self.prog, s.name.string_()), s)
+        self.assertIsNone(find_slab_cache(self.prog, "not a slab cache"))
+
+    def test_slab_object_info(self):
+        task = find_task(self.prog, os.getpid())
+        info = slab_object_info(self.prog, task.value_() + 1)
+        self.assertEqual(info.slab_cache.name.string_(), b"task_struct")
+        self.assertEqual(info.address, task.value_())
+        self.assertTrue(info.allocated)
+        self.assertIsNone(slab_object_info(self.prog, 0))
+
+    def test_slab_cache_objects(self):
+        task = find_task(self.prog, os.getpid())
+        slab_cache = find_slab_cache(self.prog, "task_struct")
+        self.assertIn(task.value_(), slab_cache_objects(slab_cache))
+        self.assertIn(
+            task, slab_cache_for_each_allocated_object(slab_cache, "struct task_struct")
+        )
+        self.assertNotIn(
+            task.value_(), slab_cache_objects(slab_cache, allocated=False, free=True)
+        )
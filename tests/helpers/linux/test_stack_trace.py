@@ -29,6 +29,28 @@ class TestStackTrace(LinuxHelperTestCase):
         os.kill(pid, signal.SIGKILL)
         os.waitpid(pid, 0)
 
+    def test_stack_traces(self):
+        pids = [fork_and_pause() for _ in range(3)]
+        try:
+            for pid in pids:
+                wait_until(lambda: proc_state(pid) == "S")
+            threads = [find_task(self.prog, pid) for pid in pids]
+            threads.append(pids[0])
+            # The current task is running, so it can't be unwound.
+            threads.append(os.getpid())
+            traces = self.prog.stack_traces(threads)
+            self.assertEqual(len(traces), len(threads))
+            for trace in traces[:-1]:
+                self.assertIn("schedule", str(trace))
+            self.assertEqual(
+                [frame.pc for frame in traces[0]], [frame.pc for frame in traces[3]]
+            )
+            self.assertIsNone(traces[-1])
+        finally:
+            for pid in pids:
+                os.kill(pid, signal.SIGKILL)
+                os.waitpid(pid, 0)
+
     def test_pt_regs(self):
         # This won't unwind anything useful, but at least make sure it accepts
         # a struct pt_regs.
@@ -177,6 +177,7 @@ class C_TOKEN(enum.IntEnum):
     STRUCT = auto()
     UNION = auto()
     ENUM = auto()
+    SIZEOF = auto()
     LPAREN = auto()
     RPAREN = auto()
     LBRACKET = auto()
@@ -185,6 +186,28 @@ class C_TOKEN(enum.IntEnum):
     DOT = auto()
     NUMBER = auto()
     IDENTIFIER = auto()
+    ARROW = auto()
+    PLUS = auto()
+    MINUS = auto()
+    SLASH = auto()
+    PERCENT = auto()
+    LSHIFT = auto()
+    RSHIFT = auto()
+    LT = auto()
+    GT = auto()
+    LE = auto()
+    GE = auto()
+    EQ = auto()
+    NE = auto()
+    AMPERSAND = auto()
+    PIPE = auto()
+    CARET = auto()
+    TILDE = auto()
+    EXCLAMATION = auto()
+    LOGICAL_AND = auto()
+    LOGICAL_OR = auto()
+    QUESTION = auto()
+    COLON = auto()
 
 
 class Token:
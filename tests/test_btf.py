@@ -0,0 +1,240 @@
+# Copyright (c) Facebook, Inc. and its affiliates.
+# SPDX-License-Identifier: GPL-3.0+
+
+import struct
+import tempfile
+
+from drgn import Program, Qualifiers, TypeEnumerator, TypeMember, TypeParameter
+from tests import MOCK_PLATFORM, TestCase
+from tests.elf import ET, SHT
+from tests.elfwriter import ElfSection, create_elf_file
+
+BTF_KIND_INT = 1
+BTF_KIND_PTR = 2
+BTF_KIND_ARRAY = 3
+BTF_KIND_STRUCT = 4
+BTF_KIND_ENUM = 6
+BTF_KIND_FWD = 7
+BTF_KIND_TYPEDEF = 8
+BTF_KIND_CONST = 10
+BTF_KIND_FUNC_PROTO = 13
+BTF_KIND_FLOAT = 16
+
+BTF_INT_SIGNED = 1
+BTF_INT_BOOL = 4
+
+
+def btf_int(name, size, encoding):
+    return (name, BTF_KIND_INT, 0, 0, size, (encoding << 24 | 8 * size,))
+
+
+def btf_data(types, little_endian=True):
+    """
+    Encode BTF. Each type is a tuple of (name, kind, vlen, kind_flag,
+    size_or_type, trailing words), where names in the trailing words are
+    replaced with string offsets.
+    """
+    endian = "<" if little_endian else ">"
+    strs = bytearray(b"\0")
+
+    def str_off(s):
+        if not s:
+            return 0
+        off = len(strs)
+        strs.extend(s.encode() + b"\0")
+        return off
+
+    type_section = bytearray()
+    for name, kind, vlen, kind_flag, size_or_type, trailing in types:
+        info = kind_flag << 31 | kind << 24 | vlen
+        type_section.extend(
+            struct.pack(endian + "III", str_off(name), info, size_or_type)
+        )
+        for word in trailing:
+            if isinstance(word, str):
+                word = str_off(word)
+            type_section.extend(struct.pack(endian + "I", word & 0xFFFFFFFF))
+    header = struct.pack(
+        endian + "HBBIIIII",
+        0xEB9F,
+        1,
+        0,
+        24,
+        0,
+        len(type_section),
+        len(type_section),
+        len(strs),
+    )
+    return header + type_section + strs
+
+
+TYPES = (
+    # 1
+    btf_int("int", 4, BTF_INT_SIGNED),
+    # 2
+    ("point", BTF_KIND_STRUCT, 2, 0, 8, ("x", 1, 0, "y", 1, 32)),
+    # 3
+    (None, BTF_KIND_PTR, 0, 0, 2, ()),
+    # 4
+    ("point_t", BTF_KIND_TYPEDEF, 0, 0, 2, ()),
+    # 5
+    (None, BTF_KIND_ARRAY, 0, 0, 0, (1, 1, 4)),
+    # 6
+    (
+        "foo",
+        BTF_KIND_STRUCT,
+        4,
+        1,
+        32,
+        ("p", 3, 0, "a", 5, 64, "flags", 1, 3 << 24 | 192, "data", 10, 224),
+    ),
+    # 7
+    (None, BTF_KIND_CONST, 0, 0, 1, ()),
+    # 8
+    ("color", BTF_KIND_ENUM, 2, 0, 4, ("RED", 0, "BLUE", -1)),
+    # 9
+    ("point", BTF_KIND_FWD, 0, 0, 0, ()),
+    # 10
+    (None, BTF_KIND_ARRAY, 0, 0, 0, (1, 1, 0)),
+    # 11
+    (None, BTF_KIND_FUNC_PROTO, 2, 0, 1, ("x", 7, 0, 0)),
+    # 12
+    ("func_t", BTF_KIND_TYPEDEF, 0, 0, 11, ()),
+    # 13
+    ("bar", BTF_KIND_STRUCT, 1, 0, 8, ("next", 14, 0)),
+    # 14
+    (None, BTF_KIND_PTR, 0, 0, 9, ()),
+    # 15
+    btf_int("_Bool", 1, BTF_INT_BOOL),
+    # 16
+    ("double", BTF_KIND_FLOAT, 0, 0, 8, ()),
+    # 17: forward declaration of enum color.
+    ("color", BTF_KIND_ENUM, 0, 0, 4, ()),
+)
+
+
+def btf_program(data):
+    prog = Program(MOCK_PLATFORM)
+    with tempfile.NamedTemporaryFile() as f:
+        f.write(data)
+        f.flush()
+        prog.load_btf(f.name)
+    return prog
+
+
+def point_type(prog):
+    int_type = prog.int_type("int", 4, True)
+    return prog.struct_type(
+        "point", 8, (TypeMember(int_type, "x", 0), TypeMember(int_type, "y", 32))
+    )
+
+
+class TestBtf(TestCase):
+    def setUp(self):
+        self.prog = btf_program(btf_data(TYPES))
+        self.int_type = self.prog.int_type("int", 4, True)
+        self.point_type = point_type(self.prog)
+
+    def test_base_types(self):
+        self.assertIdentical(self.prog.type("int"), self.int_type)
+        self.assertIdentical(self.prog.type("_Bool"), self.prog.bool_type("_Bool", 1))
+        self.assertIdentical(
+            self.prog.type("double"), self.prog.float_type("double", 8)
+        )
+
+    def test_struct(self):
+        self.assertIdentical(self.prog.type("struct point"), self.point_type)
+        self.assertIdentical(
+            self.prog.type("point_t"),
+            self.prog.typedef_type("point_t", self.point_type),
+        )
+
+    def test_members(self):
+        self.assertIdentical(
+            self.prog.type("struct foo"),
+            self.prog.struct_type(
+                "foo",
+                32,
+                (
+                    TypeMember(self.prog.pointer_type(self.point_type), "p", 0),
+                    TypeMember(self.prog.array_type(self.int_type, 4), "a", 64),
+                    TypeMember(self.int_type, "flags", 192, 3),
+                    TypeMember(self.prog.array_type(self.int_type), "data", 224),
+                ),
+            ),
+        )
+
+    def test_forward_declaration(self):
+        self.assertIdentical(
+            self.prog.type("struct bar"),
+            self.prog.struct_type(
+                "bar",
+                8,
+                (TypeMember(self.prog.pointer_type(self.point_type), "next", 0),),
+            ),
+        )
+
+    def test_enum(self):
+        self.assertIdentical(
+            self.prog.type("enum color"),
+            self.prog.enum_type(
+                "color",
+                self.prog.int_type("<unknown>", 4, True),
+                (TypeEnumerator("RED", 0), TypeEnumerator("BLUE", -1)),
+            ),
+        )
+
+    def test_function(self):
+        self.assertIdentical(
+            self.prog.type("func_t"),
+            self.prog.typedef_type(
+                "func_t",
+                self.prog.function_type(
+                    self.int_type,
+                    (
+                        TypeParameter(
+                            self.prog.int_type(
+                                "int", 4, True, qualifiers=Qualifiers.CONST
+                            ),
+                            "x",
+                        ),
+                    ),
+                    True,
+                ),
+            ),
+        )
+
+    def test_not_found(self):
+        self.assertRaises(LookupError, self.prog.type, "struct baz")
+        self.assertRaises(LookupError, self.prog.type, "union point")
+        self.assertRaises(LookupError, self.prog.type, "struct point", "point.c")
+
+    def test_big_endian(self):
+        prog = btf_program(btf_data(TYPES, little_endian=False))
+        self.assertIdentical(prog.type("struct point"), point_type(prog))
+
+    def test_elf(self):
+        prog = btf_program(
+            create_elf_file(
+                ET.EXEC,
+                [ElfSection(name=".BTF", sh_type=SHT.PROGBITS, data=btf_data(TYPES))],
+            )
+        )
+        self.assertIdentical(prog.type("struct point"), point_type(prog))
+
+    def test_load_twice(self):
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(btf_data(TYPES))
+            f.flush()
+            self.assertRaisesRegex(
+                ValueError, "already loaded", self.prog.load_btf, f.name
+            )
+
+    def test_invalid(self):
+        self.assertRaisesRegex(Exception, "bad magic", btf_program, b"\0" * 24)
+        data = bytearray(btf_data(TYPES))
+        # Point the first type's name past the end of the string section.
+        data[24:28] = struct.pack("<I", 0xFFFF)
+        self.assertRaisesRegex(
+            Exception, "invalid string offset", btf_program, bytes(data)
+        )
@@ -5,8 +5,15 @@ from functools import reduce
 import operator
 import unittest
 
-from drgn import Qualifiers, TypeEnumerator, TypeMember, TypeParameter
-from tests import MockProgramTestCase
+from drgn import (
+    FaultError,
+    Object,
+    Qualifiers,
+    TypeEnumerator,
+    TypeMember,
+    TypeParameter,
+)
+from tests import MockObject, MockProgramTestCase
 from tests.libdrgn import C_TOKEN, Lexer, drgn_lexer_c
 
 
@@ -636,6 +643,177 @@ typedef struct {
         )
 
 
+class TestExpression(MockProgramTestCase):
+    def setUp(self):
+        super().setUp()
+        self.add_memory_segment(
+            b"".join(i.to_bytes(4, "little") for i in range(1, 7)),
+            virt_addr=0xFFFF0000,
+        )
+        self.types.append(self.point_type)
+        self.types.append(self.pid_type)
+        self.points_type = self.prog.array_type(self.point_type, 3)
+        self.objects.append(MockObject("points", self.points_type, address=0xFFFF0000))
+        self.objects.append(MockObject("limit", self.prog.type("int"), value=10))
+
+    def test_integer_literals(self):
+        self.assertIdentical(self.prog.eval("1"), self.int(1))
+        self.assertIdentical(self.prog.eval("0x1f"), self.int(31))
+        self.assertIdentical(self.prog.eval("0XAb"), self.int(0xAB))
+        self.assertIdentical(self.prog.eval("017"), self.int(15))
+        self.assertIdentical(
+            self.prog.eval("0xffffffff"), self.unsigned_int(2 ** 32 - 1)
+        )
+        self.assertIdentical(self.prog.eval("10u"), self.unsigned_int(10))
+        self.assertIdentical(self.prog.eval("10L"), self.long(10))
+        self.assertIdentical(
+            self.prog.eval("0x10ull"),
+            Object(self.prog, "unsigned long long", value=16),
+        )
+        self.assertRaisesRegex(
+            SyntaxError, "invalid number", self.prog.eval, "10lu2"
+        )
+
+    def test_arithmetic(self):
+        self.assertIdentical(self.prog.eval("1 + 2 * 3"), self.int(7))
+        self.assertIdentical(self.prog.eval("(1 + 2) * 3"), self.int(9))
+        self.assertIdentical(self.prog.eval("10 - 4 - 3"), self.int(3))
+        self.assertIdentical(self.prog.eval("17 / 5 % 2"), self.int(1))
+        self.assertIdentical(self.prog.eval("1 << 4 | 1 ^ 3 & 2"), self.int(19))
+        self.assertIdentical(self.prog.eval("-limit >> 1"), self.int(-5))
+        self.assertIdentical(self.prog.eval("~+0"), self.int(-1))
+
+    def test_comparison(self):
+        self.assertIdentical(self.prog.eval("1 < 2"), self.int(1))
+        self.assertIdentical(self.prog.eval("2 <= 1"), self.int(0))
+        self.assertIdentical(self.prog.eval("limit > 9 == 1"), self.int(1))
+        self.assertIdentical(self.prog.eval("limit >= 11 != 0"), self.int(0))
+        self.assertIdentical(self.prog.eval("!limit"), self.int(0))
+
+    def test_short_circuit(self):
+        self.assertRaises(FaultError, self.prog.eval, "*(int *)0 + 1")
+        self.assertIdentical(self.prog.eval("0 && *(int *)0"), self.int(0))
+        self.assertIdentical(self.prog.eval("limit || *(int *)0"), self.int(1))
+        self.assertIdentical(self.prog.eval("limit ? 2 : *(int *)0"), self.int(2))
+        self.assertIdentical(self.prog.eval("0 ? *(int *)0 : 0 ? 1 : 3"), self.int(3))
+
+    def test_member_and_subscript(self):
+        self.assertIdentical(
+            self.prog.eval("points[1].y"),
+            Object(self.prog, "int", address=0xFFFF000C),
+        )
+        self.assertIdentical(
+            self.prog.eval("(&points[2])->x"),
+            Object(self.prog, "int", address=0xFFFF0010),
+        )
+        self.assertEqual(self.prog.eval("points[limit - 9].x + 1").value_(), 4)
+        self.assertRaisesRegex(
+            LookupError, "has no member 'z'", self.prog.eval, "points[0].z"
+        )
+
+    def test_cast(self):
+        ptr = Object(self.prog, self.prog.pointer_type(self.point_type), 0xFFFF0008)
+        self.assertIdentical(self.prog.eval("(struct point *)0xffff0008"), ptr)
+        self.assertIdentical(
+            self.prog.eval("((struct point *)0xffff0008)->y"),
+            Object(self.prog, "int", address=0xFFFF000C),
+        )
+        self.assertIdentical(
+            self.prog.eval("(pid_t)5"), Object(self.prog, self.pid_type, value=5)
+        )
+        self.assertIdentical(
+            self.prog.eval("(unsigned long)-1"),
+            Object(self.prog, "unsigned long", value=2 ** 64 - 1),
+        )
+        self.assertIdentical(self.prog.eval("(limit)"), self.int(10))
+
+    def test_sizeof(self):
+        size_t = self.prog.type("size_t")
+        self.assertIdentical(
+            self.prog.eval("sizeof(struct point)"), Object(self.prog, size_t, 8)
+        )
+        self.assertIdentical(
+            self.prog.eval("sizeof(int [4])"), Object(self.prog, size_t, 16)
+        )
+        self.assertIdentical(
+            self.prog.eval("sizeof points"), Object(self.prog, size_t, 24)
+        )
+        self.assertIdentical(
+            self.prog.eval("sizeof (points)[0]"), Object(self.prog, size_t, 8)
+        )
+        # The operand of sizeof is not evaluated.
+        self.assertIdentical(
+            self.prog.eval("sizeof(*(int *)0)"), Object(self.prog, size_t, 4)
+        )
+        self.assertIdentical(
+            self.prog.eval("sizeof(((struct point *)0)->y + 1L)"),
+            Object(self.prog, size_t, 8),
+        )
+        self.assertIdentical(
+            self.prog.eval(
+                "sizeof(p[100000].x / 0)",
+                p=Object(self.prog, self.prog.pointer_type(self.point_type), 0),
+            ),
+            Object(self.prog, size_t, 4),
+        )
+        self.assertIdentical(
+            self.prog.eval("sizeof(limit ? points[0] : points[1])"),
+            Object(self.prog, size_t, 8),
+        )
+
+    def test_variables(self):
+        ptr = Object(self.prog, self.prog.pointer_type(self.point_type), 0xFFFF0008)
+        self.assertIdentical(self.prog.eval("p->x * n", p=ptr, n=2), self.int(6))
+        # Variables shadow objects in the program.
+        self.assertIdentical(
+            self.prog.eval("limit", limit=True), Object(self.prog, value=True)
+        )
+        self.assertRaises(TypeError, self.prog.eval, "p", p="foo")
+        self.assertRaises(TypeError, self.prog.eval, "1", 2)
+
+    def test_compile(self):
+        expr = self.prog.compile("p->y + n", ["p", "n"])
+        self.assertEqual(expr.params, ("p", "n"))
+        self.assertIs(expr.prog, self.prog)
+        for i in range(3):
+            ptr = Object(
+                self.prog, self.prog.pointer_type(self.point_type), 0xFFFF0000 + 8 * i
+            )
+            self.assertIdentical(expr(ptr, 1), self.int(2 * i + 3))
+            self.assertIdentical(expr(n=1, p=ptr), self.int(2 * i + 3))
+        self.assertIdentical(self.prog.compile("2 * limit")(), self.int(20))
+        self.assertRaises(TypeError, expr, ptr)
+        self.assertRaises(TypeError, expr, ptr, 1, 2)
+        self.assertRaises(TypeError, expr, ptr, 1, n=1)
+        self.assertRaises(TypeError, expr, ptr, 1, m=1)
+
+    def test_depth(self):
+        self.assertIdentical(self.prog.eval("(" * 500 + "1" + ")" * 500), self.int(1))
+        self.assertIdentical(self.prog.eval("-" * 500 + "1"), self.int(1))
+        self.assertIdentical(self.prog.eval(" + ".join(["1"] * 500)), self.int(500))
+        for s in [
+            "(" * 10000 + "1" + ")" * 10000,
+            "-" * 10000 + "1",
+            "sizeof " * 10000 + "1",
+            " + ".join(["1"] * 10000),
+            " ? ".join(["1"] * 10000) + " : 0" * 9999,
+        ]:
+            with self.subTest(s=s[:10]):
+                self.assertRaisesRegex(
+                    RecursionError, "maximum expression depth", self.prog.eval, s
+                )
+
+    def test_errors(self):
+        for s in ["", "1 +", "(1", "1 2", "limit = 1", "points.", "1 ? 2", "(int)"]:
+            with self.subTest(s=s):
+                self.assertRaises(SyntaxError, self.prog.eval, s)
+        self.assertRaises(LookupError, self.prog.eval, "foo + 1")
+        # Syntax errors are reported before unknown identifiers.
+        self.assertRaises(SyntaxError, self.prog.eval, "foo bar")
+        self.assertRaises(SyntaxError, self.prog.eval, "foo +")
+        self.assertRaises(LookupError, self.prog.eval, "(struct foo *)0")
+
+
 class TestLexer(unittest.TestCase):
     def lex(self, s):
         lexer = Lexer(drgn_lexer_c, s)
@@ -662,9 +840,47 @@ class TestLexer(unittest.TestCase):
         ]
         self.assertEqual([token.kind for token in self.lex(s)], tokens)
 
+    def test_operators(self):
+        s = "-> + - / % << >> < > <= >= == != & | ^ ~ ! && || ? :"
+        tokens = [
+            C_TOKEN.ARROW,
+            C_TOKEN.PLUS,
+            C_TOKEN.MINUS,
+            C_TOKEN.SLASH,
+            C_TOKEN.PERCENT,
+            C_TOKEN.LSHIFT,
+            C_TOKEN.RSHIFT,
+            C_TOKEN.LT,
+            C_TOKEN.GT,
+            C_TOKEN.LE,
+            C_TOKEN.GE,
+            C_TOKEN.EQ,
+            C_TOKEN.NE,
+            C_TOKEN.AMPERSAND,
+            C_TOKEN.PIPE,
+            C_TOKEN.CARET,
+            C_TOKEN.TILDE,
+            C_TOKEN.EXCLAMATION,
+            C_TOKEN.LOGICAL_AND,
+            C_TOKEN.LOGICAL_OR,
+            C_TOKEN.QUESTION,
+            C_TOKEN.COLON,
+        ]
+        self.assertEqual([token.kind for token in self.lex(s)], tokens)
+        self.assertEqual(
+            [token.kind for token in self.lex("a->b-c")],
+            [
+                C_TOKEN.IDENTIFIER,
+                C_TOKEN.ARROW,
+                C_TOKEN.IDENTIFIER,
+                C_TOKEN.MINUS,
+                C_TOKEN.IDENTIFIER,
+            ],
+        )
+
     def test_keywords(self):
         s = """void char short int long signed unsigned _Bool float double
-        _Complex const restrict volatile _Atomic struct union enum"""
+        _Complex const restrict volatile _Atomic struct union enum sizeof"""
         tokens = [
             C_TOKEN.VOID,
             C_TOKEN.CHAR,
@@ -684,6 +900,7 @@ class TestLexer(unittest.TestCase):
             C_TOKEN.STRUCT,
             C_TOKEN.UNION,
             C_TOKEN.ENUM,
+            C_TOKEN.SIZEOF,
         ]
         self.assertEqual([token.kind for token in self.lex(s)], tokens)
 
@@ -696,7 +913,7 @@ class TestLexer(unittest.TestCase):
         )
 
     def test_number(self):
-        s = "0 1234 0xdeadbeef"
+        s = "0 1234 0xdeadbeef 0XCAFE 1u 2L 3ul 4LLU 0x5llu"
         tokens = s.split()
         self.assertEqual(
             [(token.kind, token.value) for token in self.lex(s)],
@@ -704,7 +921,7 @@ class TestLexer(unittest.TestCase):
         )
 
     def test_invalid_number(self):
-        for s in ["0x", "1234y"]:
+        for s in ["0x", "1234y", "1uu", "1lul", "1lL", "2ux"]:
             self.assertRaisesRegex(SyntaxError, "invalid number", list, self.lex(s))
 
     def test_invalid_character(self):
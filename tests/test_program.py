@@ -4,7 +4,9 @@
 import ctypes
 import itertools
 import os
+import struct
 import tempfile
+import threading
 import unittest.mock
 
 from drgn import (
@@ -12,14 +14,18 @@ from drgn import (
     FaultError,
     FindObjectFlags,
     Object,
+    OutOfBoundsError,
     Platform,
     PlatformFlags,
     Program,
     ProgramFlags,
     Qualifiers,
     TypeKind,
+    TypeMember,
     host_platform,
 )
+from drgn.helpers.linux.mm import pointer_index
+from drgn.helpers.linux.percpu import per_cpu_ptr
 from tests import (
     DEFAULT_LANGUAGE,
     MOCK_32BIT_PLATFORM,
@@ -30,8 +36,9 @@ from tests import (
     TestCase,
     mock_program,
 )
-from tests.elf import ET, PT
-from tests.elfwriter import ElfSection, create_elf_file
+from tests.dwarfwriter import compile_dwarf
+from tests.elf import ET, PT, SHT, STB, STT
+from tests.elfwriter import ElfSection, ElfSymbol, create_elf_file
 
 
 def zero_memory_read(address, count, offset, physical):
@@ -141,6 +148,80 @@ class TestMemory(TestCase):
             MOCK_32BIT_PLATFORM, segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)]
         )
 
+    def test_read_keywords(self):
+        data = b"\x01\x02\x03\x04\x05\x06\x07\x08"
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000, 0xA0)])
+        self.assertEqual(prog.read(address=0xA0, size=2, physical=True), data[:2])
+        self.assertEqual(
+            prog.read_u64(address=0xA0, physical=True),
+            int.from_bytes(data, "little"),
+        )
+        self.assertEqual(
+            prog.read_word(0xFFFF0000, physical=False), int.from_bytes(data, "little")
+        )
+        self.assertRaises(TypeError, prog.read_u32)
+        self.assertRaises(TypeError, prog.read_u32, 0xA0, True, False)
+        self.assertRaises(TypeError, prog.read_u32, 0xA0, foo=True)
+
+    def test_search_memory(self):
+        data = bytearray(0x3000)
+        data[0x10:0x16] = b"needle"
+        # Crosses the boundary between the two segments.
+        data[0x1FFD:0x2003] = b"needle"
+        data[0x100:0x108] = (0xFFFF8881DEADBEEF).to_bytes(8, "little")
+        prog = mock_program(
+            segments=[
+                MockMemorySegment(bytes(data[:0x2000]), 0xFFFF0000),
+                MockMemorySegment(bytes(data[0x2000:]), 0xFFFF2000),
+            ]
+        )
+        self.assertEqual(list(prog.search_memory(b"needle")), [0xFFFF0010, 0xFFFF1FFD])
+        self.assertEqual(list(prog.search_memory(b"needle", align=8)), [0xFFFF0010])
+        self.assertEqual(
+            list(prog.search_memory(b"NEEDLE", b"\xdf" * 6)), [0xFFFF0010, 0xFFFF1FFD]
+        )
+        self.assertEqual(
+            list(prog.search_memory(b"needle", start=0xFFFF0011)), [0xFFFF1FFD]
+        )
+        self.assertEqual(
+            list(prog.search_memory(b"needle", end=0xFFFF0011)), [0xFFFF0010]
+        )
+        self.assertEqual(
+            list(prog.search_memory(b"needle", start=0xFFFF0011, end=0xFFFF0010)), []
+        )
+        self.assertEqual(
+            list(
+                prog.search_memory(
+                    (0xFFFF888100000000).to_bytes(8, "little"),
+                    (0xFFFFFFFF00000000).to_bytes(8, "little"),
+                    align=8,
+                )
+            ),
+            [0xFFFF0100],
+        )
+        self.assertEqual(list(prog.search_memory(b"needle", physical=True)), [])
+        self.assertRaises(ValueError, prog.search_memory, b"")
+        self.assertRaises(ValueError, prog.search_memory, b"needle", b"\xff")
+        self.assertRaises(ValueError, prog.search_memory, b"needle", align=0)
+
+    def test_search_memory_live(self):
+        prog = Program()
+        prog.set_pid(os.getpid())
+        needle = os.urandom(16)
+        buf = ctypes.create_string_buffer(needle)
+        self.assertIn(ctypes.addressof(buf), list(prog.search_memory(needle)))
+
+    def test_search_memory_large(self):
+        data = bytearray(0x101000)
+        # Crosses the boundary between two chunks.
+        data[0xFFFFD:0x100003] = b"needle"
+        data[-6:] = b"needle"
+        prog = mock_program(segments=[MockMemorySegment(bytes(data), 0x10000000)])
+        self.assertEqual(
+            list(prog.search_memory(b"needle")),
+            [0x100FFFFD, 0x10000000 + len(data) - 6],
+        )
+
     def test_bad_address(self):
         data = b"hello, world!"
         prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000)])
@@ -173,6 +254,100 @@ class TestMemory(TestCase):
         )
         self.assertEqual(prog.read(0xFFFF0000, 14), data[:14])
 
+    def test_reentrant_read(self):
+        data = b"hello, world!"
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(
+            0xFFFF0000,
+            len(data),
+            lambda address, count, offset, physical: data[offset : offset + count],
+        )
+        prog.add_memory_segment(
+            0xA0000000,
+            len(data),
+            lambda address, count, offset, physical: prog.read(
+                0xFFFF0000 + offset, count
+            ),
+        )
+        self.assertEqual(prog.read(0xA0000000, len(data)), data)
+
+    def test_reentrant_read_search_memory(self):
+        size = 0x400000
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, 16, zero_memory_read)
+        prog.add_memory_segment(
+            0xA0000000,
+            size,
+            lambda address, count, offset, physical: prog.read(0xFFFF0000, 1)
+            * count,
+        )
+        # The read callback may run on a worker thread while the main thread
+        # holds the program lock. Using the program from there must raise
+        # instead of deadlocking. Exceptions from worker threads are reported
+        # as a generic Exception.
+        try:
+            self.assertEqual(list(prog.search_memory(b"needle")), [])
+        except Exception as e:
+            self.assertIn("RuntimeError: program cannot be used", str(e))
+
+    def test_read_threads(self):
+        barrier = threading.Barrier(2, timeout=30)
+
+        def read_fn(address, count, offset, physical):
+            barrier.wait()
+            return bytes(range(offset, offset + count))
+
+        progs = []
+        for _ in range(2):
+            prog = Program(MOCK_PLATFORM)
+            prog.add_memory_segment(0xFFFF0000, 16, read_fn)
+            progs.append(prog)
+        results = [None] * len(progs)
+
+        def target(i):
+            results[i] = progs[i].read(0xFFFF0004, 4)
+
+        threads = [
+            threading.Thread(target=target, args=(i,)) for i in range(len(progs))
+        ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(results, [b"\x04\x05\x06\x07"] * len(progs))
+
+    def test_read_threads_same_program(self):
+        started = threading.Event()
+        release = threading.Event()
+        events = []
+
+        def read_fn(address, count, offset, physical):
+            started.set()
+            release.wait(30)
+            events.append("read")
+            return bytes(count)
+
+        prog = Program(MOCK_PLATFORM)
+        prog.add_memory_segment(0xFFFF0000, 16, read_fn)
+        prog.add_memory_segment(0xA0000000, 16, zero_memory_read)
+
+        def read_u8():
+            prog.read_u8(0xA0000000)
+            events.append("read_u8")
+
+        reader = threading.Thread(target=prog.read, args=(0xFFFF0000, 4))
+        reader.start()
+        started.wait(30)
+        # read_u8() holds the GIL, but it must wait for the read() in the other
+        # thread to finish with the program.
+        other = threading.Thread(target=read_u8)
+        other.start()
+        other.join(0.1)
+        release.set()
+        reader.join()
+        other.join()
+        self.assertEqual(events, ["read", "read_u8"])
+
     def test_overlap_same_address_smaller_size(self):
         # Existing segment: |_______|
         # New segment:      |___|
@@ -359,6 +534,29 @@ class TestTypes(MockProgramTestCase):
         self.prog.add_type_finder(lambda kind, name, filename: None)
         self.assertRaises(LookupError, self.prog.type, "struct foo")
 
+    def test_cache(self):
+        finder = unittest.mock.Mock(
+            side_effect=lambda kind, name, filename: self.point_type
+            if name == "point"
+            else None
+        )
+        self.prog.add_type_finder(finder)
+        for _ in range(2):
+            self.assertIdentical(self.prog.type("struct point"), self.point_type)
+            self.assertIdentical(
+                self.prog.type("struct point *"),
+                self.prog.pointer_type(self.point_type),
+            )
+            self.assertRaises(LookupError, self.prog.type, "struct foo")
+            self.assertRaises(SyntaxError, self.prog.type, "struct point (")
+        self.assertEqual(finder.call_count, 2)
+
+        # Adding a finder invalidates the cache.
+        self.prog.add_type_finder(lambda kind, name, filename: None)
+        self.assertIdentical(self.prog.type("struct point"), self.point_type)
+        self.assertRaises(LookupError, self.prog.type, "struct foo")
+        self.assertEqual(finder.call_count, 4)
+
     def test_default_primitive_types(self):
         def spellings(tokens, num_optional=0):
             for i in range(len(tokens) - num_optional, len(tokens) + 1):
@@ -657,6 +855,32 @@ class TestObjects(MockProgramTestCase):
         self.assertRaises(LookupError, self.prog.object, "foo")
         self.assertFalse("foo" in self.prog)
 
+    def test_cache(self):
+        self.objects.append(
+            MockObject(
+                "counter", self.prog.int_type("int", 4, True), address=0xFFFF0000
+            )
+        )
+        finder = unittest.mock.Mock(return_value=None)
+        self.prog.add_object_finder(finder)
+        for _ in range(2):
+            self.assertIdentical(
+                self.prog["counter"],
+                Object(
+                    self.prog, self.prog.int_type("int", 4, True), address=0xFFFF0000
+                ),
+            )
+            self.assertRaises(LookupError, self.prog.object, "foo")
+            self.assertRaises(
+                LookupError, self.prog.object, "counter", FindObjectFlags.CONSTANT
+            )
+        self.assertEqual(finder.call_count, 3)
+
+        # Adding a finder invalidates the cache.
+        self.prog.add_object_finder(lambda prog, name, flags, filename: None)
+        self.prog["counter"]
+        self.assertEqual(finder.call_count, 4)
+
     def test_constant(self):
         self.objects.append(
             MockObject("PAGE_SIZE", self.prog.int_type("int", 4, True), value=4096)
@@ -787,3 +1011,913 @@ class TestCoreDump(TestCase):
             f.flush()
             prog.set_core_dump(f.name)
         self.assertEqual(prog.read(0xFFFF0000, len(data) + 4), data + bytes(4))
+
+
+def prstatus_note(tid, rip, rbp, rsp):
+    """Create an x86-64 NT_PRSTATUS note with the given registers."""
+    desc = bytearray(336)
+    struct.pack_into("<I", desc, 32, tid)  # pr_pid
+    struct.pack_into("<Q", desc, 112 + 4 * 8, rbp)  # pr_reg
+    struct.pack_into("<Q", desc, 112 + 16 * 8, rip)
+    struct.pack_into("<Q", desc, 112 + 19 * 8, rsp)
+    name = b"CORE\0"
+    return (
+        struct.pack("<III", len(name), len(desc), 1)  # NT_PRSTATUS
+        + name
+        + bytes(-len(name) % 4)
+        + desc
+    )
+
+
+class TestStackTraces(TestCase):
+    def setUp(self):
+        super().setUp()
+        # Thread 1 has a chain of two frame pointers on its stack. Thread 2
+        # doesn't have a frame pointer.
+        stack = bytearray(0x40)
+        struct.pack_into("<QQ", stack, 0x0, 0x7020, 0x401100)
+        struct.pack_into("<QQ", stack, 0x20, 0, 0x401200)
+        core = create_elf_file(
+            ET.CORE,
+            [
+                ElfSection(
+                    p_type=PT.NOTE,
+                    data=prstatus_note(1, 0x401000, 0x7000, 0x6FF0)
+                    + prstatus_note(2, 0x402000, 0, 0x7100),
+                ),
+                ElfSection(p_type=PT.LOAD, vaddr=0x7000, data=stack),
+            ],
+        )
+        self.prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(core)
+            f.flush()
+            self.prog.set_core_dump(f.name)
+        # libdwfl needs at least one module to determine the architecture.
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf(()))
+            f.flush()
+            self.prog.load_debug_info([f.name])
+
+    @staticmethod
+    def pcs(trace):
+        return [frame.pc for frame in trace]
+
+    def test_stack_trace(self):
+        self.assertEqual(
+            self.pcs(self.prog.stack_trace(1)), [0x401000, 0x401100, 0x401200]
+        )
+        self.assertEqual(self.pcs(self.prog.stack_trace(2)), [0x402000])
+        self.assertRaisesRegex(
+            LookupError, "thread not found", self.prog.stack_trace, 3
+        )
+
+    def test_stack_traces(self):
+        traces = self.prog.stack_traces([1, 2, 3, Object(self.prog, "int", 1)])
+        self.assertEqual(len(traces), 4)
+        self.assertEqual(self.pcs(traces[0]), [0x401000, 0x401100, 0x401200])
+        self.assertEqual(self.pcs(traces[1]), [0x402000])
+        self.assertIsNone(traces[2])
+        self.assertEqual(self.pcs(traces[3]), self.pcs(traces[0]))
+        self.assertEqual(self.prog.stack_traces([]), [])
+
+    def test_aggregate_stack_traces(self):
+        obj = Object(self.prog, "int", 2)
+        buckets = self.prog.aggregate_stack_traces([2, 1, 3, 1, obj, 1])
+        self.assertEqual(
+            [(self.pcs(trace), threads) for trace, threads in buckets],
+            [([0x401000, 0x401100, 0x401200], [1, 1, 1]), ([0x402000], [2, obj])],
+        )
+        self.assertIs(buckets[1][1][1], obj)
+        self.assertEqual(self.prog.aggregate_stack_traces([3]), [])
+        self.assertEqual(self.prog.aggregate_stack_traces([]), [])
+
+    def test_stack_traces_invalid(self):
+        self.assertRaises(TypeError, self.prog.stack_traces, 1)
+        self.assertRaises(TypeError, self.prog.stack_traces, [1.0])
+        self.assertRaisesRegex(
+            TypeError,
+            "expected struct pt_regs",
+            self.prog.stack_traces,
+            [1, Object(self.prog, "int *", 0)],
+        )
+
+
+
+class TestPerCpu(TestCase):
+    def setUp(self):
+        buf = bytearray(0x4000)
+        # __per_cpu_offset, nr_cpu_ids, and __cpu_possible_mask (CPUs 0 and 2).
+        struct.pack_into("<4Q", buf, 0, 0, 0x1000, 0x2000, 0x3000)
+        struct.pack_into("<I", buf, 0x100, 3)
+        struct.pack_into("<Q", buf, 0x200, 0b101)
+        for cpu, value in enumerate((5, -2, 7)):
+            struct.pack_into("<i", buf, 0x1000 * (cpu + 1), value)
+        self.types = []
+        self.objects = []
+        self.prog = mock_program(
+            segments=[MockMemorySegment(bytes(buf), virt_addr=0xFFFF0000)],
+            types=self.types,
+            objects=self.objects,
+        )
+        unsigned_long = self.prog.int_type("unsigned long", 8, False)
+        self.objects.extend(
+            [
+                MockObject(
+                    "__per_cpu_offset",
+                    self.prog.array_type(unsigned_long, 4),
+                    address=0xFFFF0000,
+                ),
+                MockObject(
+                    "nr_cpu_ids",
+                    self.prog.int_type("unsigned int", 4, False),
+                    address=0xFFFF0100,
+                ),
+                MockObject(
+                    "__cpu_possible_mask",
+                    self.prog.struct_type(
+                        "cpumask",
+                        8,
+                        (TypeMember(self.prog.array_type(unsigned_long, 1), "bits"),),
+                    ),
+                    address=0xFFFF0200,
+                ),
+            ]
+        )
+        self.ptr = Object(self.prog, "int *", 0xFFFF1000)
+
+    def test_per_cpu_values(self):
+        self.assertEqual(
+            [value.value_() for value in self.prog.per_cpu_values(self.ptr)], [5, 7]
+        )
+        values = self.prog.per_cpu_values(self.ptr, [1, 0])
+        self.assertIdentical(values[0], Object(self.prog, "int", -2))
+        self.assertIdentical(values[1], Object(self.prog, "int", 5))
+        self.assertEqual(self.prog.per_cpu_values(self.ptr, []), [])
+        self.assertRaises(OutOfBoundsError, self.prog.per_cpu_values, self.ptr, [3])
+        self.assertRaises(
+            TypeError, self.prog.per_cpu_values, Object(self.prog, "int", 0)
+        )
+
+    def test_per_cpu_sum(self):
+        self.assertIdentical(
+            self.prog.per_cpu_sum(self.ptr), Object(self.prog, "long long", 12)
+        )
+        self.assertIdentical(
+            self.prog.per_cpu_sum(self.ptr, range(3)),
+            Object(self.prog, "long long", 10),
+        )
+        self.assertIdentical(
+            self.prog.per_cpu_sum(Object(self.prog, "unsigned int *", 0xFFFF1000)),
+            Object(self.prog, "unsigned long long", 12),
+        )
+        self.assertRaises(
+            TypeError,
+            self.prog.per_cpu_sum,
+            Object(self.prog, "double *", 0xFFFF1000),
+        )
+
+    def test_per_cpu_ptr(self):
+        self.assertIdentical(
+            per_cpu_ptr(self.ptr, 2), Object(self.prog, "int *", 0xFFFF3000)
+        )
+
+    def test_up(self):
+        # Without CONFIG_SMP, there is no __per_cpu_offset or nr_cpu_ids.
+        del self.objects[:2]
+        self.objects.append(
+            MockObject("init_task", self.prog.int_type("int", 4, True), address=0)
+        )
+        self.assertEqual(
+            [value.value_() for value in self.prog.per_cpu_values(self.ptr)], [5]
+        )
+
+    def test_missing_per_cpu_offset(self):
+        # Not having __per_cpu_offset doesn't mean that the kernel is UP.
+        del self.objects[0]
+        self.objects.append(
+            MockObject("init_task", self.prog.int_type("int", 4, True), address=0)
+        )
+        self.assertRaisesRegex(
+            LookupError, "per-CPU offsets", self.prog.per_cpu_values, self.ptr
+        )
+
+
+class TestSymbols(TestCase):
+    @staticmethod
+    def symbols_program(symbols):
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(compile_dwarf((), symbols=symbols))
+            f.flush()
+            prog.load_debug_info([f.name])
+        return prog
+
+    @staticmethod
+    def symbol_tuples(symbols):
+        return sorted((sym.name, sym.address, sym.size) for sym in symbols)
+
+    def setUp(self):
+        super().setUp()
+        self.prog = self.symbols_program(
+            (
+                ElfSymbol("foo", 0xFFFF0000, 8),
+                ElfSymbol("bar", 0xFFFF0008, 4),
+                ElfSymbol("baz", 0xFFFF000C, 4),
+                ElfSymbol("foo", 0xFFFF0010, 16, binding=STB.WEAK),
+                ElfSymbol("local", 0xFFFF0020, 4, binding=STB.LOCAL),
+            )
+        )
+
+    def test_by_name(self):
+        sym = self.prog.symbol("bar")
+        self.assertEqual((sym.name, sym.address, sym.size), ("bar", 0xFFFF0008, 4))
+        self.assertEqual(self.prog.symbol("foo").address, 0xFFFF0000)
+        self.assertRaisesRegex(
+            LookupError, "could not find symbol", self.prog.symbol, "local"
+        )
+        self.assertRaisesRegex(
+            LookupError, "could not find symbol", self.prog.symbol, "qux"
+        )
+
+    def test_symbols_exact(self):
+        self.assertEqual(
+            self.symbol_tuples(self.prog.symbols("foo")),
+            [("foo", 0xFFFF0000, 8), ("foo", 0xFFFF0010, 16)],
+        )
+        self.assertEqual(self.prog.symbols("qux"), [])
+
+    def test_symbols_pattern(self):
+        self.assertEqual(
+            self.symbol_tuples(self.prog.symbols("ba?")),
+            [("bar", 0xFFFF0008, 4), ("baz", 0xFFFF000C, 4)],
+        )
+        self.assertEqual(
+            [sym.name for sym in self.prog.symbols("[fz]*")], ["foo", "foo"]
+        )
+        self.assertEqual(self.prog.symbols("q*"), [])
+
+    def test_all_symbols(self):
+        self.assertEqual(
+            self.symbol_tuples(self.prog.symbols()),
+            [
+                ("bar", 0xFFFF0008, 4),
+                ("baz", 0xFFFF000C, 4),
+                ("foo", 0xFFFF0000, 8),
+                ("foo", 0xFFFF0010, 16),
+            ],
+        )
+
+    def test_no_debug_info(self):
+        prog = Program()
+        self.assertEqual(prog.symbols(), [])
+        self.assertRaises(LookupError, prog.symbol, "foo")
+        self.assertRaises(LookupError, prog.symbol, 0xFFFF0000)
+        self.assertEqual(prog.symbolize([0xFFFF0000, 0]), [None, None])
+
+    def test_symbolize_invalid(self):
+        self.assertRaises(TypeError, self.prog.symbolize, 0xFFFF0000)
+        self.assertRaises(TypeError, self.prog.symbolize, ["foo"])
+        self.assertEqual(self.prog.symbolize([]), [])
+
+
+def linux_kernel_core(vmcoreinfo, segments):
+    """
+    Create a Linux kernel core dump with the given VMCOREINFO and memory
+    segments.
+    """
+    vmcoreinfo = vmcoreinfo.encode()
+    note_name = b"VMCOREINFO\0"
+    note = bytearray(struct.pack("<III", len(note_name), len(vmcoreinfo), 0))
+    note.extend(note_name + bytes(-len(note_name) % 4))
+    note.extend(vmcoreinfo + bytes(-len(vmcoreinfo) % 4))
+    return create_elf_file(ET.CORE, [ElfSection(p_type=PT.NOTE, data=note), *segments])
+
+
+def kallsyms_vmcore(symbols):
+    """
+    Create a Linux kernel core dump containing the compressed kallsyms tables
+    for the given (type, name, address) tuples.
+    """
+    base = 0xFFFFFFFF81000000
+    # Token 1 expands to a common prefix. Every other token is a single byte.
+    tokens = [bytes([i]) for i in range(256)]
+    tokens[1] = b"do_"
+    token_table = bytearray()
+    token_index = []
+    for token in tokens:
+        token_index.append(len(token_table))
+        token_table.extend(token + b"\0")
+
+    names = bytearray()
+    for type, name, _ in symbols:
+        encoded = (type + name).replace(b"do_", b"\x01")
+        if len(encoded) < 0x80:
+            names.append(len(encoded))
+        else:
+            names.extend((len(encoded) & 0x7F | 0x80, len(encoded) >> 7))
+        names.extend(encoded)
+
+    relative_base = min(address for _, _, address in symbols)
+    data = bytearray()
+    offsets = len(data)
+    for _, _, address in symbols:
+        data.extend(struct.pack("<I", address - relative_base))
+    data.extend(bytes(-len(data) % 8))
+    relative_base_offset = len(data)
+    data.extend(struct.pack("<QQ", relative_base, len(symbols)))
+    names_offset = len(data)
+    data.extend(names)
+    data.extend(bytes(-len(data) % 8))
+    token_table_offset = len(data)
+    data.extend(token_table)
+    data.extend(bytes(-len(data) % 8))
+    token_index_offset = len(data)
+    data.extend(struct.pack("<256H", *token_index))
+
+    vmcoreinfo = f"""OSRELEASE=6.0.0
+PAGESIZE=4096
+SYMBOL(swapper_pg_dir)={base:x}
+SYMBOL(kallsyms_names)={base + names_offset:x}
+SYMBOL(kallsyms_num_syms)={base + relative_base_offset + 8:x}
+SYMBOL(kallsyms_token_table)={base + token_table_offset:x}
+SYMBOL(kallsyms_token_index)={base + token_index_offset:x}
+SYMBOL(kallsyms_offsets)={base + offsets:x}
+SYMBOL(kallsyms_relative_base)={base + relative_base_offset:x}
+"""
+    return linux_kernel_core(
+        vmcoreinfo, [ElfSection(p_type=PT.LOAD, vaddr=base, data=data)]
+    )
+
+
+class TestKallsyms(TestCase):
+    def setUp(self):
+        super().setUp()
+        self.prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                kallsyms_vmcore(
+                    (
+                        (b"T", b"_stext", 0xFFFFFFFF81000000),
+                        (b"T", b"do_fork", 0xFFFFFFFF81000100),
+                        (b"t", b"do_exit", 0xFFFFFFFF81000180),
+                        (b"T", b"x" * 200, 0xFFFFFFFF81000200),
+                        (b"t", b"do_exit", 0xFFFFFFFF81000300),
+                        (b"D", b"_end", 0xFFFFFFFF81000400),
+                    )
+                )
+            )
+            f.flush()
+            self.prog.set_core_dump(f.name)
+
+    def test_by_name(self):
+        sym = self.prog.symbol("do_fork")
+        self.assertEqual(
+            (sym.name, sym.address, sym.size), ("do_fork", 0xFFFFFFFF81000100, 0x80)
+        )
+        self.assertEqual(self.prog.symbol("x" * 200).address, 0xFFFFFFFF81000200)
+        self.assertRaises(LookupError, self.prog.symbol, "do_")
+
+    def test_by_address(self):
+        sym = self.prog.symbol(0xFFFFFFFF810001FF)
+        self.assertEqual(
+            (sym.name, sym.address, sym.size), ("do_exit", 0xFFFFFFFF81000180, 0x80)
+        )
+        self.assertEqual(self.prog.symbol(0xFFFFFFFF81000000).name, "_stext")
+        self.assertRaises(LookupError, self.prog.symbol, 0xFFFFFFFF80FFFFFF)
+        self.assertRaises(LookupError, self.prog.symbol, 0xFFFFFFFF81000400)
+        self.assertEqual(
+            [
+                sym and sym.name for sym in self.prog.symbolize([0xFFFFFFFF81000101, 0])
+            ],
+            ["do_fork", None],
+        )
+
+    def test_symbols(self):
+        self.assertEqual(
+            sorted(sym.address for sym in self.prog.symbols("do_exit")),
+            [0xFFFFFFFF81000180, 0xFFFFFFFF81000300],
+        )
+        self.assertEqual(
+            sorted(sym.name for sym in self.prog.symbols("do_*")),
+            ["do_exit", "do_exit", "do_fork"],
+        )
+        self.assertEqual(len(self.prog.symbols()), 6)
+
+
+class TestPointerIndex(TestCase):
+    PAGE_OFFSET = 0xFFFF888000000000
+
+    def _program(self, vmcoreinfo="", phys_offset=0):
+        data = bytearray(8192)
+        struct.pack_into(
+            "<4Q",
+            data,
+            0,
+            self.PAGE_OFFSET + 0x1000,
+            self.PAGE_OFFSET + 0x10,
+            0x1234,
+            self.PAGE_OFFSET + 0x1000,
+        )
+        # Past the end of the direct mapping.
+        struct.pack_into("<Q", data, 0x1008, self.PAGE_OFFSET + 0x2000)
+        struct.pack_into("<Q", data, 0x1010, self.PAGE_OFFSET + 0x1FFF)
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(
+                linux_kernel_core(
+                    "OSRELEASE=6.0.0\nPAGESIZE=4096\n"
+                    "SYMBOL(swapper_pg_dir)=ffffffff82000000\n" + vmcoreinfo,
+                    [
+                        ElfSection(
+                            p_type=PT.LOAD,
+                            vaddr=self.PAGE_OFFSET,
+                            paddr=phys_offset,
+                            data=data,
+                        )
+                    ],
+                )
+            )
+            f.flush()
+            prog.set_core_dump(f.name)
+
+        def find_object(prog, name, flags, filename):
+            if name == "PAGE_OFFSET":
+                return Object(prog, "unsigned long", self.PAGE_OFFSET)
+            elif name == "max_pfn":
+                return Object(prog, "unsigned long", (phys_offset >> 12) + 2)
+            elif name == "memstart_addr" and phys_offset:
+                return Object(prog, "long", phys_offset)
+            return None
+
+        prog.add_object_finder(find_object)
+        return prog
+
+    def setUp(self):
+        super().setUp()
+        self.prog = self._program()
+
+    def test_referrers(self):
+        index = pointer_index(self.prog)
+        self.assertEqual(len(index), 4)
+        self.assertEqual(
+            index.referrers(self.PAGE_OFFSET + 0x1000, 0x1000),
+            [
+                (self.PAGE_OFFSET, self.PAGE_OFFSET + 0x1000),
+                (self.PAGE_OFFSET + 0x18, self.PAGE_OFFSET + 0x1000),
+                (self.PAGE_OFFSET + 0x1010, self.PAGE_OFFSET + 0x1FFF),
+            ],
+        )
+        self.assertEqual(
+            index.referrers(self.PAGE_OFFSET + 0x10),
+            [(self.PAGE_OFFSET + 0x8, self.PAGE_OFFSET + 0x10)],
+        )
+        self.assertEqual(index.referrers(self.PAGE_OFFSET + 0x11, 0xFEF), [])
+
+    def test_phys_offset(self):
+        # The direct mapping starts at the beginning of RAM (e.g., AArch64).
+        prog = self._program(phys_offset=0x80000000)
+        index = pointer_index(prog)
+        self.assertEqual(len(index), 4)
+        self.assertEqual(
+            index.referrers(self.PAGE_OFFSET + 0x10),
+            [(self.PAGE_OFFSET + 0x8, self.PAGE_OFFSET + 0x10)],
+        )
+
+    def test_save(self):
+        with tempfile.TemporaryDirectory(prefix="drgn-tests-") as dir:
+            path = os.path.join(dir, "pointers")
+            index = pointer_index(self.prog, path)
+            loaded = pointer_index(self.prog, path)
+            self.assertEqual(len(loaded), len(index))
+            self.assertEqual(
+                loaded.referrers(self.PAGE_OFFSET, 0x2000),
+                index.referrers(self.PAGE_OFFSET, 0x2000),
+            )
+
+            # Same kernel, but a different crash.
+            self.assertRaisesRegex(
+                ValueError,
+                "different core dump",
+                pointer_index,
+                self._program("CRASHTIME=1700000000\n"),
+                path,
+            )
+
+            with open(path, "r+b") as f:
+                # Change the size of the direct mapping in the header.
+                f.seek(32)
+                f.write(struct.pack("<Q", 0x1000))
+            self.assertRaisesRegex(
+                ValueError, "different kernel", pointer_index, self.prog, path
+            )
+            with open(path, "r+b") as f:
+                f.write(b"NOTANIDX")
+            self.assertRaisesRegex(
+                Exception, "not a pointer index", pointer_index, self.prog, path
+            )
+
+
+class TestMinicore(TestCase):
+    def _reload(self, prog):
+        with tempfile.TemporaryDirectory(prefix="drgn-tests-") as dir:
+            path = os.path.join(dir, "minicore")
+            prog.write_minicore(path)
+            minicore = Program()
+            minicore.set_core_dump(path)
+        return minicore
+
+    def _test_userspace(self, platform):
+        data = bytes(range(256)) * 64
+        prog = mock_program(
+            platform,
+            segments=[
+                MockMemorySegment(data, 0xFFFF0000),
+                MockMemorySegment(b"hello" * 2000, 0x100000),
+            ],
+        )
+        prog.start_recording()
+        # Crosses a page boundary.
+        self.assertEqual(prog.read(0xFFFF0FF0, 32), data[0xFF0:0x1010])
+        self.assertEqual(prog.read(0x100005, 3), b"hel")
+        prog.stop_recording()
+        prog.read(0x102000, 4)
+
+        minicore = self._reload(prog)
+        self.assertEqual(minicore.platform, platform)
+        self.assertEqual(minicore.read(0xFFFF0000, 8192), data[:8192])
+        self.assertEqual(minicore.read(0x100000, 4096), (b"hello" * 2000)[:4096])
+        self.assertRaises(FaultError, minicore.read, 0xFFFF2000, 1)
+        self.assertRaises(FaultError, minicore.read, 0x102000, 4)
+
+    def test_contents_from_first_read(self):
+        data = bytearray(b"a" * 8192)
+        prog = mock_program(segments=[MockMemorySegment(data, 0xFFFF0000)])
+        prog.start_recording()
+        self.assertEqual(prog.read(0xFFFF0010, 4), b"aaaa")
+        data[:] = b"b" * 8192
+        self.assertEqual(prog.read(0xFFFF0020, 4), b"bbbb")
+        self.assertEqual(prog.read(0xFFFF1000, 4), b"bbbb")
+        data[:] = b"c" * 8192
+
+        minicore = self._reload(prog)
+        self.assertEqual(minicore.read(0xFFFF0000, 4096), b"a" * 4096)
+        self.assertEqual(minicore.read(0xFFFF1000, 4096), b"b" * 4096)
+
+    def test_userspace(self):
+        self._test_userspace(MOCK_PLATFORM)
+
+    def test_userspace_32_bit(self):
+        self._test_userspace(MOCK_32BIT_PLATFORM)
+
+    def test_kernel(self):
+        page_offset = 0xFFFF888000000000
+        data = bytes(range(256)) * 64
+        core = linux_kernel_core(
+            "OSRELEASE=6.0.0\nPAGESIZE=4096\n"
+            "SYMBOL(swapper_pg_dir)=ffffffff82000000\n",
+            [ElfSection(p_type=PT.LOAD, vaddr=page_offset, paddr=0, data=data)],
+        )
+        prog = Program()
+        prog.start_recording()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(core)
+            f.flush()
+            prog.set_core_dump(f.name)
+        prog.add_object_finder(
+            lambda prog, name, flags, filename: Object(
+                prog, "unsigned long", page_offset
+            )
+            if name == "PAGE_OFFSET"
+            else None
+        )
+        prog.read(page_offset + 0x1010, 8)
+        prog.read(0x3000, 16, True)
+
+        minicore = self._reload(prog)
+        self.assertTrue(minicore.flags & ProgramFlags.IS_LINUX_KERNEL)
+        self.assertEqual(minicore["UTS_RELEASE"].string_(), b"6.0.0")
+        self.assertEqual(minicore.read(page_offset + 0x1000, 4096), data[0x1000:0x2000])
+        self.assertEqual(minicore.read(0x3000, 4096, True), data[0x3000:0x4000])
+        # Physical memory is also available in the direct mapping.
+        self.assertEqual(minicore.read(page_offset + 0x3000, 16), data[0x3000:0x3010])
+        self.assertRaises(FaultError, minicore.read, 0x1000, 1, True)
+        self.assertRaises(FaultError, minicore.read, page_offset + 0x2000, 1)
+
+    def test_not_recorded(self):
+        prog = mock_program(segments=[MockMemorySegment(b"foo", 0xFFFF0000)])
+        with tempfile.TemporaryDirectory(prefix="drgn-tests-") as dir:
+            self.assertRaisesRegex(
+                ValueError,
+                "not been recorded",
+                prog.write_minicore,
+                os.path.join(dir, "minicore"),
+            )
+
+
+# ORC register and type numbers (since Linux 6.4).
+ORC_REG_UNDEFINED = 0
+ORC_REG_PREV_SP = 1
+ORC_REG_BP = 4
+ORC_REG_SP = 5
+ORC_TYPE_UNDEFINED = 0
+ORC_TYPE_END_OF_STACK = 1
+ORC_TYPE_CALL = 2
+ORC_TYPE_REGS = 3
+
+
+def orc_entry(version, sp_reg, sp_offset, bp_reg, bp_offset, type, signal=False):
+    if version >= (6, 4):
+        flags = sp_reg | bp_reg << 4 | type << 8 | signal << 11
+    elif type == ORC_TYPE_END_OF_STACK:
+        # Before Linux 6.3, the end of the stack had an undefined stack
+        # pointer and the end bit set.
+        flags = 1 << 10
+    else:
+        # Before Linux 6.4, CALL was 0 and REGS was 1.
+        flags = sp_reg | bp_reg << 4 | max(type - ORC_TYPE_CALL, 0) << 8
+    return struct.pack("<hhH", sp_offset, bp_offset, flags)
+
+
+class TestOrc(TestCase):
+    TEXT = 0xFFFFFFFF81000000
+    ORC = 0xFFFFFFFF82000000
+    STACK = 0xFFFFC90000004000
+    REGS = 0xFFFFC90000008000
+
+    def orc_program(self, version):
+        T = self.TEXT
+        S = self.STACK
+        # Deliberately unsorted, like the tables in kernel modules.
+        entries = [
+            (
+                T + 0x500,
+                (ORC_REG_UNDEFINED, 0, ORC_REG_UNDEFINED, 0, ORC_TYPE_UNDEFINED),
+            ),
+            (T + 0x100, (ORC_REG_BP, 16, ORC_REG_PREV_SP, -16, ORC_TYPE_CALL)),
+            (T, (ORC_REG_SP, 24, ORC_REG_PREV_SP, -24, ORC_TYPE_CALL)),
+            (T + 0x200, (ORC_REG_SP, 0, ORC_REG_UNDEFINED, 0, ORC_TYPE_REGS, True)),
+            (
+                T + 0x400,
+                (ORC_REG_UNDEFINED, 0, ORC_REG_UNDEFINED, 0, ORC_TYPE_END_OF_STACK),
+            ),
+            (T + 0x300, (ORC_REG_SP, 8, ORC_REG_UNDEFINED, 0, ORC_TYPE_CALL)),
+        ]
+        orc_unwind_ip = b"".join(
+            struct.pack("<i", pc - (self.ORC + 4 * i))
+            for i, (pc, _) in enumerate(entries)
+        )
+        orc_unwind = b"".join(orc_entry(version, *entry) for _, entry in entries)
+        vmlinux = compile_dwarf(
+            (),
+            sections=(
+                ElfSection(name=".init.text", sh_type=SHT.PROGBITS, data=b""),
+                ElfSection(
+                    name=".text",
+                    sh_type=SHT.PROGBITS,
+                    p_type=PT.LOAD,
+                    vaddr=T,
+                    p_align=0x1000,
+                    data=bytes(0x600),
+                ),
+                ElfSection(
+                    name=".orc_unwind_ip",
+                    sh_type=SHT.PROGBITS,
+                    vaddr=self.ORC,
+                    data=orc_unwind_ip,
+                ),
+                ElfSection(
+                    name=".orc_unwind",
+                    sh_type=SHT.PROGBITS,
+                    vaddr=self.ORC + 0x1000,
+                    data=orc_unwind,
+                ),
+            ),
+            symbols=[
+                ElfSymbol(f"f{i}", T + 0x100 * i, 0x100, STT.FUNC) for i in range(5)
+            ],
+        )
+
+        # f0 saved the frame pointer and has 8 bytes of locals. f1 uses a
+        # frame pointer. f2 is an interrupt entry point whose pt_regs were
+        # saved on its caller's stack. f3 was interrupted and has no frame.
+        stack = bytearray(0x300)
+        struct.pack_into("<Q", stack, 0x0, S + 0x40)
+        struct.pack_into("<Q", stack, 0x10, T + 0x110)
+        struct.pack_into("<QQ", stack, 0x40, 0x5555, T + 0x210)
+        pt_regs = [0] * 21
+        pt_regs[3] = 0x1212  # r12
+        pt_regs[4] = 0x6666  # rbp
+        pt_regs[16] = T + 0x300  # ip
+        pt_regs[17] = 0x10  # cs
+        pt_regs[19] = S + 0x200  # sp
+        struct.pack_into("<21Q", stack, 0x50, *pt_regs)
+        struct.pack_into("<Q", stack, 0x200, T + 0x401)
+
+        initial_regs = [0] * 21
+        initial_regs[4] = 0x1234  # rbp
+        initial_regs[5] = 0xBB  # rbx
+        initial_regs[16] = T + 0x10  # ip
+        initial_regs[19] = S  # sp
+        core = linux_kernel_core(
+            f"""OSRELEASE={version[0]}.{version[1]}.0
+PAGESIZE=4096
+SYMBOL(swapper_pg_dir)={T:x}
+""",
+            [
+                ElfSection(p_type=PT.LOAD, vaddr=S, paddr=0x4000, data=stack),
+                ElfSection(
+                    p_type=PT.LOAD,
+                    vaddr=self.REGS,
+                    paddr=0x8000,
+                    data=struct.pack("<21Q", *initial_regs),
+                ),
+            ],
+        )
+
+        prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(core)
+            f.flush()
+            prog.set_core_dump(f.name)
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(vmlinux)
+            f.flush()
+            prog.load_debug_info([f.name])
+        return prog
+
+    def assert_orc_stack_trace(self, version):
+        prog = self.orc_program(version)
+        pt_regs_type = prog.struct_type("pt_regs", 21 * 8, ())
+        trace = prog.stack_trace(Object(prog, pt_regs_type, address=self.REGS))
+        T = self.TEXT
+        S = self.STACK
+        self.assertEqual(
+            [frame.pc for frame in trace],
+            [T + 0x10, T + 0x110, T + 0x210, T + 0x300, T + 0x401],
+        )
+        # The interrupted frame is symbolized by its exact program counter.
+        self.assertEqual(
+            [frame.symbol().name for frame in trace], ["f0", "f1", "f2", "f3", "f4"]
+        )
+        self.assertEqual(trace[0].register("rbx"), 0xBB)
+        self.assertEqual(trace[1].register("rsp"), S + 24)
+        self.assertEqual(trace[1].register("rbp"), S + 0x40)
+        self.assertRaises(LookupError, trace[1].register, "rbx")
+        self.assertEqual(trace[2].register("rbp"), 0x5555)
+        self.assertEqual(trace[3].register("r12"), 0x1212)
+        self.assertEqual(trace[3].register("rsp"), S + 0x200)
+        self.assertEqual(trace[4].register("rsp"), S + 0x208)
+        self.assertEqual(trace[4].register("rbp"), 0x6666)
+
+    def test_stack_trace(self):
+        self.assert_orc_stack_trace((6, 4))
+
+    def test_stack_trace_old_format(self):
+        self.assert_orc_stack_trace((5, 10))
+
+
+def cfi_entry(body, cie_id=None):
+    """Create a 32-bit call frame information entry padded to 4 bytes."""
+    if cie_id is not None:
+        body = struct.pack("<I", cie_id) + body
+    body += bytes(-(len(body) + 4) % 4)  # DW_CFA_nop
+    return struct.pack("<I", len(body)) + body
+
+
+class TestCfi(TestCase):
+    TEXT = 0xFFFFFFFF81000000
+    EH_FRAME = 0xFFFFFFFF82000000
+    STACK = 0xFFFFC90000004000
+    REGS = 0xFFFFC90000008000
+
+    def setUp(self):
+        super().setUp()
+        T = self.TEXT
+        S = self.STACK
+        # Both CIEs have code alignment 1, data alignment -8, the return
+        # address in rip, and initial instructions DW_CFA_def_cfa rsp+8,
+        # DW_CFA_offset rip at CFA-8.
+        initial_instructions = b"\x0c\x07\x08\x90\x01"
+        # f0 is described by .eh_frame (with augmentation "zR" and pcrel
+        # sdata4 addresses). After 4 bytes, it has pushed rbp and rbx and has 8
+        # bytes of locals: DW_CFA_advance_loc 4, DW_CFA_def_cfa_offset 24,
+        # DW_CFA_offset rbx at CFA-16, DW_CFA_offset rbp at CFA-24.
+        eh_cie = cfi_entry(b"\x01zR\x00\x01\x78\x10\x01\x1b" + initial_instructions, 0)
+        fde_address = self.EH_FRAME + len(eh_cie)
+        eh_frame = (
+            eh_cie
+            + cfi_entry(
+                struct.pack("<Iii", len(eh_cie) + 4, T - (fde_address + 8), 0x100)
+                + b"\x00\x44\x0e\x18\x83\x02\x86\x03"
+            )
+            + bytes(4)
+        )
+        # f1 is described by version 4 .debug_frame. After 4 bytes, it has
+        # pushed rbp and set up a frame pointer: DW_CFA_advance_loc 4,
+        # DW_CFA_def_cfa_expression DW_OP_breg6 16, DW_CFA_offset rbp at
+        # CFA-16.
+        debug_frame = cfi_entry(
+            b"\x04\x00\x08\x00\x01\x78\x10" + initial_instructions, 0xFFFFFFFF
+        ) + cfi_entry(
+            struct.pack("<IQQ", 0, T + 0x100, 0x100)
+            + b"\x44\x0f\x02\x76\x10\x86\x02"
+        )
+        # f2 doesn't have any call frame information.
+        vmlinux = compile_dwarf(
+            (),
+            sections=(
+                ElfSection(name=".init.text", sh_type=SHT.PROGBITS, data=b""),
+                ElfSection(
+                    name=".text",
+                    sh_type=SHT.PROGBITS,
+                    p_type=PT.LOAD,
+                    vaddr=T,
+                    p_align=0x1000,
+                    data=bytes(0x300),
+                ),
+                ElfSection(
+                    name=".eh_frame",
+                    sh_type=SHT.PROGBITS,
+                    vaddr=self.EH_FRAME,
+                    data=eh_frame,
+                ),
+                ElfSection(name=".debug_frame", sh_type=SHT.PROGBITS, data=debug_frame),
+            ),
+        )
+
+        # f0 saved rbp and rbx. f1 uses a frame pointer, and so does f2, which
+        # is the outermost frame.
+        stack = bytearray(0x70)
+        struct.pack_into("<QQQ", stack, 0x0, S + 0x40, 0x5555, T + 0x110)
+        struct.pack_into("<QQ", stack, 0x40, S + 0x60, T + 0x210)
+        initial_regs = [0] * 21
+        initial_regs[4] = 0x1234  # rbp
+        initial_regs[5] = 0xBB  # rbx
+        initial_regs[16] = T + 0x10  # ip
+        initial_regs[19] = S  # sp
+        core = linux_kernel_core(
+            f"""OSRELEASE=6.0.0
+PAGESIZE=4096
+SYMBOL(swapper_pg_dir)={T:x}
+""",
+            [
+                ElfSection(p_type=PT.LOAD, vaddr=S, paddr=0x4000, data=stack),
+                ElfSection(
+                    p_type=PT.LOAD,
+                    vaddr=self.REGS,
+                    paddr=0x8000,
+                    data=struct.pack("<21Q", *initial_regs),
+                ),
+            ],
+        )
+
+        self.prog = Program()
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(core)
+            f.flush()
+            self.prog.set_core_dump(f.name)
+        with tempfile.NamedTemporaryFile() as f:
+            f.write(vmlinux)
+            f.flush()
+            self.prog.load_debug_info([f.name])
+        pt_regs_type = self.prog.struct_type("pt_regs", 21 * 8, ())
+        self.regs = Object(self.prog, pt_regs_type, address=self.REGS)
+        self.trace = self.prog.stack_trace(self.regs)
+
+    def test_pcs(self):
+        T = self.TEXT
+        self.assertEqual(
+            [frame.pc for frame in self.trace], [T + 0x10, T + 0x110, T + 0x210]
+        )
+
+    def test_registers(self):
+        S = self.STACK
+        self.assertEqual(self.trace[0].register("rbx"), 0xBB)
+        # Restored from the stack by the rules for f0.
+        self.assertEqual(self.trace[1].register("rbx"), 0x5555)
+        self.assertEqual(self.trace[1].register("rbp"), S + 0x40)
+        self.assertEqual(self.trace[1].register("rsp"), S + 0x18)
+        # Restored by the rules for f1, whose CFA is a DWARF expression. rbx
+        # is callee-saved, so it is unchanged.
+        self.assertEqual(self.trace[2].register("rbx"), 0x5555)
+        self.assertEqual(self.trace[2].register("rbp"), S + 0x60)
+        self.assertEqual(self.trace[2].register("rsp"), S + 0x50)
+
+    def test_frame_pointer_unwinding(self):
+        self.assertFalse(self.prog.frame_pointer_unwinding)
+        self.prog.frame_pointer_unwinding = True
+        self.assertTrue(self.prog.frame_pointer_unwinding)
+        T = self.TEXT
+        S = self.STACK
+        trace = self.prog.stack_trace(self.regs)
+        self.assertEqual(
+            [frame.pc for frame in trace], [T + 0x10, T + 0x110, T + 0x210]
+        )
+        # The interrupted frame is still unwound with call frame information.
+        self.assertEqual(trace[1].register("rbx"), 0x5555)
+        # The next frame is unwound with the frame pointer, which doesn't
+        # restore any other registers.
+        self.assertEqual(trace[2].register("rbp"), S + 0x60)
+        self.assertEqual(trace[2].register("rsp"), S + 0x50)
+        self.assertRaises(LookupError, trace[2].register, "rbx")